@@ -27,16 +27,76 @@ mkdir -p gen/bin
 
 # ----
 
+echo "Building gen/bin/iconvg-bench-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    example/iconvg-bench/iconvg-bench.c \
+    -lcairo \
+    -o gen/bin/iconvg-bench-with-cairo
+
+# ----
+
+echo "Building gen/bin/iconvg-cache-bench-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    example/iconvg-cache-bench/iconvg-cache-bench.c \
+    -lcairo \
+    -o gen/bin/iconvg-cache-bench-with-cairo
+
+# ----
+
+echo "Building gen/bin/iconvg-disassemble-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    example/iconvg-disassemble/iconvg-disassemble.c \
+    -lcairo \
+    -o gen/bin/iconvg-disassemble-with-cairo
+
+# ----
+
+echo "Building gen/bin/iconvg-encode-bench-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    example/iconvg-encode-bench/iconvg-encode-bench.c \
+    -lcairo \
+    -o gen/bin/iconvg-encode-bench-with-cairo
+
+# ----
+
+echo "Building gen/bin/iconvg-to-c-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    example/iconvg-to-c/iconvg-to-c.c \
+    -lcairo \
+    -o gen/bin/iconvg-to-c-with-cairo
+
+# ----
+
 echo "Building gen/bin/iconvg-to-png-with-cairo"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
     -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
     example/iconvg-to-png/iconvg-to-png.c \
-    -lcairo -lpng \
+    -lcairo -lpng -pthread \
     -o gen/bin/iconvg-to-png-with-cairo
 
 # ----
 
+echo "Building gen/bin/iconvg-trace-with-cairo"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_CAIRO_BACKEND \
+    example/iconvg-trace/iconvg-trace.c \
+    -lcairo \
+    -o gen/bin/iconvg-trace-with-cairo
+
+# ----
+
 echo "Building gen/bin/iconvg-viewer-with-cairo"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
@@ -36,6 +36,71 @@ mkdir -p gen/bin
 
 # ----
 
+echo "Building gen/bin/iconvg-bench-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-bench/iconvg-bench.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -o gen/bin/iconvg-bench-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
+echo "Building gen/bin/iconvg-cache-bench-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-cache-bench/iconvg-cache-bench.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -o gen/bin/iconvg-cache-bench-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
+echo "Building gen/bin/iconvg-disassemble-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-disassemble/iconvg-disassemble.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -o gen/bin/iconvg-disassemble-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
+echo "Building gen/bin/iconvg-encode-bench-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-encode-bench/iconvg-encode-bench.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -o gen/bin/iconvg-encode-bench-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
+echo "Building gen/bin/iconvg-to-c-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-to-c/iconvg-to-c.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -o gen/bin/iconvg-to-c-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
 echo "Building gen/bin/iconvg-to-png-with-skia"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
@@ -43,13 +108,26 @@ ${CC:-gcc} -O3 -Wall -std=c99 \
     -I $SKIA_LIB_DIR/../.. \
     example/iconvg-to-png/iconvg-to-png.c \
     $SKIA_LIB_DIR/libskia.* \
-    -lpng \
+    -lpng -pthread \
     -o gen/bin/iconvg-to-png-with-skia \
     -Wl,-rpath \
     -Wl,$SKIA_LIB_DIR
 
 # ----
 
+echo "Building gen/bin/iconvg-trace-with-skia"
+
+${CC:-gcc} -O3 -Wall -std=c99 \
+    -DICONVG_CONFIG__ENABLE_SKIA_BACKEND \
+    -I $SKIA_LIB_DIR/../.. \
+    example/iconvg-trace/iconvg-trace.c \
+    $SKIA_LIB_DIR/libskia.* \
+    -o gen/bin/iconvg-trace-with-skia \
+    -Wl,-rpath \
+    -Wl,$SKIA_LIB_DIR
+
+# ----
+
 echo "Building gen/bin/iconvg-viewer-with-skia"
 
 ${CC:-gcc} -O3 -Wall -std=c99 \
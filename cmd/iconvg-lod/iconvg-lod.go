@@ -0,0 +1,86 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-lod converts an IconVG file into one with multiple Level of Detail
+// variants, with simplified geometry for small heights. Decoders pick the
+// variant that matches the height_in_pixels. See lowlevel.GenerateLODs for
+// the details.
+//
+// Usage: iconvg-lod [flags] input.iconvg > output.iconvg
+//
+// For example, to add variants for below 20 pixels and for 20 up to 32
+// pixels high, simplified to within a quarter of a pixel:
+//
+//	iconvg-lod -heights=20,32 -tolerance=0.25 in.iconvg > out.iconvg
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+	"strconv"
+	"strings"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	heightsFlag   = flag.String("heights", "20,32", "comma-separated, increasing height_in_pixels boundaries between the variants")
+	minAreaFlag   = flag.Float64("min-area", 0.5, "bounding box area (in square pixels) below which drawings are removed; negative means never")
+	toleranceFlag = flag.Float64("tolerance", 0.5, "how far (in pixels) simplified geometry may stray from the original")
+)
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	flag.Usage = func() {
+		fmt.Fprintf(flag.CommandLine.Output(), "Usage: %s [flags] input.iconvg > output.iconvg\n", os.Args[0])
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	if flag.NArg() != 1 {
+		flag.Usage()
+		os.Exit(2)
+	}
+
+	opts := &lowlevel.LODOptions{
+		Tolerance: float32(*toleranceFlag),
+		MinArea:   float32(*minAreaFlag),
+	}
+	for _, s := range strings.Split(*heightsFlag, ",") {
+		h, err := strconv.ParseFloat(strings.TrimSpace(s), 32)
+		if err != nil {
+			return fmt.Errorf("invalid -heights: %v", err)
+		}
+		opts.Heights = append(opts.Heights, float32(h))
+	}
+
+	src, err := os.ReadFile(flag.Arg(0))
+	if err != nil {
+		return err
+	}
+	data, err := lowlevel.GenerateLODs(src, opts)
+	if err != nil {
+		return fmt.Errorf("%s: %v", flag.Arg(0), err)
+	}
+	_, err = os.Stdout.Write(data)
+	return err
+}
@@ -0,0 +1,174 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-optimize re-encodes IconVG files to be smaller and faster to decode,
+// without changing what they draw. See lowlevel.Optimize for the details.
+//
+// Usage: iconvg-optimize [flags] file...
+//
+// For each file, it prints the size, the number of ops and the decode time,
+// before and after optimizing. The decode time is the fastest of -reps
+// decodes by the Go decoder, at a height_in_pixels of -height. By default,
+// nothing is written: use -w to rewrite the files in place or -o to write a
+// single file's result elsewhere. -w only rewrites a file if optimizing made
+// it smaller without adding ops or making its decode time slower.
+package main
+
+import (
+	"errors"
+	"flag"
+	"fmt"
+	"os"
+	"time"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	heightFlag = flag.Int("height", 48, "height_in_pixels for Level of Detail queries when timing decodes")
+	oFlag      = flag.String("o", "", "write the (single) file's result to this path")
+	repsFlag   = flag.Int("reps", 100, "number of decodes to time; the fastest is reported")
+	wFlag      = flag.Bool("w", false, "rewrite the files in place, if optimizing made them smaller with no more ops and no slower decodes")
+)
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	flag.Usage = func() {
+		fmt.Fprintf(flag.CommandLine.Output(), "Usage: %s [flags] file...\n", os.Args[0])
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	if (flag.NArg() == 0) || (*repsFlag <= 0) {
+		flag.Usage()
+		os.Exit(2)
+	} else if *wFlag && (*oFlag != "") {
+		return errors.New("main: -w and -o are mutually exclusive")
+	} else if (*oFlag != "") && (flag.NArg() != 1) {
+		return errors.New("main: -o requires exactly one input file")
+	}
+
+	total := [2]result{}
+	for _, filename := range flag.Args() {
+		before, after, err := do(filename)
+		if err != nil {
+			return fmt.Errorf("main: %s: %w", filename, err)
+		}
+		fmt.Printf("%s\n", filename)
+		printDelta("bytes", int64(before.numBytes), int64(after.numBytes))
+		printDelta("ops", int64(before.numOps), int64(after.numOps))
+		printDelta("ns", before.decodeTime.Nanoseconds(), after.decodeTime.Nanoseconds())
+		total[0].add(before)
+		total[1].add(after)
+	}
+	if flag.NArg() > 1 {
+		fmt.Printf("total (%d files)\n", flag.NArg())
+		printDelta("bytes", int64(total[0].numBytes), int64(total[1].numBytes))
+		printDelta("ops", int64(total[0].numOps), int64(total[1].numOps))
+		printDelta("ns", total[0].decodeTime.Nanoseconds(), total[1].decodeTime.Nanoseconds())
+	}
+	return nil
+}
+
+type result struct {
+	numBytes   int
+	numOps     int
+	decodeTime time.Duration
+}
+
+func (r *result) add(s result) {
+	r.numBytes += s.numBytes
+	r.numOps += s.numOps
+	r.decodeTime += s.decodeTime
+}
+
+func do(filename string) (before result, after result, retErr error) {
+	src, err := os.ReadFile(filename)
+	if err != nil {
+		return result{}, result{}, err
+	}
+	dst, report, err := lowlevel.Optimize(src)
+	if err != nil {
+		return result{}, result{}, err
+	}
+	// Optimize does not check everything that the decoder does, such as
+	// colors, so check that both versions still decode.
+	if before.decodeTime, err = timeDecode(src); err != nil {
+		return result{}, result{}, err
+	} else if after.decodeTime, err = timeDecode(dst); err != nil {
+		return result{}, result{}, err
+	}
+	before.numBytes, before.numOps = len(src), report.NumOpsBefore
+	after.numBytes, after.numOps = len(dst), report.NumOpsAfter
+
+	if *oFlag != "" {
+		return before, after, os.WriteFile(*oFlag, dst, 0644)
+	} else if *wFlag && (len(dst) < len(src)) {
+		if after.numOps > before.numOps {
+			fmt.Printf("%s: not rewritten: more ops\n", filename)
+		} else if after.decodeTime > before.decodeTime {
+			fmt.Printf("%s: not rewritten: slower to decode\n", filename)
+		} else {
+			return before, after, os.WriteFile(filename, dst, 0644)
+		}
+	}
+	return before, after, nil
+}
+
+func timeDecode(src []byte) (time.Duration, error) {
+	best := time.Duration(0)
+	for i := 0; i < *repsFlag; i++ {
+		now := time.Now()
+		if err := lowlevel.Decode(&nopDestination{}, src, nil); err != nil {
+			return 0, err
+		}
+		if elapsed := time.Since(now); (i == 0) || (best > elapsed) {
+			best = elapsed
+		}
+	}
+	return best, nil
+}
+
+func printDelta(name string, before int64, after int64) {
+	percent := 0.0
+	if before != 0 {
+		percent = 100 * float64(after-before) / float64(before)
+	}
+	fmt.Printf("  %-6s %10d -> %10d  %+7.1f%%\n", name, before, after, percent)
+}
+
+// nopDestination is a lowlevel.Destination that discards its drawing ops.
+type nopDestination struct{}
+
+func (nopDestination) Reset(m lowlevel.Metadata) {}
+
+func (nopDestination) QueryLevelOfDetail(lod0, lod1 float32) bool {
+	h := float32(*heightFlag)
+	return (lod0 <= h) && (h < lod1)
+}
+
+func (nopDestination) ClosePathMoveTo(x, y float32)                           {}
+func (nopDestination) LineTo(x, y float32)                                    {}
+func (nopDestination) QuadTo(x1, y1, x, y float32)                            {}
+func (nopDestination) CubeTo(x1, y1, x2, y2, x, y float32)                    {}
+func (nopDestination) Ellipse(nQuarters uint32, x1, y1, x2, y2, x, y float32) {}
+func (nopDestination) Parallelogram(x1, y1, x2, y2, x, y float32)             {}
+func (nopDestination) ClosePathFill()                                         {}
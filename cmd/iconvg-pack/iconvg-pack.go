@@ -0,0 +1,235 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-pack bundles many IconVG files into a single IconVG pack file, which
+// the C library can open with one mmap (see iconvg_pack__open_mmap) and
+// search by name.
+//
+// Usage: iconvg-pack [flags] -o out.ivgpack dir-or-file...
+//
+// Directories are walked recursively, looking for files whose names end with
+// one of the -ext extensions (by default, only ".iconvg", as legacy ".ivg"
+// files are a different format). Their entry names are their slash-separated
+// paths relative to that directory. Files named explicitly are always
+// included, with their base name as their entry name.
+//
+// The -o file is only written once every input has been read and checked, so
+// a failed run leaves any previous pack in place. Without -o, the pack is
+// written to stdout, but a shell's "> out.ivgpack" redirection truncates that
+// file even if packing then fails.
+//
+// The pack format is documented alongside iconvg_pack in the C library's
+// public header.
+package main
+
+import (
+	"bytes"
+	"encoding/binary"
+	"flag"
+	"fmt"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	extFlag = flag.String("ext", ".iconvg", "comma-separated file name extensions to look for when walking directories")
+	oFlag   = flag.String("o", "", "write the pack to this path instead of stdout")
+)
+
+const (
+	packMagic         = "\x8AIVGpack"
+	packVersion       = 1
+	packHeaderSize    = 32
+	packEntrySize     = 32
+	packBlobAlignment = 4096
+)
+
+type entry struct {
+	name     string
+	hash     uint64
+	filename string
+}
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	flag.Usage = func() {
+		fmt.Fprintf(flag.CommandLine.Output(), "Usage: %s [flags] -o out.ivgpack dir-or-file...\n", os.Args[0])
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	if flag.NArg() == 0 {
+		flag.Usage()
+		os.Exit(2)
+	}
+	exts := strings.Split(*extFlag, ",")
+
+	entries := []entry(nil)
+	for _, arg := range flag.Args() {
+		err := filepath.WalkDir(arg, func(path string, d fs.DirEntry, err error) error {
+			if err != nil {
+				return err
+			} else if d.IsDir() {
+				return nil
+			}
+			name := filepath.Base(path)
+			if path != arg {
+				if !hasExtension(path, exts) {
+					return nil
+				}
+				rel, err := filepath.Rel(arg, path)
+				if err != nil {
+					return err
+				}
+				name = filepath.ToSlash(rel)
+			}
+			entries = append(entries, entry{name: name, hash: fnv1a64(name), filename: path})
+			return nil
+		})
+		if err != nil {
+			return err
+		}
+	}
+
+	sort.Slice(entries, func(i, j int) bool {
+		if entries[i].hash != entries[j].hash {
+			return entries[i].hash < entries[j].hash
+		}
+		return entries[i].name < entries[j].name
+	})
+	for i := 1; i < len(entries); i++ {
+		if entries[i-1].name == entries[i].name {
+			return fmt.Errorf("duplicate entry name %q (from %s and %s)",
+				entries[i].name, entries[i-1].filename, entries[i].filename)
+		}
+	}
+	if len(entries) > 0xFFFFFFFF {
+		return fmt.Errorf("too many entries")
+	}
+
+	// Lay out the header, index and names, then the 4096-byte aligned blobs.
+	names := []byte(nil)
+	nameOffsets := make([]uint32, len(entries))
+	namesStart := packHeaderSize + packEntrySize*len(entries)
+	for i, e := range entries {
+		nameOffsets[i] = uint32(namesStart + len(names))
+		names = append(names, e.name...)
+		names = append(names, 0)
+	}
+
+	blobs := []byte(nil)
+	blobsStart := alignUp(namesStart+len(names), packBlobAlignment)
+	index := make([]byte, packEntrySize*len(entries))
+	for i, e := range entries {
+		src, err := os.ReadFile(e.filename)
+		if err != nil {
+			return err
+		}
+		if _, err := lowlevel.DecodeMetadata(src); err != nil {
+			return fmt.Errorf("%s: %v", e.filename, err)
+		}
+		pad := alignUp(len(blobs), packBlobAlignment) - len(blobs)
+		blobs = append(blobs, make([]byte, pad)...)
+
+		x := index[packEntrySize*i:]
+		binary.LittleEndian.PutUint64(x[0:], e.hash)
+		binary.LittleEndian.PutUint64(x[8:], uint64(blobsStart+len(blobs)))
+		binary.LittleEndian.PutUint64(x[16:], uint64(len(src)))
+		binary.LittleEndian.PutUint32(x[24:], nameOffsets[i])
+		binary.LittleEndian.PutUint32(x[28:], uint32(len(e.name)))
+		blobs = append(blobs, src...)
+	}
+
+	buf := bytes.Buffer{}
+	header := [packHeaderSize]byte{}
+	copy(header[0:], packMagic)
+	binary.LittleEndian.PutUint32(header[8:], packVersion)
+	binary.LittleEndian.PutUint32(header[12:], uint32(len(entries)))
+	binary.LittleEndian.PutUint64(header[16:], packHeaderSize)
+	binary.LittleEndian.PutUint64(header[24:], uint64(blobsStart+len(blobs)))
+	buf.Write(header[:])
+	buf.Write(index)
+	buf.Write(names)
+	buf.Write(make([]byte, blobsStart-buf.Len()))
+	buf.Write(blobs)
+	if *oFlag == "" {
+		_, err := os.Stdout.Write(buf.Bytes())
+		return err
+	}
+	return writeFileAtomically(*oFlag, buf.Bytes())
+}
+
+// writeFileAtomically writes data to a temporary file in filename's directory
+// and then renames it to filename, so that filename is never left partially
+// written.
+func writeFileAtomically(filename string, data []byte) error {
+	f, err := os.CreateTemp(filepath.Dir(filename), ".iconvg-pack-*")
+	if err != nil {
+		return err
+	}
+	tmp := f.Name()
+	if _, err := f.Write(data); err != nil {
+		f.Close()
+		os.Remove(tmp)
+		return err
+	}
+	if err := f.Close(); err != nil {
+		os.Remove(tmp)
+		return err
+	}
+	if err := os.Chmod(tmp, 0644); err != nil {
+		os.Remove(tmp)
+		return err
+	}
+	if err := os.Rename(tmp, filename); err != nil {
+		os.Remove(tmp)
+		return err
+	}
+	return nil
+}
+
+func alignUp(n int, alignment int) int {
+	return (n + alignment - 1) &^ (alignment - 1)
+}
+
+// fnv1a64 is the 64-bit FNV-1a hash, as used by iconvg_pack__find.
+func fnv1a64(s string) uint64 {
+	h := uint64(0xCBF29CE484222325)
+	for i := 0; i < len(s); i++ {
+		h ^= uint64(s[i])
+		h *= 0x00000100000001B3
+	}
+	return h
+}
+
+func hasExtension(path string, exts []string) bool {
+	for _, ext := range exts {
+		if (ext != "") && strings.HasSuffix(path, ext) {
+			return true
+		}
+	}
+	return false
+}
@@ -0,0 +1,74 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-specialize strips an IconVG file down to what it draws at a single
+// height_in_pixels, removing the Level of Detail branches not taken at that
+// height and the Jump ops themselves. See lowlevel.Specialize for the
+// details.
+//
+// Usage: iconvg-specialize -height=N input.iconvg > output.iconvg
+//
+// Decoding the output at that height produces the same canvas calls as
+// decoding the input. At other heights, it may not.
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	heightFlag = flag.Int64("height", 0, "the height_in_pixels to specialize for (required)")
+)
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	flag.Usage = func() {
+		fmt.Fprintf(flag.CommandLine.Output(), "Usage: %s -height=N input.iconvg > output.iconvg\n", os.Args[0])
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	hasHeight := false
+	flag.Visit(func(f *flag.Flag) {
+		hasHeight = hasHeight || (f.Name == "height")
+	})
+	if !hasHeight || (flag.NArg() != 1) {
+		flag.Usage()
+		os.Exit(2)
+	}
+
+	src, err := os.ReadFile(flag.Arg(0))
+	if err != nil {
+		return err
+	}
+	data, report, err := lowlevel.Specialize(src, *heightFlag)
+	if err != nil {
+		return fmt.Errorf("%s: %v", flag.Arg(0), err)
+	}
+	fmt.Fprintf(os.Stderr, "%s: %d -> %d bytes, %d -> %d ops\n", flag.Arg(0),
+		len(src), len(data), report.NumOpsBefore, report.NumOpsAfter)
+	_, err = os.Stdout.Write(data)
+	return err
+}
@@ -0,0 +1,138 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-stats prints aggregate statistics over a corpus of IconVG files:
+// opcode class frequencies, coordinate and natural number encoding widths,
+// reps per LineTo / QuadTo / CubeTo op, gradient stop counts, Level of Detail
+// ranges and drawings (Fill ops) per file.
+//
+// Usage: iconvg-stats [flags] dir-or-file... > out.json
+//
+// Directories are walked recursively, looking for files whose names end with
+// one of the -ext extensions. Files named explicitly are always read. The
+// files are decoded concurrently, by -j worker goroutines.
+package main
+
+import (
+	"flag"
+	"fmt"
+	"io/fs"
+	"os"
+	"path/filepath"
+	"runtime"
+	"strings"
+	"sync"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	extFlag    = flag.String("ext", ".iconvg,.ivg", "comma-separated file name extensions to look for when walking directories")
+	formatFlag = flag.String("format", "json", "output format: json or csv")
+	jFlag      = flag.Int("j", runtime.NumCPU(), "number of worker goroutines")
+)
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	flag.Usage = func() {
+		fmt.Fprintf(flag.CommandLine.Output(), "Usage: %s [flags] dir-or-file... > out.json\n", os.Args[0])
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	if (flag.NArg() == 0) || (*jFlag <= 0) ||
+		((*formatFlag != "json") && (*formatFlag != "csv")) {
+		flag.Usage()
+		os.Exit(2)
+	}
+	exts := strings.Split(*extFlag, ",")
+
+	filenames := make(chan string, 1024)
+	results := make([]lowlevel.Stats, *jFlag)
+	readErrs := make([]error, *jFlag)
+	wg := sync.WaitGroup{}
+	for i := range results {
+		wg.Add(1)
+		go func(s *lowlevel.Stats, readErr *error) {
+			defer wg.Done()
+			for filename := range filenames {
+				src, err := os.ReadFile(filename)
+				if err != nil {
+					if *readErr == nil {
+						*readErr = err
+					}
+					continue
+				}
+				// Invalid files are tallied by s, not treated as fatal.
+				s.Add(src)
+			}
+		}(&results[i], &readErrs[i])
+	}
+
+	walkErr := error(nil)
+	for _, arg := range flag.Args() {
+		walkErr = filepath.WalkDir(arg, func(path string, d fs.DirEntry, err error) error {
+			if err != nil {
+				return err
+			} else if d.IsDir() {
+				return nil
+			} else if path != arg {
+				if !hasExtension(path, exts) {
+					return nil
+				}
+			}
+			filenames <- path
+			return nil
+		})
+		if walkErr != nil {
+			break
+		}
+	}
+	close(filenames)
+	wg.Wait()
+
+	if walkErr != nil {
+		return walkErr
+	}
+	for _, err := range readErrs {
+		if err != nil {
+			return err
+		}
+	}
+
+	total := &results[0]
+	for i := 1; i < len(results); i++ {
+		total.Merge(&results[i])
+	}
+	if *formatFlag == "csv" {
+		return total.WriteCSV(os.Stdout)
+	}
+	return total.WriteJSON(os.Stdout)
+}
+
+func hasExtension(path string, exts []string) bool {
+	for _, ext := range exts {
+		if (ext != "") && strings.HasSuffix(path, ext) {
+			return true
+		}
+	}
+	return false
+}
@@ -0,0 +1,96 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-synthesize generates a synthetic IconVG file, for stress tests and
+// benchmarks, whose size and structure are controlled by flags.
+//
+// Usage: iconvg-synthesize [flags] > out.iconvg
+//
+// For example, to chart decode cost versus file size:
+//
+//	for n in 1 10 100 1000; do
+//	  iconvg-synthesize -drawings=$n -segments=64 > gen/synth-$n.iconvg
+//	done
+//	gen/bin/iconvg-bench-with-cairo gen/synth-*.iconvg
+package main
+
+import (
+	"flag"
+	"fmt"
+	"os"
+	"strconv"
+	"strings"
+
+	"github.com/google/iconvg/src/go/lowlevel"
+)
+
+var (
+	callsFlag    = flag.Int("calls", 0, "number of Call ops at the start of each drawing")
+	callLenFlag  = flag.Int("call-length", 16, "number of bytes in each Call op's inline segment")
+	coordsFlag   = flag.String("coordinate-widths", "1", "comma-separated coordinate number encoding widths (1, 2 or 4 bytes) to cycle through")
+	drawingsFlag = flag.Int("drawings", 1, "number of drawings (fills)")
+	lodFlag      = flag.Int("lod-depth", 0, "number of nested LODJumps around each drawing")
+	pathsFlag    = flag.Int("paths", 1, "number of paths per drawing")
+	regsFlag     = flag.Int("register-run", 0, "number of extra registers written before each fill")
+	seedFlag     = flag.Int64("seed", 1, "pseudo-random number generator seed")
+	segsFlag     = flag.Int("segments", 8, "number of segments per path")
+	stopsFlag    = flag.Int("stops", 0, "number of gradient stops per fill (0 means flat colors)")
+)
+
+func main() {
+	if err := main1(); err != nil {
+		os.Stderr.WriteString(err.Error() + "\n")
+		os.Exit(1)
+	}
+}
+
+func main1() error {
+	flag.Usage = func() {
+		fmt.Fprintf(flag.CommandLine.Output(), "Usage: %s [flags] > out.iconvg\n", os.Args[0])
+		flag.PrintDefaults()
+	}
+	flag.Parse()
+	if flag.NArg() != 0 {
+		flag.Usage()
+		os.Exit(2)
+	}
+
+	opts := &lowlevel.SynthesizeOptions{
+		NumDrawings:        *drawingsFlag,
+		NumPathsPerDrawing: *pathsFlag,
+		NumSegmentsPerPath: *segsFlag,
+		NumGradientStops:   *stopsFlag,
+		LODDepth:           *lodFlag,
+		RegisterRunLength:  *regsFlag,
+		NumCallsPerDrawing: *callsFlag,
+		CallSegmentLength:  *callLenFlag,
+		Seed:               *seedFlag,
+	}
+	for _, s := range strings.Split(*coordsFlag, ",") {
+		w, err := strconv.Atoi(strings.TrimSpace(s))
+		if err != nil {
+			return fmt.Errorf("invalid -coordinate-widths: %v", err)
+		}
+		opts.CoordinateWidths = append(opts.CoordinateWidths, w)
+	}
+
+	data, err := lowlevel.Synthesize(opts)
+	if err != nil {
+		return err
+	}
+	_, err = os.Stdout.Write(data)
+	return err
+}
@@ -0,0 +1,1039 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-bench measures how long it takes to decode and render IconVG files.
+//
+// Usage: iconvg-bench [flags] [file.iconvg|directory ...]
+//     If no files or directories are given, it reads test/data/*.iconvg and
+//     adds the -quads fixture. Directories are scanned (non-recursively) for
+//     *.iconvg files.
+//
+// Flags:
+//     -benchtime=N     Target duration (in milliseconds) of each benchmark.
+//                      Defaults to 100.
+//     -heights=A,B,C   Comma-separated rendering heights (in pixels). The
+//                      width is derived from each file's ViewBox aspect ratio.
+//                      Defaults to 16,32,64,256.
+//     -json            Print the results as JSON instead of as a table.
+//     -quads           Also measure a built-in, QuadTo-heavy fixture (named
+//                      "(built-in quads)"), generated with iconvg_encoder.
+//
+// Each file is measured in these modes:
+//     validate iconvg_validate, which checks the file without decoding it. As
+//              this doesn't depend on the rendering height, it is measured
+//              once per file and once more over all of the files, back to
+//              back, as a single corpus.
+//     decode   iconvg_decode with a broken (NULL error message) canvas, which
+//              measures the bytecode interpreter on its own.
+//     bounds   iconvg_decode with a canvas that only computes the bounding box
+//              of the path points: a lightweight but non-trivial backend.
+//     render   iconvg_decode with the compiled-in raster backend (Cairo or
+//              Skia), re-drawing onto the same pixel buffer. This mode is
+//              skipped if no backend was configured.
+//
+// For each file, mode and height, it reports the nanoseconds per op (where an
+// op is one iconvg_decode or iconvg_validate call, or for the corpus, one
+// call per file), nanoseconds per input byte, nanoseconds per bytecode opcode
+// (counting every opcode in the file, as iconvg_validate does, even those that
+// a jump skips over), throughput in GB/s, ops per second and heap
+// allocations per op. Allocations are only counted when using glibc,
+// where this program interposes malloc, calloc, realloc, posix_memalign,
+// aligned_alloc and memalign. That covers the backend libraries' allocations
+// too, as long as they're dynamically linked. Other allocators (e.g. C++'s
+// operator new, when libstdc++ is statically linked, or direct mmap calls)
+// are not counted.
+//
+// Synthetic files (e.g. from cmd/iconvg-synthesize) can be benchmarked by
+// passing their file or directory names as arguments.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+// MAX_HEIGHTS is the maximum number of -heights=etc values.
+#define MAX_HEIGHTS 16
+
+struct {
+  uint64_t benchtime_nanos;
+  uint32_t heights[MAX_HEIGHTS];
+  size_t num_heights;
+  bool json;
+  bool quads;
+} g_flags;
+
+// ----
+
+// Allocation counting.
+//
+// With glibc, we interpose the malloc family, forwarding to the __libc_etc
+// implementations. Elsewhere, g_num_allocs stays at zero and the allocs/op
+// column says "-".
+
+uint64_t g_num_allocs = 0;
+
+#if defined(__GLIBC__) && !defined(ICONVG_BENCH_DISABLE_ALLOCATION_COUNTING)
+
+#define HAVE_ALLOCATION_COUNTING true
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+void*  //
+malloc(size_t size) {
+  g_num_allocs++;
+  return __libc_malloc(size);
+}
+
+void*  //
+calloc(size_t nmemb, size_t size) {
+  g_num_allocs++;
+  return __libc_calloc(nmemb, size);
+}
+
+void*  //
+realloc(void* ptr, size_t size) {
+  g_num_allocs++;
+  return __libc_realloc(ptr, size);
+}
+
+// posix_memalign, aligned_alloc and memalign check their alignment argument
+// the way glibc's own versions do, before forwarding to __libc_memalign.
+
+int  //
+posix_memalign(void** memptr, size_t alignment, size_t size) {
+  g_num_allocs++;
+  if ((alignment == 0) || (alignment & (alignment - 1)) ||
+      (alignment % sizeof(void*))) {
+    return EINVAL;
+  }
+  void* ptr = __libc_memalign(alignment, size);
+  if (!ptr) {
+    return ENOMEM;
+  }
+  *memptr = ptr;
+  return 0;
+}
+
+void*  //
+aligned_alloc(size_t alignment, size_t size) {
+  g_num_allocs++;
+  if ((alignment == 0) || (alignment & (alignment - 1))) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return __libc_memalign(alignment, size);
+}
+
+void*  //
+memalign(size_t alignment, size_t size) {
+  g_num_allocs++;
+  return __libc_memalign(alignment, size);
+}
+
+void  //
+free(void* ptr) {
+  __libc_free(ptr);
+}
+
+#else
+
+#define HAVE_ALLOCATION_COUNTING false
+
+#endif
+
+// ----
+
+uint64_t  //
+monotonic_nanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return 0;
+  }
+  return (((uint64_t)(ts.tv_sec)) * 1000000000) + ((uint64_t)(ts.tv_nsec));
+}
+
+// ----
+
+// The bounds canvas computes the bounding box of all of the (on-curve and
+// off-curve) path points, in dst coordinate space. It is a conservative
+// bounding box for the curves themselves.
+
+typedef struct {
+  float min_x;
+  float min_y;
+  float max_x;
+  float max_y;
+  uint64_t num_points;
+} bounds;
+
+static inline void  //
+bounds__add(bounds* b, float x, float y) {
+  if (b->num_points++ == 0) {
+    b->min_x = x;
+    b->min_y = y;
+    b->max_x = x;
+    b->max_y = y;
+    return;
+  }
+  if (b->min_x > x) {
+    b->min_x = x;
+  } else if (b->max_x < x) {
+    b->max_x = x;
+  }
+  if (b->min_y > y) {
+    b->min_y = y;
+  } else if (b->max_y < y) {
+    b->max_y = y;
+  }
+}
+
+const char*  //
+bounds_canvas__begin_decode(iconvg_canvas* c, iconvg_rectangle_f32 dst_rect) {
+  bounds* b = (bounds*)(c->context.nonconst_ptr1);
+  b->num_points = 0;
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__end_decode(iconvg_canvas* c,
+                          const char* err_msg,
+                          size_t num_bytes_consumed,
+                          size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+const char*  //
+bounds_canvas__begin_drawing(iconvg_canvas* c) {
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__end_drawing(iconvg_canvas* c, const iconvg_paint* p) {
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  bounds__add((bounds*)(c->context.nonconst_ptr1), x0, y0);
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__end_path(iconvg_canvas* c) {
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
+  bounds__add((bounds*)(c->context.nonconst_ptr1), x1, y1);
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__path_quad_to(iconvg_canvas* c,
+                            float x1,
+                            float y1,
+                            float x2,
+                            float y2) {
+  bounds* b = (bounds*)(c->context.nonconst_ptr1);
+  bounds__add(b, x1, y1);
+  bounds__add(b, x2, y2);
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__path_cube_to(iconvg_canvas* c,
+                            float x1,
+                            float y1,
+                            float x2,
+                            float y2,
+                            float x3,
+                            float y3) {
+  bounds* b = (bounds*)(c->context.nonconst_ptr1);
+  bounds__add(b, x1, y1);
+  bounds__add(b, x2, y2);
+  bounds__add(b, x3, y3);
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                   iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+const char*  //
+bounds_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
+
+const iconvg_canvas_vtable bounds_canvas_vtable = {
+    sizeof(iconvg_canvas_vtable),
+    &bounds_canvas__begin_decode,
+    &bounds_canvas__end_decode,
+    &bounds_canvas__begin_drawing,
+    &bounds_canvas__end_drawing,
+    &bounds_canvas__begin_path,
+    &bounds_canvas__end_path,
+    &bounds_canvas__path_line_to,
+    &bounds_canvas__path_quad_to,
+    &bounds_canvas__path_cube_to,
+    &bounds_canvas__on_metadata_viewbox,
+    &bounds_canvas__on_metadata_suggested_palette,
+    NULL,  // begin_path__fixed
+    NULL,  // path_line_to__fixed
+    NULL,  // path_quad_to__fixed
+    NULL,  // path_cube_to__fixed
+};
+
+iconvg_canvas  //
+make_bounds_canvas(bounds* b) {
+  iconvg_canvas c;
+  c.vtable = &bounds_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = b;
+  return c;
+}
+
+// ----
+
+// A raster_canvas is a backend-specific pixel buffer and the iconvg_canvas
+// that draws onto it.
+
+typedef struct {
+  iconvg_canvas canvas;
+  void* extra0;
+  void* extra1;
+} raster_canvas;
+
+#if defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+
+#include <cairo/cairo.h>
+
+#define BACKEND_NAME "cairo"
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  cairo_surface_t* cs =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)width, (int)height);
+  if (cairo_surface_status(cs) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(cs);
+    return "main: could not create cairo_surface_t";
+  }
+  cairo_t* cr = cairo_create(cs);
+
+  *rc = ((raster_canvas){0});
+  rc->canvas = iconvg_canvas__make_cairo(cr);
+  rc->extra0 = cs;
+  rc->extra1 = cr;
+  return NULL;
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {
+  if (rc->extra1) {
+    cairo_destroy((cairo_t*)(rc->extra1));
+    rc->extra1 = NULL;
+  }
+  if (rc->extra0) {
+    cairo_surface_destroy((cairo_surface_t*)(rc->extra0));
+    rc->extra0 = NULL;
+  }
+}
+
+#elif defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+
+#include "include/c/sk_imageinfo.h"
+#include "include/c/sk_surface.h"
+
+#define BACKEND_NAME "skia"
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  uint8_t* data = (uint8_t*)(malloc(4 * width * height));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+  sk_imageinfo_t* si =
+      sk_imageinfo_new((int)width, (int)height, BGRA_8888_SK_COLORTYPE,
+                       PREMUL_SK_ALPHATYPE, NULL);
+  if (!si) {
+    free(data);
+    return "main: could not create sk_imageinfo_t";
+  }
+  sk_surface_t* ss = sk_surface_new_raster_direct(si, data, 4 * width, NULL);
+  sk_imageinfo_delete(si);
+  if (!ss) {
+    free(data);
+    return "main: could not create sk_surface_t";
+  }
+  sk_canvas_t* sc = sk_surface_get_canvas(ss);
+  if (!sc) {
+    sk_surface_unref(ss);
+    free(data);
+    return "main: could not create sk_canvas_t";
+  }
+
+  *rc = ((raster_canvas){0});
+  rc->canvas = iconvg_canvas__make_skia(sc);
+  rc->extra0 = ss;
+  rc->extra1 = data;
+  return NULL;
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {
+  if (rc->extra0) {
+    sk_surface_unref((sk_surface_t*)(rc->extra0));
+    rc->extra0 = NULL;
+  }
+  if (rc->extra1) {
+    free(rc->extra1);
+    rc->extra1 = NULL;
+  }
+}
+
+#else  //  ICONVG_CONFIG__ETC
+
+#define BACKEND_NAME NULL
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  return "main: no IconVG backend configured";
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {}
+
+#endif  //  ICONVG_CONFIG__ETC
+
+// ----
+
+typedef struct {
+  char* filename;
+  iconvg_file file;
+  iconvg_rectangle_f32 viewbox;
+  uint64_t num_opcodes;
+} source_file;
+
+source_file* g_sources = NULL;
+size_t g_num_sources = 0;
+size_t g_cap_sources = 0;
+
+// add_source_bytes adds file, taking ownership of it, as filename.
+bool  //
+add_source_bytes(const char* filename, iconvg_file file) {
+  iconvg_rectangle_f32 viewbox = {0};
+  const char* err_msg = iconvg_decode_viewbox(&viewbox, file.ptr, file.len);
+  if (err_msg) {
+    fprintf(stderr, "main: could not decode %s\n%s\n", filename, err_msg);
+    iconvg_file__close(&file);
+    return false;
+  }
+
+  if (g_num_sources == g_cap_sources) {
+    size_t new_cap = g_cap_sources ? (2 * g_cap_sources) : 64;
+    source_file* new_sources =
+        realloc(g_sources, new_cap * sizeof(source_file));
+    if (!new_sources) {
+      fprintf(stderr, "main: out of memory\n");
+      iconvg_file__close(&file);
+      return false;
+    }
+    g_sources = new_sources;
+    g_cap_sources = new_cap;
+  }
+  source_file* s = &g_sources[g_num_sources++];
+  s->filename = strdup(filename);
+  s->file = file;
+  s->viewbox = viewbox;
+  // An invalid file's num_ops only counts the opcodes before the error, but
+  // the validate mode will report that error anyway.
+  iconvg_validate_report report = {0};
+  iconvg_validate(file.ptr, file.len, &report);
+  s->num_opcodes = report.num_ops;
+  return s->filename != NULL;
+}
+
+bool  //
+add_source_file(const char* filename) {
+  iconvg_file file;
+  const char* err_msg = iconvg_file__open(&file, filename, NULL);
+  if (err_msg) {
+    fprintf(stderr, "main: could not read %s\n%s\n", filename, err_msg);
+    return false;
+  }
+  return add_source_bytes(filename, file);
+}
+
+const char*  //
+grow_with_realloc(void* grow_context,
+                  uint8_t** ptr,
+                  size_t* cap,
+                  size_t min_cap) {
+  size_t new_cap = (*cap > 4096) ? *cap : 4096;
+  while (new_cap < min_cap) {
+    new_cap *= 2;
+  }
+  uint8_t* new_ptr = (uint8_t*)(realloc(*ptr, new_cap));
+  if (!new_ptr) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  *ptr = new_ptr;
+  *cap = new_cap;
+  return NULL;
+}
+
+// QUADS_FIXTURE_NAME names the built-in quad-heavy fixture. The test data's
+// icons are mostly LineTo and CubeTo segments, so this fixture gives QuadTo a
+// measurable share of the render time: for example, of the raster backend's
+// conversion of quadratic Bézier curves to cubic ones.
+#define QUADS_FIXTURE_NAME "(built-in quads)"
+
+// add_scalloped_square writes a closed path around the square with center
+// (cx, cy) and half-width h, each of whose sides is n QuadTo segments that
+// bulge outwards. reverse reverses the winding.
+void  //
+add_scalloped_square(iconvg_encoder* e,
+                     double cx,
+                     double cy,
+                     double h,
+                     int n,
+                     bool reverse) {
+  double xs[5] = {cx - h, cx + h, cx + h, cx - h, cx - h};
+  double ys[5] = {cy - h, cy - h, cy + h, cy + h, cy - h};
+  if (reverse) {
+    xs[1] = cx - h;
+    ys[1] = cy + h;
+    xs[3] = cx + h;
+    ys[3] = cy - h;
+  }
+  iconvg_encoder__move_to(e, (float)(xs[0]), (float)(ys[0]));
+  for (int side = 0; side < 4; side++) {
+    double dx = (xs[side + 1] - xs[side]) / n;
+    double dy = (ys[side + 1] - ys[side]) / n;
+    // (nx, ny) is perpendicular to the side, pointing away from the center.
+    double nx = dy / 2;
+    double ny = -dx / 2;
+    double mx = ((xs[side] + xs[side + 1]) / 2) - cx;
+    double my = ((ys[side] + ys[side + 1]) / 2) - cy;
+    if (((mx * nx) + (my * ny)) < 0) {
+      nx = -nx;
+      ny = -ny;
+    }
+    for (int i = 1; i <= n; i++) {
+      double x = xs[side] + (i * dx);
+      double y = ys[side] + (i * dy);
+      iconvg_encoder__quad_to(e, (float)(x - (dx / 2) + nx),
+                              (float)(y - (dy / 2) + ny), (float)x, (float)y);
+    }
+  }
+}
+
+// add_quads_fixture adds QUADS_FIXTURE_NAME: 16 scalloped square rings, with
+// 96 QuadTo segments per ring.
+bool  //
+add_quads_fixture() {
+  iconvg_encoder e;
+  iconvg_encoder__initialize(&e, NULL, 0, &grow_with_realloc, NULL);
+  iconvg_encoder__write_metadata(&e, NULL, NULL);
+  for (int i = 0; i < 16; i++) {
+    double cx = -24 + (16 * (i % 4));
+    double cy = -24 + (16 * (i / 4));
+    add_scalloped_square(&e, cx, cy, 6, 16, false);
+    add_scalloped_square(&e, cx, cy, 3, 8, true);
+    iconvg_premul_color c = {{(uint8_t)(0x11 * i), 0x80, 0xC0, 0xFF}};
+    iconvg_encoder__fill_flat_color(&e, c);
+  }
+  const char* err_msg = iconvg_encoder__finish(&e);
+  if (err_msg) {
+    fprintf(stderr, "main: could not encode %s\n%s\n", QUADS_FIXTURE_NAME,
+            err_msg);
+    free(e.ptr);
+    return false;
+  }
+  // A NULL allocator's memory is released with free, so file can own the
+  // realloc'ed buffer.
+  iconvg_file file = {0};
+  file.ptr = e.ptr;
+  file.len = e.len;
+  file.cap = e.cap;
+  return add_source_bytes(QUADS_FIXTURE_NAME, file);
+}
+
+bool  //
+has_iconvg_suffix(const char* s) {
+  size_t n = strlen(s);
+  return (n >= 7) && !strcmp(s + n - 7, ".iconvg");
+}
+
+int  //
+compare_strings(const void* a, const void* b) {
+  return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+bool  //
+add_source_directory(const char* dirname) {
+  DIR* d = opendir(dirname);
+  if (!d) {
+    fprintf(stderr, "main: could not open %s: %s\n", dirname, strerror(errno));
+    return false;
+  }
+
+  // Collect and sort the names, so that the output order is deterministic.
+  char** names = NULL;
+  size_t num_names = 0;
+  size_t cap_names = 0;
+  bool ok = true;
+  for (struct dirent* e = readdir(d); e; e = readdir(d)) {
+    if (!has_iconvg_suffix(e->d_name)) {
+      continue;
+    }
+    if (num_names == cap_names) {
+      cap_names = cap_names ? (2 * cap_names) : 64;
+      char** new_names = realloc(names, cap_names * sizeof(char*));
+      if (!new_names) {
+        ok = false;
+        break;
+      }
+      names = new_names;
+    }
+    size_t dirname_len = strlen(dirname);
+    const char* sep =
+        (dirname_len && (dirname[dirname_len - 1] == '/')) ? "" : "/";
+    size_t n = dirname_len + 1 + strlen(e->d_name) + 1;
+    names[num_names] = malloc(n);
+    if (!names[num_names]) {
+      ok = false;
+      break;
+    }
+    snprintf(names[num_names++], n, "%s%s%s", dirname, sep, e->d_name);
+  }
+  closedir(d);
+
+  if (ok) {
+    qsort(names, num_names, sizeof(char*), &compare_strings);
+    for (size_t i = 0; ok && (i < num_names); i++) {
+      ok = add_source_file(names[i]);
+    }
+  } else {
+    fprintf(stderr, "main: out of memory\n");
+  }
+  for (size_t i = 0; i < num_names; i++) {
+    free(names[i]);
+  }
+  free(names);
+  return ok;
+}
+
+bool  //
+add_source(const char* name) {
+  DIR* d = opendir(name);
+  if (d) {
+    closedir(d);
+    return add_source_directory(name);
+  }
+  return add_source_file(name);
+}
+
+// ----
+
+typedef struct {
+  const char* filename;
+  const char* mode;
+  uint32_t width;
+  uint32_t height;
+  size_t num_bytes;
+  uint64_t num_iters;
+  double ns_per_op;
+  double ns_per_byte;
+  double ns_per_opcode;
+  double gb_per_sec;
+  double ops_per_sec;
+  double allocs_per_op;
+} result;
+
+// run_benchmark calls iconvg_decode (or, if c is NULL, iconvg_validate) on
+// each of the num_sources files, num_iters times, returning the elapsed
+// nanoseconds, or 0 on error.
+uint64_t  //
+run_benchmark(const char** err_msg,
+              iconvg_canvas* c,
+              const source_file* sources,
+              size_t num_sources,
+              iconvg_rectangle_f32 dst_rect,
+              uint64_t num_iters) {
+  uint64_t start = monotonic_nanos();
+  for (uint64_t i = 0; i < num_iters; i++) {
+    for (size_t j = 0; j < num_sources; j++) {
+      const source_file* s = &sources[j];
+      *err_msg = c ? iconvg_decode(c, dst_rect, s->file.ptr, s->file.len, NULL)
+                   : iconvg_validate(s->file.ptr, s->file.len, NULL);
+      if (*err_msg) {
+        return 0;
+      }
+    }
+  }
+  uint64_t elapsed = monotonic_nanos() - start;
+  return elapsed ? elapsed : 1;
+}
+
+// benchmark is like run_benchmark but picks num_iters so that the total
+// elapsed time is roughly g_flags.benchtime_nanos, like Go's "testing"
+// package does.
+const char*  //
+benchmark(result* r,
+          iconvg_canvas* c,
+          const source_file* sources,
+          size_t num_sources,
+          const char* filename,
+          const char* mode,
+          uint32_t width,
+          uint32_t height) {
+  iconvg_rectangle_f32 dst_rect =
+      iconvg_rectangle_f32__make(0, 0, (float)width, (float)height);
+  const char* err_msg = NULL;
+  size_t num_bytes = 0;
+  uint64_t num_opcodes = 0;
+  for (size_t j = 0; j < num_sources; j++) {
+    num_bytes += sources[j].file.len;
+    num_opcodes += sources[j].num_opcodes;
+  }
+
+  // Warm up (and check for decoding errors) before measuring.
+  if (!run_benchmark(&err_msg, c, sources, num_sources, dst_rect, 1)) {
+    return err_msg;
+  }
+
+  uint64_t num_iters = 1;
+  uint64_t elapsed = 0;
+  uint64_t num_allocs = 0;
+  while (true) {
+    uint64_t allocs_before = g_num_allocs;
+    elapsed =
+        run_benchmark(&err_msg, c, sources, num_sources, dst_rect, num_iters);
+    if (!elapsed) {
+      return err_msg;
+    }
+    num_allocs = g_num_allocs - allocs_before;
+    if ((elapsed >= g_flags.benchtime_nanos) || (num_iters >= 1000000000)) {
+      break;
+    }
+    // Aim 20% past the target, growing by at least 1x and at most 100x.
+    double predicted = 1.2 * ((double)num_iters) *
+                       ((double)g_flags.benchtime_nanos) / ((double)elapsed);
+    uint64_t next = (uint64_t)predicted;
+    if (next <= num_iters) {
+      next = num_iters + 1;
+    } else if (next > (100 * num_iters)) {
+      next = 100 * num_iters;
+    }
+    num_iters = next;
+  }
+
+  uint64_t num_ops = num_iters * ((uint64_t)num_sources);
+  r->filename = filename;
+  r->mode = mode;
+  r->width = width;
+  r->height = height;
+  r->num_bytes = num_bytes;
+  r->num_iters = num_iters;
+  r->ns_per_op = ((double)elapsed) / ((double)num_ops);
+  r->ns_per_byte =
+      num_bytes ? (((double)elapsed) / ((double)num_iters * num_bytes)) : 0;
+  r->ns_per_opcode =
+      num_opcodes ? (((double)elapsed) / ((double)num_iters * num_opcodes))
+                  : 0;
+  r->gb_per_sec = (r->ns_per_byte > 0) ? (1 / r->ns_per_byte) : 0;
+  r->ops_per_sec = 1e9 / r->ns_per_op;
+  r->allocs_per_op = ((double)num_allocs) / ((double)num_ops);
+  return NULL;
+}
+
+// ----
+
+void  //
+print_json_string(const char* s) {
+  putchar('"');
+  for (; *s; s++) {
+    unsigned char c = (unsigned char)(*s);
+    if ((c == '"') || (c == '\\')) {
+      printf("\\%c", c);
+    } else if (c < 0x20) {
+      printf("\\u%04X", c);
+    } else {
+      putchar(c);
+    }
+  }
+  putchar('"');
+}
+
+void  //
+print_result(const result* r, bool first) {
+  if (g_flags.json) {
+    printf("%s\n    {\"file\": ", first ? "" : ",");
+    print_json_string(r->filename);
+    printf(
+        ", \"mode\": \"%s\", \"width\": %u, \"height\": %u"
+        ", \"num_bytes\": %zu, \"num_iters\": %llu, \"ns_per_op\": %.1f"
+        ", \"ns_per_byte\": %.3f, \"ns_per_opcode\": %.3f"
+        ", \"gb_per_sec\": %.3f, \"ops_per_sec\": %.1f",
+        r->mode, r->width, r->height, r->num_bytes,
+        (unsigned long long)(r->num_iters), r->ns_per_op, r->ns_per_byte,
+        r->ns_per_opcode, r->gb_per_sec, r->ops_per_sec);
+    if (HAVE_ALLOCATION_COUNTING) {
+      printf(", \"allocs_per_op\": %.2f}", r->allocs_per_op);
+    } else {
+      printf(", \"allocs_per_op\": null}");
+    }
+    return;
+  }
+
+  if (first) {
+    printf("%-40s %-8s %11s %9s %11s %13s %10s %10s %8s %12s %10s\n",
+           "file", "mode", "size", "bytes", "iters", "ns/op", "ns/byte",
+           "ns/opcode", "GB/s", "ops/sec", "allocs/op");
+  }
+  char size[32];
+  if (r->height) {
+    snprintf(size, sizeof(size), "%ux%u", r->width, r->height);
+  } else {
+    snprintf(size, sizeof(size), "-");
+  }
+  printf("%-40s %-8s %11s %9zu %11llu %13.1f %10.3f %10.3f %8.3f %12.1f",
+         r->filename, r->mode, size, r->num_bytes,
+         (unsigned long long)(r->num_iters), r->ns_per_op, r->ns_per_byte,
+         r->ns_per_opcode, r->gb_per_sec, r->ops_per_sec);
+  if (HAVE_ALLOCATION_COUNTING) {
+    printf(" %10.2f\n", r->allocs_per_op);
+  } else {
+    printf(" %10s\n", "-");
+  }
+}
+
+// ----
+
+const char*  //
+parse_heights(const char* s) {
+  g_flags.num_heights = 0;
+  while (*s) {
+    if (g_flags.num_heights >= MAX_HEIGHTS) {
+      return "main: too many -heights values";
+    }
+    char* end = NULL;
+    unsigned long h = strtoul(s, &end, 10);
+    if ((end == s) || (h == 0) || (h > 0x7FFF)) {
+      return "main: invalid -heights value";
+    }
+    g_flags.heights[g_flags.num_heights++] = (uint32_t)h;
+    s = end;
+    if (*s == ',') {
+      s++;
+    } else if (*s) {
+      return "main: invalid -heights value";
+    }
+  }
+  return g_flags.num_heights ? NULL : "main: empty -heights value";
+}
+
+const char*  //
+parse_flags(int* argc, char** argv) {
+  g_flags.benchtime_nanos = 100 * 1000000;
+  parse_heights("16,32,64,256");
+
+  int n = 1;
+  for (int i = 1; i < *argc; i++) {
+    const char* arg = argv[i];
+    if ((arg[0] != '-') || !strcmp(arg, "-")) {
+      argv[n++] = argv[i];
+      continue;
+    } else if (!strcmp(arg, "--")) {
+      for (i++; i < *argc; i++) {
+        argv[n++] = argv[i];
+      }
+      break;
+    }
+    if (arg[1] == '-') {
+      arg++;
+    }
+    if (!strncmp(arg, "-benchtime=", 11)) {
+      char* end = NULL;
+      unsigned long ms = strtoul(arg + 11, &end, 10);
+      if ((end == (arg + 11)) || *end || (ms == 0) || (ms > 3600000)) {
+        return "main: invalid -benchtime value";
+      }
+      g_flags.benchtime_nanos = ((uint64_t)ms) * 1000000;
+    } else if (!strncmp(arg, "-heights=", 9)) {
+      const char* err_msg = parse_heights(arg + 9);
+      if (err_msg) {
+        return err_msg;
+      }
+    } else if (!strcmp(arg, "-json")) {
+      g_flags.json = true;
+    } else if (!strcmp(arg, "-quads")) {
+      g_flags.quads = true;
+    } else {
+      return "main: unrecognized flag";
+    }
+  }
+  *argc = n;
+  return NULL;
+}
+
+// ----
+
+int  //
+main(int argc, char** argv) {
+  {
+    const char* err_msg = parse_flags(&argc, argv);
+    if (err_msg) {
+      fprintf(stderr,
+              "%s\n"
+              "Usage: %s [-benchtime=N] [-heights=A,B,C] [-json] [-quads] "
+              "[file.iconvg|directory ...]\n",
+              err_msg, argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc <= 1) {
+    if (!add_source("test/data")) {
+      return 1;
+    }
+    g_flags.quads = true;
+  }
+  for (int i = 1; i < argc; i++) {
+    if (!add_source(argv[i])) {
+      return 1;
+    }
+  }
+  if (g_flags.quads && !add_quads_fixture()) {
+    return 1;
+  }
+
+  if (g_flags.json) {
+    printf("{\n  \"backend\": ");
+    if (BACKEND_NAME) {
+      print_json_string(BACKEND_NAME);
+    } else {
+      printf("null");
+    }
+    printf(",\n  \"benchtime_ms\": %llu,\n  \"results\": [",
+           (unsigned long long)(g_flags.benchtime_nanos / 1000000));
+  }
+
+  int ret = 0;
+  bool first = true;
+  for (size_t i = 0; i < g_num_sources; i++) {
+    const source_file* s = &g_sources[i];
+    {
+      result r = {0};
+      const char* err_msg =
+          benchmark(&r, NULL, s, 1, s->filename, "validate", 0, 0);
+      if (err_msg) {
+        fprintf(stderr, "main: could not benchmark %s\n%s\n", s->filename,
+                err_msg);
+        ret = 1;
+      } else {
+        print_result(&r, first);
+        first = false;
+      }
+    }
+
+    for (size_t j = 0; j < g_flags.num_heights; j++) {
+      uint32_t height = g_flags.heights[j];
+      double vw = iconvg_rectangle_f32__width_f64(&s->viewbox);
+      double vh = iconvg_rectangle_f32__height_f64(&s->viewbox);
+      double w = (vh > 0) ? ((height * vw) / vh) : height;
+      uint32_t width = (w < 1) ? 1 : (w > 0x7FFF) ? 0x7FFF : (uint32_t)(w + 0.5);
+
+      for (int mode = 0; mode < 3; mode++) {
+        result r = {0};
+        const char* err_msg = NULL;
+        if (mode == 0) {
+          iconvg_canvas c = iconvg_canvas__make_broken(NULL);
+          err_msg =
+              benchmark(&r, &c, s, 1, s->filename, "decode", width, height);
+        } else if (mode == 1) {
+          bounds b = {0};
+          iconvg_canvas c = make_bounds_canvas(&b);
+          err_msg =
+              benchmark(&r, &c, s, 1, s->filename, "bounds", width, height);
+        } else if (!BACKEND_NAME) {
+          continue;
+        } else {
+          raster_canvas rc = {0};
+          err_msg = initialize_raster_canvas(&rc, width, height);
+          if (!err_msg) {
+            err_msg = benchmark(&r, &rc.canvas, s, 1, s->filename, "render",
+                                width, height);
+            finalize_raster_canvas(&rc);
+          }
+        }
+
+        if (err_msg) {
+          fprintf(stderr, "main: could not benchmark %s\n%s\n", s->filename,
+                  err_msg);
+          ret = 1;
+          continue;
+        }
+        print_result(&r, first);
+        first = false;
+      }
+    }
+  }
+
+  if (g_num_sources > 1) {
+    char filename[64];
+    snprintf(filename, sizeof(filename), "(all %zu files)", g_num_sources);
+    result r = {0};
+    const char* err_msg = benchmark(&r, NULL, g_sources, g_num_sources,
+                                    filename, "validate", 0, 0);
+    if (err_msg) {
+      fprintf(stderr, "main: could not benchmark %s\n%s\n", filename, err_msg);
+      ret = 1;
+    } else {
+      print_result(&r, first);
+      first = false;
+    }
+  }
+
+  if (g_flags.json) {
+    printf("\n  ]\n}\n");
+  }
+  return ret;
+}
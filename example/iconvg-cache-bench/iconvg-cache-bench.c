@@ -0,0 +1,435 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-cache-bench compares the cold and warm startup of an application
+// (such as a launcher) that shows many icons.
+//
+// Usage: iconvg-cache-bench [flags] [file.iconvg|directory ...]
+//     If no files or directories are given, it reads test/data/*.iconvg.
+//     Directories are scanned (non-recursively) for *.iconvg files.
+//
+// Flags:
+//     -cache=PATH  Where to write the display list cache. Defaults to
+//                  /tmp/iconvg-cache-bench.cache.
+//     -height=N    Rendering height (in pixels). Defaults to 48.
+//     -n=N         Number of icons. Defaults to 4000. The input files are
+//                  repeated as necessary, each copy made distinct (but
+//                  drawing the same thing) by appending a RET op and some
+//                  unreachable ops, so that each copy has its own cache entry.
+//     -reps=N      Number of repetitions. The fastest is reported. Defaults
+//                  to 5.
+//
+// The icons are held in memory (as if from an IconVG pack). A cold start
+// calls iconvg_decode for every icon. A warm start memory-maps the display
+// list cache (written once, beforehand, by iconvg_write_display_list_cache)
+// and calls iconvg_display_list_cache__replay for every icon, which skips the
+// bytecode interpreter. Both draw onto a broken (NULL error message) canvas,
+// so that rendering costs don't mask the difference.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+struct {
+  const char* cache;
+  uint32_t height;
+  uint32_t n;
+  uint32_t reps;
+} g_flags;
+
+// ----
+
+uint64_t  //
+monotonic_nanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return 0;
+  }
+  return (((uint64_t)(ts.tv_sec)) * 1000000000) + ((uint64_t)(ts.tv_nsec));
+}
+
+// ----
+
+iconvg_file* g_files = NULL;
+size_t g_num_files = 0;
+size_t g_cap_files = 0;
+
+bool  //
+add_source_file(const char* filename) {
+  iconvg_file file;
+  const char* err_msg = iconvg_file__open(&file, filename, NULL);
+  if (err_msg) {
+    fprintf(stderr, "main: could not read %s\n%s\n", filename, err_msg);
+    return false;
+  }
+
+  err_msg = iconvg_validate(file.ptr, file.len, NULL);
+  if (err_msg) {
+    fprintf(stderr, "main: could not validate %s\n%s\n", filename, err_msg);
+    iconvg_file__close(&file);
+    return false;
+  }
+
+  if (g_num_files == g_cap_files) {
+    size_t new_cap = g_cap_files ? (2 * g_cap_files) : 64;
+    iconvg_file* new_files = realloc(g_files, new_cap * sizeof(iconvg_file));
+    if (!new_files) {
+      fprintf(stderr, "main: out of memory\n");
+      iconvg_file__close(&file);
+      return false;
+    }
+    g_files = new_files;
+    g_cap_files = new_cap;
+  }
+  g_files[g_num_files++] = file;
+  return true;
+}
+
+bool  //
+has_iconvg_suffix(const char* s) {
+  size_t n = strlen(s);
+  return (n >= 7) && !strcmp(s + n - 7, ".iconvg");
+}
+
+int  //
+compare_strings(const void* a, const void* b) {
+  return strcmp(*(const char* const*)a, *(const char* const*)b);
+}
+
+bool  //
+add_source_directory(const char* dirname) {
+  DIR* d = opendir(dirname);
+  if (!d) {
+    fprintf(stderr, "main: could not open %s: %s\n", dirname, strerror(errno));
+    return false;
+  }
+
+  // Collect and sort the names, so that the icon order is deterministic.
+  char** names = NULL;
+  size_t num_names = 0;
+  size_t cap_names = 0;
+  bool ok = true;
+  for (struct dirent* e = readdir(d); e; e = readdir(d)) {
+    if (!has_iconvg_suffix(e->d_name)) {
+      continue;
+    }
+    if (num_names == cap_names) {
+      cap_names = cap_names ? (2 * cap_names) : 64;
+      char** new_names = realloc(names, cap_names * sizeof(char*));
+      if (!new_names) {
+        ok = false;
+        break;
+      }
+      names = new_names;
+    }
+    size_t dirname_len = strlen(dirname);
+    const char* sep =
+        (dirname_len && (dirname[dirname_len - 1] == '/')) ? "" : "/";
+    size_t n = dirname_len + 1 + strlen(e->d_name) + 1;
+    names[num_names] = malloc(n);
+    if (!names[num_names]) {
+      ok = false;
+      break;
+    }
+    snprintf(names[num_names++], n, "%s%s%s", dirname, sep, e->d_name);
+  }
+  closedir(d);
+
+  if (ok) {
+    qsort(names, num_names, sizeof(char*), &compare_strings);
+    for (size_t i = 0; ok && (i < num_names); i++) {
+      ok = add_source_file(names[i]);
+    }
+  } else {
+    fprintf(stderr, "main: out of memory\n");
+  }
+  for (size_t i = 0; i < num_names; i++) {
+    free(names[i]);
+  }
+  free(names);
+  return ok;
+}
+
+bool  //
+add_source(const char* name) {
+  DIR* d = opendir(name);
+  if (d) {
+    closedir(d);
+    return add_source_directory(name);
+  }
+  return add_source_file(name);
+}
+
+// ----
+
+// The icons, g_flags.n of them, are copies of the input files.
+
+const uint8_t** g_icon_ptrs = NULL;
+size_t* g_icon_lens = NULL;
+iconvg_rectangle_f32* g_icon_rects = NULL;
+
+// make_icons sets up the g_icon_etc arrays. The i'th icon is file (i %
+// g_num_files) followed by RET (0x3B) and then, if it is a repeat, two
+// unreachable "SEL += arg" ops whose args hold (i / g_num_files).
+const char*  //
+make_icons() {
+  g_icon_ptrs = calloc(g_flags.n, sizeof(const uint8_t*));
+  g_icon_lens = calloc(g_flags.n, sizeof(size_t));
+  g_icon_rects = calloc(g_flags.n, sizeof(iconvg_rectangle_f32));
+  if (!g_icon_ptrs || !g_icon_lens || !g_icon_rects) {
+    return "main: out of memory";
+  }
+  for (uint32_t i = 0; i < g_flags.n; i++) {
+    const iconvg_file* f = &g_files[i % g_num_files];
+    uint32_t copy = (uint32_t)(i / g_num_files);
+    size_t n = f->len + ((copy > 0) ? 5 : 0);
+    uint8_t* ptr = malloc(n);
+    if (!ptr) {
+      return "main: out of memory";
+    }
+    memcpy(ptr, f->ptr, f->len);
+    if (copy > 0) {
+      uint8_t suffix[5] = {0x3B, 0x36, (uint8_t)(copy >> 0), 0x36,
+                           (uint8_t)(copy >> 8)};
+      memcpy(ptr + f->len, suffix, 5);
+    }
+    g_icon_ptrs[i] = ptr;
+    g_icon_lens[i] = n;
+
+    iconvg_rectangle_f32 viewbox = {0};
+    const char* err_msg = iconvg_decode_viewbox(&viewbox, ptr, n);
+    if (err_msg) {
+      return err_msg;
+    }
+    double vw = iconvg_rectangle_f32__width_f64(&viewbox);
+    double vh = iconvg_rectangle_f32__height_f64(&viewbox);
+    double w = (vh > 0) ? ((g_flags.height * vw) / vh) : g_flags.height;
+    g_icon_rects[i] =
+        iconvg_rectangle_f32__make(0, 0, (float)w, (float)(g_flags.height));
+  }
+  return NULL;
+}
+
+// ----
+
+const char*  //
+cold_start() {
+  iconvg_canvas c = iconvg_canvas__make_broken(NULL);
+  for (uint32_t i = 0; i < g_flags.n; i++) {
+    const char* err_msg = iconvg_decode(&c, g_icon_rects[i], g_icon_ptrs[i],
+                                        g_icon_lens[i], NULL);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+  return NULL;
+}
+
+const char*  //
+warm_start(uint32_t* num_hits) {
+  iconvg_display_list_cache cache;
+  const char* err_msg =
+      iconvg_display_list_cache__open_mmap(&cache, g_flags.cache, NULL);
+  if (err_msg) {
+    return err_msg;
+  }
+  iconvg_canvas c = iconvg_canvas__make_broken(NULL);
+  for (uint32_t i = 0; i < g_flags.n; i++) {
+    err_msg = iconvg_display_list_cache__replay(
+        &cache, &c, g_icon_rects[i], g_icon_ptrs[i], g_icon_lens[i], NULL);
+    if (err_msg) {
+      break;
+    }
+  }
+  if (num_hits) {
+    *num_hits = 0;
+    for (uint32_t i = 0; i < g_flags.n; i++) {
+      *num_hits += iconvg_display_list_cache__contains(
+          &cache, g_icon_ptrs[i], g_icon_lens[i], NULL);
+    }
+  }
+  iconvg_display_list_cache__close(&cache);
+  return err_msg;
+}
+
+const char*  //
+write_cache(uint64_t* cache_size) {
+  FILE* f = fopen(g_flags.cache, "wb");
+  if (!f) {
+    return "main: could not create the cache file";
+  }
+  const char* err_msg = iconvg_write_display_list_cache(
+      f, g_icon_ptrs, g_icon_lens, g_flags.n, NULL);
+  if (!err_msg && ferror(f)) {
+    err_msg = "main: could not write the cache file";
+  }
+  long size = ftell(f);
+  *cache_size = (size > 0) ? ((uint64_t)size) : 0;
+  if (fclose(f) && !err_msg) {
+    err_msg = "main: could not write the cache file";
+  }
+  return err_msg;
+}
+
+// ----
+
+const char*  //
+parse_flags(int* argc, char** argv) {
+  g_flags.cache = "/tmp/iconvg-cache-bench.cache";
+  g_flags.height = 48;
+  g_flags.n = 4000;
+  g_flags.reps = 5;
+
+  int n = 1;
+  for (int i = 1; i < *argc; i++) {
+    const char* arg = argv[i];
+    if ((arg[0] != '-') || !strcmp(arg, "-")) {
+      argv[n++] = argv[i];
+      continue;
+    } else if (!strcmp(arg, "--")) {
+      for (i++; i < *argc; i++) {
+        argv[n++] = argv[i];
+      }
+      break;
+    }
+    if (arg[1] == '-') {
+      arg++;
+    }
+    if (!strncmp(arg, "-cache=", 7)) {
+      g_flags.cache = arg + 7;
+      if (!*g_flags.cache) {
+        return "main: empty -cache value";
+      }
+    } else if (!strncmp(arg, "-height=", 8) || !strncmp(arg, "-n=", 3) ||
+               !strncmp(arg, "-reps=", 6)) {
+      const char* eq = strchr(arg, '=') + 1;
+      char* end = NULL;
+      unsigned long x = strtoul(eq, &end, 10);
+      if ((end == eq) || *end || (x == 0) || (x > 1000000)) {
+        return "main: invalid -height, -n or -reps value";
+      } else if (arg[1] == 'h') {
+        g_flags.height = (uint32_t)x;
+      } else if (arg[1] == 'n') {
+        g_flags.n = (uint32_t)x;
+      } else {
+        g_flags.reps = (uint32_t)x;
+      }
+    } else {
+      return "main: unrecognized flag";
+    }
+  }
+  *argc = n;
+  return NULL;
+}
+
+int  //
+main(int argc, char** argv) {
+  {
+    const char* err_msg = parse_flags(&argc, argv);
+    if (err_msg) {
+      fprintf(stderr,
+              "%s\n"
+              "Usage: %s [-cache=PATH] [-height=N] [-n=N] [-reps=N] "
+              "[file.iconvg|directory ...]\n",
+              err_msg, argv[0]);
+      return 1;
+    }
+  }
+
+  if (argc <= 1) {
+    if (!add_source("test/data")) {
+      return 1;
+    }
+  }
+  for (int i = 1; i < argc; i++) {
+    if (!add_source(argv[i])) {
+      return 1;
+    }
+  }
+  if (g_num_files == 0) {
+    fprintf(stderr, "main: no input files\n");
+    return 1;
+  }
+  const char* err_msg = make_icons();
+  if (err_msg) {
+    fprintf(stderr, "%s\n", err_msg);
+    return 1;
+  }
+
+  uint64_t cache_size = 0;
+  uint64_t now = monotonic_nanos();
+  err_msg = write_cache(&cache_size);
+  uint64_t write_nanos = monotonic_nanos() - now;
+  if (err_msg) {
+    fprintf(stderr, "%s\n", err_msg);
+    return 1;
+  }
+
+  uint64_t cold_nanos = UINT64_MAX;
+  uint64_t warm_nanos = UINT64_MAX;
+  for (uint32_t r = 0; r < g_flags.reps; r++) {
+    now = monotonic_nanos();
+    err_msg = cold_start();
+    uint64_t cold = monotonic_nanos() - now;
+    if (!err_msg) {
+      now = monotonic_nanos();
+      err_msg = warm_start(NULL);
+    }
+    uint64_t warm = monotonic_nanos() - now;
+    if (err_msg) {
+      fprintf(stderr, "%s\n", err_msg);
+      return 1;
+    }
+    cold_nanos = (cold_nanos < cold) ? cold_nanos : cold;
+    warm_nanos = (warm_nanos < warm) ? warm_nanos : warm;
+  }
+
+  uint32_t num_hits = 0;
+  err_msg = warm_start(&num_hits);
+  if (err_msg) {
+    fprintf(stderr, "%s\n", err_msg);
+    return 1;
+  }
+
+  printf("icons:  %u (from %zu files), height %u, best of %u\n", g_flags.n,
+         g_num_files, g_flags.height, g_flags.reps);
+  printf("cache:  %s, %llu bytes, %u hits, written in %.3f ms\n",
+         g_flags.cache, (unsigned long long)cache_size, num_hits,
+         write_nanos / 1e6);
+  printf("cold:   %10.3f ms  %10.3f us/icon  (iconvg_decode)\n",
+         cold_nanos / 1e6, cold_nanos / (1e3 * g_flags.n));
+  printf("warm:   %10.3f ms  %10.3f us/icon  (open_mmap and replay)\n",
+         warm_nanos / 1e6, warm_nanos / (1e3 * g_flags.n));
+  printf("speedup: %.2fx\n",
+         (warm_nanos > 0) ? (((double)cold_nanos) / warm_nanos) : 0.0);
+  return 0;
+}
@@ -0,0 +1,1119 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-disassemble prints a human-readable disassembly of IconVG byte-code,
+// like cmd/iconvg-disassemble does, annotated with where the C decoder spends
+// its time.
+//
+// Usage: iconvg-disassemble [flags] input.ivg > output.txt
+//     If input.ivg is omitted, it reads from stdin.
+//
+// Flags:
+//     -benchtime=N     Target duration (in milliseconds) of the repeated
+//                      decodes that are timed. Defaults to 100.
+//     -height=N        Rendering height (in pixels). The width is derived
+//                      from the ViewBox aspect ratio. Defaults to 256.
+//     -nocosts         Omit the cost columns. The output is then the same as
+//                      cmd/iconvg-disassemble's (the *.disassembly files).
+//
+// Each line is prefixed by two cost columns. For lines that start an op, they
+// are the average (over the repeated decodes) nanoseconds per decode spent in
+// that op: its total wall time and the part of that spent in the canvas
+// callbacks that the op triggered. For example, the time spent filling
+// pixels is attributed to the fill op whose end_drawing call did so. The
+// columns are blank for lines that continue an op (its arguments) and are
+// "-" for ops that the decoder did not execute (e.g. ops skipped over by a
+// Level of Detail jump, whose skipping cost is attributed to the jump op).
+//
+// Decodes go through the real bytecode interpreter, with the
+// ICONVG_CONFIG__OP_OBSERVER hook marking op boundaries, onto the compiled-in
+// raster backend (Cairo or Skia) or, if none was configured, onto a canvas
+// that does nothing. Every op's wall time includes one monotonic clock read
+// (and every canvas callback adds two more), whose cost is printed to stderr
+// along with the totals.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// observe_op is called by the IconVG library just before it executes each op.
+void observe_op(const uint8_t* op_ptr);
+#define ICONVG_CONFIG__OP_OBSERVER(op_ptr) observe_op(op_ptr)
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+struct {
+  uint64_t benchtime_nanos;
+  uint32_t height;
+  bool costs;
+} g_flags;
+
+uint64_t  //
+monotonic_nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((uint64_t)(ts.tv_sec)) * 1000000000) + ((uint64_t)(ts.tv_nsec));
+}
+
+// ----
+
+// A raster_canvas is a backend-specific pixel buffer and the iconvg_canvas
+// that draws onto it.
+
+typedef struct {
+  iconvg_canvas canvas;
+  void* extra0;
+  void* extra1;
+} raster_canvas;
+
+#if defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+
+#include <cairo/cairo.h>
+
+#define BACKEND_NAME "cairo"
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  cairo_surface_t* cs =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)width, (int)height);
+  if (cairo_surface_status(cs) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(cs);
+    return "main: could not create cairo_surface_t";
+  }
+  cairo_t* cr = cairo_create(cs);
+
+  *rc = ((raster_canvas){0});
+  rc->canvas = iconvg_canvas__make_cairo(cr);
+  rc->extra0 = cs;
+  rc->extra1 = cr;
+  return NULL;
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {
+  if (rc->extra1) {
+    cairo_destroy((cairo_t*)(rc->extra1));
+    rc->extra1 = NULL;
+  }
+  if (rc->extra0) {
+    cairo_surface_destroy((cairo_surface_t*)(rc->extra0));
+    rc->extra0 = NULL;
+  }
+}
+
+#elif defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+
+#include "include/c/sk_imageinfo.h"
+#include "include/c/sk_surface.h"
+
+#define BACKEND_NAME "skia"
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  uint8_t* data = (uint8_t*)(malloc(4 * width * height));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+  sk_imageinfo_t* si =
+      sk_imageinfo_new((int)width, (int)height, BGRA_8888_SK_COLORTYPE,
+                       PREMUL_SK_ALPHATYPE, NULL);
+  if (!si) {
+    free(data);
+    return "main: could not create sk_imageinfo_t";
+  }
+  sk_surface_t* ss = sk_surface_new_raster_direct(si, data, 4 * width, NULL);
+  sk_imageinfo_delete(si);
+  if (!ss) {
+    free(data);
+    return "main: could not create sk_surface_t";
+  }
+  sk_canvas_t* sc = sk_surface_get_canvas(ss);
+  if (!sc) {
+    sk_surface_unref(ss);
+    free(data);
+    return "main: could not create sk_canvas_t";
+  }
+
+  *rc = ((raster_canvas){0});
+  rc->canvas = iconvg_canvas__make_skia(sc);
+  rc->extra0 = ss;
+  rc->extra1 = data;
+  return NULL;
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {
+  if (rc->extra0) {
+    sk_surface_unref((sk_surface_t*)(rc->extra0));
+    rc->extra0 = NULL;
+  }
+  if (rc->extra1) {
+    free(rc->extra1);
+    rc->extra1 = NULL;
+  }
+}
+
+#else  //  ICONVG_CONFIG__ETC
+
+#define BACKEND_NAME "none"
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  *rc = ((raster_canvas){0});
+  rc->canvas = iconvg_canvas__make_broken(NULL);
+  return NULL;
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {}
+
+#endif  //  ICONVG_CONFIG__ETC
+
+// ----
+
+// The costs are indexed by the op's byte offset in the source file. The
+// prologue (decoding the header and metadata) and epilogue (anything after
+// the last op) costs are kept separately.
+
+iconvg_file g_src = {0};
+
+uint64_t* g_wall_nanos = NULL;
+uint64_t* g_canvas_nanos = NULL;
+uint64_t* g_num_executions = NULL;
+
+uint64_t g_prologue_nanos = 0;
+uint64_t g_epilogue_nanos = 0;
+uint64_t g_num_decodes = 0;
+
+// g_current_op is the byte offset of the op being executed, or one of the
+// CURRENT_OP__ETC values.
+size_t g_current_op = 0;
+uint64_t g_current_op_start = 0;
+
+#define CURRENT_OP__PROLOGUE ((size_t)(-1))
+#define CURRENT_OP__EPILOGUE ((size_t)(-2))
+
+void  //
+finish_current_op(uint64_t now) {
+  uint64_t elapsed = now - g_current_op_start;
+  if (g_current_op == CURRENT_OP__PROLOGUE) {
+    g_prologue_nanos += elapsed;
+  } else if (g_current_op == CURRENT_OP__EPILOGUE) {
+    g_epilogue_nanos += elapsed;
+  } else {
+    g_wall_nanos[g_current_op] += elapsed;
+  }
+  g_current_op_start = now;
+}
+
+void  //
+observe_op(const uint8_t* op_ptr) {
+  finish_current_op(monotonic_nanos());
+  g_current_op = (size_t)(op_ptr - g_src.ptr);
+  g_num_executions[g_current_op]++;
+}
+
+void  //
+add_canvas_nanos(uint64_t elapsed) {
+  if ((g_current_op != CURRENT_OP__PROLOGUE) &&
+      (g_current_op != CURRENT_OP__EPILOGUE)) {
+    g_canvas_nanos[g_current_op] += elapsed;
+  }
+}
+
+// The timing canvas forwards to the canvas pointed to by its
+// context.nonconst_ptr1, adding the time spent there to the current op.
+
+const char*  //
+timing_canvas__begin_decode(iconvg_canvas* c, iconvg_rectangle_f32 dst_rect) {
+  g_current_op = CURRENT_OP__PROLOGUE;
+  g_current_op_start = monotonic_nanos();
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*w->vtable->begin_decode)(w, dst_rect);
+}
+
+const char*  //
+timing_canvas__end_decode(iconvg_canvas* c,
+                          const char* err_msg,
+                          size_t num_bytes_consumed,
+                          size_t num_bytes_remaining) {
+  finish_current_op(monotonic_nanos());
+  g_current_op = CURRENT_OP__EPILOGUE;
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  err_msg = (*w->vtable->end_decode)(w, err_msg, num_bytes_consumed,
+                                     num_bytes_remaining);
+  finish_current_op(monotonic_nanos());
+  g_num_decodes++;
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  uint64_t t0 = monotonic_nanos();
+  const char* err_msg = (*w->vtable->begin_drawing)(w);
+  add_canvas_nanos(monotonic_nanos() - t0);
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__end_drawing(iconvg_canvas* c, const iconvg_paint* p) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  uint64_t t0 = monotonic_nanos();
+  const char* err_msg = (*w->vtable->end_drawing)(w, p);
+  add_canvas_nanos(monotonic_nanos() - t0);
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  uint64_t t0 = monotonic_nanos();
+  const char* err_msg = (*w->vtable->begin_path)(w, x0, y0);
+  add_canvas_nanos(monotonic_nanos() - t0);
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__end_path(iconvg_canvas* c) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  uint64_t t0 = monotonic_nanos();
+  const char* err_msg = (*w->vtable->end_path)(w);
+  add_canvas_nanos(monotonic_nanos() - t0);
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  uint64_t t0 = monotonic_nanos();
+  const char* err_msg = (*w->vtable->path_line_to)(w, x1, y1);
+  add_canvas_nanos(monotonic_nanos() - t0);
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__path_quad_to(iconvg_canvas* c,
+                            float x1,
+                            float y1,
+                            float x2,
+                            float y2) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  uint64_t t0 = monotonic_nanos();
+  const char* err_msg = (*w->vtable->path_quad_to)(w, x1, y1, x2, y2);
+  add_canvas_nanos(monotonic_nanos() - t0);
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__path_cube_to(iconvg_canvas* c,
+                            float x1,
+                            float y1,
+                            float x2,
+                            float y2,
+                            float x3,
+                            float y3) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  uint64_t t0 = monotonic_nanos();
+  const char* err_msg = (*w->vtable->path_cube_to)(w, x1, y1, x2, y2, x3, y3);
+  add_canvas_nanos(monotonic_nanos() - t0);
+  return err_msg;
+}
+
+const char*  //
+timing_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                   iconvg_rectangle_f32 viewbox) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*w->vtable->on_metadata_viewbox)(w, viewbox);
+}
+
+const char*  //
+timing_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_canvas* w = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  return (*w->vtable->on_metadata_suggested_palette)(w, suggested_palette);
+}
+
+const iconvg_canvas_vtable timing_canvas_vtable = {
+    sizeof(iconvg_canvas_vtable),
+    &timing_canvas__begin_decode,
+    &timing_canvas__end_decode,
+    &timing_canvas__begin_drawing,
+    &timing_canvas__end_drawing,
+    &timing_canvas__begin_path,
+    &timing_canvas__end_path,
+    &timing_canvas__path_line_to,
+    &timing_canvas__path_quad_to,
+    &timing_canvas__path_cube_to,
+    &timing_canvas__on_metadata_viewbox,
+    &timing_canvas__on_metadata_suggested_palette,
+    NULL,  // begin_path__fixed
+    NULL,  // path_line_to__fixed
+    NULL,  // path_quad_to__fixed
+    NULL,  // path_cube_to__fixed
+};
+
+// measure_costs decodes the source repeatedly, for roughly
+// g_flags.benchtime_nanos (and at least once), accumulating the costs.
+const char*  //
+measure_costs() {
+  g_wall_nanos = (uint64_t*)(calloc(g_src.len, sizeof(uint64_t)));
+  g_canvas_nanos = (uint64_t*)(calloc(g_src.len, sizeof(uint64_t)));
+  g_num_executions = (uint64_t*)(calloc(g_src.len, sizeof(uint64_t)));
+  if (!g_wall_nanos || !g_canvas_nanos || !g_num_executions) {
+    return "main: out of memory";
+  }
+
+  iconvg_rectangle_f32 viewbox = {0};
+  const char* err_msg = iconvg_decode_viewbox(&viewbox, g_src.ptr, g_src.len);
+  if (err_msg) {
+    return err_msg;
+  }
+  double vw = iconvg_rectangle_f32__width_f64(&viewbox);
+  double vh = iconvg_rectangle_f32__height_f64(&viewbox);
+  double h = g_flags.height;
+  double w = (vh > 0) ? ((h * vw) / vh) : h;
+  uint32_t width = (w < 1) ? 1 : (w > 0x7FFF) ? 0x7FFF : (uint32_t)(w + 0.5);
+  iconvg_rectangle_f32 dst_rect =
+      iconvg_rectangle_f32__make(0, 0, (float)width, (float)g_flags.height);
+
+  raster_canvas rc = {0};
+  err_msg = initialize_raster_canvas(&rc, width, g_flags.height);
+  if (err_msg) {
+    return err_msg;
+  }
+  iconvg_canvas c;
+  c.vtable = &timing_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = &rc.canvas;
+
+  uint64_t start = monotonic_nanos();
+  do {
+    err_msg = iconvg_decode(&c, dst_rect, g_src.ptr, g_src.len, NULL);
+  } while (!err_msg && ((monotonic_nanos() - start) < g_flags.benchtime_nanos));
+  finalize_raster_canvas(&rc);
+  return err_msg;
+}
+
+// ----
+
+// The disassembler below mirrors the Go one (in src/go/lowlevel/decode.go),
+// so that, without the cost columns, the output matches the *.disassembly
+// files.
+
+static const char* g_spread_names[4] = {"none", "pad", "reflect", "repeat"};
+
+void  //
+print_line(const uint8_t* b, size_t n, bool is_op, const char* format, ...) {
+  if (g_flags.costs) {
+    size_t i = b ? ((size_t)(b - g_src.ptr)) : 0;
+    if (!is_op) {
+      printf("%22s", "");
+    } else if (g_num_executions[i] == 0) {
+      printf("%10s %10s ", "-", "-");
+    } else {
+      printf("%10.1f %10.1f ",
+             ((double)(g_wall_nanos[i])) / ((double)g_num_decodes),
+             ((double)(g_canvas_nanos[i])) / ((double)g_num_decodes));
+    }
+  }
+
+  static const char* hex = "0123456789abcdef";
+  char buf[15];
+  memset(buf, ' ', 14);
+  buf[14] = 0;
+  for (size_t i = 0; (i < n) && (i < 4); i++) {
+    buf[(3 * i) + 0] = hex[b[i] >> 4];
+    buf[(3 * i) + 1] = hex[b[i] & 15];
+  }
+  fputs(buf, stdout);
+
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+}
+
+// format_float formats f like Go's fmt.Sprintf("%+g", f) does for a float32:
+// the shortest decimal that round-trips, in exponent form if the decimal
+// exponent is less than -4 or at least 6.
+const char*  //
+format_float(char* buf, size_t buf_len, float f) {
+  if (f == 0) {
+    snprintf(buf, buf_len, "%s", signbit(f) ? "-0" : "+0");
+    return buf;
+  } else if (isinf(f)) {
+    snprintf(buf, buf_len, "%s", (f < 0) ? "-Inf" : "+Inf");
+    return buf;
+  }
+  int nd = 1;
+  for (; nd < 9; nd++) {
+    snprintf(buf, buf_len, "%.*e", nd - 1, f);
+    if (strtof(buf, NULL) == f) {
+      break;
+    }
+  }
+  snprintf(buf, buf_len, "%.*e", nd - 1, f);
+  const char* e = strchr(buf, 'e');
+  int exp = e ? atoi(e + 1) : 0;
+  if ((exp < -4) || (exp >= 6)) {
+    snprintf(buf, buf_len, "%+.*e", nd - 1, f);
+  } else {
+    int prec = nd - 1 - exp;
+    snprintf(buf, buf_len, "%+.*f", (prec > 0) ? prec : 0, f);
+  }
+  return buf;
+}
+
+size_t  //
+peek_natural(const uint8_t* p, size_t len, uint32_t* dst) {
+  if (len < 1) {
+    return 0;
+  } else if (p[0] & 0x01) {
+    *dst = p[0] >> 1;
+    return 1;
+  } else if (p[0] & 0x02) {
+    if (len < 2) {
+      return 0;
+    }
+    *dst = iconvg_private_peek_u16le(p) >> 2;
+    return 2;
+  } else if (len < 4) {
+    return 0;
+  }
+  *dst = iconvg_private_peek_u32le(p) >> 2;
+  return 4;
+}
+
+size_t  //
+peek_coordinate(const uint8_t* p, size_t len, float* dst) {
+  uint32_t u = 0;
+  size_t n = peek_natural(p, len, &u);
+  if (n == 1) {
+    *dst = (float)(((int32_t)u) - 64);
+  } else if (n == 2) {
+    *dst = ((float)(((int32_t)u) - (64 * 128))) / 64;
+  } else if (n == 4) {
+    float f = iconvg_private_reinterpret_from_u32_to_f32(u << 2);
+    if (f != f) {
+      return 0;
+    }
+    *dst = f;
+  }
+  return n;
+}
+
+// The disassembler's state is the remaining source, as a pointer and length,
+// and the program counter (counting ops).
+
+typedef struct {
+  const uint8_t* ptr;
+  size_t len;
+  uint32_t pc;
+} disassembler;
+
+void  //
+disassembler__advance(disassembler* d, size_t n) {
+  d->ptr += n;
+  d->len -= n;
+}
+
+bool  //
+disassembler__coordinates(disassembler* d, float* dst, size_t num_dst) {
+  for (size_t i = 0; i < num_dst; i++) {
+    float f = 0;
+    size_t n = peek_coordinate(d->ptr, d->len, &f);
+    if (n == 0) {
+      return false;
+    }
+    char buf[64];
+    print_line(d->ptr, n, false, "      %s\n", format_float(buf, 64, f));
+    disassembler__advance(d, n);
+    if (dst) {
+      dst[i] = f;
+    }
+  }
+  return true;
+}
+
+bool  //
+disassembler__extra_data(disassembler* d) {
+  uint32_t length = 0;
+  size_t n = peek_natural(d->ptr, d->len, &length);
+  if (n == 0) {
+    return false;
+  }
+  print_line(d->ptr, n, false, "      Extra data length: %d\n", (int)length);
+  disassembler__advance(d, n);
+  if (d->len < length) {
+    return false;
+  }
+  for (; length > 4; length -= 4) {
+    print_line(d->ptr, 4, false, "      ???\n");
+    disassembler__advance(d, 4);
+  }
+  if (length > 0) {
+    print_line(d->ptr, length, false, "      ???\n");
+    disassembler__advance(d, length);
+  }
+  return true;
+}
+
+void  //
+one_byte_color_string(char* buf, size_t buf_len, uint8_t x) {
+  static const uint8_t table[5] = {0x00, 0x40, 0x80, 0xC0, 0xFF};
+  if (x >= 0xC0) {
+    snprintf(buf, buf_len, "REGS[INDEX+%d]", x & 0x3F);
+    return;
+  } else if (x >= 0x80) {
+    snprintf(buf, buf_len, "CPAL[%d]", x & 0x3F);
+    return;
+  }
+  uint8_t r = 0x00, g = 0x00, b = 0x00, a = 0xFF;
+  if (x < 3) {
+    r = g = b = a = (x == 0) ? 0x00 : (x == 1) ? 0x80 : 0xC0;
+  } else {
+    x -= 3;
+    r = table[x % 5];
+    x /= 5;
+    g = table[x % 5];
+    x /= 5;
+    b = table[x];
+  }
+  snprintf(buf, buf_len, "rgba(%02X:%02X:%02X:%02X)", r, g, b, a);
+}
+
+bool  //
+disassembler__set_reg_lo32(disassembler* d) {
+  if (d->len < 4) {
+    return false;
+  }
+  const uint8_t* p = d->ptr;
+  print_line(p, 4, false, "      lo32 = 0x%02X%02X_%02X%02X\n", p[3], p[2],
+             p[1], p[0]);
+  disassembler__advance(d, 4);
+  return true;
+}
+
+bool  //
+disassembler__set_reg_hi32(disassembler* d) {
+  if (d->len < 4) {
+    return false;
+  }
+  const uint8_t* p = d->ptr;
+  if ((p[0] <= p[3]) && (p[1] <= p[3]) && (p[2] <= p[3])) {
+    print_line(p, 4, false, "      hi32 = rgba(%02X:%02X:%02X:%02X)\n", p[0],
+               p[1], p[2], p[3]);
+  } else {
+    char buf1[32];
+    char buf2[32];
+    if ((p[0] == 0x00) || (p[1] == p[2])) {
+      one_byte_color_string(buf1, 32, p[1]);
+      print_line(p, 4, false, "      hi32 = %s\n", buf1);
+    } else if (p[0] == 0xFF) {
+      one_byte_color_string(buf2, 32, p[2]);
+      print_line(p, 4, false, "      hi32 = %s\n", buf2);
+    } else {
+      one_byte_color_string(buf1, 32, p[1]);
+      one_byte_color_string(buf2, 32, p[2]);
+      print_line(p, 4, false, "      hi32 = blend(0x%02X * %s, 0x%02X * %s)\n",
+                 0xFF - p[0], buf1, p[0], buf2);
+    }
+  }
+  disassembler__advance(d, 4);
+  return true;
+}
+
+bool  //
+disassembler__line_quad_cube_to(disassembler* d, uint8_t opcode) {
+  static const char* names[3] = {"LineTo", "QuadTo", "CubeTo"};
+  const char* name = names[opcode >> 4];
+  size_t num_coords = 2 * (1 + (opcode >> 4));
+
+  uint32_t num_reps = opcode & 0x0F;
+  if (num_reps > 0) {
+    print_line(d->ptr, 1, true, "#%04d %s (%d reps)\n", (int)d->pc, name,
+               (int)num_reps);
+    disassembler__advance(d, 1);
+  } else {
+    print_line(d->ptr, 1, true, "#%04d %s...\n", (int)d->pc, name);
+    disassembler__advance(d, 1);
+    size_t n = peek_natural(d->ptr, d->len, &num_reps);
+    if (n == 0) {
+      return false;
+    }
+    num_reps += 16;
+    print_line(d->ptr, n, false, "      ...(%d reps)\n", (int)num_reps);
+    disassembler__advance(d, n);
+  }
+
+  for (uint32_t i = 0; i < num_reps; i++) {
+    if (i != 0) {
+      print_line(NULL, 0, false, "      (rep)\n");
+    }
+    if (!disassembler__coordinates(d, NULL, num_coords)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool  //
+disassembler__jump_target(disassembler* d) {
+  uint32_t jump_distance = 0;
+  size_t n = peek_natural(d->ptr, d->len, &jump_distance);
+  if (n == 0) {
+    return false;
+  }
+  print_line(d->ptr, n, false, "      Target: #%04d (PC+%d)\n",
+             (int)(d->pc + jump_distance), (int)jump_distance);
+  disassembler__advance(d, n);
+  return true;
+}
+
+const char*  //
+disassembler__bytecode(disassembler* d) {
+  static const char* invalid = "main: invalid IconVG bytecode";
+  float lod[2];
+  while (d->len > 0) {
+    const uint8_t* op = d->ptr;
+    uint8_t opcode = op[0];
+    switch (opcode >> 6) {
+      case 0:  // Path-drawing, miscellaneous, jump and call opcodes.
+        if (opcode < 0x30) {
+          if (!disassembler__line_quad_cube_to(d, opcode)) {
+            return invalid;
+          }
+          d->pc++;
+          continue;
+
+        } else if (opcode < 0x34) {
+          print_line(op, 1, true, "#%04d Ellipse (%d quarters)\n", (int)d->pc++,
+                     1 + (opcode & 3));
+          disassembler__advance(d, 1);
+          if (!disassembler__coordinates(d, NULL, 4)) {
+            return invalid;
+          }
+          continue;
+        }
+
+        switch (opcode & 0x0F) {
+          case 0x04:
+            print_line(op, 1, true, "#%04d Parallelogram\n", (int)d->pc++);
+            disassembler__advance(d, 1);
+            if (!disassembler__coordinates(d, NULL, 4)) {
+              return invalid;
+            }
+            continue;
+
+          case 0x05:
+            print_line(op, 1, true, "#%04d ClosePath; MoveTo\n", (int)d->pc++);
+            disassembler__advance(d, 1);
+            if (!disassembler__coordinates(d, NULL, 2)) {
+              return invalid;
+            }
+            continue;
+
+          case 0x06:
+            if (d->len < 2) {
+              return invalid;
+            }
+            print_line(op, 2, true, "#%04d SEL += %d\n", (int)d->pc++,
+                       op[1] & 63);
+            disassembler__advance(d, 2);
+            continue;
+
+          case 0x07:
+            print_line(op, 1, true, "#%04d NOP\n", (int)d->pc++);
+            disassembler__advance(d, 1);
+            continue;
+
+          case 0x08:
+            print_line(op, 1, true, "#%04d Jump Unconditional\n", (int)d->pc++);
+            disassembler__advance(d, 1);
+            if (!disassembler__jump_target(d)) {
+              return invalid;
+            }
+            continue;
+
+          case 0x09: {
+            print_line(op, 1, true, "#%04d Jump Feature-Bits\n", (int)d->pc++);
+            disassembler__advance(d, 1);
+            if (!disassembler__jump_target(d)) {
+              return invalid;
+            }
+            uint32_t feature_bits = 0;
+            size_t n = peek_natural(d->ptr, d->len, &feature_bits);
+            if (n == 0) {
+              return invalid;
+            }
+            print_line(d->ptr, n, false, "      FeatureBits: 0x%08X\n",
+                       (unsigned int)feature_bits);
+            disassembler__advance(d, n);
+            continue;
+          }
+
+          case 0x0A:
+            print_line(op, 1, true, "#%04d Jump Level-of-Detail\n",
+                       (int)d->pc++);
+            disassembler__advance(d, 1);
+            if (!disassembler__jump_target(d) ||
+                !disassembler__coordinates(d, lod, 2)) {
+              return invalid;
+            }
+            continue;
+
+          case 0x0B:
+            print_line(op, 1, true, "#%04d RET\n", (int)d->pc++);
+            disassembler__advance(d, 1);
+            continue;
+        }
+
+        // Call ops. The Go disassembler doesn't support these yet. This
+        // follows the C decoder, which skips over them.
+        {
+          print_line(op, 1, true, "#%04d Call\n", (int)d->pc++);
+          disassembler__advance(d, 1);
+          size_t n = 0;
+          if (opcode & 1) {
+            n += 25;
+          }
+          if (opcode & 2) {
+            n += 8;
+          } else if (d->len >= (n + 4)) {
+            n += 4 + (iconvg_private_peek_u32le(d->ptr + n) >> 8);
+          } else {
+            return invalid;
+          }
+          if (d->len < n) {
+            return invalid;
+          }
+          for (; n > 4; n -= 4) {
+            print_line(d->ptr, 4, false, "      ???\n");
+            disassembler__advance(d, 4);
+          }
+          if (n > 0) {
+            print_line(d->ptr, n, false, "      ???\n");
+            disassembler__advance(d, n);
+          }
+        }
+        continue;
+
+      case 1: {  // Set-register opcodes.
+        uint8_t adj = opcode & 0x0F;
+        const char* decr = (adj == 0) ? "; SEL--" : "";
+        switch ((opcode >> 4) & 3) {
+          case 0:
+            print_line(op, 1, true, "#%04d Set REGS[SEL+%d].lo32%s\n",
+                       (int)d->pc++, adj, decr);
+            disassembler__advance(d, 1);
+            if (!disassembler__set_reg_lo32(d)) {
+              return invalid;
+            }
+            continue;
+          case 1:
+            print_line(op, 1, true, "#%04d Set REGS[SEL+%d].hi32%s\n",
+                       (int)d->pc++, adj, decr);
+            disassembler__advance(d, 1);
+            if (!disassembler__set_reg_hi32(d)) {
+              return invalid;
+            }
+            continue;
+          case 2:
+            print_line(op, 1, true, "#%04d Set REGS[SEL+%d]%s\n", (int)d->pc++,
+                       adj, decr);
+            disassembler__advance(d, 1);
+            if (!disassembler__set_reg_lo32(d) ||
+                !disassembler__set_reg_hi32(d)) {
+              return invalid;
+            }
+            continue;
+        }
+        print_line(op, 1, true, "#%04d SEL -= %d; Set REGS[SEL+1 .. SEL+%d]\n",
+                   (int)d->pc++, adj + 2, adj + 3);
+        disassembler__advance(d, 1);
+        for (int i = 0; i < (adj + 2); i++) {
+          if (!disassembler__set_reg_lo32(d) ||
+              !disassembler__set_reg_hi32(d)) {
+            return invalid;
+          }
+        }
+        continue;
+      }
+
+      case 2: {  // Fill opcodes.
+        uint8_t adj = opcode & 0x0F;
+        const char* incr = (adj == 0) ? "SEL++; " : "";
+        uint8_t o = (opcode >> 4) & 3;
+        if (o == 0) {
+          print_line(op, 1, true,
+                     "#%04d ClosePath; %sFill (flat color) with REGS[SEL+%d]\n",
+                     (int)d->pc++, incr, adj);
+          disassembler__advance(d, 1);
+          continue;
+
+        } else if (o == 3) {
+          print_line(op, 1, true,
+                     "#%04d ClosePath; %sFill (reserved) with REGS[SEL+%d]\n",
+                     (int)d->pc++, incr, adj);
+          disassembler__advance(d, 1);
+          if (!disassembler__extra_data(d)) {
+            return invalid;
+          }
+          continue;
+        }
+
+        if (d->len < 2) {
+          return invalid;
+        }
+        print_line(op, 2, true,
+                   "#%04d ClosePath; %sFill (%s gradient; %s) with "
+                   "REGS[SEL+%d .. SEL+%d]\n",
+                   (int)d->pc++, incr, (o == 1) ? "linear" : "radial",
+                   g_spread_names[op[1] >> 6], adj, adj + 2 + (op[1] & 63));
+        disassembler__advance(d, 2);
+        for (int i = 0; i < (3 * o); i++) {
+          if (d->len < 4) {
+            return invalid;
+          }
+          float f = iconvg_private_reinterpret_from_u32_to_f32(
+              iconvg_private_peek_u32le(d->ptr));
+          if (f != f) {
+            return invalid;
+          }
+          char buf[64];
+          print_line(d->ptr, 4, false, "      %s\n", format_float(buf, 64, f));
+          disassembler__advance(d, 4);
+        }
+        continue;
+      }
+    }
+
+    // Reserved opcodes.
+    bool line_to = opcode < 0xE0;
+    print_line(op, 1, true, "Reserved (%s)\n", line_to ? "LineTo" : "NOP");
+    d->pc++;
+    disassembler__advance(d, 1);
+    if (!disassembler__extra_data(d) ||
+        (line_to && !disassembler__coordinates(d, NULL, 2))) {
+      return invalid;
+    }
+  }
+  return NULL;
+}
+
+const char*  //
+disassemble() {
+  static const char* invalid = "main: invalid IconVG metadata";
+  disassembler d = {0};
+  d.ptr = g_src.ptr;
+  d.len = g_src.len;
+
+  if ((d.len < 4) || memcmp(d.ptr, "\x8A\x49\x56\x47", 4)) {
+    return "main: invalid IconVG magic identifier";
+  }
+  print_line(d.ptr, 4, false, "IconVG Magic Identifier\n");
+  disassembler__advance(&d, 4);
+
+  uint32_t num_metadata_chunks = 0;
+  size_t n = peek_natural(d.ptr, d.len, &num_metadata_chunks);
+  if (n == 0) {
+    return invalid;
+  }
+  print_line(d.ptr, n, false, "Number of metadata chunks: %d\n",
+             (int)num_metadata_chunks);
+  disassembler__advance(&d, n);
+
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    uint32_t length = 0;
+    n = peek_natural(d.ptr, d.len, &length);
+    if (n == 0) {
+      return invalid;
+    }
+    print_line(d.ptr, n, false, "Metadata chunk length: %d\n", (int)length);
+    disassembler__advance(&d, n);
+    if (d.len < length) {
+      return invalid;
+    }
+    size_t len_want = d.len - length;
+
+    uint32_t mid = 0;
+    n = peek_natural(d.ptr, d.len, &mid);
+    if ((n == 0) || (mid > 16)) {
+      return invalid;
+    }
+    print_line(d.ptr, n, false, "Metadata Identifier: %d (%s)\n", (int)mid,
+               (mid == 8) ? "ViewBox" : (mid == 16) ? "Suggested Palette" : "");
+    disassembler__advance(&d, n);
+
+    if (mid == 8) {
+      if (!disassembler__coordinates(&d, NULL, 4)) {
+        return invalid;
+      }
+    } else if (mid == 16) {
+      if ((d.len == 0) || ((d.ptr[0] >> 6) != 0)) {
+        return invalid;
+      }
+      int num_colors = 1 + (d.ptr[0] & 0x3F);
+      print_line(d.ptr, 1, false, "      %d palette colors\n", num_colors);
+      disassembler__advance(&d, 1);
+      for (int i = 0; i < num_colors; i++) {
+        if (d.len < 4) {
+          return invalid;
+        }
+        uint8_t c[4] = {d.ptr[0], d.ptr[1], d.ptr[2], d.ptr[3]};
+        if ((c[0] > c[3]) || (c[1] > c[3]) || (c[2] > c[3])) {
+          c[0] = 0x00;
+          c[1] = 0x00;
+          c[2] = 0x00;
+          c[3] = 0xFF;
+        }
+        print_line(d.ptr, 4, false, "      rgba(%02X:%02X:%02X:%02X)\n", c[0],
+                   c[1], c[2], c[3]);
+        disassembler__advance(&d, 4);
+      }
+    } else {
+      return invalid;
+    }
+
+    if (d.len != len_want) {
+      return invalid;
+    }
+  }
+
+  return disassembler__bytecode(&d);
+}
+
+// ----
+
+const char*  //
+parse_flags(int* argc, char** argv) {
+  g_flags.benchtime_nanos = 100 * 1000000;
+  g_flags.height = 256;
+  g_flags.costs = true;
+
+  int n = 1;
+  for (int i = 1; i < *argc; i++) {
+    const char* arg = argv[i];
+    if ((arg[0] != '-') || !strcmp(arg, "-")) {
+      argv[n++] = argv[i];
+      continue;
+    } else if (!strcmp(arg, "--")) {
+      for (i++; i < *argc; i++) {
+        argv[n++] = argv[i];
+      }
+      break;
+    }
+    if (arg[1] == '-') {
+      arg++;
+    }
+    if (!strncmp(arg, "-benchtime=", 11)) {
+      char* end = NULL;
+      unsigned long ms = strtoul(arg + 11, &end, 10);
+      if ((end == (arg + 11)) || *end || (ms > 3600000)) {
+        return "main: invalid -benchtime value";
+      }
+      g_flags.benchtime_nanos = ((uint64_t)ms) * 1000000;
+    } else if (!strncmp(arg, "-height=", 8)) {
+      char* end = NULL;
+      unsigned long h = strtoul(arg + 8, &end, 10);
+      if ((end == (arg + 8)) || *end || (h == 0) || (h > 0x7FFF)) {
+        return "main: invalid -height value";
+      }
+      g_flags.height = (uint32_t)h;
+    } else if (!strcmp(arg, "-nocosts")) {
+      g_flags.costs = false;
+    } else {
+      return "main: unrecognized flag";
+    }
+  }
+  *argc = n;
+  return NULL;
+}
+
+int  //
+main(int argc, char** argv) {
+  const char* err_msg = parse_flags(&argc, argv);
+  if (!err_msg && (argc > 2)) {
+    err_msg = "main: too many arguments";
+  }
+  if (err_msg) {
+    fprintf(stderr,
+            "%s\n"
+            "Usage: %s [-benchtime=N] [-height=N] [-nocosts] input.ivg\n",
+            err_msg, argv[0]);
+    return 1;
+  }
+
+  const char* filename = (argc == 2) ? argv[1] : "stdin";
+  err_msg = (argc == 2) ? iconvg_file__open(&g_src, argv[1], NULL)
+                        : iconvg_file__open_stream(&g_src, stdin, NULL);
+  if (err_msg) {
+    fprintf(stderr, "main: could not read %s\n%s\n", filename, err_msg);
+    return 1;
+  }
+
+  if (g_flags.costs) {
+    err_msg = measure_costs();
+    if (!err_msg) {
+      printf("%10s %10s\n", "wall_ns", "canvas_ns");
+    }
+  }
+  if (!err_msg) {
+    err_msg = disassemble();
+  }
+  if (err_msg) {
+    fprintf(stderr, "%s\n", err_msg);
+    return 1;
+  }
+
+  if (g_flags.costs) {
+    uint64_t total = g_prologue_nanos + g_epilogue_nanos;
+    for (size_t i = 0; i < g_src.len; i++) {
+      total += g_wall_nanos[i];
+    }
+    uint64_t t0 = monotonic_nanos();
+    for (int i = 0; i < 1000; i++) {
+      monotonic_nanos();
+    }
+    double clock_overhead = ((double)(monotonic_nanos() - t0)) / 1000;
+    fprintf(stderr,
+            "backend %s, %llu decodes, %.1f ns/decode "
+            "(%.1f ns header and metadata, %.1f ns after the last op), "
+            "%.1f ns per clock read\n",
+            BACKEND_NAME, (unsigned long long)g_num_decodes,
+            ((double)total) / ((double)g_num_decodes),
+            ((double)g_prologue_nanos) / ((double)g_num_decodes),
+            ((double)g_epilogue_nanos) / ((double)g_num_decodes),
+            clock_overhead);
+  }
+  return 0;
+}
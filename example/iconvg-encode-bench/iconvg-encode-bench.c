@@ -0,0 +1,309 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-encode-bench measures the throughput of iconvg_encoder, generating
+// status badges (the kind of icon that a server might make on the fly): a
+// rounded rectangle with a gradient, a status dot and a sparkline.
+//
+// Usage: iconvg-encode-bench [flags]
+//
+// Flags:
+//     -n=N         Number of icons. Defaults to 100000. Each icon differs in
+//                  its colors and sparkline.
+//     -points=N    Number of sparkline points. Defaults to 16.
+//     -reps=N      Number of repetitions. The fastest is reported. Defaults
+//                  to 5.
+//
+// There are two modes. The fixed mode encodes every icon into the same
+// caller-supplied buffer, with no grow_func. The grow mode starts every icon
+// with an empty buffer and a grow_func that calls realloc, freeing the buffer
+// after each icon. Every icon is checked by iconvg_validate, before timing.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+// FIXED_BUFFER_SIZE is the size (in bytes) of the fixed mode's buffer.
+#define FIXED_BUFFER_SIZE 65536
+
+struct {
+  uint32_t n;
+  uint32_t points;
+  uint32_t reps;
+} g_flags;
+
+uint8_t g_fixed_buffer[FIXED_BUFFER_SIZE];
+
+// ----
+
+uint64_t  //
+monotonic_nanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return 0;
+  }
+  return (((uint64_t)(ts.tv_sec)) * 1000000000) + ((uint64_t)(ts.tv_nsec));
+}
+
+// hash returns a pseudo-random number derived from x.
+uint32_t  //
+hash(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7FEB352D;
+  x ^= x >> 15;
+  x *= 0x846CA68B;
+  x ^= x >> 16;
+  return x;
+}
+
+const char*  //
+grow_with_realloc(void* grow_context,
+                  uint8_t** ptr,
+                  size_t* cap,
+                  size_t min_cap) {
+  size_t new_cap = *cap ? *cap : 256;
+  while (new_cap < min_cap) {
+    new_cap *= 2;
+  }
+  uint8_t* new_ptr = (uint8_t*)(realloc(*ptr, new_cap));
+  if (!new_ptr) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  *ptr = new_ptr;
+  *cap = new_cap;
+  return NULL;
+}
+
+// ----
+
+// encode_badge encodes the i'th icon.
+const char*  //
+encode_badge(iconvg_encoder* e, uint32_t i) {
+  uint32_t h = hash(i);
+  iconvg_rectangle_f32 viewbox = iconvg_rectangle_f32__make(0, 0, 48, 48);
+  iconvg_encoder__write_metadata(e, &viewbox, NULL);
+
+  // The background: a rounded rectangle filled with a vertical gradient
+  // between two shades of the status color.
+  iconvg_encoder__move_to(e, 8, 4);
+  iconvg_encoder__line_to(e, 40, 4);
+  iconvg_encoder__quad_to(e, 44, 4, 44, 8);
+  iconvg_encoder__line_to(e, 44, 40);
+  iconvg_encoder__quad_to(e, 44, 44, 40, 44);
+  iconvg_encoder__line_to(e, 8, 44);
+  iconvg_encoder__quad_to(e, 4, 44, 4, 40);
+  iconvg_encoder__line_to(e, 4, 8);
+  iconvg_encoder__quad_to(e, 4, 4, 8, 4);
+  uint64_t r = 0x40 + (h & 0x7F);
+  uint64_t g = 0x40 + ((h >> 7) & 0x7F);
+  uint64_t b = 0x40 + ((h >> 14) & 0x7F);
+  uint64_t stops[2] = {
+      0x00000000 | (((r << 0) | (g << 8) | (b << 16) | 0xFF000000) << 32),
+      0x00010000 |
+          ((((r / 2) << 0) | ((g / 2) << 8) | ((b / 2) << 16) | 0xFF000000)
+           << 32),
+  };
+  iconvg_encoder__set_registers(e, stops, 2);
+  iconvg_matrix_2x3_f64 m =
+      iconvg_matrix_2x3_f64__make(0, 1.0 / 40, -0.1, 0, 0, 0);
+  iconvg_encoder__fill_linear_gradient(e, 1, 2, ICONVG_GRADIENT_SPREAD__PAD,
+                                       &m);
+  iconvg_encoder__add_to_sel(e, 2);
+
+  // The status dot: a circle centered on (36, 12) with radius 5.
+  static const iconvg_premul_color dot_colors[4] = {
+      {{0x00, 0xC0, 0x00, 0xFF}},
+      {{0xFF, 0xC0, 0x00, 0xFF}},
+      {{0xFF, 0x00, 0x00, 0xFF}},
+      {{0x80, 0x80, 0x80, 0xFF}},
+  };
+  iconvg_encoder__move_to(e, 31, 12);
+  iconvg_encoder__ellipse(e, 4, 36, 7, 41, 12);
+  iconvg_encoder__fill_flat_color(e, dot_colors[(h >> 21) & 3]);
+
+  // The sparkline: a 1.5 unit thick band through the points, whose y
+  // coordinates are multiples of 1/64.
+  if (g_flags.points >= 2) {
+    float dx = 32.0f / (g_flags.points - 1);
+    iconvg_encoder__move_to(e, 8, 38);
+    for (uint32_t j = 0; j < g_flags.points; j++) {
+      float y = 38 - (hash(h + j) % 1024) / 64.0f;
+      iconvg_encoder__line_to(e, 8 + (j * dx), y);
+    }
+    for (uint32_t j = g_flags.points; j > 0; j--) {
+      float y = 38 - (hash(h + j - 1) % 1024) / 64.0f;
+      iconvg_encoder__line_to(e, 8 + ((j - 1) * dx), y + 1.5f);
+    }
+    iconvg_premul_color white = {{0xFF, 0xFF, 0xFF, 0xFF}};
+    iconvg_encoder__fill_flat_color(e, white);
+  }
+
+  return iconvg_encoder__finish(e);
+}
+
+// ----
+
+const char*  //
+run_fixed(uint64_t* total_len) {
+  *total_len = 0;
+  iconvg_encoder e;
+  for (uint32_t i = 0; i < g_flags.n; i++) {
+    iconvg_encoder__initialize(&e, g_fixed_buffer, FIXED_BUFFER_SIZE, NULL,
+                               NULL);
+    const char* err_msg = encode_badge(&e, i);
+    if (err_msg) {
+      return err_msg;
+    }
+    *total_len += e.len;
+  }
+  return NULL;
+}
+
+const char*  //
+run_grow(uint64_t* total_len) {
+  *total_len = 0;
+  iconvg_encoder e;
+  for (uint32_t i = 0; i < g_flags.n; i++) {
+    iconvg_encoder__initialize(&e, NULL, 0, &grow_with_realloc, NULL);
+    const char* err_msg = encode_badge(&e, i);
+    free(e.ptr);
+    if (err_msg) {
+      return err_msg;
+    }
+    *total_len += e.len;
+  }
+  return NULL;
+}
+
+const char*  //
+check_all() {
+  iconvg_encoder e;
+  for (uint32_t i = 0; i < g_flags.n; i++) {
+    iconvg_encoder__initialize(&e, g_fixed_buffer, FIXED_BUFFER_SIZE, NULL,
+                               NULL);
+    const char* err_msg = encode_badge(&e, i);
+    if (!err_msg) {
+      err_msg = iconvg_validate(e.ptr, e.len, NULL);
+    }
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+  return NULL;
+}
+
+// ----
+
+const char*  //
+parse_flags(int argc, char** argv) {
+  g_flags.n = 100000;
+  g_flags.points = 16;
+  g_flags.reps = 5;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (arg[0] != '-') {
+      return "main: unexpected argument";
+    }
+    if (arg[1] == '-') {
+      arg++;
+    }
+    if (!strncmp(arg, "-n=", 3) || !strncmp(arg, "-points=", 8) ||
+        !strncmp(arg, "-reps=", 6)) {
+      const char* eq = strchr(arg, '=') + 1;
+      char* end = NULL;
+      unsigned long x = strtoul(eq, &end, 10);
+      if ((end == eq) || *end || (x > 10000000)) {
+        return "main: invalid -n, -points or -reps value";
+      } else if (arg[1] == 'n') {
+        g_flags.n = (uint32_t)x;
+      } else if (arg[1] == 'p') {
+        if (x > 1000) {
+          return "main: invalid -n, -points or -reps value";
+        }
+        g_flags.points = (uint32_t)x;
+      } else {
+        g_flags.reps = (uint32_t)x;
+      }
+    } else {
+      return "main: unrecognized flag";
+    }
+  }
+  if ((g_flags.n == 0) || (g_flags.reps == 0)) {
+    return "main: invalid -n, -points or -reps value";
+  }
+  return NULL;
+}
+
+int  //
+main(int argc, char** argv) {
+  const char* err_msg = parse_flags(argc, argv);
+  if (err_msg) {
+    fprintf(stderr, "%s\nUsage: %s [-n=N] [-points=N] [-reps=N]\n", err_msg,
+            argv[0]);
+    return 1;
+  }
+  err_msg = check_all();
+  if (err_msg) {
+    fprintf(stderr, "main: %s\n", err_msg);
+    return 1;
+  }
+
+  uint64_t total_len = 0;
+  uint64_t fixed_nanos = UINT64_MAX;
+  uint64_t grow_nanos = UINT64_MAX;
+  for (uint32_t r = 0; r < g_flags.reps; r++) {
+    uint64_t now = monotonic_nanos();
+    err_msg = run_fixed(&total_len);
+    uint64_t fixed = monotonic_nanos() - now;
+    if (!err_msg) {
+      now = monotonic_nanos();
+      err_msg = run_grow(&total_len);
+    }
+    uint64_t grow = monotonic_nanos() - now;
+    if (err_msg) {
+      fprintf(stderr, "main: %s\n", err_msg);
+      return 1;
+    }
+    fixed_nanos = (fixed_nanos < fixed) ? fixed_nanos : fixed;
+    grow_nanos = (grow_nanos < grow) ? grow_nanos : grow;
+  }
+
+  printf("icons:  %u, %u sparkline points, best of %u\n", g_flags.n,
+         g_flags.points, g_flags.reps);
+  printf("size:   %.1f bytes/icon\n", ((double)total_len) / g_flags.n);
+  printf("fixed:  %10.3f ms  %12.0f icons/sec  %8.1f MB/s\n",
+         fixed_nanos / 1e6, g_flags.n / (fixed_nanos / 1e9),
+         total_len / (fixed_nanos / 1e3));
+  printf("grow:   %10.3f ms  %12.0f icons/sec  %8.1f MB/s\n",
+         grow_nanos / 1e6, g_flags.n / (grow_nanos / 1e9),
+         total_len / (grow_nanos / 1e3));
+  return 0;
+}
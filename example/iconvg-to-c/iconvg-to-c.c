@@ -0,0 +1,208 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-to-c compiles IconVG files ahead of time to C code. Each file
+// becomes a function that makes the canvas calls that iconvg_decode would
+// make, without running the bytecode interpreter:
+//
+//   const char* icon_foo(iconvg_canvas* dst_canvas,
+//                        iconvg_rectangle_f32 dst_rect,
+//                        const iconvg_decode_options* options);
+//
+// See iconvg_write_c_source for the details. The generated code still needs
+// linking against the IconVG library, for the iconvg_compiled_etc helpers and
+// the canvas implementations. It also compiles as C++.
+//
+// Usage: iconvg-to-c [flags] input.ivg... > output.c
+//
+// Flags:
+//     -header          Print only the functions' declarations, for a header
+//                      file to go with the generated code.
+//     -include=PATH    The IconVG header that the generated code #include's.
+//                      Defaults to "iconvg.h".
+//     -name=NAME       The function name, if there is only one input file.
+//                      Otherwise (and by default), each function's name is
+//                      "icon_" followed by the input file's base name, up to
+//                      the first '.', with non-alphanumeric bytes replaced by
+//                      '_'. For example, "dir/action-info.lores.ivg" becomes
+//                      "icon_action_info".
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+// MAX_NAME_SIZE is the largest size (in bytes) for function names.
+#define MAX_NAME_SIZE 256
+
+struct {
+  bool header;
+  const char* include;
+  const char* name;
+} g_flags;
+
+// ----
+
+// function_name sets dst to the function name for the given input file.
+void  //
+function_name(char* dst, const char* filename) {
+  if (g_flags.name) {
+    snprintf(dst, MAX_NAME_SIZE, "%s", g_flags.name);
+    return;
+  }
+  const char* base = strrchr(filename, '/');
+  base = base ? (base + 1) : filename;
+  size_t n = (size_t)snprintf(dst, MAX_NAME_SIZE, "icon_");
+  for (; *base && (*base != '.') && (n < (MAX_NAME_SIZE - 1)); base++) {
+    char c = *base;
+    bool alnum = (('0' <= c) && (c <= '9')) || (('A' <= c) && (c <= 'Z')) ||
+                 (('a' <= c) && (c <= 'z'));
+    dst[n++] = alnum ? c : '_';
+  }
+  dst[n] = '\x00';
+}
+
+bool  //
+is_valid_identifier(const char* s) {
+  if (!*s || (('0' <= *s) && (*s <= '9'))) {
+    return false;
+  }
+  for (; *s; s++) {
+    char c = *s;
+    if (!((('0' <= c) && (c <= '9')) || (('A' <= c) && (c <= 'Z')) ||
+          (('a' <= c) && (c <= 'z')) || (c == '_'))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char*  //
+parse_flags(int* argc, char** argv) {
+  g_flags.header = false;
+  g_flags.include = "iconvg.h";
+  g_flags.name = NULL;
+
+  int n = 1;
+  for (int i = 1; i < *argc; i++) {
+    const char* arg = argv[i];
+    if ((arg[0] != '-') || !strcmp(arg, "-")) {
+      argv[n++] = argv[i];
+      continue;
+    } else if (!strcmp(arg, "--")) {
+      for (i++; i < *argc; i++) {
+        argv[n++] = argv[i];
+      }
+      break;
+    }
+    if (arg[1] == '-') {
+      arg++;
+    }
+    if (!strcmp(arg, "-header")) {
+      g_flags.header = true;
+    } else if (!strncmp(arg, "-include=", 9)) {
+      g_flags.include = arg + 9;
+    } else if (!strncmp(arg, "-name=", 6)) {
+      g_flags.name = arg + 6;
+      if (!is_valid_identifier(g_flags.name) ||
+          (strlen(g_flags.name) >= MAX_NAME_SIZE)) {
+        return "main: invalid -name value";
+      }
+    } else {
+      return "main: unrecognized flag";
+    }
+  }
+  *argc = n;
+  return NULL;
+}
+
+int  //
+main(int argc, char** argv) {
+  const char* err_msg = parse_flags(&argc, argv);
+  if (!err_msg && (argc < 2)) {
+    err_msg = "main: no input files";
+  } else if (!err_msg && g_flags.name && (argc > 2)) {
+    err_msg = "main: -name requires exactly one input file";
+  }
+  if (err_msg) {
+    fprintf(stderr,
+            "%s\n"
+            "Usage: %s [-header] [-include=PATH] [-name=NAME] input.ivg...\n",
+            err_msg, argv[0]);
+    return 1;
+  }
+
+  printf("// Code generated by iconvg-to-c. DO NOT EDIT.\n\n");
+  if (!g_flags.header) {
+    printf("#include <math.h>\n#include <stdint.h>\n\n");
+  }
+  printf("#include \"%s\"\n\n", g_flags.include);
+  printf("#ifdef __cplusplus\nextern \"C\" {\n#endif\n");
+
+  char name[MAX_NAME_SIZE];
+  for (int i = 1; i < argc; i++) {
+    function_name(name, argv[i]);
+    if (!is_valid_identifier(name)) {
+      fprintf(stderr, "main: %s: invalid function name %s\n", argv[i], name);
+      return 1;
+    }
+
+    iconvg_file src = {0};
+    err_msg = iconvg_file__open(&src, argv[i], NULL);
+    if (!err_msg) {
+      err_msg = iconvg_validate(src.ptr, src.len, NULL);
+    }
+    if (!err_msg) {
+      if (g_flags.header) {
+        size_t indent = strlen(name) + 1;
+        printf(
+            "\n// %s is compiled from %s.\n"
+            "const char*  //\n"
+            "%s(iconvg_canvas* dst_canvas,\n"
+            "%*siconvg_rectangle_f32 dst_rect,\n"
+            "%*sconst iconvg_decode_options* options);\n",
+            name, argv[i], name, (int)indent, "", (int)indent, "");
+      } else {
+        printf("\n// ---------------- %s is compiled from %s.\n\n", name,
+               argv[i]);
+        err_msg = iconvg_write_c_source(stdout, name, src.ptr, src.len, NULL);
+      }
+    }
+    iconvg_file__close(&src);
+    if (err_msg) {
+      fprintf(stderr, "main: %s: %s\n", argv[i], err_msg);
+      return 1;
+    }
+  }
+
+  printf("\n#ifdef __cplusplus\n}  // extern \"C\"\n#endif\n");
+  fflush(stdout);
+  if (ferror(stdout)) {
+    fprintf(stderr, "main: could not write output\n");
+    return 1;
+  }
+  return 0;
+}
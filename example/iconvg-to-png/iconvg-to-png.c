@@ -14,18 +14,50 @@
 
 // ----------------
 
-// iconvg-to-png converts from IconVG to PNG (written to stdout).
+// iconvg-to-png converts from IconVG to PNG.
 //
 // Usage: iconvg-to-png input.ivg > output.png
 //     If input.ivg is omitted, it reads from stdin.
+//
+// Usage: iconvg-to-png -batch=manifest.txt [-j=N] [-pipeline[=R,D,E,W]]
+//                      [-queue=N]
+//     Converts every job in the manifest on N threads (N defaults to the
+//     number of online CPUs), then prints the throughput and the per-stage
+//     timings to stdout.
+//
+//     With -pipeline, each job instead flows through read, render (decode and
+//     rasterize), encode and write stages, with R, D, E and W threads
+//     respectively and bounded queues of -queue=N (default 16) jobs in
+//     between. This keeps the disk and the CPUs busy at the same time. R and W
+//     default to 2 and 1, D and E to the -j value. The report then gives each
+//     stage's utilization: how much of its threads' time was spent busy,
+//     waiting for input (starved) or waiting for output (pushed back).
+//
+// A manifest has one job per line, with four space-separated fields: the
+// input path, the size (N or WxH, in pixels), the palette and the output path.
+// The palette is "-" for the input's suggested palette or else a
+// comma-separated list of up to 64 non-alpha-premultiplied RRGGBBAA colors,
+// the remaining colors being opaque black (as per the default palette). Blank
+// lines and lines starting with '#' are ignored. Paths cannot contain spaces.
+//
+// Consecutive jobs with the same input path (such as one icon at several
+// sizes) are handed out together, so that the input is read once. Each thread
+// keeps its pixel buffer (while the size doesn't change) and its PNG encoding
+// buffers from one job to the next. A failed job is reported to stderr and
+// doesn't stop the others, but makes the exit code non-zero.
+
+#define _POSIX_C_SOURCE 200809L
 
 #include <errno.h>
 #include <png.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 // IconVG ships as a "single file C library" or "header file library" as per
 // https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
@@ -36,17 +68,6 @@
 #define ICONVG_IMPLEMENTATION
 #include "../../release/c/iconvg-unsupported-snapshot.c"
 
-// SRC_BUFFER_ARRAY_SIZE is the largest size (in bytes) for .ivg files
-// supported by this program.
-//
-// This is 1 MiB (1024 * 1024 = 1048576 bytes) by default, but can be
-// configured by compiling with -DSRC_BUFFER_ARRAY_SIZE=etc.
-#ifndef SRC_BUFFER_ARRAY_SIZE
-#define SRC_BUFFER_ARRAY_SIZE 1048576
-#endif
-
-uint8_t g_src_buffer_array[SRC_BUFFER_ARRAY_SIZE];
-
 typedef struct {
   uint8_t* data;
   uint32_t width;
@@ -96,6 +117,26 @@ flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
   return NULL;
 }
 
+const char*  //
+clear_pixel_buffer(pixel_buffer* pb) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  }
+  cairo_surface_t* cs = (cairo_surface_t*)(pb->extra0);
+  if (!cs) {
+    return "main: NULL cairo_surface_t";
+  }
+  cairo_surface_flush(cs);
+  uint8_t* data = cairo_image_surface_get_data(cs);
+  if (data) {
+    memset(data, 0,
+           ((size_t)(cairo_image_surface_get_stride(cs))) *
+               ((size_t)(cairo_image_surface_get_height(cs))));
+  }
+  cairo_surface_mark_dirty(cs);
+  return NULL;
+}
+
 const char*  //
 finalize_pixel_buffer(pixel_buffer* pb) {
   if (!pb) {
@@ -167,6 +208,16 @@ flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
   return NULL;
 }
 
+const char*  //
+clear_pixel_buffer(pixel_buffer* pb) {
+  if (!pb) {
+    return "main: NULL pixel_buffer";
+  } else if (pb->data) {
+    memset(pb->data, 0, 4 * pb->width * pb->height);
+  }
+  return NULL;
+}
+
 const char*  //
 finalize_pixel_buffer(pixel_buffer* pb) {
   if (!pb) {
@@ -200,6 +251,11 @@ flush_pixel_buffer(pixel_buffer* pb, uint32_t width, uint32_t height) {
   return "main: no IconVG backend configured";
 }
 
+const char*  //
+clear_pixel_buffer(pixel_buffer* pb) {
+  return "main: no IconVG backend configured";
+}
+
 const char*  //
 finalize_pixel_buffer(pixel_buffer* pb) {
   return "main: no IconVG backend configured";
@@ -209,65 +265,73 @@ finalize_pixel_buffer(pixel_buffer* pb) {
 
 // ----
 
-bool  //
-read_file(size_t* dst_num_bytes_read,
-          uint8_t* dst_buffer_ptr,
-          size_t dst_buffer_len,
-          FILE* src_file,
-          const char* src_filename) {
-  if (!dst_num_bytes_read || !src_file || !src_filename) {
-    return false;
-  }
-  *dst_num_bytes_read = 0;
-  uint8_t placeholder[1];
-  uint8_t* ptr = dst_buffer_ptr;
-  size_t len = dst_buffer_len;
-  while (true) {
-    if (!len) {
-      // We have read all that dst can hold. Check that we have read the full
-      // file by trying to read one more byte, which should fail with EOF.
-      ptr = placeholder;
-      len = 1;
-    }
-    size_t n = fread(ptr, 1, len, src_file);
-    if (ptr != placeholder) {
-      ptr += n;
-      len -= n;
-      *dst_num_bytes_read += n;
-    } else if (n) {
-      fprintf(stderr, "main: %s file size (in bytes) is too large\n",
-              src_filename);
-      return false;
-    }
-    if (feof(src_file)) {
-      break;
+// png_encoder holds the memory that encode_png reuses from one image to the
+// next. libpng has no way to reset a png_struct for another image, so those
+// (and their png_info) are created afresh each time.
+typedef struct {
+  png_byte** rows;
+  uint32_t rows_cap;
+  uint8_t* dst_ptr;
+  size_t dst_len;
+  size_t dst_cap;
+} png_encoder;
+
+void  //
+png_encoder__finalize(png_encoder* e) {
+  free(e->rows);
+  free(e->dst_ptr);
+  *e = ((png_encoder){0});
+}
+
+void  //
+png_encoder__write(png_structp png, png_bytep data, png_size_t length) {
+  png_encoder* e = (png_encoder*)(png_get_io_ptr(png));
+  if ((e->dst_cap - e->dst_len) < length) {
+    size_t cap = e->dst_cap ? e->dst_cap : 65536;
+    while ((cap - e->dst_len) < length) {
+      if (cap > (SIZE_MAX / 2)) {
+        png_error(png, "main: PNG output is too large");
+      }
+      cap *= 2;
     }
-    int err = ferror(src_file);
-    if (!err) {
-      continue;
-    } else if (err == EINTR) {
-      clearerr(src_file);
-      continue;
+    uint8_t* ptr = realloc(e->dst_ptr, cap);
+    if (!ptr) {
+      png_error(png, "main: could not allocate PNG output");
     }
-    fprintf(stderr, "main: could not read %s: %s\n", src_filename,
-            strerror(err));
-    return false;
+    e->dst_ptr = ptr;
+    e->dst_cap = cap;
   }
-  return true;
+  memcpy(e->dst_ptr + e->dst_len, data, length);
+  e->dst_len += length;
 }
 
-// ----
+void  //
+png_encoder__flush(png_structp png) {}
 
+// encode_png encodes pb (which should be non-alpha-premultiplied) as PNG. It
+// writes to f if non-NULL, otherwise to e->dst_ptr[.. e->dst_len].
 const char*  //
-write_png_to_stdout(pixel_buffer* pb) {
-  if (!pb || (pb->width > 0x7FFF) || (pb->height > 0x7FFF)) {
-    return "main: invalid write_png_to_stdout argument";
+encode_png(png_encoder* e, pixel_buffer* pb, FILE* f) {
+  if (!e || !pb || (pb->width > 0x7FFF) || (pb->height > 0x7FFF)) {
+    return "main: invalid encode_png argument";
+  }
+  e->dst_len = 0;
+  if (e->rows_cap < pb->height) {
+    png_byte** rows = realloc(e->rows, pb->height * sizeof(png_byte*));
+    if (!rows) {
+      return "main: could not allocate PNG rows";
+    }
+    e->rows = rows;
+    e->rows_cap = pb->height;
+  }
+  for (uint32_t i = 0; i < pb->height; i++) {
+    const size_t bytes_per_pixel = 4;
+    e->rows[i] = pb->data + (i * bytes_per_pixel * pb->width);
   }
 
   const char* ret = NULL;
   png_structp png = NULL;
   png_infop info = NULL;
-  png_byte** rows = NULL;
 
   {
     png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -285,67 +349,1144 @@ write_png_to_stdout(pixel_buffer* pb) {
       goto exit;
     }
 
-    rows = malloc(pb->height * sizeof(png_byte*));
-    for (uint32_t i = 0; i < pb->height; i++) {
-      const size_t bytes_per_pixel = 4;
-      rows[i] = pb->data + (i * bytes_per_pixel * pb->width);
+    if (f) {
+      png_init_io(png, f);
+    } else {
+      png_set_write_fn(png, e, &png_encoder__write, &png_encoder__flush);
     }
-    png_init_io(png, stdout);
     png_set_IHDR(png, info, pb->width, pb->height, 8, PNG_COLOR_TYPE_RGBA,
                  PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
                  PNG_FILTER_TYPE_DEFAULT);
-    png_set_rows(png, info, rows);
+    png_set_rows(png, info, e->rows);
     png_write_png(png, info, PNG_TRANSFORM_BGR, NULL);
   }
 
 exit:
-  if (rows) {
-    free(rows);
-  }
   if (png) {
     png_destroy_write_struct(&png, &info);
   }
   return ret;
 }
 
+const char*  //
+write_png_to_stdout(pixel_buffer* pb) {
+  png_encoder e = {0};
+  const char* ret = encode_png(&e, pb, stdout);
+  png_encoder__finalize(&e);
+  return ret;
+}
+
+// unpremultiply_pixel_buffer converts from premultiplied alpha to
+// non-premultiplied alpha. CAIRO_FORMAT_ARGB32 uses the former, as does Skia
+// with PREMUL_SK_ALPHATYPE. libpng uses the latter.
+void  //
+unpremultiply_pixel_buffer(pixel_buffer* pb) {
+  for (uint32_t y = 0; y < pb->height; y++) {
+    const size_t bytes_per_pixel = 4;
+    uint8_t* row = pb->data + (y * bytes_per_pixel * pb->width);
+    for (uint32_t x = 0; x < pb->width; x++) {
+      uint8_t* rgba = row + (x * bytes_per_pixel);
+      if ((rgba[3] != 0x00) && (rgba[3] != 0xFF)) {
+        uint32_t a = rgba[3];
+        rgba[0] = (uint8_t)((rgba[0] * ((uint32_t)0xFF)) / a);
+        rgba[1] = (uint8_t)((rgba[1] * ((uint32_t)0xFF)) / a);
+        rgba[2] = (uint8_t)((rgba[2] * ((uint32_t)0xFF)) / a);
+      }
+    }
+  }
+}
+
+// ----
+
+struct {
+  const char* batch;
+  uint32_t j;
+  bool pipeline;
+  // pipeline_threads holds the per-stage thread counts, zero meaning the
+  // default.
+  uint32_t pipeline_threads[4];
+  uint32_t queue;
+} g_flags;
+
+uint64_t  //
+monotonic_nanos() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return 0;
+  }
+  return (((uint64_t)(ts.tv_sec)) * 1000000000) + ((uint64_t)(ts.tv_nsec));
+}
+
+// parse_palette parses a manifest's palette field (other than "-").
+const char*  //
+parse_palette(iconvg_palette* dst, const char* s) {
+  for (int i = 0; i < 64; i++) {
+    dst->colors[i] = ((iconvg_premul_color){{0x00, 0x00, 0x00, 0xFF}});
+  }
+  for (int i = 0; *s; i++) {
+    if (i == 64) {
+      return "main: too many palette colors";
+    }
+    uint32_t u = 0;
+    for (int k = 0; k < 8; k++, s++) {
+      char c = *s;
+      if (('0' <= c) && (c <= '9')) {
+        u = (u << 4) | ((uint32_t)(c - '0'));
+      } else if (('A' <= c) && (c <= 'F')) {
+        u = (u << 4) | ((uint32_t)(c - 'A' + 10));
+      } else if (('a' <= c) && (c <= 'f')) {
+        u = (u << 4) | ((uint32_t)(c - 'a' + 10));
+      } else {
+        return "main: invalid palette color";
+      }
+    }
+    if (*s == ',') {
+      s++;
+      if (!*s) {
+        return "main: invalid palette color";
+      }
+    } else if (*s) {
+      return "main: invalid palette color";
+    }
+    uint32_t a = u & 0xFF;
+    for (int k = 0; k < 3; k++) {
+      uint32_t c = (u >> (24 - (8 * k))) & 0xFF;
+      dst->colors[i].rgba[k] = (uint8_t)(((c * a) + 127) / 255);
+    }
+    dst->colors[i].rgba[3] = (uint8_t)a;
+  }
+  return NULL;
+}
+
+// ----
+
+typedef struct {
+  const char* input;
+  const char* output;
+  // palette is NULL for the input's suggested palette.
+  const char* palette;
+  uint32_t width;
+  uint32_t height;
+  uint32_t line;
+  bool same_input_as_previous;
+} batch_job;
+
+// g_manifest holds the manifest's contents, NUL-terminated. Its lines are
+// split into fields in place, which g_jobs' strings point to.
+char* g_manifest = NULL;
+
+batch_job* g_jobs = NULL;
+size_t g_num_jobs = 0;
+size_t g_cap_jobs = 0;
+
+// MAX_JOBS_PER_CLAIM bounds how many consecutive same-input jobs a thread
+// claims at once, so that a manifest that repeats one input many times
+// still spreads across the threads.
+#define MAX_JOBS_PER_CLAIM 16
+
+pthread_mutex_t g_next_job_mutex = PTHREAD_MUTEX_INITIALIZER;
+size_t g_next_job = 0;
+
+const char*  //
+parse_batch_job(batch_job* job, char** fields) {
+  char* end = NULL;
+  unsigned long w = strtoul(fields[1], &end, 10);
+  unsigned long h = w;
+  if ((end != fields[1]) && (*end == 'x')) {
+    const char* hs = end + 1;
+    h = strtoul(hs, &end, 10);
+    if (end == hs) {
+      return "main: invalid size";
+    }
+  }
+  if ((end == fields[1]) || *end || (w == 0) || (w > 0x7FFF) || (h == 0) ||
+      (h > 0x7FFF)) {
+    return "main: invalid size";
+  }
+
+  const char* palette = NULL;
+  if (strcmp(fields[2], "-")) {
+    iconvg_palette scratch;
+    const char* err_msg = parse_palette(&scratch, fields[2]);
+    if (err_msg) {
+      return err_msg;
+    }
+    palette = fields[2];
+  }
+
+  job->input = fields[0];
+  job->output = fields[3];
+  job->palette = palette;
+  job->width = (uint32_t)w;
+  job->height = (uint32_t)h;
+  return NULL;
+}
+
+const char*  //
+load_manifest(const char* filename) {
+  FILE* f = fopen(filename, "r");
+  if (!f) {
+    fprintf(stderr, "main: could not open %s: %s\n", filename,
+            strerror(errno));
+    return "main: could not read the manifest";
+  }
+  size_t len = 0;
+  size_t cap = 0;
+  while (true) {
+    if ((cap - len) < 2) {
+      cap = cap ? (cap * 2) : 65536;
+      char* ptr = realloc(g_manifest, cap);
+      if (!ptr) {
+        fclose(f);
+        return "main: could not allocate the manifest";
+      }
+      g_manifest = ptr;
+    }
+    len += fread(g_manifest + len, 1, cap - len - 1, f);
+    if (feof(f)) {
+      break;
+    } else if (ferror(f)) {
+      fclose(f);
+      return "main: could not read the manifest";
+    }
+  }
+  fclose(f);
+  g_manifest[len] = '\x00';
+
+  uint32_t line = 0;
+  for (char* p = g_manifest; *p;) {
+    line++;
+    char* eol = strchr(p, '\n');
+    char* next = eol ? (eol + 1) : (p + strlen(p));
+    if (eol) {
+      *eol = '\x00';
+    }
+
+    char* fields[4];
+    int num_fields = 0;
+    for (char* q = p; true;) {
+      while ((*q == ' ') || (*q == '\t') || (*q == '\r')) {
+        q++;
+      }
+      if (!*q || ((num_fields == 0) && (*q == '#'))) {
+        break;
+      } else if (num_fields == 4) {
+        num_fields++;
+        break;
+      }
+      fields[num_fields++] = q;
+      while (*q && (*q != ' ') && (*q != '\t') && (*q != '\r')) {
+        q++;
+      }
+      if (*q) {
+        *q++ = '\x00';
+      }
+    }
+    p = next;
+    if (num_fields == 0) {
+      continue;
+    }
+
+    if (g_num_jobs == g_cap_jobs) {
+      size_t new_cap = g_cap_jobs ? (g_cap_jobs * 2) : 256;
+      batch_job* new_jobs = realloc(g_jobs, new_cap * sizeof(batch_job));
+      if (!new_jobs) {
+        return "main: could not allocate the jobs";
+      }
+      g_jobs = new_jobs;
+      g_cap_jobs = new_cap;
+    }
+    batch_job* job = &g_jobs[g_num_jobs];
+    const char* err_msg = (num_fields != 4) ? "main: expected four fields"
+                                            : parse_batch_job(job, fields);
+    if (err_msg) {
+      fprintf(stderr, "main: could not parse %s line %u\n", filename, line);
+      return err_msg;
+    }
+    job->line = line;
+    job->same_input_as_previous =
+        (g_num_jobs > 0) && !strcmp(job->input, g_jobs[g_num_jobs - 1].input);
+    g_num_jobs++;
+  }
+  return NULL;
+}
+
+// ----
+
+bool  //
+claim_batch_jobs(size_t* i, size_t* j) {
+  pthread_mutex_lock(&g_next_job_mutex);
+  size_t k = g_next_job;
+  bool ok = k < g_num_jobs;
+  if (ok) {
+    *i = k;
+    size_t limit = ((g_num_jobs - k) < MAX_JOBS_PER_CLAIM)
+                       ? g_num_jobs
+                       : (k + MAX_JOBS_PER_CLAIM);
+    for (k++; (k < limit) && g_jobs[k].same_input_as_previous; k++) {
+    }
+    *j = k;
+    g_next_job = k;
+  }
+  pthread_mutex_unlock(&g_next_job_mutex);
+  return ok;
+}
+
+// write_output writes e's encoded PNG to the output file. It runs on worker
+// threads, so its error messages are fixed strings (strerror isn't
+// thread-safe).
+const char*  //
+write_output(const png_encoder* e, const char* filename) {
+  FILE* out = fopen(filename, "wb");
+  if (!out) {
+    return "main: could not open the output";
+  }
+  size_t n = fwrite(e->dst_ptr, 1, e->dst_len, out);
+  if ((fclose(out) != 0) || (n != e->dst_len)) {
+    return "main: could not write the output";
+  }
+  return NULL;
+}
+
+// batch_renderer is a pixel buffer (and a parsed custom palette) that is
+// reused from one job to the next, for as long as the size doesn't change.
+typedef struct {
+  pixel_buffer pb;
+  bool has_pb;
+  uint32_t width;
+  uint32_t height;
+
+  iconvg_palette palette;
+  // palette_string is the manifest palette field that palette holds, if any.
+  const char* palette_string;
+} batch_renderer;
+
+void  //
+batch_renderer__finalize(batch_renderer* r) {
+  if (r->has_pb) {
+    finalize_pixel_buffer(&r->pb);
+    r->has_pb = false;
+  }
+}
+
+// batch_renderer__render decodes src_ptr[.. src_len] onto r->pb, which is
+// left alpha-premultiplied.
+const char*  //
+batch_renderer__render(batch_renderer* r,
+                       const batch_job* job,
+                       const uint8_t* src_ptr,
+                       size_t src_len) {
+  if (r->has_pb && ((r->width != job->width) || (r->height != job->height))) {
+    r->has_pb = false;
+    const char* err_msg = finalize_pixel_buffer(&r->pb);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+  if (!r->has_pb) {
+    const char* err_msg =
+        initialize_pixel_buffer(&r->pb, job->width, job->height);
+    if (err_msg) {
+      return err_msg;
+    }
+    r->has_pb = true;
+    r->width = job->width;
+    r->height = job->height;
+  } else {
+    const char* err_msg = clear_pixel_buffer(&r->pb);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+
+  iconvg_decode_options opts = {0};
+  opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+  if (job->palette) {
+    if (!r->palette_string || strcmp(r->palette_string, job->palette)) {
+      r->palette_string = NULL;
+      const char* err_msg = parse_palette(&r->palette, job->palette);
+      if (err_msg) {
+        return err_msg;
+      }
+      r->palette_string = job->palette;
+    }
+    opts.palette = &r->palette;
+  }
+
+  const char* err_msg = iconvg_decode(
+      &r->pb.canvas, iconvg_rectangle_f32__make(0, 0, job->width, job->height),
+      src_ptr, src_len, &opts);
+  if (err_msg) {
+    return err_msg;
+  }
+  return flush_pixel_buffer(&r->pb, job->width, job->height);
+}
+
+void  //
+print_batch_summary(uint64_t num_ok,
+                    uint64_t num_failed,
+                    uint32_t num_threads,
+                    uint64_t num_bytes_written,
+                    uint64_t wall_nanos) {
+  double wall_seconds = ((double)wall_nanos) / 1e9;
+  if (wall_seconds <= 0) {
+    wall_seconds = 1e-9;
+  }
+  printf("jobs:        %llu ok, %llu failed, on %u threads\n",
+         (unsigned long long)num_ok, (unsigned long long)num_failed,
+         num_threads);
+  printf("wall time:   %.3f s\n", wall_seconds);
+  printf("throughput:  %.1f images/s, %.2f MB/s of PNG output\n",
+         ((double)num_ok) / wall_seconds,
+         ((double)num_bytes_written) / (wall_seconds * 1e6));
+  printf("\n");
+}
+
+// ----
+
+typedef enum {
+  BATCH_STAGE__READ,
+  BATCH_STAGE__RENDER,
+  BATCH_STAGE__UNPREMULTIPLY,
+  BATCH_STAGE__ENCODE,
+  BATCH_STAGE__WRITE,
+  BATCH_STAGE__COUNT,
+} batch_stage;
+
+const char* g_batch_stage_names[BATCH_STAGE__COUNT] = {
+    "read",           //
+    "render",         //
+    "unpremultiply",  //
+    "encode",         //
+    "write",          //
+};
+
+// batch_worker is one thread's state. Its buffers are reused across jobs.
+typedef struct {
+  pthread_t thread;
+
+  iconvg_file src;
+  // src_input is the input path that src holds, if any.
+  const char* src_input;
+
+  batch_renderer renderer;
+  png_encoder encoder;
+
+  uint64_t num_ok;
+  uint64_t num_failed;
+  uint64_t num_bytes_written;
+  uint64_t nanos[BATCH_STAGE__COUNT];
+} batch_worker;
+
+const char*  //
+batch_worker__run(batch_worker* w, const batch_job* job) {
+  uint64_t nanos[BATCH_STAGE__COUNT + 1];
+  nanos[0] = monotonic_nanos();
+
+  if (!w->src_input || strcmp(w->src_input, job->input)) {
+    w->src_input = NULL;
+    iconvg_file__close(&w->src);
+    const char* err_msg = iconvg_file__open(&w->src, job->input, NULL);
+    if (err_msg) {
+      return err_msg;
+    }
+    w->src_input = job->input;
+  }
+  nanos[1] = monotonic_nanos();
+
+  {
+    const char* err_msg =
+        batch_renderer__render(&w->renderer, job, w->src.ptr, w->src.len);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+  nanos[2] = monotonic_nanos();
+
+  unpremultiply_pixel_buffer(&w->renderer.pb);
+  nanos[3] = monotonic_nanos();
+
+  {
+    const char* err_msg = encode_png(&w->encoder, &w->renderer.pb, NULL);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+  nanos[4] = monotonic_nanos();
+
+  {
+    const char* err_msg = write_output(&w->encoder, job->output);
+    if (err_msg) {
+      return err_msg;
+    }
+  }
+  nanos[5] = monotonic_nanos();
+
+  for (int i = 0; i < BATCH_STAGE__COUNT; i++) {
+    w->nanos[i] += nanos[i + 1] - nanos[i];
+  }
+  w->num_bytes_written += w->encoder.dst_len;
+  return NULL;
+}
+
+void*  //
+batch_worker__main(void* arg) {
+  batch_worker* w = (batch_worker*)arg;
+  size_t i = 0;
+  size_t j = 0;
+  while (claim_batch_jobs(&i, &j)) {
+    for (; i < j; i++) {
+      const char* err_msg = batch_worker__run(w, &g_jobs[i]);
+      if (err_msg) {
+        fprintf(stderr, "main: could not convert %s (manifest line %u)\n%s\n",
+                g_jobs[i].input, g_jobs[i].line, err_msg);
+        w->num_failed++;
+      } else {
+        w->num_ok++;
+      }
+    }
+  }
+  return NULL;
+}
+
+void  //
+print_batch_report(const batch_worker* workers,
+                   uint32_t num_workers,
+                   uint64_t wall_nanos) {
+  uint64_t num_ok = 0;
+  uint64_t num_failed = 0;
+  uint64_t num_bytes_written = 0;
+  uint64_t nanos[BATCH_STAGE__COUNT] = {0};
+  uint64_t total_nanos = 0;
+  for (uint32_t i = 0; i < num_workers; i++) {
+    num_ok += workers[i].num_ok;
+    num_failed += workers[i].num_failed;
+    num_bytes_written += workers[i].num_bytes_written;
+    for (int k = 0; k < BATCH_STAGE__COUNT; k++) {
+      nanos[k] += workers[i].nanos[k];
+      total_nanos += workers[i].nanos[k];
+    }
+  }
+
+  print_batch_summary(num_ok, num_failed, num_workers, num_bytes_written,
+                      wall_nanos);
+  printf("stage          thread-seconds  us/image   share\n");
+  for (int k = 0; k < BATCH_STAGE__COUNT; k++) {
+    printf("%-14s %14.3f %9.1f %6.1f%%\n", g_batch_stage_names[k],
+           ((double)nanos[k]) / 1e9,
+           num_ok ? (((double)nanos[k]) / (1e3 * ((double)num_ok))) : 0.0,
+           total_nanos ? ((100.0 * ((double)nanos[k])) / ((double)total_nanos))
+                       : 0.0);
+  }
+}
+
+uint32_t  //
+num_online_cpus() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return ((n > 0) && (n < 1024)) ? ((uint32_t)n) : 1;
+}
+
+int  //
+run_batch() {
+  uint32_t num_workers = g_flags.j ? g_flags.j : num_online_cpus();
+  if (num_workers > g_num_jobs) {
+    num_workers = g_num_jobs ? ((uint32_t)g_num_jobs) : 1;
+  }
+
+  batch_worker* workers = calloc(num_workers, sizeof(batch_worker));
+  if (!workers) {
+    fprintf(stderr, "main: could not allocate the workers\n");
+    return 1;
+  }
+
+  uint64_t start = monotonic_nanos();
+  uint32_t num_started = 0;
+  for (; num_started < num_workers; num_started++) {
+    if (pthread_create(&workers[num_started].thread, NULL, &batch_worker__main,
+                       &workers[num_started])) {
+      break;
+    }
+  }
+  if (num_started == 0) {
+    fprintf(stderr, "main: could not create any threads\n");
+    return 1;
+  }
+  for (uint32_t i = 0; i < num_started; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  uint64_t wall_nanos = monotonic_nanos() - start;
+
+  print_batch_report(workers, num_started, wall_nanos);
+
+  bool failed = false;
+  for (uint32_t i = 0; i < num_workers; i++) {
+    failed = failed || (workers[i].num_failed > 0);
+    batch_renderer__finalize(&workers[i].renderer);
+    png_encoder__finalize(&workers[i].encoder);
+    iconvg_file__close(&workers[i].src);
+  }
+  free(workers);
+  return failed ? 1 : 0;
+}
+
+// ----
+
+// The -pipeline mode runs each stage of a job on its own pool of threads:
+//
+//   (free items) -> read -> render -> encode -> write -> (free items)
+//
+// A fixed number of batch_item values circulate through bounded queues
+// between the stages, each item carrying one job. An item keeps its buffers
+// (the pixel buffer and the PNG output) when recycled, and the pixel buffer is
+// handed from the render stage to the encode stage without copying. A full
+// queue blocks its producers and an empty one its consumers, so the slowest
+// stage sets the pace and the others neither race ahead nor buffer without
+// bound.
+
+// batch_source is an input file shared by a run of same-input items. The
+// render stage, its last user, releases each item's reference.
+typedef struct {
+  iconvg_file file;
+  size_t num_refs;
+} batch_source;
+
+pthread_mutex_t g_batch_sources_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+const char*  //
+batch_source__open(batch_source** dst, const char* filename, size_t num_refs) {
+  *dst = NULL;
+  batch_source* s = calloc(1, sizeof(batch_source));
+  if (!s) {
+    return "main: could not allocate the source";
+  }
+  const char* err_msg = iconvg_file__open(&s->file, filename, NULL);
+  if (err_msg) {
+    free(s);
+    return err_msg;
+  }
+  // Touch every page, so that any disk reads happen here, in the read stage,
+  // instead of as page faults in the render stage.
+  if (s->file.is_mapped) {
+    volatile uint8_t sink = 0;
+    for (size_t i = 0; i < s->file.len; i += 4096) {
+      sink ^= s->file.ptr[i];
+    }
+  }
+  s->num_refs = num_refs;
+  *dst = s;
+  return NULL;
+}
+
+void  //
+batch_source__release(batch_source* s) {
+  pthread_mutex_lock(&g_batch_sources_mutex);
+  bool last = --s->num_refs == 0;
+  pthread_mutex_unlock(&g_batch_sources_mutex);
+  if (last) {
+    iconvg_file__close(&s->file);
+    free(s);
+  }
+}
+
+typedef struct {
+  const batch_job* job;
+  // err_msg, if non-NULL, is why an earlier stage failed. Later stages skip
+  // the item and the write stage reports it.
+  const char* err_msg;
+
+  // src is NULL after the render stage, or if the read stage failed.
+  batch_source* src;
+
+  batch_renderer renderer;
+  png_encoder encoder;
+} batch_item;
+
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+  batch_item** ptrs;
+  size_t cap;
+  size_t head;
+  size_t len;
+  // num_producers counts the threads that may still push. Once it is zero,
+  // item_queue__pop returns NULL instead of waiting on an empty queue.
+  uint32_t num_producers;
+} item_queue;
+
+const char*  //
+item_queue__initialize(item_queue* q, size_t cap, uint32_t num_producers) {
+  *q = ((item_queue){0});
+  q->ptrs = calloc(cap, sizeof(batch_item*));
+  if (!q->ptrs) {
+    return "main: could not allocate a queue";
+  }
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->not_empty, NULL);
+  pthread_cond_init(&q->not_full, NULL);
+  q->cap = cap;
+  q->num_producers = num_producers;
+  return NULL;
+}
+
+void  //
+item_queue__finalize(item_queue* q) {
+  if (q->ptrs) {
+    pthread_cond_destroy(&q->not_full);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_mutex_destroy(&q->mutex);
+    free(q->ptrs);
+  }
+  *q = ((item_queue){0});
+}
+
+void  //
+item_queue__push(item_queue* q, batch_item* item) {
+  pthread_mutex_lock(&q->mutex);
+  while (q->len == q->cap) {
+    pthread_cond_wait(&q->not_full, &q->mutex);
+  }
+  q->ptrs[(q->head + q->len) % q->cap] = item;
+  q->len++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+batch_item*  //
+item_queue__pop(item_queue* q) {
+  pthread_mutex_lock(&q->mutex);
+  while ((q->len == 0) && (q->num_producers > 0)) {
+    pthread_cond_wait(&q->not_empty, &q->mutex);
+  }
+  batch_item* item = NULL;
+  if (q->len > 0) {
+    item = q->ptrs[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->len--;
+    pthread_cond_signal(&q->not_full);
+  }
+  pthread_mutex_unlock(&q->mutex);
+  return item;
+}
+
+// item_queue__close_one records that one of q's producers has finished.
+void  //
+item_queue__close_one(item_queue* q) {
+  pthread_mutex_lock(&q->mutex);
+  if ((q->num_producers > 0) && (--q->num_producers == 0)) {
+    pthread_cond_broadcast(&q->not_empty);
+  }
+  pthread_mutex_unlock(&q->mutex);
+}
+
+typedef enum {
+  PIPELINE_STAGE__READ,
+  PIPELINE_STAGE__RENDER,
+  PIPELINE_STAGE__ENCODE,
+  PIPELINE_STAGE__WRITE,
+  PIPELINE_STAGE__COUNT,
+} pipeline_stage;
+
+const char* g_pipeline_stage_names[PIPELINE_STAGE__COUNT] = {
+    "read",    //
+    "render",  //
+    "encode",  //
+    "write",   //
+};
+
+// g_pipeline_queues[s] is stage s's input queue. The read stage's input is
+// the free list, which the write stage refills.
+item_queue g_pipeline_queues[PIPELINE_STAGE__COUNT];
+
+typedef struct {
+  pthread_t thread;
+  pipeline_stage stage;
+
+  uint64_t num_items;
+  uint64_t busy_nanos;
+  uint64_t wait_for_input_nanos;
+  uint64_t wait_for_output_nanos;
+
+  // These are only used by write threads.
+  uint64_t num_ok;
+  uint64_t num_failed;
+  uint64_t num_bytes_written;
+} pipeline_thread;
+
+// pipeline_thread__read_jobs is the read stage's loop. It takes free items
+// (waiting on the free list counts as waiting for output, as it is how the
+// later stages push back) and opens the input once per claimed run of
+// same-input jobs.
+void  //
+pipeline_thread__read_jobs(pipeline_thread* t) {
+  item_queue* src = &g_pipeline_queues[PIPELINE_STAGE__READ];
+  item_queue* dst = &g_pipeline_queues[PIPELINE_STAGE__RENDER];
+  size_t i = 0;
+  size_t j = 0;
+  while (claim_batch_jobs(&i, &j)) {
+    const char* err_msg = NULL;
+    batch_source* source = NULL;
+    for (size_t k = i; k < j; k++) {
+      uint64_t t0 = monotonic_nanos();
+      batch_item* item = item_queue__pop(src);
+      if (!item) {
+        return;
+      }
+      uint64_t t1 = monotonic_nanos();
+
+      if (k == i) {
+        err_msg = batch_source__open(&source, g_jobs[k].input, j - i);
+      }
+      item->job = &g_jobs[k];
+      item->err_msg = err_msg;
+      item->src = source;
+      uint64_t t2 = monotonic_nanos();
+
+      item_queue__push(dst, item);
+      uint64_t t3 = monotonic_nanos();
+
+      t->num_items++;
+      t->wait_for_output_nanos += (t1 - t0) + (t3 - t2);
+      t->busy_nanos += t2 - t1;
+    }
+  }
+}
+
+void  //
+pipeline_thread__process(pipeline_thread* t, batch_item* item) {
+  switch (t->stage) {
+    case PIPELINE_STAGE__RENDER:
+      if (!item->err_msg) {
+        item->err_msg =
+            batch_renderer__render(&item->renderer, item->job,
+                                   item->src->file.ptr, item->src->file.len);
+      }
+      if (item->src) {
+        batch_source__release(item->src);
+        item->src = NULL;
+      }
+      if (!item->err_msg) {
+        unpremultiply_pixel_buffer(&item->renderer.pb);
+      }
+      break;
+
+    case PIPELINE_STAGE__ENCODE:
+      if (!item->err_msg) {
+        item->err_msg = encode_png(&item->encoder, &item->renderer.pb, NULL);
+      }
+      break;
+
+    case PIPELINE_STAGE__WRITE:
+      if (!item->err_msg) {
+        item->err_msg = write_output(&item->encoder, item->job->output);
+      }
+      if (item->err_msg) {
+        fprintf(stderr, "main: could not convert %s (manifest line %u)\n%s\n",
+                item->job->input, item->job->line, item->err_msg);
+        t->num_failed++;
+      } else {
+        t->num_ok++;
+        t->num_bytes_written += item->encoder.dst_len;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void*  //
+pipeline_thread__main(void* arg) {
+  pipeline_thread* t = (pipeline_thread*)arg;
+  item_queue* src = &g_pipeline_queues[t->stage];
+  item_queue* dst =
+      &g_pipeline_queues[(t->stage + 1) % ((int)PIPELINE_STAGE__COUNT)];
+  if (t->stage == PIPELINE_STAGE__READ) {
+    pipeline_thread__read_jobs(t);
+  } else {
+    while (true) {
+      uint64_t t0 = monotonic_nanos();
+      batch_item* item = item_queue__pop(src);
+      uint64_t t1 = monotonic_nanos();
+      t->wait_for_input_nanos += t1 - t0;
+      if (!item) {
+        break;
+      }
+      pipeline_thread__process(t, item);
+      uint64_t t2 = monotonic_nanos();
+      item_queue__push(dst, item);
+      uint64_t t3 = monotonic_nanos();
+
+      t->num_items++;
+      t->busy_nanos += t2 - t1;
+      t->wait_for_output_nanos += t3 - t2;
+    }
+  }
+  item_queue__close_one(dst);
+  return NULL;
+}
+
+void  //
+print_pipeline_report(const pipeline_thread* threads,
+                      uint32_t num_threads,
+                      uint64_t wall_nanos) {
+  uint64_t num_ok = 0;
+  uint64_t num_failed = 0;
+  uint64_t num_bytes_written = 0;
+  uint32_t stage_threads[PIPELINE_STAGE__COUNT] = {0};
+  uint64_t stage_items[PIPELINE_STAGE__COUNT] = {0};
+  uint64_t stage_nanos[PIPELINE_STAGE__COUNT][3] = {{0}};
+  for (uint32_t i = 0; i < num_threads; i++) {
+    const pipeline_thread* t = &threads[i];
+    num_ok += t->num_ok;
+    num_failed += t->num_failed;
+    num_bytes_written += t->num_bytes_written;
+    stage_threads[t->stage]++;
+    stage_items[t->stage] += t->num_items;
+    stage_nanos[t->stage][0] += t->busy_nanos;
+    stage_nanos[t->stage][1] += t->wait_for_input_nanos;
+    stage_nanos[t->stage][2] += t->wait_for_output_nanos;
+  }
+
+  print_batch_summary(num_ok, num_failed, num_threads, num_bytes_written,
+                      wall_nanos);
+  printf(
+      "stage    threads   us/item     busy  waiting for input  "
+      "waiting for output\n");
+  for (int k = 0; k < PIPELINE_STAGE__COUNT; k++) {
+    double denominator = ((double)stage_threads[k]) * ((double)wall_nanos);
+    if (denominator <= 0) {
+      denominator = 1;
+    }
+    printf("%-8s %7u %9.1f %7.1f%% %17.1f%% %18.1f%%\n",
+           g_pipeline_stage_names[k], stage_threads[k],
+           stage_items[k] ? (((double)stage_nanos[k][0]) /
+                             (1e3 * ((double)stage_items[k])))
+                          : 0.0,
+           (100.0 * ((double)stage_nanos[k][0])) / denominator,
+           (100.0 * ((double)stage_nanos[k][1])) / denominator,
+           (100.0 * ((double)stage_nanos[k][2])) / denominator);
+  }
+}
+
+int  //
+run_pipeline() {
+  uint32_t stage_threads[PIPELINE_STAGE__COUNT];
+  for (int k = 0; k < PIPELINE_STAGE__COUNT; k++) {
+    stage_threads[k] = g_flags.pipeline_threads[k];
+  }
+  if (!stage_threads[PIPELINE_STAGE__READ]) {
+    stage_threads[PIPELINE_STAGE__READ] = 2;
+  }
+  if (!stage_threads[PIPELINE_STAGE__RENDER]) {
+    stage_threads[PIPELINE_STAGE__RENDER] =
+        g_flags.j ? g_flags.j : num_online_cpus();
+  }
+  if (!stage_threads[PIPELINE_STAGE__ENCODE]) {
+    stage_threads[PIPELINE_STAGE__ENCODE] =
+        g_flags.j ? g_flags.j : num_online_cpus();
+  }
+  if (!stage_threads[PIPELINE_STAGE__WRITE]) {
+    stage_threads[PIPELINE_STAGE__WRITE] = 1;
+  }
+
+  // Every queue but the free list holds up to g_flags.queue items, and every
+  // thread holds at most one, so that the free list only runs dry when the
+  // pipeline is full.
+  uint32_t num_threads = 0;
+  for (int k = 0; k < PIPELINE_STAGE__COUNT; k++) {
+    num_threads += stage_threads[k];
+  }
+  size_t num_items = (((size_t)(PIPELINE_STAGE__COUNT - 1)) * g_flags.queue) +
+                     ((size_t)num_threads);
+
+  batch_item* items = calloc(num_items, sizeof(batch_item));
+  pipeline_thread* threads = calloc(num_threads, sizeof(pipeline_thread));
+  if (!items || !threads) {
+    fprintf(stderr, "main: could not allocate the pipeline\n");
+    return 1;
+  }
+  for (int k = 0; k < PIPELINE_STAGE__COUNT; k++) {
+    // Stage k's input queue is fed by the previous stage (with the free list
+    // being fed by the write stage).
+    int producer = (k + PIPELINE_STAGE__COUNT - 1) % PIPELINE_STAGE__COUNT;
+    size_t cap = (k == PIPELINE_STAGE__READ) ? num_items : g_flags.queue;
+    const char* err_msg = item_queue__initialize(&g_pipeline_queues[k], cap,
+                                                 stage_threads[producer]);
+    if (err_msg) {
+      fprintf(stderr, "%s\n", err_msg);
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < num_items; i++) {
+    item_queue__push(&g_pipeline_queues[PIPELINE_STAGE__READ], &items[i]);
+  }
+
+  uint32_t n = 0;
+  for (int k = 0; k < PIPELINE_STAGE__COUNT; k++) {
+    for (uint32_t i = 0; i < stage_threads[k]; i++, n++) {
+      threads[n].stage = (pipeline_stage)k;
+    }
+  }
+
+  // A stage without threads would stall the pipeline, so give up (rather
+  // than carry on with fewer threads) if any thread can't be created.
+  uint64_t start = monotonic_nanos();
+  for (uint32_t i = 0; i < num_threads; i++) {
+    if (pthread_create(&threads[i].thread, NULL, &pipeline_thread__main,
+                       &threads[i])) {
+      fprintf(stderr, "main: could not create the pipeline threads\n");
+      exit(1);
+    }
+  }
+  for (uint32_t i = 0; i < num_threads; i++) {
+    pthread_join(threads[i].thread, NULL);
+  }
+  uint64_t wall_nanos = monotonic_nanos() - start;
+
+  print_pipeline_report(threads, num_threads, wall_nanos);
+
+  bool failed = false;
+  for (uint32_t i = 0; i < num_threads; i++) {
+    failed = failed || (threads[i].num_failed > 0);
+  }
+  for (size_t i = 0; i < num_items; i++) {
+    batch_renderer__finalize(&items[i].renderer);
+    png_encoder__finalize(&items[i].encoder);
+  }
+  for (int k = 0; k < PIPELINE_STAGE__COUNT; k++) {
+    item_queue__finalize(&g_pipeline_queues[k]);
+  }
+  free(threads);
+  free(items);
+  return failed ? 1 : 0;
+}
+
+// ----
+
+const char*  //
+parse_flags(int* argc, char** argv) {
+  g_flags.batch = NULL;
+  g_flags.j = 0;
+  g_flags.pipeline = false;
+  g_flags.queue = 16;
+
+  int n = 1;
+  for (int i = 1; i < *argc; i++) {
+    const char* arg = argv[i];
+    if ((arg[0] != '-') || !strcmp(arg, "-")) {
+      argv[n++] = argv[i];
+      continue;
+    } else if (!strcmp(arg, "--")) {
+      for (i++; i < *argc; i++) {
+        argv[n++] = argv[i];
+      }
+      break;
+    }
+    if (arg[1] == '-') {
+      arg++;
+    }
+    if (!strncmp(arg, "-batch=", 7)) {
+      g_flags.batch = arg + 7;
+      if (!*g_flags.batch) {
+        return "main: empty -batch value";
+      }
+    } else if (!strncmp(arg, "-j=", 3)) {
+      const char* eq = arg + 3;
+      char* end = NULL;
+      unsigned long x = strtoul(eq, &end, 10);
+      if ((end == eq) || *end || (x == 0) || (x > 1024)) {
+        return "main: invalid -j value";
+      }
+      g_flags.j = (uint32_t)x;
+    } else if (!strcmp(arg, "-pipeline")) {
+      g_flags.pipeline = true;
+    } else if (!strncmp(arg, "-pipeline=", 10)) {
+      g_flags.pipeline = true;
+      const char* p = arg + 10;
+      for (int k = 0; k < 4; k++) {
+        char* end = NULL;
+        unsigned long x = strtoul(p, &end, 10);
+        if ((end == p) || (*end != ((k < 3) ? ',' : '\x00')) || (x == 0) ||
+            (x > 1024)) {
+          return "main: invalid -pipeline value";
+        }
+        g_flags.pipeline_threads[k] = (uint32_t)x;
+        p = end + 1;
+      }
+    } else if (!strncmp(arg, "-queue=", 7)) {
+      const char* eq = arg + 7;
+      char* end = NULL;
+      unsigned long x = strtoul(eq, &end, 10);
+      if ((end == eq) || *end || (x == 0) || (x > 65536)) {
+        return "main: invalid -queue value";
+      }
+      g_flags.queue = (uint32_t)x;
+    } else {
+      return "main: unrecognized flag";
+    }
+  }
+  *argc = n;
+  if (g_flags.pipeline && !g_flags.batch) {
+    return "main: -pipeline requires -batch";
+  }
+  return NULL;
+}
+
 // ----
 
 int  //
 main(int argc, char** argv) {
-  // Read the input bytes.
+  {
+    const char* err_msg = parse_flags(&argc, argv);
+    if (err_msg) {
+      argc = -1;
+      fprintf(stderr, "%s\n", err_msg);
+    } else if (g_flags.batch) {
+      if (argc != 1) {
+        argc = -1;
+      } else if ((err_msg = load_manifest(g_flags.batch))) {
+        fprintf(stderr, "%s\n", err_msg);
+        return 1;
+      } else {
+        return g_flags.pipeline ? run_pipeline() : run_batch();
+      }
+    }
+  }
+
+  // Read the input bytes, memory-mapping the file if possible. There's no
+  // need to explicitly close src later. The program exits (and releases all
+  // memory and mappings) when main returns.
   const char* input_filename = NULL;
-  uint8_t* src_ptr = &g_src_buffer_array[0];
-  size_t src_len = 0;
+  iconvg_file src = {0};
   {
-    FILE* in = NULL;
+    const char* err_msg = NULL;
     switch (argc) {
       case 1:
         input_filename = "<stdin>";
-        in = stdin;
+        err_msg = iconvg_file__open_stream(&src, stdin, NULL);
         break;
       case 2:
         input_filename = argv[1];
-        in = fopen(input_filename, "r");
-        if (!in) {
-          fprintf(stderr, "main: could not open %s: %s\n", input_filename,
-                  strerror(errno));
-          return 1;
-        }
-        // No need to explicitly close in later. The program exits (and releases
-        // all file descriptors) when main returns.
+        err_msg = iconvg_file__open(&src, input_filename, NULL);
         break;
       default:
         fprintf(stderr,
                 "Usage: %s input.ivg > output.png\n"
-                "    If input.ivg is omitted, it reads from stdin.\n",
-                argv[0]);
+                "    If input.ivg is omitted, it reads from stdin.\n"
+                "Usage: %s -batch=manifest.txt [-j=N] [-pipeline[=R,D,E,W]] "
+                "[-queue=N]\n",
+                argv[0], argv[0]);
         return 1;
     }
-    if (!read_file(&src_len, &g_src_buffer_array[0], SRC_BUFFER_ARRAY_SIZE, in,
-                   input_filename)) {
+    if (err_msg) {
+      fprintf(stderr, "main: could not read %s\n%s\n", input_filename,
+              err_msg);
       return 1;
     }
   }
+  const uint8_t* src_ptr = src.ptr;
+  size_t src_len = src.len;
 
   // Decode the IconVG viewbox.
   iconvg_rectangle_f32 viewbox = {0};
@@ -414,23 +1555,7 @@ main(int argc, char** argv) {
   }
 
   // Convert from premultiplied alpha to non-premultiplied alpha.
-  // CAIRO_FORMAT_ARGB32 uses the former, as does Skia with
-  // PREMUL_SK_ALPHATYPE. libpng uses the latter.
-  {
-    for (uint32_t y = 0; y < pb.height; y++) {
-      const size_t bytes_per_pixel = 4;
-      uint8_t* row = pb.data + (y * bytes_per_pixel * pb.width);
-      for (uint32_t x = 0; x < pb.width; x++) {
-        uint8_t* rgba = row + (x * bytes_per_pixel);
-        if ((rgba[3] != 0x00) && (rgba[3] != 0xFF)) {
-          uint32_t a = rgba[3];
-          rgba[0] = (uint8_t)((rgba[0] * ((uint32_t)0xFF)) / a);
-          rgba[1] = (uint8_t)((rgba[1] * ((uint32_t)0xFF)) / a);
-          rgba[2] = (uint8_t)((rgba[2] * ((uint32_t)0xFF)) / a);
-        }
-      }
-    }
-  }
+  unpremultiply_pixel_buffer(&pb);
 
   // Write the PNG to stdout.
   {
@@ -0,0 +1,467 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// ----------------
+
+// iconvg-trace records and replays binary traces of IconVG canvas calls (see
+// iconvg_canvas__make_trace and iconvg_trace__replay).
+//
+// Usage: iconvg-trace record [-height=N] input.ivg > output.trace
+//        iconvg-trace replay [-benchtime=N] [-debug] input.trace
+//
+// record decodes input.ivg, at the given height in pixels (the width is
+// derived from the ViewBox aspect ratio), and writes the trace to stdout.
+// -height defaults to 256.
+//
+// replay feeds a trace back into canvases, independent of the decoder. With
+// -debug, it prints each call (like iconvg_canvas__make_debug). Otherwise, it
+// measures how long replaying takes, first into a canvas that does nothing
+// and then (if a backend was configured) into the Cairo or Skia raster
+// backend, for -benchtime milliseconds each (defaulting to 100).
+//
+// A trace captured from a production program (e.g. with a ring buffer) can
+// be saved to a file and then replayed here, to reproduce and benchmark the
+// backend's behavior in isolation.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// IconVG ships as a "single file C library" or "header file library" as per
+// https://github.com/nothings/stb/blob/master/docs/stb_howto.txt
+//
+// To use that single file as a "foo.c"-like implementation, instead of a
+// "foo.h"-like header, #define ICONVG_IMPLEMENTATION before #include'ing or
+// compiling it.
+#define ICONVG_IMPLEMENTATION
+#include "../../release/c/iconvg-unsupported-snapshot.c"
+
+struct {
+  uint64_t benchtime_nanos;
+  uint32_t height;
+  bool debug;
+} g_flags;
+
+uint64_t  //
+monotonic_nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (((uint64_t)(ts.tv_sec)) * 1000000000) + ((uint64_t)(ts.tv_nsec));
+}
+
+// ----
+
+// A raster_canvas is a backend-specific pixel buffer and the iconvg_canvas
+// that draws onto it.
+
+typedef struct {
+  iconvg_canvas canvas;
+  void* extra0;
+  void* extra1;
+} raster_canvas;
+
+#if defined(ICONVG_CONFIG__ENABLE_CAIRO_BACKEND)
+
+#include <cairo/cairo.h>
+
+#define BACKEND_NAME "cairo"
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  cairo_surface_t* cs =
+      cairo_image_surface_create(CAIRO_FORMAT_ARGB32, (int)width, (int)height);
+  if (cairo_surface_status(cs) != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy(cs);
+    return "main: could not create cairo_surface_t";
+  }
+  cairo_t* cr = cairo_create(cs);
+
+  *rc = ((raster_canvas){0});
+  rc->canvas = iconvg_canvas__make_cairo(cr);
+  rc->extra0 = cs;
+  rc->extra1 = cr;
+  return NULL;
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {
+  if (rc->extra1) {
+    cairo_destroy((cairo_t*)(rc->extra1));
+    rc->extra1 = NULL;
+  }
+  if (rc->extra0) {
+    cairo_surface_destroy((cairo_surface_t*)(rc->extra0));
+    rc->extra0 = NULL;
+  }
+}
+
+#elif defined(ICONVG_CONFIG__ENABLE_SKIA_BACKEND)
+
+#include "include/c/sk_imageinfo.h"
+#include "include/c/sk_surface.h"
+
+#define BACKEND_NAME "skia"
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  uint8_t* data = (uint8_t*)(malloc(4 * width * height));
+  if (!data) {
+    return "main: could not allocate pixel buffer data";
+  }
+  sk_imageinfo_t* si =
+      sk_imageinfo_new((int)width, (int)height, BGRA_8888_SK_COLORTYPE,
+                       PREMUL_SK_ALPHATYPE, NULL);
+  if (!si) {
+    free(data);
+    return "main: could not create sk_imageinfo_t";
+  }
+  sk_surface_t* ss = sk_surface_new_raster_direct(si, data, 4 * width, NULL);
+  sk_imageinfo_delete(si);
+  if (!ss) {
+    free(data);
+    return "main: could not create sk_surface_t";
+  }
+  sk_canvas_t* sc = sk_surface_get_canvas(ss);
+  if (!sc) {
+    sk_surface_unref(ss);
+    free(data);
+    return "main: could not create sk_canvas_t";
+  }
+
+  *rc = ((raster_canvas){0});
+  rc->canvas = iconvg_canvas__make_skia(sc);
+  rc->extra0 = ss;
+  rc->extra1 = data;
+  return NULL;
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {
+  if (rc->extra0) {
+    sk_surface_unref((sk_surface_t*)(rc->extra0));
+    rc->extra0 = NULL;
+  }
+  if (rc->extra1) {
+    free(rc->extra1);
+    rc->extra1 = NULL;
+  }
+}
+
+#else  //  ICONVG_CONFIG__ETC
+
+#define BACKEND_NAME NULL
+
+const char*  //
+initialize_raster_canvas(raster_canvas* rc, uint32_t width, uint32_t height) {
+  return "main: no IconVG backend configured";
+}
+
+void  //
+finalize_raster_canvas(raster_canvas* rc) {}
+
+#endif  //  ICONVG_CONFIG__ETC
+
+// ----
+
+// The dst_rect canvas records the first begin_decode call's dst_rect (into
+// the iconvg_rectangle_f32 pointed to by context.nonconst_ptr1), so that the
+// replay command knows how large a raster_canvas to make.
+
+const char*  //
+dst_rect_canvas__begin_decode(iconvg_canvas* c, iconvg_rectangle_f32 dst_rect) {
+  iconvg_rectangle_f32* r = (iconvg_rectangle_f32*)(c->context.nonconst_ptr1);
+  if (!iconvg_rectangle_f32__is_finite_and_not_empty(r)) {
+    *r = dst_rect;
+  }
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__end_decode(iconvg_canvas* c,
+                            const char* err_msg,
+                            size_t num_bytes_consumed,
+                            size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+const char*  //
+dst_rect_canvas__begin_drawing(iconvg_canvas* c) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__end_drawing(iconvg_canvas* c, const iconvg_paint* p) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__end_path(iconvg_canvas* c) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__path_quad_to(iconvg_canvas* c,
+                              float x1,
+                              float y1,
+                              float x2,
+                              float y2) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__path_cube_to(iconvg_canvas* c,
+                              float x1,
+                              float y1,
+                              float x2,
+                              float y2,
+                              float x3,
+                              float y3) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                     iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+const char*  //
+dst_rect_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
+
+const iconvg_canvas_vtable dst_rect_canvas_vtable = {
+    sizeof(iconvg_canvas_vtable),
+    &dst_rect_canvas__begin_decode,
+    &dst_rect_canvas__end_decode,
+    &dst_rect_canvas__begin_drawing,
+    &dst_rect_canvas__end_drawing,
+    &dst_rect_canvas__begin_path,
+    &dst_rect_canvas__end_path,
+    &dst_rect_canvas__path_line_to,
+    &dst_rect_canvas__path_quad_to,
+    &dst_rect_canvas__path_cube_to,
+    &dst_rect_canvas__on_metadata_viewbox,
+    &dst_rect_canvas__on_metadata_suggested_palette,
+    NULL,  // begin_path__fixed
+    NULL,  // path_line_to__fixed
+    NULL,  // path_quad_to__fixed
+    NULL,  // path_cube_to__fixed
+};
+
+// ----
+
+const char*  //
+record(const char* filename) {
+  iconvg_file src;
+  const char* err_msg = iconvg_file__open(&src, filename, NULL);
+  if (err_msg) {
+    fprintf(stderr, "main: could not read %s\n", filename);
+    return err_msg;
+  }
+
+  iconvg_rectangle_f32 viewbox = {0};
+  err_msg = iconvg_decode_viewbox(&viewbox, src.ptr, src.len);
+  if (!err_msg) {
+    double vw = iconvg_rectangle_f32__width_f64(&viewbox);
+    double vh = iconvg_rectangle_f32__height_f64(&viewbox);
+    double h = g_flags.height;
+    double w = (vh > 0) ? ((h * vw) / vh) : h;
+    iconvg_rectangle_f32 dst_rect =
+        iconvg_rectangle_f32__make(0, 0, (float)w, (float)h);
+
+    iconvg_trace t = {0};
+    t.file = stdout;
+    iconvg_canvas c = iconvg_canvas__make_trace(NULL, &t);
+    err_msg = iconvg_decode(&c, dst_rect, src.ptr, src.len, NULL);
+    if (!err_msg && (fflush(stdout) || ferror(stdout))) {
+      err_msg = "main: could not write trace";
+    }
+  }
+  iconvg_file__close(&src);
+  return err_msg;
+}
+
+// replay_benchmark replays t into c repeatedly, for roughly
+// g_flags.benchtime_nanos, and prints the nanoseconds per replay.
+const char*  //
+replay_benchmark(const iconvg_trace* t, iconvg_canvas* c, const char* name) {
+  uint64_t num_iters = 1;
+  uint64_t elapsed = 0;
+  while (true) {
+    uint64_t start = monotonic_nanos();
+    for (uint64_t i = 0; i < num_iters; i++) {
+      const char* err_msg = iconvg_trace__replay(t, c);
+      if (err_msg) {
+        return err_msg;
+      }
+    }
+    elapsed = monotonic_nanos() - start;
+    if ((elapsed >= g_flags.benchtime_nanos) || (num_iters >= 1000000000)) {
+      break;
+    }
+    num_iters *= 2;
+  }
+  printf("%-8s  %10llu iters  %12.1f ns/op  %10.2f ns/record\n", name,
+         (unsigned long long)num_iters,
+         ((double)elapsed) / ((double)num_iters),
+         ((double)elapsed) /
+             (((double)num_iters) * ((double)(t->num_records))));
+  return NULL;
+}
+
+const char*  //
+replay(const char* filename) {
+  iconvg_file src;
+  const char* err_msg = iconvg_file__open(&src, filename, NULL);
+  if (err_msg) {
+    fprintf(stderr, "main: could not read %s\n", filename);
+    return err_msg;
+  }
+  // Replaying only reads the records, so it's OK to drop the const.
+  iconvg_trace t = {0};
+  t.ptr = (uint8_t*)(src.ptr);
+  t.len = src.len;
+  t.num_records = t.len / ICONVG_TRACE__RECORD_SIZE;
+
+  if (g_flags.debug) {
+    iconvg_canvas c = iconvg_canvas__make_debug(stdout, "", NULL);
+    err_msg = iconvg_trace__replay(&t, &c);
+    iconvg_file__close(&src);
+    return err_msg;
+  }
+
+  do {
+    iconvg_canvas c = iconvg_canvas__make_broken(NULL);
+    err_msg = replay_benchmark(&t, &c, "nothing");
+    if (err_msg || !BACKEND_NAME) {
+      break;
+    }
+
+    iconvg_rectangle_f32 dst_rect = {0};
+    c.vtable = &dst_rect_canvas_vtable;
+    memset(&c.context, 0, sizeof(c.context));
+    c.context.nonconst_ptr1 = &dst_rect;
+    err_msg = iconvg_trace__replay(&t, &c);
+    if (err_msg) {
+      break;
+    }
+    double w = iconvg_rectangle_f32__width_f64(&dst_rect) + dst_rect.min_x;
+    double h = iconvg_rectangle_f32__height_f64(&dst_rect) + dst_rect.min_y;
+    raster_canvas rc = {0};
+    err_msg = initialize_raster_canvas(
+        &rc, (w < 1) ? 1 : (w > 0x7FFF) ? 0x7FFF : (uint32_t)(w + 0.5),
+        (h < 1) ? 1 : (h > 0x7FFF) ? 0x7FFF : (uint32_t)(h + 0.5));
+    if (err_msg) {
+      break;
+    }
+    err_msg = replay_benchmark(&t, &rc.canvas, BACKEND_NAME);
+    finalize_raster_canvas(&rc);
+  } while (false);
+
+  iconvg_file__close(&src);
+  return err_msg;
+}
+
+// ----
+
+const char*  //
+parse_flags(int* argc, char** argv) {
+  g_flags.benchtime_nanos = 100 * 1000000;
+  g_flags.height = 256;
+
+  int n = 1;
+  for (int i = 1; i < *argc; i++) {
+    const char* arg = argv[i];
+    if ((arg[0] != '-') || !strcmp(arg, "-")) {
+      argv[n++] = argv[i];
+      continue;
+    } else if (!strcmp(arg, "--")) {
+      for (i++; i < *argc; i++) {
+        argv[n++] = argv[i];
+      }
+      break;
+    }
+    if (arg[1] == '-') {
+      arg++;
+    }
+    if (!strncmp(arg, "-benchtime=", 11)) {
+      char* end = NULL;
+      unsigned long ms = strtoul(arg + 11, &end, 10);
+      if ((end == (arg + 11)) || *end || (ms == 0) || (ms > 3600000)) {
+        return "main: invalid -benchtime value";
+      }
+      g_flags.benchtime_nanos = ((uint64_t)ms) * 1000000;
+    } else if (!strcmp(arg, "-debug")) {
+      g_flags.debug = true;
+    } else if (!strncmp(arg, "-height=", 8)) {
+      char* end = NULL;
+      unsigned long h = strtoul(arg + 8, &end, 10);
+      if ((end == (arg + 8)) || *end || (h == 0) || (h > 0x7FFF)) {
+        return "main: invalid -height value";
+      }
+      g_flags.height = (uint32_t)h;
+    } else {
+      return "main: unrecognized flag";
+    }
+  }
+  *argc = n;
+  return NULL;
+}
+
+int  //
+main(int argc, char** argv) {
+  const char* err_msg = parse_flags(&argc, argv);
+  if (!err_msg && (argc != 3)) {
+    err_msg = "main: wrong number of arguments";
+  }
+  if (err_msg) {
+    fprintf(stderr,
+            "%s\n"
+            "Usage: %s record [-height=N] input.ivg > output.trace\n"
+            "       %s replay [-benchtime=N] [-debug] input.trace\n",
+            err_msg, argv[0], argv[0]);
+    return 1;
+  }
+
+  if (!strcmp(argv[1], "record")) {
+    err_msg = record(argv[2]);
+  } else if (!strcmp(argv[1], "replay")) {
+    err_msg = replay(argv[2]);
+  } else {
+    err_msg = "main: unrecognized command (want record or replay)";
+  }
+  if (err_msg) {
+    fprintf(stderr, "%s\n", err_msg);
+    return 1;
+  }
+  return 0;
+}
@@ -31,7 +31,6 @@
 //
 // The Escape key quits.
 
-#include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -47,16 +46,10 @@
 #define ICONVG_IMPLEMENTATION
 #include "../../release/c/iconvg-unsupported-snapshot.c"
 
-// SRC_BUFFER_ARRAY_SIZE is the largest size (in bytes) for .ivg files
-// supported by this program.
-//
-// This is 1 MiB (1024 * 1024 = 1048576 bytes) by default, but can be
-// configured by compiling with -DSRC_BUFFER_ARRAY_SIZE=etc.
-#ifndef SRC_BUFFER_ARRAY_SIZE
-#define SRC_BUFFER_ARRAY_SIZE 1048576
-#endif
-uint8_t g_src_buffer_array[SRC_BUFFER_ARRAY_SIZE];
-size_t g_src_len = 0;
+// g_src holds the current file's contents. They are read into memory, not
+// memory-mapped, as they are decoded again on every render and the file might
+// be rewritten (or truncated) in the meantime.
+iconvg_file g_src = {0};
 
 // g_background_colors' 6 elements are two checkerboard colors: [R0, G0, B0,
 // R1, G1, B1].
@@ -284,66 +277,25 @@ finalize_pixel_buffer(pixel_buffer* pb) {
 
 // ----
 
-bool  //
-read_file(size_t* dst_num_bytes_read,
-          uint8_t* dst_buffer_ptr,
-          size_t dst_buffer_len,
-          FILE* src_file,
-          const char* src_filename) {
-  if (!dst_num_bytes_read || !src_file || !src_filename) {
-    return false;
-  }
-  *dst_num_bytes_read = 0;
-  uint8_t placeholder[1];
-  uint8_t* ptr = dst_buffer_ptr;
-  size_t len = dst_buffer_len;
-  while (true) {
-    if (!len) {
-      // We have read all that dst can hold. Check that we have read the full
-      // file by trying to read one more byte, which should fail with EOF.
-      ptr = placeholder;
-      len = 1;
-    }
-    size_t n = fread(ptr, 1, len, src_file);
-    if (ptr != placeholder) {
-      ptr += n;
-      len -= n;
-      *dst_num_bytes_read += n;
-    } else if (n) {
-      printf("%s: main: file size (in bytes) is too large\n", src_filename);
-      return false;
-    }
-    if (feof(src_file)) {
-      break;
-    }
-    int err = ferror(src_file);
-    if (!err) {
-      continue;
-    } else if (err == EINTR) {
-      clearerr(src_file);
-      continue;
-    }
-    printf("%s: main: I/O error: %s\n", src_filename, strerror(err));
-    return false;
-  }
-  return true;
-}
-
 bool  //
 load(const char* filename) {
   if (!filename) {
     return false;
   }
-  FILE* f = fopen(filename, "r");
-  if (f == NULL) {
-    printf("%s: main: could not open file\n", filename);
+  iconvg_file__close(&g_src);
+  FILE* f = fopen(filename, "rb");
+  if (!f) {
+    printf("%s: main: %s\n", filename,
+           iconvg_error_system_failure_could_not_read_file);
     return false;
   }
-  g_src_len = 0;
-  bool ret = read_file(&g_src_len, &g_src_buffer_array[0],
-                       SRC_BUFFER_ARRAY_SIZE, f, filename);
+  const char* err_msg = iconvg_file__open_stream(&g_src, f, NULL);
   fclose(f);
-  return ret;
+  if (err_msg) {
+    printf("%s: main: %s\n", filename, err_msg);
+    return false;
+  }
+  return true;
 }
 
 // ----
@@ -357,8 +309,8 @@ render(void* ctx,
   if (!filename) {
     return false;
   }
-  uint8_t const* src_ptr = &g_src_buffer_array[0];
-  const size_t src_len = g_src_len;
+  uint8_t const* src_ptr = g_src.ptr;
+  const size_t src_len = g_src.len;
 
   // Decode the IconVG viewbox.
   double vw = 0.0;
@@ -69,28 +69,84 @@
 //
 // Functions (-):
 //   - iconvg_decode
+//   - iconvg_decode_iov
 //   - iconvg_decode_viewbox
 //   - iconvg_error_is_file_format_error
+//   - iconvg_validate
+//   - iconvg_write_c_source
+//   - iconvg_write_display_list_cache
 //
 // Data structures (-), their constructors (*) and their methods (+):
+//   - iconvg_allocator
 //   - iconvg_canvas
 //           * iconvg::canvas__make_skia
 //           * iconvg_canvas__make_broken
 //           * iconvg_canvas__make_cairo
 //           * iconvg_canvas__make_debug
+//           * iconvg_canvas__make_profiler
 //           * iconvg_canvas__make_skia
+//           * iconvg_canvas__make_trace
 //       + iconvg_canvas__does_nothing
 //   - iconvg_canvas_vtable
+//   - iconvg_compiled_frame
+//       + iconvg_compiled_frame__end_drawing
+//   - iconvg_compiled_icon
+//       + iconvg_compiled_icon__decode
+//   - iconvg_compiled_paint
+//   - iconvg_compiled_variant
 //   - iconvg_decode_options
+//   - iconvg_display_list_cache
+//       + iconvg_display_list_cache__close
+//       + iconvg_display_list_cache__contains
+//       + iconvg_display_list_cache__open_bytes
+//       + iconvg_display_list_cache__open_mmap
+//       + iconvg_display_list_cache__replay
+//   - iconvg_encoder
+//       + iconvg_encoder__add_to_sel
+//       + iconvg_encoder__cube_to
+//       + iconvg_encoder__ellipse
+//       + iconvg_encoder__fill_flat
+//       + iconvg_encoder__fill_flat_color
+//       + iconvg_encoder__fill_linear_gradient
+//       + iconvg_encoder__fill_radial_gradient
+//       + iconvg_encoder__finish
+//       + iconvg_encoder__initialize
+//       + iconvg_encoder__line_to
+//       + iconvg_encoder__move_to
+//       + iconvg_encoder__parallelogram
+//       + iconvg_encoder__quad_to
+//       + iconvg_encoder__set_register
+//       + iconvg_encoder__set_registers
+//       + iconvg_encoder__write_metadata
+//   - iconvg_file
+//       + iconvg_file__close
+//       + iconvg_file__open
+//       + iconvg_file__open_stream
+//   - iconvg_fixed_24_8
+//   - iconvg_histogram
+//       + iconvg_histogram__add
+//       + iconvg_histogram__merge
+//       + iconvg_histogram__percentile
 //   - iconvg_matrix_2x3_f64
 //           * iconvg_matrix_2x3_f64__make
 //       + iconvg_matrix_2x3_f64__determinant
 //       + iconvg_matrix_2x3_f64__inverse
 //       + iconvg_matrix_2x3_f64__override_second_row
 //   - iconvg_nonpremul_color
+//   - iconvg_op
+//   - iconvg_op_iterator
+//           * iconvg_op_iterator__make
+//       + iconvg_op_iterator__next
 //   - iconvg_optional_i64
 //           * iconvg_optional_i64__make_none
 //           * iconvg_optional_i64__make_some
+//   - iconvg_pack
+//       + iconvg_pack__close
+//       + iconvg_pack__entry
+//       + iconvg_pack__find
+//       + iconvg_pack__open_bytes
+//       + iconvg_pack__open_mmap
+//   - iconvg_pack_entry
 //   - iconvg_paint
 //       + iconvg_paint__flat_color_as_nonpremul_color
 //       + iconvg_paint__flat_color_as_premul_color
@@ -103,11 +159,17 @@
 //       + iconvg_paint__type
 //   - iconvg_palette
 //   - iconvg_premul_color
+//   - iconvg_profile
+//       + iconvg_profile__merge
+//       + iconvg_profile__write_json
 //   - iconvg_rectangle_f32
 //           * iconvg_rectangle_f32__make
 //       + iconvg_rectangle_f32__height_f64
 //       + iconvg_rectangle_f32__is_finite_and_not_empty
 //       + iconvg_rectangle_f32__width_f64
+//   - iconvg_trace
+//       + iconvg_trace__replay
+//   - iconvg_validate_report
 //
 // Enumerations (-), their constructors (*) and their values (=):
 //   - iconvg_gradient_spread
@@ -115,6 +177,17 @@
 //       = ICONVG_GRADIENT_SPREAD__PAD
 //       = ICONVG_GRADIENT_SPREAD__REFLECT
 //       = ICONVG_GRADIENT_SPREAD__REPEAT
+//   - iconvg_op_type
+//       = ICONVG_OP_TYPE__BEGIN_DRAWING
+//       = ICONVG_OP_TYPE__BEGIN_PATH
+//       = ICONVG_OP_TYPE__END_DRAWING
+//       = ICONVG_OP_TYPE__END_PATH
+//       = ICONVG_OP_TYPE__NONE
+//       = ICONVG_OP_TYPE__ON_METADATA_SUGGESTED_PALETTE
+//       = ICONVG_OP_TYPE__ON_METADATA_VIEWBOX
+//       = ICONVG_OP_TYPE__PATH_CUBE_TO
+//       = ICONVG_OP_TYPE__PATH_LINE_TO
+//       = ICONVG_OP_TYPE__PATH_QUAD_TO
 //   - iconvg_paint_type
 //       = ICONVG_PAINT_TYPE__FLAT_COLOR
 //       = ICONVG_PAINT_TYPE__INVALID
@@ -123,6 +196,7 @@
 //
 // Other globals (-):
 //   - iconvg_error_bad_coordinate
+//   - iconvg_error_bad_display_list_cache
 //   - iconvg_error_bad_jump
 //   - iconvg_error_bad_magic_identifier
 //   - iconvg_error_bad_metadata
@@ -131,10 +205,15 @@
 //   - iconvg_error_bad_metadata_viewbox
 //   - iconvg_error_bad_number
 //   - iconvg_error_bad_opcode_length
+//   - iconvg_error_bad_pack
+//   - iconvg_error_bad_segref
 //   - iconvg_error_invalid_backend_not_enabled
 //   - iconvg_error_invalid_constructor_argument
+//   - iconvg_error_invalid_encoder_call
 //   - iconvg_error_invalid_paint_type
+//   - iconvg_error_invalid_trace
 //   - iconvg_error_invalid_vtable
+//   - iconvg_error_system_failure_could_not_read_file
 //   - iconvg_error_system_failure_out_of_memory
 
 // ----
@@ -165,6 +244,7 @@
 // Other errors (invalid_etc) are programming errors.
 
 extern const char iconvg_error_bad_coordinate[];                  // ¶0.1
+extern const char iconvg_error_bad_display_list_cache[];          // ¶0.1
 extern const char iconvg_error_bad_jump[];                        // ¶0.1
 extern const char iconvg_error_bad_magic_identifier[];            // ¶0.1
 extern const char iconvg_error_bad_metadata[];                    // ¶0.1
@@ -173,12 +253,17 @@ extern const char iconvg_error_bad_metadata_suggested_palette[];  // ¶0.1
 extern const char iconvg_error_bad_metadata_viewbox[];            // ¶0.1
 extern const char iconvg_error_bad_number[];                      // ¶0.1
 extern const char iconvg_error_bad_opcode_length[];               // ¶0.1
+extern const char iconvg_error_bad_pack[];                        // ¶0.1
+extern const char iconvg_error_bad_segref[];                      // ¶0.1
 
-extern const char iconvg_error_system_failure_out_of_memory[];  // ¶0.1
+extern const char iconvg_error_system_failure_could_not_read_file[];  // ¶0.1
+extern const char iconvg_error_system_failure_out_of_memory[];        // ¶0.1
 
 extern const char iconvg_error_invalid_backend_not_enabled[];   // ¶0.1
 extern const char iconvg_error_invalid_constructor_argument[];  // ¶0.1
+extern const char iconvg_error_invalid_encoder_call[];          // ¶0.1
 extern const char iconvg_error_invalid_paint_type[];            // ¶0.1
+extern const char iconvg_error_invalid_trace[];                 // ¶0.1
 extern const char iconvg_error_invalid_vtable[];                // ¶0.1
 
 // ----
@@ -336,6 +421,59 @@ iconvg_matrix_2x3_f64__determinant(  // ¶0.1
 
 // ----
 
+// iconvg_allocator is a caller-supplied memory allocator, such as a
+// per-request arena, for the library's own heap allocations. Decoding itself
+// (iconvg_decode and the built-in canvases other than Cairo and Skia) never
+// allocates. The allocations are iconvg_write_display_list_cache's and
+// iconvg_write_c_source's working buffers and the file contents that
+// iconvg_file__open (and so the etc__open_mmap functions) reads instead of
+// mapping. The Cairo and Skia
+// libraries allocate their own objects (patterns, paths, paints and shaders)
+// through their own allocators, which IconVG cannot redirect.
+//
+// If alloc_func is NULL then malloc, realloc and free are used and the other
+// two funcs are ignored. Otherwise, a NULL realloc_func means alloc_func,
+// memcpy and free_func, and a NULL free_func means that freeing is a no-op
+// (as for an arena that is released all at once). realloc_func and free_func
+// are passed the size of the existing allocation, so that they don't have to
+// record it, and realloc_func's ptr may be NULL (with an old_n of zero).
+//
+// The library updates the num_etc and peak_bytes_in_use fields. The call
+// counts include failed calls. num_bytes_requested is the sum of the sizes
+// passed to successful alloc and realloc calls: an upper bound on what an
+// arena that never reuses memory would consume. If bytes_in_use_limit is
+// non-zero then calls that would take num_bytes_in_use above it fail (and the
+// library function reports iconvg_error_system_failure_out_of_memory) without
+// reaching alloc_func or realloc_func.
+//
+// The library does not synchronize access: an iconvg_allocator should not be
+// used by multiple threads concurrently.
+//
+// Example code:
+//   iconvg_allocator a = {0};
+//   a.alloc_func = &my_arena_alloc;
+//   a.context = my_arena;
+//   a.bytes_in_use_limit = 16 << 20;
+//   iconvg_decode_options opts = {0};
+//   opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+//   opts.allocator = &a;
+typedef struct iconvg_allocator_struct {
+  void* (*alloc_func)(void* context, size_t n);
+  void* (*realloc_func)(void* context, void* ptr, size_t old_n, size_t new_n);
+  void (*free_func)(void* context, void* ptr, size_t n);
+  void* context;
+  uint64_t bytes_in_use_limit;
+
+  uint64_t num_alloc_calls;
+  uint64_t num_realloc_calls;
+  uint64_t num_free_calls;
+  uint64_t num_bytes_requested;
+  uint64_t num_bytes_in_use;
+  uint64_t peak_bytes_in_use;
+} iconvg_allocator;  // ¶0.1
+
+// ----
+
 // iconvg_decode_options holds the optional arguments to iconvg_decode.
 //
 // Example code:
@@ -364,8 +502,45 @@ typedef struct iconvg_decode_options_struct {
   iconvg_palette* palette;
 
   // The fields above are ¶0.1
+
+  // dst_transform, if non-NULL, is an affine transformation applied after
+  // mapping the viewbox to the dst_rect argument to iconvg_decode. It maps
+  // from that dst_rect's coordinate space to the canvas', and applies to both
+  // path coordinates and gradient transformation matrices. For example, it
+  // can rotate or skew an icon without changing the canvas' own transform.
+  //
+  // It does not affect the default height_in_pixels, which is still the
+  // dst_rect's height.
+  const iconvg_matrix_2x3_f64* dst_transform;
+
+  // allocator, if non-NULL, is used (instead of malloc, realloc and free) by
+  // the functions that take an iconvg_decode_options and allocate memory, such
+  // as iconvg_write_display_list_cache. iconvg_decode itself never allocates.
+  iconvg_allocator* allocator;
+
+  // The fields above are ¶0.2
 } iconvg_decode_options;  // ¶0.1
 
+// iconvg_validate_report holds the optional details from iconvg_validate.
+typedef struct iconvg_validate_report_struct {
+  // error_offset is the byte offset (relative to the start of src) of the
+  // magic identifier, metadata chunk or op that was invalid. It is src_len if
+  // src was valid or if the error was a jump op whose target lies beyond the
+  // last op.
+  size_t error_offset;
+
+  // num_metadata_chunks and num_ops are the number of metadata chunks and
+  // ops that were valid.
+  uint64_t num_metadata_chunks;
+  uint64_t num_ops;
+} iconvg_validate_report;  // ¶0.1
+
+// ----
+
+// iconvg_fixed_24_8 is a signed fixed point number with 24 integer bits and 8
+// fractional bits. For example, 0x00000180 represents 1.5.
+typedef int32_t iconvg_fixed_24_8;  // ¶0.1
+
 // ----
 
 // iconvg_canvas is conceptually a 'virtual super-class' with e.g. Cairo-backed
@@ -416,6 +591,32 @@ typedef struct iconvg_canvas_vtable_struct {
       const iconvg_palette* suggested_palette);
 
   // The fields above are ¶0.1
+
+  // The optional fields below are like the begin_path and path_etc_to fields,
+  // but with dst coordinates as 24.8 fixed point numbers. The decoder only
+  // calls them if it was built with the ICONVG_CONFIG__FIXED_POINT macro
+  // defined (see iconvg_decode). A NULL field means to call its floating
+  // point equivalent instead.
+  const char* (*begin_path__fixed)(struct iconvg_canvas_struct* c,
+                                   iconvg_fixed_24_8 x0,
+                                   iconvg_fixed_24_8 y0);
+  const char* (*path_line_to__fixed)(struct iconvg_canvas_struct* c,
+                                     iconvg_fixed_24_8 x1,
+                                     iconvg_fixed_24_8 y1);
+  const char* (*path_quad_to__fixed)(struct iconvg_canvas_struct* c,
+                                     iconvg_fixed_24_8 x1,
+                                     iconvg_fixed_24_8 y1,
+                                     iconvg_fixed_24_8 x2,
+                                     iconvg_fixed_24_8 y2);
+  const char* (*path_cube_to__fixed)(struct iconvg_canvas_struct* c,
+                                     iconvg_fixed_24_8 x1,
+                                     iconvg_fixed_24_8 y1,
+                                     iconvg_fixed_24_8 x2,
+                                     iconvg_fixed_24_8 y2,
+                                     iconvg_fixed_24_8 x3,
+                                     iconvg_fixed_24_8 y3);
+
+  // The fields above are ¶0.2
 } iconvg_canvas_vtable;  // ¶0.1
 
 typedef struct iconvg_canvas_struct {
@@ -443,6 +644,387 @@ typedef struct iconvg_canvas_struct {
 
 // ----
 
+// ICONVG_HISTOGRAM__NUM_BUCKETS is the number of buckets in an
+// iconvg_histogram.
+#define ICONVG_HISTOGRAM__NUM_BUCKETS 40
+
+// iconvg_histogram is a log-bucketed histogram of non-negative integer
+// values, such as latencies in nanoseconds.
+//
+// buckets[0] counts the zero values. For 0 < i < (NUM_BUCKETS - 1),
+// buckets[i] counts the values v such that (2**(i-1) <= v) and (v < 2**i).
+// The last bucket also counts all larger values.
+//
+// A zero-valued iconvg_histogram is empty and ready to use.
+typedef struct iconvg_histogram_struct {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[ICONVG_HISTOGRAM__NUM_BUCKETS];
+} iconvg_histogram;  // ¶0.1
+
+// iconvg_profile holds the statistics gathered by a profiler canvas (see
+// iconvg_canvas__make_profiler). A zero-valued iconvg_profile is empty and
+// ready to use.
+//
+// Latencies are measured around the calls to the wrapped canvas, in
+// nanoseconds, using a monotonic clock.
+typedef struct iconvg_profile_struct {
+  // num_calls counts the calls to each iconvg_canvas_vtable method.
+  struct {
+    uint64_t begin_decode;
+    uint64_t end_decode;
+    uint64_t begin_drawing;
+    uint64_t end_drawing;
+    uint64_t begin_path;
+    uint64_t end_path;
+    uint64_t path_line_to;
+    uint64_t path_quad_to;
+    uint64_t path_cube_to;
+    uint64_t on_metadata_viewbox;
+    uint64_t on_metadata_suggested_palette;
+  } num_calls;
+
+  // num_failed_decodes counts the end_decode calls with a non-NULL err_msg.
+  uint64_t num_failed_decodes;
+
+  // num_drawings_by_paint_type counts the end_drawing calls, indexed by the
+  // iconvg_paint_type of their paint.
+  uint64_t num_drawings_by_paint_type[4];
+
+  // segments_per_path has one value per path: its number of path_etc_to
+  // calls between begin_path and end_path.
+  iconvg_histogram segments_per_path;
+
+  // stops_per_gradient has one value per gradient paint: its number of
+  // gradient stops.
+  iconvg_histogram stops_per_gradient;
+
+  // end_drawing_nanos holds the latencies of the wrapped canvas' end_drawing
+  // calls. For most backends, this is when the pixels are filled.
+  iconvg_histogram end_drawing_nanos;
+
+  // path_nanos holds the latencies of the wrapped canvas' begin_path,
+  // end_path and path_etc_to calls.
+  iconvg_histogram path_nanos;
+} iconvg_profile;  // ¶0.1
+
+// ----
+
+// ICONVG_TRACE__RECORD_SIZE is the size, in bytes, of each record written by
+// a trace canvas.
+#define ICONVG_TRACE__RECORD_SIZE 32
+
+// iconvg_trace is where a trace canvas (see iconvg_canvas__make_trace)
+// writes its binary records, one or more fixed size records per vtable call.
+// Records hold their arguments' raw bits (including a snapshot of the paint
+// passed to end_drawing), without any text formatting, and can be fed back
+// into another canvas by iconvg_trace__replay.
+//
+// If ptr is non-NULL then the records are written to the ring buffer ptr[..
+// len], overwriting the oldest records once full. len should be a multiple
+// of ICONVG_TRACE__RECORD_SIZE and any remainder is unused.
+//
+// If file is non-NULL then the records are also written (appended) to file.
+// Check ferror(file) afterwards to detect write errors.
+//
+// num_records counts the records written so far. Both ptr and file may be
+// NULL, in which case only num_records is updated.
+//
+// A trace file's contents, read back into memory, can be replayed by setting
+// ptr and len to that memory and num_records to (len / RECORD_SIZE).
+typedef struct iconvg_trace_struct {
+  uint8_t* ptr;
+  size_t len;
+  FILE* file;
+  uint64_t num_records;
+} iconvg_trace;  // ¶0.1
+
+// ----
+
+// iconvg_file holds an entire file's contents, ptr[.. len], which can be
+// passed straight to iconvg_decode. There is no size limit other than the
+// address space.
+//
+// Regular files are memory-mapped read-only, if the platform supports mmap,
+// and is_mapped is true. Otherwise (for pipes, character devices such as
+// /dev/stdin, empty files or platforms without mmap), the contents are read
+// into memory, of capacity cap, allocated by allocator.
+typedef struct iconvg_file_struct {
+  const uint8_t* ptr;
+  size_t len;
+  size_t cap;
+  bool is_mapped;
+  iconvg_allocator* allocator;
+} iconvg_file;  // ¶0.1
+
+// ----
+
+// iconvg_pack is a read-only view of an IconVG pack: a single file holding
+// many named IconVG files, so that loading them all costs one open and one
+// mmap instead of an open and read per file.
+//
+// The pack format (all integers are little-endian) is:
+//   - a 32-byte header: the 8-byte magic "\x8AIVGpack", a u32 version (1), a
+//     u32 number of entries N, a u64 index offset (32) and a u64 total pack
+//     length.
+//   - an index of N 32-byte entries: a u64 name hash (64-bit FNV-1a), a u64
+//     blob offset, a u64 blob length, a u32 name offset and a u32 name
+//     length. Entries are sorted by name hash and then by name.
+//   - the names, each followed by a NUL byte.
+//   - the blobs (IconVG files), each starting at a 4096-byte aligned offset.
+//
+// cmd/iconvg-pack writes pack files.
+//
+// ptr and len hold the entire pack. file is what iconvg_pack__open_mmap
+// opened (and iconvg_pack__close closes), holding that memory. It is
+// zero-valued for iconvg_pack__open_bytes.
+typedef struct iconvg_pack_struct {
+  const uint8_t* ptr;
+  size_t len;
+  uint32_t num_entries;
+  iconvg_file file;
+} iconvg_pack;  // ¶0.1
+
+// iconvg_pack_entry is one of an iconvg_pack's named IconVG files. name (NUL
+// terminated, name_len bytes long, excluding the NUL) and ptr[.. len] point
+// into the pack, and are valid until the pack is closed. ptr[.. len] can be
+// passed straight to iconvg_decode.
+//
+// A zero-valued entry (with a NULL name) means that there was no such entry.
+typedef struct iconvg_pack_entry_struct {
+  const char* name;
+  size_t name_len;
+  const uint8_t* ptr;
+  size_t len;
+} iconvg_pack_entry;  // ¶0.1
+
+// ----
+
+// iconvg_display_list_cache is a read-only view of a display list cache: a
+// single file holding, for many IconVG files, the canvas calls that decoding
+// them makes, so that a warm start can replay those calls (see
+// iconvg_display_list_cache__replay) without running the bytecode interpreter.
+// Entries are keyed by their IconVG file's digest and length.
+//
+// The cache format (all numbers are little-endian) is:
+//   - a 32-byte header: the 8-byte magic "\x8AIVGdlst", a u32 version (2), a
+//     u32 number of entries N, a u64 palette key and a u64 total cache
+//     length. The palette key is zero if the cache was written without a
+//     custom palette, otherwise the first 8 bytes (as a u64) of the digest of
+//     that palette's 256 bytes, with the low bit set.
+//   - an index of N 40-byte entries: a 16-byte source digest, a u64 source
+//     length, a u64 body offset and a u64 body length. Entries are sorted by
+//     source digest (compared as bytes) and then by source length. The digest
+//     is the unkeyed 128-bit BLAKE2s (RFC 7693) digest.
+//   - the bodies, each starting at an 8-byte aligned offset.
+//
+// Each body holds the ViewBox (four f32 values), a u32 number of variants V,
+// u32 flags, the suggested palette (256 bytes, only if the flags' low bit is
+// set, otherwise it is the default palette) and V 16-byte variant headers: an
+// i64 minimum height_in_pixels, a u32 verb stream offset (relative to the
+// body) and a u32 verb stream length. Variants are sorted by minimum height, the
+// first one's being INT64_MIN, and each covers the heights up to the next
+// one's minimum. Files without Level of Detail jumps have only one variant.
+//
+// A verb stream is the flattened canvas calls between on_metadata_etc and
+// end_decode, each a verb byte followed by its arguments. Path coordinates
+// are f32 values in src (viewbox) coordinate space. Paints are resolved: flat
+// colors are stored as a u32 premultiplied color.
+//
+// iconvg_write_display_list_cache writes cache files.
+//
+// ptr and len hold the entire cache. file is what
+// iconvg_display_list_cache__open_mmap opened (and
+// iconvg_display_list_cache__close closes), holding that memory. It is
+// zero-valued for iconvg_display_list_cache__open_bytes.
+typedef struct iconvg_display_list_cache_struct {
+  const uint8_t* ptr;
+  size_t len;
+  uint32_t num_entries;
+  iconvg_file file;
+} iconvg_display_list_cache;  // ¶0.1
+
+// ----
+
+// iconvg_compiled_icon and the other iconvg_compiled_etc types are what the C
+// code generated by iconvg_write_c_source (or by the iconvg-to-c tool) is
+// built from. Users of that code don't need to know their details.
+//
+// A compiled icon has one variant function per distinct Level of Detail
+// range. Each makes the canvas calls that iconvg_decode would make, as
+// straight-line code with constant src (viewbox) space coordinates.
+
+struct iconvg_compiled_frame_struct;
+
+// iconvg_compiled_paint is an end_drawing call's paint. Its fields hold the
+// decoder's state at that call. regs points to the 64 color and number
+// registers. Bit i of palette_regs is set when the i'th register was never
+// written, so that it holds the i'th custom (or suggested) palette color,
+// whatever the palette is at run time. Bit k of live_regs is set when the
+// paint's methods can read the register numbered ((which_regs + k) & 63).
+typedef struct iconvg_compiled_paint_struct {
+  const uint64_t* regs;
+  uint64_t palette_regs;
+  uint64_t live_regs;
+  float transform[6];
+  uint8_t paint_type;
+  uint8_t spread;
+  uint8_t num_stops;
+  uint8_t which_regs;
+} iconvg_compiled_paint;  // ¶0.1
+
+// iconvg_compiled_variant is a variant function and the minimum
+// height_in_pixels that it applies to.
+typedef struct iconvg_compiled_variant_struct {
+  int64_t min_height_in_pixels;
+  const char* (*func)(iconvg_canvas* c,
+                      const struct iconvg_compiled_frame_struct* f);
+} iconvg_compiled_variant;  // ¶0.1
+
+// iconvg_compiled_icon is everything that a compiled icon knows about its
+// IconVG file. The variants are sorted by minimum height, the first one's
+// being INT64_MIN. A NULL suggested_palette means the default palette.
+typedef struct iconvg_compiled_icon_struct {
+  iconvg_rectangle_f32 viewbox;
+  const iconvg_palette* suggested_palette;
+  size_t src_len;
+  size_t num_variants;
+  const iconvg_compiled_variant* variants;
+} iconvg_compiled_icon;  // ¶0.1
+
+// iconvg_compiled_frame is a variant function's per-call state: the src to
+// dst coordinate transform (see iconvg_compiled_icon__decode) and the paint
+// that iconvg_compiled_frame__end_drawing passes to the canvas. The skew
+// fields are zero unless iconvg_decode_options.dst_transform rotates or
+// skews. The transform is:
+//
+//   dst_x = (src_x * s2d_scale_x) + (src_y * s2d_skew_x) + s2d_bias_x
+//   dst_y = (src_x * s2d_skew_y) + (src_y * s2d_scale_y) + s2d_bias_y
+typedef struct iconvg_compiled_frame_struct {
+  double s2d_scale_x;
+  double s2d_bias_x;
+  double s2d_scale_y;
+  double s2d_bias_y;
+  iconvg_paint* paint;
+  double s2d_skew_x;
+  double s2d_skew_y;
+} iconvg_compiled_frame;  // ¶0.1
+
+// ----
+
+// iconvg_encoder writes an IconVG file, op by op, into a caller-supplied
+// buffer. The encoder itself never allocates memory. When the buffer is full,
+// it calls grow_func (if non-NULL) to obtain a larger one.
+//
+// The encoded bytes so far are ptr[.. len] and the buffer's capacity is cap.
+// grow_func should set *ptr and *cap to a buffer of at least min_cap bytes
+// that starts with the old buffer's contents (as realloc would) or else
+// return an error. If grow_func is NULL then a full buffer is an
+// iconvg_error_system_failure_out_of_memory error.
+//
+// Methods that fail leave ptr[.. len] unchanged but, once one has failed,
+// every later method call returns that same error, so that callers can
+// check for errors only once, after iconvg_encoder__finish.
+//
+// private_impl's fields are private implementation details. Users should not
+// read or write them directly.
+typedef struct iconvg_encoder_struct {
+  uint8_t* ptr;
+  size_t len;
+  size_t cap;
+  const char* (*grow_func)(void* grow_context,
+                           uint8_t** ptr,
+                           size_t* cap,
+                           size_t min_cap);
+  void* grow_context;
+
+  struct {
+    const char* err_msg;
+    size_t run_offset;
+    uint32_t run_reps;
+    uint8_t run_opcode;
+    bool wrote_metadata;
+  } private_impl;
+} iconvg_encoder;  // ¶0.1
+
+// ----
+
+// iconvg_op_type says which iconvg_canvas_vtable method iconvg_decode would
+// have called for an iconvg_op. The NONE type means no more ops.
+typedef enum iconvg_op_type_enum {
+  ICONVG_OP_TYPE__NONE = 0,                           // ¶0.1
+  ICONVG_OP_TYPE__BEGIN_DRAWING = 1,                  // ¶0.1
+  ICONVG_OP_TYPE__END_DRAWING = 2,                    // ¶0.1
+  ICONVG_OP_TYPE__BEGIN_PATH = 3,                     // ¶0.1
+  ICONVG_OP_TYPE__END_PATH = 4,                       // ¶0.1
+  ICONVG_OP_TYPE__PATH_LINE_TO = 5,                   // ¶0.1
+  ICONVG_OP_TYPE__PATH_QUAD_TO = 6,                   // ¶0.1
+  ICONVG_OP_TYPE__PATH_CUBE_TO = 7,                   // ¶0.1
+  ICONVG_OP_TYPE__ON_METADATA_VIEWBOX = 8,            // ¶0.1
+  ICONVG_OP_TYPE__ON_METADATA_SUGGESTED_PALETTE = 9,  // ¶0.1
+} iconvg_op_type;                                     // ¶0.1
+
+// iconvg_op is one iconvg_canvas_vtable method call, as data. Its fields are
+// that method's arguments and fields that don't apply to its type are zero.
+// The coordinates are in dst space. For example, a PATH_QUAD_TO op's x1, y1,
+// x2 and y2 are the path_quad_to method's arguments.
+//
+// paint (for END_DRAWING ops) points into the iconvg_op_iterator and is
+// valid until the next iconvg_op_iterator__next call. suggested_palette
+// (for ON_METADATA_SUGGESTED_PALETTE ops) is valid for the iterator's
+// lifetime.
+typedef struct iconvg_op_struct {
+  iconvg_op_type type;
+  float x0;
+  float y0;
+  float x1;
+  float y1;
+  float x2;
+  float y2;
+  float x3;
+  float y3;
+  iconvg_rectangle_f32 viewbox;
+  const iconvg_palette* suggested_palette;
+  const iconvg_paint* paint;
+} iconvg_op;  // ¶0.1
+
+// ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE is the number of uint64_t elements
+// that an iconvg_op_iterator reserves for its (opaque) iconvg_paint.
+#define ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE 128
+
+// ICONVG_OP_ITERATOR__MAX_PENDING_OPS is the capacity of an
+// iconvg_op_iterator's queue of ops produced but not yet returned. A single
+// IconVG opcode produces at most this many ops, other than those that repeat
+// (e.g. a LineTo with 100 coordinate pairs), which are produced one by one.
+#define ICONVG_OP_ITERATOR__MAX_PENDING_OPS 8
+
+// iconvg_op_iterator is a pull-style alternative to iconvg_decode. Instead of
+// calling an iconvg_canvas' methods, it returns each call as an iconvg_op,
+// one per iconvg_op_iterator__next call. It never allocates memory: it only
+// holds the src bytes' pointer (which must stay valid while iterating) and a
+// fixed amount of decoder state.
+//
+// private_impl's fields are private implementation details. Users should not
+// read or write them directly.
+typedef struct iconvg_op_iterator_struct {
+  struct {
+    const char* err_msg;
+    const uint8_t* src_ptr;
+    size_t src_len;
+    uint32_t num_reps;
+    uint8_t rep_opcode;
+    bool done;
+    uint8_t ops_ri;
+    uint8_t ops_wi;
+    iconvg_op ops[ICONVG_OP_ITERATOR__MAX_PENDING_OPS];
+    iconvg_palette suggested_palette;
+    uint64_t paint[ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE];
+  } private_impl;
+} iconvg_op_iterator;  // ¶0.1
+
+// ----
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -488,6 +1070,53 @@ iconvg_canvas__make_debug(  // ¶0.1
     const char* message_prefix,
     iconvg_canvas* wrapped);
 
+// iconvg_canvas__make_profiler returns an iconvg_canvas that forwards vtable
+// calls on to the wrapped iconvg_canvas, recording statistics about those
+// calls (and how long the wrapped canvas took to respond) in *profile.
+//
+// Unlike iconvg_canvas__make_debug, its overhead (on the order of two clock
+// reads per path or drawing call) is low enough for production use, but it
+// is not thread-safe. To profile multiple threads, give each thread its own
+// iconvg_profile and combine them afterwards with iconvg_profile__merge.
+//
+// The monotonic clock is clock_gettime(CLOCK_MONOTONIC) if <time.h> provides
+// it, which on some systems requires defining _POSIX_C_SOURCE (to 199309L or
+// later) before #include'ing this library. Otherwise, it falls back to C11's
+// timespec_get or, failing that, to the (per-process CPU time) clock function.
+//
+// profile may be NULL, in which case nothing is recorded.
+//
+// wrapped may be NULL, in which case the iconvg_canvas vtable calls always
+// return success (a NULL error message) except that end_decode returns its
+// (possibly non-NULL) err_msg argument unchanged.
+//
+// If any of the pointer-typed arguments are non-NULL then the caller of this
+// function is responsible for ensuring that the pointers remain valid while
+// the returned iconvg_canvas is in use.
+iconvg_canvas                  //
+iconvg_canvas__make_profiler(  // ¶0.1
+    iconvg_canvas* wrapped,
+    iconvg_profile* profile);
+
+// iconvg_canvas__make_trace returns an iconvg_canvas that appends binary
+// records of the vtable calls to *trace before forwarding the call on to the
+// wrapped iconvg_canvas. It is a compact, cheaper alternative to
+// iconvg_canvas__make_debug, intended for capturing production renders.
+//
+// trace may be NULL, in which case nothing is recorded.
+//
+// wrapped may be NULL, in which case the iconvg_canvas vtable calls always
+// return success (a NULL error message) except that end_decode returns its
+// (possibly non-NULL) err_msg argument unchanged.
+//
+// If any of the pointer-typed arguments are non-NULL then the caller of this
+// function is responsible for ensuring that the pointers remain valid while
+// the returned iconvg_canvas is in use.
+iconvg_canvas               //
+iconvg_canvas__make_trace(  // ¶0.1
+    iconvg_canvas* wrapped,
+    iconvg_trace* trace);
+
 // iconvg_canvas__does_nothing returns whether self is NULL or *self is
 // zero-valued or broken. Other canvas values are presumed to do something.
 // Zero-valued means the result of "iconvg_canvas c = {0}". Broken means the
@@ -554,6 +1183,26 @@ iconvg_canvas__make_skia(  // ¶0.1
 // this function, iconvg_decode, returns whatever end_decode returns.
 //
 // options may be NULL, in which case default values will be used.
+//
+// For profiling, the IconVG library can be built with the
+// ICONVG_CONFIG__OP_OBSERVER(op_ptr) macro defined. It is then invoked, with
+// a const uint8_t* pointing into src, just before each op is executed. Ops
+// that are skipped over (by a jump op) are not observed.
+//
+// With GCC or Clang, the bytecode interpreter dispatches each op with a
+// computed goto (a GNU C extension). Building the IconVG library with the
+// ICONVG_CONFIG__DISABLE_COMPUTED_GOTO macro defined uses a portable switch
+// statement instead.
+//
+// For targets without floating point hardware, the IconVG library can be
+// built with the ICONVG_CONFIG__FIXED_POINT macro defined. Path coordinates
+// are then decoded as 24.8 fixed point numbers, and transformed to dst space
+// (and expanded from Ellipse ops) with integer arithmetic. Only 4-byte
+// coordinates, setting up each decode's transform and calling a canvas
+// without the vtable's optional etc__fixed fields need floating point. The
+// results can differ from the default build's by about 1/256 of a src unit
+// (times the src-to-dst scale). Coordinates beyond ±(1 << 23) saturate, as do
+// scales beyond 4096 dst units per src unit.
 const char*     //
 iconvg_decode(  // ¶0.1
     iconvg_canvas* dst_canvas,
@@ -562,6 +1211,52 @@ iconvg_decode(  // ¶0.1
     size_t src_len,
     const iconvg_decode_options* options);
 
+struct iovec;
+
+// iconvg_decode_iov is like iconvg_decode but the src IconVG-formatted data is
+// the concatenation of iov[0 .. iovcnt], each a POSIX struct iovec (on
+// platforms without <sys/uio.h>, one with the same iov_base and iov_len
+// fields). The fragments need not be coalesced: numbers and coordinates that
+// straddle fragment boundaries are copied into a small internal buffer, and
+// everything else is read in place.
+//
+// ICONVG_CONFIG__OP_OBSERVER's op_ptr points into one of the fragments.
+const char*         //
+iconvg_decode_iov(  // ¶0.1
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const struct iovec* iov,
+    int iovcnt,
+    const iconvg_decode_options* options);
+
+// iconvg_op_iterator__make returns an iterator over the iconvg_op values
+// that iconvg_decode(canvas, dst_rect, src_ptr, src_len, options) would pass
+// to its canvas, other than begin_decode and end_decode. src_ptr[.. src_len]
+// must remain valid while the iterator is in use. options may be NULL.
+//
+// Example code:
+//   iconvg_op_iterator it = iconvg_op_iterator__make(r, ptr, len, NULL);
+//   iconvg_op op;
+//   while (!(err = iconvg_op_iterator__next(&it, &op)) &&
+//          (op.type != ICONVG_OP_TYPE__NONE)) {
+//     etc;
+//   }
+iconvg_op_iterator         //
+iconvg_op_iterator__make(  // ¶0.1
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// iconvg_op_iterator__next sets *dst_op to the next op. After the last op, it
+// sets dst_op->type to ICONVG_OP_TYPE__NONE. Decoding errors are returned
+// after the ops that iconvg_decode would have produced before that error.
+// Once it returns NONE or an error, it keeps doing so.
+const char*                //
+iconvg_op_iterator__next(  // ¶0.1
+    iconvg_op_iterator* self,
+    iconvg_op* dst_op);
+
 // iconvg_decode_viewbox sets *dst_viewbox to the ViewBox Metadata from the src
 // IconVG-formatted data.
 //
@@ -576,6 +1271,28 @@ iconvg_decode_viewbox(  // ¶0.1
     const uint8_t* src_ptr,
     size_t src_len);
 
+// iconvg_validate checks that src is well-formed IconVG data, returning NULL
+// if so or else the first file format error. That error is the same as what
+// iconvg_decode would return for an op that it executes, other than
+// iconvg_error_bad_segref, which only iconvg_validate checks for.
+//
+// It is much cheaper than iconvg_decode with a broken canvas, as it only
+// checks lengths, number encodings, jump targets, Call ops' SegRefs and
+// gradient register windows. It does not convert coordinates to dst space
+// or call any canvas methods.
+//
+// Every op is checked, regardless of the rendering height or whether a Level
+// of Detail or other jump would skip over it (or whether a RET op precedes
+// it). A valid src is therefore decodable at any height, but some src that
+// iconvg_decode accepts (at some heights) are rejected.
+//
+// report may be NULL. If not, it is filled in, whether or not src is valid.
+const char*       //
+iconvg_validate(  // ¶0.1
+    const uint8_t* src_ptr,
+    size_t src_len,
+    iconvg_validate_report* report);
+
 // ----
 
 // iconvg_paint__type returns what type of paint self is.
@@ -666,6 +1383,459 @@ iconvg_paint__gradient_transformation_matrix(  // ¶0.1
 
 // ----
 
+// iconvg_histogram__add adds one value to self.
+void                    //
+iconvg_histogram__add(  // ¶0.1
+    iconvg_histogram* self,
+    uint64_t value);
+
+// iconvg_histogram__merge adds all of other's values to self.
+void                      //
+iconvg_histogram__merge(  // ¶0.1
+    iconvg_histogram* self,
+    const iconvg_histogram* other);
+
+// iconvg_histogram__percentile returns an upper bound (the exclusive upper
+// bound of the matching bucket, capped at self->max) for the p'th percentile
+// value, where p ranges from 0.0 to 100.0. It returns zero if self is empty.
+uint64_t                       //
+iconvg_histogram__percentile(  // ¶0.1
+    const iconvg_histogram* self,
+    double p);
+
+// ----
+
+// iconvg_profile__merge adds all of other's statistics to self. It can be
+// used to combine per-thread profiles.
+void                    //
+iconvg_profile__merge(  // ¶0.1
+    iconvg_profile* self,
+    const iconvg_profile* other);
+
+// iconvg_profile__write_json writes self to f as a JSON object. Histograms
+// are written as their count, sum, max, p50, p90 and p99 and their non-empty
+// buckets (keyed by each bucket's exclusive upper bound).
+//
+// Check ferror(f) afterwards to detect write errors.
+void                         //
+iconvg_profile__write_json(  // ¶0.1
+    const iconvg_profile* self,
+    FILE* f);
+
+// ----
+
+// iconvg_trace__replay calls c's vtable methods as recorded in self, oldest
+// record first. If the ring buffer has wrapped around, records before the
+// oldest complete begin_decode record are skipped.
+//
+// As with iconvg_decode, if one of c's methods (other than end_decode)
+// returns an error then the rest of that decode's records are skipped and
+// c's end_decode is called with that error. Otherwise, end_decode is called
+// with the recorded err_msg. Recorded error messages that aren't built-in
+// iconvg_error_etc constants are replayed as iconvg_error_invalid_trace.
+//
+// The iconvg_paint passed to end_drawing is a snapshot: its iconvg_paint__etc
+// methods return what the recorded paint's did, for the methods that apply to
+// its paint type.
+//
+// It returns the first non-NULL end_decode result, or
+// iconvg_error_invalid_trace if self's records are malformed.
+const char*            //
+iconvg_trace__replay(  // ¶0.1
+    const iconvg_trace* self,
+    iconvg_canvas* c);
+
+// ----
+
+// iconvg_file__open loads the file at path, memory-mapping it if possible
+// and otherwise reading it into memory allocated by allocator, which may be
+// NULL.
+//
+// On success, the caller is responsible for calling iconvg_file__close, and
+// the allocator must outlive the iconvg_file. On failure, *self is zeroed and
+// nothing needs closing.
+const char*         //
+iconvg_file__open(  // ¶0.1
+    iconvg_file* self,
+    const char* path,
+    iconvg_allocator* allocator);
+
+// iconvg_file__open_stream is like iconvg_file__open but reads f (such as
+// stdin) until EOF. It does not close f.
+const char*                //
+iconvg_file__open_stream(  // ¶0.1
+    iconvg_file* self,
+    FILE* f,
+    iconvg_allocator* allocator);
+
+// iconvg_file__close releases self's memory and zeroes *self.
+void                 //
+iconvg_file__close(  // ¶0.1
+    iconvg_file* self);
+
+// ----
+
+// iconvg_pack__open_mmap opens the pack file at path with iconvg_file__open,
+// memory-mapping it read-only where possible (or else reading it into memory
+// allocated by allocator, which may be NULL), and checks its header and index.
+//
+// On success, the caller is responsible for calling iconvg_pack__close, and
+// the allocator must outlive the pack. On failure, *self is zeroed and
+// nothing needs closing.
+const char*              //
+iconvg_pack__open_mmap(  // ¶0.1
+    iconvg_pack* self,
+    const char* path,
+    iconvg_allocator* allocator);
+
+// iconvg_pack__open_bytes is like iconvg_pack__open_mmap but the pack is
+// already in memory. The caller owns ptr[.. len], which must remain valid
+// until the pack is no longer used. Calling iconvg_pack__close is optional.
+const char*               //
+iconvg_pack__open_bytes(  // ¶0.1
+    iconvg_pack* self,
+    const uint8_t* ptr,
+    size_t len);
+
+// iconvg_pack__close releases self's memory (if iconvg_pack__open_mmap
+// obtained it) and zeroes *self.
+void                 //
+iconvg_pack__close(  // ¶0.1
+    iconvg_pack* self);
+
+// iconvg_pack__find returns the entry named name[.. name_len], using a binary
+// search of the index, or a zero-valued entry if there is no such entry.
+iconvg_pack_entry   //
+iconvg_pack__find(  // ¶0.1
+    const iconvg_pack* self,
+    const char* name,
+    size_t name_len);
+
+// iconvg_pack__entry returns the i'th entry in index order (sorted by name
+// hash), or a zero-valued entry if i is out of bounds.
+iconvg_pack_entry    //
+iconvg_pack__entry(  // ¶0.1
+    const iconvg_pack* self,
+    uint32_t i);
+
+// ----
+
+// iconvg_write_display_list_cache decodes the num_srcs IconVG files
+// src_ptrs[i][.. src_lens[i]] and writes their display lists to f, in the
+// iconvg_display_list_cache format. Each file is decoded once per distinct
+// Level of Detail range, so that the cache serves every height_in_pixels.
+//
+// options->palette, if non-NULL, is baked into the cache's resolved colors.
+// options->height_in_pixels is ignored.
+//
+// Files that iconvg_validate rejects, files with more than 64 distinct Level
+// of Detail thresholds and duplicate files are left out of the cache, so that
+// replaying them falls back to iconvg_decode.
+//
+// It returns iconvg_error_system_failure_out_of_memory if it could not
+// allocate its working memory (from options->allocator, if non-NULL). Check
+// ferror(f) afterwards to detect write errors.
+const char*                       //
+iconvg_write_display_list_cache(  // ¶0.1
+    FILE* f,
+    const uint8_t* const* src_ptrs,
+    const size_t* src_lens,
+    size_t num_srcs,
+    const iconvg_decode_options* options);
+
+// iconvg_display_list_cache__open_mmap opens the cache file at path with
+// iconvg_file__open, memory-mapping it read-only where possible (or else
+// reading it into memory allocated by allocator, which may be NULL), and
+// checks its header and index.
+//
+// On success, the caller is responsible for calling
+// iconvg_display_list_cache__close, and the allocator must outlive the cache.
+// On failure, *self is zeroed and nothing needs closing.
+const char*                            //
+iconvg_display_list_cache__open_mmap(  // ¶0.1
+    iconvg_display_list_cache* self,
+    const char* path,
+    iconvg_allocator* allocator);
+
+// iconvg_display_list_cache__open_bytes is like
+// iconvg_display_list_cache__open_mmap but the cache is already in memory. The
+// caller owns ptr[.. len], which must remain valid until the cache is no
+// longer used. Calling iconvg_display_list_cache__close is optional.
+const char*                             //
+iconvg_display_list_cache__open_bytes(  // ¶0.1
+    iconvg_display_list_cache* self,
+    const uint8_t* ptr,
+    size_t len);
+
+// iconvg_display_list_cache__close releases self's memory (if
+// iconvg_display_list_cache__open_mmap obtained it) and zeroes *self.
+void                               //
+iconvg_display_list_cache__close(  // ¶0.1
+    iconvg_display_list_cache* self);
+
+// iconvg_display_list_cache__contains returns whether
+// iconvg_display_list_cache__replay, given the same arguments, would replay
+// from the cache instead of falling back to iconvg_decode.
+bool                                  //
+iconvg_display_list_cache__contains(  // ¶0.1
+    const iconvg_display_list_cache* self,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// iconvg_display_list_cache__replay is like iconvg_decode but, if self has an
+// entry for src_ptr[.. src_len] (and for options->palette), it calls
+// dst_canvas' methods from that entry instead of running the bytecode
+// interpreter. Finding the entry still computes src_ptr[.. src_len]'s digest.
+//
+// The calls are those that iconvg_decode would make, with the same arguments,
+// except that:
+//   - end_decode's num_bytes_consumed and num_bytes_remaining are src_len and
+//     0 (or 0 and src_len if one of dst_canvas' methods failed).
+//   - path coordinates were rounded to float32 in src space, not dst space.
+//     Where iconvg_decode computes them in float64 (e.g. for ellipses), they
+//     can differ in their least significant bits.
+//   - as with iconvg_trace__replay, the iconvg_paint passed to end_drawing is
+//     a snapshot.
+//
+// If there is no such entry, it calls iconvg_decode.
+const char*                         //
+iconvg_display_list_cache__replay(  // ¶0.1
+    const iconvg_display_list_cache* self,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// ----
+
+// iconvg_write_c_source writes C code to f that defines a function named
+// function_name, with the same signature as iconvg_decode minus the src_ptr
+// and src_len arguments:
+//
+//   const char* function_name(iconvg_canvas* dst_canvas,
+//                             iconvg_rectangle_f32 dst_rect,
+//                             const iconvg_decode_options* options);
+//
+// Calling it is like calling iconvg_decode on src_ptr[.. src_len], with the
+// differences listed for iconvg_display_list_cache__replay, but without
+// running the bytecode interpreter. options->palette and
+// options->height_in_pixels still apply. The code refers to static
+// definitions whose names start with function_name followed by two
+// underscores. It does not #include the IconVG header: the caller writes
+// that (and any other preamble) first.
+//
+// function_name must be a valid C identifier. It returns an error if
+// iconvg_validate rejects src_ptr[.. src_len]. Files with more than 64
+// distinct Level of Detail thresholds are not compiled: the function instead
+// embeds the file and calls iconvg_decode. Its working memory comes from
+// allocator, which may be NULL. Check ferror(f) afterwards to detect write
+// errors.
+const char*             //
+iconvg_write_c_source(  // ¶0.1
+    FILE* f,
+    const char* function_name,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    iconvg_allocator* allocator);
+
+// iconvg_compiled_icon__decode is what the function that iconvg_write_c_source
+// generates calls. It makes the begin_decode and on_metadata_etc calls, picks
+// the variant for the height_in_pixels and calls that variant's function with
+// a frame whose scale and bias transform from src to dst coordinates:
+//
+//   dst_x = (src_x * s2d_scale_x) + s2d_bias_x
+//   dst_y = (src_y * s2d_scale_y) + s2d_bias_y
+//
+// It then calls end_decode as iconvg_display_list_cache__replay does.
+const char*                    //
+iconvg_compiled_icon__decode(  // ¶0.1
+    const iconvg_compiled_icon* self,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_decode_options* options);
+
+// iconvg_compiled_frame__end_drawing calls c's end_drawing method with self's
+// paint, set up to be equivalent to the decoder's, given paint.
+const char*                          //
+iconvg_compiled_frame__end_drawing(  // ¶0.1
+    const iconvg_compiled_frame* self,
+    iconvg_canvas* c,
+    const iconvg_compiled_paint* paint);
+
+// ----
+
+// iconvg_encoder__initialize sets self to encode into ptr[.. cap], with the
+// given grow_func and grow_context (see iconvg_encoder). ptr may be NULL if
+// cap is zero. Re-initializing an encoder starts a new IconVG file.
+const char*                  //
+iconvg_encoder__initialize(  // ¶0.1
+    iconvg_encoder* self,
+    uint8_t* ptr,
+    size_t cap,
+    const char* (*grow_func)(void* grow_context,
+                             uint8_t** ptr,
+                             size_t* cap,
+                             size_t min_cap),
+    void* grow_context);
+
+// iconvg_encoder__write_metadata writes the magic identifier and metadata.
+// viewbox and suggested_palette may be NULL, meaning the file format's
+// default values. Chunks that would only repeat the defaults are left out.
+//
+// If called at all, it must be called before any other write method.
+// Otherwise, the first op or iconvg_encoder__finish writes a default
+// (empty) metadata.
+const char*                      //
+iconvg_encoder__write_metadata(  // ¶0.1
+    iconvg_encoder* self,
+    const iconvg_rectangle_f32* viewbox,
+    const iconvg_palette* suggested_palette);
+
+// iconvg_encoder__move_to writes a ClosePathMoveTo op, closing any current
+// path and starting a new one at (x, y).
+//
+// Every coordinate number, for this and the other path ops, is written in
+// the shortest (1, 2 or 4 byte) encoding that represents it exactly. 4-byte
+// encodings round off the float32 mantissa's two lowest bits. NaN
+// coordinates are an iconvg_error_bad_coordinate error.
+const char*               //
+iconvg_encoder__move_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x,
+    float y);
+
+// iconvg_encoder__line_to writes a LineTo segment. Consecutive segments of
+// the same kind (consecutive line_to calls, consecutive quad_to calls or
+// consecutive cube_to calls) are merged into a single op with a RepCount.
+const char*               //
+iconvg_encoder__line_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x,
+    float y);
+
+// iconvg_encoder__quad_to writes a QuadTo segment, merged as per
+// iconvg_encoder__line_to.
+const char*               //
+iconvg_encoder__quad_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x1,
+    float y1,
+    float x2,
+    float y2);
+
+// iconvg_encoder__cube_to writes a CubeTo segment, merged as per
+// iconvg_encoder__line_to.
+const char*               //
+iconvg_encoder__cube_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x1,
+    float y1,
+    float x2,
+    float y2,
+    float x3,
+    float y3);
+
+// iconvg_encoder__ellipse writes an Ellipse op, whose num_quarters must be in
+// the range [1 ..= 4]. The pen position and (x1, y1) and (x2, y2) are three
+// of the four corners of the ellipse's bounding parallelogram.
+const char*               //
+iconvg_encoder__ellipse(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t num_quarters,
+    float x1,
+    float y1,
+    float x2,
+    float y2);
+
+// iconvg_encoder__parallelogram writes a Parallelogram op. The pen position
+// and (x1, y1) and (x2, y2) are three of the parallelogram's four corners.
+const char*                     //
+iconvg_encoder__parallelogram(  // ¶0.1
+    iconvg_encoder* self,
+    float x1,
+    float y1,
+    float x2,
+    float y2);
+
+// iconvg_encoder__set_register sets REGS[SEL + adj] to value, where adj must
+// be in the range [0 ..= 15]. As per the file format, an adj of zero also
+// decrements SEL. It writes a 5-byte op if either half of value is zero,
+// otherwise a 9-byte op.
+const char*                    //
+iconvg_encoder__set_register(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint64_t value);
+
+// iconvg_encoder__set_registers decrements SEL by num_values and then sets
+// REGS[SEL + 1], REGS[SEL + 2], etc. to values[0], values[1], etc., using as
+// few ops as possible. num_values must be at most 64.
+const char*                     //
+iconvg_encoder__set_registers(  // ¶0.1
+    iconvg_encoder* self,
+    const uint64_t* values,
+    size_t num_values);
+
+// iconvg_encoder__add_to_sel adds delta (modulo 64) to SEL.
+const char*                  //
+iconvg_encoder__add_to_sel(  // ¶0.1
+    iconvg_encoder* self,
+    uint8_t delta);
+
+// iconvg_encoder__fill_flat writes a flat color Fill op, filling with
+// REGS[SEL + adj], where adj must be in the range [0 ..= 15]. As per the file
+// format, an adj of zero also first increments SEL.
+const char*                 //
+iconvg_encoder__fill_flat(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj);
+
+// iconvg_encoder__fill_flat_color fills with color. It sets the high 32 bits
+// of REGS[SEL + 1] (and zeroes its low 32 bits) and then fills with that
+// register. A non-sensible color means a blend, as per the file format.
+const char*                       //
+iconvg_encoder__fill_flat_color(  // ¶0.1
+    iconvg_encoder* self,
+    iconvg_premul_color color);
+
+// iconvg_encoder__fill_linear_gradient writes a linear gradient Fill op. The
+// num_stops (in the range [2 ..= 64]) gradient stops are REGS[SEL + adj],
+// REGS[SEL + adj + 1], etc., where adj must be in the range [0 ..= 15]. As
+// per the file format, an adj of zero also first increments SEL.
+//
+// nominal_matrix transforms from src (viewbox) space to gradient pattern
+// space. Only its first row is written (as float32 values), as linear
+// gradients ignore the second.
+const char*                            //
+iconvg_encoder__fill_linear_gradient(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix);
+
+// iconvg_encoder__fill_radial_gradient is like
+// iconvg_encoder__fill_linear_gradient but for a radial gradient, writing
+// both rows of nominal_matrix.
+const char*                            //
+iconvg_encoder__fill_radial_gradient(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix);
+
+// iconvg_encoder__finish writes the metadata, if nothing has been written
+// yet, and returns the first error (if any) of all of self's method calls.
+// On success, the complete IconVG file is self->ptr[.. self->len].
+const char*              //
+iconvg_encoder__finish(  // ¶0.1
+    iconvg_encoder* self);
+
+// ----
+
 // iconvg_matrix_2x3_f64__inverse returns self's inverse.
 iconvg_matrix_2x3_f64            //
 iconvg_matrix_2x3_f64__inverse(  // ¶0.1
@@ -767,6 +1937,23 @@ iconvg_private_poke_u32le(uint8_t* p, uint32_t x) {
   p[3] = (uint8_t)(x >> 24);
 }
 
+static inline void  //
+iconvg_private_poke_u64le(uint8_t* p, uint64_t x) {
+  iconvg_private_poke_u32le(p + 0, (uint32_t)(x >> 0));
+  iconvg_private_poke_u32le(p + 4, (uint32_t)(x >> 32));
+}
+
+// iconvg_private_hash_fnv1a_64 returns the 64-bit FNV-1a hash of p[.. n].
+static inline uint64_t  //
+iconvg_private_hash_fnv1a_64(const uint8_t* p, size_t n) {
+  uint64_t h = 0xCBF29CE484222325u;
+  for (; n > 0; n--) {
+    h ^= *p++;
+    h *= 0x00000100000001B3u;
+  }
+  return h;
+}
+
 static inline float  //
 iconvg_private_reinterpret_from_u32_to_f32(uint32_t u) {
   float f = 0;
@@ -776,6 +1963,33 @@ iconvg_private_reinterpret_from_u32_to_f32(uint32_t u) {
   return f;
 }
 
+static inline uint32_t  //
+iconvg_private_reinterpret_from_f32_to_u32(float f) {
+  uint32_t u = 0;
+  if (sizeof(uint32_t) == sizeof(float)) {
+    memcpy(&u, &f, sizeof(uint32_t));
+  }
+  return u;
+}
+
+static inline double  //
+iconvg_private_reinterpret_from_u64_to_f64(uint64_t u) {
+  double f = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&f, &u, sizeof(uint64_t));
+  }
+  return f;
+}
+
+static inline uint64_t  //
+iconvg_private_reinterpret_from_f64_to_u64(double f) {
+  uint64_t u = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&u, &f, sizeof(uint64_t));
+  }
+  return u;
+}
+
 // ----
 
 static inline size_t  //
@@ -786,6 +2000,33 @@ iconvg_private_canvas_sizeof_vtable(iconvg_canvas* c) {
   return 0;
 }
 
+// iconvg_private_canvas__set_current_point and
+// iconvg_private_canvas__current_point track the current point (the end of
+// the most recent begin_path or path_etc_to call) in dst coordinate space.
+// Backends that need the current point, e.g. to convert quadratic Bézier
+// curves to cubic ones, can use these instead of asking their underlying
+// graphics library, which might have to convert back from its own internal
+// representation.
+//
+// The point is stored (as float32 bits) in the context.extra5 and
+// context.extra6 fields, so backends that use these functions must not use
+// those fields for anything else.
+static inline void  //
+iconvg_private_canvas__set_current_point(iconvg_canvas* c, float x, float y) {
+  c->context.extra5 = iconvg_private_reinterpret_from_f32_to_u32(x);
+  c->context.extra6 = iconvg_private_reinterpret_from_f32_to_u32(y);
+}
+
+static inline void  //
+iconvg_private_canvas__current_point(const iconvg_canvas* c,
+                                     float* x,
+                                     float* y) {
+  *x = iconvg_private_reinterpret_from_u32_to_f32(
+      (uint32_t)(c->context.extra5));
+  *y = iconvg_private_reinterpret_from_u32_to_f32(
+      (uint32_t)(c->context.extra6));
+}
+
 // ----
 
 static inline iconvg_rectangle_f32  //
@@ -800,9 +2041,15 @@ iconvg_private_default_viewbox() {
 
 // ----
 
+struct iconvg_private_decoder_iov_struct;
+
+// iconvg_private_decoder reads from ptr[.. len]. If iov is non-NULL (see
+// iconvg_decode_iov) then more input follows ptr[.. len] and
+// iconvg_private_decoder__refill moves on to it.
 typedef struct iconvg_private_decoder_struct {
   const uint8_t* ptr;
   size_t len;
+  struct iconvg_private_decoder_iov_struct* iov;
 } iconvg_private_decoder;
 
 // ----
@@ -826,6 +2073,18 @@ iconvg_private_last_color_that_isnt_opaque_black(
 
 // ----
 
+// iconvg_private_coord is the type of the decoder's path coordinates, in src
+// (viewbox) space. iconvg_private_wide_coord holds intermediate values, such
+// as an ellipse's cubic Bézier control points. With ICONVG_CONFIG__FIXED_POINT,
+// they are 24.8 fixed point numbers instead of floating point.
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+typedef int32_t iconvg_private_coord;
+typedef int64_t iconvg_private_wide_coord;
+#else
+typedef float iconvg_private_coord;
+typedef double iconvg_private_wide_coord;
+#endif
+
 struct iconvg_paint_struct {
   iconvg_rectangle_f32 viewbox;
   int64_t height_in_pixels;
@@ -847,16 +2106,41 @@ struct iconvg_paint_struct {
   //
   //   400 = ((-32) * 1.5625) + 450
   //   500 = ((+32) * 1.5625) + 450
+  //
+  // A non-NULL iconvg_decode_options.dst_transform can also rotate or skew,
+  // which adds a skew term. When skewed is true:
+  //
+  //   q_x = (p_x * p2q_scale_x) + (p_y * p2q_skew_x) + p2q_bias_x
+  //   q_y = (p_x * p2q_skew_y) + (p_y * p2q_scale_y) + p2q_bias_y
+  //
+  // When skewed is false, the skew fields are zero and unused.
 
   double s2d_scale_x;
   double s2d_bias_x;
   double s2d_scale_y;
   double s2d_bias_y;
+  double s2d_skew_x;
+  double s2d_skew_y;
 
   double d2s_scale_x;
   double d2s_bias_x;
   double d2s_scale_y;
   double d2s_bias_y;
+  double d2s_skew_x;
+  double d2s_skew_y;
+
+  bool skewed;
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  // The s2d_fixed_etc fields are the s2d_etc fields as 16.16 (for scales and
+  // skews) and 24.8 (for biases) fixed point numbers.
+  int64_t s2d_fixed_scale_x;
+  int64_t s2d_fixed_bias_x;
+  int64_t s2d_fixed_scale_y;
+  int64_t s2d_fixed_bias_y;
+  int64_t s2d_fixed_skew_x;
+  int64_t s2d_fixed_skew_y;
+#endif
 
   uint8_t sel;
   bool begun_drawing;
@@ -869,12 +2153,13 @@ struct iconvg_paint_struct {
 
   union {
     // coords[0] are the current x and y coordinates. coords[1..4] are the x
-    // and y coordinates of the path op arguments. That final space (6 floats)
-    // is also used to hold gradient transformation matrices.
-    float coords[4][2];
+    // and y coordinates of the path op arguments. That final space (6 floats
+    // or fixed point numbers) is also used to hold gradient transformation
+    // matrices.
+    iconvg_private_coord coords[4][2];
     struct {
-      float current_x;
-      float current_y;
+      iconvg_private_coord current_x;
+      iconvg_private_coord current_y;
       float transform[6];
     };
   };
@@ -884,6 +2169,88 @@ struct iconvg_paint_struct {
 
 // ----
 
+// The iconvg_private_allocator__etc functions are like malloc, realloc and
+// free but go through a (which may be NULL, meaning the C standard library)
+// and update its counters. The sizes passed to realloc and free must be those
+// of the existing allocation.
+
+void*  //
+iconvg_private_allocator__alloc(iconvg_allocator* a, size_t n);
+
+void*  //
+iconvg_private_allocator__realloc(iconvg_allocator* a,
+                                  void* ptr,
+                                  size_t old_n,
+                                  size_t new_n);
+
+void  //
+iconvg_private_allocator__free(iconvg_allocator* a, void* ptr, size_t n);
+
+// iconvg_private_allocator__from_options returns options->allocator, or NULL
+// if options is NULL or predates that field.
+iconvg_allocator*  //
+iconvg_private_allocator__from_options(const iconvg_decode_options* options);
+
+// ----
+
+// ICONVG_PRIVATE_LOD_THRESHOLDS__MAX is the maximum number of distinct values
+// held by an iconvg_private_lod_thresholds.
+#define ICONVG_PRIVATE_LOD_THRESHOLDS__MAX 64
+
+// iconvg_private_lod_thresholds collects the distinct, finite lower and upper
+// bounds of a file's Jump Level-of-Detail ops, in no particular order.
+// overflowed is whether there were more than can be held.
+typedef struct iconvg_private_lod_thresholds_struct {
+  float values[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX];
+  uint32_t num_values;
+  bool overflowed;
+} iconvg_private_lod_thresholds;
+
+// ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS is the maximum number of
+// values written by iconvg_private_lod_thresholds__breakpoints.
+#define ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS \
+  (ICONVG_PRIVATE_LOD_THRESHOLDS__MAX + 1)
+
+// iconvg_private_lod_thresholds__breakpoints converts Level of Detail
+// thresholds to the sorted, distinct minimum heights of a file's variants,
+// writing them to dst and returning how many there are. The first is always
+// INT64_MIN. A Jump Level-of-Detail op's (lod[0] <= h) and (h < lod[1]) tests,
+// for an integer h, only change value at h = ceil(lod[i]). Breakpoints are
+// clamped to +/-(1 << 53), beyond which int64_t to double conversion is
+// inexact.
+size_t  //
+iconvg_private_lod_thresholds__breakpoints(
+    const iconvg_private_lod_thresholds* self,
+    int64_t* dst);
+
+// iconvg_private_validate is iconvg_validate, also collecting the Level of
+// Detail thresholds into *lods if it is non-NULL.
+const char*  //
+iconvg_private_validate(iconvg_validate_report* r,
+                        const uint8_t* src_ptr,
+                        size_t src_len,
+                        iconvg_private_lod_thresholds* lods);
+
+// iconvg_private_height_in_pixels returns the height that iconvg_decode uses
+// for Level of Detail tests.
+int64_t  //
+iconvg_private_height_in_pixels(iconvg_rectangle_f32 r,
+                                const iconvg_decode_options* options);
+
+// iconvg_private_dst_transform returns the options' dst_transform, or NULL if
+// options is NULL or too old (too small) to have that field.
+const iconvg_matrix_2x3_f64*  //
+iconvg_private_dst_transform(const iconvg_decode_options* options);
+
+// iconvg_private_initialize_remaining_paint_fields sets the iconvg_paint
+// fields after custom_palette, given p->viewbox, the dst_rect r and the
+// optional dst_transform m.
+void  //
+iconvg_private_initialize_remaining_paint_fields(
+    iconvg_paint* p,
+    iconvg_rectangle_f32 r,
+    const iconvg_matrix_2x3_f64* m);
+
 const char*  //
 iconvg_private_path_arc_to(iconvg_canvas* c,
                            double scale_x,
@@ -900,9 +2267,114 @@ iconvg_private_path_arc_to(iconvg_canvas* c,
                            float final_x,
                            float final_y);
 
-// -------------------------------- #include "./broken.c"
+// -------------------------------- #include "./allocator.c"
 
-static const char*  //
+#include <stdlib.h>
+
+// iconvg_private_allocator__admit returns whether growing a's bytes in use by
+// n (after shrinking it by m) stays within a's limit, if it has one.
+static bool  //
+iconvg_private_allocator__admit(const iconvg_allocator* a,
+                                size_t m,
+                                size_t n) {
+  if (a->bytes_in_use_limit == 0) {
+    return true;
+  }
+  uint64_t in_use = a->num_bytes_in_use - m;
+  return (in_use <= a->bytes_in_use_limit) &&
+         (n <= (a->bytes_in_use_limit - in_use));
+}
+
+static void  //
+iconvg_private_allocator__update(iconvg_allocator* a, size_t m, size_t n) {
+  a->num_bytes_requested += n;
+  a->num_bytes_in_use = (a->num_bytes_in_use - m) + n;
+  if (a->peak_bytes_in_use < a->num_bytes_in_use) {
+    a->peak_bytes_in_use = a->num_bytes_in_use;
+  }
+}
+
+void*  //
+iconvg_private_allocator__alloc(iconvg_allocator* a, size_t n) {
+  if (!a) {
+    return malloc(n);
+  }
+  a->num_alloc_calls++;
+  if (!iconvg_private_allocator__admit(a, 0, n)) {
+    return NULL;
+  }
+  void* ptr = a->alloc_func ? (*a->alloc_func)(a->context, n) : malloc(n);
+  if (ptr) {
+    iconvg_private_allocator__update(a, 0, n);
+  }
+  return ptr;
+}
+
+void*  //
+iconvg_private_allocator__realloc(iconvg_allocator* a,
+                                  void* ptr,
+                                  size_t old_n,
+                                  size_t new_n) {
+  if (!a) {
+    return realloc(ptr, new_n);
+  }
+  a->num_realloc_calls++;
+  if (!iconvg_private_allocator__admit(a, old_n, new_n)) {
+    return NULL;
+  }
+
+  void* new_ptr = NULL;
+  if (!a->alloc_func) {
+    new_ptr = realloc(ptr, new_n);
+  } else if (a->realloc_func) {
+    new_ptr = (*a->realloc_func)(a->context, ptr, old_n, new_n);
+  } else {
+    new_ptr = (*a->alloc_func)(a->context, new_n);
+    if (new_ptr && ptr) {
+      memcpy(new_ptr, ptr, (old_n < new_n) ? old_n : new_n);
+      if (a->free_func) {
+        (*a->free_func)(a->context, ptr, old_n);
+      }
+    }
+  }
+
+  if (new_ptr) {
+    iconvg_private_allocator__update(a, old_n, new_n);
+  }
+  return new_ptr;
+}
+
+void  //
+iconvg_private_allocator__free(iconvg_allocator* a, void* ptr, size_t n) {
+  if (!ptr) {
+    return;
+  } else if (!a) {
+    free(ptr);
+    return;
+  }
+  a->num_free_calls++;
+  a->num_bytes_in_use -= n;
+  if (!a->alloc_func) {
+    free(ptr);
+  } else if (a->free_func) {
+    (*a->free_func)(a->context, ptr, n);
+  }
+}
+
+iconvg_allocator*  //
+iconvg_private_allocator__from_options(const iconvg_decode_options* options) {
+  if (!options ||
+      (options->sizeof__iconvg_decode_options <
+       (offsetof(iconvg_decode_options, allocator) +
+        sizeof(options->allocator)))) {
+    return NULL;
+  }
+  return options->allocator;
+}
+
+// -------------------------------- #include "./broken.c"
+
+static const char*  //
 iconvg_private_broken_canvas__begin_decode(iconvg_canvas* c,
                                            iconvg_rectangle_f32 dst_rect) {
   return ((const char*)(c->context.const_ptr3));
@@ -992,6 +2464,10 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_broken_canvas__path_cube_to,
         &iconvg_private_broken_canvas__on_metadata_viewbox,
         &iconvg_private_broken_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
 };
 
 iconvg_canvas  //
@@ -1230,6 +2706,7 @@ static const char*  //
 iconvg_private_cairo_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
   cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
   cairo_move_to(cr, x0, y0);
+  iconvg_private_canvas__set_current_point(c, x0, y0);
   return NULL;
 }
 
@@ -1246,6 +2723,7 @@ iconvg_private_cairo_canvas__path_line_to(iconvg_canvas* c,
                                           float y1) {
   cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
   cairo_line_to(cr, x1, y1);
+  iconvg_private_canvas__set_current_point(c, x1, y1);
   return NULL;
 }
 
@@ -1264,9 +2742,16 @@ iconvg_private_cairo_canvas__path_quad_to(iconvg_canvas* c,
   // Here, we perform "degree elevation" from [x0, x1, x2] to [X0, X1, X2, X3]
   // = [x0, ((⅓ * x0) + (⅔ * x1)), ((⅔ * x1) + (⅓ * x2)), c2] and likewise for
   // the y dimension.
-  double X0;
-  double Y0;
-  cairo_get_current_point(cr, &X0, &Y0);
+  //
+  // We track x0 ourselves, instead of calling cairo_get_current_point, as
+  // Cairo would otherwise convert it back from its fixed-point path
+  // representation and through the inverse of its CTM (Current
+  // Transformation Matrix).
+  float x0;
+  float y0;
+  iconvg_private_canvas__current_point(c, &x0, &y0);
+  double X0 = ((double)x0);
+  double Y0 = ((double)y0);
   double twice_x1 = ((double)x1) * 2;
   double twice_y1 = ((double)y1) * 2;
   double X3 = ((double)x2);
@@ -1276,6 +2761,7 @@ iconvg_private_cairo_canvas__path_quad_to(iconvg_canvas* c,
   double X2 = (X3 + twice_x1) / 3;
   double Y2 = (Y3 + twice_y1) / 3;
   cairo_curve_to(cr, X1, Y1, X2, Y2, X3, Y3);
+  iconvg_private_canvas__set_current_point(c, x2, y2);
   return NULL;
 }
 
@@ -1289,6 +2775,7 @@ iconvg_private_cairo_canvas__path_cube_to(iconvg_canvas* c,
                                           float y3) {
   cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
   cairo_curve_to(cr, x1, y1, x2, y2, x3, y3);
+  iconvg_private_canvas__set_current_point(c, x3, y3);
   return NULL;
 }
 
@@ -1319,6 +2806,10 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_cairo_canvas__path_cube_to,
         &iconvg_private_cairo_canvas__on_metadata_viewbox,
         &iconvg_private_cairo_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
 };
 
 iconvg_canvas  //
@@ -1538,1244 +3029,5284 @@ const iconvg_palette iconvg_private_default_palette = {{
     {{0x00, 0x00, 0x00, 0xFF}},  //
 }};
 
-// -------------------------------- #include "./debug.c"
+// -------------------------------- #include "./compiled.c"
 
-static const char*  //
-iconvg_private_debug_canvas__begin_decode(iconvg_canvas* c,
-                                          iconvg_rectangle_f32 dst_rect) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%sbegin_decode({%g, %g, %g, %g})\n",
-            ((const char*)(c->context.const_ptr3)), dst_rect.min_x,
-            dst_rect.min_y, dst_rect.max_x, dst_rect.max_y);
+#include <stdlib.h>
+
+#define ICONVG_PRIVATE_COMPILED_OP__BEGIN_DRAWING 0x01
+#define ICONVG_PRIVATE_COMPILED_OP__END_DRAWING 0x02
+#define ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH 0x03
+#define ICONVG_PRIVATE_COMPILED_OP__END_PATH 0x04
+#define ICONVG_PRIVATE_COMPILED_OP__PATH_LINE_TO 0x05
+#define ICONVG_PRIVATE_COMPILED_OP__PATH_QUAD_TO 0x06
+#define ICONVG_PRIVATE_COMPILED_OP__PATH_CUBE_TO 0x07
+
+// ----
+
+// iconvg_private_compiled__blend_regs returns the live_regs bits for the
+// registers that a flat color's register value u (shifted right by 32) reads
+// if it is a blend, as per iconvg_private_paint__resolve.
+static inline uint64_t  //
+iconvg_private_compiled__blend_regs(uint32_t u) {
+  uint64_t m = 0;
+  if ((u != 0) && ((u >> 24) == 0)) {
+    uint32_t ug = 0xFF & (u >> 8);
+    uint32_t ub = 0xFF & (u >> 16);
+    if (ug >= 0xC0) {
+      m |= ((uint64_t)1) << (ug & 63);
+    }
+    if (ub >= 0xC0) {
+      m |= ((uint64_t)1) << (ub & 63);
+    }
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
+  return m;
+}
+
+const char*  //
+iconvg_compiled_frame__end_drawing(const iconvg_compiled_frame* self,
+                                   iconvg_canvas* c,
+                                   const iconvg_compiled_paint* paint) {
+  iconvg_paint* p = self->paint;
+  uint32_t which = paint->which_regs;
+  uint64_t live = paint->live_regs;
+  // A flat color that is still its palette color is usually premultiplied
+  // but, for unusual palettes, it can be a blend that reads other registers.
+  if ((paint->paint_type == ICONVG_PAINT_TYPE__FLAT_COLOR) &&
+      ((paint->palette_regs >> (which & 63)) & 1)) {
+    live |= iconvg_private_compiled__blend_regs(iconvg_private_peek_u32le(
+        &p->custom_palette.colors[which & 63].rgba[0]));
   }
-  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+
+  // Only the live registers need setting.
+  for (uint32_t k = 0; live; k++, live >>= 1) {
+    if (!(live & 1)) {
+      continue;
+    }
+    uint32_t i = (which + k) & 63;
+    if ((paint->palette_regs >> i) & 1) {
+      uint32_t u =
+          iconvg_private_peek_u32le(&p->custom_palette.colors[i].rgba[0]);
+      p->regs[i] = ((uint64_t)u) << 32;
+    } else {
+      p->regs[i] = paint->regs[i];
+    }
+  }
+  for (int i = 0; i < 6; i++) {
+    p->transform[i] = paint->transform[i];
+  }
+  p->paint_type = paint->paint_type;
+  p->spread = paint->spread;
+  p->num_stops = paint->num_stops;
+  p->which_regs = paint->which_regs;
+  return (*c->vtable->end_drawing)(c, p);
 }
 
 static const char*  //
-iconvg_private_debug_canvas__end_decode(iconvg_canvas* c,
-                                        const char* err_msg,
-                                        size_t num_bytes_consumed,
-                                        size_t num_bytes_remaining) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    const char* quote = err_msg ? "\"" : "";
-    fprintf(f, "%send_decode(%s%s%s, %zu, %zu)\n",
-            ((const char*)(c->context.const_ptr3)), quote,
-            err_msg ? err_msg : "NULL", quote, num_bytes_consumed,
-            num_bytes_remaining);
+iconvg_private_compiled_icon__decode(const iconvg_compiled_icon* self,
+                                     iconvg_canvas* c,
+                                     iconvg_rectangle_f32 dst_rect,
+                                     const iconvg_decode_options* options) {
+  const iconvg_palette* suggested_palette =
+      self->suggested_palette ? self->suggested_palette
+                              : &iconvg_private_default_palette;
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, self->viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, suggested_palette));
+  if (self->num_variants == 0) {
+    return NULL;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return err_msg;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
+
+  iconvg_paint p;
+  p.viewbox = self->viewbox;
+  p.height_in_pixels = iconvg_private_height_in_pixels(dst_rect, options);
+  memcpy(&p.custom_palette,
+         (options && options->palette) ? options->palette : suggested_palette,
+         sizeof(p.custom_palette));
+  iconvg_private_initialize_remaining_paint_fields(
+      &p, dst_rect, iconvg_private_dst_transform(options));
+
+  iconvg_compiled_frame frame;
+  frame.s2d_scale_x = p.s2d_scale_x;
+  frame.s2d_bias_x = p.s2d_bias_x;
+  frame.s2d_scale_y = p.s2d_scale_y;
+  frame.s2d_bias_y = p.s2d_bias_y;
+  frame.paint = &p;
+  frame.s2d_skew_x = p.s2d_skew_x;
+  frame.s2d_skew_y = p.s2d_skew_y;
+
+  size_t i = self->num_variants - 1;
+  while ((i > 0) &&
+         (self->variants[i].min_height_in_pixels > p.height_in_pixels)) {
+    i--;
+  }
+  return (*self->variants[i].func)(c, &frame);
+}
+
+const char*  //
+iconvg_compiled_icon__decode(const iconvg_compiled_icon* self,
+                             iconvg_canvas* dst_canvas,
+                             iconvg_rectangle_f32 dst_rect,
+                             const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
+      sizeof(iconvg_canvas_vtable)) {
     return iconvg_error_invalid_vtable;
   }
-  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
-                                        num_bytes_remaining);
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_compiled_icon__decode(self, dst_canvas, dst_rect,
+                                                   options);
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg,
+                                           err_msg ? 0 : self->src_len,
+                                           err_msg ? self->src_len : 0);
 }
 
-static const char*  //
-iconvg_private_debug_canvas__begin_drawing(iconvg_canvas* c) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%sbegin_drawing()\n", ((const char*)(c->context.const_ptr3)));
+// ----
+
+// The recording canvas appends to its ops and snapshots, given decoding with
+// the dst_rect set to the ViewBox, so that dst coordinates are src
+// coordinates.
+//
+// Each variant is decoded twice: once with the suggested palette and then,
+// with checking set, with every palette color changed. The second pass only
+// compares registers, to find those that still hold their initial palette
+// colors.
+
+typedef struct iconvg_private_compiled_op_struct {
+  uint32_t verb;
+  uint32_t snapshot_index;
+  float args[6];
+} iconvg_private_compiled_op;
+
+typedef struct iconvg_private_compiled_snapshot_struct {
+  uint64_t regs[64];
+  uint64_t palette_regs;
+  uint64_t live_regs;
+  float transform[6];
+  uint32_t paint_type;
+  uint32_t spread;
+  uint32_t num_stops;
+  uint32_t which_regs;
+} iconvg_private_compiled_snapshot;
+
+typedef struct iconvg_private_compiled_recorder_struct {
+  iconvg_private_compiled_op* ops;
+  size_t num_ops;
+  size_t cap_ops;
+  iconvg_private_compiled_snapshot* snapshots;
+  size_t num_snapshots;
+  size_t cap_snapshots;
+  bool checking;
+  size_t check_index;
+  iconvg_palette suggested_palette;
+  iconvg_allocator* allocator;
+} iconvg_private_compiled_recorder;
+
+// iconvg_private_compiled__grow returns ptr, an array (allocated by a)
+// holding len elements, or a reallocation of it, with room for at least one
+// more. It returns NULL on failure, leaving ptr as is.
+static void*  //
+iconvg_private_compiled__grow(iconvg_allocator* a,
+                              void* ptr,
+                              size_t* cap,
+                              size_t len,
+                              size_t elem_size) {
+  if (len < *cap) {
+    return ptr;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
+  size_t new_cap = *cap ? (2 * *cap) : 256;
+  if ((new_cap <= *cap) || (new_cap > (SIZE_MAX / elem_size))) {
     return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
   }
-  return (*wrapped->vtable->begin_drawing)(wrapped);
+  void* new_ptr = iconvg_private_allocator__realloc(
+      a, ptr, *cap * elem_size, new_cap * elem_size);
+  if (new_ptr) {
+    *cap = new_cap;
+  }
+  return new_ptr;
 }
 
 static const char*  //
-iconvg_private_debug_canvas__end_drawing(iconvg_canvas* c,
-                                         const iconvg_paint* p) {
-  static const char* spread_names[4] = {"none", "pad", "reflect", "repeat"};
+iconvg_private_compiled_recorder__op(iconvg_canvas* c,
+                                     uint32_t verb,
+                                     float a0,
+                                     float a1,
+                                     float a2,
+                                     float a3,
+                                     float a4,
+                                     float a5) {
+  iconvg_private_compiled_recorder* r =
+      (iconvg_private_compiled_recorder*)(c->context.nonconst_ptr1);
+  if (r->checking) {
+    return NULL;
+  }
+  void* ops = iconvg_private_compiled__grow(r->allocator, r->ops, &r->cap_ops,
+                                            r->num_ops,
+                                            sizeof(iconvg_private_compiled_op));
+  if (!ops) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  r->ops = ops;
+  iconvg_private_compiled_op* o = &r->ops[r->num_ops++];
+  memset(o, 0, sizeof(*o));
+  o->verb = verb;
+  o->args[0] = a0;
+  o->args[1] = a1;
+  o->args[2] = a2;
+  o->args[3] = a3;
+  o->args[4] = a4;
+  o->args[5] = a5;
+  return NULL;
+}
 
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    switch (iconvg_paint__type(p)) {
-      case ICONVG_PAINT_TYPE__FLAT_COLOR: {
-        iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
-        fprintf(f, "%send_drawing(flat_color{%02X:%02X:%02X:%02X})\n",
-                ((const char*)(c->context.const_ptr3)), ((int)(k.rgba[0])),
-                ((int)(k.rgba[1])), ((int)(k.rgba[2])), ((int)(k.rgba[3])));
-        break;
-      }
+static const char*  //
+iconvg_private_compiled_recorder__begin_decode(iconvg_canvas* c,
+                                               iconvg_rectangle_f32 dst_rect) {
+  return NULL;
+}
 
-      case ICONVG_PAINT_TYPE__LINEAR_GRADIENT: {
-        fprintf(f,
-                "%send_drawing(linear_gradient{nstops=%d, spread=%s, ...})\n",
-                ((const char*)(c->context.const_ptr3)),
-                ((int)(iconvg_paint__gradient_number_of_stops(p))),
-                spread_names[iconvg_paint__gradient_spread(p)]);
-        break;
-      }
+static const char*  //
+iconvg_private_compiled_recorder__end_decode(iconvg_canvas* c,
+                                             const char* err_msg,
+                                             size_t num_bytes_consumed,
+                                             size_t num_bytes_remaining) {
+  return err_msg;
+}
 
-      case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
-        fprintf(f,
-                "%send_drawing(radial_gradient{nstops=%d, spread=%s, ...})\n",
-                ((const char*)(c->context.const_ptr3)),
-                ((int)(iconvg_paint__gradient_number_of_stops(p))),
-                spread_names[iconvg_paint__gradient_spread(p)]);
-        break;
-      }
+static const char*  //
+iconvg_private_compiled_recorder__begin_drawing(iconvg_canvas* c) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__BEGIN_DRAWING, 0, 0, 0, 0, 0, 0);
+}
 
-      case ICONVG_PAINT_TYPE__INVALID:
-      default: {
-        return iconvg_error_invalid_paint_type;
+static const char*  //
+iconvg_private_compiled_recorder__end_drawing(iconvg_canvas* c,
+                                              const iconvg_paint* p) {
+  iconvg_private_compiled_recorder* r =
+      (iconvg_private_compiled_recorder*)(c->context.nonconst_ptr1);
+  if (r->checking) {
+    if (r->check_index >= r->num_snapshots) {
+      return NULL;
+    }
+    iconvg_private_compiled_snapshot* s = &r->snapshots[r->check_index++];
+    for (int i = 0; i < 64; i++) {
+      if (s->regs[i] != p->regs[i]) {
+        s->regs[i] = 0;
+        s->palette_regs |= ((uint64_t)1) << i;
       }
     }
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
     return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
   }
-  return (*wrapped->vtable->end_drawing)(wrapped, p);
-}
 
-static const char*  //
-iconvg_private_debug_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%sbegin_path(%g, %g)\n", ((const char*)(c->context.const_ptr3)),
-            x0, y0);
+  void* snapshots = iconvg_private_compiled__grow(
+      r->allocator, r->snapshots, &r->cap_snapshots, r->num_snapshots,
+      sizeof(iconvg_private_compiled_snapshot));
+  if (!snapshots) {
+    return iconvg_error_system_failure_out_of_memory;
   }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
+  r->snapshots = snapshots;
+  iconvg_private_compiled_snapshot* s = &r->snapshots[r->num_snapshots];
+  memset(s, 0, sizeof(*s));
+  memcpy(s->regs, p->regs, sizeof(s->regs));
+  if (p->paint_type != ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    memcpy(s->transform, p->transform, sizeof(s->transform));
   }
-  return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+  s->paint_type = p->paint_type;
+  s->spread = p->spread;
+  s->num_stops = p->num_stops;
+  s->which_regs = p->which_regs;
+
+  ICONVG_PRIVATE_TRY(iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__END_DRAWING, 0, 0, 0, 0, 0, 0));
+  r->ops[r->num_ops - 1].snapshot_index = (uint32_t)(r->num_snapshots++);
+  return NULL;
 }
 
 static const char*  //
-iconvg_private_debug_canvas__end_path(iconvg_canvas* c) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%send_path()\n", ((const char*)(c->context.const_ptr3)));
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
-  }
-  return (*wrapped->vtable->end_path)(wrapped);
+iconvg_private_compiled_recorder__begin_path(iconvg_canvas* c,
+                                             float x0,
+                                             float y0) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH, x0, y0, 0, 0, 0, 0);
 }
 
 static const char*  //
-iconvg_private_debug_canvas__path_line_to(iconvg_canvas* c,
-                                          float x1,
-                                          float y1) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%spath_line_to(%g, %g)\n",
-            ((const char*)(c->context.const_ptr3)), x1, y1);
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
-  }
-  return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+iconvg_private_compiled_recorder__end_path(iconvg_canvas* c) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__END_PATH, 0, 0, 0, 0, 0, 0);
 }
 
 static const char*  //
-iconvg_private_debug_canvas__path_quad_to(iconvg_canvas* c,
-                                          float x1,
-                                          float y1,
-                                          float x2,
-                                          float y2) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%spath_quad_to(%g, %g, %g, %g)\n",
-            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2);
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
-  }
-  return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+iconvg_private_compiled_recorder__path_line_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__PATH_LINE_TO, x1, y1, 0, 0, 0, 0);
 }
 
 static const char*  //
-iconvg_private_debug_canvas__path_cube_to(iconvg_canvas* c,
-                                          float x1,
-                                          float y1,
-                                          float x2,
-                                          float y2,
-                                          float x3,
-                                          float y3) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%spath_cube_to(%g, %g, %g, %g, %g, %g)\n",
-            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2, x3, y3);
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
-  }
-  return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+iconvg_private_compiled_recorder__path_quad_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__PATH_QUAD_TO, x1, y1, x2, y2, 0, 0);
 }
 
 static const char*  //
-iconvg_private_debug_canvas__on_metadata_viewbox(iconvg_canvas* c,
-                                                 iconvg_rectangle_f32 viewbox) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    fprintf(f, "%son_metadata_viewbox({%g, %g, %g, %g})\n",
-            ((const char*)(c->context.const_ptr3)), viewbox.min_x,
-            viewbox.min_y, viewbox.max_x, viewbox.max_y);
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
-  }
-  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+iconvg_private_compiled_recorder__path_cube_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2,
+                                               float x3,
+                                               float y3) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__PATH_CUBE_TO, x1, y1, x2, y2, x3, y3);
 }
 
 static const char*  //
-iconvg_private_debug_canvas__on_metadata_suggested_palette(
+iconvg_private_compiled_recorder__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__on_metadata_suggested_palette(
     iconvg_canvas* c,
     const iconvg_palette* suggested_palette) {
-  FILE* f = (FILE*)(c->context.nonconst_ptr2);
-  if (f) {
-    int j = iconvg_private_last_color_that_isnt_opaque_black(suggested_palette);
-    if (j < 0) {
-      fprintf(f, "%son_metadata_suggested_palette(...)\n",
-              ((const char*)(c->context.const_ptr3)));
-    } else {
-      fprintf(f, "%son_metadata_suggested_palette(",
-              ((const char*)(c->context.const_ptr3)));
-      for (int i = 0; i <= j; i++) {
-        fprintf(f, "%02X:%02X:%02X:%02X%s",
-                ((int)(suggested_palette->colors[i].rgba[0])),
-                ((int)(suggested_palette->colors[i].rgba[1])),
-                ((int)(suggested_palette->colors[i].rgba[2])),
-                ((int)(suggested_palette->colors[i].rgba[3])),
-                (i < 63) ? ", " : ")\n");
-      }
-      if (j < 63) {
-        fprintf(f, "...)\n");
-      } else {
-        fprintf(f, ")\n");
-      }
-    }
-  }
-  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
-  if (!wrapped) {
-    return NULL;
-  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
-             sizeof(iconvg_canvas_vtable)) {
-    return iconvg_error_invalid_vtable;
-  }
-  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
-                                                           suggested_palette);
+  iconvg_private_compiled_recorder* r =
+      (iconvg_private_compiled_recorder*)(c->context.nonconst_ptr1);
+  memcpy(&r->suggested_palette, suggested_palette, sizeof(iconvg_palette));
+  return NULL;
 }
 
 static const iconvg_canvas_vtable  //
-    iconvg_private_debug_canvas_vtable = {
+    iconvg_private_compiled_recorder_vtable = {
         sizeof(iconvg_canvas_vtable),
-        &iconvg_private_debug_canvas__begin_decode,
-        &iconvg_private_debug_canvas__end_decode,
-        &iconvg_private_debug_canvas__begin_drawing,
-        &iconvg_private_debug_canvas__end_drawing,
-        &iconvg_private_debug_canvas__begin_path,
-        &iconvg_private_debug_canvas__end_path,
-        &iconvg_private_debug_canvas__path_line_to,
-        &iconvg_private_debug_canvas__path_quad_to,
-        &iconvg_private_debug_canvas__path_cube_to,
-        &iconvg_private_debug_canvas__on_metadata_viewbox,
-        &iconvg_private_debug_canvas__on_metadata_suggested_palette,
+        &iconvg_private_compiled_recorder__begin_decode,
+        &iconvg_private_compiled_recorder__end_decode,
+        &iconvg_private_compiled_recorder__begin_drawing,
+        &iconvg_private_compiled_recorder__end_drawing,
+        &iconvg_private_compiled_recorder__begin_path,
+        &iconvg_private_compiled_recorder__end_path,
+        &iconvg_private_compiled_recorder__path_line_to,
+        &iconvg_private_compiled_recorder__path_quad_to,
+        &iconvg_private_compiled_recorder__path_cube_to,
+        &iconvg_private_compiled_recorder__on_metadata_viewbox,
+        &iconvg_private_compiled_recorder__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
 };
 
-iconvg_canvas  //
-iconvg_canvas__make_debug(FILE* f,
-                          const char* message_prefix,
-                          iconvg_canvas* wrapped) {
-  if (wrapped && !wrapped->vtable) {
-    wrapped = NULL;
+// ----
+
+// iconvg_private_compiled_snapshot__prune sets s's live_regs and zeroes the
+// other registers (and their palette_regs bits), so that snapshots that only
+// differ in registers that their paint can't read are equal.
+static void  //
+iconvg_private_compiled_snapshot__prune(iconvg_private_compiled_snapshot* s) {
+  uint32_t which = s->which_regs & 63;
+  uint64_t live = 0;
+  if (s->paint_type == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    live = 1;
+    if (!((s->palette_regs >> which) & 1)) {
+      live |= iconvg_private_compiled__blend_regs(
+          (uint32_t)(s->regs[which] >> 32));
+    }
+  } else if (s->num_stops < 64) {
+    live = (((uint64_t)1) << s->num_stops) - 1;
+  } else {
+    live = ~((uint64_t)0);
+  }
+  s->live_regs = live;
+
+  for (uint32_t i = 0; i < 64; i++) {
+    uint32_t k = (i - which) & 63;
+    if (!((live >> k) & 1)) {
+      s->regs[i] = 0;
+      s->palette_regs &= ~(((uint64_t)1) << i);
+    }
   }
-  iconvg_canvas c;
-  c.vtable = &iconvg_private_debug_canvas_vtable;
-  memset(&c.context, 0, sizeof(c.context));
-  c.context.nonconst_ptr1 = wrapped;
-  c.context.nonconst_ptr2 = f;
-  c.context.const_ptr3 = message_prefix ? message_prefix : "";
-  return c;
 }
 
-// -------------------------------- #include "./decoder.c"
+// iconvg_private_compiled__variants_are_equal returns whether the ops
+// (including their snapshots) in [i0 .. i0+n) and [i1 .. i1+n) are equal.
+static bool  //
+iconvg_private_compiled__variants_are_equal(
+    const iconvg_private_compiled_recorder* r,
+    size_t i0,
+    size_t i1,
+    size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    const iconvg_private_compiled_op* o0 = &r->ops[i0 + k];
+    const iconvg_private_compiled_op* o1 = &r->ops[i1 + k];
+    if ((o0->verb != o1->verb) ||
+        memcmp(o0->args, o1->args, sizeof(o0->args))) {
+      return false;
+    } else if ((o0->verb == ICONVG_PRIVATE_COMPILED_OP__END_DRAWING) &&
+               memcmp(&r->snapshots[o0->snapshot_index],
+                      &r->snapshots[o1->snapshot_index],
+                      sizeof(iconvg_private_compiled_snapshot))) {
+      return false;
+    }
+  }
+  return true;
+}
 
+// iconvg_private_compiled__write_f32 writes x as a C float literal.
 static void  //
-iconvg_private_decoder__advance_to_ptr(iconvg_private_decoder* self,
-                                       const uint8_t* new_ptr) {
-  if (new_ptr >= self->ptr) {
-    size_t delta = ((size_t)(new_ptr - self->ptr));
-    if (delta <= self->len) {
-      self->ptr += delta;
-      self->len -= delta;
-      return;
-    }
+iconvg_private_compiled__write_f32(FILE* f, float x) {
+  if (isnan(x)) {
+    fputs("NAN", f);
+    return;
+  } else if (isinf(x)) {
+    fputs((x < 0) ? "-INFINITY" : "INFINITY", f);
+    return;
   }
-  self->ptr = NULL;
-  self->len = 0;
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.9g", x);
+  fputs(buf, f);
+  if (!strpbrk(buf, ".e")) {
+    fputs(".0", f);
+  }
+  fputc('f', f);
 }
 
-static iconvg_private_decoder  //
-iconvg_private_decoder__limit_u32(iconvg_private_decoder* self,
-                                  uint32_t limit) {
-  iconvg_private_decoder d;
-  d.ptr = self->ptr;
-  d.len = (limit < self->len) ? limit : self->len;
-  return d;
+static void  //
+iconvg_private_compiled__write_f32s(FILE* f, const float* x, int n) {
+  for (int i = 0; i < n; i++) {
+    fputs(i ? ", " : "{", f);
+    iconvg_private_compiled__write_f32(f, x[i]);
+  }
+  fputc('}', f);
 }
 
+// iconvg_private_compiled__write_xy writes a dst coordinate pair, computed
+// from a src coordinate pair the same way that the decoder does. The skew
+// terms are zero unless iconvg_decode_options.dst_transform rotates or skews.
 static void  //
-iconvg_private_decoder__skip_to_the_end(iconvg_private_decoder* self) {
-  self->ptr += self->len;
-  self->len = 0;
+iconvg_private_compiled__write_xy(FILE* f, const float* xy) {
+  fputs(", (", f);
+  iconvg_private_compiled__write_f32(f, xy[0]);
+  fputs(" * sx) + (", f);
+  iconvg_private_compiled__write_f32(f, xy[1]);
+  fputs(" * kx) + bx, (", f);
+  iconvg_private_compiled__write_f32(f, xy[0]);
+  fputs(" * ky) + (", f);
+  iconvg_private_compiled__write_f32(f, xy[1]);
+  fputs(" * sy) + by", f);
 }
 
-// ----
+static void  //
+iconvg_private_compiled__write_variant(FILE* f,
+                                       const char* name,
+                                       size_t variant_index,
+                                       const iconvg_private_compiled_op* ops,
+                                       size_t num_ops,
+                                       const uint32_t* snapshot_ids) {
+  fprintf(f,
+          "static const char*  //\n"
+          "%s__variant_%zu(iconvg_canvas* c, const iconvg_compiled_frame* "
+          "f) {\n",
+          name, variant_index);
+  if (num_ops == 0) {
+    fprintf(f, "  return NULL;\n}\n\n");
+    return;
+  }
+  fprintf(f, "  const iconvg_canvas_vtable* v = c->vtable;\n");
+  for (size_t i = 0; i < num_ops; i++) {
+    if (ops[i].verb >= ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH) {
+      fprintf(f,
+              "  const double sx = f->s2d_scale_x;\n"
+              "  const double bx = f->s2d_bias_x;\n"
+              "  const double sy = f->s2d_scale_y;\n"
+              "  const double by = f->s2d_bias_y;\n"
+              "  const double kx = f->s2d_skew_x;\n"
+              "  const double ky = f->s2d_skew_y;\n");
+      break;
+    }
+  }
+  fprintf(f, "  const char* err_msg = NULL;\n");
 
-static bool  //
-iconvg_private_decoder__decode_coordinates(iconvg_private_decoder* self,
-                                           float* dst_ptr,
-                                           size_t dst_len) {
-  for (; dst_len > 0; dst_len--) {
-    if (self->len == 0) {
-      return false;
+  for (size_t i = 0; i < num_ops; i++) {
+    const iconvg_private_compiled_op* o = &ops[i];
+    switch (o->verb) {
+      case ICONVG_PRIVATE_COMPILED_OP__BEGIN_DRAWING:
+        fputs("  if ((err_msg = (*v->begin_drawing)(c", f);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__END_DRAWING:
+        fprintf(f,
+                "  if ((err_msg = iconvg_compiled_frame__end_drawing(f, c, "
+                "&%s__paint_%u",
+                name, (unsigned int)(snapshot_ids[o->snapshot_index]));
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH:
+        fputs("  if ((err_msg = (*v->begin_path)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__END_PATH:
+        fputs("  if ((err_msg = (*v->end_path)(c", f);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__PATH_LINE_TO:
+        fputs("  if ((err_msg = (*v->path_line_to)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__PATH_QUAD_TO:
+        fputs("  if ((err_msg = (*v->path_quad_to)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        iconvg_private_compiled__write_xy(f, &o->args[2]);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__PATH_CUBE_TO:
+        fputs("  if ((err_msg = (*v->path_cube_to)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        iconvg_private_compiled__write_xy(f, &o->args[2]);
+        iconvg_private_compiled__write_xy(f, &o->args[4]);
+        break;
     }
-    uint8_t v = self->ptr[0];
-    if ((v & 0x01) != 0) {  // 1-byte encoding.
-      int32_t i = (int32_t)(v >> 1);
-      *dst_ptr++ = ((float)(i - 64));
-      self->ptr += 1;
-      self->len -= 1;
+    fputs("))) {\n    return err_msg;\n  }\n", f);
+  }
+  fprintf(f, "  return NULL;\n}\n\n");
+}
 
-    } else if ((v & 0x02) != 0) {  // 2-byte encoding.
-      if (self->len < 2) {
-        return false;
-      }
-      int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
-      *dst_ptr++ = ((float)(i - (128 * 64))) / 64.0f;
-      self->ptr += 2;
-      self->len -= 2;
+// iconvg_private_compiled__write_fallback writes a function_name that calls
+// iconvg_decode on an embedded copy of src_ptr[.. src_len].
+static void  //
+iconvg_private_compiled__write_fallback(FILE* f,
+                                        const char* name,
+                                        const uint8_t* src_ptr,
+                                        size_t src_len) {
+  fprintf(f,
+          "// %s has too many Level of Detail thresholds to compile, so it\n"
+          "// decodes the IconVG file instead.\n"
+          "static const uint8_t %s__src[%zu] = {",
+          name, name, src_len);
+  for (size_t i = 0; i < src_len; i++) {
+    fprintf(f, "%s0x%02X,", ((i % 12) == 0) ? "\n    " : " ", src_ptr[i]);
+  }
+  size_t indent = strlen(name) + 1;
+  fprintf(f,
+          "\n};\n\n"
+          "const char*  //\n"
+          "%s(iconvg_canvas* dst_canvas,\n"
+          "%*siconvg_rectangle_f32 dst_rect,\n"
+          "%*sconst iconvg_decode_options* options) {\n"
+          "  return iconvg_decode(dst_canvas, dst_rect, %s__src, "
+          "sizeof(%s__src),\n"
+          "                       options);\n"
+          "}\n",
+          name, (int)indent, "", (int)indent, "", name, name);
+}
 
-    } else {  // 4-byte encoding.
-      if (self->len < 4) {
-        return false;
+static void  //
+iconvg_private_compiled__write(FILE* f,
+                               const char* name,
+                               size_t src_len,
+                               iconvg_rectangle_f32 viewbox,
+                               const iconvg_private_compiled_recorder* r,
+                               const int64_t* min_heights,
+                               const size_t* op_starts,
+                               size_t num_variants,
+                               uint32_t* snapshot_ids,
+                               uint32_t* regs_ids) {
+  // Number the distinct snapshots and, separately, their distinct registers.
+  // Registers that hold palette colors are zero, so they don't differ.
+  uint32_t num_paints = 0;
+  uint32_t num_regs = 0;
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    snapshot_ids[i] = num_paints;
+    for (size_t j = 0; j < i; j++) {
+      if (!memcmp(&r->snapshots[i], &r->snapshots[j],
+                  sizeof(iconvg_private_compiled_snapshot))) {
+        snapshot_ids[i] = snapshot_ids[j];
+        break;
       }
-      float f = iconvg_private_reinterpret_from_u32_to_f32(
-          iconvg_private_peek_u32le(self->ptr));
-      if (f != f) {  // Reject NaN.
-        return false;
+    }
+    if (snapshot_ids[i] == num_paints) {
+      num_paints++;
+    }
+  }
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    regs_ids[i] = num_regs;
+    for (size_t j = 0; j < i; j++) {
+      if (!memcmp(r->snapshots[i].regs, r->snapshots[j].regs,
+                  sizeof(r->snapshots[i].regs))) {
+        regs_ids[i] = regs_ids[j];
+        break;
       }
-      *dst_ptr++ = f;
-      self->ptr += 4;
-      self->len -= 4;
+    }
+    if (regs_ids[i] == num_regs) {
+      num_regs++;
     }
   }
-  return true;
-}
 
-static bool  //
-iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
-                                              uint32_t* dst) {
-  if (self->len == 0) {
-    return false;
+  bool has_palette = memcmp(&r->suggested_palette,
+                            &iconvg_private_default_palette,
+                            sizeof(iconvg_palette)) != 0;
+  if (has_palette) {
+    fprintf(f, "static const iconvg_palette %s__suggested_palette = {{",
+            name);
+    for (int i = 0; i < 64; i++) {
+      const uint8_t* k = &r->suggested_palette.colors[i].rgba[0];
+      fprintf(f, "\n    {{0x%02X, 0x%02X, 0x%02X, 0x%02X}},", k[0], k[1], k[2],
+              k[3]);
+    }
+    fprintf(f, "\n}};\n\n");
   }
-  uint8_t v = self->ptr[0];
-  if ((v & 0x01) != 0) {  // 1-byte encoding.
-    *dst = v >> 1;
-    self->ptr += 1;
-    self->len -= 1;
 
-  } else if ((v & 0x02) != 0) {  // 2-byte encoding.
-    if (self->len < 2) {
-      return false;
+  uint32_t next = 0;
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    if (regs_ids[i] != next) {
+      continue;
     }
-    *dst = iconvg_private_peek_u16le(self->ptr) >> 2;
-    self->ptr += 2;
-    self->len -= 2;
+    next++;
+    fprintf(f, "static const uint64_t %s__regs_%u[64] = {", name,
+            (unsigned int)(regs_ids[i]));
+    for (int j = 0; j < 64; j++) {
+      fprintf(f, "%s0x%016llX,", ((j % 3) == 0) ? "\n    " : " ",
+              (unsigned long long)(r->snapshots[i].regs[j]));
+    }
+    fprintf(f, "\n};\n\n");
+  }
 
-  } else {  // 4-byte encoding.
-    if (self->len < 4) {
-      return false;
+  next = 0;
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    if (snapshot_ids[i] != next) {
+      continue;
     }
-    *dst = iconvg_private_peek_u32le(self->ptr) >> 2;
-    self->ptr += 4;
-    self->len -= 4;
+    next++;
+    const iconvg_private_compiled_snapshot* s = &r->snapshots[i];
+    fprintf(f,
+            "static const iconvg_compiled_paint %s__paint_%u = {\n"
+            "    %s__regs_%u,\n"
+            "    0x%016llX,\n"
+            "    0x%016llX,\n"
+            "    ",
+            name, (unsigned int)(snapshot_ids[i]), name,
+            (unsigned int)(regs_ids[i]), (unsigned long long)(s->palette_regs),
+            (unsigned long long)(s->live_regs));
+    iconvg_private_compiled__write_f32s(f, s->transform, 6);
+    fprintf(f,
+            ",\n"
+            "    %u,\n"
+            "    %u,\n"
+            "    %u,\n"
+            "    %u,\n"
+            "};\n\n",
+            (unsigned int)(s->paint_type), (unsigned int)(s->spread),
+            (unsigned int)(s->num_stops), (unsigned int)(s->which_regs));
   }
-  return true;
-}
 
-static bool  //
-iconvg_private_decoder__decode_float32(iconvg_private_decoder* self,
-                                       float* dst) {
-  if (self->len < 4) {
-    return false;
+  for (size_t i = 0; i < num_variants; i++) {
+    iconvg_private_compiled__write_variant(f, name, i, r->ops + op_starts[i],
+                                           op_starts[i + 1] - op_starts[i],
+                                           snapshot_ids);
   }
-  float f = iconvg_private_reinterpret_from_u32_to_f32(
-      iconvg_private_peek_u32le(self->ptr));
-  if (f != f) {  // Reject NaN.
-    return false;
+
+  fprintf(f, "static const iconvg_compiled_variant %s__variants[%zu] = {\n",
+          name, num_variants);
+  for (size_t i = 0; i < num_variants; i++) {
+    if (min_heights[i] == INT64_MIN) {
+      fprintf(f, "    {INT64_MIN, &%s__variant_%zu},\n", name, i);
+    } else {
+      fprintf(f, "    {%lld, &%s__variant_%zu},\n",
+              (long long)(min_heights[i]), name, i);
+    }
   }
-  *dst = f;
-  self->ptr += 4;
-  self->len -= 4;
-  return true;
+  fprintf(f, "};\n\nstatic const iconvg_compiled_icon %s__icon = {\n    ",
+          name);
+  float v[4] = {viewbox.min_x, viewbox.min_y, viewbox.max_x, viewbox.max_y};
+  iconvg_private_compiled__write_f32s(f, v, 4);
+  if (has_palette) {
+    fprintf(f, ",\n    &%s__suggested_palette", name);
+  } else {
+    fprintf(f, ",\n    NULL");
+  }
+  size_t indent = strlen(name) + 1;
+  fprintf(f,
+          ",\n"
+          "    %zu,\n"
+          "    %zu,\n"
+          "    %s__variants,\n"
+          "};\n\n"
+          "const char*  //\n"
+          "%s(iconvg_canvas* dst_canvas,\n"
+          "%*siconvg_rectangle_f32 dst_rect,\n"
+          "%*sconst iconvg_decode_options* options) {\n"
+          "  return iconvg_compiled_icon__decode(&%s__icon, dst_canvas, "
+          "dst_rect,\n"
+          "                                      options);\n"
+          "}\n",
+          src_len, num_variants, name, name, (int)indent, "", (int)indent, "",
+          name);
 }
 
-// ----
-
-static bool  //
-iconvg_private_decoder__decode_magic_identifier(iconvg_private_decoder* self) {
-  if ((self->len < 4) ||         //
-      (self->ptr[0] != 0x8A) ||  //
-      (self->ptr[1] != 0x49) ||  //
-      (self->ptr[2] != 0x56) ||  //
-      (self->ptr[3] != 0x47)) {
-    return false;
+const char*  //
+iconvg_write_c_source(FILE* f,
+                      const char* function_name,
+                      const uint8_t* src_ptr,
+                      size_t src_len,
+                      iconvg_allocator* allocator) {
+  if (!f || !function_name || !*function_name) {
+    return iconvg_error_invalid_constructor_argument;
   }
-  self->ptr += 4;
-  self->len -= 4;
-  return true;
-}
+  iconvg_validate_report report = {0};
+  iconvg_private_lod_thresholds lods;
+  lods.num_values = 0;
+  lods.overflowed = false;
+  ICONVG_PRIVATE_TRY(
+      iconvg_private_validate(&report, src_ptr, src_len, &lods));
+  if (lods.overflowed) {
+    iconvg_private_compiled__write_fallback(f, function_name, src_ptr,
+                                            src_len);
+    return NULL;
+  }
+  iconvg_rectangle_f32 viewbox;
+  ICONVG_PRIVATE_TRY(iconvg_decode_viewbox(&viewbox, src_ptr, src_len));
+
+  int64_t breakpoints[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t num_breakpoints =
+      iconvg_private_lod_thresholds__breakpoints(&lods, breakpoints);
+
+  iconvg_private_compiled_recorder r;
+  memset(&r, 0, sizeof(r));
+  r.allocator = allocator;
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_compiled_recorder_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = &r;
+
+  // Decode once per variant, dropping variants that are identical to their
+  // predecessor.
+  int64_t min_heights[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t op_starts[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS + 1];
+  size_t snapshot_starts[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS + 1];
+  size_t num_variants = 0;
+  op_starts[0] = 0;
+  snapshot_starts[0] = 0;
+  const char* err_msg = NULL;
+  for (size_t i = 0; i < num_breakpoints; i++) {
+    iconvg_decode_options opts = {0};
+    opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+    opts.height_in_pixels.has_value = true;
+    opts.height_in_pixels.value = breakpoints[i];
+
+    r.checking = false;
+    err_msg = iconvg_decode(&c, viewbox, src_ptr, src_len, &opts);
+    if (err_msg) {
+      break;
+    }
+
+    iconvg_palette changed_palette = r.suggested_palette;
+    for (int j = 0; j < 64; j++) {
+      changed_palette.colors[j].rgba[0] ^= 0x01;
+    }
+    opts.palette = &changed_palette;
+    r.checking = true;
+    r.check_index = snapshot_starts[num_variants];
+    err_msg = iconvg_decode(&c, viewbox, src_ptr, src_len, &opts);
+    if (err_msg) {
+      break;
+    }
+    for (size_t j = snapshot_starts[num_variants]; j < r.num_snapshots; j++) {
+      iconvg_private_compiled_snapshot__prune(&r.snapshots[j]);
+    }
+
+    size_t n = r.num_ops - op_starts[num_variants];
+    if ((num_variants > 0) &&
+        ((op_starts[num_variants] - op_starts[num_variants - 1]) == n) &&
+        iconvg_private_compiled__variants_are_equal(
+            &r, op_starts[num_variants - 1], op_starts[num_variants], n)) {
+      r.num_ops = op_starts[num_variants];
+      r.num_snapshots = snapshot_starts[num_variants];
+      continue;
+    }
+    min_heights[num_variants] = breakpoints[i];
+    num_variants++;
+    op_starts[num_variants] = r.num_ops;
+    snapshot_starts[num_variants] = r.num_snapshots;
+  }
+
+  const size_t ids_size = 2 * r.num_snapshots * sizeof(uint32_t);
+  uint32_t* ids = NULL;
+  if (!err_msg && (r.num_snapshots > 0)) {
+    ids = iconvg_private_allocator__alloc(allocator, ids_size);
+    if (!ids) {
+      err_msg = iconvg_error_system_failure_out_of_memory;
+    }
+  }
+  if (!err_msg) {
+    iconvg_private_compiled__write(f, function_name, src_len, viewbox, &r,
+                                   min_heights, op_starts, num_variants, ids,
+                                   ids + r.num_snapshots);
+  }
+  iconvg_private_allocator__free(allocator, ids, ids_size);
+  iconvg_private_allocator__free(
+      allocator, r.ops, r.cap_ops * sizeof(iconvg_private_compiled_op));
+  iconvg_private_allocator__free(
+      allocator, r.snapshots,
+      r.cap_snapshots * sizeof(iconvg_private_compiled_snapshot));
+  return err_msg;
+}
+
+// -------------------------------- #include "./debug.c"
+
+static const char*  //
+iconvg_private_debug_canvas__begin_decode(iconvg_canvas* c,
+                                          iconvg_rectangle_f32 dst_rect) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%sbegin_decode({%g, %g, %g, %g})\n",
+            ((const char*)(c->context.const_ptr3)), dst_rect.min_x,
+            dst_rect.min_y, dst_rect.max_x, dst_rect.max_y);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__end_decode(iconvg_canvas* c,
+                                        const char* err_msg,
+                                        size_t num_bytes_consumed,
+                                        size_t num_bytes_remaining) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    const char* quote = err_msg ? "\"" : "";
+    fprintf(f, "%send_decode(%s%s%s, %zu, %zu)\n",
+            ((const char*)(c->context.const_ptr3)), quote,
+            err_msg ? err_msg : "NULL", quote, num_bytes_consumed,
+            num_bytes_remaining);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return err_msg;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__begin_drawing(iconvg_canvas* c) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%sbegin_drawing()\n", ((const char*)(c->context.const_ptr3)));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__end_drawing(iconvg_canvas* c,
+                                         const iconvg_paint* p) {
+  static const char* spread_names[4] = {"none", "pad", "reflect", "repeat"};
+
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    switch (iconvg_paint__type(p)) {
+      case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+        iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+        fprintf(f, "%send_drawing(flat_color{%02X:%02X:%02X:%02X})\n",
+                ((const char*)(c->context.const_ptr3)), ((int)(k.rgba[0])),
+                ((int)(k.rgba[1])), ((int)(k.rgba[2])), ((int)(k.rgba[3])));
+        break;
+      }
+
+      case ICONVG_PAINT_TYPE__LINEAR_GRADIENT: {
+        fprintf(f,
+                "%send_drawing(linear_gradient{nstops=%d, spread=%s, ...})\n",
+                ((const char*)(c->context.const_ptr3)),
+                ((int)(iconvg_paint__gradient_number_of_stops(p))),
+                spread_names[iconvg_paint__gradient_spread(p)]);
+        break;
+      }
+
+      case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
+        fprintf(f,
+                "%send_drawing(radial_gradient{nstops=%d, spread=%s, ...})\n",
+                ((const char*)(c->context.const_ptr3)),
+                ((int)(iconvg_paint__gradient_number_of_stops(p))),
+                spread_names[iconvg_paint__gradient_spread(p)]);
+        break;
+      }
+
+      case ICONVG_PAINT_TYPE__INVALID:
+      default: {
+        return iconvg_error_invalid_paint_type;
+      }
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_drawing)(wrapped, p);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%sbegin_path(%g, %g)\n", ((const char*)(c->context.const_ptr3)),
+            x0, y0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__end_path(iconvg_canvas* c) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%send_path()\n", ((const char*)(c->context.const_ptr3)));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_path)(wrapped);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__path_line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%spath_line_to(%g, %g)\n",
+            ((const char*)(c->context.const_ptr3)), x1, y1);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__path_quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%spath_quad_to(%g, %g, %g, %g)\n",
+            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__path_cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%spath_cube_to(%g, %g, %g, %g, %g, %g)\n",
+            ((const char*)(c->context.const_ptr3)), x1, y1, x2, y2, x3, y3);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                 iconvg_rectangle_f32 viewbox) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    fprintf(f, "%son_metadata_viewbox({%g, %g, %g, %g})\n",
+            ((const char*)(c->context.const_ptr3)), viewbox.min_x,
+            viewbox.min_y, viewbox.max_x, viewbox.max_y);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+}
+
+static const char*  //
+iconvg_private_debug_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  FILE* f = (FILE*)(c->context.nonconst_ptr2);
+  if (f) {
+    int j = iconvg_private_last_color_that_isnt_opaque_black(suggested_palette);
+    if (j < 0) {
+      fprintf(f, "%son_metadata_suggested_palette(...)\n",
+              ((const char*)(c->context.const_ptr3)));
+    } else {
+      fprintf(f, "%son_metadata_suggested_palette(",
+              ((const char*)(c->context.const_ptr3)));
+      for (int i = 0; i <= j; i++) {
+        fprintf(f, "%02X:%02X:%02X:%02X%s",
+                ((int)(suggested_palette->colors[i].rgba[0])),
+                ((int)(suggested_palette->colors[i].rgba[1])),
+                ((int)(suggested_palette->colors[i].rgba[2])),
+                ((int)(suggested_palette->colors[i].rgba[3])),
+                (i < 63) ? ", " : ")\n");
+      }
+      if (j < 63) {
+        fprintf(f, "...)\n");
+      } else {
+        fprintf(f, ")\n");
+      }
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_debug_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_debug_canvas__begin_decode,
+        &iconvg_private_debug_canvas__end_decode,
+        &iconvg_private_debug_canvas__begin_drawing,
+        &iconvg_private_debug_canvas__end_drawing,
+        &iconvg_private_debug_canvas__begin_path,
+        &iconvg_private_debug_canvas__end_path,
+        &iconvg_private_debug_canvas__path_line_to,
+        &iconvg_private_debug_canvas__path_quad_to,
+        &iconvg_private_debug_canvas__path_cube_to,
+        &iconvg_private_debug_canvas__on_metadata_viewbox,
+        &iconvg_private_debug_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_debug(FILE* f,
+                          const char* message_prefix,
+                          iconvg_canvas* wrapped) {
+  if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_debug_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = f;
+  c.context.const_ptr3 = message_prefix ? message_prefix : "";
+  return c;
+}
+
+// -------------------------------- #include "./decoder.c"
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/uio.h>
+#else
+// struct iovec is as specified by POSIX, for platforms without <sys/uio.h>.
+struct iovec {
+  void* iov_base;
+  size_t iov_len;
+};
+#endif
+
+// ICONVG_PRIVATE_OBSERVE_OP calls the ICONVG_CONFIG__OP_OBSERVER hook, if
+// configured, with a pointer to the op about to be executed. See the
+// iconvg_decode documentation in aaa_public.h.
+#if defined(ICONVG_CONFIG__OP_OBSERVER)
+#define ICONVG_PRIVATE_OBSERVE_OP(op_ptr) ICONVG_CONFIG__OP_OBSERVER(op_ptr)
+#else
+#define ICONVG_PRIVATE_OBSERVE_OP(op_ptr)
+#endif
+
+static void  //
+iconvg_private_decoder__advance_to_ptr(iconvg_private_decoder* self,
+                                       const uint8_t* new_ptr) {
+  if (new_ptr >= self->ptr) {
+    size_t delta = ((size_t)(new_ptr - self->ptr));
+    if (delta <= self->len) {
+      self->ptr += delta;
+      self->len -= delta;
+      return;
+    }
+  }
+  self->ptr = NULL;
+  self->len = 0;
+}
+
+static iconvg_private_decoder  //
+iconvg_private_decoder__limit_u32(iconvg_private_decoder* self,
+                                  uint32_t limit) {
+  iconvg_private_decoder d;
+  d.ptr = self->ptr;
+  d.len = (limit < self->len) ? limit : self->len;
+  d.iov = NULL;
+  return d;
+}
+
+// ----
+
+// ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE bounds how many bytes
+// iconvg_private_decoder__refill can make contiguous. It is more than the
+// longest valid metadata chunk (a Suggested Palette), which is the longest
+// thing that the decoder reads in one piece.
+#define ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE 512
+
+// iconvg_private_decoder_iov is the input after a decoder's ptr[.. len]: the
+// iov fragments, starting offset bytes into iov[0]. remaining counts those
+// bytes (and so ends the iov array). stitch holds copies of the bytes either
+// side of a fragment boundary, for reading something that straddles it.
+typedef struct iconvg_private_decoder_iov_struct {
+  const struct iovec* iov;
+  size_t offset;
+  size_t remaining;
+  uint8_t stitch[ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE];
+} iconvg_private_decoder_iov;
+
+// iconvg_private_decoder__refill is the slow path for when self->len < n. It
+// returns whether it could make ptr[.. len] at least n bytes long, without
+// consuming anything. If self->len is zero, it moves on to the next fragment
+// without copying. Otherwise, it copies the last few bytes of this fragment
+// and the first few of the next into the stitch buffer.
+static bool  //
+iconvg_private_decoder__refill(iconvg_private_decoder* self, size_t n) {
+  iconvg_private_decoder_iov* v = self->iov;
+  if (!v || ((n - self->len) > v->remaining)) {
+    return false;
+  }
+
+  if (self->len == 0) {
+    while (v->offset >= v->iov[0].iov_len) {
+      v->offset = 0;
+      v->iov++;
+    }
+    size_t available = v->iov[0].iov_len - v->offset;
+    if (available >= n) {
+      self->ptr = ((const uint8_t*)(v->iov[0].iov_base)) + v->offset;
+      self->len = available;
+      v->offset = 0;
+      v->iov++;
+      v->remaining -= available;
+      return true;
+    }
+  }
+
+  if (n > ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE) {
+    return false;
+  }
+  if (self->len > 0) {
+    memmove(v->stitch, self->ptr, self->len);
+  }
+  while (self->len < n) {
+    while (v->offset >= v->iov[0].iov_len) {
+      v->offset = 0;
+      v->iov++;
+    }
+    size_t m = v->iov[0].iov_len - v->offset;
+    if (m > (n - self->len)) {
+      m = n - self->len;
+    }
+    memcpy(v->stitch + self->len,
+           ((const uint8_t*)(v->iov[0].iov_base)) + v->offset, m);
+    self->len += m;
+    v->offset += m;
+    v->remaining -= m;
+  }
+  self->ptr = v->stitch;
+  return true;
+}
+
+// iconvg_private_decoder__ensure returns whether ptr[.. len] is (or, after
+// refilling, has become) at least n bytes long.
+static inline bool  //
+iconvg_private_decoder__ensure(iconvg_private_decoder* self, size_t n) {
+  return (self->len >= n) || iconvg_private_decoder__refill(self, n);
+}
+
+// iconvg_private_decoder__skip consumes n bytes, which need not be contiguous.
+// It returns false, having consumed nothing, if there are fewer than n bytes
+// left.
+static bool  //
+iconvg_private_decoder__skip(iconvg_private_decoder* self, size_t n) {
+  if (self->len < n) {
+    // Check the total up front, so that failing leaves the position alone
+    // (for end_decode to report) instead of at the end of the input.
+    if (!self->iov || ((n - self->len) > self->iov->remaining)) {
+      return false;
+    }
+  }
+  while (self->len < n) {
+    n -= self->len;
+    self->ptr += self->len;
+    self->len = 0;
+    if (!iconvg_private_decoder__refill(self, 1)) {
+      return false;
+    }
+  }
+  self->ptr += n;
+  self->len -= n;
+  return true;
+}
+
+static void  //
+iconvg_private_decoder__skip_to_the_end(iconvg_private_decoder* self) {
+  self->ptr += self->len;
+  self->len = 0;
+}
+
+// ----
+
+static bool  //
+iconvg_private_decoder__decode_coordinates(iconvg_private_decoder* self,
+                                           float* dst_ptr,
+                                           size_t dst_len) {
+  for (; dst_len > 0; dst_len--) {
+    if (!iconvg_private_decoder__ensure(self, 1)) {
+      return false;
+    }
+    uint8_t v = self->ptr[0];
+    if ((v & 0x01) != 0) {  // 1-byte encoding.
+      int32_t i = (int32_t)(v >> 1);
+      *dst_ptr++ = ((float)(i - 64));
+      self->ptr += 1;
+      self->len -= 1;
+
+    } else if ((v & 0x02) != 0) {  // 2-byte encoding.
+      if (!iconvg_private_decoder__ensure(self, 2)) {
+        return false;
+      }
+      int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
+      *dst_ptr++ = ((float)(i - (128 * 64))) / 64.0f;
+      self->ptr += 2;
+      self->len -= 2;
+
+    } else {  // 4-byte encoding.
+      if (!iconvg_private_decoder__ensure(self, 4)) {
+        return false;
+      }
+      float f = iconvg_private_reinterpret_from_u32_to_f32(
+          iconvg_private_peek_u32le(self->ptr));
+      if (f != f) {  // Reject NaN.
+        return false;
+      }
+      *dst_ptr++ = f;
+      self->ptr += 4;
+      self->len -= 4;
+    }
+  }
+  return true;
+}
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+
+// iconvg_private_fixed_from_f64 returns round(f * one), clamped to ±max.
+static int64_t  //
+iconvg_private_fixed_from_f64(double f, double one, int64_t max) {
+  f *= one;
+  if (f >= (double)max) {
+    return +max;
+  } else if (f <= -(double)max) {
+    return -max;
+  }
+  return (int64_t)((f < 0) ? (f - 0.5) : (f + 0.5));
+}
+
+#endif  // defined(ICONVG_CONFIG__FIXED_POINT)
+
+// iconvg_private_decoder__decode_path_coordinate is like
+// iconvg_private_decoder__decode_coordinates (with a dst_len of 1) but, with
+// ICONVG_CONFIG__FIXED_POINT, it produces 24.8 fixed point numbers. Only the
+// 4-byte encoding then involves floating point.
+static bool  //
+iconvg_private_decoder__decode_path_coordinate(iconvg_private_decoder* self,
+                                               iconvg_private_coord* dst) {
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  if (!iconvg_private_decoder__ensure(self, 1)) {
+    return false;
+  }
+  uint8_t v = self->ptr[0];
+  if ((v & 0x01) != 0) {  // 1-byte encoding.
+    int32_t i = (int32_t)(v >> 1);
+    *dst = (i - 64) * 256;
+    self->ptr += 1;
+    self->len -= 1;
+
+  } else if ((v & 0x02) != 0) {  // 2-byte encoding.
+    if (!iconvg_private_decoder__ensure(self, 2)) {
+      return false;
+    }
+    int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
+    *dst = (i - (128 * 64)) * 4;
+    self->ptr += 2;
+    self->len -= 2;
+
+  } else {  // 4-byte encoding.
+    if (!iconvg_private_decoder__ensure(self, 4)) {
+      return false;
+    }
+    float f = iconvg_private_reinterpret_from_u32_to_f32(
+        iconvg_private_peek_u32le(self->ptr));
+    if (f != f) {  // Reject NaN.
+      return false;
+    }
+    *dst = (int32_t)iconvg_private_fixed_from_f64(f, 256, INT32_MAX);
+    self->ptr += 4;
+    self->len -= 4;
+  }
+  return true;
+#else
+  return iconvg_private_decoder__decode_coordinates(self, dst, 1);
+#endif
+}
+
+// iconvg_private_decoder__decode_path_coordinate_run decodes up to dst_len
+// coordinates, returning how many it decoded before hitting the end of the
+// input or an invalid (NaN) coordinate.
+//
+// Path ops with repeat counts often encode dozens of coordinates in a row,
+// nearly all of them in the 1- or 2-byte encodings. While at least two
+// contiguous bytes remain, the inner loop decodes those without the
+// per-coordinate iconvg_private_decoder__ensure calls, keeping ptr in a
+// register. It still branches on each coordinate's tag bits: a coordinate's
+// length depends on its first byte, so a branch-free loop would make every
+// load wait for the previous one, whereas a predicted branch lets the CPU run
+// ahead. 4-byte encodings, and coordinates straddling an iconvg_decode_iov
+// fragment boundary, fall back to the one-at-a-time path.
+static size_t  //
+iconvg_private_decoder__decode_path_coordinate_run(
+    iconvg_private_decoder* self,
+    iconvg_private_coord* dst_ptr,
+    size_t dst_len) {
+  size_t n = 0;
+  while (n < dst_len) {
+    const uint8_t* ptr = self->ptr;
+    const uint8_t* end = ptr + self->len;
+    for (; (n < dst_len) && ((end - ptr) >= 2); n++) {
+      uint8_t v = ptr[0];
+      if ((v & 0x01) != 0) {  // 1-byte encoding.
+        int32_t i = (int32_t)(v >> 1);
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+        dst_ptr[n] = (i - 64) * 256;
+#else
+        dst_ptr[n] = ((float)(i - 64));
+#endif
+        ptr += 1;
+      } else if ((v & 0x02) != 0) {  // 2-byte encoding.
+        int32_t i = (int32_t)(iconvg_private_peek_u16le(ptr) >> 2);
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+        dst_ptr[n] = (i - (128 * 64)) * 4;
+#else
+        dst_ptr[n] = ((float)(i - (128 * 64))) / 64.0f;
+#endif
+        ptr += 2;
+      } else {  // 4-byte encoding.
+        break;
+      }
+    }
+    self->len -= (size_t)(ptr - self->ptr);
+    self->ptr = ptr;
+
+    if (n >= dst_len) {
+      break;
+    } else if (!iconvg_private_decoder__decode_path_coordinate(self,
+                                                               dst_ptr + n)) {
+      return n;
+    }
+    n++;
+  }
+  return n;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_path_coordinates(iconvg_private_decoder* self,
+                                                iconvg_private_coord* dst_ptr,
+                                                size_t dst_len) {
+  return iconvg_private_decoder__decode_path_coordinate_run(self, dst_ptr,
+                                                            dst_len) ==
+         dst_len;
+}
+
+static bool  //
+iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
+                                              uint32_t* dst) {
+  if (!iconvg_private_decoder__ensure(self, 1)) {
+    return false;
+  }
+  uint8_t v = self->ptr[0];
+  if ((v & 0x01) != 0) {  // 1-byte encoding.
+    *dst = v >> 1;
+    self->ptr += 1;
+    self->len -= 1;
+
+  } else if ((v & 0x02) != 0) {  // 2-byte encoding.
+    if (!iconvg_private_decoder__ensure(self, 2)) {
+      return false;
+    }
+    *dst = iconvg_private_peek_u16le(self->ptr) >> 2;
+    self->ptr += 2;
+    self->len -= 2;
+
+  } else {  // 4-byte encoding.
+    if (!iconvg_private_decoder__ensure(self, 4)) {
+      return false;
+    }
+    *dst = iconvg_private_peek_u32le(self->ptr) >> 2;
+    self->ptr += 4;
+    self->len -= 4;
+  }
+  return true;
+}
+
+static bool  //
+iconvg_private_decoder__decode_float32(iconvg_private_decoder* self,
+                                       float* dst) {
+  if (!iconvg_private_decoder__ensure(self, 4)) {
+    return false;
+  }
+  float f = iconvg_private_reinterpret_from_u32_to_f32(
+      iconvg_private_peek_u32le(self->ptr));
+  if (f != f) {  // Reject NaN.
+    return false;
+  }
+  *dst = f;
+  self->ptr += 4;
+  self->len -= 4;
+  return true;
+}
+
+// ----
+
+static bool  //
+iconvg_private_decoder__decode_magic_identifier(iconvg_private_decoder* self) {
+  if (!iconvg_private_decoder__ensure(self, 4) ||  //
+      (self->ptr[0] != 0x8A) ||                   //
+      (self->ptr[1] != 0x49) ||                   //
+      (self->ptr[2] != 0x56) ||                   //
+      (self->ptr[3] != 0x47)) {
+    return false;
+  }
+  self->ptr += 4;
+  self->len -= 4;
+  return true;
+}
+
+static bool  //
+iconvg_private_decoder__decode_metadata_viewbox(iconvg_private_decoder* self,
+                                                iconvg_rectangle_f32* dst) {
+  float a[2][2];
+  if (iconvg_private_decoder__decode_coordinates(self, a[0], 4) &&
+      (-INFINITY < a[0][0]) &&  //
+      (a[0][0] <= a[1][0]) &&   //
+      (a[1][0] < +INFINITY) &&  //
+      (-INFINITY < a[0][1]) &&  //
+      (a[0][1] <= a[1][1]) &&   //
+      (a[1][1] < +INFINITY)) {
+    dst->min_x = a[0][0];
+    dst->min_y = a[0][1];
+    dst->max_x = a[1][0];
+    dst->max_y = a[1][1];
+    return true;
+  }
+  return false;
+}
+
+static bool  //
+iconvg_private_decoder__decode_metadata_suggested_palette(
+    iconvg_private_decoder* self,
+    iconvg_palette* dst) {
+  if ((self->len == 0) || (self->ptr[0] >= 0x40)) {
+    return false;
+  }
+  size_t n = 1 + self->ptr[0];
+  self->ptr += 1;
+  self->len -= 1;
+
+  if (self->len != (n * 4)) {
+    return false;
+  }
+  const uint8_t* ptr = self->ptr;
+  self->ptr += self->len;
+  self->len = 0;
+
+  iconvg_premul_color* c = &dst->colors[0];
+  for (; n > 0; n--) {
+    c->rgba[0] = *ptr++;
+    c->rgba[1] = *ptr++;
+    c->rgba[2] = *ptr++;
+    c->rgba[3] = *ptr++;
+    c++;
+  }
+  return true;
+}
+
+// ----
+
+// The iconvg_private_canvas__etc functions transform from src (viewbox) to dst
+// coordinates and call the canvas' corresponding method. With
+// ICONVG_CONFIG__FIXED_POINT, they prefer the etc__fixed methods.
+//
+// iconvg_private_canvas__path_run does the same for up to
+// ICONVG_PRIVATE_PATH_RUN__MAX_REPS repetitions of a LineTo, QuadTo or CubeTo
+// op (with num_points being 1, 2 or 3), transforming all of their points in
+// one pass before calling the canvas once per repetition.
+
+#define ICONVG_PRIVATE_PATH_RUN__MAX_REPS 16
+#define ICONVG_PRIVATE_PATH_RUN__MAX_COORDS \
+  (ICONVG_PRIVATE_PATH_RUN__MAX_REPS * 3 * 2)
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+
+static inline iconvg_fixed_24_8  //
+iconvg_private_fixed_s2d(int64_t u,
+                         int64_t v,
+                         int64_t u_scale,
+                         int64_t v_scale,
+                         int64_t bias) {
+  // u and v are 24.8 (and less than 1<<34 in magnitude, even for Ellipse
+  // control points) and the scales are 16.16 (and at most 1<<28), so the sum
+  // of products is 40.24 and doesn't overflow. This assumes that >> of a
+  // negative number is an arithmetic shift, as it is for all of the compilers
+  // that we care about.
+  int64_t x = ((((u * u_scale) + (v * v_scale)) + 0x8000) >> 16) + bias;
+  return (x > INT32_MAX) ? INT32_MAX : (x < INT32_MIN) ? INT32_MIN : (int32_t)x;
+}
+
+#define ICONVG_PRIVATE_S2D_X(p, x, y)                                       \
+  iconvg_private_fixed_s2d(x, y, p->s2d_fixed_scale_x, p->s2d_fixed_skew_x, \
+                           p->s2d_fixed_bias_x)
+#define ICONVG_PRIVATE_S2D_Y(p, x, y)                                       \
+  iconvg_private_fixed_s2d(y, x, p->s2d_fixed_scale_y, p->s2d_fixed_skew_y, \
+                           p->s2d_fixed_bias_y)
+#define ICONVG_PRIVATE_FIXED_TO_F32(v) (((float)(v)) / 256.0f)
+
+static const char*  //
+iconvg_private_canvas__begin_path(iconvg_canvas* c,
+                                  const iconvg_paint* p,
+                                  iconvg_private_wide_coord x0,
+                                  iconvg_private_wide_coord y0) {
+  iconvg_fixed_24_8 dx0 = ICONVG_PRIVATE_S2D_X(p, x0, y0);
+  iconvg_fixed_24_8 dy0 = ICONVG_PRIVATE_S2D_Y(p, x0, y0);
+  if (c->vtable->begin_path__fixed) {
+    return (*c->vtable->begin_path__fixed)(c, dx0, dy0);
+  }
+  return (*c->vtable->begin_path)(c, ICONVG_PRIVATE_FIXED_TO_F32(dx0),
+                                  ICONVG_PRIVATE_FIXED_TO_F32(dy0));
+}
+
+static const char*  //
+iconvg_private_canvas__path_line_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1) {
+  iconvg_fixed_24_8 dx1 = ICONVG_PRIVATE_S2D_X(p, x1, y1);
+  iconvg_fixed_24_8 dy1 = ICONVG_PRIVATE_S2D_Y(p, x1, y1);
+  if (c->vtable->path_line_to__fixed) {
+    return (*c->vtable->path_line_to__fixed)(c, dx1, dy1);
+  }
+  return (*c->vtable->path_line_to)(c, ICONVG_PRIVATE_FIXED_TO_F32(dx1),
+                                    ICONVG_PRIVATE_FIXED_TO_F32(dy1));
+}
+
+static const char*  //
+iconvg_private_canvas__path_quad_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2) {
+  iconvg_fixed_24_8 dx1 = ICONVG_PRIVATE_S2D_X(p, x1, y1);
+  iconvg_fixed_24_8 dy1 = ICONVG_PRIVATE_S2D_Y(p, x1, y1);
+  iconvg_fixed_24_8 dx2 = ICONVG_PRIVATE_S2D_X(p, x2, y2);
+  iconvg_fixed_24_8 dy2 = ICONVG_PRIVATE_S2D_Y(p, x2, y2);
+  if (c->vtable->path_quad_to__fixed) {
+    return (*c->vtable->path_quad_to__fixed)(c, dx1, dy1, dx2, dy2);
+  }
+  return (*c->vtable->path_quad_to)(
+      c, ICONVG_PRIVATE_FIXED_TO_F32(dx1), ICONVG_PRIVATE_FIXED_TO_F32(dy1),
+      ICONVG_PRIVATE_FIXED_TO_F32(dx2), ICONVG_PRIVATE_FIXED_TO_F32(dy2));
+}
+
+static const char*  //
+iconvg_private_canvas__path_cube_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2,
+                                    iconvg_private_wide_coord x3,
+                                    iconvg_private_wide_coord y3) {
+  iconvg_fixed_24_8 dx1 = ICONVG_PRIVATE_S2D_X(p, x1, y1);
+  iconvg_fixed_24_8 dy1 = ICONVG_PRIVATE_S2D_Y(p, x1, y1);
+  iconvg_fixed_24_8 dx2 = ICONVG_PRIVATE_S2D_X(p, x2, y2);
+  iconvg_fixed_24_8 dy2 = ICONVG_PRIVATE_S2D_Y(p, x2, y2);
+  iconvg_fixed_24_8 dx3 = ICONVG_PRIVATE_S2D_X(p, x3, y3);
+  iconvg_fixed_24_8 dy3 = ICONVG_PRIVATE_S2D_Y(p, x3, y3);
+  if (c->vtable->path_cube_to__fixed) {
+    return (*c->vtable->path_cube_to__fixed)(c, dx1, dy1, dx2, dy2, dx3, dy3);
+  }
+  return (*c->vtable->path_cube_to)(
+      c, ICONVG_PRIVATE_FIXED_TO_F32(dx1), ICONVG_PRIVATE_FIXED_TO_F32(dy1),
+      ICONVG_PRIVATE_FIXED_TO_F32(dx2), ICONVG_PRIVATE_FIXED_TO_F32(dy2),
+      ICONVG_PRIVATE_FIXED_TO_F32(dx3), ICONVG_PRIVATE_FIXED_TO_F32(dy3));
+}
+
+static const char*  //
+iconvg_private_canvas__path_run(iconvg_canvas* c,
+                                const iconvg_paint* p,
+                                const iconvg_private_coord* src,
+                                size_t num_points,
+                                size_t num_reps) {
+  iconvg_fixed_24_8 dst[ICONVG_PRIVATE_PATH_RUN__MAX_COORDS];
+  size_t n = 2 * num_points * num_reps;
+  for (size_t i = 0; i < n; i += 2) {
+    dst[i + 0] = ICONVG_PRIVATE_S2D_X(p, src[i + 0], src[i + 1]);
+    dst[i + 1] = ICONVG_PRIVATE_S2D_Y(p, src[i + 0], src[i + 1]);
+  }
+
+  const iconvg_fixed_24_8* d = dst;
+  switch (num_points) {
+    case 1:
+      if (c->vtable->path_line_to__fixed) {
+        for (; num_reps > 0; num_reps--, d += 2) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_line_to__fixed)(c, d[0], d[1]));
+        }
+      } else {
+        for (; num_reps > 0; num_reps--, d += 2) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
+              c, ICONVG_PRIVATE_FIXED_TO_F32(d[0]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[1])));
+        }
+      }
+      break;
+    case 2:
+      if (c->vtable->path_quad_to__fixed) {
+        for (; num_reps > 0; num_reps--, d += 4) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to__fixed)(c, d[0], d[1],
+                                                              d[2], d[3]));
+        }
+      } else {
+        for (; num_reps > 0; num_reps--, d += 4) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to)(
+              c, ICONVG_PRIVATE_FIXED_TO_F32(d[0]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[1]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[2]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[3])));
+        }
+      }
+      break;
+    default:
+      if (c->vtable->path_cube_to__fixed) {
+        for (; num_reps > 0; num_reps--, d += 6) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to__fixed)(
+              c, d[0], d[1], d[2], d[3], d[4], d[5]));
+        }
+      } else {
+        for (; num_reps > 0; num_reps--, d += 6) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
+              c, ICONVG_PRIVATE_FIXED_TO_F32(d[0]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[1]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[2]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[3]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[4]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[5])));
+        }
+      }
+      break;
+  }
+  return NULL;
+}
+
+#else  // defined(ICONVG_CONFIG__FIXED_POINT)
+
+// Checking p->skewed keeps the common, axis-aligned case's arithmetic (and
+// its floating point results) the same as when there is no dst_transform.
+#define ICONVG_PRIVATE_S2D_X(p, x, y)                                       \
+  (p->skewed ? (((x)*p->s2d_scale_x) + ((y)*p->s2d_skew_x) + p->s2d_bias_x) \
+             : (((x)*p->s2d_scale_x) + p->s2d_bias_x))
+#define ICONVG_PRIVATE_S2D_Y(p, x, y)                                       \
+  (p->skewed ? (((x)*p->s2d_skew_y) + ((y)*p->s2d_scale_y) + p->s2d_bias_y) \
+             : (((y)*p->s2d_scale_y) + p->s2d_bias_y))
+
+static inline const char*  //
+iconvg_private_canvas__begin_path(iconvg_canvas* c,
+                                  const iconvg_paint* p,
+                                  iconvg_private_wide_coord x0,
+                                  iconvg_private_wide_coord y0) {
+  return (*c->vtable->begin_path)(c,                                //
+                                  ICONVG_PRIVATE_S2D_X(p, x0, y0),  //
+                                  ICONVG_PRIVATE_S2D_Y(p, x0, y0));
+}
+
+static inline const char*  //
+iconvg_private_canvas__path_line_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1) {
+  return (*c->vtable->path_line_to)(c,                                //
+                                    ICONVG_PRIVATE_S2D_X(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x1, y1));
+}
+
+static inline const char*  //
+iconvg_private_canvas__path_quad_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2) {
+  return (*c->vtable->path_quad_to)(c,                                //
+                                    ICONVG_PRIVATE_S2D_X(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_X(p, x2, y2),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x2, y2));
+}
+
+static inline const char*  //
+iconvg_private_canvas__path_cube_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2,
+                                    iconvg_private_wide_coord x3,
+                                    iconvg_private_wide_coord y3) {
+  return (*c->vtable->path_cube_to)(c,                                //
+                                    ICONVG_PRIVATE_S2D_X(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_X(p, x2, y2),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x2, y2),  //
+                                    ICONVG_PRIVATE_S2D_X(p, x3, y3),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x3, y3));
+}
+
+static const char*  //
+iconvg_private_canvas__path_run(iconvg_canvas* c,
+                                const iconvg_paint* p,
+                                const iconvg_private_coord* src,
+                                size_t num_points,
+                                size_t num_reps) {
+  float dst[ICONVG_PRIVATE_PATH_RUN__MAX_COORDS];
+  size_t n = 2 * num_points * num_reps;
+  const double sx = p->s2d_scale_x;
+  const double bx = p->s2d_bias_x;
+  const double sy = p->s2d_scale_y;
+  const double by = p->s2d_bias_y;
+  // This is ICONVG_PRIVATE_S2D_X and ICONVG_PRIVATE_S2D_Y, with the
+  // p->skewed check hoisted out of the loop. The arithmetic must stay the
+  // same so that the results match, bit for bit.
+  if (p->skewed) {
+    const double kx = p->s2d_skew_x;
+    const double ky = p->s2d_skew_y;
+    for (size_t i = 0; i < n; i += 2) {
+      double x = src[i + 0];
+      double y = src[i + 1];
+      dst[i + 0] = (float)((x * sx) + (y * kx) + bx);
+      dst[i + 1] = (float)((x * ky) + (y * sy) + by);
+    }
+  } else {
+    for (size_t i = 0; i < n; i += 2) {
+      dst[i + 0] = (float)((((double)src[i + 0]) * sx) + bx);
+      dst[i + 1] = (float)((((double)src[i + 1]) * sy) + by);
+    }
+  }
+
+  const float* d = dst;
+  switch (num_points) {
+    case 1:
+      for (; num_reps > 0; num_reps--, d += 2) {
+        ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(c, d[0], d[1]));
+      }
+      break;
+    case 2:
+      for (; num_reps > 0; num_reps--, d += 4) {
+        ICONVG_PRIVATE_TRY(
+            (*c->vtable->path_quad_to)(c, d[0], d[1], d[2], d[3]));
+      }
+      break;
+    default:
+      for (; num_reps > 0; num_reps--, d += 6) {
+        ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(c, d[0], d[1], d[2],
+                                                      d[3], d[4], d[5]));
+      }
+      break;
+  }
+  return NULL;
+}
+
+#endif  // defined(ICONVG_CONFIG__FIXED_POINT)
+
+// ----
+
+// Each opcode's iconvg_private_opcode_infos entry says which of the bytecode
+// interpreter's handlers executes it and how long its arguments are, so that
+// jump ops can skip over it without executing it. An op's arguments are, in
+// order:
+//   - if the REPS flag is set, a natural number repeat count (only if the
+//     opcode's low 4 bits are zero) and then num_naturals coordinates per
+//     repetition. Coordinates have the same lengths as natural numbers.
+//   - if the VARIABLE_LENGTH flag is set, a natural number N and then N
+//     bytes.
+//   - num_bytes bytes.
+//   - if the REPS flag is not set, num_naturals natural numbers or
+//     coordinates.
+//   - if the SEGREF flag is set, an 8-byte SegRef and, if it is an Inline
+//     SegRef, the Segment Length bytes of segment contents that follow it.
+
+#define ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO 0x00
+#define ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO 0x01
+#define ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO 0x02
+#define ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE 0x03
+#define ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO 0x04
+#define ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD 0x05
+#define ICONVG_PRIVATE_OPCODE_HANDLER__NOP 0x06
+#define ICONVG_PRIVATE_OPCODE_HANDLER__JUMP 0x07
+#define ICONVG_PRIVATE_OPCODE_HANDLER__RET 0x08
+#define ICONVG_PRIVATE_OPCODE_HANDLER__CALL 0x09
+#define ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER 0x0A
+#define ICONVG_PRIVATE_OPCODE_HANDLER__FILL 0x0B
+#define ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED 0x0C
+#define ICONVG_PRIVATE_OPCODE_HANDLER__COUNT 0x0D
+
+#define ICONVG_PRIVATE_OPCODE_FLAG__REPS 0x01
+#define ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH 0x02
+#define ICONVG_PRIVATE_OPCODE_FLAG__SEGREF 0x04
+
+typedef struct iconvg_private_opcode_info_struct {
+  uint8_t handler;
+  uint8_t flags;
+  uint8_t num_bytes;
+  uint8_t num_naturals;
+} iconvg_private_opcode_info;
+
+#define ICONVG_PRIVATE_X16(...)                                     \
+  __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, \
+      __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, \
+      __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, \
+      __VA_ARGS__
+
+static const iconvg_private_opcode_info  //
+    iconvg_private_opcode_infos[256] = {
+        // 0x00 ..= 0x0F: LineTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO,
+                            ICONVG_PRIVATE_OPCODE_FLAG__REPS, 0, 2}),
+        // 0x10 ..= 0x1F: QuadTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO,
+                            ICONVG_PRIVATE_OPCODE_FLAG__REPS, 0, 4}),
+        // 0x20 ..= 0x2F: CubeTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO,
+                            ICONVG_PRIVATE_OPCODE_FLAG__REPS, 0, 6}),
+
+        // 0x30 ..= 0x33: Ellipse (1, 2, 3 or 4 quarters).
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        // 0x34: Parallelogram.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        // 0x35: MoveTo.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO, 0, 0, 2},
+        // 0x36: SEL += arg.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD, 0, 1, 0},
+        // 0x37: NOP.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__NOP, 0, 0, 0},
+        // 0x38: Jump Unconditional.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__JUMP, 0, 0, 1},
+        // 0x39: Jump Feature-Bits.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__JUMP, 0, 0, 2},
+        // 0x3A: Jump Level-of-Detail.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__JUMP, 0, 0, 3},
+        // 0x3B: RET.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__RET, 0, 0, 0},
+        // 0x3C: Call Untransformed (SegRef).
+        {ICONVG_PRIVATE_OPCODE_HANDLER__CALL,
+         ICONVG_PRIVATE_OPCODE_FLAG__SEGREF, 0, 0},
+        // 0x3D: Call Transformed (alpha byte, 6 coordinates, SegRef).
+        {ICONVG_PRIVATE_OPCODE_HANDLER__CALL,
+         ICONVG_PRIVATE_OPCODE_FLAG__SEGREF, 1, 6},
+        // 0x3E ..= 0x3F: Reserved ops.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+         ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+         ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0, 0},
+
+        // 0x40 ..= 0x4F: SetReg[SEL+adj].lo32 = u32.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 4, 0}),
+        // 0x50 ..= 0x5F: SetReg[SEL+adj].hi32 = u32.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 4, 0}),
+        // 0x60 ..= 0x6F: SetReg[SEL+adj] = u64.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 8, 0}),
+        // 0x70 ..= 0x7F: SetRegs[SEL-N+1 ..= SEL] = N u64s, for N = 2 ..= 17.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 16, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 24, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 32, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 40, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 48, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 56, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 64, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 72, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 80, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 88, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 96, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 104, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 112, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 120, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 128, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 136, 0},
+
+        // 0x80 ..= 0x8F: Fill flat color.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL, 0, 0, 0}),
+        // 0x90 ..= 0x9F: Fill linear gradient (NSTOPS byte, 3 f32s).
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL, 0, 13, 0}),
+        // 0xA0 ..= 0xAF: Fill radial gradient (NSTOPS byte, 6 f32s).
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL, 0, 25, 0}),
+        // 0xB0 ..= 0xBF: Reserved fill ops.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            0}),
+
+        // 0xC0 ..= 0xDF: Reserved ops that end with a LineTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            2}),
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            2}),
+        // 0xE0 ..= 0xFF: Other reserved ops.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            0}),
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            0}),
+};
+
+#undef ICONVG_PRIVATE_X16
+
+// iconvg_private_decoder__decode_num_reps sets *dst to the repeat count of
+// an op with the REPS flag, decoding a natural number if opcode's low 4 bits
+// are zero.
+static inline bool  //
+iconvg_private_decoder__decode_num_reps(iconvg_private_decoder* self,
+                                        uint8_t opcode,
+                                        uint32_t* dst) {
+  uint32_t num_reps = opcode & 15;
+  if (num_reps == 0) {
+    if (!iconvg_private_decoder__decode_natural_number(self, &num_reps)) {
+      return false;
+    }
+    num_reps += 16;
+  }
+  *dst = num_reps;
+  return true;
+}
+
+// iconvg_private_decoder__skip_segref skips an 8-byte SegRef and, if it is an
+// Inline SegRef (one whose high 32 bits are zero), the segment contents that
+// immediately follow it.
+static inline bool  //
+iconvg_private_decoder__skip_segref(iconvg_private_decoder* self) {
+  if (!iconvg_private_decoder__ensure(self, 8)) {
+    return false;
+  }
+  uint64_t segref = iconvg_private_peek_u64le(self->ptr);
+  size_t n = 8;
+  if ((segref >> 32) == 0) {
+    n += (size_t)((segref >> 8) & 0xFFFFFF);
+  }
+  return iconvg_private_decoder__skip(self, n);
+}
+
+// ----
+
+static const char*  //
+iconvg_private_expand_call(iconvg_canvas* c,
+                           iconvg_private_decoder* d,
+                           iconvg_paint* p,
+                           uint8_t opcode) {
+  // TODO: implement call ops. For now, just jump over them.
+
+  // Handle the ATM (Alpha and Transform Matrix): an alpha byte and then six
+  // coordinates.
+  if (opcode & 1) {
+    if (!iconvg_private_decoder__skip(d, 1)) {
+      return iconvg_error_bad_opcode_length;
+    }
+    for (int i = 0; i < 6; i++) {
+      uint32_t dummy;
+      if (!iconvg_private_decoder__decode_natural_number(d, &dummy)) {
+        return iconvg_error_bad_coordinate;
+      }
+    }
+  }
+
+  if (!iconvg_private_decoder__skip_segref(d)) {
+    return iconvg_error_bad_opcode_length;
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_expand_ellipse_parallelogram(iconvg_canvas* c,
+                                            iconvg_private_decoder* d,
+                                            iconvg_paint* p,
+                                            uint8_t opcode) {
+  // Decode the two explicit coordinate pairs.
+  if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[1], 4)) {
+    return iconvg_error_bad_coordinate;
+  }
+
+  // The third coordinate pair is implicit.
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  for (int j = 0; j < 2; j++) {
+    int64_t v = ((int64_t)p->coords[0][j]) - ((int64_t)p->coords[1][j]) +
+                ((int64_t)p->coords[2][j]);
+    p->coords[3][j] = (v > INT32_MAX)   ? INT32_MAX
+                      : (v < INT32_MIN) ? INT32_MIN
+                                        : (int32_t)v;
+  }
+#else
+  p->coords[3][0] = p->coords[0][0] - p->coords[1][0] + p->coords[2][0];
+  p->coords[3][1] = p->coords[0][1] - p->coords[1][1] + p->coords[2][1];
+#endif
+
+  // Handle a Parallelogram opcode.
+  if (opcode >= 0x34) {
+    for (int i = 1; i <= 4; i++) {  // Loop 1 ..= 4, not 0 ..= 3.
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_line_to(
+          c, p, p->coords[i & 3][0], p->coords[i & 3][1]));
+    }
+    return NULL;
+  }
+
+  // The ellipse approximation's cubic Bézier points are described at
+  // https://nigeltao.github.io/blog/2021/three-points-define-ellipse.html
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  // k is 0.551784777779014 as a 16.16 fixed point number. Working with
+  // (2 * (B - center)) = (2*B - A - C) avoids rounding the center.
+  const int64_t k = 36162;
+  int64_t kr[2];
+  int64_t ks[2];
+  for (int j = 0; j < 2; j++) {
+    int64_t ca = p->coords[0][j];
+    int64_t cb = p->coords[1][j];
+    int64_t cc = p->coords[2][j];
+    kr[j] = ((k * ((2 * cb) - ca - cc)) + 0x10000) >> 17;
+    ks[j] = ((k * (cc - ca)) + 0x10000) >> 17;
+  }
+#else
+  double center[2];
+  center[0] = (p->coords[0][0] + p->coords[2][0]) / 2;
+  center[1] = (p->coords[0][1] + p->coords[2][1]) / 2;
+  const double k = 0.551784777779014;
+  double kr[2];
+  kr[0] = k * (p->coords[1][0] - center[0]);
+  kr[1] = k * (p->coords[1][1] - center[1]);
+  double ks[2];
+  ks[0] = k * (p->coords[2][0] - center[0]);
+  ks[1] = k * (p->coords[2][1] - center[1]);
+#endif
+
+  iconvg_private_wide_coord imps[12][2];  // A+ B- B,   B+ C- C,   C+ D- D,   D+ A- A.
+  imps[0][0] = p->coords[0][0] + kr[0];
+  imps[0][1] = p->coords[0][1] + kr[1];
+  imps[1][0] = p->coords[1][0] - ks[0];
+  imps[1][1] = p->coords[1][1] - ks[1];
+  imps[2][0] = p->coords[1][0];
+  imps[2][1] = p->coords[1][1];
+  imps[3][0] = p->coords[1][0] + ks[0];
+  imps[3][1] = p->coords[1][1] + ks[1];
+  imps[4][0] = p->coords[2][0] + kr[0];
+  imps[4][1] = p->coords[2][1] + kr[1];
+  imps[5][0] = p->coords[2][0];
+  imps[5][1] = p->coords[2][1];
+  imps[6][0] = p->coords[2][0] - kr[0];
+  imps[6][1] = p->coords[2][1] - kr[1];
+  imps[7][0] = p->coords[3][0] + ks[0];
+  imps[7][1] = p->coords[3][1] + ks[1];
+  imps[8][0] = p->coords[3][0];
+  imps[8][1] = p->coords[3][1];
+  imps[9][0] = p->coords[3][0] - ks[0];
+  imps[9][1] = p->coords[3][1] - ks[1];
+  imps[10][0] = p->coords[0][0] - kr[0];
+  imps[10][1] = p->coords[0][1] - kr[1];
+  imps[11][0] = p->coords[0][0];
+  imps[11][1] = p->coords[0][1];
+
+  for (size_t i = 0; i <= (opcode & 3); i++) {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_cube_to(
+        c, p,                                            //
+        imps[(3 * i) + 0][0], imps[(3 * i) + 0][1],      //
+        imps[(3 * i) + 1][0], imps[(3 * i) + 1][1],      //
+        imps[(3 * i) + 2][0], imps[(3 * i) + 2][1]));
+    // The end points (B, C, D or A) are coords[1], coords[2], coords[3] or
+    // coords[0], so this cast does not overflow.
+    p->coords[0][0] = (iconvg_private_coord)imps[(3 * i) + 2][0];
+    p->coords[0][1] = (iconvg_private_coord)imps[(3 * i) + 2][1];
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_expand_jump(iconvg_private_decoder* d,
+                           iconvg_paint* p,
+                           uint8_t opcode) {
+  uint32_t jump_distance = 0;
+  if (!iconvg_private_decoder__decode_natural_number(d, &jump_distance)) {
+    return iconvg_error_bad_number;
+  }
+
+  if (opcode == 0x39) {  // Jump Feature-Bits.
+    uint32_t feature_bits = 0;
+    if (!iconvg_private_decoder__decode_natural_number(d, &feature_bits)) {
+      return iconvg_error_bad_number;
+    }
+    // This decoder doesn't support any optional features (optional in terms of
+    // the file format), so we always jump unless feature_bits is zero.
+    if (feature_bits == 0) {
+      return NULL;
+    }
+
+  } else if (opcode == 0x3A) {  // Jump Level-of-Detail.
+    iconvg_private_coord lod[2] = {0};
+    if (!iconvg_private_decoder__decode_path_coordinates(d, lod, 2)) {
+      return iconvg_error_bad_number;
+    }
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+    // lod is 24.8 fixed point, so scale h by 256 too. The bounds saturate at
+    // ±(1<<23), so clamping h to ±(1<<24) doesn't change the comparisons.
+    int64_t h = p->height_in_pixels;
+    h = (h < -(1 << 24)) ? -(1 << 24) : (h > (1 << 24)) ? (1 << 24) : h;
+    h *= 256;
+#else
+    double h = p->height_in_pixels;
+#endif
+    if ((lod[0] <= h) && (h < lod[1])) {
+      return NULL;
+    }
+  }
+
+  for (; jump_distance > 0; jump_distance--) {
+    if (!iconvg_private_decoder__ensure(d, 1)) {
+      return iconvg_error_bad_jump;
+    }
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+    const iconvg_private_opcode_info* info =
+        &iconvg_private_opcode_infos[opcode];
+
+    uint64_t num_naturals = info->num_naturals;
+    if (info->flags & ICONVG_PRIVATE_OPCODE_FLAG__REPS) {
+      uint32_t num_reps = 0;
+      if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+        return iconvg_error_bad_jump;
+      }
+      num_naturals *= num_reps;
+    }
+
+    if (info->flags & ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH) {
+      uint32_t num_bytes = 0;
+      if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes) ||
+          !iconvg_private_decoder__skip(d, num_bytes)) {
+        return iconvg_error_bad_jump;
+      }
+    }
+
+    if (!iconvg_private_decoder__skip(d, info->num_bytes)) {
+      return iconvg_error_bad_jump;
+    }
+
+    for (; num_naturals > 0; num_naturals--) {
+      uint32_t dummy;
+      if (!iconvg_private_decoder__decode_natural_number(d, &dummy)) {
+        return iconvg_error_bad_jump;
+      }
+    }
+
+    if ((info->flags & ICONVG_PRIVATE_OPCODE_FLAG__SEGREF) &&
+        !iconvg_private_decoder__skip_segref(d)) {
+      return iconvg_error_bad_jump;
+    }
+  }
+
+  return NULL;
+}
+
+// ----
+
+static inline const char*  //
+iconvg_private_execute_register_op(iconvg_private_decoder* d,
+                                   iconvg_paint* p,
+                                   uint8_t opcode) {
+  uint32_t adj = opcode & 15;
+  switch ((opcode >> 4) & 3) {
+    case 0:
+      if (!iconvg_private_decoder__ensure(d, 4)) {
+        return iconvg_error_bad_number;
+      }
+      p->regs[(p->sel + adj) & 63] =
+          ((uint64_t)iconvg_private_peek_u32le(d->ptr));
+      d->ptr += 4;
+      d->len -= 4;
+      break;
+    case 1:
+      if (!iconvg_private_decoder__ensure(d, 4)) {
+        return iconvg_error_bad_number;
+      }
+      p->regs[(p->sel + adj) & 63] =
+          ((uint64_t)iconvg_private_peek_u32le(d->ptr)) << 32;
+      d->ptr += 4;
+      d->len -= 4;
+      break;
+    case 2:
+      if (!iconvg_private_decoder__ensure(d, 8)) {
+        return iconvg_error_bad_number;
+      }
+      p->regs[(p->sel + adj) & 63] = iconvg_private_peek_u64le(d->ptr);
+      d->ptr += 8;
+      d->len -= 8;
+      break;
+    default:
+      adj += 2;
+      p->sel -= adj;
+      for (uint32_t i = 1; i <= adj; i++) {
+        if (!iconvg_private_decoder__ensure(d, 8)) {
+          return iconvg_error_bad_number;
+        }
+        p->regs[(p->sel + i) & 63] = iconvg_private_peek_u64le(d->ptr);
+        d->ptr += 8;
+        d->len -= 8;
+      }
+      return NULL;
+  }
+  p->sel -= (adj == 0) ? 1 : 0;
+  return NULL;
+}
+
+static inline const char*  //
+iconvg_private_execute_fill_op(iconvg_canvas* c,
+                               iconvg_private_decoder* d,
+                               iconvg_paint* p,
+                               uint8_t opcode) {
+  uint32_t adj = opcode & 15;
+  p->sel += (adj == 0) ? 1 : 0;
+  uint32_t num_transforms = 0;
+
+  switch ((opcode >> 4) & 3) {
+    case 0:
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
+      break;
+    case 1:
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__LINEAR_GRADIENT;
+      p->transform[3] = 0.0f;
+      p->transform[4] = 0.0f;
+      p->transform[5] = 0.0f;
+      num_transforms = 3;
+      break;
+    case 2:
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__RADIAL_GRADIENT;
+      num_transforms = 6;
+      break;
+    case 3: {
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
+      uint32_t num_bytes = 0;
+      if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
+        return iconvg_error_bad_number;
+      }
+      if (!iconvg_private_decoder__skip(d, num_bytes)) {
+        return iconvg_error_bad_opcode_length;
+      }
+      break;
+    }
+  }
+  p->which_regs = (uint8_t)(p->sel + adj);
+
+  if (num_transforms > 0) {
+    if (!iconvg_private_decoder__ensure(d, 1)) {
+      return iconvg_error_bad_opcode_length;
+    }
+    p->num_stops = (d->ptr[0] & 63) + 2;
+    p->spread = d->ptr[0] >> 6;
+    d->ptr += 1;
+    d->len -= 1;
+    if (p->num_stops > 64) {
+      return iconvg_error_bad_opcode_length;
+    }
+    for (uint32_t i = 0; i < num_transforms; i++) {
+      if (!iconvg_private_decoder__decode_float32(d, &p->transform[i])) {
+        return iconvg_error_bad_number;
+      }
+    }
+  }
+
+  if (p->begun_path) {
+    p->begun_path = false;
+    ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+  }
+  if (p->begun_drawing) {
+    p->begun_drawing = false;
+    ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, p));
+  }
+  return NULL;
+}
+
+static inline const char*  //
+iconvg_private_execute_reserved_op(iconvg_canvas* c,
+                                   iconvg_private_decoder* d,
+                                   iconvg_paint* p,
+                                   uint8_t opcode) {
+  uint32_t num_bytes = 0;
+  if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
+    return iconvg_error_bad_number;
+  }
+  if (!iconvg_private_decoder__skip(d, num_bytes)) {
+    return iconvg_error_bad_opcode_length;
+  }
+  if ((0xC0 <= opcode) && (opcode < 0xE0)) {
+    if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[1], 2)) {
+      return iconvg_error_bad_coordinate;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_line_to(
+        c, p, p->coords[1][0], p->coords[1][1]));
+    p->coords[0][0] = p->coords[1][0];
+    p->coords[0][1] = p->coords[1][1];
+  }
+  return NULL;
+}
+
+// ----
+
+// With GCC and Clang, iconvg_private_execute_bytecode uses computed gotos (a
+// GNU C extension) to jump straight from one op's handler to the next's,
+// each handler having its own indirect branch. Otherwise, or if the
+// ICONVG_CONFIG__DISABLE_COMPUTED_GOTO macro is defined, it uses a switch.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(ICONVG_CONFIG__DISABLE_COMPUTED_GOTO)
+#define ICONVG_PRIVATE_HAVE_COMPUTED_GOTO 1
+#endif
+
+// iconvg_private_canvas__ensure_begun_path calls begin_drawing and then
+// begin_path (at the current point), unless they have already been called.
+static inline const char*  //
+iconvg_private_canvas__ensure_begun_path(iconvg_canvas* c, iconvg_paint* p) {
+  if (!p->begun_drawing) {
+    p->begun_drawing = true;
+    ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
+  }
+  if (!p->begun_path) {
+    p->begun_path = true;
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+        c, p, p->coords[0][0], p->coords[0][1]));
+  }
+  return NULL;
+}
+
+static inline const char*  //
+iconvg_private_execute_move_to(iconvg_canvas* c,
+                               iconvg_private_decoder* d,
+                               iconvg_paint* p) {
+  if (!p->begun_drawing) {
+    p->begun_drawing = true;
+    ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
+  }
+  if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[0], 2)) {
+    return iconvg_error_bad_coordinate;
+  }
+  if (p->begun_path) {
+    ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+  } else {
+    p->begun_path = true;
+  }
+  return iconvg_private_canvas__begin_path(c, p, p->coords[0][0],
+                                           p->coords[0][1]);
+}
+
+static inline const char*  //
+iconvg_private_execute_sel_add(iconvg_private_decoder* d, iconvg_paint* p) {
+  if (!iconvg_private_decoder__ensure(d, 1)) {
+    return iconvg_error_bad_number;
+  }
+  p->sel += d->ptr[0];
+  d->ptr += 1;
+  d->len -= 1;
+  return NULL;
+}
+
+// iconvg_private_execute_path_run executes num_reps repetitions of a LineTo,
+// QuadTo or CubeTo op (with num_points being 1, 2 or 3), decoding and then
+// transforming up to ICONVG_PRIVATE_PATH_RUN__MAX_REPS of them at a time.
+static inline const char*  //
+iconvg_private_execute_path_run(iconvg_canvas* c,
+                                iconvg_private_decoder* d,
+                                iconvg_paint* p,
+                                uint32_t num_reps,
+                                size_t num_points) {
+  iconvg_private_coord src[ICONVG_PRIVATE_PATH_RUN__MAX_COORDS];
+  const size_t rep_len = 2 * num_points;
+  while (num_reps > 0) {
+    uint32_t n = (num_reps < ICONVG_PRIVATE_PATH_RUN__MAX_REPS)
+                     ? num_reps
+                     : ICONVG_PRIVATE_PATH_RUN__MAX_REPS;
+    size_t num_complete_reps =
+        iconvg_private_decoder__decode_path_coordinate_run(d, src,
+                                                           n * rep_len) /
+        rep_len;
+    // As if executing the repetitions one at a time, the canvas sees every
+    // repetition before the first bad coordinate.
+    if (num_complete_reps > 0) {
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_run(c, p, src, num_points,
+                                                         num_complete_reps));
+      p->coords[0][0] = src[(num_complete_reps * rep_len) - 2];
+      p->coords[0][1] = src[(num_complete_reps * rep_len) - 1];
+    }
+    if (num_complete_reps < n) {
+      return iconvg_error_bad_coordinate;
+    }
+    num_reps -= n;
+  }
+  return NULL;
+}
+
+#if defined(ICONVG_PRIVATE_HAVE_COMPUTED_GOTO)
+#define ICONVG_PRIVATE_HANDLER(h) handler_##h
+#define ICONVG_PRIVATE_NEXT_OPCODE()                                       \
+  do {                                                                     \
+    if ((d->len == 0) && !iconvg_private_decoder__refill(d, 1)) {          \
+      return NULL;                                                         \
+    }                                                                      \
+    ICONVG_PRIVATE_OBSERVE_OP(d->ptr);                                     \
+    opcode = d->ptr[0];                                                    \
+    d->ptr += 1;                                                           \
+    d->len -= 1;                                                           \
+    goto* handlers[iconvg_private_opcode_infos[opcode].handler];           \
+  } while (0)
+#else
+#define ICONVG_PRIVATE_HANDLER(h) case ICONVG_PRIVATE_OPCODE_HANDLER__##h
+#define ICONVG_PRIVATE_NEXT_OPCODE() goto next_opcode
+#endif
+
+static const char*  //
+iconvg_private_execute_bytecode(iconvg_canvas* c,
+                                iconvg_private_decoder* d,
+                                iconvg_paint* p) {
+  uint8_t opcode = 0;
+
+#if defined(ICONVG_PRIVATE_HAVE_COMPUTED_GOTO)
+  // This array's order matches the ICONVG_PRIVATE_OPCODE_HANDLER__ETC values.
+  static const void* const handlers[ICONVG_PRIVATE_OPCODE_HANDLER__COUNT] = {
+      &&handler_LINE_TO,  &&handler_QUAD_TO,  &&handler_CUBE_TO,
+      &&handler_ELLIPSE,  &&handler_MOVE_TO,  &&handler_SEL_ADD,
+      &&handler_NOP,      &&handler_JUMP,     &&handler_RET,
+      &&handler_CALL,     &&handler_REGISTER, &&handler_FILL,
+      &&handler_RESERVED,
+  };
+  ICONVG_PRIVATE_NEXT_OPCODE();
+#else
+next_opcode:
+  if ((d->len == 0) && !iconvg_private_decoder__refill(d, 1)) {
+    return NULL;
+  }
+  ICONVG_PRIVATE_OBSERVE_OP(d->ptr);
+  opcode = d->ptr[0];
+  d->ptr += 1;
+  d->len -= 1;
+  switch (iconvg_private_opcode_infos[opcode].handler) {
+#endif
+
+  ICONVG_PRIVATE_HANDLER(LINE_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    uint32_t num_reps = 0;
+    if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+      return iconvg_error_bad_number;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_path_run(c, d, p, num_reps, 1));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(QUAD_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    uint32_t num_reps = 0;
+    if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+      return iconvg_error_bad_number;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_path_run(c, d, p, num_reps, 2));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(CUBE_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    uint32_t num_reps = 0;
+    if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+      return iconvg_error_bad_number;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_path_run(c, d, p, num_reps, 3));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(ELLIPSE) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    ICONVG_PRIVATE_TRY(
+        iconvg_private_expand_ellipse_parallelogram(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(MOVE_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_move_to(c, d, p));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(SEL_ADD) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_sel_add(d, p));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(NOP) : {
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(JUMP) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_expand_jump(d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(RET) : {
+    return NULL;
+  }
+
+  ICONVG_PRIVATE_HANDLER(CALL) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_expand_call(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(REGISTER) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_register_op(d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(FILL) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_fill_op(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(RESERVED) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_reserved_op(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+#if !defined(ICONVG_PRIVATE_HAVE_COMPUTED_GOTO)
+  }
+  return NULL;
+#endif
+}
+
+#undef ICONVG_PRIVATE_HANDLER
+#undef ICONVG_PRIVATE_NEXT_OPCODE
+
+// ----
+
+const iconvg_matrix_2x3_f64*  //
+iconvg_private_dst_transform(const iconvg_decode_options* options) {
+  if (!options ||
+      (options->sizeof__iconvg_decode_options <
+       (offsetof(iconvg_decode_options, dst_transform) +
+        sizeof(options->dst_transform)))) {
+    return NULL;
+  }
+  return options->dst_transform;
+}
+
+void  //
+iconvg_private_initialize_remaining_paint_fields(
+    iconvg_paint* p,
+    iconvg_rectangle_f32 r,
+    const iconvg_matrix_2x3_f64* m) {
+  double rw = iconvg_rectangle_f32__width_f64(&r);
+  double rh = iconvg_rectangle_f32__height_f64(&r);
+  double vw = iconvg_rectangle_f32__width_f64(&p->viewbox);
+  double vh = iconvg_rectangle_f32__height_f64(&p->viewbox);
+  if ((rw > 0) && (rh > 0) && (vw > 0) && (vh > 0)) {
+    p->s2d_scale_x = rw / vw;
+    p->s2d_scale_y = rh / vh;
+    p->s2d_bias_x = r.min_x - (p->viewbox.min_x * p->s2d_scale_x);
+    p->s2d_bias_y = r.min_y - (p->viewbox.min_y * p->s2d_scale_y);
+  } else {
+    p->s2d_scale_x = 1.0;
+    p->s2d_bias_x = 0.0;
+    p->s2d_scale_y = 1.0;
+    p->s2d_bias_y = 0.0;
+  }
+
+  p->s2d_skew_x = 0.0;
+  p->s2d_skew_y = 0.0;
+
+  // An identity m is the same as no m. Any other axis-aligned m (a scale and
+  // a translation) keeps s2d axis-aligned, so compose it directly and derive
+  // d2s the same way as for no m, rather than by a general matrix inverse.
+  // Either way, the results are exact, not off by an ulp or so.
+  if (m && (m->elems[0][1] == 0) && (m->elems[1][0] == 0)) {
+    if ((m->elems[0][0] == 1) && (m->elems[0][2] == 0) &&
+        (m->elems[1][1] == 1) && (m->elems[1][2] == 0)) {
+      m = NULL;
+    } else if ((m->elems[0][0] != 0) && (m->elems[1][1] != 0)) {
+      p->s2d_bias_x = (m->elems[0][0] * p->s2d_bias_x) + m->elems[0][2];
+      p->s2d_bias_y = (m->elems[1][1] * p->s2d_bias_y) + m->elems[1][2];
+      p->s2d_scale_x *= m->elems[0][0];
+      p->s2d_scale_y *= m->elems[1][1];
+      m = NULL;
+    }
+  }
+
+  p->d2s_scale_x = 1.0 / p->s2d_scale_x;
+  p->d2s_bias_x = -p->s2d_bias_x * p->d2s_scale_x;
+  p->d2s_scale_y = 1.0 / p->s2d_scale_y;
+  p->d2s_bias_y = -p->s2d_bias_y * p->d2s_scale_y;
+  p->d2s_skew_x = 0.0;
+  p->d2s_skew_y = 0.0;
+
+  p->skewed = false;
+
+  if (m) {
+    // Compose the (not axis-aligned) m after the axis-aligned s2d transform.
+    iconvg_matrix_2x3_f64 s2d = iconvg_matrix_2x3_f64__make(
+        m->elems[0][0] * p->s2d_scale_x,  //
+        m->elems[0][1] * p->s2d_scale_y,  //
+        (m->elems[0][0] * p->s2d_bias_x) + (m->elems[0][1] * p->s2d_bias_y) +
+            m->elems[0][2],               //
+        m->elems[1][0] * p->s2d_scale_x,  //
+        m->elems[1][1] * p->s2d_scale_y,  //
+        (m->elems[1][0] * p->s2d_bias_x) + (m->elems[1][1] * p->s2d_bias_y) +
+            m->elems[1][2]);
+    iconvg_matrix_2x3_f64 d2s = iconvg_matrix_2x3_f64__inverse(&s2d);
+
+    p->s2d_scale_x = s2d.elems[0][0];
+    p->s2d_skew_x = s2d.elems[0][1];
+    p->s2d_bias_x = s2d.elems[0][2];
+    p->s2d_skew_y = s2d.elems[1][0];
+    p->s2d_scale_y = s2d.elems[1][1];
+    p->s2d_bias_y = s2d.elems[1][2];
+
+    p->d2s_scale_x = d2s.elems[0][0];
+    p->d2s_skew_x = d2s.elems[0][1];
+    p->d2s_bias_x = d2s.elems[0][2];
+    p->d2s_skew_y = d2s.elems[1][0];
+    p->d2s_scale_y = d2s.elems[1][1];
+    p->d2s_bias_y = d2s.elems[1][2];
+
+    p->skewed = (p->s2d_skew_x != 0) || (p->s2d_skew_y != 0);
+  }
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  p->s2d_fixed_scale_x = iconvg_private_fixed_from_f64(p->s2d_scale_x, 65536.0,
+                                                       ((int64_t)1) << 28);
+  p->s2d_fixed_bias_x = iconvg_private_fixed_from_f64(p->s2d_bias_x, 256.0,
+                                                      ((int64_t)1) << 40);
+  p->s2d_fixed_scale_y = iconvg_private_fixed_from_f64(p->s2d_scale_y, 65536.0,
+                                                       ((int64_t)1) << 28);
+  p->s2d_fixed_bias_y = iconvg_private_fixed_from_f64(p->s2d_bias_y, 256.0,
+                                                      ((int64_t)1) << 40);
+  p->s2d_fixed_skew_x = iconvg_private_fixed_from_f64(p->s2d_skew_x, 65536.0,
+                                                      ((int64_t)1) << 28);
+  p->s2d_fixed_skew_y = iconvg_private_fixed_from_f64(p->s2d_skew_y, 65536.0,
+                                                      ((int64_t)1) << 28);
+#endif
+
+  p->sel = 56;
+  p->begun_drawing = false;
+  p->begun_path = false;
+
+  p->paint_type = 0;
+  p->num_stops = 0;
+  p->spread = 0;
+  p->which_regs = 0;
+
+  p->coords[0][0] = 0;
+  p->coords[0][1] = 0;
+  p->coords[1][0] = 0;
+  p->coords[1][1] = 0;
+  p->coords[2][0] = 0;
+  p->coords[2][1] = 0;
+  p->coords[3][0] = 0;
+  p->coords[3][1] = 0;
+
+  for (int i = 0; i < 64; i++) {
+    uint32_t u =
+        iconvg_private_peek_u32le(&p->custom_palette.colors[i].rgba[0]);
+    p->regs[i] = ((uint64_t)u) << 32;
+  }
+}
+
+// ----
+
+const char*  //
+iconvg_decode_viewbox(iconvg_rectangle_f32* dst_viewbox,
+                      const uint8_t* src_ptr,
+                      size_t src_len) {
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  d.iov = NULL;
+
+  if (!iconvg_private_decoder__decode_magic_identifier(&d)) {
+    return iconvg_error_bad_magic_identifier;
+  }
+  uint32_t num_metadata_chunks;
+  if (!iconvg_private_decoder__decode_natural_number(&d,
+                                                     &num_metadata_chunks)) {
+    return iconvg_error_bad_metadata;
+  }
+
+  bool use_default_viewbox = true;
+  int32_t previous_metadata_id = -1;
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    uint32_t chunk_length;
+    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
+        (chunk_length > d.len)) {
+      return iconvg_error_bad_metadata;
+    }
+    iconvg_private_decoder chunk =
+        iconvg_private_decoder__limit_u32(&d, chunk_length);
+    uint32_t metadata_id;
+    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
+      return iconvg_error_bad_metadata;
+    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
+      return iconvg_error_bad_metadata_id_order;
+    }
+
+    if (metadata_id == 8) {  // MID 8 (ViewBox).
+      use_default_viewbox = false;
+      iconvg_rectangle_f32 r;
+      if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk, &r) ||
+          (chunk.len != 0)) {
+        return iconvg_error_bad_metadata_viewbox;
+      } else if (dst_viewbox) {
+        *dst_viewbox = r;
+      }
+      return NULL;
+    } else if (metadata_id > 8) {
+      // MIDs should appear in increasing order.
+      break;
+    }
+
+    iconvg_private_decoder__skip_to_the_end(&chunk);
+    iconvg_private_decoder__advance_to_ptr(&d, chunk.ptr);
+    previous_metadata_id = ((int32_t)metadata_id);
+  }
+
+  if (use_default_viewbox && dst_viewbox) {
+    *dst_viewbox = iconvg_private_default_viewbox();
+  }
+  return NULL;
+}
+
+int64_t  //
+iconvg_private_height_in_pixels(iconvg_rectangle_f32 r,
+                                const iconvg_decode_options* options) {
+  if (options && options->height_in_pixels.has_value) {
+    return options->height_in_pixels.value;
+  }
+  double h = iconvg_rectangle_f32__height_f64(&r);
+  // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
+  // than MAX_INT32 and also ensures that conversion between integer and
+  // float or double is lossless.
+  if (h <= 0x100000) {
+    return (int64_t)h;
+  }
+  return 0x100000;
+}
+
+// iconvg_private_decode_header decodes the magic identifier and metadata,
+// passing the latter to c, and sets up p to execute the bytecode that
+// follows.
+static const char*  //
+iconvg_private_decode_header(iconvg_canvas* c,
+                             iconvg_rectangle_f32 r,
+                             iconvg_private_decoder* d,
+                             iconvg_paint* p,
+                             const iconvg_decode_options* options) {
+  p->viewbox = iconvg_private_default_viewbox();
+  p->height_in_pixels = iconvg_private_height_in_pixels(r, options);
+  memcpy(&p->custom_palette, &iconvg_private_default_palette,
+         sizeof(p->custom_palette));
+
+  if (!iconvg_private_decoder__decode_magic_identifier(d)) {
+    return iconvg_error_bad_magic_identifier;
+  }
+  uint32_t num_metadata_chunks;
+  if (!iconvg_private_decoder__decode_natural_number(d, &num_metadata_chunks)) {
+    return iconvg_error_bad_metadata;
+  }
+
+  int32_t previous_metadata_id = -1;
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    uint32_t chunk_length;
+    if (!iconvg_private_decoder__decode_natural_number(d, &chunk_length) ||
+        !iconvg_private_decoder__ensure(d, chunk_length)) {
+      return iconvg_error_bad_metadata;
+    }
+    iconvg_private_decoder chunk =
+        iconvg_private_decoder__limit_u32(d, chunk_length);
+    uint32_t metadata_id;
+    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
+      return iconvg_error_bad_metadata;
+    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
+      return iconvg_error_bad_metadata_id_order;
+    }
+
+    switch (metadata_id) {
+      case 8:  // MID 8 (ViewBox).
+        if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk,
+                                                             &p->viewbox) ||
+            (chunk.len != 0)) {
+          return iconvg_error_bad_metadata_viewbox;
+        }
+        break;
+
+      case 16:  // MID 16 (Suggested Palette).
+        if (!iconvg_private_decoder__decode_metadata_suggested_palette(
+                &chunk, &p->custom_palette) ||
+            (chunk.len != 0)) {
+          return iconvg_error_bad_metadata_suggested_palette;
+        }
+        break;
+
+      default:
+        return iconvg_error_bad_metadata;
+    }
+
+    iconvg_private_decoder__skip_to_the_end(&chunk);
+    iconvg_private_decoder__advance_to_ptr(d, chunk.ptr);
+    previous_metadata_id = ((int32_t)metadata_id);
+  }
+
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, p->viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, &p->custom_palette));
+
+  if (options && options->palette) {
+    memcpy(&p->custom_palette, options->palette, sizeof(p->custom_palette));
+  }
+
+  iconvg_private_initialize_remaining_paint_fields(
+      p, r, iconvg_private_dst_transform(options));
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_decode(iconvg_canvas* c,
+                      iconvg_rectangle_f32 r,
+                      iconvg_private_decoder* d,
+                      const iconvg_decode_options* options) {
+  iconvg_paint p;
+  ICONVG_PRIVATE_TRY(iconvg_private_decode_header(c, r, d, &p, options));
+  return iconvg_private_execute_bytecode(c, d, &p);
+}
+
+const char*  //
+iconvg_decode(iconvg_canvas* dst_canvas,
+              iconvg_rectangle_f32 dst_rect,
+              const uint8_t* src_ptr,
+              size_t src_len,
+              const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+
+  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
+      sizeof(iconvg_canvas_vtable)) {
+    // If we want to support multiple library versions (with dynamic linking),
+    // we could detect older versions here (with smaller vtable sizes) and
+    // substitute in an adapter implementation.
+    return iconvg_error_invalid_vtable;
+  }
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  d.iov = NULL;
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_decode(dst_canvas, dst_rect, &d, options);
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg, src_len - d.len,
+                                           d.len);
+}
+
+const char*  //
+iconvg_decode_iov(iconvg_canvas* dst_canvas,
+                  iconvg_rectangle_f32 dst_rect,
+                  const struct iovec* iov,
+                  int iovcnt,
+                  const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+
+  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
+      sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+
+  iconvg_private_decoder_iov v;
+  v.iov = iov;
+  v.offset = 0;
+  v.remaining = 0;
+  for (int i = 0; iov && (i < iovcnt); i++) {
+    v.remaining += iov[i].iov_len;
+  }
+  size_t src_len = v.remaining;
+
+  iconvg_private_decoder d;
+  d.ptr = NULL;
+  d.len = 0;
+  d.iov = &v;
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_decode(dst_canvas, dst_rect, &d, options);
+  }
+  size_t num_bytes_remaining = d.len + v.remaining;
+  return (*dst_canvas->vtable->end_decode)(
+      dst_canvas, err_msg, src_len - num_bytes_remaining, num_bytes_remaining);
+}
+
+// ----
+
+// The iconvg_op_iterator's private_impl.paint holds an iconvg_paint, whose
+// size is only known here.
+typedef char iconvg_private_op_iterator_paint_storage_is_large_enough
+    [(sizeof(iconvg_paint) <=
+      (sizeof(uint64_t) * ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE))
+         ? 1
+         : -1];
+
+// iconvg_private_op_iterator_canvas is a canvas that appends each method call
+// to the iconvg_op_iterator (its context.nonconst_ptr1)'s queue of ops.
+
+static iconvg_op*  //
+iconvg_private_op_iterator_canvas__push(iconvg_canvas* c, iconvg_op_type t) {
+  iconvg_op_iterator* self = (iconvg_op_iterator*)(c->context.nonconst_ptr1);
+  if (self->private_impl.ops_wi >= ICONVG_OP_ITERATOR__MAX_PENDING_OPS) {
+    return NULL;
+  }
+  iconvg_op* op = &self->private_impl.ops[self->private_impl.ops_wi++];
+  memset(op, 0, sizeof(*op));
+  op->type = t;
+  return op;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__begin_decode(iconvg_canvas* c,
+                                                iconvg_rectangle_f32 dst_rect) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__end_decode(iconvg_canvas* c,
+                                              const char* err_msg,
+                                              size_t num_bytes_consumed,
+                                              size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__BEGIN_DRAWING);
+  return op ? NULL : iconvg_error_system_failure_out_of_memory;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__end_drawing(iconvg_canvas* c,
+                                               const iconvg_paint* p) {
+  // The op's paint field is set by iconvg_op_iterator__next, as the iterator
+  // (and its paint) might have moved since.
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__END_DRAWING);
+  return op ? NULL : iconvg_error_system_failure_out_of_memory;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__begin_path(iconvg_canvas* c,
+                                              float x0,
+                                              float y0) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__BEGIN_PATH);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x0 = x0;
+  op->y0 = y0;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__end_path(iconvg_canvas* c) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__END_PATH);
+  return op ? NULL : iconvg_error_system_failure_out_of_memory;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__path_line_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__PATH_LINE_TO);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x1 = x1;
+  op->y1 = y1;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__path_quad_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__PATH_QUAD_TO);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x1 = x1;
+  op->y1 = y1;
+  op->x2 = x2;
+  op->y2 = y2;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__path_cube_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2,
+                                                float x3,
+                                                float y3) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__PATH_CUBE_TO);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x1 = x1;
+  op->y1 = y1;
+  op->x2 = x2;
+  op->y2 = y2;
+  op->x3 = x3;
+  op->y3 = y3;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_op* op = iconvg_private_op_iterator_canvas__push(
+      c, ICONVG_OP_TYPE__ON_METADATA_VIEWBOX);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->viewbox = viewbox;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_op_iterator* self = (iconvg_op_iterator*)(c->context.nonconst_ptr1);
+  iconvg_op* op = iconvg_private_op_iterator_canvas__push(
+      c, ICONVG_OP_TYPE__ON_METADATA_SUGGESTED_PALETTE);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  memcpy(&self->private_impl.suggested_palette, suggested_palette,
+         sizeof(*suggested_palette));
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_op_iterator_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_op_iterator_canvas__begin_decode,
+        &iconvg_private_op_iterator_canvas__end_decode,
+        &iconvg_private_op_iterator_canvas__begin_drawing,
+        &iconvg_private_op_iterator_canvas__end_drawing,
+        &iconvg_private_op_iterator_canvas__begin_path,
+        &iconvg_private_op_iterator_canvas__end_path,
+        &iconvg_private_op_iterator_canvas__path_line_to,
+        &iconvg_private_op_iterator_canvas__path_quad_to,
+        &iconvg_private_op_iterator_canvas__path_cube_to,
+        &iconvg_private_op_iterator_canvas__on_metadata_viewbox,
+        &iconvg_private_op_iterator_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+static iconvg_canvas  //
+iconvg_private_op_iterator__make_canvas(iconvg_op_iterator* self) {
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_op_iterator_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = self;
+  return c;
+}
+
+// iconvg_private_op_iterator__step is like iconvg_private_execute_bytecode
+// but it stops as soon as c (an iconvg_private_op_iterator_canvas) has queued
+// any ops. Ops with repeated coordinates stop after each repetition, leaving
+// the rest in private_impl.num_reps.
+static const char*  //
+iconvg_private_op_iterator__step(iconvg_op_iterator* self,
+                                 iconvg_canvas* c,
+                                 iconvg_private_decoder* d,
+                                 iconvg_paint* p) {
+  while (self->private_impl.ops_wi == 0) {
+    if (self->private_impl.num_reps > 0) {
+      self->private_impl.num_reps--;
+      bool last = self->private_impl.num_reps == 0;
+
+      switch (self->private_impl.rep_opcode >> 4) {
+        case 0:
+          if (!iconvg_private_decoder__decode_path_coordinates(
+                  d, p->coords[1], 2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_line_to(
+              c, p, p->coords[1][0], p->coords[1][1]));
+          if (last) {
+            p->coords[0][0] = p->coords[1][0];
+            p->coords[0][1] = p->coords[1][1];
+          }
+          continue;
+
+        case 1:
+          if (!iconvg_private_decoder__decode_path_coordinates(
+                  d, p->coords[1], 4)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_quad_to(
+              c, p,                              //
+              p->coords[1][0], p->coords[1][1],  //
+              p->coords[2][0], p->coords[2][1]));
+          if (last) {
+            p->coords[0][0] = p->coords[2][0];
+            p->coords[0][1] = p->coords[2][1];
+          }
+          continue;
+      }
+
+      if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[1],
+                                                           6)) {
+        return iconvg_error_bad_coordinate;
+      }
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_cube_to(
+          c, p,                              //
+          p->coords[1][0], p->coords[1][1],  //
+          p->coords[2][0], p->coords[2][1],  //
+          p->coords[3][0], p->coords[3][1]));
+      if (last) {
+        p->coords[0][0] = p->coords[3][0];
+        p->coords[0][1] = p->coords[3][1];
+      }
+      continue;
+    }
+
+    if (d->len == 0) {
+      self->private_impl.done = true;
+      return NULL;
+    }
+    ICONVG_PRIVATE_OBSERVE_OP(d->ptr);
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    switch (iconvg_private_opcode_infos[opcode].handler) {
+      case ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO:
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+        if (!iconvg_private_decoder__decode_num_reps(
+                d, opcode, &self->private_impl.num_reps)) {
+          return iconvg_error_bad_number;
+        }
+        self->private_impl.rep_opcode = opcode;
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE:
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_expand_ellipse_parallelogram(c, d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_move_to(c, d, p));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_sel_add(d, p));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__NOP:
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__JUMP:
+        ICONVG_PRIVATE_TRY(iconvg_private_expand_jump(d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RET:
+        self->private_impl.done = true;
+        return NULL;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CALL:
+        ICONVG_PRIVATE_TRY(iconvg_private_expand_call(c, d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_register_op(d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__FILL:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_fill_op(c, d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED:
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_execute_reserved_op(c, d, p, opcode));
+        continue;
+    }
+  }
+  return NULL;
+}
+
+iconvg_op_iterator  //
+iconvg_op_iterator__make(iconvg_rectangle_f32 dst_rect,
+                         const uint8_t* src_ptr,
+                         size_t src_len,
+                         const iconvg_decode_options* options) {
+  iconvg_op_iterator self;
+  memset(&self, 0, sizeof(self));
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  d.iov = NULL;
+
+  iconvg_canvas c = iconvg_private_op_iterator__make_canvas(&self);
+  self.private_impl.err_msg = iconvg_private_decode_header(
+      &c, dst_rect, &d, (iconvg_paint*)(void*)(self.private_impl.paint),
+      options);
+  self.private_impl.src_ptr = d.ptr;
+  self.private_impl.src_len = d.len;
+  return self;
+}
+
+const char*  //
+iconvg_op_iterator__next(iconvg_op_iterator* self, iconvg_op* dst_op) {
+  if (self->private_impl.ops_ri >= self->private_impl.ops_wi) {
+    self->private_impl.ops_ri = 0;
+    self->private_impl.ops_wi = 0;
+    if (!self->private_impl.err_msg && !self->private_impl.done) {
+      iconvg_private_decoder d;
+      d.ptr = self->private_impl.src_ptr;
+      d.len = self->private_impl.src_len;
+      d.iov = NULL;
+
+      iconvg_canvas c = iconvg_private_op_iterator__make_canvas(self);
+      self->private_impl.err_msg = iconvg_private_op_iterator__step(
+          self, &c, &d, (iconvg_paint*)(void*)(self->private_impl.paint));
+      self->private_impl.src_ptr = d.ptr;
+      self->private_impl.src_len = d.len;
+    }
+
+    if (self->private_impl.ops_wi == 0) {
+      memset(dst_op, 0, sizeof(*dst_op));
+      return self->private_impl.err_msg;
+    }
+  }
+
+  *dst_op = self->private_impl.ops[self->private_impl.ops_ri++];
+  if (dst_op->type == ICONVG_OP_TYPE__END_DRAWING) {
+    dst_op->paint =
+        (const iconvg_paint*)(const void*)(self->private_impl.paint);
+  } else if (dst_op->type == ICONVG_OP_TYPE__ON_METADATA_SUGGESTED_PALETTE) {
+    dst_op->suggested_palette = &self->private_impl.suggested_palette;
+  }
+  return NULL;
+}
+
+// ----
+
+static bool  //
+iconvg_private_decoder__skip_coordinates(iconvg_private_decoder* self,
+                                         uint64_t n) {
+  for (; n > 0; n--) {
+    if (self->len == 0) {
+      return false;
+    }
+    uint8_t v = self->ptr[0];
+    size_t num_bytes = ((v & 0x01) != 0) ? 1 : ((v & 0x02) != 0) ? 2 : 4;
+    if (self->len < num_bytes) {
+      return false;
+    } else if ((num_bytes == 4) &&
+               ((iconvg_private_peek_u32le(self->ptr) & 0x7FFFFFFF) >
+                0x7F800000)) {  // Reject NaN.
+      return false;
+    }
+    self->ptr += num_bytes;
+    self->len -= num_bytes;
+  }
+  return true;
+}
 
 static bool  //
-iconvg_private_decoder__decode_metadata_viewbox(iconvg_private_decoder* self,
-                                                iconvg_rectangle_f32* dst) {
-  float a[2][2];
-  if (iconvg_private_decoder__decode_coordinates(self, a[0], 4) &&
-      (-INFINITY < a[0][0]) &&  //
-      (a[0][0] <= a[1][0]) &&   //
-      (a[1][0] < +INFINITY) &&  //
-      (-INFINITY < a[0][1]) &&  //
-      (a[0][1] <= a[1][1]) &&   //
-      (a[1][1] < +INFINITY)) {
-    dst->min_x = a[0][0];
-    dst->min_y = a[0][1];
-    dst->max_x = a[1][0];
-    dst->max_y = a[1][1];
-    return true;
+iconvg_private_validate_absolute_segref(const uint8_t* src_ptr,
+                                        size_t src_len,
+                                        uint64_t segref) {
+  // Only Segment Type 0x00 (IconVG bytecode) can be called.
+  if ((segref & 0xFF) != 0) {
+    return false;
+  }
+
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  if ((segref >> 63) == 0) {  // Direct.
+    offset = segref >> 32;
+    length = (segref >> 8) & 0xFFFFFF;
+    if (offset == 0) {
+      return false;
+    }
+  } else {  // Indirect.
+    uint64_t o = (segref >> 8) & 0x7FFFFFFFFFFFFF;
+    if ((o > src_len) || (16 > (src_len - o))) {
+      return false;
+    }
+    length = iconvg_private_peek_u64le(src_ptr + o);
+    offset = iconvg_private_peek_u64le(src_ptr + o + 8);
+  }
+  return (offset <= src_len) && (length <= (src_len - offset));
+}
+
+static void  //
+iconvg_private_lod_thresholds__add(iconvg_private_lod_thresholds* self,
+                                   float f) {
+  if ((iconvg_private_reinterpret_from_f32_to_u32(f) & 0x7FFFFFFF) >=
+      0x7F800000) {  // Ignore infinities and NaN.
+    return;
+  }
+  for (uint32_t i = 0; i < self->num_values; i++) {
+    if (self->values[i] == f) {
+      return;
+    }
+  }
+  if (self->num_values < ICONVG_PRIVATE_LOD_THRESHOLDS__MAX) {
+    self->values[self->num_values++] = f;
+  } else {
+    self->overflowed = true;
+  }
+}
+
+size_t  //
+iconvg_private_lod_thresholds__breakpoints(
+    const iconvg_private_lod_thresholds* self,
+    int64_t* dst) {
+  size_t n = 0;
+  dst[n++] = INT64_MIN;
+  for (uint32_t i = 0; i < self->num_values; i++) {
+    double t = self->values[i];
+    int64_t b = 0;
+    if (t <= -9007199254740992.0) {
+      b = -9007199254740992;
+    } else if (t >= +9007199254740992.0) {
+      b = +9007199254740992;
+    } else {
+      b = (int64_t)t;
+      if (((double)b) < t) {
+        b++;
+      }
+    }
+    // Insertion sort, skipping duplicates.
+    size_t j = n;
+    while ((j > 0) && (dst[j - 1] > b)) {
+      j--;
+    }
+    if ((j > 0) && (dst[j - 1] == b)) {
+      continue;
+    }
+    memmove(dst + j + 1, dst + j, (n - j) * sizeof(int64_t));
+    dst[j] = b;
+    n++;
+  }
+  return n;
+}
+
+const char*  //
+iconvg_private_validate(iconvg_validate_report* r,
+                        const uint8_t* src_ptr,
+                        size_t src_len,
+                        iconvg_private_lod_thresholds* lods) {
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  d.iov = NULL;
+
+  if (!iconvg_private_decoder__decode_magic_identifier(&d)) {
+    return iconvg_error_bad_magic_identifier;
+  }
+  r->error_offset = (size_t)(d.ptr - src_ptr);
+  uint32_t num_metadata_chunks;
+  if (!iconvg_private_decoder__decode_natural_number(&d,
+                                                     &num_metadata_chunks)) {
+    return iconvg_error_bad_metadata;
+  }
+
+  int32_t previous_metadata_id = -1;
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    r->error_offset = (size_t)(d.ptr - src_ptr);
+    uint32_t chunk_length;
+    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
+        (chunk_length > d.len)) {
+      return iconvg_error_bad_metadata;
+    }
+    iconvg_private_decoder chunk =
+        iconvg_private_decoder__limit_u32(&d, chunk_length);
+    uint32_t metadata_id;
+    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
+      return iconvg_error_bad_metadata;
+    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
+      return iconvg_error_bad_metadata_id_order;
+    }
+
+    if (metadata_id == 8) {  // MID 8 (ViewBox).
+      iconvg_rectangle_f32 viewbox;
+      if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk, &viewbox) ||
+          (chunk.len != 0)) {
+        return iconvg_error_bad_metadata_viewbox;
+      }
+    } else if (metadata_id == 16) {  // MID 16 (Suggested Palette).
+      iconvg_palette palette;
+      if (!iconvg_private_decoder__decode_metadata_suggested_palette(
+              &chunk, &palette) ||
+          (chunk.len != 0)) {
+        return iconvg_error_bad_metadata_suggested_palette;
+      }
+    } else {
+      return iconvg_error_bad_metadata;
+    }
+
+    iconvg_private_decoder__advance_to_ptr(&d, chunk.ptr);
+    previous_metadata_id = ((int32_t)metadata_id);
+    r->num_metadata_chunks++;
+  }
+
+  // jump_end is one past the index of the last op that any jump op skips.
+  uint64_t jump_end = 0;
+
+  while (d.len > 0) {
+    r->error_offset = (size_t)(d.ptr - src_ptr);
+    uint8_t opcode = d.ptr[0];
+    d.ptr += 1;
+    d.len -= 1;
+
+    const iconvg_private_opcode_info* info =
+        &iconvg_private_opcode_infos[opcode];
+    uint32_t num_bytes = 0;
+    switch (info->handler) {
+      case ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO: {
+        uint32_t num_reps = 0;
+        if (!iconvg_private_decoder__decode_num_reps(&d, opcode, &num_reps)) {
+          return iconvg_error_bad_number;
+        } else if (!iconvg_private_decoder__skip_coordinates(
+                       &d, ((uint64_t)num_reps) * info->num_naturals)) {
+          return iconvg_error_bad_coordinate;
+        }
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO:
+        if (!iconvg_private_decoder__skip_coordinates(&d,
+                                                      info->num_naturals)) {
+          return iconvg_error_bad_coordinate;
+        }
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD:
+        num_bytes = info->num_bytes;
+        if (d.len < num_bytes) {
+          return iconvg_error_bad_number;
+        }
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__NOP:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RET:
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__JUMP: {
+        uint32_t jump_distance = 0;
+        uint32_t feature_bits = 0;
+        if (!iconvg_private_decoder__decode_natural_number(&d,
+                                                           &jump_distance) ||
+            ((opcode == 0x39) &&
+             !iconvg_private_decoder__decode_natural_number(&d,
+                                                            &feature_bits))) {
+          return iconvg_error_bad_number;
+        } else if (opcode == 0x3A) {
+          iconvg_private_decoder lod_d = d;
+          if (!iconvg_private_decoder__skip_coordinates(&d, 2)) {
+            return iconvg_error_bad_number;
+          } else if (lods) {
+            float lod[2] = {0};
+            iconvg_private_decoder__decode_coordinates(&lod_d, lod, 2);
+            iconvg_private_lod_thresholds__add(lods, lod[0]);
+            iconvg_private_lod_thresholds__add(lods, lod[1]);
+          }
+        }
+        uint64_t end = r->num_ops + 1 + ((uint64_t)jump_distance);
+        jump_end = (jump_end > end) ? jump_end : end;
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CALL: {
+        if (opcode & 1) {  // The ATM: an alpha byte and six coordinates.
+          if (d.len < 1) {
+            return iconvg_error_bad_opcode_length;
+          }
+          d.ptr += 1;
+          d.len -= 1;
+          if (!iconvg_private_decoder__skip_coordinates(&d, 6)) {
+            return iconvg_error_bad_coordinate;
+          }
+        }
+        if (d.len < 8) {
+          return iconvg_error_bad_opcode_length;
+        }
+        uint64_t segref = iconvg_private_peek_u64le(d.ptr);
+        if ((segref >> 32) == 0) {  // Inline.
+          if ((segref & 0xFF) != 0) {
+            return iconvg_error_bad_segref;
+          }
+          num_bytes = 8 + ((uint32_t)(segref >> 8));
+        } else if (!iconvg_private_validate_absolute_segref(src_ptr, src_len,
+                                                            segref)) {
+          return iconvg_error_bad_segref;
+        } else {
+          num_bytes = 8;
+        }
+        if (d.len < num_bytes) {
+          return iconvg_error_bad_opcode_length;
+        }
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER:
+        num_bytes = info->num_bytes;
+        if (d.len < num_bytes) {
+          return iconvg_error_bad_number;
+        }
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__FILL: {
+        uint32_t num_transforms = 3 * ((opcode >> 4) & 3);
+        if (info->flags & ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH) {
+          if (!iconvg_private_decoder__decode_natural_number(&d, &num_bytes)) {
+            return iconvg_error_bad_number;
+          } else if (d.len < num_bytes) {
+            return iconvg_error_bad_opcode_length;
+          }
+        } else if (num_transforms > 0) {
+          // The (num_stops > 64) check means that the stops' register window
+          // fits in the 64 registers without wrapping around onto itself.
+          if ((d.len == 0) || (((d.ptr[0] & 63) + 2) > 64)) {
+            return iconvg_error_bad_opcode_length;
+          }
+          d.ptr += 1;
+          d.len -= 1;
+          for (uint32_t i = 0; i < num_transforms; i++) {
+            if ((d.len < 4) ||
+                ((iconvg_private_peek_u32le(d.ptr) & 0x7FFFFFFF) >
+                 0x7F800000)) {  // Reject NaN.
+              return iconvg_error_bad_number;
+            }
+            d.ptr += 4;
+            d.len -= 4;
+          }
+        }
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED: {
+        if (!iconvg_private_decoder__decode_natural_number(&d, &num_bytes)) {
+          return iconvg_error_bad_number;
+        } else if (d.len < num_bytes) {
+          return iconvg_error_bad_opcode_length;
+        }
+        d.ptr += num_bytes;
+        d.len -= num_bytes;
+        num_bytes = 0;
+        if (!iconvg_private_decoder__skip_coordinates(&d,
+                                                      info->num_naturals)) {
+          return iconvg_error_bad_coordinate;
+        }
+        break;
+      }
+    }
+
+    d.ptr += num_bytes;
+    d.len -= num_bytes;
+    r->num_ops++;
+  }
+
+  if (jump_end > r->num_ops) {
+    r->error_offset = src_len;
+    return iconvg_error_bad_jump;
+  }
+  r->error_offset = src_len;
+  return NULL;
+}
+
+const char*  //
+iconvg_validate(const uint8_t* src_ptr,
+                size_t src_len,
+                iconvg_validate_report* report) {
+  iconvg_validate_report r = {0};
+  const char* err_msg = iconvg_private_validate(&r, src_ptr, src_len, NULL);
+  if (report) {
+    *report = r;
+  }
+  return err_msg;
+}
+
+// -------------------------------- #include "./display_list.c"
+
+#include <stdlib.h>
+
+// The display list cache format is documented alongside
+// iconvg_display_list_cache in the public header.
+//
+// In a verb stream, each verb byte is followed by its arguments:
+//   - BEGIN_DRAWING and END_PATH have no arguments.
+//   - BEGIN_PATH and LINE_TO have 2 f32 values, QUAD_TO has 4 and CUBE_TO
+//     has 6.
+//   - END_DRAWING has the paint type byte. A flat color is then followed by
+//     its 4-byte premultiplied color. A gradient is followed by its spread
+//     and number of stops bytes, the src space gradient transform (6 f32
+//     values) and then the stops' registers (each a u64).
+
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_DRAWING 0x01
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_DRAWING 0x02
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH 0x03
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_PATH 0x04
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO 0x05
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO 0x06
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO 0x07
+
+#define ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE 32
+#define ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE 40
+#define ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE 16
+#define ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE 16
+#define ICONVG_PRIVATE_DISPLAY_LIST__BODY_ALIGNMENT 8
+
+// ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE is the size of a body's
+// ViewBox, number of variants and flags.
+#define ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE (16 + 4 + 4)
+
+// ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE means that the body's prefix
+// is followed by a (non-default) suggested palette.
+#define ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE 0x01
+
+static const uint32_t iconvg_private_display_list__blake2s_iv[8] = {
+    0x6A09E667u, 0xBB67AE85u, 0x3C6EF372u, 0xA54FF53Au,
+    0x510E527Fu, 0x9B05688Cu, 0x1F83D9ABu, 0x5BE0CD19u,
+};
+
+static const uint8_t iconvg_private_display_list__blake2s_sigma[10][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+};
+
+static inline uint32_t  //
+iconvg_private_display_list__rotr32(uint32_t x, uint32_t n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+// iconvg_private_display_list__blake2s_compress is BLAKE2s' compression
+// function (RFC 7693 section 3.2), with t being the number of bytes so far.
+static void  //
+iconvg_private_display_list__blake2s_compress(uint32_t h[8],
+                                              const uint8_t block[64],
+                                              uint64_t t,
+                                              bool last) {
+  uint32_t m[16];
+  uint32_t v[16];
+  for (int i = 0; i < 16; i++) {
+    m[i] = iconvg_private_peek_u32le(block + (4 * i));
+  }
+  for (int i = 0; i < 8; i++) {
+    v[i] = h[i];
+    v[i + 8] = iconvg_private_display_list__blake2s_iv[i];
+  }
+  v[12] ^= (uint32_t)(t);
+  v[13] ^= (uint32_t)(t >> 32);
+  if (last) {
+    v[14] = ~v[14];
+  }
+
+  // The rounds are unrolled so that the compiler can resolve each sigma
+  // lookup at compile time.
+#define ICONVG_PRIVATE_DISPLAY_LIST__G(r, i, a, b, c, d)       \
+  v[a] = v[a] + v[b] + m[sigma[r][2 * i]];                     \
+  v[d] = iconvg_private_display_list__rotr32(v[d] ^ v[a], 16); \
+  v[c] = v[c] + v[d];                                          \
+  v[b] = iconvg_private_display_list__rotr32(v[b] ^ v[c], 12); \
+  v[a] = v[a] + v[b] + m[sigma[r][(2 * i) + 1]];               \
+  v[d] = iconvg_private_display_list__rotr32(v[d] ^ v[a], 8);  \
+  v[c] = v[c] + v[d];                                          \
+  v[b] = iconvg_private_display_list__rotr32(v[b] ^ v[c], 7)
+
+#define ICONVG_PRIVATE_DISPLAY_LIST__ROUND(r)         \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 0, 0, 4, 8, 12);  \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 1, 1, 5, 9, 13);  \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 2, 2, 6, 10, 14); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 3, 3, 7, 11, 15); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 4, 0, 5, 10, 15); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 5, 1, 6, 11, 12); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 6, 2, 7, 8, 13);  \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 7, 3, 4, 9, 14)
+
+  const uint8_t(*sigma)[16] = iconvg_private_display_list__blake2s_sigma;
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(0);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(1);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(2);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(3);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(4);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(5);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(6);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(7);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(8);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(9);
+
+#undef ICONVG_PRIVATE_DISPLAY_LIST__ROUND
+#undef ICONVG_PRIVATE_DISPLAY_LIST__G
+
+  for (int i = 0; i < 8; i++) {
+    h[i] ^= v[i] ^ v[i + 8];
+  }
+}
+
+// iconvg_private_display_list__digest sets dst to the unkeyed 128-bit
+// BLAKE2s digest of p[.. n]. The cache is keyed by this digest, not by a
+// fast non-cryptographic hash, so that a crafted IconVG file can't collide
+// with (and so replay as) another one.
+static void  //
+iconvg_private_display_list__digest(
+    uint8_t dst[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE],
+    const uint8_t* p,
+    size_t n) {
+  uint32_t h[8];
+  memcpy(h, iconvg_private_display_list__blake2s_iv, sizeof(h));
+  h[0] ^= 0x01010000u ^ ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE;
+  uint64_t t = 0;
+  for (; n > 64; n -= 64, p += 64) {
+    t += 64;
+    iconvg_private_display_list__blake2s_compress(h, p, t, false);
+  }
+  uint8_t tail[64] = {0};
+  if (n > 0) {
+    memcpy(tail, p, n);
+  }
+  iconvg_private_display_list__blake2s_compress(h, tail, t + n, true);
+  for (int i = 0; i < (ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE / 4); i++) {
+    iconvg_private_poke_u32le(dst + (4 * i), h[i]);
+  }
+}
+
+static uint64_t  //
+iconvg_private_display_list__palette_key(
+    const iconvg_decode_options* options) {
+  if (!options || !options->palette) {
+    return 0;
+  }
+  uint8_t digest[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE];
+  iconvg_private_display_list__digest(
+      digest, &options->palette->colors[0].rgba[0], sizeof(iconvg_palette));
+  return 1 | iconvg_private_peek_u64le(digest);
+}
+
+static inline float  //
+iconvg_private_display_list__peek_f32(const uint8_t* p, int i) {
+  return iconvg_private_reinterpret_from_u32_to_f32(
+      iconvg_private_peek_u32le(p + (4 * i)));
+}
+
+// ----
+
+// iconvg_private_display_list_buffer is a growable byte buffer, backed by
+// allocator (which may be NULL). Once an allocation fails, oom is set and
+// further appends are no-ops.
+typedef struct iconvg_private_display_list_buffer_struct {
+  uint8_t* ptr;
+  size_t len;
+  size_t cap;
+  bool oom;
+  iconvg_allocator* allocator;
+} iconvg_private_display_list_buffer;
+
+static bool  //
+iconvg_private_display_list_buffer__append(
+    iconvg_private_display_list_buffer* b,
+    const uint8_t* p,
+    size_t n) {
+  if (b->oom) {
+    return false;
+  } else if (n > (b->cap - b->len)) {
+    size_t new_cap = b->cap ? b->cap : 4096;
+    while (n > (new_cap - b->len)) {
+      if (new_cap > (SIZE_MAX / 2)) {
+        b->oom = true;
+        return false;
+      }
+      new_cap *= 2;
+    }
+    uint8_t* new_ptr = iconvg_private_allocator__realloc(b->allocator, b->ptr,
+                                                         b->cap, new_cap);
+    if (!new_ptr) {
+      b->oom = true;
+      return false;
+    }
+    b->ptr = new_ptr;
+    b->cap = new_cap;
+  }
+  if (n > 0) {
+    memcpy(b->ptr + b->len, p, n);
+    b->len += n;
+  }
+  return true;
+}
+
+static bool  //
+iconvg_private_display_list_buffer__append_u8(
+    iconvg_private_display_list_buffer* b,
+    uint8_t x) {
+  return iconvg_private_display_list_buffer__append(b, &x, 1);
+}
+
+static bool  //
+iconvg_private_display_list_buffer__append_f32s(
+    iconvg_private_display_list_buffer* b,
+    const float* f,
+    int n) {
+  uint8_t x[4 * 6];
+  for (int i = 0; i < n; i++) {
+    iconvg_private_poke_u32le(x + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f[i]));
+  }
+  return iconvg_private_display_list_buffer__append(b, x, 4 * (size_t)n);
+}
+
+// ----
+
+// The recording canvas appends a verb stream to its buffer, given decoding
+// with the dst_rect set to the ViewBox, so that dst coordinates are src
+// coordinates.
+
+typedef struct iconvg_private_display_list_recorder_struct {
+  iconvg_private_display_list_buffer* stream;
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+} iconvg_private_display_list_recorder;
+
+static inline const char*  //
+iconvg_private_display_list_recorder__verb(iconvg_canvas* c,
+                                           uint8_t verb,
+                                           const float* f,
+                                           int n) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  if (!iconvg_private_display_list_buffer__append_u8(r->stream, verb) ||
+      !iconvg_private_display_list_buffer__append_f32s(r->stream, f, n)) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__begin_decode(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 dst_rect) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__end_decode(iconvg_canvas* c,
+                                                 const char* err_msg,
+                                                 size_t num_bytes_consumed,
+                                                 size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__begin_drawing(iconvg_canvas* c) {
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_DRAWING, NULL, 0);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__end_drawing(iconvg_canvas* c,
+                                                  const iconvg_paint* p) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  iconvg_private_display_list_buffer* b = r->stream;
+  iconvg_paint_type paint_type = iconvg_paint__type(p);
+  iconvg_private_display_list_buffer__append_u8(
+      b, ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_DRAWING);
+  iconvg_private_display_list_buffer__append_u8(b, (uint8_t)paint_type);
+  switch (paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+      iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+      iconvg_private_display_list_buffer__append(b, &k.rgba[0], 4);
+      break;
+    }
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
+      iconvg_private_display_list_buffer__append_u8(b, p->spread);
+      iconvg_private_display_list_buffer__append_u8(b, p->num_stops);
+      iconvg_private_display_list_buffer__append_f32s(b, p->transform, 6);
+      for (uint32_t i = 0; i < p->num_stops; i++) {
+        uint8_t x[8];
+        iconvg_private_poke_u64le(x, p->regs[(p->which_regs + i) & 63]);
+        iconvg_private_display_list_buffer__append(b, x, 8);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return b->oom ? iconvg_error_system_failure_out_of_memory : NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__begin_path(iconvg_canvas* c,
+                                                 float x0,
+                                                 float y0) {
+  float f[2] = {x0, y0};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH, f, 2);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__end_path(iconvg_canvas* c) {
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_PATH, NULL, 0);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__path_line_to(iconvg_canvas* c,
+                                                   float x1,
+                                                   float y1) {
+  float f[2] = {x1, y1};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO, f, 2);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__path_quad_to(iconvg_canvas* c,
+                                                   float x1,
+                                                   float y1,
+                                                   float x2,
+                                                   float y2) {
+  float f[4] = {x1, y1, x2, y2};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO, f, 4);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__path_cube_to(iconvg_canvas* c,
+                                                   float x1,
+                                                   float y1,
+                                                   float x2,
+                                                   float y2,
+                                                   float x3,
+                                                   float y3) {
+  float f[6] = {x1, y1, x2, y2, x3, y3};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO, f, 6);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  r->viewbox = viewbox;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  memcpy(&r->suggested_palette, suggested_palette, sizeof(iconvg_palette));
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_display_list_recorder_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_display_list_recorder__begin_decode,
+        &iconvg_private_display_list_recorder__end_decode,
+        &iconvg_private_display_list_recorder__begin_drawing,
+        &iconvg_private_display_list_recorder__end_drawing,
+        &iconvg_private_display_list_recorder__begin_path,
+        &iconvg_private_display_list_recorder__end_path,
+        &iconvg_private_display_list_recorder__path_line_to,
+        &iconvg_private_display_list_recorder__path_quad_to,
+        &iconvg_private_display_list_recorder__path_cube_to,
+        &iconvg_private_display_list_recorder__on_metadata_viewbox,
+        &iconvg_private_display_list_recorder__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+// ----
+
+typedef struct iconvg_private_display_list_entry_struct {
+  uint8_t src_digest[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE];
+  uint64_t src_len;
+  uint64_t body_offset;
+  uint64_t body_len;
+  size_t src_index;
+} iconvg_private_display_list_entry;
+
+static int  //
+iconvg_private_display_list_entry__compare(const void* a, const void* b) {
+  const iconvg_private_display_list_entry* x =
+      (const iconvg_private_display_list_entry*)a;
+  const iconvg_private_display_list_entry* y =
+      (const iconvg_private_display_list_entry*)b;
+  int c = memcmp(x->src_digest, y->src_digest,
+                 ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+  if (c != 0) {
+    return c;
+  } else if (x->src_len != y->src_len) {
+    return (x->src_len < y->src_len) ? -1 : +1;
+  } else if (x->src_index != y->src_index) {
+    return (x->src_index < y->src_index) ? -1 : +1;
   }
-  return false;
+  return 0;
 }
 
+// iconvg_private_display_list__record appends src_ptr[.. src_len]'s body to
+// bodies. It returns false if the source was left out (or on out of memory,
+// which also sets bodies->oom).
 static bool  //
-iconvg_private_decoder__decode_metadata_suggested_palette(
-    iconvg_private_decoder* self,
-    iconvg_palette* dst) {
-  if ((self->len == 0) || (self->ptr[0] >= 0x40)) {
+iconvg_private_display_list__record(iconvg_private_display_list_buffer* bodies,
+                                    iconvg_private_display_list_buffer* streams,
+                                    const uint8_t* src_ptr,
+                                    size_t src_len,
+                                    const iconvg_decode_options* options) {
+  iconvg_validate_report report = {0};
+  iconvg_private_lod_thresholds lods;
+  lods.num_values = 0;
+  lods.overflowed = false;
+  if (iconvg_private_validate(&report, src_ptr, src_len, &lods) ||
+      lods.overflowed) {
+    return false;
+  }
+  iconvg_rectangle_f32 viewbox;
+  if (iconvg_decode_viewbox(&viewbox, src_ptr, src_len)) {
     return false;
   }
-  size_t n = 1 + self->ptr[0];
-  self->ptr += 1;
-  self->len -= 1;
 
-  if (self->len != (n * 4)) {
+  int64_t breakpoints[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t num_breakpoints =
+      iconvg_private_lod_thresholds__breakpoints(&lods, breakpoints);
+
+  iconvg_private_display_list_recorder r;
+  memset(&r, 0, sizeof(r));
+  r.stream = streams;
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_display_list_recorder_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = &r;
+
+  iconvg_decode_options opts = {0};
+  opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+  opts.palette = options ? options->palette : NULL;
+
+  // Decode once per variant, dropping variants that are identical to their
+  // predecessor.
+  int64_t min_heights[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t offsets[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS + 1];
+  size_t num_variants = 0;
+  streams->len = 0;
+  offsets[0] = 0;
+  for (size_t i = 0; i < num_breakpoints; i++) {
+    opts.height_in_pixels = iconvg_optional_i64__make_some(breakpoints[i]);
+    if (iconvg_decode(&c, viewbox, src_ptr, src_len, &opts)) {
+      if (streams->oom) {
+        bodies->oom = true;
+      }
+      return false;
+    }
+    size_t prev = offsets[num_variants];
+    size_t n = streams->len - prev;
+    if ((num_variants > 0) &&
+        (n == (prev - offsets[num_variants - 1])) &&
+        !memcmp(streams->ptr + offsets[num_variants - 1], streams->ptr + prev,
+                n)) {
+      streams->len = prev;
+      continue;
+    }
+    min_heights[num_variants++] = breakpoints[i];
+    offsets[num_variants] = streams->len;
+  }
+
+  bool has_palette = memcmp(&r.suggested_palette,
+                            &iconvg_private_default_palette,
+                            sizeof(iconvg_palette)) != 0;
+  size_t table_size =
+      ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE +
+      (has_palette ? sizeof(iconvg_palette) : 0) +
+      (num_variants * ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE);
+  if (streams->len > (0xFFFFFFFFu - table_size)) {
     return false;
   }
-  const uint8_t* ptr = self->ptr;
-  self->ptr += self->len;
-  self->len = 0;
 
-  iconvg_premul_color* c = &dst->colors[0];
-  for (; n > 0; n--) {
-    c->rgba[0] = *ptr++;
-    c->rgba[1] = *ptr++;
-    c->rgba[2] = *ptr++;
-    c->rgba[3] = *ptr++;
-    c++;
+  uint8_t prefix[ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE];
+  float f[4] = {viewbox.min_x, viewbox.min_y, viewbox.max_x, viewbox.max_y};
+  for (int i = 0; i < 4; i++) {
+    iconvg_private_poke_u32le(prefix + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f[i]));
   }
-  return true;
+  iconvg_private_poke_u32le(prefix + 16, (uint32_t)num_variants);
+  iconvg_private_poke_u32le(
+      prefix + 20,
+      has_palette ? ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE : 0);
+  iconvg_private_display_list_buffer__append(bodies, prefix, sizeof(prefix));
+  if (has_palette) {
+    iconvg_private_display_list_buffer__append(
+        bodies, &r.suggested_palette.colors[0].rgba[0], sizeof(iconvg_palette));
+  }
+  for (size_t i = 0; i < num_variants; i++) {
+    uint8_t v[ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE];
+    iconvg_private_poke_u64le(v + 0, (uint64_t)(min_heights[i]));
+    iconvg_private_poke_u32le(v + 8, (uint32_t)(table_size + offsets[i]));
+    iconvg_private_poke_u32le(v + 12, (uint32_t)(offsets[i + 1] - offsets[i]));
+    iconvg_private_display_list_buffer__append(bodies, v, sizeof(v));
+  }
+  iconvg_private_display_list_buffer__append(bodies, streams->ptr,
+                                             streams->len);
+  return !bodies->oom;
 }
 
-// ----
-
-static const char*  //
-iconvg_private_expand_call(iconvg_canvas* c,
-                           iconvg_private_decoder* d,
-                           iconvg_paint* p,
-                           uint8_t opcode) {
-  // TODO: implement call ops. For now, just jump over them.
+const char*  //
+iconvg_write_display_list_cache(FILE* f,
+                                const uint8_t* const* src_ptrs,
+                                const size_t* src_lens,
+                                size_t num_srcs,
+                                const iconvg_decode_options* options) {
+  if (!f || ((!src_ptrs || !src_lens) && (num_srcs > 0))) {
+    return iconvg_error_invalid_constructor_argument;
+  } else if (num_srcs > 0xFFFFFFFFu) {
+    num_srcs = 0xFFFFFFFFu;
+  }
 
-  // Handle the ATM (Alpha and Transform Matrix).
-  if (opcode & 1) {
-    if (d->len < 25) {
-      return iconvg_error_bad_opcode_length;
+  iconvg_allocator* allocator =
+      iconvg_private_allocator__from_options(options);
+  const size_t entries_size =
+      num_srcs * sizeof(iconvg_private_display_list_entry);
+  iconvg_private_display_list_entry* entries = NULL;
+  if (num_srcs > 0) {
+    entries = iconvg_private_allocator__alloc(allocator, entries_size);
+    if (!entries) {
+      return iconvg_error_system_failure_out_of_memory;
     }
-    d->ptr += 25;
-    d->len -= 25;
+  }
+  for (size_t i = 0; i < num_srcs; i++) {
+    iconvg_private_display_list__digest(entries[i].src_digest, src_ptrs[i],
+                                        src_lens[i]);
+    entries[i].src_len = src_lens[i];
+    entries[i].body_offset = 0;
+    entries[i].body_len = 0;
+    entries[i].src_index = i;
+  }
+  if (num_srcs > 1) {
+    qsort(entries, num_srcs, sizeof(iconvg_private_display_list_entry),
+          &iconvg_private_display_list_entry__compare);
   }
 
-  if (opcode & 2) {
-    // Absolute FileSegment.
-    if (d->len < 8) {
-      return iconvg_error_bad_opcode_length;
+  // Record the bodies in index order, compacting the entries to drop
+  // duplicates and sources that couldn't be recorded. Sources with equal keys
+  // are compared byte for byte: identical ones share one entry but, should
+  // different ones ever collide, they are all left out (and so fall back to
+  // iconvg_decode) rather than replaying one as the other.
+  iconvg_private_display_list_buffer bodies = {0};
+  iconvg_private_display_list_buffer streams = {0};
+  bodies.allocator = allocator;
+  streams.allocator = allocator;
+  size_t num_entries = 0;
+  for (size_t i = 0, j = 0; i < num_srcs; i = j) {
+    iconvg_private_display_list_entry e = entries[i];
+    const uint8_t* e_ptr = src_ptrs[e.src_index];
+    bool collides = false;
+    for (j = i + 1; j < num_srcs; j++) {
+      const iconvg_private_display_list_entry* f = &entries[j];
+      if ((f->src_len != e.src_len) ||
+          memcmp(f->src_digest, e.src_digest,
+                 ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE)) {
+        break;
+      } else if ((e.src_len > 0) &&
+                 memcmp(src_ptrs[f->src_index], e_ptr, e.src_len)) {
+        collides = true;
+      }
     }
-    d->ptr += 8;
-    d->len -= 8;
-  } else {
-    // Inline FileSegment.
-    if (d->len < 4) {
-      return iconvg_error_bad_opcode_length;
+    if (collides) {
+      continue;
     }
-    uint32_t n = 4 + (iconvg_private_peek_u32le(d->ptr) >> 8);
-    if (d->len < n) {
-      return iconvg_error_bad_opcode_length;
+    while (bodies.len % ICONVG_PRIVATE_DISPLAY_LIST__BODY_ALIGNMENT) {
+      iconvg_private_display_list_buffer__append_u8(&bodies, 0);
     }
-    d->ptr += n;
-    d->len -= n;
+    size_t body_start = bodies.len;
+    if (!iconvg_private_display_list__record(&bodies, &streams,
+                                             src_ptrs[e.src_index],
+                                             src_lens[e.src_index], options)) {
+      if (bodies.oom) {
+        break;
+      }
+      bodies.len = body_start;
+      continue;
+    }
+    e.body_offset = body_start;
+    e.body_len = bodies.len - body_start;
+    entries[num_entries++] = e;
+  }
+  iconvg_private_allocator__free(allocator, streams.ptr, streams.cap);
+  if (bodies.oom) {
+    iconvg_private_allocator__free(allocator, bodies.ptr, bodies.cap);
+    iconvg_private_allocator__free(allocator, entries, entries_size);
+    return iconvg_error_system_failure_out_of_memory;
+  }
+
+  uint64_t bodies_start =
+      ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE +
+      (((uint64_t)num_entries) * ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE);
+  uint8_t header[ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE];
+  memcpy(header, "\x8AIVGdlst", 8);
+  iconvg_private_poke_u32le(header + 8, 2);
+  iconvg_private_poke_u32le(header + 12, (uint32_t)num_entries);
+  iconvg_private_poke_u64le(header + 16,
+                            iconvg_private_display_list__palette_key(options));
+  iconvg_private_poke_u64le(header + 24, bodies_start + bodies.len);
+  fwrite(header, 1, sizeof(header), f);
+  for (size_t i = 0; i < num_entries; i++) {
+    uint8_t x[ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE];
+    memcpy(x + 0, entries[i].src_digest,
+           ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+    iconvg_private_poke_u64le(x + 16, entries[i].src_len);
+    iconvg_private_poke_u64le(x + 24, bodies_start + entries[i].body_offset);
+    iconvg_private_poke_u64le(x + 32, entries[i].body_len);
+    fwrite(x, 1, sizeof(x), f);
+  }
+  if (bodies.len > 0) {
+    fwrite(bodies.ptr, 1, bodies.len, f);
   }
 
+  iconvg_private_allocator__free(allocator, bodies.ptr, bodies.cap);
+  iconvg_private_allocator__free(allocator, entries, entries_size);
   return NULL;
 }
 
-static const char*  //
-iconvg_private_expand_ellipse_parallelogram(iconvg_canvas* c,
-                                            iconvg_private_decoder* d,
-                                            iconvg_paint* p,
-                                            uint8_t opcode) {
-  // Decode the two explicit coordinate pairs.
-  if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1], 4)) {
-    return iconvg_error_bad_coordinate;
-  }
+// ----
 
-  // The third coordinate pair is implicit.
-  p->coords[3][0] = p->coords[0][0] - p->coords[1][0] + p->coords[2][0];
-  p->coords[3][1] = p->coords[0][1] - p->coords[1][1] + p->coords[2][1];
+const char*  //
+iconvg_display_list_cache__open_bytes(iconvg_display_list_cache* self,
+                                      const uint8_t* ptr,
+                                      size_t len) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!ptr || (len < ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE) ||
+      memcmp(ptr, "\x8AIVGdlst", 8) ||
+      (iconvg_private_peek_u32le(ptr + 8) != 2) ||
+      (iconvg_private_peek_u64le(ptr + 24) != len)) {
+    return iconvg_error_bad_display_list_cache;
+  }
 
-  // Handle a Parallelogram opcode.
-  if (opcode >= 0x34) {
-    for (int i = 1; i <= 4; i++) {  // Loop 1 ..= 4, not 0 ..= 3.
-      ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
-          c,                                                       //
-          (p->coords[i & 3][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-          (p->coords[i & 3][1] * p->s2d_scale_y) + p->s2d_bias_y));
+  // Check the index up front, so that the other methods don't have to. The
+  // bodies are checked as they are replayed.
+  uint32_t num_entries = iconvg_private_peek_u32le(ptr + 12);
+  uint64_t bodies_start =
+      ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE +
+      (((uint64_t)num_entries) * ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE);
+  if (bodies_start > len) {
+    return iconvg_error_bad_display_list_cache;
+  }
+  const uint8_t* e = ptr + ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE;
+  for (uint32_t i = 0; i < num_entries;
+       i++, e += ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE) {
+    uint64_t body_offset = iconvg_private_peek_u64le(e + 24);
+    uint64_t body_length = iconvg_private_peek_u64le(e + 32);
+    if ((body_offset % ICONVG_PRIVATE_DISPLAY_LIST__BODY_ALIGNMENT) ||
+        (body_offset < bodies_start) || (body_offset > len) ||
+        (body_length > (len - body_offset))) {
+      return iconvg_error_bad_display_list_cache;
+    } else if (i > 0) {
+      const uint8_t* p = e - ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE;
+      int c = memcmp(p, e, ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+      if ((c > 0) || ((c == 0) && (iconvg_private_peek_u64le(p + 16) >=
+                                   iconvg_private_peek_u64le(e + 16)))) {
+        return iconvg_error_bad_display_list_cache;
+      }
     }
-    return NULL;
   }
 
-  // The ellipse approximation's cubic Bézier points are described at
-  // https://nigeltao.github.io/blog/2021/three-points-define-ellipse.html
-
-  double center[2];
-  center[0] = (p->coords[0][0] + p->coords[2][0]) / 2;
-  center[1] = (p->coords[0][1] + p->coords[2][1]) / 2;
-  const double k = 0.551784777779014;
-  double kr[2];
-  kr[0] = k * (p->coords[1][0] - center[0]);
-  kr[1] = k * (p->coords[1][1] - center[1]);
-  double ks[2];
-  ks[0] = k * (p->coords[2][0] - center[0]);
-  ks[1] = k * (p->coords[2][1] - center[1]);
+  self->ptr = ptr;
+  self->len = len;
+  self->num_entries = num_entries;
+  return NULL;
+}
 
-  double imps[12][2];  // A+ B- B,   B+ C- C,   C+ D- D,   D+ A- A.
-  imps[0][0] = p->coords[0][0] + kr[0];
-  imps[0][1] = p->coords[0][1] + kr[1];
-  imps[1][0] = p->coords[1][0] - ks[0];
-  imps[1][1] = p->coords[1][1] - ks[1];
-  imps[2][0] = p->coords[1][0];
-  imps[2][1] = p->coords[1][1];
-  imps[3][0] = p->coords[1][0] + ks[0];
-  imps[3][1] = p->coords[1][1] + ks[1];
-  imps[4][0] = p->coords[2][0] + kr[0];
-  imps[4][1] = p->coords[2][1] + kr[1];
-  imps[5][0] = p->coords[2][0];
-  imps[5][1] = p->coords[2][1];
-  imps[6][0] = p->coords[2][0] - kr[0];
-  imps[6][1] = p->coords[2][1] - kr[1];
-  imps[7][0] = p->coords[3][0] + ks[0];
-  imps[7][1] = p->coords[3][1] + ks[1];
-  imps[8][0] = p->coords[3][0];
-  imps[8][1] = p->coords[3][1];
-  imps[9][0] = p->coords[3][0] - ks[0];
-  imps[9][1] = p->coords[3][1] - ks[1];
-  imps[10][0] = p->coords[0][0] - kr[0];
-  imps[10][1] = p->coords[0][1] - kr[1];
-  imps[11][0] = p->coords[0][0];
-  imps[11][1] = p->coords[0][1];
+const char*  //
+iconvg_display_list_cache__open_mmap(iconvg_display_list_cache* self,
+                                     const char* path,
+                                     iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!path) {
+    return iconvg_error_invalid_constructor_argument;
+  }
 
-  for (size_t i = 0; i <= (opcode & 3); i++) {
-    ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
-        c,                                                        //
-        (imps[(3 * i) + 0][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-        (imps[(3 * i) + 0][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-        (imps[(3 * i) + 1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-        (imps[(3 * i) + 1][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-        (imps[(3 * i) + 2][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-        (imps[(3 * i) + 2][1] * p->s2d_scale_y) + p->s2d_bias_y));
-    p->coords[0][0] = imps[(3 * i) + 2][0];
-    p->coords[0][1] = imps[(3 * i) + 2][1];
+  iconvg_file file;
+  const char* err_msg = iconvg_file__open(&file, path, allocator);
+  if (err_msg) {
+    return err_msg;
   }
+  err_msg = iconvg_display_list_cache__open_bytes(self, file.ptr, file.len);
+  if (err_msg) {
+    iconvg_file__close(&file);
+    return err_msg;
+  }
+  self->file = file;
   return NULL;
 }
 
-static const char*  //
-iconvg_private_expand_jump(iconvg_private_decoder* d,
-                           iconvg_paint* p,
-                           uint8_t opcode) {
-  uint32_t jump_distance = 0;
-  if (!iconvg_private_decoder__decode_natural_number(d, &jump_distance)) {
-    return iconvg_error_bad_number;
+void  //
+iconvg_display_list_cache__close(iconvg_display_list_cache* self) {
+  if (!self) {
+    return;
   }
+  iconvg_file__close(&self->file);
+  memset(self, 0, sizeof(*self));
+}
 
-  if (opcode == 0x39) {  // Jump Feature-Bits.
-    uint32_t feature_bits = 0;
-    if (!iconvg_private_decoder__decode_natural_number(d, &feature_bits)) {
-      return iconvg_error_bad_number;
-    }
-    // This decoder doesn't support any optional features (optional in terms of
-    // the file format), so we always jump unless feature_bits is zero.
-    if (feature_bits == 0) {
-      return NULL;
-    }
-
-  } else if (opcode == 0x3A) {  // Jump Level-of-Detail.
-    float lod[2] = {0};
-    if (!iconvg_private_decoder__decode_coordinates(d, lod, 2)) {
-      return iconvg_error_bad_number;
-    }
-    double h = p->height_in_pixels;
-    if ((lod[0] <= h) && (h < lod[1])) {
-      return NULL;
+// iconvg_private_display_list_cache__find sets *body_ptr and *body_len to the
+// body for src_ptr[.. src_len], using a binary search of the index. It returns
+// false if there is no such body.
+static bool  //
+iconvg_private_display_list_cache__find(const iconvg_display_list_cache* self,
+                                        const uint8_t* src_ptr,
+                                        size_t src_len,
+                                        const iconvg_decode_options* options,
+                                        const uint8_t** body_ptr,
+                                        size_t* body_len) {
+  if (!self || !self->ptr || !src_ptr ||
+      (iconvg_private_peek_u64le(self->ptr + 16) !=
+       iconvg_private_display_list__palette_key(options))) {
+    return false;
+  }
+  uint8_t digest[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE];
+  iconvg_private_display_list__digest(digest, src_ptr, src_len);
+  uint32_t lo = 0;
+  uint32_t hi = self->num_entries;
+  const uint8_t* index = self->ptr + ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE;
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) / 2);
+    const uint8_t* e =
+        index + (((size_t)mid) * ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE);
+    int c = memcmp(digest, e, ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+    uint64_t el = iconvg_private_peek_u64le(e + 16);
+    if ((c == 0) && (src_len == el)) {
+      *body_ptr = self->ptr + iconvg_private_peek_u64le(e + 24);
+      *body_len = (size_t)(iconvg_private_peek_u64le(e + 32));
+      return true;
+    } else if ((c < 0) || ((c == 0) && (src_len < el))) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
     }
   }
+  return false;
+}
 
-  for (; jump_distance > 0; jump_distance--) {
-    if (d->len == 0) {
-      return iconvg_error_bad_jump;
-    }
-    uint8_t opcode = d->ptr[0];
-    d->ptr += 1;
-    d->len -= 1;
+bool  //
+iconvg_display_list_cache__contains(const iconvg_display_list_cache* self,
+                                    const uint8_t* src_ptr,
+                                    size_t src_len,
+                                    const iconvg_decode_options* options) {
+  const uint8_t* body_ptr = NULL;
+  size_t body_len = 0;
+  return iconvg_private_display_list_cache__find(
+      self, src_ptr, src_len, options, &body_ptr, &body_len);
+}
 
-    uint32_t num_bytes = 0;
-    uint64_t num_naturals = 0;
-    bool inline_file_segment = false;
-
-    if (opcode < 0x30) {
-      uint32_t num_reps = opcode & 15;
-      if (num_reps == 0) {
-        if (!iconvg_private_decoder__decode_natural_number(d, &num_reps)) {
-          return iconvg_error_bad_jump;
-        }
-        num_reps += 16;
-      }
-      uint64_t coordinate_pairs_per_rep = 1 + (opcode >> 4);
-      num_naturals = ((uint64_t)num_reps) * 2 * coordinate_pairs_per_rep;
-
-    } else if (opcode < 0x3C) {
-      static const uint8_t nums[16] = {
-          0x04, 0x04, 0x04, 0x04,  // Ellipse ops.
-          0x04, 0x02, 0x10, 0x00,  // Parallelogram, MoveTo, SEL += arg, NOP.
-          0x01, 0x02, 0x03, 0x00,  // Jump ops.
-          0x00, 0x00, 0x00, 0x00,  // Call ops are handled separately, below.
-      };
-      num_bytes = nums[opcode & 15] >> 4;
-      num_naturals = nums[opcode & 15] & 15;
-
-    } else if (opcode < 0x40) {
-      if (opcode & 1) {
-        num_bytes += 25;
-      }
-      if (opcode & 2) {
-        num_bytes += 8;
-      } else {
-        inline_file_segment = true;
+// iconvg_private_display_list__replay_paint reads an end_drawing verb's
+// arguments (after the verb byte) from s[.. n] into *p, keeping p's scale and
+// bias fields. It returns the number of bytes read, or zero if malformed.
+static size_t  //
+iconvg_private_display_list__replay_paint(iconvg_paint* p,
+                                          const uint8_t* s,
+                                          size_t n) {
+  if (n < 1) {
+    return 0;
+  }
+  p->paint_type = s[0];
+  p->spread = 0;
+  p->num_stops = 0;
+  p->which_regs = 0;
+  switch (p->paint_type) {
+    case ICONVG_PAINT_TYPE__INVALID:
+      return 1;
+    case ICONVG_PAINT_TYPE__FLAT_COLOR:
+      if (n < 5) {
+        return 0;
       }
+      // A valid premultiplied color resolves to itself.
+      p->regs[0] = ((uint64_t)(iconvg_private_peek_u32le(s + 1))) << 32;
+      return 5;
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      break;
+    default:
+      return 0;
+  }
 
-    } else if (opcode < 0x60) {
-      num_bytes = 4;
-
-    } else if (opcode < 0x70) {
-      num_bytes = 8;
-
-    } else if (opcode < 0x80) {
-      num_bytes = 8 * (2 + (opcode & 15));
-
-    } else if (opcode < 0x90) {
-      continue;
+  if (n < 27) {
+    return 0;
+  }
+  p->spread = s[1];
+  p->num_stops = s[2];
+  size_t m = 27 + (8 * (size_t)(p->num_stops));
+  if ((p->num_stops > 64) || (n < m)) {
+    return 0;
+  }
+  for (int i = 0; i < 6; i++) {
+    p->transform[i] = iconvg_private_display_list__peek_f32(s + 3, i);
+  }
+  for (uint32_t i = 0; i < p->num_stops; i++) {
+    p->regs[i] = iconvg_private_peek_u64le(s + 27 + (8 * i));
+  }
+  return m;
+}
 
-    } else if (opcode < 0xA0) {
-      num_bytes = 13;
+static const char*  //
+iconvg_private_display_list__replay(iconvg_canvas* c,
+                                    iconvg_rectangle_f32 dst_rect,
+                                    const uint8_t* body,
+                                    size_t body_len,
+                                    const iconvg_decode_options* options) {
+  if (body_len < ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE) {
+    return iconvg_error_bad_display_list_cache;
+  }
+  uint32_t num_variants = iconvg_private_peek_u32le(body + 16);
+  uint32_t flags = iconvg_private_peek_u32le(body + 20);
+  const uint8_t* v = body + ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE;
+  size_t n = body_len - ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE;
+
+  // The iconvg_palette type is a byte array, so that it can alias the body.
+  const iconvg_palette* suggested_palette = &iconvg_private_default_palette;
+  if (flags & ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE) {
+    if (n < sizeof(iconvg_palette)) {
+      return iconvg_error_bad_display_list_cache;
+    }
+    suggested_palette = (const iconvg_palette*)v;
+    v += sizeof(iconvg_palette);
+    n -= sizeof(iconvg_palette);
+  }
+  if ((num_variants == 0) ||
+      (num_variants > (n / ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE))) {
+    return iconvg_error_bad_display_list_cache;
+  }
 
-    } else if (opcode < 0xB0) {
-      num_bytes = 25;
+  iconvg_paint p;
+  memset(&p, 0, sizeof(p));
+  p.viewbox = iconvg_rectangle_f32__make(
+      iconvg_private_display_list__peek_f32(body, 0),
+      iconvg_private_display_list__peek_f32(body, 1),
+      iconvg_private_display_list__peek_f32(body, 2),
+      iconvg_private_display_list__peek_f32(body, 3));
+  p.height_in_pixels = iconvg_private_height_in_pixels(dst_rect, options);
 
-    } else {
-      if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
-        return iconvg_error_bad_jump;
-      }
-      if ((0xC0 <= opcode) && (opcode < 0xE0)) {
-        num_naturals = 2;
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, p.viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, suggested_palette));
+  iconvg_private_initialize_remaining_paint_fields(
+      &p, dst_rect, iconvg_private_dst_transform(options));
+
+  // Pick the last variant whose minimum height is at most the height.
+  for (uint32_t i = 1; i < num_variants; i++) {
+    const uint8_t* w = v + ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE;
+    if (((int64_t)(iconvg_private_peek_u64le(w))) > p.height_in_pixels) {
+      break;
+    }
+    v = w;
+  }
+  size_t offset = iconvg_private_peek_u32le(v + 8);
+  n = iconvg_private_peek_u32le(v + 12);
+  if ((offset > body_len) || (n > (body_len - offset))) {
+    return iconvg_error_bad_display_list_cache;
+  }
+  const uint8_t* s = body + offset;
+
+  while (n > 0) {
+    uint8_t verb = s[0];
+    s += 1;
+    n -= 1;
+    float f[6];
+    int num_f32s = 0;
+    switch (verb) {
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_DRAWING:
+        ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
+        continue;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_DRAWING: {
+        size_t m = iconvg_private_display_list__replay_paint(&p, s, n);
+        if (m == 0) {
+          return iconvg_error_bad_display_list_cache;
+        }
+        s += m;
+        n -= m;
+        ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, &p));
+        continue;
       }
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_PATH:
+        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+        continue;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH:
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO:
+        num_f32s = 2;
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO:
+        num_f32s = 4;
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO:
+        num_f32s = 6;
+        break;
+      default:
+        return iconvg_error_bad_display_list_cache;
     }
 
-    if (d->len < num_bytes) {
-      return iconvg_error_bad_jump;
+    // Convert from src to dst coordinate space, the same way that the
+    // bytecode interpreter does.
+    if (n < (4 * (size_t)num_f32s)) {
+      return iconvg_error_bad_display_list_cache;
     }
-    d->ptr += num_bytes;
-    d->len -= num_bytes;
-
-    for (; num_naturals > 0; num_naturals--) {
-      uint32_t dummy;
-      if (!iconvg_private_decoder__decode_natural_number(d, &dummy)) {
-        return iconvg_error_bad_jump;
+    for (int i = 0; i < num_f32s; i += 2) {
+      float x = iconvg_private_display_list__peek_f32(s, i + 0);
+      float y = iconvg_private_display_list__peek_f32(s, i + 1);
+      if (p.skewed) {
+        f[i + 0] = (float)((x * p.s2d_scale_x) + (y * p.s2d_skew_x) +
+                           p.s2d_bias_x);
+        f[i + 1] = (float)((x * p.s2d_skew_y) + (y * p.s2d_scale_y) +
+                           p.s2d_bias_y);
+      } else {
+        f[i + 0] = (float)((x * p.s2d_scale_x) + p.s2d_bias_x);
+        f[i + 1] = (float)((y * p.s2d_scale_y) + p.s2d_bias_y);
       }
     }
-
-    if (inline_file_segment) {
-      if (d->len < 4) {
-        return iconvg_error_bad_jump;
-      }
-      uint32_t n = 4 + (iconvg_private_peek_u32le(d->ptr) >> 8);
-      if (d->len < n) {
-        return iconvg_error_bad_jump;
-      }
-      d->ptr += n;
-      d->len -= n;
+    s += 4 * (size_t)num_f32s;
+    n -= 4 * (size_t)num_f32s;
+    switch (verb) {
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH:
+        ICONVG_PRIVATE_TRY((*c->vtable->begin_path)(c, f[0], f[1]));
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(c, f[0], f[1]));
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO:
+        ICONVG_PRIVATE_TRY(
+            (*c->vtable->path_quad_to)(c, f[0], f[1], f[2], f[3]));
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO:
+        ICONVG_PRIVATE_TRY(
+            (*c->vtable->path_cube_to)(c, f[0], f[1], f[2], f[3], f[4], f[5]));
+        break;
     }
   }
-
   return NULL;
 }
 
-// ----
-
-static const char*  //
-iconvg_private_execute_bytecode(iconvg_canvas* c,
-                                iconvg_private_decoder* d,
-                                iconvg_paint* p) {
-  while (d->len > 0) {
-    uint8_t opcode = d->ptr[0];
-    d->ptr += 1;
-    d->len -= 1;
-
-    switch (opcode >> 6) {
-      case 0: {  // Path and miscellaneous ops.
-        if (opcode >= 0x36) {
-          if (opcode == 0x36) {  // SEL += arg.
-            if (d->len == 0) {
-              return iconvg_error_bad_number;
-            }
-            p->sel += d->ptr[0];
-            d->ptr += 1;
-            d->len -= 1;
-            continue;
-          } else if (opcode == 0x37) {  // NOP.
-            continue;
-          } else if (opcode < 0x3B) {  // Jump ops.
-            ICONVG_PRIVATE_TRY(iconvg_private_expand_jump(d, p, opcode));
-            continue;
-          } else if (opcode > 0x3B) {  // Call ops.
-            ICONVG_PRIVATE_TRY(iconvg_private_expand_call(c, d, p, opcode));
-            continue;
-          }
-          // RET.
-          return NULL;
-        }
-
-        if (!p->begun_drawing) {
-          p->begun_drawing = true;
-          ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
-        }
-
-        if (opcode == 0x35) {
-          if (!iconvg_private_decoder__decode_coordinates(d, p->coords[0], 2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          if (p->begun_path) {
-            ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-          } else {
-            p->begun_path = true;
-          }
-          ICONVG_PRIVATE_TRY((*c->vtable->begin_path)(
-              c,                                                   //
-              (p->coords[0][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[0][1] * p->s2d_scale_y) + p->s2d_bias_y));
-          continue;
-        }
+const char*  //
+iconvg_display_list_cache__replay(const iconvg_display_list_cache* self,
+                                  iconvg_canvas* dst_canvas,
+                                  iconvg_rectangle_f32 dst_rect,
+                                  const uint8_t* src_ptr,
+                                  size_t src_len,
+                                  const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
+      sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
 
-        if (!p->begun_path) {
-          p->begun_path = true;
-          ICONVG_PRIVATE_TRY((*c->vtable->begin_path)(
-              c,                                                   //
-              (p->coords[0][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[0][1] * p->s2d_scale_y) + p->s2d_bias_y));
-        }
+  const uint8_t* body_ptr = NULL;
+  size_t body_len = 0;
+  if (!iconvg_private_display_list_cache__find(self, src_ptr, src_len, options,
+                                               &body_ptr, &body_len)) {
+    return iconvg_decode(dst_canvas, dst_rect, src_ptr, src_len, options);
+  }
 
-        if (opcode >= 0x30) {
-          ICONVG_PRIVATE_TRY(
-              iconvg_private_expand_ellipse_parallelogram(c, d, p, opcode));
-          continue;
-        }
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_display_list__replay(dst_canvas, dst_rect,
+                                                  body_ptr, body_len, options);
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg,
+                                           err_msg ? 0 : src_len,
+                                           err_msg ? src_len : 0);
+}
 
-        uint32_t num_reps = opcode & 15;
-        if (num_reps == 0) {
-          if (!iconvg_private_decoder__decode_natural_number(d, &num_reps)) {
-            return iconvg_error_bad_number;
-          }
-          num_reps += 16;
-        }
+// -------------------------------- #include "./encoder.c"
 
-        switch (opcode >> 4) {
-          case 0:
-            for (; num_reps > 0; num_reps--) {
-              if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1],
-                                                              2)) {
-                return iconvg_error_bad_coordinate;
-              }
-              ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
-                  c,                                                   //
-                  (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-                  (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y));
-            }
-            p->coords[0][0] = p->coords[1][0];
-            p->coords[0][1] = p->coords[1][1];
-            continue;
-
-          case 1:
-            for (; num_reps > 0; num_reps--) {
-              if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1],
-                                                              4)) {
-                return iconvg_error_bad_coordinate;
-              }
-              ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to)(
-                  c,                                                   //
-                  (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-                  (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-                  (p->coords[2][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-                  (p->coords[2][1] * p->s2d_scale_y) + p->s2d_bias_y));
-            }
-            p->coords[0][0] = p->coords[2][0];
-            p->coords[0][1] = p->coords[2][1];
-            continue;
-        }
+// ICONVG_PRIVATE_ENCODER__MAX_RUN_REPS is the largest RepCount of a merged
+// LineTo, QuadTo or CubeTo op. Longer runs start a new op, so that the
+// RepCount's natural number always fits in 1 byte and extending a run never
+// moves the coordinates already written more than once.
+#define ICONVG_PRIVATE_ENCODER__MAX_RUN_REPS (16 + 127)
 
-        for (; num_reps > 0; num_reps--) {
-          if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1], 6)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
-              c,                                                   //
-              (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-              (p->coords[2][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[2][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-              (p->coords[3][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[3][1] * p->s2d_scale_y) + p->s2d_bias_y));
-        }
-        p->coords[0][0] = p->coords[3][0];
-        p->coords[0][1] = p->coords[3][1];
-        continue;
-      }
+#define ICONVG_PRIVATE_ENCODER__NO_RUN SIZE_MAX
 
-      case 1: {  // Register ops.
-        uint32_t adj = opcode & 15;
-        switch ((opcode >> 4) & 3) {
-          case 0:
-            if (d->len < 4) {
-              return iconvg_error_bad_number;
-            }
-            p->regs[(p->sel + adj) & 63] =
-                ((uint64_t)iconvg_private_peek_u32le(d->ptr));
-            d->ptr += 4;
-            d->len -= 4;
-            break;
-          case 1:
-            if (d->len < 4) {
-              return iconvg_error_bad_number;
-            }
-            p->regs[(p->sel + adj) & 63] =
-                ((uint64_t)iconvg_private_peek_u32le(d->ptr)) << 32;
-            d->ptr += 4;
-            d->len -= 4;
-            break;
-          case 2:
-            if (d->len < 8) {
-              return iconvg_error_bad_number;
-            }
-            p->regs[(p->sel + adj) & 63] = iconvg_private_peek_u64le(d->ptr);
-            d->ptr += 8;
-            d->len -= 8;
-            break;
-          default:
-            adj += 2;
-            p->sel -= adj;
-            for (uint32_t i = 1; i <= adj; i++) {
-              if (d->len < 8) {
-                return iconvg_error_bad_number;
-              }
-              p->regs[(p->sel + i) & 63] = iconvg_private_peek_u64le(d->ptr);
-              d->ptr += 8;
-              d->len -= 8;
-            }
-            continue;
-        }
-        p->sel -= (adj == 0) ? 1 : 0;
-        continue;
-      }
+// iconvg_private_encode_natural writes u's shortest encoding to dst,
+// returning its length. u must be less than (1 << 30).
+static inline size_t  //
+iconvg_private_encode_natural(uint8_t* dst, uint32_t u) {
+  if (u < (1u << 7)) {
+    dst[0] = (uint8_t)((u << 1) | 0x01);
+    return 1;
+  } else if (u < (1u << 14)) {
+    u = (u << 2) | 0x02;
+    dst[0] = (uint8_t)(u >> 0);
+    dst[1] = (uint8_t)(u >> 8);
+    return 2;
+  }
+  iconvg_private_poke_u32le(dst, u << 2);
+  return 4;
+}
 
-      case 2: {  // Fill ops.
-        uint32_t adj = opcode & 15;
-        p->sel += (adj == 0) ? 1 : 0;
-        uint32_t num_transforms = 0;
-
-        switch ((opcode >> 4) & 3) {
-          case 0:
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
-            break;
-          case 1:
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__LINEAR_GRADIENT;
-            p->transform[3] = 0.0f;
-            p->transform[4] = 0.0f;
-            p->transform[5] = 0.0f;
-            num_transforms = 3;
-            break;
-          case 2:
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__RADIAL_GRADIENT;
-            num_transforms = 6;
-            break;
-          case 3: {
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
-            uint32_t num_bytes = 0;
-            if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
-              return iconvg_error_bad_number;
-            }
-            if (d->len < num_bytes) {
-              return iconvg_error_bad_opcode_length;
-            }
-            d->ptr += num_bytes;
-            d->len -= num_bytes;
-            break;
-          }
-        }
-        p->which_regs = (uint8_t)(p->sel + adj);
+// iconvg_private_encode_coordinate writes f's shortest encoding to dst,
+// returning its length, or zero if f is NaN. It produces the same bytes as
+// the Go implementation's encodeCoordinate.
+static inline size_t  //
+iconvg_private_encode_coordinate(uint8_t* dst, float f) {
+  if ((-64.0f <= f) && (f < +64.0f)) {
+    int32_t i = (int32_t)f;
+    if ((float)i == f) {
+      dst[0] = (uint8_t)((((uint32_t)(i + 64)) << 1) | 0x01);
+      return 1;
+    }
+  }
 
-        if (num_transforms > 0) {
-          if (d->len == 0) {
-            return iconvg_error_bad_opcode_length;
-          }
-          p->num_stops = (d->ptr[0] & 63) + 2;
-          p->spread = d->ptr[0] >> 6;
-          d->ptr += 1;
-          d->len -= 1;
-          if (p->num_stops > 64) {
-            return iconvg_error_bad_opcode_length;
-          }
-          for (uint32_t i = 0; i < num_transforms; i++) {
-            if (!iconvg_private_decoder__decode_float32(d, &p->transform[i])) {
-              return iconvg_error_bad_number;
-            }
-          }
-        }
+  float g = f * 64.0f;
+  if ((-8192.0f <= g) && (g < +8192.0f)) {
+    int32_t i = (int32_t)g;
+    if ((float)i == g) {
+      uint32_t u = (((uint32_t)(i + 8192)) << 2) | 0x02;
+      dst[0] = (uint8_t)(u >> 0);
+      dst[1] = (uint8_t)(u >> 8);
+      return 2;
+    }
+  }
 
-        if (p->begun_path) {
-          p->begun_path = false;
-          ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-        }
-        if (p->begun_drawing) {
-          p->begun_drawing = false;
-          ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, p));
-        }
-        continue;
-      }
+  if (f != f) {  // Reject NaN.
+    return 0;
+  }
+  // Round the fractional bits (the low 23 bits) to the nearest multiple of 4,
+  // being careful not to overflow into the upper bits. The low 2 bits must
+  // end up zero, as they mark this as a 4-byte encoding.
+  uint32_t u = iconvg_private_reinterpret_from_f32_to_u32(f);
+  uint32_t v = u & 0x007FFFFF;
+  if (v < 0x007FFFFE) {
+    v += 2;
+  }
+  iconvg_private_poke_u32le(dst, (u & 0xFF800000) | (v & ~3u));
+  return 4;
+}
 
-      case 3: {  // Reserved ops.
-        uint32_t num_bytes = 0;
-        if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
-          return iconvg_error_bad_number;
-        }
-        if (d->len < num_bytes) {
-          return iconvg_error_bad_opcode_length;
-        }
-        d->ptr += num_bytes;
-        d->len -= num_bytes;
-        if (opcode < 0xE0) {
-          if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1], 2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
-              c,                                                   //
-              (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y));
-          p->coords[0][0] = p->coords[1][0];
-          p->coords[0][1] = p->coords[1][1];
-        }
-      }
+static size_t  //
+iconvg_private_encode_coordinates(uint8_t* dst, const float* src, size_t n) {
+  size_t m = 0;
+  for (; n > 0; n--) {
+    size_t k = iconvg_private_encode_coordinate(dst + m, *src++);
+    if (k == 0) {
+      return 0;
     }
+    m += k;
   }
-  return NULL;
+  return m;
 }
 
 // ----
 
-static void  //
-iconvg_private_initialize_remaining_paint_fields(iconvg_paint* p,
-                                                 iconvg_rectangle_f32 r) {
-  double rw = iconvg_rectangle_f32__width_f64(&r);
-  double rh = iconvg_rectangle_f32__height_f64(&r);
-  double vw = iconvg_rectangle_f32__width_f64(&p->viewbox);
-  double vh = iconvg_rectangle_f32__height_f64(&p->viewbox);
-  if ((rw > 0) && (rh > 0) && (vw > 0) && (vh > 0)) {
-    p->s2d_scale_x = rw / vw;
-    p->s2d_scale_y = rh / vh;
-    p->s2d_bias_x = r.min_x - (p->viewbox.min_x * p->s2d_scale_x);
-    p->s2d_bias_y = r.min_y - (p->viewbox.min_y * p->s2d_scale_y);
-  } else {
-    p->s2d_scale_x = 1.0;
-    p->s2d_bias_x = 0.0;
-    p->s2d_scale_y = 1.0;
-    p->s2d_bias_y = 0.0;
+static const char*  //
+iconvg_private_encoder__fail(iconvg_encoder* self, const char* err_msg) {
+  self->private_impl.err_msg = err_msg;
+  return err_msg;
+}
+
+// iconvg_private_encoder__reserve makes room for n more bytes, calling
+// grow_func if necessary.
+static const char*  //
+iconvg_private_encoder__reserve(iconvg_encoder* self, size_t n) {
+  if (n <= (self->cap - self->len)) {
+    return NULL;
+  } else if (!self->grow_func || (n > (SIZE_MAX - self->len))) {
+    return iconvg_private_encoder__fail(
+        self, iconvg_error_system_failure_out_of_memory);
+  }
+  uint8_t* ptr = self->ptr;
+  size_t cap = self->cap;
+  size_t min_cap = self->len + n;
+  const char* err_msg =
+      (*self->grow_func)(self->grow_context, &ptr, &cap, min_cap);
+  if (err_msg) {
+    return iconvg_private_encoder__fail(self, err_msg);
+  } else if (!ptr || (cap < min_cap)) {
+    return iconvg_private_encoder__fail(
+        self, iconvg_error_system_failure_out_of_memory);
   }
+  self->ptr = ptr;
+  self->cap = cap;
+  return NULL;
+}
 
-  p->d2s_scale_x = 1.0 / p->s2d_scale_x;
-  p->d2s_bias_x = -p->s2d_bias_x * p->d2s_scale_x;
-  p->d2s_scale_y = 1.0 / p->s2d_scale_y;
-  p->d2s_bias_y = -p->s2d_bias_y * p->d2s_scale_y;
+// iconvg_private_encoder__write_bytes appends src[.. n], writing the default
+// metadata first if needed.
+static const char*  //
+iconvg_private_encoder__write_bytes(iconvg_encoder* self,
+                                    const uint8_t* src,
+                                    size_t n) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  }
+  size_t header = self->private_impl.wrote_metadata ? 0 : 5;
+  ICONVG_PRIVATE_TRY(iconvg_private_encoder__reserve(self, header + n));
+  uint8_t* p = self->ptr + self->len;
+  if (header) {
+    // The magic identifier and zero metadata chunks.
+    memcpy(p, "\x8A\x49\x56\x47\x01", 5);
+    p += 5;
+    self->private_impl.wrote_metadata = true;
+  }
+  if (n) {
+    memcpy(p, src, n);
+  }
+  self->len += header + n;
+  return NULL;
+}
 
-  p->sel = 56;
-  p->begun_drawing = false;
-  p->begun_path = false;
+// iconvg_private_encoder__write_op appends an op other than a LineTo, QuadTo
+// or CubeTo op, ending any run of those.
+static const char*  //
+iconvg_private_encoder__write_op(iconvg_encoder* self,
+                                 const uint8_t* src,
+                                 size_t n) {
+  ICONVG_PRIVATE_TRY(iconvg_private_encoder__write_bytes(self, src, n));
+  self->private_impl.run_offset = ICONVG_PRIVATE_ENCODER__NO_RUN;
+  return NULL;
+}
 
-  p->paint_type = 0;
-  p->num_stops = 0;
-  p->spread = 0;
-  p->which_regs = 0;
+// iconvg_private_encoder__write_segment appends a LineTo (opcode 0x00),
+// QuadTo (0x10) or CubeTo (0x20) segment, merging it into the previous op if
+// that was of the same kind.
+static const char*  //
+iconvg_private_encoder__write_segment(iconvg_encoder* self,
+                                      uint8_t opcode,
+                                      const float* coords,
+                                      size_t num_coords) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  }
+  uint8_t buf[1 + (6 * 4)];
+  size_t n = iconvg_private_encode_coordinates(buf + 1, coords, num_coords);
+  if (n == 0) {
+    return iconvg_private_encoder__fail(self, iconvg_error_bad_coordinate);
+  }
 
-  p->coords[0][0] = 0.0f;
-  p->coords[0][1] = 0.0f;
-  p->coords[1][0] = 0.0f;
-  p->coords[1][1] = 0.0f;
-  p->coords[2][0] = 0.0f;
-  p->coords[2][1] = 0.0f;
-  p->coords[3][0] = 0.0f;
-  p->coords[3][1] = 0.0f;
+  size_t run_offset = self->private_impl.run_offset;
+  uint32_t reps = self->private_impl.run_reps + 1;
+  if ((run_offset == ICONVG_PRIVATE_ENCODER__NO_RUN) ||
+      (self->private_impl.run_opcode != opcode) ||
+      (reps > ICONVG_PRIVATE_ENCODER__MAX_RUN_REPS)) {
+    buf[0] = opcode | 1;
+    ICONVG_PRIVATE_TRY(iconvg_private_encoder__write_bytes(self, buf, 1 + n));
+    self->private_impl.run_offset = self->len - (1 + n);
+    self->private_impl.run_reps = 1;
+    self->private_impl.run_opcode = opcode;
+    return NULL;
+  }
 
-  for (int i = 0; i < 64; i++) {
-    uint32_t u =
-        iconvg_private_peek_u32le(&p->custom_palette.colors[i].rgba[0]);
-    p->regs[i] = ((uint64_t)u) << 32;
+  // Extend the run. Going from 15 to 16 reps switches the op to the form
+  // where the RepCount is a natural number after the opcode byte.
+  ICONVG_PRIVATE_TRY(iconvg_private_encoder__reserve(self, 1 + n));
+  uint8_t* op = self->ptr + run_offset;
+  if (reps < 16) {
+    op[0] = opcode | (uint8_t)reps;
+  } else if (reps == 16) {
+    memmove(op + 2, op + 1, self->len - (run_offset + 1));
+    op[0] = opcode;
+    op[1] = 0x01;
+    self->len++;
+  } else {
+    op[1] = (uint8_t)(((reps - 16) << 1) | 0x01);
   }
+  memcpy(self->ptr + self->len, buf + 1, n);
+  self->len += n;
+  self->private_impl.run_reps = reps;
+  return NULL;
 }
 
-// ----
-
-const char*  //
-iconvg_decode_viewbox(iconvg_rectangle_f32* dst_viewbox,
-                      const uint8_t* src_ptr,
-                      size_t src_len) {
-  iconvg_private_decoder d;
-  d.ptr = src_ptr;
-  d.len = src_len;
-
-  if (!iconvg_private_decoder__decode_magic_identifier(&d)) {
-    return iconvg_error_bad_magic_identifier;
+static const char*  //
+iconvg_private_encoder__write_gradient(
+    iconvg_encoder* self,
+    uint8_t opcode,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if ((adj > 15) || (num_stops < 2) || (num_stops > 64) ||
+             (((uint32_t)spread) > 3) || !nominal_matrix) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
   }
-  uint32_t num_metadata_chunks;
-  if (!iconvg_private_decoder__decode_natural_number(&d,
-                                                     &num_metadata_chunks)) {
-    return iconvg_error_bad_metadata;
+  size_t num_floats = (opcode == 0x90) ? 3 : 6;
+  uint8_t buf[2 + (6 * 4)];
+  buf[0] = opcode | (uint8_t)adj;
+  buf[1] = (uint8_t)((num_stops - 2) | (((uint32_t)spread) << 6));
+  for (size_t i = 0; i < num_floats; i++) {
+    float f = (float)(nominal_matrix->elems[i / 3][i % 3]);
+    if (f != f) {  // Reject NaN.
+      return iconvg_private_encoder__fail(self, iconvg_error_bad_number);
+    }
+    iconvg_private_poke_u32le(buf + 2 + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f));
   }
+  return iconvg_private_encoder__write_op(self, buf, 2 + (4 * num_floats));
+}
 
-  bool use_default_viewbox = true;
-  int32_t previous_metadata_id = -1;
-  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
-    uint32_t chunk_length;
-    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
-        (chunk_length > d.len)) {
-      return iconvg_error_bad_metadata;
-    }
-    iconvg_private_decoder chunk =
-        iconvg_private_decoder__limit_u32(&d, chunk_length);
-    uint32_t metadata_id;
-    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
-      return iconvg_error_bad_metadata;
-    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
-      return iconvg_error_bad_metadata_id_order;
-    }
+// iconvg_private_encoder__register_op writes REGS[SEL + adj]'s op to dst,
+// returning its length.
+static size_t  //
+iconvg_private_encoder__register_op(uint8_t* dst,
+                                    uint32_t adj,
+                                    uint64_t value) {
+  uint32_t lo = (uint32_t)(value >> 0);
+  uint32_t hi = (uint32_t)(value >> 32);
+  if (hi == 0) {
+    dst[0] = 0x40 | (uint8_t)adj;
+    iconvg_private_poke_u32le(dst + 1, lo);
+    return 5;
+  } else if (lo == 0) {
+    dst[0] = 0x50 | (uint8_t)adj;
+    iconvg_private_poke_u32le(dst + 1, hi);
+    return 5;
+  }
+  dst[0] = 0x60 | (uint8_t)adj;
+  iconvg_private_poke_u64le(dst + 1, value);
+  return 9;
+}
 
-    if (metadata_id == 8) {  // MID 8 (ViewBox).
-      use_default_viewbox = false;
-      iconvg_rectangle_f32 r;
-      if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk, &r) ||
-          (chunk.len != 0)) {
-        return iconvg_error_bad_metadata_viewbox;
-      } else if (dst_viewbox) {
-        *dst_viewbox = r;
-      }
-      return NULL;
-    } else if (metadata_id > 8) {
-      // MIDs should appear in increasing order.
-      break;
-    }
+// ----
 
-    iconvg_private_decoder__skip_to_the_end(&chunk);
-    iconvg_private_decoder__advance_to_ptr(&d, chunk.ptr);
-    previous_metadata_id = ((int32_t)metadata_id);
+const char*  //
+iconvg_encoder__initialize(iconvg_encoder* self,
+                           uint8_t* ptr,
+                           size_t cap,
+                           const char* (*grow_func)(void* grow_context,
+                                                    uint8_t** ptr,
+                                                    size_t* cap,
+                                                    size_t min_cap),
+                           void* grow_context) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
   }
-
-  if (use_default_viewbox && dst_viewbox) {
-    *dst_viewbox = iconvg_private_default_viewbox();
+  memset(self, 0, sizeof(*self));
+  self->private_impl.run_offset = ICONVG_PRIVATE_ENCODER__NO_RUN;
+  if (!ptr && cap) {
+    return iconvg_private_encoder__fail(
+        self, iconvg_error_invalid_constructor_argument);
   }
+  self->ptr = ptr;
+  self->cap = cap;
+  self->grow_func = grow_func;
+  self->grow_context = grow_context;
   return NULL;
 }
 
-static const char*  //
-iconvg_private_decode(iconvg_canvas* c,
-                      iconvg_rectangle_f32 r,
-                      iconvg_private_decoder* d,
-                      const iconvg_decode_options* options) {
-  iconvg_paint p;
-  p.viewbox = iconvg_private_default_viewbox();
-  if (options && options->height_in_pixels.has_value) {
-    p.height_in_pixels = options->height_in_pixels.value;
-  } else {
-    double h = iconvg_rectangle_f32__height_f64(&r);
-    // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
-    // than MAX_INT32 and also ensures that conversion between integer and
-    // float or double is lossless.
-    if (h <= 0x100000) {
-      p.height_in_pixels = (int64_t)h;
-    } else {
-      p.height_in_pixels = 0x100000;
+const char*  //
+iconvg_encoder__write_metadata(iconvg_encoder* self,
+                               const iconvg_rectangle_f32* viewbox,
+                               const iconvg_palette* suggested_palette) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if (self->private_impl.wrote_metadata) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  }
+
+  // The magic identifier (4 bytes), the number of chunks (1 byte), the
+  // ViewBox chunk (18 bytes) and the Suggested Palette chunk (260 bytes).
+  uint8_t buf[4 + 1 + (2 + (4 * 4)) + (2 + 2 + (64 * 4))];
+  memcpy(buf, "\x8A\x49\x56\x47", 4);
+  size_t n = 5;
+  uint8_t num_chunks = 0;
+
+  if (viewbox &&
+      ((viewbox->min_x != -32) || (viewbox->min_y != -32) ||
+       (viewbox->max_x != +32) || (viewbox->max_y != +32))) {
+    if (!((-INFINITY < viewbox->min_x) &&         //
+          (viewbox->min_x <= viewbox->max_x) &&  //
+          (viewbox->max_x < +INFINITY) &&        //
+          (-INFINITY < viewbox->min_y) &&        //
+          (viewbox->min_y <= viewbox->max_y) &&  //
+          (viewbox->max_y < +INFINITY))) {
+      return iconvg_private_encoder__fail(self,
+                                          iconvg_error_bad_metadata_viewbox);
     }
+    float coords[4] = {viewbox->min_x, viewbox->min_y, viewbox->max_x,
+                       viewbox->max_y};
+    size_t m = iconvg_private_encode_coordinates(buf + n + 2, coords, 4);
+    buf[n + 0] = (uint8_t)(((1 + m) << 1) | 0x01);
+    buf[n + 1] = 0x11;  // MID 8.
+    n += 2 + m;
+    num_chunks++;
   }
-  memcpy(&p.custom_palette, &iconvg_private_default_palette,
-         sizeof(p.custom_palette));
 
-  if (!iconvg_private_decoder__decode_magic_identifier(d)) {
-    return iconvg_error_bad_magic_identifier;
+  int last = suggested_palette
+                 ? iconvg_private_last_color_that_isnt_opaque_black(
+                       suggested_palette)
+                 : -1;
+  if (last >= 0) {
+    size_t m = 4 * (1 + (size_t)last);
+    n += iconvg_private_encode_natural(buf + n, (uint32_t)(2 + m));
+    buf[n + 0] = 0x21;  // MID 16.
+    buf[n + 1] = (uint8_t)last;
+    n += 2;
+    for (int i = 0; i <= last; i++) {
+      const uint8_t* rgba = &suggested_palette->colors[i].rgba[0];
+      if ((rgba[0] > rgba[3]) || (rgba[1] > rgba[3]) || (rgba[2] > rgba[3])) {
+        return iconvg_private_encoder__fail(
+            self, iconvg_error_bad_metadata_suggested_palette);
+      }
+      memcpy(buf + n, rgba, 4);
+      n += 4;
+    }
+    num_chunks++;
   }
-  uint32_t num_metadata_chunks;
-  if (!iconvg_private_decoder__decode_natural_number(d, &num_metadata_chunks)) {
-    return iconvg_error_bad_metadata;
+
+  buf[4] = (uint8_t)((num_chunks << 1) | 0x01);
+  self->private_impl.wrote_metadata = true;
+  const char* err_msg = iconvg_private_encoder__write_op(self, buf, n);
+  if (err_msg) {
+    self->private_impl.wrote_metadata = false;
   }
+  return err_msg;
+}
 
-  int32_t previous_metadata_id = -1;
-  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
-    uint32_t chunk_length;
-    if (!iconvg_private_decoder__decode_natural_number(d, &chunk_length) ||
-        (chunk_length > d->len)) {
-      return iconvg_error_bad_metadata;
-    }
-    iconvg_private_decoder chunk =
-        iconvg_private_decoder__limit_u32(d, chunk_length);
-    uint32_t metadata_id;
-    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
-      return iconvg_error_bad_metadata;
-    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
-      return iconvg_error_bad_metadata_id_order;
-    }
+const char*  //
+iconvg_encoder__move_to(iconvg_encoder* self, float x, float y) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  }
+  float coords[2] = {x, y};
+  uint8_t buf[1 + (2 * 4)];
+  buf[0] = 0x35;
+  size_t n = iconvg_private_encode_coordinates(buf + 1, coords, 2);
+  if (n == 0) {
+    return iconvg_private_encoder__fail(self, iconvg_error_bad_coordinate);
+  }
+  return iconvg_private_encoder__write_op(self, buf, 1 + n);
+}
 
-    switch (metadata_id) {
-      case 8:  // MID 8 (ViewBox).
-        if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk,
-                                                             &p.viewbox) ||
-            (chunk.len != 0)) {
-          return iconvg_error_bad_metadata_viewbox;
-        }
-        break;
+const char*  //
+iconvg_encoder__line_to(iconvg_encoder* self, float x, float y) {
+  float coords[2] = {x, y};
+  return iconvg_private_encoder__write_segment(self, 0x00, coords, 2);
+}
 
-      case 16:  // MID 16 (Suggested Palette).
-        if (!iconvg_private_decoder__decode_metadata_suggested_palette(
-                &chunk, &p.custom_palette) ||
-            (chunk.len != 0)) {
-          return iconvg_error_bad_metadata_suggested_palette;
-        }
-        break;
+const char*  //
+iconvg_encoder__quad_to(iconvg_encoder* self,
+                        float x1,
+                        float y1,
+                        float x2,
+                        float y2) {
+  float coords[4] = {x1, y1, x2, y2};
+  return iconvg_private_encoder__write_segment(self, 0x10, coords, 4);
+}
 
-      default:
-        return iconvg_error_bad_metadata;
-    }
+const char*  //
+iconvg_encoder__cube_to(iconvg_encoder* self,
+                        float x1,
+                        float y1,
+                        float x2,
+                        float y2,
+                        float x3,
+                        float y3) {
+  float coords[6] = {x1, y1, x2, y2, x3, y3};
+  return iconvg_private_encoder__write_segment(self, 0x20, coords, 6);
+}
 
-    iconvg_private_decoder__skip_to_the_end(&chunk);
-    iconvg_private_decoder__advance_to_ptr(d, chunk.ptr);
-    previous_metadata_id = ((int32_t)metadata_id);
+static const char*  //
+iconvg_private_encoder__write_parallelogram_op(iconvg_encoder* self,
+                                               uint8_t opcode,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
   }
+  float coords[4] = {x1, y1, x2, y2};
+  uint8_t buf[1 + (4 * 4)];
+  buf[0] = opcode;
+  size_t n = iconvg_private_encode_coordinates(buf + 1, coords, 4);
+  if (n == 0) {
+    return iconvg_private_encoder__fail(self, iconvg_error_bad_coordinate);
+  }
+  return iconvg_private_encoder__write_op(self, buf, 1 + n);
+}
 
-  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, p.viewbox));
-  ICONVG_PRIVATE_TRY(
-      (*c->vtable->on_metadata_suggested_palette)(c, &p.custom_palette));
-
-  if (options && options->palette) {
-    memcpy(&p.custom_palette, options->palette, sizeof(p.custom_palette));
+const char*  //
+iconvg_encoder__ellipse(iconvg_encoder* self,
+                        uint32_t num_quarters,
+                        float x1,
+                        float y1,
+                        float x2,
+                        float y2) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if ((num_quarters < 1) || (num_quarters > 4)) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
   }
+  return iconvg_private_encoder__write_parallelogram_op(
+      self, (uint8_t)(0x30 + (num_quarters - 1)), x1, y1, x2, y2);
+}
 
-  iconvg_private_initialize_remaining_paint_fields(&p, r);
-  return iconvg_private_execute_bytecode(c, d, &p);
+const char*  //
+iconvg_encoder__parallelogram(iconvg_encoder* self,
+                              float x1,
+                              float y1,
+                              float x2,
+                              float y2) {
+  return iconvg_private_encoder__write_parallelogram_op(self, 0x34, x1, y1,
+                                                        x2, y2);
 }
 
 const char*  //
-iconvg_decode(iconvg_canvas* dst_canvas,
-              iconvg_rectangle_f32 dst_rect,
-              const uint8_t* src_ptr,
-              size_t src_len,
-              const iconvg_decode_options* options) {
-  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
-  if (!dst_canvas || !dst_canvas->vtable) {
-    dst_canvas = &fallback_canvas;
+iconvg_encoder__set_register(iconvg_encoder* self,
+                             uint32_t adj,
+                             uint64_t value) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if (adj > 15) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
   }
+  uint8_t buf[9];
+  size_t n = iconvg_private_encoder__register_op(buf, adj, value);
+  return iconvg_private_encoder__write_op(self, buf, n);
+}
 
-  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
-      sizeof(iconvg_canvas_vtable)) {
-    // If we want to support multiple library versions (with dynamic linking),
-    // we could detect older versions here (with smaller vtable sizes) and
-    // substitute in an adapter implementation.
-    return iconvg_error_invalid_vtable;
+const char*  //
+iconvg_encoder__set_registers(iconvg_encoder* self,
+                              const uint64_t* values,
+                              size_t num_values) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if ((num_values > 64) || (!values && num_values)) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  } else if (num_values == 0) {
+    return NULL;
   }
 
-  iconvg_private_decoder d;
-  d.ptr = src_ptr;
-  d.len = src_len;
+  // Each op decrements SEL first, so write the highest registers first. A
+  // run of 1 uses a "set REGS[SEL + 0]; SEL--" op, as there is no 1-register
+  // multi-register op.
+  uint8_t buf[(4 * 1) + (64 * 8)];
+  size_t n = 0;
+  for (size_t end = num_values; end > 0;) {
+    size_t chunk = (end < 17) ? end : 17;
+    size_t start = end - chunk;
+    if (chunk == 1) {
+      n += iconvg_private_encoder__register_op(buf + n, 0, values[start]);
+    } else {
+      buf[n++] = 0x70 | (uint8_t)(chunk - 2);
+      for (size_t i = start; i < end; i++) {
+        iconvg_private_poke_u64le(buf + n, values[i]);
+        n += 8;
+      }
+    }
+    end = start;
+  }
+  return iconvg_private_encoder__write_op(self, buf, n);
+}
 
-  const char* err_msg =
-      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
-  if (!err_msg) {
-    err_msg = iconvg_private_decode(dst_canvas, dst_rect, &d, options);
+const char*  //
+iconvg_encoder__add_to_sel(iconvg_encoder* self, uint8_t delta) {
+  uint8_t buf[2] = {0x36, delta};
+  return iconvg_private_encoder__write_op(self, buf, 2);
+}
+
+const char*  //
+iconvg_encoder__fill_flat(iconvg_encoder* self, uint32_t adj) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if (adj > 15) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
   }
-  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg, src_len - d.len,
-                                           d.len);
+  uint8_t buf[1] = {0x80 | (uint8_t)adj};
+  return iconvg_private_encoder__write_op(self, buf, 1);
+}
+
+const char*  //
+iconvg_encoder__fill_flat_color(iconvg_encoder* self,
+                                iconvg_premul_color color) {
+  uint8_t buf[6] = {0x51, color.rgba[0], color.rgba[1],
+                    color.rgba[2], color.rgba[3], 0x81};
+  return iconvg_private_encoder__write_op(self, buf, 6);
+}
+
+const char*  //
+iconvg_encoder__fill_linear_gradient(
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix) {
+  return iconvg_private_encoder__write_gradient(self, 0x90, adj, num_stops,
+                                                spread, nominal_matrix);
+}
+
+const char*  //
+iconvg_encoder__fill_radial_gradient(
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix) {
+  return iconvg_private_encoder__write_gradient(self, 0xA0, adj, num_stops,
+                                                spread, nominal_matrix);
+}
+
+const char*  //
+iconvg_encoder__finish(iconvg_encoder* self) {
+  return iconvg_private_encoder__write_bytes(self, NULL, 0);
 }
 
 // -------------------------------- #include "./error.c"
 
 const char iconvg_error_bad_coordinate[] =  //
     "iconvg: bad coordinate";
+const char iconvg_error_bad_display_list_cache[] =  //
+    "iconvg: bad display list cache";
 const char iconvg_error_bad_jump[] =  //
     "iconvg: bad jump";
 const char iconvg_error_bad_magic_identifier[] =  //
@@ -2792,7 +8323,13 @@ const char iconvg_error_bad_number[] =  //
     "iconvg: bad number";
 const char iconvg_error_bad_opcode_length[] =  //
     "iconvg: bad opcode length";
+const char iconvg_error_bad_pack[] =  //
+    "iconvg: bad pack";
+const char iconvg_error_bad_segref[] =  //
+    "iconvg: bad SegRef";
 
+const char iconvg_error_system_failure_could_not_read_file[] =  //
+    "iconvg: system failure: could not read file";
 const char iconvg_error_system_failure_out_of_memory[] =  //
     "iconvg: system failure: out of memory";
 
@@ -2800,8 +8337,12 @@ const char iconvg_error_invalid_backend_not_enabled[] =  //
     "iconvg: invalid backend (not enabled)";
 const char iconvg_error_invalid_constructor_argument[] =  //
     "iconvg: invalid constructor argument";
+const char iconvg_error_invalid_encoder_call[] =  //
+    "iconvg: invalid encoder call";
 const char iconvg_error_invalid_paint_type[] =  //
     "iconvg: invalid paint type";
+const char iconvg_error_invalid_trace[] =  //
+    "iconvg: invalid trace";
 const char iconvg_error_invalid_vtable[] =  //
     "iconvg: invalid vtable";
 
@@ -2810,6 +8351,7 @@ const char iconvg_error_invalid_vtable[] =  //
 bool  //
 iconvg_error_is_file_format_error(const char* err_msg) {
   return (err_msg == iconvg_error_bad_coordinate) ||
+         (err_msg == iconvg_error_bad_display_list_cache) ||
          (err_msg == iconvg_error_bad_jump) ||
          (err_msg == iconvg_error_bad_magic_identifier) ||
          (err_msg == iconvg_error_bad_metadata) ||
@@ -2817,7 +8359,217 @@ iconvg_error_is_file_format_error(const char* err_msg) {
          (err_msg == iconvg_error_bad_metadata_suggested_palette) ||
          (err_msg == iconvg_error_bad_metadata_viewbox) ||
          (err_msg == iconvg_error_bad_number) ||
-         (err_msg == iconvg_error_bad_opcode_length);
+         (err_msg == iconvg_error_bad_opcode_length) ||
+         (err_msg == iconvg_error_bad_pack) ||
+         (err_msg == iconvg_error_bad_segref);
+}
+
+// -------------------------------- #include "./file.c"
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ICONVG_PRIVATE_FILE__HAVE_MMAP 1
+#endif
+
+// iconvg_private_file__reserve grows (*ptr)[.. *cap] so that at least one
+// byte is free after its first n bytes. On failure, it frees *ptr.
+static bool  //
+iconvg_private_file__reserve(uint8_t** ptr,
+                             size_t* cap,
+                             size_t n,
+                             iconvg_allocator* allocator) {
+  if (n < *cap) {
+    return true;
+  }
+  size_t new_cap = *cap ? (2 * *cap) : 65536;
+  uint8_t* new_ptr = (new_cap > *cap) ? iconvg_private_allocator__realloc(
+                                            allocator, *ptr, *cap, new_cap)
+                                      : NULL;
+  if (!new_ptr) {
+    iconvg_private_allocator__free(allocator, *ptr, *cap);
+    *ptr = NULL;
+    *cap = 0;
+    return false;
+  }
+  *ptr = new_ptr;
+  *cap = new_cap;
+  return true;
+}
+
+// iconvg_private_file__read_stream reads f until EOF into (*ptr)[.. *len],
+// allocated (with capacity *cap) by allocator. On failure, nothing needs
+// freeing.
+static const char*  //
+iconvg_private_file__read_stream(FILE* f,
+                                 uint8_t** ptr,
+                                 size_t* len,
+                                 size_t* cap,
+                                 iconvg_allocator* allocator) {
+  uint8_t* p = NULL;
+  size_t n = 0;
+  size_t c = 0;
+  while (true) {
+    if (!iconvg_private_file__reserve(&p, &c, n, allocator)) {
+      return iconvg_error_system_failure_out_of_memory;
+    }
+    size_t m = fread(p + n, 1, c - n, f);
+    n += m;
+    if (m == 0) {
+      break;
+    }
+  }
+  if (ferror(f)) {
+    iconvg_private_allocator__free(allocator, p, c);
+    return iconvg_error_system_failure_could_not_read_file;
+  }
+  *ptr = p;
+  *len = n;
+  *cap = c;
+  return NULL;
+}
+
+#if defined(ICONVG_PRIVATE_FILE__HAVE_MMAP)
+// iconvg_private_file__read_fd is like iconvg_private_file__read_stream but
+// reads from a file descriptor.
+static const char*  //
+iconvg_private_file__read_fd(int fd,
+                             uint8_t** ptr,
+                             size_t* len,
+                             size_t* cap,
+                             iconvg_allocator* allocator) {
+  uint8_t* p = NULL;
+  size_t n = 0;
+  size_t c = 0;
+  while (true) {
+    if (!iconvg_private_file__reserve(&p, &c, n, allocator)) {
+      return iconvg_error_system_failure_out_of_memory;
+    }
+    ssize_t m = read(fd, p + n, c - n);
+    if (m > 0) {
+      n += (size_t)m;
+    } else if (m == 0) {
+      break;
+    } else if (errno != EINTR) {
+      iconvg_private_allocator__free(allocator, p, c);
+      return iconvg_error_system_failure_could_not_read_file;
+    }
+  }
+  *ptr = p;
+  *len = n;
+  *cap = c;
+  return NULL;
+}
+#endif
+
+// ----
+
+const char*  //
+iconvg_file__open(iconvg_file* self,
+                  const char* path,
+                  iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!path) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  uint8_t* ptr = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+
+#if defined(ICONVG_PRIVATE_FILE__HAVE_MMAP)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return iconvg_error_system_failure_could_not_read_file;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return iconvg_error_system_failure_could_not_read_file;
+  } else if (S_ISREG(st.st_mode) && (st.st_size > 0) &&
+             (((uint64_t)(st.st_size)) <= SIZE_MAX)) {
+    size_t n = (size_t)(st.st_size);
+    void* p = mmap(NULL, n, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      close(fd);
+      self->ptr = (const uint8_t*)p;
+      self->len = n;
+      self->is_mapped = true;
+      return NULL;
+    }
+  }
+  // Pipes, character devices, empty files and the like can't be mapped, so
+  // read them instead.
+  const char* err_msg =
+      iconvg_private_file__read_fd(fd, &ptr, &len, &cap, allocator);
+  close(fd);
+
+#else
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    return iconvg_error_system_failure_could_not_read_file;
+  }
+  const char* err_msg =
+      iconvg_private_file__read_stream(f, &ptr, &len, &cap, allocator);
+  fclose(f);
+#endif
+
+  if (err_msg) {
+    return err_msg;
+  }
+  self->ptr = ptr;
+  self->len = len;
+  self->cap = cap;
+  self->allocator = allocator;
+  return NULL;
+}
+
+const char*  //
+iconvg_file__open_stream(iconvg_file* self,
+                         FILE* f,
+                         iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!f) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  uint8_t* ptr = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+  const char* err_msg =
+      iconvg_private_file__read_stream(f, &ptr, &len, &cap, allocator);
+  if (err_msg) {
+    return err_msg;
+  }
+  self->ptr = ptr;
+  self->len = len;
+  self->cap = cap;
+  self->allocator = allocator;
+  return NULL;
+}
+
+void  //
+iconvg_file__close(iconvg_file* self) {
+  if (!self) {
+    return;
+  } else if (self->is_mapped) {
+#if defined(ICONVG_PRIVATE_FILE__HAVE_MMAP)
+    munmap((void*)(self->ptr), self->len);
+#endif
+  } else {
+    iconvg_private_allocator__free(self->allocator, (void*)(self->ptr),
+                                   self->cap);
+  }
+  memset(self, 0, sizeof(*self));
 }
 
 // -------------------------------- #include "./matrix.c"
@@ -2829,39 +8581,221 @@ iconvg_matrix_2x3_f64__inverse(iconvg_matrix_2x3_f64* self) {
     return iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
   }
 
-  // https://ardoris.wordpress.com/2008/07/18/general-formula-for-the-inverse-of-a-3x3-matrix/
-  // recalling that self's implicit bottom row is [0, 0, 1].
-  double e02 = (self->elems[0][1] * self->elems[1][2]) -
-               (self->elems[0][2] * self->elems[1][1]);
-  double e12 = (self->elems[0][0] * self->elems[1][2]) -
-               (self->elems[0][2] * self->elems[1][0]);
-  return iconvg_matrix_2x3_f64__make(+inv * self->elems[1][1],  //
-                                     -inv * self->elems[0][1],  //
-                                     +inv * e02,                //
-                                     -inv * self->elems[1][0],  //
-                                     +inv * self->elems[0][0],  //
-                                     -inv * e12);               //
+  // https://ardoris.wordpress.com/2008/07/18/general-formula-for-the-inverse-of-a-3x3-matrix/
+  // recalling that self's implicit bottom row is [0, 0, 1].
+  double e02 = (self->elems[0][1] * self->elems[1][2]) -
+               (self->elems[0][2] * self->elems[1][1]);
+  double e12 = (self->elems[0][0] * self->elems[1][2]) -
+               (self->elems[0][2] * self->elems[1][0]);
+  return iconvg_matrix_2x3_f64__make(+inv * self->elems[1][1],  //
+                                     -inv * self->elems[0][1],  //
+                                     +inv * e02,                //
+                                     -inv * self->elems[1][0],  //
+                                     +inv * self->elems[0][0],  //
+                                     -inv * e12);               //
+}
+
+void  //
+iconvg_matrix_2x3_f64__override_second_row(iconvg_matrix_2x3_f64* self) {
+  if (!self) {
+    return;
+  }
+  if (self->elems[0][0] != 0.0) {
+    self->elems[1][0] = 0.0;
+    self->elems[1][1] = 1.0;
+  } else if (self->elems[0][1] != 0.0) {
+    self->elems[1][0] = 1.0;
+    self->elems[1][1] = 0.0;
+  } else {
+    // 1e-10 is arbitrary but very small and squaring it still gives
+    // something larger than FLT_MIN, approximately 1.175494e-38.
+    self->elems[0][0] = 1e-10;
+    self->elems[0][1] = 0.0;
+    self->elems[1][0] = 0.0;
+    self->elems[1][1] = 1e-10;
+  }
+}
+
+// -------------------------------- #include "./pack.c"
+
+#define ICONVG_PRIVATE_PACK__HEADER_SIZE 32
+#define ICONVG_PRIVATE_PACK__ENTRY_SIZE 32
+#define ICONVG_PRIVATE_PACK__BLOB_ALIGNMENT 4096
+
+static inline uint64_t  //
+iconvg_private_pack__hash(const char* name, size_t name_len) {
+  return iconvg_private_hash_fnv1a_64((const uint8_t*)name, name_len);
+}
+
+// iconvg_private_pack__compare orders entries (given as hash, name and
+// name_len) by hash and then by name.
+static int  //
+iconvg_private_pack__compare(uint64_t h0,
+                             const char* name0,
+                             size_t name_len0,
+                             uint64_t h1,
+                             const char* name1,
+                             size_t name_len1) {
+  if (h0 != h1) {
+    return (h0 < h1) ? -1 : +1;
+  }
+  size_t n = (name_len0 < name_len1) ? name_len0 : name_len1;
+  int c = memcmp(name0, name1, n);
+  if (c != 0) {
+    return c;
+  } else if (name_len0 != name_len1) {
+    return (name_len0 < name_len1) ? -1 : +1;
+  }
+  return 0;
+}
+
+static iconvg_pack_entry  //
+iconvg_private_pack__entry(const iconvg_pack* self, uint32_t i) {
+  const uint8_t* e = self->ptr + ICONVG_PRIVATE_PACK__HEADER_SIZE +
+                     (((size_t)i) * ICONVG_PRIVATE_PACK__ENTRY_SIZE);
+  iconvg_pack_entry entry;
+  entry.name =
+      (const char*)(self->ptr + iconvg_private_peek_u32le(e + 24));
+  entry.name_len = iconvg_private_peek_u32le(e + 28);
+  entry.ptr = self->ptr + iconvg_private_peek_u64le(e + 8);
+  entry.len = (size_t)(iconvg_private_peek_u64le(e + 16));
+  return entry;
+}
+
+// ----
+
+const char*  //
+iconvg_pack__open_bytes(iconvg_pack* self, const uint8_t* ptr, size_t len) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!ptr || (len < ICONVG_PRIVATE_PACK__HEADER_SIZE) ||
+      memcmp(ptr, "\x8AIVGpack", 8) ||
+      (iconvg_private_peek_u32le(ptr + 8) != 1) ||
+      (iconvg_private_peek_u64le(ptr + 16) !=
+       ICONVG_PRIVATE_PACK__HEADER_SIZE) ||
+      (iconvg_private_peek_u64le(ptr + 24) != len)) {
+    return iconvg_error_bad_pack;
+  }
+
+  // Check the index up front, so that the other methods don't have to.
+  uint32_t num_entries = iconvg_private_peek_u32le(ptr + 12);
+  uint64_t names_start = ICONVG_PRIVATE_PACK__HEADER_SIZE +
+                         (((uint64_t)num_entries) *
+                          ICONVG_PRIVATE_PACK__ENTRY_SIZE);
+  if (names_start > len) {
+    return iconvg_error_bad_pack;
+  }
+  const uint8_t* e = ptr + ICONVG_PRIVATE_PACK__HEADER_SIZE;
+  for (uint32_t i = 0; i < num_entries;
+       i++, e += ICONVG_PRIVATE_PACK__ENTRY_SIZE) {
+    uint64_t h = iconvg_private_peek_u64le(e + 0);
+    uint64_t blob_offset = iconvg_private_peek_u64le(e + 8);
+    uint64_t blob_length = iconvg_private_peek_u64le(e + 16);
+    uint64_t name_offset = iconvg_private_peek_u32le(e + 24);
+    uint64_t name_length = iconvg_private_peek_u32le(e + 28);
+    if ((blob_offset % ICONVG_PRIVATE_PACK__BLOB_ALIGNMENT) ||
+        (blob_offset > len) || (blob_length > (len - blob_offset)) ||
+        (name_offset < names_start) || (name_offset > len) ||
+        (name_length >= (len - name_offset)) ||
+        (ptr[name_offset + name_length] != 0)) {
+      return iconvg_error_bad_pack;
+    }
+    const char* name = (const char*)(ptr + name_offset);
+    if (h != iconvg_private_pack__hash(name, name_length)) {
+      return iconvg_error_bad_pack;
+    } else if (i > 0) {
+      const uint8_t* p = e - ICONVG_PRIVATE_PACK__ENTRY_SIZE;
+      if (iconvg_private_pack__compare(
+              iconvg_private_peek_u64le(p + 0),
+              (const char*)(ptr + iconvg_private_peek_u32le(p + 24)),
+              iconvg_private_peek_u32le(p + 28), h, name, name_length) >= 0) {
+        return iconvg_error_bad_pack;
+      }
+    }
+  }
+
+  self->ptr = ptr;
+  self->len = len;
+  self->num_entries = num_entries;
+  return NULL;
+}
+
+// ----
+
+const char*  //
+iconvg_pack__open_mmap(iconvg_pack* self,
+                       const char* path,
+                       iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!path) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  iconvg_file file;
+  const char* err_msg = iconvg_file__open(&file, path, allocator);
+  if (err_msg) {
+    return err_msg;
+  }
+  err_msg = iconvg_pack__open_bytes(self, file.ptr, file.len);
+  if (err_msg) {
+    iconvg_file__close(&file);
+    return err_msg;
+  }
+  self->file = file;
+  return NULL;
 }
 
 void  //
-iconvg_matrix_2x3_f64__override_second_row(iconvg_matrix_2x3_f64* self) {
+iconvg_pack__close(iconvg_pack* self) {
   if (!self) {
     return;
   }
-  if (self->elems[0][0] != 0.0) {
-    self->elems[1][0] = 0.0;
-    self->elems[1][1] = 1.0;
-  } else if (self->elems[0][1] != 0.0) {
-    self->elems[1][0] = 1.0;
-    self->elems[1][1] = 0.0;
-  } else {
-    // 1e-10 is arbitrary but very small and squaring it still gives
-    // something larger than FLT_MIN, approximately 1.175494e-38.
-    self->elems[0][0] = 1e-10;
-    self->elems[0][1] = 0.0;
-    self->elems[1][0] = 0.0;
-    self->elems[1][1] = 1e-10;
+  iconvg_file__close(&self->file);
+  memset(self, 0, sizeof(*self));
+}
+
+iconvg_pack_entry  //
+iconvg_pack__find(const iconvg_pack* self, const char* name, size_t name_len) {
+  iconvg_pack_entry entry = {0};
+  if (!self || !self->ptr || (!name && name_len)) {
+    return entry;
+  } else if (!name) {
+    name = "";
+  }
+  uint64_t h = iconvg_private_pack__hash(name, name_len);
+  uint32_t lo = 0;
+  uint32_t hi = self->num_entries;
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) / 2);
+    const uint8_t* e = self->ptr + ICONVG_PRIVATE_PACK__HEADER_SIZE +
+                       (((size_t)mid) * ICONVG_PRIVATE_PACK__ENTRY_SIZE);
+    int c = iconvg_private_pack__compare(
+        h, name, name_len, iconvg_private_peek_u64le(e + 0),
+        (const char*)(self->ptr + iconvg_private_peek_u32le(e + 24)),
+        iconvg_private_peek_u32le(e + 28));
+    if (c == 0) {
+      return iconvg_private_pack__entry(self, mid);
+    } else if (c < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return entry;
+}
+
+iconvg_pack_entry  //
+iconvg_pack__entry(const iconvg_pack* self, uint32_t i) {
+  if (!self || !self->ptr || (i >= self->num_entries)) {
+    iconvg_pack_entry entry = {0};
+    return entry;
   }
+  return iconvg_private_pack__entry(self, i);
 }
 
 // -------------------------------- #include "./paint.c"
@@ -3008,66 +8942,576 @@ iconvg_paint__gradient_stop_color_as_nonpremul_color(const iconvg_paint* self,
   return iconvg_private_flat_color_as_nonpremul_color(u);
 }
 
-iconvg_premul_color  //
-iconvg_paint__gradient_stop_color_as_premul_color(const iconvg_paint* self,
-                                                  uint32_t which_stop) {
-  uint32_t i = self->which_regs + which_stop;
-  uint32_t u = ((uint32_t)(self->regs[i & 63] >> 32));
-  return iconvg_private_flat_color_as_premul_color(u);
+iconvg_premul_color  //
+iconvg_paint__gradient_stop_color_as_premul_color(const iconvg_paint* self,
+                                                  uint32_t which_stop) {
+  uint32_t i = self->which_regs + which_stop;
+  uint32_t u = ((uint32_t)(self->regs[i & 63] >> 32));
+  return iconvg_private_flat_color_as_premul_color(u);
+}
+
+float  //
+iconvg_paint__gradient_stop_offset(const iconvg_paint* self,
+                                   uint32_t which_stop) {
+  if (!self) {
+    return 0.0f;
+  }
+  uint32_t i = self->which_regs + which_stop;
+  uint32_t u = ((uint32_t)(self->regs[i & 63]));
+  return (u >= 0x10000) ? 1.0f : (((float)u) / 0x10000);
+}
+
+iconvg_matrix_2x3_f64  //
+iconvg_paint__gradient_transformation_matrix(const iconvg_paint* self) {
+  if (!self) {
+    return iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+  }
+
+  double s00 = self->transform[0];
+  double s01 = self->transform[1];
+  double s02 = self->transform[2];
+  double s10 = self->transform[3];
+  double s11 = self->transform[4];
+  double s12 = self->transform[5];
+
+  // The [s00, s01, s02; s10, s11, s12] matrix transforms from *src*
+  // coordinates to pattern coordinates.
+  //
+  //   pat_x = (src_x * s00) + (src_y * s01) + s02
+  //   pat_y = (src_x * s10) + (src_y * s11) + s12
+  //
+  // Pattern coordinate space (also known as paint or gradient coordinate
+  // space) is where linear gradients always range from x=0 to x=1 and radial
+  // gradients are always center=(0,0) and radius=1. We can't just return this
+  // matrix to the caller. We need to produce the equivalent [d00, d01, d02;
+  // d10, d11, d12] matrix that transforms from *dst* coordinates to pattern
+  // coordinates. Recall that:
+  //
+  //   src_x = (dst_x * d2s_scale_x) + d2s_bias_x
+  //   src_y = (dst_y * d2s_scale_y) + d2s_bias_y
+  //
+  // Combining the above, we can solve for d00, d01, etc such that:
+  //
+  //   pat_x = (dst_x * d00) + (dst_y * d01) + d02
+  //   pat_y = (dst_x * d10) + (dst_y * d11) + d12
+  double d00 = s00 * self->d2s_scale_x;
+  double d01 = s01 * self->d2s_scale_y;
+  double d02 = (s00 * self->d2s_bias_x) + (s01 * self->d2s_bias_y) + s02;
+  double d10 = s10 * self->d2s_scale_x;
+  double d11 = s11 * self->d2s_scale_y;
+  double d12 = (s10 * self->d2s_bias_x) + (s11 * self->d2s_bias_y) + s12;
+
+  // With a rotating or skewing dst_transform, src_x also depends on dst_y
+  // (and src_y on dst_x):
+  //
+  //   src_x = (dst_x * d2s_scale_x) + (dst_y * d2s_skew_x) + d2s_bias_x
+  //   src_y = (dst_x * d2s_skew_y) + (dst_y * d2s_scale_y) + d2s_bias_y
+  if (self->skewed) {
+    d00 += s01 * self->d2s_skew_y;
+    d01 += s00 * self->d2s_skew_x;
+    d10 += s11 * self->d2s_skew_y;
+    d11 += s10 * self->d2s_skew_x;
+  }
+
+  return iconvg_matrix_2x3_f64__make(d00, d01, d02, d10, d11, d12);
+}
+
+// -------------------------------- #include "./profiler.c"
+
+#include <time.h>
+
+static uint64_t  //
+iconvg_private_monotonic_nanos() {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return (((uint64_t)(ts.tv_sec)) * 1000000000u) +
+           ((uint64_t)(ts.tv_nsec));
+  }
+  return 0;
+#elif defined(TIME_UTC)
+  struct timespec ts;
+  if (timespec_get(&ts, TIME_UTC) == TIME_UTC) {
+    return (((uint64_t)(ts.tv_sec)) * 1000000000u) +
+           ((uint64_t)(ts.tv_nsec));
+  }
+  return 0;
+#else
+  return (uint64_t)(((double)(clock())) * (1e9 / CLOCKS_PER_SEC));
+#endif
+}
+
+// ----
+
+void  //
+iconvg_histogram__add(iconvg_histogram* self, uint64_t value) {
+  if (!self) {
+    return;
+  }
+  uint32_t i = 0;
+  for (uint64_t v = value; v; v >>= 1) {
+    i++;
+  }
+  if (i >= ICONVG_HISTOGRAM__NUM_BUCKETS) {
+    i = ICONVG_HISTOGRAM__NUM_BUCKETS - 1;
+  }
+  self->count++;
+  self->sum += value;
+  if (self->max < value) {
+    self->max = value;
+  }
+  self->buckets[i]++;
+}
+
+void  //
+iconvg_histogram__merge(iconvg_histogram* self,
+                        const iconvg_histogram* other) {
+  if (!self || !other) {
+    return;
+  }
+  self->count += other->count;
+  self->sum += other->sum;
+  if (self->max < other->max) {
+    self->max = other->max;
+  }
+  for (int i = 0; i < ICONVG_HISTOGRAM__NUM_BUCKETS; i++) {
+    self->buckets[i] += other->buckets[i];
+  }
+}
+
+uint64_t  //
+iconvg_histogram__percentile(const iconvg_histogram* self, double p) {
+  if (!self || (self->count == 0)) {
+    return 0;
+  } else if (!(p > 0)) {
+    p = 0;
+  } else if (p > 100) {
+    p = 100;
+  }
+  uint64_t rank = (uint64_t)((p / 100) * ((double)(self->count)));
+  if (rank >= self->count) {
+    rank = self->count - 1;
+  }
+  uint64_t n = 0;
+  for (int i = 0; i < ICONVG_HISTOGRAM__NUM_BUCKETS; i++) {
+    n += self->buckets[i];
+    if (n > rank) {
+      if (i >= (ICONVG_HISTOGRAM__NUM_BUCKETS - 1)) {
+        break;
+      }
+      uint64_t upper = ((uint64_t)1) << i;
+      return (upper < self->max) ? upper : self->max;
+    }
+  }
+  return self->max;
+}
+
+// ----
+
+void  //
+iconvg_profile__merge(iconvg_profile* self, const iconvg_profile* other) {
+  if (!self || !other) {
+    return;
+  }
+  self->num_calls.begin_decode += other->num_calls.begin_decode;
+  self->num_calls.end_decode += other->num_calls.end_decode;
+  self->num_calls.begin_drawing += other->num_calls.begin_drawing;
+  self->num_calls.end_drawing += other->num_calls.end_drawing;
+  self->num_calls.begin_path += other->num_calls.begin_path;
+  self->num_calls.end_path += other->num_calls.end_path;
+  self->num_calls.path_line_to += other->num_calls.path_line_to;
+  self->num_calls.path_quad_to += other->num_calls.path_quad_to;
+  self->num_calls.path_cube_to += other->num_calls.path_cube_to;
+  self->num_calls.on_metadata_viewbox +=
+      other->num_calls.on_metadata_viewbox;
+  self->num_calls.on_metadata_suggested_palette +=
+      other->num_calls.on_metadata_suggested_palette;
+  self->num_failed_decodes += other->num_failed_decodes;
+  for (int i = 0; i < 4; i++) {
+    self->num_drawings_by_paint_type[i] +=
+        other->num_drawings_by_paint_type[i];
+  }
+  iconvg_histogram__merge(&self->segments_per_path, &other->segments_per_path);
+  iconvg_histogram__merge(&self->stops_per_gradient,
+                          &other->stops_per_gradient);
+  iconvg_histogram__merge(&self->end_drawing_nanos, &other->end_drawing_nanos);
+  iconvg_histogram__merge(&self->path_nanos, &other->path_nanos);
+}
+
+static void  //
+iconvg_private_histogram__write_json(const iconvg_histogram* self,
+                                     FILE* f,
+                                     const char* name,
+                                     const char* suffix) {
+  fprintf(f,
+          "  \"%s\": {\"count\": %llu, \"sum\": %llu, \"max\": %llu"
+          ", \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"buckets\": {",
+          name, ((unsigned long long)(self->count)),
+          ((unsigned long long)(self->sum)), ((unsigned long long)(self->max)),
+          ((unsigned long long)(iconvg_histogram__percentile(self, 50))),
+          ((unsigned long long)(iconvg_histogram__percentile(self, 90))),
+          ((unsigned long long)(iconvg_histogram__percentile(self, 99))));
+  const char* sep = "";
+  for (int i = 0; i < ICONVG_HISTOGRAM__NUM_BUCKETS; i++) {
+    if (self->buckets[i] == 0) {
+      continue;
+    } else if (i < (ICONVG_HISTOGRAM__NUM_BUCKETS - 1)) {
+      fprintf(f, "%s\"<%llu\": %llu", sep,
+              ((unsigned long long)(((uint64_t)1) << i)),
+              ((unsigned long long)(self->buckets[i])));
+    } else {
+      fprintf(f, "%s\"inf\": %llu", sep,
+              ((unsigned long long)(self->buckets[i])));
+    }
+    sep = ", ";
+  }
+  fprintf(f, "}}%s\n", suffix);
+}
+
+void  //
+iconvg_profile__write_json(const iconvg_profile* self, FILE* f) {
+  if (!self || !f) {
+    return;
+  }
+  fprintf(f, "{\n  \"num_calls\": {");
+  fprintf(f, "\"begin_decode\": %llu",
+          ((unsigned long long)(self->num_calls.begin_decode)));
+  fprintf(f, ", \"end_decode\": %llu",
+          ((unsigned long long)(self->num_calls.end_decode)));
+  fprintf(f, ", \"begin_drawing\": %llu",
+          ((unsigned long long)(self->num_calls.begin_drawing)));
+  fprintf(f, ", \"end_drawing\": %llu",
+          ((unsigned long long)(self->num_calls.end_drawing)));
+  fprintf(f, ", \"begin_path\": %llu",
+          ((unsigned long long)(self->num_calls.begin_path)));
+  fprintf(f, ", \"end_path\": %llu",
+          ((unsigned long long)(self->num_calls.end_path)));
+  fprintf(f, ", \"path_line_to\": %llu",
+          ((unsigned long long)(self->num_calls.path_line_to)));
+  fprintf(f, ", \"path_quad_to\": %llu",
+          ((unsigned long long)(self->num_calls.path_quad_to)));
+  fprintf(f, ", \"path_cube_to\": %llu",
+          ((unsigned long long)(self->num_calls.path_cube_to)));
+  fprintf(f, ", \"on_metadata_viewbox\": %llu",
+          ((unsigned long long)(self->num_calls.on_metadata_viewbox)));
+  fprintf(
+      f, ", \"on_metadata_suggested_palette\": %llu},\n",
+      ((unsigned long long)(self->num_calls.on_metadata_suggested_palette)));
+  fprintf(f, "  \"num_failed_decodes\": %llu,\n",
+          ((unsigned long long)(self->num_failed_decodes)));
+  fprintf(f,
+          "  \"num_drawings_by_paint_type\": {\"invalid\": %llu"
+          ", \"flat_color\": %llu, \"linear_gradient\": %llu"
+          ", \"radial_gradient\": %llu},\n",
+          ((unsigned long long)(self->num_drawings_by_paint_type[0])),
+          ((unsigned long long)(self->num_drawings_by_paint_type[1])),
+          ((unsigned long long)(self->num_drawings_by_paint_type[2])),
+          ((unsigned long long)(self->num_drawings_by_paint_type[3])));
+  iconvg_private_histogram__write_json(&self->segments_per_path, f,
+                                       "segments_per_path", ",");
+  iconvg_private_histogram__write_json(&self->stops_per_gradient, f,
+                                       "stops_per_gradient", ",");
+  iconvg_private_histogram__write_json(&self->end_drawing_nanos, f,
+                                       "end_drawing_nanos", ",");
+  iconvg_private_histogram__write_json(&self->path_nanos, f, "path_nanos",
+                                       "");
+  fprintf(f, "}\n");
+}
+
+// ----
+
+// The profiler canvas' context fields are:
+//  - nonconst_ptr1: the wrapped iconvg_canvas*, possibly NULL.
+//  - nonconst_ptr2: the iconvg_profile*, possibly NULL.
+//  - extra5: the number of segments in the current path.
+
+static const char*  //
+iconvg_private_profiler_canvas__begin_decode(iconvg_canvas* c,
+                                             iconvg_rectangle_f32 dst_rect) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.begin_decode++;
+  }
+  c->context.extra5 = 0;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__end_decode(iconvg_canvas* c,
+                                           const char* err_msg,
+                                           size_t num_bytes_consumed,
+                                           size_t num_bytes_remaining) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.end_decode++;
+    if (err_msg) {
+      profile->num_failed_decodes++;
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return err_msg;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.begin_drawing++;
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__end_drawing(iconvg_canvas* c,
+                                            const iconvg_paint* p) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.end_drawing++;
+    iconvg_paint_type t = iconvg_paint__type(p);
+    profile->num_drawings_by_paint_type[t & 3]++;
+    if ((t == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) ||
+        (t == ICONVG_PAINT_TYPE__RADIAL_GRADIENT)) {
+      iconvg_histogram__add(&profile->stops_per_gradient,
+                            iconvg_paint__gradient_number_of_stops(p));
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->end_drawing)(wrapped, p);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->end_drawing)(wrapped, p);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->end_drawing_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__begin_path(iconvg_canvas* c,
+                                           float x0,
+                                           float y0) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.begin_path++;
+  }
+  c->context.extra5 = 0;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__end_path(iconvg_canvas* c) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.end_path++;
+    iconvg_histogram__add(&profile->segments_per_path, c->context.extra5);
+  }
+  c->context.extra5 = 0;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->end_path)(wrapped);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->end_path)(wrapped);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__path_line_to(iconvg_canvas* c,
+                                             float x1,
+                                             float y1) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.path_line_to++;
+  }
+  c->context.extra5++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__path_quad_to(iconvg_canvas* c,
+                                             float x1,
+                                             float y1,
+                                             float x2,
+                                             float y2) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.path_quad_to++;
+  }
+  c->context.extra5++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg =
+      (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__path_cube_to(iconvg_canvas* c,
+                                             float x1,
+                                             float y1,
+                                             float x2,
+                                             float y2,
+                                             float x3,
+                                             float y3) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.path_cube_to++;
+  }
+  c->context.extra5++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg =
+      (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
 }
 
-float  //
-iconvg_paint__gradient_stop_offset(const iconvg_paint* self,
-                                   uint32_t which_stop) {
-  if (!self) {
-    return 0.0f;
+static const char*  //
+iconvg_private_profiler_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.on_metadata_viewbox++;
   }
-  uint32_t i = self->which_regs + which_stop;
-  uint32_t u = ((uint32_t)(self->regs[i & 63]));
-  return (u >= 0x10000) ? 1.0f : (((float)u) / 0x10000);
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
 }
 
-iconvg_matrix_2x3_f64  //
-iconvg_paint__gradient_transformation_matrix(const iconvg_paint* self) {
-  if (!self) {
-    return iconvg_matrix_2x3_f64__make(1.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+static const char*  //
+iconvg_private_profiler_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.on_metadata_suggested_palette++;
   }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
+}
 
-  double s00 = self->transform[0];
-  double s01 = self->transform[1];
-  double s02 = self->transform[2];
-  double s10 = self->transform[3];
-  double s11 = self->transform[4];
-  double s12 = self->transform[5];
-
-  // The [s00, s01, s02; s10, s11, s12] matrix transforms from *src*
-  // coordinates to pattern coordinates.
-  //
-  //   pat_x = (src_x * s00) + (src_y * s01) + s02
-  //   pat_y = (src_x * s10) + (src_y * s11) + s12
-  //
-  // Pattern coordinate space (also known as paint or gradient coordinate
-  // space) is where linear gradients always range from x=0 to x=1 and radial
-  // gradients are always center=(0,0) and radius=1. We can't just return this
-  // matrix to the caller. We need to produce the equivalent [d00, d01, d02;
-  // d10, d11, d12] matrix that transforms from *dst* coordinates to pattern
-  // coordinates. Recall that:
-  //
-  //   src_x = (dst_x * d2s_scale_x) + d2s_bias_x
-  //   src_y = (dst_y * d2s_scale_y) + d2s_bias_y
-  //
-  // Combining the above, we can solve for d00, d01, etc such that:
-  //
-  //   pat_x = (dst_x * d00) + (dst_y * d01) + d02
-  //   pat_y = (dst_x * d10) + (dst_y * d11) + d12
-  double d00 = s00 * self->d2s_scale_x;
-  double d01 = s01 * self->d2s_scale_y;
-  double d02 = (s00 * self->d2s_bias_x) + (s01 * self->d2s_bias_y) + s02;
-  double d10 = s10 * self->d2s_scale_x;
-  double d11 = s11 * self->d2s_scale_y;
-  double d12 = (s10 * self->d2s_bias_x) + (s11 * self->d2s_bias_y) + s12;
+static const iconvg_canvas_vtable  //
+    iconvg_private_profiler_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_profiler_canvas__begin_decode,
+        &iconvg_private_profiler_canvas__end_decode,
+        &iconvg_private_profiler_canvas__begin_drawing,
+        &iconvg_private_profiler_canvas__end_drawing,
+        &iconvg_private_profiler_canvas__begin_path,
+        &iconvg_private_profiler_canvas__end_path,
+        &iconvg_private_profiler_canvas__path_line_to,
+        &iconvg_private_profiler_canvas__path_quad_to,
+        &iconvg_private_profiler_canvas__path_cube_to,
+        &iconvg_private_profiler_canvas__on_metadata_viewbox,
+        &iconvg_private_profiler_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
 
-  return iconvg_matrix_2x3_f64__make(d00, d01, d02, d10, d11, d12);
+iconvg_canvas  //
+iconvg_canvas__make_profiler(iconvg_canvas* wrapped, iconvg_profile* profile) {
+  if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_profiler_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = profile;
+  return c;
 }
 
 // -------------------------------- #include "./rectangle.c"
@@ -3249,28 +9693,29 @@ iconvg_private_skia_canvas__end_decode(iconvg_canvas* c,
                                        const char* err_msg,
                                        size_t num_bytes_consumed,
                                        size_t num_bytes_remaining) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
   if (spb) {
     sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
+    c->context.nonconst_ptr2 = NULL;
   }
   sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
   sk_canvas_restore(sc);
   return err_msg;
 }
 
+// The first begin_drawing creates the path builder. Later drawings (in the
+// same decode) reuse it, as end_drawing's sk_pathbuilder_detach_path leaves it
+// empty, and end_decode deletes it.
 static const char*  //
 iconvg_private_skia_canvas__begin_drawing(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
+  if (c->context.nonconst_ptr2) {
+    return NULL;
   }
-  spb = sk_pathbuilder_new();
+  sk_pathbuilder_t* spb = sk_pathbuilder_new();
   if (!spb) {
     return iconvg_error_system_failure_out_of_memory;
   }
-  c->context_nonconst_ptr2 = spb;
+  c->context.nonconst_ptr2 = spb;
   return NULL;
 }
 
@@ -3278,7 +9723,7 @@ static const char*  //
 iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
                                         const iconvg_paint* p) {
   sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
 
   iconvg_paint_type paint_type = iconvg_paint__type(p);
   switch (paint_type) {
@@ -3378,114 +9823,799 @@ iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
         &sm);
   }
 
-  // Use the Skia shader.
-  if (shader) {
-    sk_path_t* path = sk_pathbuilder_detach_path(spb);
-    sk_paint_t* paint = sk_paint_new();
-    sk_paint_set_antialias(paint, true);
-    sk_paint_set_shader(paint, shader);
-    sk_shader_unref(shader);
-    sk_canvas_draw_path(sc, path, paint);
-    sk_paint_delete(paint);
-    sk_path_delete(path);
+  // Use the Skia shader. Detach the path even if there's no shader, so that
+  // the path builder is empty for the next drawing.
+  sk_path_t* path = sk_pathbuilder_detach_path(spb);
+  if (shader) {
+    sk_paint_t* paint = sk_paint_new();
+    sk_paint_set_antialias(paint, true);
+    sk_paint_set_shader(paint, shader);
+    sk_shader_unref(shader);
+    sk_canvas_draw_path(sc, path, paint);
+    sk_paint_delete(paint);
+  }
+  sk_path_delete(path);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
+  sk_pathbuilder_move_to(spb, x0, y0);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__end_path(iconvg_canvas* c) {
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
+  sk_pathbuilder_close(spb);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
+  sk_pathbuilder_line_to(spb, x1, y1);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__path_quad_to(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2) {
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
+  sk_pathbuilder_quad_to(spb, x1, y1, x2, y2);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__path_cube_to(iconvg_canvas* c,
+                                         float x1,
+                                         float y1,
+                                         float x2,
+                                         float y2,
+                                         float x3,
+                                         float y3) {
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
+  sk_pathbuilder_cubic_to(spb, x1, y1, x2, y2, x3, y3);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_skia_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_skia_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_skia_canvas__begin_decode,
+        &iconvg_private_skia_canvas__end_decode,
+        &iconvg_private_skia_canvas__begin_drawing,
+        &iconvg_private_skia_canvas__end_drawing,
+        &iconvg_private_skia_canvas__begin_path,
+        &iconvg_private_skia_canvas__end_path,
+        &iconvg_private_skia_canvas__path_line_to,
+        &iconvg_private_skia_canvas__path_quad_to,
+        &iconvg_private_skia_canvas__path_cube_to,
+        &iconvg_private_skia_canvas__on_metadata_viewbox,
+        &iconvg_private_skia_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_skia(sk_canvas_t* sc) {
+  if (!sc) {
+    return iconvg_canvas__make_broken(
+        iconvg_error_invalid_constructor_argument);
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_skia_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = sc;
+  return c;
+}
+
+#endif  // ICONVG_CONFIG__ENABLE_SKIA_BACKEND
+
+// -------------------------------- #include "./trace.c"
+
+// Each trace record is ICONVG_TRACE__RECORD_SIZE (32) bytes:
+//  - byte 0 is the op, one of the ICONVG_PRIVATE_TRACE_OP__ETC values.
+//  - bytes 1, 2 and 3 are small op-specific fields.
+//  - bytes 4 .. 8 are the number of continuation records that immediately
+//    follow this one, as a little-endian uint32_t.
+//  - bytes 8 .. 32 are the payload: up to six little-endian float32 values
+//    (a rectangle or path coordinates) or three little-endian uint64_t values.
+//
+// Continuation records hold larger arguments (a paint or a palette), 24 bytes
+// per record, in their bytes 8 .. 32. Their other bytes are zero except for
+// byte 0, which is ICONVG_PRIVATE_TRACE_OP__CONTINUATION.
+//
+// For end_decode, byte 1 indexes iconvg_private_trace_errors, or is 0xFF for
+// other (non-NULL) error messages, and the payload holds num_bytes_consumed
+// and num_bytes_remaining.
+//
+// For end_drawing, bytes 1, 2 and 3 are the paint's type, gradient spread and
+// gradient number of stops. For flat colors, the payload's first four bytes
+// hold the (resolved) premultiplied color. For gradients, the payload holds
+// the src space gradient transform (six float32 values) and the continuation
+// records hold the four float64 d2s scale and bias values followed by the
+// stops' registers (each a uint64_t). If the paint is skewed (see
+// iconvg_decode_options.dst_transform), two float64 d2s skew values follow
+// the registers. Older traces don't have them, which replays as unskewed.
+
+#define ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE 0x01
+#define ICONVG_PRIVATE_TRACE_OP__END_DECODE 0x02
+#define ICONVG_PRIVATE_TRACE_OP__BEGIN_DRAWING 0x03
+#define ICONVG_PRIVATE_TRACE_OP__END_DRAWING 0x04
+#define ICONVG_PRIVATE_TRACE_OP__BEGIN_PATH 0x05
+#define ICONVG_PRIVATE_TRACE_OP__END_PATH 0x06
+#define ICONVG_PRIVATE_TRACE_OP__PATH_LINE_TO 0x07
+#define ICONVG_PRIVATE_TRACE_OP__PATH_QUAD_TO 0x08
+#define ICONVG_PRIVATE_TRACE_OP__PATH_CUBE_TO 0x09
+#define ICONVG_PRIVATE_TRACE_OP__ON_METADATA_VIEWBOX 0x0A
+#define ICONVG_PRIVATE_TRACE_OP__ON_METADATA_SUGGESTED_PALETTE 0x0B
+#define ICONVG_PRIVATE_TRACE_OP__CONTINUATION 0xFF
+
+#define ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE 24
+
+// ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE is the largest continuation payload: a
+// gradient's four float64 values, 64 registers and two more float64 values.
+#define ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE (32 + (64 * 8) + 16)
+
+#define ICONVG_PRIVATE_TRACE__MAX_NUM_CONTINUATIONS \
+  ((ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE +           \
+    (ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE - 1)) /     \
+   ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE)
+
+static const char* const iconvg_private_trace_errors[] = {
+    NULL,
+    iconvg_error_bad_coordinate,
+    iconvg_error_bad_jump,
+    iconvg_error_bad_magic_identifier,
+    iconvg_error_bad_metadata,
+    iconvg_error_bad_metadata_id_order,
+    iconvg_error_bad_metadata_suggested_palette,
+    iconvg_error_bad_metadata_viewbox,
+    iconvg_error_bad_number,
+    iconvg_error_bad_opcode_length,
+    iconvg_error_system_failure_out_of_memory,
+    iconvg_error_invalid_backend_not_enabled,
+    iconvg_error_invalid_constructor_argument,
+    iconvg_error_invalid_paint_type,
+    iconvg_error_invalid_vtable,
+    iconvg_error_invalid_trace,
+    // New errors are appended, so that existing traces' indexes stay valid.
+    iconvg_error_bad_segref,
+    iconvg_error_bad_pack,
+    iconvg_error_system_failure_could_not_read_file,
+    iconvg_error_bad_display_list_cache,
+    iconvg_error_invalid_encoder_call,
+};
+
+#define ICONVG_PRIVATE_TRACE__NUM_ERRORS \
+  (sizeof(iconvg_private_trace_errors) / sizeof(iconvg_private_trace_errors[0]))
+
+// ----
+
+static void  //
+iconvg_private_trace__write_record(iconvg_trace* t, const uint8_t* rec) {
+  if (t->ptr) {
+    size_t n = t->len / ICONVG_TRACE__RECORD_SIZE;
+    if (n > 0) {
+      memcpy(t->ptr + (ICONVG_TRACE__RECORD_SIZE * (t->num_records % n)), rec,
+             ICONVG_TRACE__RECORD_SIZE);
+    }
+  }
+  if (t->file) {
+    fwrite(rec, 1, ICONVG_TRACE__RECORD_SIZE, t->file);
+  }
+  t->num_records++;
+}
+
+// iconvg_private_trace__write writes a record whose first 8 bytes are set from
+// the op and a8, b8, c8 arguments, followed by the continuation records for
+// blob_ptr[.. blob_len]. The record's payload is rec[8 .. 32], set by the
+// caller.
+static void  //
+iconvg_private_trace__write(iconvg_trace* t,
+                            uint8_t* rec,
+                            uint8_t op,
+                            uint8_t a8,
+                            uint8_t b8,
+                            uint8_t c8,
+                            const uint8_t* blob_ptr,
+                            size_t blob_len) {
+  size_t num_continuations =
+      (blob_len + (ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE - 1)) /
+      ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE;
+  rec[0] = op;
+  rec[1] = a8;
+  rec[2] = b8;
+  rec[3] = c8;
+  iconvg_private_poke_u32le(rec + 4, (uint32_t)num_continuations);
+  iconvg_private_trace__write_record(t, rec);
+
+  while (blob_len > 0) {
+    size_t n = (blob_len < ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE)
+                   ? blob_len
+                   : ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE;
+    uint8_t cont[ICONVG_TRACE__RECORD_SIZE] = {0};
+    cont[0] = ICONVG_PRIVATE_TRACE_OP__CONTINUATION;
+    memcpy(cont + 8, blob_ptr, n);
+    iconvg_private_trace__write_record(t, cont);
+    blob_ptr += n;
+    blob_len -= n;
+  }
+}
+
+static inline void  //
+iconvg_private_trace__poke_f32s(uint8_t* rec, const float* f, int n) {
+  for (int i = 0; i < n; i++) {
+    iconvg_private_poke_u32le(rec + 8 + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f[i]));
+  }
+}
+
+// ----
+
+static const char*  //
+iconvg_private_trace_canvas__begin_decode(iconvg_canvas* c,
+                                          iconvg_rectangle_f32 dst_rect) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[4] = {dst_rect.min_x, dst_rect.min_y, dst_rect.max_x,
+                  dst_rect.max_y};
+    iconvg_private_trace__poke_f32s(rec, f, 4);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__end_decode(iconvg_canvas* c,
+                                        const char* err_msg,
+                                        size_t num_bytes_consumed,
+                                        size_t num_bytes_remaining) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t e = 0xFF;
+    for (size_t i = 0; i < ICONVG_PRIVATE_TRACE__NUM_ERRORS; i++) {
+      if (err_msg == iconvg_private_trace_errors[i]) {
+        e = (uint8_t)i;
+        break;
+      }
+    }
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_poke_u64le(rec + 8, num_bytes_consumed);
+    iconvg_private_poke_u64le(rec + 16, num_bytes_remaining);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__END_DECODE, e,
+                                0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return err_msg;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__BEGIN_DRAWING,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
   }
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
 
-  // Clean up.
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
+static const char*  //
+iconvg_private_trace_canvas__end_drawing(iconvg_canvas* c,
+                                         const iconvg_paint* p) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    uint8_t blob[ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE];
+    size_t blob_len = 0;
+    iconvg_paint_type paint_type = iconvg_paint__type(p);
+    uint8_t spread = 0;
+    uint8_t num_stops = 0;
+    switch (paint_type) {
+      case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+        iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+        memcpy(rec + 8, &k.rgba[0], 4);
+        break;
+      }
+      case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+      case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
+        spread = p->spread;
+        num_stops = p->num_stops;
+        iconvg_private_trace__poke_f32s(rec, p->transform, 6);
+        double d2s[4] = {p->d2s_scale_x, p->d2s_bias_x, p->d2s_scale_y,
+                         p->d2s_bias_y};
+        for (int i = 0; i < 4; i++) {
+          iconvg_private_poke_u64le(
+              blob + blob_len,
+              iconvg_private_reinterpret_from_f64_to_u64(d2s[i]));
+          blob_len += 8;
+        }
+        for (uint32_t i = 0; i < num_stops; i++) {
+          iconvg_private_poke_u64le(blob + blob_len,
+                                    p->regs[(p->which_regs + i) & 63]);
+          blob_len += 8;
+        }
+        if (p->skewed) {
+          double skews[2] = {p->d2s_skew_x, p->d2s_skew_y};
+          for (int i = 0; i < 2; i++) {
+            iconvg_private_poke_u64le(
+                blob + blob_len,
+                iconvg_private_reinterpret_from_f64_to_u64(skews[i]));
+            blob_len += 8;
+          }
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__END_DRAWING,
+                                (uint8_t)paint_type, spread, num_stops, blob,
+                                blob_len);
   }
-  return NULL;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_drawing)(wrapped, p);
 }
 
 static const char*  //
-iconvg_private_skia_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_move_to(spb, x0, y0);
-  return NULL;
+iconvg_private_trace_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[2] = {x0, y0};
+    iconvg_private_trace__poke_f32s(rec, f, 2);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__BEGIN_PATH, 0,
+                                0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
 }
 
 static const char*  //
-iconvg_private_skia_canvas__end_path(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_close(spb);
-  return NULL;
+iconvg_private_trace_canvas__end_path(iconvg_canvas* c) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__END_PATH, 0, 0,
+                                0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_path)(wrapped);
 }
 
 static const char*  //
-iconvg_private_skia_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_line_to(spb, x1, y1);
-  return NULL;
+iconvg_private_trace_canvas__path_line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[2] = {x1, y1};
+    iconvg_private_trace__poke_f32s(rec, f, 2);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__PATH_LINE_TO,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
 }
 
 static const char*  //
-iconvg_private_skia_canvas__path_quad_to(iconvg_canvas* c,
-                                         float x1,
-                                         float y1,
-                                         float x2,
-                                         float y2) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_quad_to(spb, x1, y1, x2, y2);
-  return NULL;
+iconvg_private_trace_canvas__path_quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[4] = {x1, y1, x2, y2};
+    iconvg_private_trace__poke_f32s(rec, f, 4);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__PATH_QUAD_TO,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
 }
 
 static const char*  //
-iconvg_private_skia_canvas__path_cube_to(iconvg_canvas* c,
-                                         float x1,
-                                         float y1,
-                                         float x2,
-                                         float y2,
-                                         float x3,
-                                         float y3) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  sk_pathbuilder_cubic_to(spb, x1, y1, x2, y2, x3, y3);
-  return NULL;
+iconvg_private_trace_canvas__path_cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[6] = {x1, y1, x2, y2, x3, y3};
+    iconvg_private_trace__poke_f32s(rec, f, 6);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__PATH_CUBE_TO,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
 }
 
 static const char*  //
-iconvg_private_skia_canvas__on_metadata_viewbox(iconvg_canvas* c,
-                                                iconvg_rectangle_f32 viewbox) {
-  return NULL;
+iconvg_private_trace_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                 iconvg_rectangle_f32 viewbox) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[4] = {viewbox.min_x, viewbox.min_y, viewbox.max_x, viewbox.max_y};
+    iconvg_private_trace__poke_f32s(rec, f, 4);
+    iconvg_private_trace__write(t, rec,
+                                ICONVG_PRIVATE_TRACE_OP__ON_METADATA_VIEWBOX, 0,
+                                0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
 }
 
 static const char*  //
-iconvg_private_skia_canvas__on_metadata_suggested_palette(
+iconvg_private_trace_canvas__on_metadata_suggested_palette(
     iconvg_canvas* c,
     const iconvg_palette* suggested_palette) {
-  return NULL;
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_trace__write(
+        t, rec, ICONVG_PRIVATE_TRACE_OP__ON_METADATA_SUGGESTED_PALETTE, 0, 0, 0,
+        &suggested_palette->colors[0].rgba[0], sizeof(iconvg_palette));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
 }
 
 static const iconvg_canvas_vtable  //
-    iconvg_private_skia_canvas_vtable = {
+    iconvg_private_trace_canvas_vtable = {
         sizeof(iconvg_canvas_vtable),
-        &iconvg_private_skia_canvas__begin_decode,
-        &iconvg_private_skia_canvas__end_decode,
-        &iconvg_private_skia_canvas__begin_drawing,
-        &iconvg_private_skia_canvas__end_drawing,
-        &iconvg_private_skia_canvas__begin_path,
-        &iconvg_private_skia_canvas__end_path,
-        &iconvg_private_skia_canvas__path_line_to,
-        &iconvg_private_skia_canvas__path_quad_to,
-        &iconvg_private_skia_canvas__path_cube_to,
-        &iconvg_private_skia_canvas__on_metadata_viewbox,
-        &iconvg_private_skia_canvas__on_metadata_suggested_palette,
+        &iconvg_private_trace_canvas__begin_decode,
+        &iconvg_private_trace_canvas__end_decode,
+        &iconvg_private_trace_canvas__begin_drawing,
+        &iconvg_private_trace_canvas__end_drawing,
+        &iconvg_private_trace_canvas__begin_path,
+        &iconvg_private_trace_canvas__end_path,
+        &iconvg_private_trace_canvas__path_line_to,
+        &iconvg_private_trace_canvas__path_quad_to,
+        &iconvg_private_trace_canvas__path_cube_to,
+        &iconvg_private_trace_canvas__on_metadata_viewbox,
+        &iconvg_private_trace_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
 };
 
 iconvg_canvas  //
-iconvg_canvas__make_skia(sk_canvas_t* sc) {
-  if (!sc) {
-    return iconvg_canvas__make_broken(
-        iconvg_error_invalid_constructor_argument);
+iconvg_canvas__make_trace(iconvg_canvas* wrapped, iconvg_trace* trace) {
+  if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
   }
   iconvg_canvas c;
-  c.vtable = &iconvg_private_skia_canvas_vtable;
+  c.vtable = &iconvg_private_trace_canvas_vtable;
   memset(&c.context, 0, sizeof(c.context));
-  c.context.nonconst_ptr1 = sc;
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = trace;
   return c;
 }
 
-#endif  // ICONVG_CONFIG__ENABLE_SKIA_BACKEND
+// ----
+
+static inline float  //
+iconvg_private_trace__peek_f32(const uint8_t* rec, int i) {
+  return iconvg_private_reinterpret_from_u32_to_f32(
+      iconvg_private_peek_u32le(rec + 8 + (4 * i)));
+}
+
+static inline iconvg_rectangle_f32  //
+iconvg_private_trace__peek_rectangle(const uint8_t* rec) {
+  return iconvg_rectangle_f32__make(iconvg_private_trace__peek_f32(rec, 0),
+                                    iconvg_private_trace__peek_f32(rec, 1),
+                                    iconvg_private_trace__peek_f32(rec, 2),
+                                    iconvg_private_trace__peek_f32(rec, 3));
+}
+
+// iconvg_private_trace__replay_paint reconstructs, in *p, a paint whose
+// iconvg_paint__etc accessors return what the recorded paint's did.
+static const char*  //
+iconvg_private_trace__replay_paint(iconvg_paint* p,
+                                   const uint8_t* rec,
+                                   const uint8_t* blob,
+                                   size_t blob_len) {
+  memset(p, 0, sizeof(*p));
+  p->paint_type = rec[1];
+  switch (p->paint_type) {
+    case ICONVG_PAINT_TYPE__INVALID:
+      return NULL;
+    case ICONVG_PAINT_TYPE__FLAT_COLOR:
+      // A valid premultiplied color resolves to itself.
+      p->regs[0] = ((uint64_t)(iconvg_private_peek_u32le(rec + 8))) << 32;
+      return NULL;
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      break;
+    default:
+      return iconvg_error_invalid_trace;
+  }
+
+  p->spread = rec[2];
+  p->num_stops = rec[3];
+  if ((p->num_stops > 64) || (blob_len < (32 + (8 * (size_t)p->num_stops)))) {
+    return iconvg_error_invalid_trace;
+  }
+  for (int i = 0; i < 6; i++) {
+    p->transform[i] = iconvg_private_trace__peek_f32(rec, i);
+  }
+  p->d2s_scale_x =
+      iconvg_private_reinterpret_from_u64_to_f64(iconvg_private_peek_u64le(blob));
+  p->d2s_bias_x = iconvg_private_reinterpret_from_u64_to_f64(
+      iconvg_private_peek_u64le(blob + 8));
+  p->d2s_scale_y = iconvg_private_reinterpret_from_u64_to_f64(
+      iconvg_private_peek_u64le(blob + 16));
+  p->d2s_bias_y = iconvg_private_reinterpret_from_u64_to_f64(
+      iconvg_private_peek_u64le(blob + 24));
+  for (uint32_t i = 0; i < p->num_stops; i++) {
+    p->regs[i] = iconvg_private_peek_u64le(blob + 32 + (8 * i));
+  }
+  size_t skews_offset = 32 + (8 * (size_t)p->num_stops);
+  if (blob_len >= (skews_offset + 16)) {
+    p->d2s_skew_x = iconvg_private_reinterpret_from_u64_to_f64(
+        iconvg_private_peek_u64le(blob + skews_offset));
+    p->d2s_skew_y = iconvg_private_reinterpret_from_u64_to_f64(
+        iconvg_private_peek_u64le(blob + skews_offset + 8));
+    p->skewed = (p->d2s_skew_x != 0) || (p->d2s_skew_y != 0);
+  }
+  return NULL;
+}
+
+const char*  //
+iconvg_trace__replay(const iconvg_trace* self, iconvg_canvas* c) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!c || !c->vtable) {
+    c = &fallback_canvas;
+  }
+  if (c->vtable->sizeof__iconvg_canvas_vtable != sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!self || !self->ptr) {
+    return NULL;
+  }
+  uint64_t n = self->len / ICONVG_TRACE__RECORD_SIZE;
+  if (n == 0) {
+    return NULL;
+  }
+  uint64_t i = 0;
+  uint64_t end = self->num_records;
+  bool skipping = false;
+  if (end > n) {
+    i = end - n;
+    skipping = true;
+  }
+
+  const char* ret = NULL;
+  const char* err_msg = NULL;
+  iconvg_palette palette;
+  iconvg_paint paint;
+  uint8_t blob[ICONVG_PRIVATE_TRACE__MAX_NUM_CONTINUATIONS *
+               ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE];
+  while (i < end) {
+    const uint8_t* rec =
+        self->ptr + (ICONVG_TRACE__RECORD_SIZE * (size_t)(i % n));
+    i++;
+    uint8_t op = rec[0];
+    if (skipping) {
+      if (op != ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE) {
+        continue;
+      }
+      skipping = false;
+    }
+
+    uint64_t num_continuations = iconvg_private_peek_u32le(rec + 4);
+    if ((op == ICONVG_PRIVATE_TRACE_OP__CONTINUATION) ||
+        (num_continuations > (end - i)) ||
+        (num_continuations > ICONVG_PRIVATE_TRACE__MAX_NUM_CONTINUATIONS)) {
+      return iconvg_error_invalid_trace;
+    }
+    size_t blob_len = 0;
+    for (; num_continuations > 0; num_continuations--) {
+      const uint8_t* cont =
+          self->ptr + (ICONVG_TRACE__RECORD_SIZE * (size_t)(i % n));
+      i++;
+      if (cont[0] != ICONVG_PRIVATE_TRACE_OP__CONTINUATION) {
+        return iconvg_error_invalid_trace;
+      }
+      memcpy(blob + blob_len, cont + 8, ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE);
+      blob_len += ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE;
+    }
+
+    // Like iconvg_decode, once a canvas method fails, skip ahead to
+    // end_decode.
+    if (err_msg && (op != ICONVG_PRIVATE_TRACE_OP__END_DECODE)) {
+      continue;
+    }
+
+    switch (op) {
+      case ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE:
+        err_msg = (*c->vtable->begin_decode)(
+            c, iconvg_private_trace__peek_rectangle(rec));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__END_DECODE: {
+        if (!err_msg) {
+          err_msg = (rec[1] < ICONVG_PRIVATE_TRACE__NUM_ERRORS)
+                        ? iconvg_private_trace_errors[rec[1]]
+                        : iconvg_error_invalid_trace;
+        }
+        const char* z = (*c->vtable->end_decode)(
+            c, err_msg, (size_t)iconvg_private_peek_u64le(rec + 8),
+            (size_t)iconvg_private_peek_u64le(rec + 16));
+        if (!ret) {
+          ret = z;
+        }
+        err_msg = NULL;
+        break;
+      }
+
+      case ICONVG_PRIVATE_TRACE_OP__BEGIN_DRAWING:
+        err_msg = (*c->vtable->begin_drawing)(c);
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__END_DRAWING:
+        err_msg =
+            iconvg_private_trace__replay_paint(&paint, rec, blob, blob_len);
+        if (err_msg) {
+          return err_msg;
+        }
+        err_msg = (*c->vtable->end_drawing)(c, &paint);
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__BEGIN_PATH:
+        err_msg = (*c->vtable->begin_path)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__END_PATH:
+        err_msg = (*c->vtable->end_path)(c);
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__PATH_LINE_TO:
+        err_msg = (*c->vtable->path_line_to)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__PATH_QUAD_TO:
+        err_msg = (*c->vtable->path_quad_to)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1),
+            iconvg_private_trace__peek_f32(rec, 2),
+            iconvg_private_trace__peek_f32(rec, 3));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__PATH_CUBE_TO:
+        err_msg = (*c->vtable->path_cube_to)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1),
+            iconvg_private_trace__peek_f32(rec, 2),
+            iconvg_private_trace__peek_f32(rec, 3),
+            iconvg_private_trace__peek_f32(rec, 4),
+            iconvg_private_trace__peek_f32(rec, 5));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__ON_METADATA_VIEWBOX:
+        err_msg = (*c->vtable->on_metadata_viewbox)(
+            c, iconvg_private_trace__peek_rectangle(rec));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__ON_METADATA_SUGGESTED_PALETTE:
+        if (blob_len < sizeof(palette)) {
+          return iconvg_error_invalid_trace;
+        }
+        memcpy(&palette, blob, sizeof(palette));
+        err_msg = (*c->vtable->on_metadata_suggested_palette)(c, &palette);
+        break;
+
+      default:
+        return iconvg_error_invalid_trace;
+    }
+  }
+  return ret;
+}
 
 #endif  // ICONVG_IMPLEMENTATION
 
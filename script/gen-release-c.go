@@ -442,6 +442,8 @@ func looksLikePublicAPIType(src []byte) (name string) {
 		src = src[len(closeCurly):]
 	} else if bytes.HasPrefix(src, typedefStruct) {
 		src = src[len(typedefStruct):]
+	} else if bytes.HasPrefix(src, typedef) && !bytes.HasPrefix(src, typedefEnum) {
+		src = src[len(typedef):]
 	} else {
 		return ""
 	}
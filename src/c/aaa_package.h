@@ -27,16 +27,24 @@
 #include "./aaa_public.h"
 #ifdef ICONVG_IMPLEMENTATION
 #include "./aaa_private.h"
+#include "./allocator.c"
 #include "./broken.c"
 #include "./cairo.c"
 #include "./color.c"
+#include "./compiled.c"
 #include "./debug.c"
 #include "./decoder.c"
+#include "./display_list.c"
+#include "./encoder.c"
 #include "./error.c"
+#include "./file.c"
 #include "./matrix.c"
+#include "./pack.c"
 #include "./paint.c"
+#include "./profiler.c"
 #include "./rectangle.c"
 #include "./skia.c"
+#include "./trace.c"
 #endif  // ICONVG_IMPLEMENTATION
 
 #endif  // ICONVG_INCLUDE_GUARD
@@ -57,6 +57,23 @@ iconvg_private_poke_u32le(uint8_t* p, uint32_t x) {
   p[3] = (uint8_t)(x >> 24);
 }
 
+static inline void  //
+iconvg_private_poke_u64le(uint8_t* p, uint64_t x) {
+  iconvg_private_poke_u32le(p + 0, (uint32_t)(x >> 0));
+  iconvg_private_poke_u32le(p + 4, (uint32_t)(x >> 32));
+}
+
+// iconvg_private_hash_fnv1a_64 returns the 64-bit FNV-1a hash of p[.. n].
+static inline uint64_t  //
+iconvg_private_hash_fnv1a_64(const uint8_t* p, size_t n) {
+  uint64_t h = 0xCBF29CE484222325u;
+  for (; n > 0; n--) {
+    h ^= *p++;
+    h *= 0x00000100000001B3u;
+  }
+  return h;
+}
+
 static inline float  //
 iconvg_private_reinterpret_from_u32_to_f32(uint32_t u) {
   float f = 0;
@@ -66,6 +83,33 @@ iconvg_private_reinterpret_from_u32_to_f32(uint32_t u) {
   return f;
 }
 
+static inline uint32_t  //
+iconvg_private_reinterpret_from_f32_to_u32(float f) {
+  uint32_t u = 0;
+  if (sizeof(uint32_t) == sizeof(float)) {
+    memcpy(&u, &f, sizeof(uint32_t));
+  }
+  return u;
+}
+
+static inline double  //
+iconvg_private_reinterpret_from_u64_to_f64(uint64_t u) {
+  double f = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&f, &u, sizeof(uint64_t));
+  }
+  return f;
+}
+
+static inline uint64_t  //
+iconvg_private_reinterpret_from_f64_to_u64(double f) {
+  uint64_t u = 0;
+  if (sizeof(uint64_t) == sizeof(double)) {
+    memcpy(&u, &f, sizeof(uint64_t));
+  }
+  return u;
+}
+
 // ----
 
 static inline size_t  //
@@ -76,6 +120,33 @@ iconvg_private_canvas_sizeof_vtable(iconvg_canvas* c) {
   return 0;
 }
 
+// iconvg_private_canvas__set_current_point and
+// iconvg_private_canvas__current_point track the current point (the end of
+// the most recent begin_path or path_etc_to call) in dst coordinate space.
+// Backends that need the current point, e.g. to convert quadratic Bézier
+// curves to cubic ones, can use these instead of asking their underlying
+// graphics library, which might have to convert back from its own internal
+// representation.
+//
+// The point is stored (as float32 bits) in the context.extra5 and
+// context.extra6 fields, so backends that use these functions must not use
+// those fields for anything else.
+static inline void  //
+iconvg_private_canvas__set_current_point(iconvg_canvas* c, float x, float y) {
+  c->context.extra5 = iconvg_private_reinterpret_from_f32_to_u32(x);
+  c->context.extra6 = iconvg_private_reinterpret_from_f32_to_u32(y);
+}
+
+static inline void  //
+iconvg_private_canvas__current_point(const iconvg_canvas* c,
+                                     float* x,
+                                     float* y) {
+  *x = iconvg_private_reinterpret_from_u32_to_f32(
+      (uint32_t)(c->context.extra5));
+  *y = iconvg_private_reinterpret_from_u32_to_f32(
+      (uint32_t)(c->context.extra6));
+}
+
 // ----
 
 static inline iconvg_rectangle_f32  //
@@ -90,9 +161,15 @@ iconvg_private_default_viewbox() {
 
 // ----
 
+struct iconvg_private_decoder_iov_struct;
+
+// iconvg_private_decoder reads from ptr[.. len]. If iov is non-NULL (see
+// iconvg_decode_iov) then more input follows ptr[.. len] and
+// iconvg_private_decoder__refill moves on to it.
 typedef struct iconvg_private_decoder_struct {
   const uint8_t* ptr;
   size_t len;
+  struct iconvg_private_decoder_iov_struct* iov;
 } iconvg_private_decoder;
 
 // ----
@@ -116,6 +193,18 @@ iconvg_private_last_color_that_isnt_opaque_black(
 
 // ----
 
+// iconvg_private_coord is the type of the decoder's path coordinates, in src
+// (viewbox) space. iconvg_private_wide_coord holds intermediate values, such
+// as an ellipse's cubic Bézier control points. With ICONVG_CONFIG__FIXED_POINT,
+// they are 24.8 fixed point numbers instead of floating point.
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+typedef int32_t iconvg_private_coord;
+typedef int64_t iconvg_private_wide_coord;
+#else
+typedef float iconvg_private_coord;
+typedef double iconvg_private_wide_coord;
+#endif
+
 struct iconvg_paint_struct {
   iconvg_rectangle_f32 viewbox;
   int64_t height_in_pixels;
@@ -137,16 +226,41 @@ struct iconvg_paint_struct {
   //
   //   400 = ((-32) * 1.5625) + 450
   //   500 = ((+32) * 1.5625) + 450
+  //
+  // A non-NULL iconvg_decode_options.dst_transform can also rotate or skew,
+  // which adds a skew term. When skewed is true:
+  //
+  //   q_x = (p_x * p2q_scale_x) + (p_y * p2q_skew_x) + p2q_bias_x
+  //   q_y = (p_x * p2q_skew_y) + (p_y * p2q_scale_y) + p2q_bias_y
+  //
+  // When skewed is false, the skew fields are zero and unused.
 
   double s2d_scale_x;
   double s2d_bias_x;
   double s2d_scale_y;
   double s2d_bias_y;
+  double s2d_skew_x;
+  double s2d_skew_y;
 
   double d2s_scale_x;
   double d2s_bias_x;
   double d2s_scale_y;
   double d2s_bias_y;
+  double d2s_skew_x;
+  double d2s_skew_y;
+
+  bool skewed;
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  // The s2d_fixed_etc fields are the s2d_etc fields as 16.16 (for scales and
+  // skews) and 24.8 (for biases) fixed point numbers.
+  int64_t s2d_fixed_scale_x;
+  int64_t s2d_fixed_bias_x;
+  int64_t s2d_fixed_scale_y;
+  int64_t s2d_fixed_bias_y;
+  int64_t s2d_fixed_skew_x;
+  int64_t s2d_fixed_skew_y;
+#endif
 
   uint8_t sel;
   bool begun_drawing;
@@ -159,12 +273,13 @@ struct iconvg_paint_struct {
 
   union {
     // coords[0] are the current x and y coordinates. coords[1..4] are the x
-    // and y coordinates of the path op arguments. That final space (6 floats)
-    // is also used to hold gradient transformation matrices.
-    float coords[4][2];
+    // and y coordinates of the path op arguments. That final space (6 floats
+    // or fixed point numbers) is also used to hold gradient transformation
+    // matrices.
+    iconvg_private_coord coords[4][2];
     struct {
-      float current_x;
-      float current_y;
+      iconvg_private_coord current_x;
+      iconvg_private_coord current_y;
       float transform[6];
     };
   };
@@ -174,6 +289,88 @@ struct iconvg_paint_struct {
 
 // ----
 
+// The iconvg_private_allocator__etc functions are like malloc, realloc and
+// free but go through a (which may be NULL, meaning the C standard library)
+// and update its counters. The sizes passed to realloc and free must be those
+// of the existing allocation.
+
+void*  //
+iconvg_private_allocator__alloc(iconvg_allocator* a, size_t n);
+
+void*  //
+iconvg_private_allocator__realloc(iconvg_allocator* a,
+                                  void* ptr,
+                                  size_t old_n,
+                                  size_t new_n);
+
+void  //
+iconvg_private_allocator__free(iconvg_allocator* a, void* ptr, size_t n);
+
+// iconvg_private_allocator__from_options returns options->allocator, or NULL
+// if options is NULL or predates that field.
+iconvg_allocator*  //
+iconvg_private_allocator__from_options(const iconvg_decode_options* options);
+
+// ----
+
+// ICONVG_PRIVATE_LOD_THRESHOLDS__MAX is the maximum number of distinct values
+// held by an iconvg_private_lod_thresholds.
+#define ICONVG_PRIVATE_LOD_THRESHOLDS__MAX 64
+
+// iconvg_private_lod_thresholds collects the distinct, finite lower and upper
+// bounds of a file's Jump Level-of-Detail ops, in no particular order.
+// overflowed is whether there were more than can be held.
+typedef struct iconvg_private_lod_thresholds_struct {
+  float values[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX];
+  uint32_t num_values;
+  bool overflowed;
+} iconvg_private_lod_thresholds;
+
+// ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS is the maximum number of
+// values written by iconvg_private_lod_thresholds__breakpoints.
+#define ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS \
+  (ICONVG_PRIVATE_LOD_THRESHOLDS__MAX + 1)
+
+// iconvg_private_lod_thresholds__breakpoints converts Level of Detail
+// thresholds to the sorted, distinct minimum heights of a file's variants,
+// writing them to dst and returning how many there are. The first is always
+// INT64_MIN. A Jump Level-of-Detail op's (lod[0] <= h) and (h < lod[1]) tests,
+// for an integer h, only change value at h = ceil(lod[i]). Breakpoints are
+// clamped to +/-(1 << 53), beyond which int64_t to double conversion is
+// inexact.
+size_t  //
+iconvg_private_lod_thresholds__breakpoints(
+    const iconvg_private_lod_thresholds* self,
+    int64_t* dst);
+
+// iconvg_private_validate is iconvg_validate, also collecting the Level of
+// Detail thresholds into *lods if it is non-NULL.
+const char*  //
+iconvg_private_validate(iconvg_validate_report* r,
+                        const uint8_t* src_ptr,
+                        size_t src_len,
+                        iconvg_private_lod_thresholds* lods);
+
+// iconvg_private_height_in_pixels returns the height that iconvg_decode uses
+// for Level of Detail tests.
+int64_t  //
+iconvg_private_height_in_pixels(iconvg_rectangle_f32 r,
+                                const iconvg_decode_options* options);
+
+// iconvg_private_dst_transform returns the options' dst_transform, or NULL if
+// options is NULL or too old (too small) to have that field.
+const iconvg_matrix_2x3_f64*  //
+iconvg_private_dst_transform(const iconvg_decode_options* options);
+
+// iconvg_private_initialize_remaining_paint_fields sets the iconvg_paint
+// fields after custom_palette, given p->viewbox, the dst_rect r and the
+// optional dst_transform m.
+void  //
+iconvg_private_initialize_remaining_paint_fields(
+    iconvg_paint* p,
+    iconvg_rectangle_f32 r,
+    const iconvg_matrix_2x3_f64* m);
+
 const char*  //
 iconvg_private_path_arc_to(iconvg_canvas* c,
                            double scale_x,
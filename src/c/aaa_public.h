@@ -84,6 +84,7 @@
 // Other errors (invalid_etc) are programming errors.
 
 extern const char iconvg_error_bad_coordinate[];                  // ¶0.1
+extern const char iconvg_error_bad_display_list_cache[];          // ¶0.1
 extern const char iconvg_error_bad_jump[];                        // ¶0.1
 extern const char iconvg_error_bad_magic_identifier[];            // ¶0.1
 extern const char iconvg_error_bad_metadata[];                    // ¶0.1
@@ -92,12 +93,17 @@ extern const char iconvg_error_bad_metadata_suggested_palette[];  // ¶0.1
 extern const char iconvg_error_bad_metadata_viewbox[];            // ¶0.1
 extern const char iconvg_error_bad_number[];                      // ¶0.1
 extern const char iconvg_error_bad_opcode_length[];               // ¶0.1
+extern const char iconvg_error_bad_pack[];                        // ¶0.1
+extern const char iconvg_error_bad_segref[];                      // ¶0.1
 
-extern const char iconvg_error_system_failure_out_of_memory[];  // ¶0.1
+extern const char iconvg_error_system_failure_could_not_read_file[];  // ¶0.1
+extern const char iconvg_error_system_failure_out_of_memory[];        // ¶0.1
 
 extern const char iconvg_error_invalid_backend_not_enabled[];   // ¶0.1
 extern const char iconvg_error_invalid_constructor_argument[];  // ¶0.1
+extern const char iconvg_error_invalid_encoder_call[];          // ¶0.1
 extern const char iconvg_error_invalid_paint_type[];            // ¶0.1
+extern const char iconvg_error_invalid_trace[];                 // ¶0.1
 extern const char iconvg_error_invalid_vtable[];                // ¶0.1
 
 // ----
@@ -255,6 +261,59 @@ iconvg_matrix_2x3_f64__determinant(  // ¶0.1
 
 // ----
 
+// iconvg_allocator is a caller-supplied memory allocator, such as a
+// per-request arena, for the library's own heap allocations. Decoding itself
+// (iconvg_decode and the built-in canvases other than Cairo and Skia) never
+// allocates. The allocations are iconvg_write_display_list_cache's and
+// iconvg_write_c_source's working buffers and the file contents that
+// iconvg_file__open (and so the etc__open_mmap functions) reads instead of
+// mapping. The Cairo and Skia
+// libraries allocate their own objects (patterns, paths, paints and shaders)
+// through their own allocators, which IconVG cannot redirect.
+//
+// If alloc_func is NULL then malloc, realloc and free are used and the other
+// two funcs are ignored. Otherwise, a NULL realloc_func means alloc_func,
+// memcpy and free_func, and a NULL free_func means that freeing is a no-op
+// (as for an arena that is released all at once). realloc_func and free_func
+// are passed the size of the existing allocation, so that they don't have to
+// record it, and realloc_func's ptr may be NULL (with an old_n of zero).
+//
+// The library updates the num_etc and peak_bytes_in_use fields. The call
+// counts include failed calls. num_bytes_requested is the sum of the sizes
+// passed to successful alloc and realloc calls: an upper bound on what an
+// arena that never reuses memory would consume. If bytes_in_use_limit is
+// non-zero then calls that would take num_bytes_in_use above it fail (and the
+// library function reports iconvg_error_system_failure_out_of_memory) without
+// reaching alloc_func or realloc_func.
+//
+// The library does not synchronize access: an iconvg_allocator should not be
+// used by multiple threads concurrently.
+//
+// Example code:
+//   iconvg_allocator a = {0};
+//   a.alloc_func = &my_arena_alloc;
+//   a.context = my_arena;
+//   a.bytes_in_use_limit = 16 << 20;
+//   iconvg_decode_options opts = {0};
+//   opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+//   opts.allocator = &a;
+typedef struct iconvg_allocator_struct {
+  void* (*alloc_func)(void* context, size_t n);
+  void* (*realloc_func)(void* context, void* ptr, size_t old_n, size_t new_n);
+  void (*free_func)(void* context, void* ptr, size_t n);
+  void* context;
+  uint64_t bytes_in_use_limit;
+
+  uint64_t num_alloc_calls;
+  uint64_t num_realloc_calls;
+  uint64_t num_free_calls;
+  uint64_t num_bytes_requested;
+  uint64_t num_bytes_in_use;
+  uint64_t peak_bytes_in_use;
+} iconvg_allocator;  // ¶0.1
+
+// ----
+
 // iconvg_decode_options holds the optional arguments to iconvg_decode.
 //
 // Example code:
@@ -283,8 +342,45 @@ typedef struct iconvg_decode_options_struct {
   iconvg_palette* palette;
 
   // The fields above are ¶0.1
+
+  // dst_transform, if non-NULL, is an affine transformation applied after
+  // mapping the viewbox to the dst_rect argument to iconvg_decode. It maps
+  // from that dst_rect's coordinate space to the canvas', and applies to both
+  // path coordinates and gradient transformation matrices. For example, it
+  // can rotate or skew an icon without changing the canvas' own transform.
+  //
+  // It does not affect the default height_in_pixels, which is still the
+  // dst_rect's height.
+  const iconvg_matrix_2x3_f64* dst_transform;
+
+  // allocator, if non-NULL, is used (instead of malloc, realloc and free) by
+  // the functions that take an iconvg_decode_options and allocate memory, such
+  // as iconvg_write_display_list_cache. iconvg_decode itself never allocates.
+  iconvg_allocator* allocator;
+
+  // The fields above are ¶0.2
 } iconvg_decode_options;  // ¶0.1
 
+// iconvg_validate_report holds the optional details from iconvg_validate.
+typedef struct iconvg_validate_report_struct {
+  // error_offset is the byte offset (relative to the start of src) of the
+  // magic identifier, metadata chunk or op that was invalid. It is src_len if
+  // src was valid or if the error was a jump op whose target lies beyond the
+  // last op.
+  size_t error_offset;
+
+  // num_metadata_chunks and num_ops are the number of metadata chunks and
+  // ops that were valid.
+  uint64_t num_metadata_chunks;
+  uint64_t num_ops;
+} iconvg_validate_report;  // ¶0.1
+
+// ----
+
+// iconvg_fixed_24_8 is a signed fixed point number with 24 integer bits and 8
+// fractional bits. For example, 0x00000180 represents 1.5.
+typedef int32_t iconvg_fixed_24_8;  // ¶0.1
+
 // ----
 
 // iconvg_canvas is conceptually a 'virtual super-class' with e.g. Cairo-backed
@@ -335,6 +431,32 @@ typedef struct iconvg_canvas_vtable_struct {
       const iconvg_palette* suggested_palette);
 
   // The fields above are ¶0.1
+
+  // The optional fields below are like the begin_path and path_etc_to fields,
+  // but with dst coordinates as 24.8 fixed point numbers. The decoder only
+  // calls them if it was built with the ICONVG_CONFIG__FIXED_POINT macro
+  // defined (see iconvg_decode). A NULL field means to call its floating
+  // point equivalent instead.
+  const char* (*begin_path__fixed)(struct iconvg_canvas_struct* c,
+                                   iconvg_fixed_24_8 x0,
+                                   iconvg_fixed_24_8 y0);
+  const char* (*path_line_to__fixed)(struct iconvg_canvas_struct* c,
+                                     iconvg_fixed_24_8 x1,
+                                     iconvg_fixed_24_8 y1);
+  const char* (*path_quad_to__fixed)(struct iconvg_canvas_struct* c,
+                                     iconvg_fixed_24_8 x1,
+                                     iconvg_fixed_24_8 y1,
+                                     iconvg_fixed_24_8 x2,
+                                     iconvg_fixed_24_8 y2);
+  const char* (*path_cube_to__fixed)(struct iconvg_canvas_struct* c,
+                                     iconvg_fixed_24_8 x1,
+                                     iconvg_fixed_24_8 y1,
+                                     iconvg_fixed_24_8 x2,
+                                     iconvg_fixed_24_8 y2,
+                                     iconvg_fixed_24_8 x3,
+                                     iconvg_fixed_24_8 y3);
+
+  // The fields above are ¶0.2
 } iconvg_canvas_vtable;  // ¶0.1
 
 typedef struct iconvg_canvas_struct {
@@ -362,6 +484,387 @@ typedef struct iconvg_canvas_struct {
 
 // ----
 
+// ICONVG_HISTOGRAM__NUM_BUCKETS is the number of buckets in an
+// iconvg_histogram.
+#define ICONVG_HISTOGRAM__NUM_BUCKETS 40
+
+// iconvg_histogram is a log-bucketed histogram of non-negative integer
+// values, such as latencies in nanoseconds.
+//
+// buckets[0] counts the zero values. For 0 < i < (NUM_BUCKETS - 1),
+// buckets[i] counts the values v such that (2**(i-1) <= v) and (v < 2**i).
+// The last bucket also counts all larger values.
+//
+// A zero-valued iconvg_histogram is empty and ready to use.
+typedef struct iconvg_histogram_struct {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t max;
+  uint64_t buckets[ICONVG_HISTOGRAM__NUM_BUCKETS];
+} iconvg_histogram;  // ¶0.1
+
+// iconvg_profile holds the statistics gathered by a profiler canvas (see
+// iconvg_canvas__make_profiler). A zero-valued iconvg_profile is empty and
+// ready to use.
+//
+// Latencies are measured around the calls to the wrapped canvas, in
+// nanoseconds, using a monotonic clock.
+typedef struct iconvg_profile_struct {
+  // num_calls counts the calls to each iconvg_canvas_vtable method.
+  struct {
+    uint64_t begin_decode;
+    uint64_t end_decode;
+    uint64_t begin_drawing;
+    uint64_t end_drawing;
+    uint64_t begin_path;
+    uint64_t end_path;
+    uint64_t path_line_to;
+    uint64_t path_quad_to;
+    uint64_t path_cube_to;
+    uint64_t on_metadata_viewbox;
+    uint64_t on_metadata_suggested_palette;
+  } num_calls;
+
+  // num_failed_decodes counts the end_decode calls with a non-NULL err_msg.
+  uint64_t num_failed_decodes;
+
+  // num_drawings_by_paint_type counts the end_drawing calls, indexed by the
+  // iconvg_paint_type of their paint.
+  uint64_t num_drawings_by_paint_type[4];
+
+  // segments_per_path has one value per path: its number of path_etc_to
+  // calls between begin_path and end_path.
+  iconvg_histogram segments_per_path;
+
+  // stops_per_gradient has one value per gradient paint: its number of
+  // gradient stops.
+  iconvg_histogram stops_per_gradient;
+
+  // end_drawing_nanos holds the latencies of the wrapped canvas' end_drawing
+  // calls. For most backends, this is when the pixels are filled.
+  iconvg_histogram end_drawing_nanos;
+
+  // path_nanos holds the latencies of the wrapped canvas' begin_path,
+  // end_path and path_etc_to calls.
+  iconvg_histogram path_nanos;
+} iconvg_profile;  // ¶0.1
+
+// ----
+
+// ICONVG_TRACE__RECORD_SIZE is the size, in bytes, of each record written by
+// a trace canvas.
+#define ICONVG_TRACE__RECORD_SIZE 32
+
+// iconvg_trace is where a trace canvas (see iconvg_canvas__make_trace)
+// writes its binary records, one or more fixed size records per vtable call.
+// Records hold their arguments' raw bits (including a snapshot of the paint
+// passed to end_drawing), without any text formatting, and can be fed back
+// into another canvas by iconvg_trace__replay.
+//
+// If ptr is non-NULL then the records are written to the ring buffer ptr[..
+// len], overwriting the oldest records once full. len should be a multiple
+// of ICONVG_TRACE__RECORD_SIZE and any remainder is unused.
+//
+// If file is non-NULL then the records are also written (appended) to file.
+// Check ferror(file) afterwards to detect write errors.
+//
+// num_records counts the records written so far. Both ptr and file may be
+// NULL, in which case only num_records is updated.
+//
+// A trace file's contents, read back into memory, can be replayed by setting
+// ptr and len to that memory and num_records to (len / RECORD_SIZE).
+typedef struct iconvg_trace_struct {
+  uint8_t* ptr;
+  size_t len;
+  FILE* file;
+  uint64_t num_records;
+} iconvg_trace;  // ¶0.1
+
+// ----
+
+// iconvg_file holds an entire file's contents, ptr[.. len], which can be
+// passed straight to iconvg_decode. There is no size limit other than the
+// address space.
+//
+// Regular files are memory-mapped read-only, if the platform supports mmap,
+// and is_mapped is true. Otherwise (for pipes, character devices such as
+// /dev/stdin, empty files or platforms without mmap), the contents are read
+// into memory, of capacity cap, allocated by allocator.
+typedef struct iconvg_file_struct {
+  const uint8_t* ptr;
+  size_t len;
+  size_t cap;
+  bool is_mapped;
+  iconvg_allocator* allocator;
+} iconvg_file;  // ¶0.1
+
+// ----
+
+// iconvg_pack is a read-only view of an IconVG pack: a single file holding
+// many named IconVG files, so that loading them all costs one open and one
+// mmap instead of an open and read per file.
+//
+// The pack format (all integers are little-endian) is:
+//   - a 32-byte header: the 8-byte magic "\x8AIVGpack", a u32 version (1), a
+//     u32 number of entries N, a u64 index offset (32) and a u64 total pack
+//     length.
+//   - an index of N 32-byte entries: a u64 name hash (64-bit FNV-1a), a u64
+//     blob offset, a u64 blob length, a u32 name offset and a u32 name
+//     length. Entries are sorted by name hash and then by name.
+//   - the names, each followed by a NUL byte.
+//   - the blobs (IconVG files), each starting at a 4096-byte aligned offset.
+//
+// cmd/iconvg-pack writes pack files.
+//
+// ptr and len hold the entire pack. file is what iconvg_pack__open_mmap
+// opened (and iconvg_pack__close closes), holding that memory. It is
+// zero-valued for iconvg_pack__open_bytes.
+typedef struct iconvg_pack_struct {
+  const uint8_t* ptr;
+  size_t len;
+  uint32_t num_entries;
+  iconvg_file file;
+} iconvg_pack;  // ¶0.1
+
+// iconvg_pack_entry is one of an iconvg_pack's named IconVG files. name (NUL
+// terminated, name_len bytes long, excluding the NUL) and ptr[.. len] point
+// into the pack, and are valid until the pack is closed. ptr[.. len] can be
+// passed straight to iconvg_decode.
+//
+// A zero-valued entry (with a NULL name) means that there was no such entry.
+typedef struct iconvg_pack_entry_struct {
+  const char* name;
+  size_t name_len;
+  const uint8_t* ptr;
+  size_t len;
+} iconvg_pack_entry;  // ¶0.1
+
+// ----
+
+// iconvg_display_list_cache is a read-only view of a display list cache: a
+// single file holding, for many IconVG files, the canvas calls that decoding
+// them makes, so that a warm start can replay those calls (see
+// iconvg_display_list_cache__replay) without running the bytecode interpreter.
+// Entries are keyed by their IconVG file's digest and length.
+//
+// The cache format (all numbers are little-endian) is:
+//   - a 32-byte header: the 8-byte magic "\x8AIVGdlst", a u32 version (2), a
+//     u32 number of entries N, a u64 palette key and a u64 total cache
+//     length. The palette key is zero if the cache was written without a
+//     custom palette, otherwise the first 8 bytes (as a u64) of the digest of
+//     that palette's 256 bytes, with the low bit set.
+//   - an index of N 40-byte entries: a 16-byte source digest, a u64 source
+//     length, a u64 body offset and a u64 body length. Entries are sorted by
+//     source digest (compared as bytes) and then by source length. The digest
+//     is the unkeyed 128-bit BLAKE2s (RFC 7693) digest.
+//   - the bodies, each starting at an 8-byte aligned offset.
+//
+// Each body holds the ViewBox (four f32 values), a u32 number of variants V,
+// u32 flags, the suggested palette (256 bytes, only if the flags' low bit is
+// set, otherwise it is the default palette) and V 16-byte variant headers: an
+// i64 minimum height_in_pixels, a u32 verb stream offset (relative to the
+// body) and a u32 verb stream length. Variants are sorted by minimum height, the
+// first one's being INT64_MIN, and each covers the heights up to the next
+// one's minimum. Files without Level of Detail jumps have only one variant.
+//
+// A verb stream is the flattened canvas calls between on_metadata_etc and
+// end_decode, each a verb byte followed by its arguments. Path coordinates
+// are f32 values in src (viewbox) coordinate space. Paints are resolved: flat
+// colors are stored as a u32 premultiplied color.
+//
+// iconvg_write_display_list_cache writes cache files.
+//
+// ptr and len hold the entire cache. file is what
+// iconvg_display_list_cache__open_mmap opened (and
+// iconvg_display_list_cache__close closes), holding that memory. It is
+// zero-valued for iconvg_display_list_cache__open_bytes.
+typedef struct iconvg_display_list_cache_struct {
+  const uint8_t* ptr;
+  size_t len;
+  uint32_t num_entries;
+  iconvg_file file;
+} iconvg_display_list_cache;  // ¶0.1
+
+// ----
+
+// iconvg_compiled_icon and the other iconvg_compiled_etc types are what the C
+// code generated by iconvg_write_c_source (or by the iconvg-to-c tool) is
+// built from. Users of that code don't need to know their details.
+//
+// A compiled icon has one variant function per distinct Level of Detail
+// range. Each makes the canvas calls that iconvg_decode would make, as
+// straight-line code with constant src (viewbox) space coordinates.
+
+struct iconvg_compiled_frame_struct;
+
+// iconvg_compiled_paint is an end_drawing call's paint. Its fields hold the
+// decoder's state at that call. regs points to the 64 color and number
+// registers. Bit i of palette_regs is set when the i'th register was never
+// written, so that it holds the i'th custom (or suggested) palette color,
+// whatever the palette is at run time. Bit k of live_regs is set when the
+// paint's methods can read the register numbered ((which_regs + k) & 63).
+typedef struct iconvg_compiled_paint_struct {
+  const uint64_t* regs;
+  uint64_t palette_regs;
+  uint64_t live_regs;
+  float transform[6];
+  uint8_t paint_type;
+  uint8_t spread;
+  uint8_t num_stops;
+  uint8_t which_regs;
+} iconvg_compiled_paint;  // ¶0.1
+
+// iconvg_compiled_variant is a variant function and the minimum
+// height_in_pixels that it applies to.
+typedef struct iconvg_compiled_variant_struct {
+  int64_t min_height_in_pixels;
+  const char* (*func)(iconvg_canvas* c,
+                      const struct iconvg_compiled_frame_struct* f);
+} iconvg_compiled_variant;  // ¶0.1
+
+// iconvg_compiled_icon is everything that a compiled icon knows about its
+// IconVG file. The variants are sorted by minimum height, the first one's
+// being INT64_MIN. A NULL suggested_palette means the default palette.
+typedef struct iconvg_compiled_icon_struct {
+  iconvg_rectangle_f32 viewbox;
+  const iconvg_palette* suggested_palette;
+  size_t src_len;
+  size_t num_variants;
+  const iconvg_compiled_variant* variants;
+} iconvg_compiled_icon;  // ¶0.1
+
+// iconvg_compiled_frame is a variant function's per-call state: the src to
+// dst coordinate transform (see iconvg_compiled_icon__decode) and the paint
+// that iconvg_compiled_frame__end_drawing passes to the canvas. The skew
+// fields are zero unless iconvg_decode_options.dst_transform rotates or
+// skews. The transform is:
+//
+//   dst_x = (src_x * s2d_scale_x) + (src_y * s2d_skew_x) + s2d_bias_x
+//   dst_y = (src_x * s2d_skew_y) + (src_y * s2d_scale_y) + s2d_bias_y
+typedef struct iconvg_compiled_frame_struct {
+  double s2d_scale_x;
+  double s2d_bias_x;
+  double s2d_scale_y;
+  double s2d_bias_y;
+  iconvg_paint* paint;
+  double s2d_skew_x;
+  double s2d_skew_y;
+} iconvg_compiled_frame;  // ¶0.1
+
+// ----
+
+// iconvg_encoder writes an IconVG file, op by op, into a caller-supplied
+// buffer. The encoder itself never allocates memory. When the buffer is full,
+// it calls grow_func (if non-NULL) to obtain a larger one.
+//
+// The encoded bytes so far are ptr[.. len] and the buffer's capacity is cap.
+// grow_func should set *ptr and *cap to a buffer of at least min_cap bytes
+// that starts with the old buffer's contents (as realloc would) or else
+// return an error. If grow_func is NULL then a full buffer is an
+// iconvg_error_system_failure_out_of_memory error.
+//
+// Methods that fail leave ptr[.. len] unchanged but, once one has failed,
+// every later method call returns that same error, so that callers can
+// check for errors only once, after iconvg_encoder__finish.
+//
+// private_impl's fields are private implementation details. Users should not
+// read or write them directly.
+typedef struct iconvg_encoder_struct {
+  uint8_t* ptr;
+  size_t len;
+  size_t cap;
+  const char* (*grow_func)(void* grow_context,
+                           uint8_t** ptr,
+                           size_t* cap,
+                           size_t min_cap);
+  void* grow_context;
+
+  struct {
+    const char* err_msg;
+    size_t run_offset;
+    uint32_t run_reps;
+    uint8_t run_opcode;
+    bool wrote_metadata;
+  } private_impl;
+} iconvg_encoder;  // ¶0.1
+
+// ----
+
+// iconvg_op_type says which iconvg_canvas_vtable method iconvg_decode would
+// have called for an iconvg_op. The NONE type means no more ops.
+typedef enum iconvg_op_type_enum {
+  ICONVG_OP_TYPE__NONE = 0,                           // ¶0.1
+  ICONVG_OP_TYPE__BEGIN_DRAWING = 1,                  // ¶0.1
+  ICONVG_OP_TYPE__END_DRAWING = 2,                    // ¶0.1
+  ICONVG_OP_TYPE__BEGIN_PATH = 3,                     // ¶0.1
+  ICONVG_OP_TYPE__END_PATH = 4,                       // ¶0.1
+  ICONVG_OP_TYPE__PATH_LINE_TO = 5,                   // ¶0.1
+  ICONVG_OP_TYPE__PATH_QUAD_TO = 6,                   // ¶0.1
+  ICONVG_OP_TYPE__PATH_CUBE_TO = 7,                   // ¶0.1
+  ICONVG_OP_TYPE__ON_METADATA_VIEWBOX = 8,            // ¶0.1
+  ICONVG_OP_TYPE__ON_METADATA_SUGGESTED_PALETTE = 9,  // ¶0.1
+} iconvg_op_type;                                     // ¶0.1
+
+// iconvg_op is one iconvg_canvas_vtable method call, as data. Its fields are
+// that method's arguments and fields that don't apply to its type are zero.
+// The coordinates are in dst space. For example, a PATH_QUAD_TO op's x1, y1,
+// x2 and y2 are the path_quad_to method's arguments.
+//
+// paint (for END_DRAWING ops) points into the iconvg_op_iterator and is
+// valid until the next iconvg_op_iterator__next call. suggested_palette
+// (for ON_METADATA_SUGGESTED_PALETTE ops) is valid for the iterator's
+// lifetime.
+typedef struct iconvg_op_struct {
+  iconvg_op_type type;
+  float x0;
+  float y0;
+  float x1;
+  float y1;
+  float x2;
+  float y2;
+  float x3;
+  float y3;
+  iconvg_rectangle_f32 viewbox;
+  const iconvg_palette* suggested_palette;
+  const iconvg_paint* paint;
+} iconvg_op;  // ¶0.1
+
+// ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE is the number of uint64_t elements
+// that an iconvg_op_iterator reserves for its (opaque) iconvg_paint.
+#define ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE 128
+
+// ICONVG_OP_ITERATOR__MAX_PENDING_OPS is the capacity of an
+// iconvg_op_iterator's queue of ops produced but not yet returned. A single
+// IconVG opcode produces at most this many ops, other than those that repeat
+// (e.g. a LineTo with 100 coordinate pairs), which are produced one by one.
+#define ICONVG_OP_ITERATOR__MAX_PENDING_OPS 8
+
+// iconvg_op_iterator is a pull-style alternative to iconvg_decode. Instead of
+// calling an iconvg_canvas' methods, it returns each call as an iconvg_op,
+// one per iconvg_op_iterator__next call. It never allocates memory: it only
+// holds the src bytes' pointer (which must stay valid while iterating) and a
+// fixed amount of decoder state.
+//
+// private_impl's fields are private implementation details. Users should not
+// read or write them directly.
+typedef struct iconvg_op_iterator_struct {
+  struct {
+    const char* err_msg;
+    const uint8_t* src_ptr;
+    size_t src_len;
+    uint32_t num_reps;
+    uint8_t rep_opcode;
+    bool done;
+    uint8_t ops_ri;
+    uint8_t ops_wi;
+    iconvg_op ops[ICONVG_OP_ITERATOR__MAX_PENDING_OPS];
+    iconvg_palette suggested_palette;
+    uint64_t paint[ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE];
+  } private_impl;
+} iconvg_op_iterator;  // ¶0.1
+
+// ----
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -407,6 +910,53 @@ iconvg_canvas__make_debug(  // ¶0.1
     const char* message_prefix,
     iconvg_canvas* wrapped);
 
+// iconvg_canvas__make_profiler returns an iconvg_canvas that forwards vtable
+// calls on to the wrapped iconvg_canvas, recording statistics about those
+// calls (and how long the wrapped canvas took to respond) in *profile.
+//
+// Unlike iconvg_canvas__make_debug, its overhead (on the order of two clock
+// reads per path or drawing call) is low enough for production use, but it
+// is not thread-safe. To profile multiple threads, give each thread its own
+// iconvg_profile and combine them afterwards with iconvg_profile__merge.
+//
+// The monotonic clock is clock_gettime(CLOCK_MONOTONIC) if <time.h> provides
+// it, which on some systems requires defining _POSIX_C_SOURCE (to 199309L or
+// later) before #include'ing this library. Otherwise, it falls back to C11's
+// timespec_get or, failing that, to the (per-process CPU time) clock function.
+//
+// profile may be NULL, in which case nothing is recorded.
+//
+// wrapped may be NULL, in which case the iconvg_canvas vtable calls always
+// return success (a NULL error message) except that end_decode returns its
+// (possibly non-NULL) err_msg argument unchanged.
+//
+// If any of the pointer-typed arguments are non-NULL then the caller of this
+// function is responsible for ensuring that the pointers remain valid while
+// the returned iconvg_canvas is in use.
+iconvg_canvas                  //
+iconvg_canvas__make_profiler(  // ¶0.1
+    iconvg_canvas* wrapped,
+    iconvg_profile* profile);
+
+// iconvg_canvas__make_trace returns an iconvg_canvas that appends binary
+// records of the vtable calls to *trace before forwarding the call on to the
+// wrapped iconvg_canvas. It is a compact, cheaper alternative to
+// iconvg_canvas__make_debug, intended for capturing production renders.
+//
+// trace may be NULL, in which case nothing is recorded.
+//
+// wrapped may be NULL, in which case the iconvg_canvas vtable calls always
+// return success (a NULL error message) except that end_decode returns its
+// (possibly non-NULL) err_msg argument unchanged.
+//
+// If any of the pointer-typed arguments are non-NULL then the caller of this
+// function is responsible for ensuring that the pointers remain valid while
+// the returned iconvg_canvas is in use.
+iconvg_canvas               //
+iconvg_canvas__make_trace(  // ¶0.1
+    iconvg_canvas* wrapped,
+    iconvg_trace* trace);
+
 // iconvg_canvas__does_nothing returns whether self is NULL or *self is
 // zero-valued or broken. Other canvas values are presumed to do something.
 // Zero-valued means the result of "iconvg_canvas c = {0}". Broken means the
@@ -473,6 +1023,26 @@ iconvg_canvas__make_skia(  // ¶0.1
 // this function, iconvg_decode, returns whatever end_decode returns.
 //
 // options may be NULL, in which case default values will be used.
+//
+// For profiling, the IconVG library can be built with the
+// ICONVG_CONFIG__OP_OBSERVER(op_ptr) macro defined. It is then invoked, with
+// a const uint8_t* pointing into src, just before each op is executed. Ops
+// that are skipped over (by a jump op) are not observed.
+//
+// With GCC or Clang, the bytecode interpreter dispatches each op with a
+// computed goto (a GNU C extension). Building the IconVG library with the
+// ICONVG_CONFIG__DISABLE_COMPUTED_GOTO macro defined uses a portable switch
+// statement instead.
+//
+// For targets without floating point hardware, the IconVG library can be
+// built with the ICONVG_CONFIG__FIXED_POINT macro defined. Path coordinates
+// are then decoded as 24.8 fixed point numbers, and transformed to dst space
+// (and expanded from Ellipse ops) with integer arithmetic. Only 4-byte
+// coordinates, setting up each decode's transform and calling a canvas
+// without the vtable's optional etc__fixed fields need floating point. The
+// results can differ from the default build's by about 1/256 of a src unit
+// (times the src-to-dst scale). Coordinates beyond ±(1 << 23) saturate, as do
+// scales beyond 4096 dst units per src unit.
 const char*     //
 iconvg_decode(  // ¶0.1
     iconvg_canvas* dst_canvas,
@@ -481,6 +1051,52 @@ iconvg_decode(  // ¶0.1
     size_t src_len,
     const iconvg_decode_options* options);
 
+struct iovec;
+
+// iconvg_decode_iov is like iconvg_decode but the src IconVG-formatted data is
+// the concatenation of iov[0 .. iovcnt], each a POSIX struct iovec (on
+// platforms without <sys/uio.h>, one with the same iov_base and iov_len
+// fields). The fragments need not be coalesced: numbers and coordinates that
+// straddle fragment boundaries are copied into a small internal buffer, and
+// everything else is read in place.
+//
+// ICONVG_CONFIG__OP_OBSERVER's op_ptr points into one of the fragments.
+const char*         //
+iconvg_decode_iov(  // ¶0.1
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const struct iovec* iov,
+    int iovcnt,
+    const iconvg_decode_options* options);
+
+// iconvg_op_iterator__make returns an iterator over the iconvg_op values
+// that iconvg_decode(canvas, dst_rect, src_ptr, src_len, options) would pass
+// to its canvas, other than begin_decode and end_decode. src_ptr[.. src_len]
+// must remain valid while the iterator is in use. options may be NULL.
+//
+// Example code:
+//   iconvg_op_iterator it = iconvg_op_iterator__make(r, ptr, len, NULL);
+//   iconvg_op op;
+//   while (!(err = iconvg_op_iterator__next(&it, &op)) &&
+//          (op.type != ICONVG_OP_TYPE__NONE)) {
+//     etc;
+//   }
+iconvg_op_iterator         //
+iconvg_op_iterator__make(  // ¶0.1
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// iconvg_op_iterator__next sets *dst_op to the next op. After the last op, it
+// sets dst_op->type to ICONVG_OP_TYPE__NONE. Decoding errors are returned
+// after the ops that iconvg_decode would have produced before that error.
+// Once it returns NONE or an error, it keeps doing so.
+const char*                //
+iconvg_op_iterator__next(  // ¶0.1
+    iconvg_op_iterator* self,
+    iconvg_op* dst_op);
+
 // iconvg_decode_viewbox sets *dst_viewbox to the ViewBox Metadata from the src
 // IconVG-formatted data.
 //
@@ -495,6 +1111,28 @@ iconvg_decode_viewbox(  // ¶0.1
     const uint8_t* src_ptr,
     size_t src_len);
 
+// iconvg_validate checks that src is well-formed IconVG data, returning NULL
+// if so or else the first file format error. That error is the same as what
+// iconvg_decode would return for an op that it executes, other than
+// iconvg_error_bad_segref, which only iconvg_validate checks for.
+//
+// It is much cheaper than iconvg_decode with a broken canvas, as it only
+// checks lengths, number encodings, jump targets, Call ops' SegRefs and
+// gradient register windows. It does not convert coordinates to dst space
+// or call any canvas methods.
+//
+// Every op is checked, regardless of the rendering height or whether a Level
+// of Detail or other jump would skip over it (or whether a RET op precedes
+// it). A valid src is therefore decodable at any height, but some src that
+// iconvg_decode accepts (at some heights) are rejected.
+//
+// report may be NULL. If not, it is filled in, whether or not src is valid.
+const char*       //
+iconvg_validate(  // ¶0.1
+    const uint8_t* src_ptr,
+    size_t src_len,
+    iconvg_validate_report* report);
+
 // ----
 
 // iconvg_paint__type returns what type of paint self is.
@@ -585,6 +1223,459 @@ iconvg_paint__gradient_transformation_matrix(  // ¶0.1
 
 // ----
 
+// iconvg_histogram__add adds one value to self.
+void                    //
+iconvg_histogram__add(  // ¶0.1
+    iconvg_histogram* self,
+    uint64_t value);
+
+// iconvg_histogram__merge adds all of other's values to self.
+void                      //
+iconvg_histogram__merge(  // ¶0.1
+    iconvg_histogram* self,
+    const iconvg_histogram* other);
+
+// iconvg_histogram__percentile returns an upper bound (the exclusive upper
+// bound of the matching bucket, capped at self->max) for the p'th percentile
+// value, where p ranges from 0.0 to 100.0. It returns zero if self is empty.
+uint64_t                       //
+iconvg_histogram__percentile(  // ¶0.1
+    const iconvg_histogram* self,
+    double p);
+
+// ----
+
+// iconvg_profile__merge adds all of other's statistics to self. It can be
+// used to combine per-thread profiles.
+void                    //
+iconvg_profile__merge(  // ¶0.1
+    iconvg_profile* self,
+    const iconvg_profile* other);
+
+// iconvg_profile__write_json writes self to f as a JSON object. Histograms
+// are written as their count, sum, max, p50, p90 and p99 and their non-empty
+// buckets (keyed by each bucket's exclusive upper bound).
+//
+// Check ferror(f) afterwards to detect write errors.
+void                         //
+iconvg_profile__write_json(  // ¶0.1
+    const iconvg_profile* self,
+    FILE* f);
+
+// ----
+
+// iconvg_trace__replay calls c's vtable methods as recorded in self, oldest
+// record first. If the ring buffer has wrapped around, records before the
+// oldest complete begin_decode record are skipped.
+//
+// As with iconvg_decode, if one of c's methods (other than end_decode)
+// returns an error then the rest of that decode's records are skipped and
+// c's end_decode is called with that error. Otherwise, end_decode is called
+// with the recorded err_msg. Recorded error messages that aren't built-in
+// iconvg_error_etc constants are replayed as iconvg_error_invalid_trace.
+//
+// The iconvg_paint passed to end_drawing is a snapshot: its iconvg_paint__etc
+// methods return what the recorded paint's did, for the methods that apply to
+// its paint type.
+//
+// It returns the first non-NULL end_decode result, or
+// iconvg_error_invalid_trace if self's records are malformed.
+const char*            //
+iconvg_trace__replay(  // ¶0.1
+    const iconvg_trace* self,
+    iconvg_canvas* c);
+
+// ----
+
+// iconvg_file__open loads the file at path, memory-mapping it if possible
+// and otherwise reading it into memory allocated by allocator, which may be
+// NULL.
+//
+// On success, the caller is responsible for calling iconvg_file__close, and
+// the allocator must outlive the iconvg_file. On failure, *self is zeroed and
+// nothing needs closing.
+const char*         //
+iconvg_file__open(  // ¶0.1
+    iconvg_file* self,
+    const char* path,
+    iconvg_allocator* allocator);
+
+// iconvg_file__open_stream is like iconvg_file__open but reads f (such as
+// stdin) until EOF. It does not close f.
+const char*                //
+iconvg_file__open_stream(  // ¶0.1
+    iconvg_file* self,
+    FILE* f,
+    iconvg_allocator* allocator);
+
+// iconvg_file__close releases self's memory and zeroes *self.
+void                 //
+iconvg_file__close(  // ¶0.1
+    iconvg_file* self);
+
+// ----
+
+// iconvg_pack__open_mmap opens the pack file at path with iconvg_file__open,
+// memory-mapping it read-only where possible (or else reading it into memory
+// allocated by allocator, which may be NULL), and checks its header and index.
+//
+// On success, the caller is responsible for calling iconvg_pack__close, and
+// the allocator must outlive the pack. On failure, *self is zeroed and
+// nothing needs closing.
+const char*              //
+iconvg_pack__open_mmap(  // ¶0.1
+    iconvg_pack* self,
+    const char* path,
+    iconvg_allocator* allocator);
+
+// iconvg_pack__open_bytes is like iconvg_pack__open_mmap but the pack is
+// already in memory. The caller owns ptr[.. len], which must remain valid
+// until the pack is no longer used. Calling iconvg_pack__close is optional.
+const char*               //
+iconvg_pack__open_bytes(  // ¶0.1
+    iconvg_pack* self,
+    const uint8_t* ptr,
+    size_t len);
+
+// iconvg_pack__close releases self's memory (if iconvg_pack__open_mmap
+// obtained it) and zeroes *self.
+void                 //
+iconvg_pack__close(  // ¶0.1
+    iconvg_pack* self);
+
+// iconvg_pack__find returns the entry named name[.. name_len], using a binary
+// search of the index, or a zero-valued entry if there is no such entry.
+iconvg_pack_entry   //
+iconvg_pack__find(  // ¶0.1
+    const iconvg_pack* self,
+    const char* name,
+    size_t name_len);
+
+// iconvg_pack__entry returns the i'th entry in index order (sorted by name
+// hash), or a zero-valued entry if i is out of bounds.
+iconvg_pack_entry    //
+iconvg_pack__entry(  // ¶0.1
+    const iconvg_pack* self,
+    uint32_t i);
+
+// ----
+
+// iconvg_write_display_list_cache decodes the num_srcs IconVG files
+// src_ptrs[i][.. src_lens[i]] and writes their display lists to f, in the
+// iconvg_display_list_cache format. Each file is decoded once per distinct
+// Level of Detail range, so that the cache serves every height_in_pixels.
+//
+// options->palette, if non-NULL, is baked into the cache's resolved colors.
+// options->height_in_pixels is ignored.
+//
+// Files that iconvg_validate rejects, files with more than 64 distinct Level
+// of Detail thresholds and duplicate files are left out of the cache, so that
+// replaying them falls back to iconvg_decode.
+//
+// It returns iconvg_error_system_failure_out_of_memory if it could not
+// allocate its working memory (from options->allocator, if non-NULL). Check
+// ferror(f) afterwards to detect write errors.
+const char*                       //
+iconvg_write_display_list_cache(  // ¶0.1
+    FILE* f,
+    const uint8_t* const* src_ptrs,
+    const size_t* src_lens,
+    size_t num_srcs,
+    const iconvg_decode_options* options);
+
+// iconvg_display_list_cache__open_mmap opens the cache file at path with
+// iconvg_file__open, memory-mapping it read-only where possible (or else
+// reading it into memory allocated by allocator, which may be NULL), and
+// checks its header and index.
+//
+// On success, the caller is responsible for calling
+// iconvg_display_list_cache__close, and the allocator must outlive the cache.
+// On failure, *self is zeroed and nothing needs closing.
+const char*                            //
+iconvg_display_list_cache__open_mmap(  // ¶0.1
+    iconvg_display_list_cache* self,
+    const char* path,
+    iconvg_allocator* allocator);
+
+// iconvg_display_list_cache__open_bytes is like
+// iconvg_display_list_cache__open_mmap but the cache is already in memory. The
+// caller owns ptr[.. len], which must remain valid until the cache is no
+// longer used. Calling iconvg_display_list_cache__close is optional.
+const char*                             //
+iconvg_display_list_cache__open_bytes(  // ¶0.1
+    iconvg_display_list_cache* self,
+    const uint8_t* ptr,
+    size_t len);
+
+// iconvg_display_list_cache__close releases self's memory (if
+// iconvg_display_list_cache__open_mmap obtained it) and zeroes *self.
+void                               //
+iconvg_display_list_cache__close(  // ¶0.1
+    iconvg_display_list_cache* self);
+
+// iconvg_display_list_cache__contains returns whether
+// iconvg_display_list_cache__replay, given the same arguments, would replay
+// from the cache instead of falling back to iconvg_decode.
+bool                                  //
+iconvg_display_list_cache__contains(  // ¶0.1
+    const iconvg_display_list_cache* self,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// iconvg_display_list_cache__replay is like iconvg_decode but, if self has an
+// entry for src_ptr[.. src_len] (and for options->palette), it calls
+// dst_canvas' methods from that entry instead of running the bytecode
+// interpreter. Finding the entry still computes src_ptr[.. src_len]'s digest.
+//
+// The calls are those that iconvg_decode would make, with the same arguments,
+// except that:
+//   - end_decode's num_bytes_consumed and num_bytes_remaining are src_len and
+//     0 (or 0 and src_len if one of dst_canvas' methods failed).
+//   - path coordinates were rounded to float32 in src space, not dst space.
+//     Where iconvg_decode computes them in float64 (e.g. for ellipses), they
+//     can differ in their least significant bits.
+//   - as with iconvg_trace__replay, the iconvg_paint passed to end_drawing is
+//     a snapshot.
+//
+// If there is no such entry, it calls iconvg_decode.
+const char*                         //
+iconvg_display_list_cache__replay(  // ¶0.1
+    const iconvg_display_list_cache* self,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    const iconvg_decode_options* options);
+
+// ----
+
+// iconvg_write_c_source writes C code to f that defines a function named
+// function_name, with the same signature as iconvg_decode minus the src_ptr
+// and src_len arguments:
+//
+//   const char* function_name(iconvg_canvas* dst_canvas,
+//                             iconvg_rectangle_f32 dst_rect,
+//                             const iconvg_decode_options* options);
+//
+// Calling it is like calling iconvg_decode on src_ptr[.. src_len], with the
+// differences listed for iconvg_display_list_cache__replay, but without
+// running the bytecode interpreter. options->palette and
+// options->height_in_pixels still apply. The code refers to static
+// definitions whose names start with function_name followed by two
+// underscores. It does not #include the IconVG header: the caller writes
+// that (and any other preamble) first.
+//
+// function_name must be a valid C identifier. It returns an error if
+// iconvg_validate rejects src_ptr[.. src_len]. Files with more than 64
+// distinct Level of Detail thresholds are not compiled: the function instead
+// embeds the file and calls iconvg_decode. Its working memory comes from
+// allocator, which may be NULL. Check ferror(f) afterwards to detect write
+// errors.
+const char*             //
+iconvg_write_c_source(  // ¶0.1
+    FILE* f,
+    const char* function_name,
+    const uint8_t* src_ptr,
+    size_t src_len,
+    iconvg_allocator* allocator);
+
+// iconvg_compiled_icon__decode is what the function that iconvg_write_c_source
+// generates calls. It makes the begin_decode and on_metadata_etc calls, picks
+// the variant for the height_in_pixels and calls that variant's function with
+// a frame whose scale and bias transform from src to dst coordinates:
+//
+//   dst_x = (src_x * s2d_scale_x) + s2d_bias_x
+//   dst_y = (src_y * s2d_scale_y) + s2d_bias_y
+//
+// It then calls end_decode as iconvg_display_list_cache__replay does.
+const char*                    //
+iconvg_compiled_icon__decode(  // ¶0.1
+    const iconvg_compiled_icon* self,
+    iconvg_canvas* dst_canvas,
+    iconvg_rectangle_f32 dst_rect,
+    const iconvg_decode_options* options);
+
+// iconvg_compiled_frame__end_drawing calls c's end_drawing method with self's
+// paint, set up to be equivalent to the decoder's, given paint.
+const char*                          //
+iconvg_compiled_frame__end_drawing(  // ¶0.1
+    const iconvg_compiled_frame* self,
+    iconvg_canvas* c,
+    const iconvg_compiled_paint* paint);
+
+// ----
+
+// iconvg_encoder__initialize sets self to encode into ptr[.. cap], with the
+// given grow_func and grow_context (see iconvg_encoder). ptr may be NULL if
+// cap is zero. Re-initializing an encoder starts a new IconVG file.
+const char*                  //
+iconvg_encoder__initialize(  // ¶0.1
+    iconvg_encoder* self,
+    uint8_t* ptr,
+    size_t cap,
+    const char* (*grow_func)(void* grow_context,
+                             uint8_t** ptr,
+                             size_t* cap,
+                             size_t min_cap),
+    void* grow_context);
+
+// iconvg_encoder__write_metadata writes the magic identifier and metadata.
+// viewbox and suggested_palette may be NULL, meaning the file format's
+// default values. Chunks that would only repeat the defaults are left out.
+//
+// If called at all, it must be called before any other write method.
+// Otherwise, the first op or iconvg_encoder__finish writes a default
+// (empty) metadata.
+const char*                      //
+iconvg_encoder__write_metadata(  // ¶0.1
+    iconvg_encoder* self,
+    const iconvg_rectangle_f32* viewbox,
+    const iconvg_palette* suggested_palette);
+
+// iconvg_encoder__move_to writes a ClosePathMoveTo op, closing any current
+// path and starting a new one at (x, y).
+//
+// Every coordinate number, for this and the other path ops, is written in
+// the shortest (1, 2 or 4 byte) encoding that represents it exactly. 4-byte
+// encodings round off the float32 mantissa's two lowest bits. NaN
+// coordinates are an iconvg_error_bad_coordinate error.
+const char*               //
+iconvg_encoder__move_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x,
+    float y);
+
+// iconvg_encoder__line_to writes a LineTo segment. Consecutive segments of
+// the same kind (consecutive line_to calls, consecutive quad_to calls or
+// consecutive cube_to calls) are merged into a single op with a RepCount.
+const char*               //
+iconvg_encoder__line_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x,
+    float y);
+
+// iconvg_encoder__quad_to writes a QuadTo segment, merged as per
+// iconvg_encoder__line_to.
+const char*               //
+iconvg_encoder__quad_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x1,
+    float y1,
+    float x2,
+    float y2);
+
+// iconvg_encoder__cube_to writes a CubeTo segment, merged as per
+// iconvg_encoder__line_to.
+const char*               //
+iconvg_encoder__cube_to(  // ¶0.1
+    iconvg_encoder* self,
+    float x1,
+    float y1,
+    float x2,
+    float y2,
+    float x3,
+    float y3);
+
+// iconvg_encoder__ellipse writes an Ellipse op, whose num_quarters must be in
+// the range [1 ..= 4]. The pen position and (x1, y1) and (x2, y2) are three
+// of the four corners of the ellipse's bounding parallelogram.
+const char*               //
+iconvg_encoder__ellipse(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t num_quarters,
+    float x1,
+    float y1,
+    float x2,
+    float y2);
+
+// iconvg_encoder__parallelogram writes a Parallelogram op. The pen position
+// and (x1, y1) and (x2, y2) are three of the parallelogram's four corners.
+const char*                     //
+iconvg_encoder__parallelogram(  // ¶0.1
+    iconvg_encoder* self,
+    float x1,
+    float y1,
+    float x2,
+    float y2);
+
+// iconvg_encoder__set_register sets REGS[SEL + adj] to value, where adj must
+// be in the range [0 ..= 15]. As per the file format, an adj of zero also
+// decrements SEL. It writes a 5-byte op if either half of value is zero,
+// otherwise a 9-byte op.
+const char*                    //
+iconvg_encoder__set_register(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint64_t value);
+
+// iconvg_encoder__set_registers decrements SEL by num_values and then sets
+// REGS[SEL + 1], REGS[SEL + 2], etc. to values[0], values[1], etc., using as
+// few ops as possible. num_values must be at most 64.
+const char*                     //
+iconvg_encoder__set_registers(  // ¶0.1
+    iconvg_encoder* self,
+    const uint64_t* values,
+    size_t num_values);
+
+// iconvg_encoder__add_to_sel adds delta (modulo 64) to SEL.
+const char*                  //
+iconvg_encoder__add_to_sel(  // ¶0.1
+    iconvg_encoder* self,
+    uint8_t delta);
+
+// iconvg_encoder__fill_flat writes a flat color Fill op, filling with
+// REGS[SEL + adj], where adj must be in the range [0 ..= 15]. As per the file
+// format, an adj of zero also first increments SEL.
+const char*                 //
+iconvg_encoder__fill_flat(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj);
+
+// iconvg_encoder__fill_flat_color fills with color. It sets the high 32 bits
+// of REGS[SEL + 1] (and zeroes its low 32 bits) and then fills with that
+// register. A non-sensible color means a blend, as per the file format.
+const char*                       //
+iconvg_encoder__fill_flat_color(  // ¶0.1
+    iconvg_encoder* self,
+    iconvg_premul_color color);
+
+// iconvg_encoder__fill_linear_gradient writes a linear gradient Fill op. The
+// num_stops (in the range [2 ..= 64]) gradient stops are REGS[SEL + adj],
+// REGS[SEL + adj + 1], etc., where adj must be in the range [0 ..= 15]. As
+// per the file format, an adj of zero also first increments SEL.
+//
+// nominal_matrix transforms from src (viewbox) space to gradient pattern
+// space. Only its first row is written (as float32 values), as linear
+// gradients ignore the second.
+const char*                            //
+iconvg_encoder__fill_linear_gradient(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix);
+
+// iconvg_encoder__fill_radial_gradient is like
+// iconvg_encoder__fill_linear_gradient but for a radial gradient, writing
+// both rows of nominal_matrix.
+const char*                            //
+iconvg_encoder__fill_radial_gradient(  // ¶0.1
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix);
+
+// iconvg_encoder__finish writes the metadata, if nothing has been written
+// yet, and returns the first error (if any) of all of self's method calls.
+// On success, the complete IconVG file is self->ptr[.. self->len].
+const char*              //
+iconvg_encoder__finish(  // ¶0.1
+    iconvg_encoder* self);
+
+// ----
+
 // iconvg_matrix_2x3_f64__inverse returns self's inverse.
 iconvg_matrix_2x3_f64            //
 iconvg_matrix_2x3_f64__inverse(  // ¶0.1
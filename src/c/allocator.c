@@ -0,0 +1,118 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#include <stdlib.h>
+
+// iconvg_private_allocator__admit returns whether growing a's bytes in use by
+// n (after shrinking it by m) stays within a's limit, if it has one.
+static bool  //
+iconvg_private_allocator__admit(const iconvg_allocator* a,
+                                size_t m,
+                                size_t n) {
+  if (a->bytes_in_use_limit == 0) {
+    return true;
+  }
+  uint64_t in_use = a->num_bytes_in_use - m;
+  return (in_use <= a->bytes_in_use_limit) &&
+         (n <= (a->bytes_in_use_limit - in_use));
+}
+
+static void  //
+iconvg_private_allocator__update(iconvg_allocator* a, size_t m, size_t n) {
+  a->num_bytes_requested += n;
+  a->num_bytes_in_use = (a->num_bytes_in_use - m) + n;
+  if (a->peak_bytes_in_use < a->num_bytes_in_use) {
+    a->peak_bytes_in_use = a->num_bytes_in_use;
+  }
+}
+
+void*  //
+iconvg_private_allocator__alloc(iconvg_allocator* a, size_t n) {
+  if (!a) {
+    return malloc(n);
+  }
+  a->num_alloc_calls++;
+  if (!iconvg_private_allocator__admit(a, 0, n)) {
+    return NULL;
+  }
+  void* ptr = a->alloc_func ? (*a->alloc_func)(a->context, n) : malloc(n);
+  if (ptr) {
+    iconvg_private_allocator__update(a, 0, n);
+  }
+  return ptr;
+}
+
+void*  //
+iconvg_private_allocator__realloc(iconvg_allocator* a,
+                                  void* ptr,
+                                  size_t old_n,
+                                  size_t new_n) {
+  if (!a) {
+    return realloc(ptr, new_n);
+  }
+  a->num_realloc_calls++;
+  if (!iconvg_private_allocator__admit(a, old_n, new_n)) {
+    return NULL;
+  }
+
+  void* new_ptr = NULL;
+  if (!a->alloc_func) {
+    new_ptr = realloc(ptr, new_n);
+  } else if (a->realloc_func) {
+    new_ptr = (*a->realloc_func)(a->context, ptr, old_n, new_n);
+  } else {
+    new_ptr = (*a->alloc_func)(a->context, new_n);
+    if (new_ptr && ptr) {
+      memcpy(new_ptr, ptr, (old_n < new_n) ? old_n : new_n);
+      if (a->free_func) {
+        (*a->free_func)(a->context, ptr, old_n);
+      }
+    }
+  }
+
+  if (new_ptr) {
+    iconvg_private_allocator__update(a, old_n, new_n);
+  }
+  return new_ptr;
+}
+
+void  //
+iconvg_private_allocator__free(iconvg_allocator* a, void* ptr, size_t n) {
+  if (!ptr) {
+    return;
+  } else if (!a) {
+    free(ptr);
+    return;
+  }
+  a->num_free_calls++;
+  a->num_bytes_in_use -= n;
+  if (!a->alloc_func) {
+    free(ptr);
+  } else if (a->free_func) {
+    (*a->free_func)(a->context, ptr, n);
+  }
+}
+
+iconvg_allocator*  //
+iconvg_private_allocator__from_options(const iconvg_decode_options* options) {
+  if (!options ||
+      (options->sizeof__iconvg_decode_options <
+       (offsetof(iconvg_decode_options, allocator) +
+        sizeof(options->allocator)))) {
+    return NULL;
+  }
+  return options->allocator;
+}
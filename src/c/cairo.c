@@ -233,6 +233,7 @@ static const char*  //
 iconvg_private_cairo_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
   cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
   cairo_move_to(cr, x0, y0);
+  iconvg_private_canvas__set_current_point(c, x0, y0);
   return NULL;
 }
 
@@ -249,6 +250,7 @@ iconvg_private_cairo_canvas__path_line_to(iconvg_canvas* c,
                                           float y1) {
   cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
   cairo_line_to(cr, x1, y1);
+  iconvg_private_canvas__set_current_point(c, x1, y1);
   return NULL;
 }
 
@@ -267,9 +269,16 @@ iconvg_private_cairo_canvas__path_quad_to(iconvg_canvas* c,
   // Here, we perform "degree elevation" from [x0, x1, x2] to [X0, X1, X2, X3]
   // = [x0, ((⅓ * x0) + (⅔ * x1)), ((⅔ * x1) + (⅓ * x2)), c2] and likewise for
   // the y dimension.
-  double X0;
-  double Y0;
-  cairo_get_current_point(cr, &X0, &Y0);
+  //
+  // We track x0 ourselves, instead of calling cairo_get_current_point, as
+  // Cairo would otherwise convert it back from its fixed-point path
+  // representation and through the inverse of its CTM (Current
+  // Transformation Matrix).
+  float x0;
+  float y0;
+  iconvg_private_canvas__current_point(c, &x0, &y0);
+  double X0 = ((double)x0);
+  double Y0 = ((double)y0);
   double twice_x1 = ((double)x1) * 2;
   double twice_y1 = ((double)y1) * 2;
   double X3 = ((double)x2);
@@ -279,6 +288,7 @@ iconvg_private_cairo_canvas__path_quad_to(iconvg_canvas* c,
   double X2 = (X3 + twice_x1) / 3;
   double Y2 = (Y3 + twice_y1) / 3;
   cairo_curve_to(cr, X1, Y1, X2, Y2, X3, Y3);
+  iconvg_private_canvas__set_current_point(c, x2, y2);
   return NULL;
 }
 
@@ -292,6 +302,7 @@ iconvg_private_cairo_canvas__path_cube_to(iconvg_canvas* c,
                                           float y3) {
   cairo_t* cr = (cairo_t*)(c->context.nonconst_ptr1);
   cairo_curve_to(cr, x1, y1, x2, y2, x3, y3);
+  iconvg_private_canvas__set_current_point(c, x3, y3);
   return NULL;
 }
 
@@ -322,6 +333,10 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_cairo_canvas__path_cube_to,
         &iconvg_private_cairo_canvas__on_metadata_viewbox,
         &iconvg_private_cairo_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
 };
 
 iconvg_canvas  //
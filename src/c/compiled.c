@@ -0,0 +1,843 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#include <stdlib.h>
+
+#define ICONVG_PRIVATE_COMPILED_OP__BEGIN_DRAWING 0x01
+#define ICONVG_PRIVATE_COMPILED_OP__END_DRAWING 0x02
+#define ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH 0x03
+#define ICONVG_PRIVATE_COMPILED_OP__END_PATH 0x04
+#define ICONVG_PRIVATE_COMPILED_OP__PATH_LINE_TO 0x05
+#define ICONVG_PRIVATE_COMPILED_OP__PATH_QUAD_TO 0x06
+#define ICONVG_PRIVATE_COMPILED_OP__PATH_CUBE_TO 0x07
+
+// ----
+
+// iconvg_private_compiled__blend_regs returns the live_regs bits for the
+// registers that a flat color's register value u (shifted right by 32) reads
+// if it is a blend, as per iconvg_private_paint__resolve.
+static inline uint64_t  //
+iconvg_private_compiled__blend_regs(uint32_t u) {
+  uint64_t m = 0;
+  if ((u != 0) && ((u >> 24) == 0)) {
+    uint32_t ug = 0xFF & (u >> 8);
+    uint32_t ub = 0xFF & (u >> 16);
+    if (ug >= 0xC0) {
+      m |= ((uint64_t)1) << (ug & 63);
+    }
+    if (ub >= 0xC0) {
+      m |= ((uint64_t)1) << (ub & 63);
+    }
+  }
+  return m;
+}
+
+const char*  //
+iconvg_compiled_frame__end_drawing(const iconvg_compiled_frame* self,
+                                   iconvg_canvas* c,
+                                   const iconvg_compiled_paint* paint) {
+  iconvg_paint* p = self->paint;
+  uint32_t which = paint->which_regs;
+  uint64_t live = paint->live_regs;
+  // A flat color that is still its palette color is usually premultiplied
+  // but, for unusual palettes, it can be a blend that reads other registers.
+  if ((paint->paint_type == ICONVG_PAINT_TYPE__FLAT_COLOR) &&
+      ((paint->palette_regs >> (which & 63)) & 1)) {
+    live |= iconvg_private_compiled__blend_regs(iconvg_private_peek_u32le(
+        &p->custom_palette.colors[which & 63].rgba[0]));
+  }
+
+  // Only the live registers need setting.
+  for (uint32_t k = 0; live; k++, live >>= 1) {
+    if (!(live & 1)) {
+      continue;
+    }
+    uint32_t i = (which + k) & 63;
+    if ((paint->palette_regs >> i) & 1) {
+      uint32_t u =
+          iconvg_private_peek_u32le(&p->custom_palette.colors[i].rgba[0]);
+      p->regs[i] = ((uint64_t)u) << 32;
+    } else {
+      p->regs[i] = paint->regs[i];
+    }
+  }
+  for (int i = 0; i < 6; i++) {
+    p->transform[i] = paint->transform[i];
+  }
+  p->paint_type = paint->paint_type;
+  p->spread = paint->spread;
+  p->num_stops = paint->num_stops;
+  p->which_regs = paint->which_regs;
+  return (*c->vtable->end_drawing)(c, p);
+}
+
+static const char*  //
+iconvg_private_compiled_icon__decode(const iconvg_compiled_icon* self,
+                                     iconvg_canvas* c,
+                                     iconvg_rectangle_f32 dst_rect,
+                                     const iconvg_decode_options* options) {
+  const iconvg_palette* suggested_palette =
+      self->suggested_palette ? self->suggested_palette
+                              : &iconvg_private_default_palette;
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, self->viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, suggested_palette));
+  if (self->num_variants == 0) {
+    return NULL;
+  }
+
+  iconvg_paint p;
+  p.viewbox = self->viewbox;
+  p.height_in_pixels = iconvg_private_height_in_pixels(dst_rect, options);
+  memcpy(&p.custom_palette,
+         (options && options->palette) ? options->palette : suggested_palette,
+         sizeof(p.custom_palette));
+  iconvg_private_initialize_remaining_paint_fields(
+      &p, dst_rect, iconvg_private_dst_transform(options));
+
+  iconvg_compiled_frame frame;
+  frame.s2d_scale_x = p.s2d_scale_x;
+  frame.s2d_bias_x = p.s2d_bias_x;
+  frame.s2d_scale_y = p.s2d_scale_y;
+  frame.s2d_bias_y = p.s2d_bias_y;
+  frame.paint = &p;
+  frame.s2d_skew_x = p.s2d_skew_x;
+  frame.s2d_skew_y = p.s2d_skew_y;
+
+  size_t i = self->num_variants - 1;
+  while ((i > 0) &&
+         (self->variants[i].min_height_in_pixels > p.height_in_pixels)) {
+    i--;
+  }
+  return (*self->variants[i].func)(c, &frame);
+}
+
+const char*  //
+iconvg_compiled_icon__decode(const iconvg_compiled_icon* self,
+                             iconvg_canvas* dst_canvas,
+                             iconvg_rectangle_f32 dst_rect,
+                             const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
+      sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_compiled_icon__decode(self, dst_canvas, dst_rect,
+                                                   options);
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg,
+                                           err_msg ? 0 : self->src_len,
+                                           err_msg ? self->src_len : 0);
+}
+
+// ----
+
+// The recording canvas appends to its ops and snapshots, given decoding with
+// the dst_rect set to the ViewBox, so that dst coordinates are src
+// coordinates.
+//
+// Each variant is decoded twice: once with the suggested palette and then,
+// with checking set, with every palette color changed. The second pass only
+// compares registers, to find those that still hold their initial palette
+// colors.
+
+typedef struct iconvg_private_compiled_op_struct {
+  uint32_t verb;
+  uint32_t snapshot_index;
+  float args[6];
+} iconvg_private_compiled_op;
+
+typedef struct iconvg_private_compiled_snapshot_struct {
+  uint64_t regs[64];
+  uint64_t palette_regs;
+  uint64_t live_regs;
+  float transform[6];
+  uint32_t paint_type;
+  uint32_t spread;
+  uint32_t num_stops;
+  uint32_t which_regs;
+} iconvg_private_compiled_snapshot;
+
+typedef struct iconvg_private_compiled_recorder_struct {
+  iconvg_private_compiled_op* ops;
+  size_t num_ops;
+  size_t cap_ops;
+  iconvg_private_compiled_snapshot* snapshots;
+  size_t num_snapshots;
+  size_t cap_snapshots;
+  bool checking;
+  size_t check_index;
+  iconvg_palette suggested_palette;
+  iconvg_allocator* allocator;
+} iconvg_private_compiled_recorder;
+
+// iconvg_private_compiled__grow returns ptr, an array (allocated by a)
+// holding len elements, or a reallocation of it, with room for at least one
+// more. It returns NULL on failure, leaving ptr as is.
+static void*  //
+iconvg_private_compiled__grow(iconvg_allocator* a,
+                              void* ptr,
+                              size_t* cap,
+                              size_t len,
+                              size_t elem_size) {
+  if (len < *cap) {
+    return ptr;
+  }
+  size_t new_cap = *cap ? (2 * *cap) : 256;
+  if ((new_cap <= *cap) || (new_cap > (SIZE_MAX / elem_size))) {
+    return NULL;
+  }
+  void* new_ptr = iconvg_private_allocator__realloc(
+      a, ptr, *cap * elem_size, new_cap * elem_size);
+  if (new_ptr) {
+    *cap = new_cap;
+  }
+  return new_ptr;
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__op(iconvg_canvas* c,
+                                     uint32_t verb,
+                                     float a0,
+                                     float a1,
+                                     float a2,
+                                     float a3,
+                                     float a4,
+                                     float a5) {
+  iconvg_private_compiled_recorder* r =
+      (iconvg_private_compiled_recorder*)(c->context.nonconst_ptr1);
+  if (r->checking) {
+    return NULL;
+  }
+  void* ops = iconvg_private_compiled__grow(r->allocator, r->ops, &r->cap_ops,
+                                            r->num_ops,
+                                            sizeof(iconvg_private_compiled_op));
+  if (!ops) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  r->ops = ops;
+  iconvg_private_compiled_op* o = &r->ops[r->num_ops++];
+  memset(o, 0, sizeof(*o));
+  o->verb = verb;
+  o->args[0] = a0;
+  o->args[1] = a1;
+  o->args[2] = a2;
+  o->args[3] = a3;
+  o->args[4] = a4;
+  o->args[5] = a5;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__begin_decode(iconvg_canvas* c,
+                                               iconvg_rectangle_f32 dst_rect) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__end_decode(iconvg_canvas* c,
+                                             const char* err_msg,
+                                             size_t num_bytes_consumed,
+                                             size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__begin_drawing(iconvg_canvas* c) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__BEGIN_DRAWING, 0, 0, 0, 0, 0, 0);
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__end_drawing(iconvg_canvas* c,
+                                              const iconvg_paint* p) {
+  iconvg_private_compiled_recorder* r =
+      (iconvg_private_compiled_recorder*)(c->context.nonconst_ptr1);
+  if (r->checking) {
+    if (r->check_index >= r->num_snapshots) {
+      return NULL;
+    }
+    iconvg_private_compiled_snapshot* s = &r->snapshots[r->check_index++];
+    for (int i = 0; i < 64; i++) {
+      if (s->regs[i] != p->regs[i]) {
+        s->regs[i] = 0;
+        s->palette_regs |= ((uint64_t)1) << i;
+      }
+    }
+    return NULL;
+  }
+
+  void* snapshots = iconvg_private_compiled__grow(
+      r->allocator, r->snapshots, &r->cap_snapshots, r->num_snapshots,
+      sizeof(iconvg_private_compiled_snapshot));
+  if (!snapshots) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  r->snapshots = snapshots;
+  iconvg_private_compiled_snapshot* s = &r->snapshots[r->num_snapshots];
+  memset(s, 0, sizeof(*s));
+  memcpy(s->regs, p->regs, sizeof(s->regs));
+  if (p->paint_type != ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    memcpy(s->transform, p->transform, sizeof(s->transform));
+  }
+  s->paint_type = p->paint_type;
+  s->spread = p->spread;
+  s->num_stops = p->num_stops;
+  s->which_regs = p->which_regs;
+
+  ICONVG_PRIVATE_TRY(iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__END_DRAWING, 0, 0, 0, 0, 0, 0));
+  r->ops[r->num_ops - 1].snapshot_index = (uint32_t)(r->num_snapshots++);
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__begin_path(iconvg_canvas* c,
+                                             float x0,
+                                             float y0) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH, x0, y0, 0, 0, 0, 0);
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__end_path(iconvg_canvas* c) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__END_PATH, 0, 0, 0, 0, 0, 0);
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__path_line_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__PATH_LINE_TO, x1, y1, 0, 0, 0, 0);
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__path_quad_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__PATH_QUAD_TO, x1, y1, x2, y2, 0, 0);
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__path_cube_to(iconvg_canvas* c,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2,
+                                               float x3,
+                                               float y3) {
+  return iconvg_private_compiled_recorder__op(
+      c, ICONVG_PRIVATE_COMPILED_OP__PATH_CUBE_TO, x1, y1, x2, y2, x3, y3);
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_compiled_recorder__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_private_compiled_recorder* r =
+      (iconvg_private_compiled_recorder*)(c->context.nonconst_ptr1);
+  memcpy(&r->suggested_palette, suggested_palette, sizeof(iconvg_palette));
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_compiled_recorder_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_compiled_recorder__begin_decode,
+        &iconvg_private_compiled_recorder__end_decode,
+        &iconvg_private_compiled_recorder__begin_drawing,
+        &iconvg_private_compiled_recorder__end_drawing,
+        &iconvg_private_compiled_recorder__begin_path,
+        &iconvg_private_compiled_recorder__end_path,
+        &iconvg_private_compiled_recorder__path_line_to,
+        &iconvg_private_compiled_recorder__path_quad_to,
+        &iconvg_private_compiled_recorder__path_cube_to,
+        &iconvg_private_compiled_recorder__on_metadata_viewbox,
+        &iconvg_private_compiled_recorder__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+// ----
+
+// iconvg_private_compiled_snapshot__prune sets s's live_regs and zeroes the
+// other registers (and their palette_regs bits), so that snapshots that only
+// differ in registers that their paint can't read are equal.
+static void  //
+iconvg_private_compiled_snapshot__prune(iconvg_private_compiled_snapshot* s) {
+  uint32_t which = s->which_regs & 63;
+  uint64_t live = 0;
+  if (s->paint_type == ICONVG_PAINT_TYPE__FLAT_COLOR) {
+    live = 1;
+    if (!((s->palette_regs >> which) & 1)) {
+      live |= iconvg_private_compiled__blend_regs(
+          (uint32_t)(s->regs[which] >> 32));
+    }
+  } else if (s->num_stops < 64) {
+    live = (((uint64_t)1) << s->num_stops) - 1;
+  } else {
+    live = ~((uint64_t)0);
+  }
+  s->live_regs = live;
+
+  for (uint32_t i = 0; i < 64; i++) {
+    uint32_t k = (i - which) & 63;
+    if (!((live >> k) & 1)) {
+      s->regs[i] = 0;
+      s->palette_regs &= ~(((uint64_t)1) << i);
+    }
+  }
+}
+
+// iconvg_private_compiled__variants_are_equal returns whether the ops
+// (including their snapshots) in [i0 .. i0+n) and [i1 .. i1+n) are equal.
+static bool  //
+iconvg_private_compiled__variants_are_equal(
+    const iconvg_private_compiled_recorder* r,
+    size_t i0,
+    size_t i1,
+    size_t n) {
+  for (size_t k = 0; k < n; k++) {
+    const iconvg_private_compiled_op* o0 = &r->ops[i0 + k];
+    const iconvg_private_compiled_op* o1 = &r->ops[i1 + k];
+    if ((o0->verb != o1->verb) ||
+        memcmp(o0->args, o1->args, sizeof(o0->args))) {
+      return false;
+    } else if ((o0->verb == ICONVG_PRIVATE_COMPILED_OP__END_DRAWING) &&
+               memcmp(&r->snapshots[o0->snapshot_index],
+                      &r->snapshots[o1->snapshot_index],
+                      sizeof(iconvg_private_compiled_snapshot))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// iconvg_private_compiled__write_f32 writes x as a C float literal.
+static void  //
+iconvg_private_compiled__write_f32(FILE* f, float x) {
+  if (isnan(x)) {
+    fputs("NAN", f);
+    return;
+  } else if (isinf(x)) {
+    fputs((x < 0) ? "-INFINITY" : "INFINITY", f);
+    return;
+  }
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.9g", x);
+  fputs(buf, f);
+  if (!strpbrk(buf, ".e")) {
+    fputs(".0", f);
+  }
+  fputc('f', f);
+}
+
+static void  //
+iconvg_private_compiled__write_f32s(FILE* f, const float* x, int n) {
+  for (int i = 0; i < n; i++) {
+    fputs(i ? ", " : "{", f);
+    iconvg_private_compiled__write_f32(f, x[i]);
+  }
+  fputc('}', f);
+}
+
+// iconvg_private_compiled__write_xy writes a dst coordinate pair, computed
+// from a src coordinate pair the same way that the decoder does. The skew
+// terms are zero unless iconvg_decode_options.dst_transform rotates or skews.
+static void  //
+iconvg_private_compiled__write_xy(FILE* f, const float* xy) {
+  fputs(", (", f);
+  iconvg_private_compiled__write_f32(f, xy[0]);
+  fputs(" * sx) + (", f);
+  iconvg_private_compiled__write_f32(f, xy[1]);
+  fputs(" * kx) + bx, (", f);
+  iconvg_private_compiled__write_f32(f, xy[0]);
+  fputs(" * ky) + (", f);
+  iconvg_private_compiled__write_f32(f, xy[1]);
+  fputs(" * sy) + by", f);
+}
+
+static void  //
+iconvg_private_compiled__write_variant(FILE* f,
+                                       const char* name,
+                                       size_t variant_index,
+                                       const iconvg_private_compiled_op* ops,
+                                       size_t num_ops,
+                                       const uint32_t* snapshot_ids) {
+  fprintf(f,
+          "static const char*  //\n"
+          "%s__variant_%zu(iconvg_canvas* c, const iconvg_compiled_frame* "
+          "f) {\n",
+          name, variant_index);
+  if (num_ops == 0) {
+    fprintf(f, "  return NULL;\n}\n\n");
+    return;
+  }
+  fprintf(f, "  const iconvg_canvas_vtable* v = c->vtable;\n");
+  for (size_t i = 0; i < num_ops; i++) {
+    if (ops[i].verb >= ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH) {
+      fprintf(f,
+              "  const double sx = f->s2d_scale_x;\n"
+              "  const double bx = f->s2d_bias_x;\n"
+              "  const double sy = f->s2d_scale_y;\n"
+              "  const double by = f->s2d_bias_y;\n"
+              "  const double kx = f->s2d_skew_x;\n"
+              "  const double ky = f->s2d_skew_y;\n");
+      break;
+    }
+  }
+  fprintf(f, "  const char* err_msg = NULL;\n");
+
+  for (size_t i = 0; i < num_ops; i++) {
+    const iconvg_private_compiled_op* o = &ops[i];
+    switch (o->verb) {
+      case ICONVG_PRIVATE_COMPILED_OP__BEGIN_DRAWING:
+        fputs("  if ((err_msg = (*v->begin_drawing)(c", f);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__END_DRAWING:
+        fprintf(f,
+                "  if ((err_msg = iconvg_compiled_frame__end_drawing(f, c, "
+                "&%s__paint_%u",
+                name, (unsigned int)(snapshot_ids[o->snapshot_index]));
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__BEGIN_PATH:
+        fputs("  if ((err_msg = (*v->begin_path)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__END_PATH:
+        fputs("  if ((err_msg = (*v->end_path)(c", f);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__PATH_LINE_TO:
+        fputs("  if ((err_msg = (*v->path_line_to)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__PATH_QUAD_TO:
+        fputs("  if ((err_msg = (*v->path_quad_to)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        iconvg_private_compiled__write_xy(f, &o->args[2]);
+        break;
+      case ICONVG_PRIVATE_COMPILED_OP__PATH_CUBE_TO:
+        fputs("  if ((err_msg = (*v->path_cube_to)(c", f);
+        iconvg_private_compiled__write_xy(f, &o->args[0]);
+        iconvg_private_compiled__write_xy(f, &o->args[2]);
+        iconvg_private_compiled__write_xy(f, &o->args[4]);
+        break;
+    }
+    fputs("))) {\n    return err_msg;\n  }\n", f);
+  }
+  fprintf(f, "  return NULL;\n}\n\n");
+}
+
+// iconvg_private_compiled__write_fallback writes a function_name that calls
+// iconvg_decode on an embedded copy of src_ptr[.. src_len].
+static void  //
+iconvg_private_compiled__write_fallback(FILE* f,
+                                        const char* name,
+                                        const uint8_t* src_ptr,
+                                        size_t src_len) {
+  fprintf(f,
+          "// %s has too many Level of Detail thresholds to compile, so it\n"
+          "// decodes the IconVG file instead.\n"
+          "static const uint8_t %s__src[%zu] = {",
+          name, name, src_len);
+  for (size_t i = 0; i < src_len; i++) {
+    fprintf(f, "%s0x%02X,", ((i % 12) == 0) ? "\n    " : " ", src_ptr[i]);
+  }
+  size_t indent = strlen(name) + 1;
+  fprintf(f,
+          "\n};\n\n"
+          "const char*  //\n"
+          "%s(iconvg_canvas* dst_canvas,\n"
+          "%*siconvg_rectangle_f32 dst_rect,\n"
+          "%*sconst iconvg_decode_options* options) {\n"
+          "  return iconvg_decode(dst_canvas, dst_rect, %s__src, "
+          "sizeof(%s__src),\n"
+          "                       options);\n"
+          "}\n",
+          name, (int)indent, "", (int)indent, "", name, name);
+}
+
+static void  //
+iconvg_private_compiled__write(FILE* f,
+                               const char* name,
+                               size_t src_len,
+                               iconvg_rectangle_f32 viewbox,
+                               const iconvg_private_compiled_recorder* r,
+                               const int64_t* min_heights,
+                               const size_t* op_starts,
+                               size_t num_variants,
+                               uint32_t* snapshot_ids,
+                               uint32_t* regs_ids) {
+  // Number the distinct snapshots and, separately, their distinct registers.
+  // Registers that hold palette colors are zero, so they don't differ.
+  uint32_t num_paints = 0;
+  uint32_t num_regs = 0;
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    snapshot_ids[i] = num_paints;
+    for (size_t j = 0; j < i; j++) {
+      if (!memcmp(&r->snapshots[i], &r->snapshots[j],
+                  sizeof(iconvg_private_compiled_snapshot))) {
+        snapshot_ids[i] = snapshot_ids[j];
+        break;
+      }
+    }
+    if (snapshot_ids[i] == num_paints) {
+      num_paints++;
+    }
+  }
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    regs_ids[i] = num_regs;
+    for (size_t j = 0; j < i; j++) {
+      if (!memcmp(r->snapshots[i].regs, r->snapshots[j].regs,
+                  sizeof(r->snapshots[i].regs))) {
+        regs_ids[i] = regs_ids[j];
+        break;
+      }
+    }
+    if (regs_ids[i] == num_regs) {
+      num_regs++;
+    }
+  }
+
+  bool has_palette = memcmp(&r->suggested_palette,
+                            &iconvg_private_default_palette,
+                            sizeof(iconvg_palette)) != 0;
+  if (has_palette) {
+    fprintf(f, "static const iconvg_palette %s__suggested_palette = {{",
+            name);
+    for (int i = 0; i < 64; i++) {
+      const uint8_t* k = &r->suggested_palette.colors[i].rgba[0];
+      fprintf(f, "\n    {{0x%02X, 0x%02X, 0x%02X, 0x%02X}},", k[0], k[1], k[2],
+              k[3]);
+    }
+    fprintf(f, "\n}};\n\n");
+  }
+
+  uint32_t next = 0;
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    if (regs_ids[i] != next) {
+      continue;
+    }
+    next++;
+    fprintf(f, "static const uint64_t %s__regs_%u[64] = {", name,
+            (unsigned int)(regs_ids[i]));
+    for (int j = 0; j < 64; j++) {
+      fprintf(f, "%s0x%016llX,", ((j % 3) == 0) ? "\n    " : " ",
+              (unsigned long long)(r->snapshots[i].regs[j]));
+    }
+    fprintf(f, "\n};\n\n");
+  }
+
+  next = 0;
+  for (size_t i = 0; i < r->num_snapshots; i++) {
+    if (snapshot_ids[i] != next) {
+      continue;
+    }
+    next++;
+    const iconvg_private_compiled_snapshot* s = &r->snapshots[i];
+    fprintf(f,
+            "static const iconvg_compiled_paint %s__paint_%u = {\n"
+            "    %s__regs_%u,\n"
+            "    0x%016llX,\n"
+            "    0x%016llX,\n"
+            "    ",
+            name, (unsigned int)(snapshot_ids[i]), name,
+            (unsigned int)(regs_ids[i]), (unsigned long long)(s->palette_regs),
+            (unsigned long long)(s->live_regs));
+    iconvg_private_compiled__write_f32s(f, s->transform, 6);
+    fprintf(f,
+            ",\n"
+            "    %u,\n"
+            "    %u,\n"
+            "    %u,\n"
+            "    %u,\n"
+            "};\n\n",
+            (unsigned int)(s->paint_type), (unsigned int)(s->spread),
+            (unsigned int)(s->num_stops), (unsigned int)(s->which_regs));
+  }
+
+  for (size_t i = 0; i < num_variants; i++) {
+    iconvg_private_compiled__write_variant(f, name, i, r->ops + op_starts[i],
+                                           op_starts[i + 1] - op_starts[i],
+                                           snapshot_ids);
+  }
+
+  fprintf(f, "static const iconvg_compiled_variant %s__variants[%zu] = {\n",
+          name, num_variants);
+  for (size_t i = 0; i < num_variants; i++) {
+    if (min_heights[i] == INT64_MIN) {
+      fprintf(f, "    {INT64_MIN, &%s__variant_%zu},\n", name, i);
+    } else {
+      fprintf(f, "    {%lld, &%s__variant_%zu},\n",
+              (long long)(min_heights[i]), name, i);
+    }
+  }
+  fprintf(f, "};\n\nstatic const iconvg_compiled_icon %s__icon = {\n    ",
+          name);
+  float v[4] = {viewbox.min_x, viewbox.min_y, viewbox.max_x, viewbox.max_y};
+  iconvg_private_compiled__write_f32s(f, v, 4);
+  if (has_palette) {
+    fprintf(f, ",\n    &%s__suggested_palette", name);
+  } else {
+    fprintf(f, ",\n    NULL");
+  }
+  size_t indent = strlen(name) + 1;
+  fprintf(f,
+          ",\n"
+          "    %zu,\n"
+          "    %zu,\n"
+          "    %s__variants,\n"
+          "};\n\n"
+          "const char*  //\n"
+          "%s(iconvg_canvas* dst_canvas,\n"
+          "%*siconvg_rectangle_f32 dst_rect,\n"
+          "%*sconst iconvg_decode_options* options) {\n"
+          "  return iconvg_compiled_icon__decode(&%s__icon, dst_canvas, "
+          "dst_rect,\n"
+          "                                      options);\n"
+          "}\n",
+          src_len, num_variants, name, name, (int)indent, "", (int)indent, "",
+          name);
+}
+
+const char*  //
+iconvg_write_c_source(FILE* f,
+                      const char* function_name,
+                      const uint8_t* src_ptr,
+                      size_t src_len,
+                      iconvg_allocator* allocator) {
+  if (!f || !function_name || !*function_name) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  iconvg_validate_report report = {0};
+  iconvg_private_lod_thresholds lods;
+  lods.num_values = 0;
+  lods.overflowed = false;
+  ICONVG_PRIVATE_TRY(
+      iconvg_private_validate(&report, src_ptr, src_len, &lods));
+  if (lods.overflowed) {
+    iconvg_private_compiled__write_fallback(f, function_name, src_ptr,
+                                            src_len);
+    return NULL;
+  }
+  iconvg_rectangle_f32 viewbox;
+  ICONVG_PRIVATE_TRY(iconvg_decode_viewbox(&viewbox, src_ptr, src_len));
+
+  int64_t breakpoints[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t num_breakpoints =
+      iconvg_private_lod_thresholds__breakpoints(&lods, breakpoints);
+
+  iconvg_private_compiled_recorder r;
+  memset(&r, 0, sizeof(r));
+  r.allocator = allocator;
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_compiled_recorder_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = &r;
+
+  // Decode once per variant, dropping variants that are identical to their
+  // predecessor.
+  int64_t min_heights[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t op_starts[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS + 1];
+  size_t snapshot_starts[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS + 1];
+  size_t num_variants = 0;
+  op_starts[0] = 0;
+  snapshot_starts[0] = 0;
+  const char* err_msg = NULL;
+  for (size_t i = 0; i < num_breakpoints; i++) {
+    iconvg_decode_options opts = {0};
+    opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+    opts.height_in_pixels.has_value = true;
+    opts.height_in_pixels.value = breakpoints[i];
+
+    r.checking = false;
+    err_msg = iconvg_decode(&c, viewbox, src_ptr, src_len, &opts);
+    if (err_msg) {
+      break;
+    }
+
+    iconvg_palette changed_palette = r.suggested_palette;
+    for (int j = 0; j < 64; j++) {
+      changed_palette.colors[j].rgba[0] ^= 0x01;
+    }
+    opts.palette = &changed_palette;
+    r.checking = true;
+    r.check_index = snapshot_starts[num_variants];
+    err_msg = iconvg_decode(&c, viewbox, src_ptr, src_len, &opts);
+    if (err_msg) {
+      break;
+    }
+    for (size_t j = snapshot_starts[num_variants]; j < r.num_snapshots; j++) {
+      iconvg_private_compiled_snapshot__prune(&r.snapshots[j]);
+    }
+
+    size_t n = r.num_ops - op_starts[num_variants];
+    if ((num_variants > 0) &&
+        ((op_starts[num_variants] - op_starts[num_variants - 1]) == n) &&
+        iconvg_private_compiled__variants_are_equal(
+            &r, op_starts[num_variants - 1], op_starts[num_variants], n)) {
+      r.num_ops = op_starts[num_variants];
+      r.num_snapshots = snapshot_starts[num_variants];
+      continue;
+    }
+    min_heights[num_variants] = breakpoints[i];
+    num_variants++;
+    op_starts[num_variants] = r.num_ops;
+    snapshot_starts[num_variants] = r.num_snapshots;
+  }
+
+  const size_t ids_size = 2 * r.num_snapshots * sizeof(uint32_t);
+  uint32_t* ids = NULL;
+  if (!err_msg && (r.num_snapshots > 0)) {
+    ids = iconvg_private_allocator__alloc(allocator, ids_size);
+    if (!ids) {
+      err_msg = iconvg_error_system_failure_out_of_memory;
+    }
+  }
+  if (!err_msg) {
+    iconvg_private_compiled__write(f, function_name, src_len, viewbox, &r,
+                                   min_heights, op_starts, num_variants, ids,
+                                   ids + r.num_snapshots);
+  }
+  iconvg_private_allocator__free(allocator, ids, ids_size);
+  iconvg_private_allocator__free(
+      allocator, r.ops, r.cap_ops * sizeof(iconvg_private_compiled_op));
+  iconvg_private_allocator__free(
+      allocator, r.snapshots,
+      r.cap_snapshots * sizeof(iconvg_private_compiled_snapshot));
+  return err_msg;
+}
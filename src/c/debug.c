@@ -291,6 +291,10 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_debug_canvas__path_cube_to,
         &iconvg_private_debug_canvas__on_metadata_viewbox,
         &iconvg_private_debug_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
 };
 
 iconvg_canvas  //
@@ -14,6 +14,25 @@
 
 #include "./aaa_private.h"
 
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/uio.h>
+#else
+// struct iovec is as specified by POSIX, for platforms without <sys/uio.h>.
+struct iovec {
+  void* iov_base;
+  size_t iov_len;
+};
+#endif
+
+// ICONVG_PRIVATE_OBSERVE_OP calls the ICONVG_CONFIG__OP_OBSERVER hook, if
+// configured, with a pointer to the op about to be executed. See the
+// iconvg_decode documentation in aaa_public.h.
+#if defined(ICONVG_CONFIG__OP_OBSERVER)
+#define ICONVG_PRIVATE_OBSERVE_OP(op_ptr) ICONVG_CONFIG__OP_OBSERVER(op_ptr)
+#else
+#define ICONVG_PRIVATE_OBSERVE_OP(op_ptr)
+#endif
+
 static void  //
 iconvg_private_decoder__advance_to_ptr(iconvg_private_decoder* self,
                                        const uint8_t* new_ptr) {
@@ -35,9 +54,114 @@ iconvg_private_decoder__limit_u32(iconvg_private_decoder* self,
   iconvg_private_decoder d;
   d.ptr = self->ptr;
   d.len = (limit < self->len) ? limit : self->len;
+  d.iov = NULL;
   return d;
 }
 
+// ----
+
+// ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE bounds how many bytes
+// iconvg_private_decoder__refill can make contiguous. It is more than the
+// longest valid metadata chunk (a Suggested Palette), which is the longest
+// thing that the decoder reads in one piece.
+#define ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE 512
+
+// iconvg_private_decoder_iov is the input after a decoder's ptr[.. len]: the
+// iov fragments, starting offset bytes into iov[0]. remaining counts those
+// bytes (and so ends the iov array). stitch holds copies of the bytes either
+// side of a fragment boundary, for reading something that straddles it.
+typedef struct iconvg_private_decoder_iov_struct {
+  const struct iovec* iov;
+  size_t offset;
+  size_t remaining;
+  uint8_t stitch[ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE];
+} iconvg_private_decoder_iov;
+
+// iconvg_private_decoder__refill is the slow path for when self->len < n. It
+// returns whether it could make ptr[.. len] at least n bytes long, without
+// consuming anything. If self->len is zero, it moves on to the next fragment
+// without copying. Otherwise, it copies the last few bytes of this fragment
+// and the first few of the next into the stitch buffer.
+static bool  //
+iconvg_private_decoder__refill(iconvg_private_decoder* self, size_t n) {
+  iconvg_private_decoder_iov* v = self->iov;
+  if (!v || ((n - self->len) > v->remaining)) {
+    return false;
+  }
+
+  if (self->len == 0) {
+    while (v->offset >= v->iov[0].iov_len) {
+      v->offset = 0;
+      v->iov++;
+    }
+    size_t available = v->iov[0].iov_len - v->offset;
+    if (available >= n) {
+      self->ptr = ((const uint8_t*)(v->iov[0].iov_base)) + v->offset;
+      self->len = available;
+      v->offset = 0;
+      v->iov++;
+      v->remaining -= available;
+      return true;
+    }
+  }
+
+  if (n > ICONVG_PRIVATE_DECODER_IOV__STITCH_SIZE) {
+    return false;
+  }
+  if (self->len > 0) {
+    memmove(v->stitch, self->ptr, self->len);
+  }
+  while (self->len < n) {
+    while (v->offset >= v->iov[0].iov_len) {
+      v->offset = 0;
+      v->iov++;
+    }
+    size_t m = v->iov[0].iov_len - v->offset;
+    if (m > (n - self->len)) {
+      m = n - self->len;
+    }
+    memcpy(v->stitch + self->len,
+           ((const uint8_t*)(v->iov[0].iov_base)) + v->offset, m);
+    self->len += m;
+    v->offset += m;
+    v->remaining -= m;
+  }
+  self->ptr = v->stitch;
+  return true;
+}
+
+// iconvg_private_decoder__ensure returns whether ptr[.. len] is (or, after
+// refilling, has become) at least n bytes long.
+static inline bool  //
+iconvg_private_decoder__ensure(iconvg_private_decoder* self, size_t n) {
+  return (self->len >= n) || iconvg_private_decoder__refill(self, n);
+}
+
+// iconvg_private_decoder__skip consumes n bytes, which need not be contiguous.
+// It returns false, having consumed nothing, if there are fewer than n bytes
+// left.
+static bool  //
+iconvg_private_decoder__skip(iconvg_private_decoder* self, size_t n) {
+  if (self->len < n) {
+    // Check the total up front, so that failing leaves the position alone
+    // (for end_decode to report) instead of at the end of the input.
+    if (!self->iov || ((n - self->len) > self->iov->remaining)) {
+      return false;
+    }
+  }
+  while (self->len < n) {
+    n -= self->len;
+    self->ptr += self->len;
+    self->len = 0;
+    if (!iconvg_private_decoder__refill(self, 1)) {
+      return false;
+    }
+  }
+  self->ptr += n;
+  self->len -= n;
+  return true;
+}
+
 static void  //
 iconvg_private_decoder__skip_to_the_end(iconvg_private_decoder* self) {
   self->ptr += self->len;
@@ -51,7 +175,7 @@ iconvg_private_decoder__decode_coordinates(iconvg_private_decoder* self,
                                            float* dst_ptr,
                                            size_t dst_len) {
   for (; dst_len > 0; dst_len--) {
-    if (self->len == 0) {
+    if (!iconvg_private_decoder__ensure(self, 1)) {
       return false;
     }
     uint8_t v = self->ptr[0];
@@ -62,7 +186,7 @@ iconvg_private_decoder__decode_coordinates(iconvg_private_decoder* self,
       self->len -= 1;
 
     } else if ((v & 0x02) != 0) {  // 2-byte encoding.
-      if (self->len < 2) {
+      if (!iconvg_private_decoder__ensure(self, 2)) {
         return false;
       }
       int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
@@ -71,7 +195,7 @@ iconvg_private_decoder__decode_coordinates(iconvg_private_decoder* self,
       self->len -= 2;
 
     } else {  // 4-byte encoding.
-      if (self->len < 4) {
+      if (!iconvg_private_decoder__ensure(self, 4)) {
         return false;
       }
       float f = iconvg_private_reinterpret_from_u32_to_f32(
@@ -87,10 +211,139 @@ iconvg_private_decoder__decode_coordinates(iconvg_private_decoder* self,
   return true;
 }
 
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+
+// iconvg_private_fixed_from_f64 returns round(f * one), clamped to ±max.
+static int64_t  //
+iconvg_private_fixed_from_f64(double f, double one, int64_t max) {
+  f *= one;
+  if (f >= (double)max) {
+    return +max;
+  } else if (f <= -(double)max) {
+    return -max;
+  }
+  return (int64_t)((f < 0) ? (f - 0.5) : (f + 0.5));
+}
+
+#endif  // defined(ICONVG_CONFIG__FIXED_POINT)
+
+// iconvg_private_decoder__decode_path_coordinate is like
+// iconvg_private_decoder__decode_coordinates (with a dst_len of 1) but, with
+// ICONVG_CONFIG__FIXED_POINT, it produces 24.8 fixed point numbers. Only the
+// 4-byte encoding then involves floating point.
+static bool  //
+iconvg_private_decoder__decode_path_coordinate(iconvg_private_decoder* self,
+                                               iconvg_private_coord* dst) {
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  if (!iconvg_private_decoder__ensure(self, 1)) {
+    return false;
+  }
+  uint8_t v = self->ptr[0];
+  if ((v & 0x01) != 0) {  // 1-byte encoding.
+    int32_t i = (int32_t)(v >> 1);
+    *dst = (i - 64) * 256;
+    self->ptr += 1;
+    self->len -= 1;
+
+  } else if ((v & 0x02) != 0) {  // 2-byte encoding.
+    if (!iconvg_private_decoder__ensure(self, 2)) {
+      return false;
+    }
+    int32_t i = (int32_t)(iconvg_private_peek_u16le(self->ptr) >> 2);
+    *dst = (i - (128 * 64)) * 4;
+    self->ptr += 2;
+    self->len -= 2;
+
+  } else {  // 4-byte encoding.
+    if (!iconvg_private_decoder__ensure(self, 4)) {
+      return false;
+    }
+    float f = iconvg_private_reinterpret_from_u32_to_f32(
+        iconvg_private_peek_u32le(self->ptr));
+    if (f != f) {  // Reject NaN.
+      return false;
+    }
+    *dst = (int32_t)iconvg_private_fixed_from_f64(f, 256, INT32_MAX);
+    self->ptr += 4;
+    self->len -= 4;
+  }
+  return true;
+#else
+  return iconvg_private_decoder__decode_coordinates(self, dst, 1);
+#endif
+}
+
+// iconvg_private_decoder__decode_path_coordinate_run decodes up to dst_len
+// coordinates, returning how many it decoded before hitting the end of the
+// input or an invalid (NaN) coordinate.
+//
+// Path ops with repeat counts often encode dozens of coordinates in a row,
+// nearly all of them in the 1- or 2-byte encodings. While at least two
+// contiguous bytes remain, the inner loop decodes those without the
+// per-coordinate iconvg_private_decoder__ensure calls, keeping ptr in a
+// register. It still branches on each coordinate's tag bits: a coordinate's
+// length depends on its first byte, so a branch-free loop would make every
+// load wait for the previous one, whereas a predicted branch lets the CPU run
+// ahead. 4-byte encodings, and coordinates straddling an iconvg_decode_iov
+// fragment boundary, fall back to the one-at-a-time path.
+static size_t  //
+iconvg_private_decoder__decode_path_coordinate_run(
+    iconvg_private_decoder* self,
+    iconvg_private_coord* dst_ptr,
+    size_t dst_len) {
+  size_t n = 0;
+  while (n < dst_len) {
+    const uint8_t* ptr = self->ptr;
+    const uint8_t* end = ptr + self->len;
+    for (; (n < dst_len) && ((end - ptr) >= 2); n++) {
+      uint8_t v = ptr[0];
+      if ((v & 0x01) != 0) {  // 1-byte encoding.
+        int32_t i = (int32_t)(v >> 1);
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+        dst_ptr[n] = (i - 64) * 256;
+#else
+        dst_ptr[n] = ((float)(i - 64));
+#endif
+        ptr += 1;
+      } else if ((v & 0x02) != 0) {  // 2-byte encoding.
+        int32_t i = (int32_t)(iconvg_private_peek_u16le(ptr) >> 2);
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+        dst_ptr[n] = (i - (128 * 64)) * 4;
+#else
+        dst_ptr[n] = ((float)(i - (128 * 64))) / 64.0f;
+#endif
+        ptr += 2;
+      } else {  // 4-byte encoding.
+        break;
+      }
+    }
+    self->len -= (size_t)(ptr - self->ptr);
+    self->ptr = ptr;
+
+    if (n >= dst_len) {
+      break;
+    } else if (!iconvg_private_decoder__decode_path_coordinate(self,
+                                                               dst_ptr + n)) {
+      return n;
+    }
+    n++;
+  }
+  return n;
+}
+
+static inline bool  //
+iconvg_private_decoder__decode_path_coordinates(iconvg_private_decoder* self,
+                                                iconvg_private_coord* dst_ptr,
+                                                size_t dst_len) {
+  return iconvg_private_decoder__decode_path_coordinate_run(self, dst_ptr,
+                                                            dst_len) ==
+         dst_len;
+}
+
 static bool  //
 iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
                                               uint32_t* dst) {
-  if (self->len == 0) {
+  if (!iconvg_private_decoder__ensure(self, 1)) {
     return false;
   }
   uint8_t v = self->ptr[0];
@@ -100,7 +353,7 @@ iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
     self->len -= 1;
 
   } else if ((v & 0x02) != 0) {  // 2-byte encoding.
-    if (self->len < 2) {
+    if (!iconvg_private_decoder__ensure(self, 2)) {
       return false;
     }
     *dst = iconvg_private_peek_u16le(self->ptr) >> 2;
@@ -108,7 +361,7 @@ iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
     self->len -= 2;
 
   } else {  // 4-byte encoding.
-    if (self->len < 4) {
+    if (!iconvg_private_decoder__ensure(self, 4)) {
       return false;
     }
     *dst = iconvg_private_peek_u32le(self->ptr) >> 2;
@@ -121,7 +374,7 @@ iconvg_private_decoder__decode_natural_number(iconvg_private_decoder* self,
 static bool  //
 iconvg_private_decoder__decode_float32(iconvg_private_decoder* self,
                                        float* dst) {
-  if (self->len < 4) {
+  if (!iconvg_private_decoder__ensure(self, 4)) {
     return false;
   }
   float f = iconvg_private_reinterpret_from_u32_to_f32(
@@ -139,10 +392,10 @@ iconvg_private_decoder__decode_float32(iconvg_private_decoder* self,
 
 static bool  //
 iconvg_private_decoder__decode_magic_identifier(iconvg_private_decoder* self) {
-  if ((self->len < 4) ||         //
-      (self->ptr[0] != 0x8A) ||  //
-      (self->ptr[1] != 0x49) ||  //
-      (self->ptr[2] != 0x56) ||  //
+  if (!iconvg_private_decoder__ensure(self, 4) ||  //
+      (self->ptr[0] != 0x8A) ||                   //
+      (self->ptr[1] != 0x49) ||                   //
+      (self->ptr[2] != 0x56) ||                   //
       (self->ptr[3] != 0x47)) {
     return false;
   }
@@ -202,6 +455,483 @@ iconvg_private_decoder__decode_metadata_suggested_palette(
 
 // ----
 
+// The iconvg_private_canvas__etc functions transform from src (viewbox) to dst
+// coordinates and call the canvas' corresponding method. With
+// ICONVG_CONFIG__FIXED_POINT, they prefer the etc__fixed methods.
+//
+// iconvg_private_canvas__path_run does the same for up to
+// ICONVG_PRIVATE_PATH_RUN__MAX_REPS repetitions of a LineTo, QuadTo or CubeTo
+// op (with num_points being 1, 2 or 3), transforming all of their points in
+// one pass before calling the canvas once per repetition.
+
+#define ICONVG_PRIVATE_PATH_RUN__MAX_REPS 16
+#define ICONVG_PRIVATE_PATH_RUN__MAX_COORDS \
+  (ICONVG_PRIVATE_PATH_RUN__MAX_REPS * 3 * 2)
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+
+static inline iconvg_fixed_24_8  //
+iconvg_private_fixed_s2d(int64_t u,
+                         int64_t v,
+                         int64_t u_scale,
+                         int64_t v_scale,
+                         int64_t bias) {
+  // u and v are 24.8 (and less than 1<<34 in magnitude, even for Ellipse
+  // control points) and the scales are 16.16 (and at most 1<<28), so the sum
+  // of products is 40.24 and doesn't overflow. This assumes that >> of a
+  // negative number is an arithmetic shift, as it is for all of the compilers
+  // that we care about.
+  int64_t x = ((((u * u_scale) + (v * v_scale)) + 0x8000) >> 16) + bias;
+  return (x > INT32_MAX) ? INT32_MAX : (x < INT32_MIN) ? INT32_MIN : (int32_t)x;
+}
+
+#define ICONVG_PRIVATE_S2D_X(p, x, y)                                       \
+  iconvg_private_fixed_s2d(x, y, p->s2d_fixed_scale_x, p->s2d_fixed_skew_x, \
+                           p->s2d_fixed_bias_x)
+#define ICONVG_PRIVATE_S2D_Y(p, x, y)                                       \
+  iconvg_private_fixed_s2d(y, x, p->s2d_fixed_scale_y, p->s2d_fixed_skew_y, \
+                           p->s2d_fixed_bias_y)
+#define ICONVG_PRIVATE_FIXED_TO_F32(v) (((float)(v)) / 256.0f)
+
+static const char*  //
+iconvg_private_canvas__begin_path(iconvg_canvas* c,
+                                  const iconvg_paint* p,
+                                  iconvg_private_wide_coord x0,
+                                  iconvg_private_wide_coord y0) {
+  iconvg_fixed_24_8 dx0 = ICONVG_PRIVATE_S2D_X(p, x0, y0);
+  iconvg_fixed_24_8 dy0 = ICONVG_PRIVATE_S2D_Y(p, x0, y0);
+  if (c->vtable->begin_path__fixed) {
+    return (*c->vtable->begin_path__fixed)(c, dx0, dy0);
+  }
+  return (*c->vtable->begin_path)(c, ICONVG_PRIVATE_FIXED_TO_F32(dx0),
+                                  ICONVG_PRIVATE_FIXED_TO_F32(dy0));
+}
+
+static const char*  //
+iconvg_private_canvas__path_line_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1) {
+  iconvg_fixed_24_8 dx1 = ICONVG_PRIVATE_S2D_X(p, x1, y1);
+  iconvg_fixed_24_8 dy1 = ICONVG_PRIVATE_S2D_Y(p, x1, y1);
+  if (c->vtable->path_line_to__fixed) {
+    return (*c->vtable->path_line_to__fixed)(c, dx1, dy1);
+  }
+  return (*c->vtable->path_line_to)(c, ICONVG_PRIVATE_FIXED_TO_F32(dx1),
+                                    ICONVG_PRIVATE_FIXED_TO_F32(dy1));
+}
+
+static const char*  //
+iconvg_private_canvas__path_quad_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2) {
+  iconvg_fixed_24_8 dx1 = ICONVG_PRIVATE_S2D_X(p, x1, y1);
+  iconvg_fixed_24_8 dy1 = ICONVG_PRIVATE_S2D_Y(p, x1, y1);
+  iconvg_fixed_24_8 dx2 = ICONVG_PRIVATE_S2D_X(p, x2, y2);
+  iconvg_fixed_24_8 dy2 = ICONVG_PRIVATE_S2D_Y(p, x2, y2);
+  if (c->vtable->path_quad_to__fixed) {
+    return (*c->vtable->path_quad_to__fixed)(c, dx1, dy1, dx2, dy2);
+  }
+  return (*c->vtable->path_quad_to)(
+      c, ICONVG_PRIVATE_FIXED_TO_F32(dx1), ICONVG_PRIVATE_FIXED_TO_F32(dy1),
+      ICONVG_PRIVATE_FIXED_TO_F32(dx2), ICONVG_PRIVATE_FIXED_TO_F32(dy2));
+}
+
+static const char*  //
+iconvg_private_canvas__path_cube_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2,
+                                    iconvg_private_wide_coord x3,
+                                    iconvg_private_wide_coord y3) {
+  iconvg_fixed_24_8 dx1 = ICONVG_PRIVATE_S2D_X(p, x1, y1);
+  iconvg_fixed_24_8 dy1 = ICONVG_PRIVATE_S2D_Y(p, x1, y1);
+  iconvg_fixed_24_8 dx2 = ICONVG_PRIVATE_S2D_X(p, x2, y2);
+  iconvg_fixed_24_8 dy2 = ICONVG_PRIVATE_S2D_Y(p, x2, y2);
+  iconvg_fixed_24_8 dx3 = ICONVG_PRIVATE_S2D_X(p, x3, y3);
+  iconvg_fixed_24_8 dy3 = ICONVG_PRIVATE_S2D_Y(p, x3, y3);
+  if (c->vtable->path_cube_to__fixed) {
+    return (*c->vtable->path_cube_to__fixed)(c, dx1, dy1, dx2, dy2, dx3, dy3);
+  }
+  return (*c->vtable->path_cube_to)(
+      c, ICONVG_PRIVATE_FIXED_TO_F32(dx1), ICONVG_PRIVATE_FIXED_TO_F32(dy1),
+      ICONVG_PRIVATE_FIXED_TO_F32(dx2), ICONVG_PRIVATE_FIXED_TO_F32(dy2),
+      ICONVG_PRIVATE_FIXED_TO_F32(dx3), ICONVG_PRIVATE_FIXED_TO_F32(dy3));
+}
+
+static const char*  //
+iconvg_private_canvas__path_run(iconvg_canvas* c,
+                                const iconvg_paint* p,
+                                const iconvg_private_coord* src,
+                                size_t num_points,
+                                size_t num_reps) {
+  iconvg_fixed_24_8 dst[ICONVG_PRIVATE_PATH_RUN__MAX_COORDS];
+  size_t n = 2 * num_points * num_reps;
+  for (size_t i = 0; i < n; i += 2) {
+    dst[i + 0] = ICONVG_PRIVATE_S2D_X(p, src[i + 0], src[i + 1]);
+    dst[i + 1] = ICONVG_PRIVATE_S2D_Y(p, src[i + 0], src[i + 1]);
+  }
+
+  const iconvg_fixed_24_8* d = dst;
+  switch (num_points) {
+    case 1:
+      if (c->vtable->path_line_to__fixed) {
+        for (; num_reps > 0; num_reps--, d += 2) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_line_to__fixed)(c, d[0], d[1]));
+        }
+      } else {
+        for (; num_reps > 0; num_reps--, d += 2) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
+              c, ICONVG_PRIVATE_FIXED_TO_F32(d[0]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[1])));
+        }
+      }
+      break;
+    case 2:
+      if (c->vtable->path_quad_to__fixed) {
+        for (; num_reps > 0; num_reps--, d += 4) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to__fixed)(c, d[0], d[1],
+                                                              d[2], d[3]));
+        }
+      } else {
+        for (; num_reps > 0; num_reps--, d += 4) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to)(
+              c, ICONVG_PRIVATE_FIXED_TO_F32(d[0]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[1]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[2]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[3])));
+        }
+      }
+      break;
+    default:
+      if (c->vtable->path_cube_to__fixed) {
+        for (; num_reps > 0; num_reps--, d += 6) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to__fixed)(
+              c, d[0], d[1], d[2], d[3], d[4], d[5]));
+        }
+      } else {
+        for (; num_reps > 0; num_reps--, d += 6) {
+          ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
+              c, ICONVG_PRIVATE_FIXED_TO_F32(d[0]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[1]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[2]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[3]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[4]),
+              ICONVG_PRIVATE_FIXED_TO_F32(d[5])));
+        }
+      }
+      break;
+  }
+  return NULL;
+}
+
+#else  // defined(ICONVG_CONFIG__FIXED_POINT)
+
+// Checking p->skewed keeps the common, axis-aligned case's arithmetic (and
+// its floating point results) the same as when there is no dst_transform.
+#define ICONVG_PRIVATE_S2D_X(p, x, y)                                       \
+  (p->skewed ? (((x)*p->s2d_scale_x) + ((y)*p->s2d_skew_x) + p->s2d_bias_x) \
+             : (((x)*p->s2d_scale_x) + p->s2d_bias_x))
+#define ICONVG_PRIVATE_S2D_Y(p, x, y)                                       \
+  (p->skewed ? (((x)*p->s2d_skew_y) + ((y)*p->s2d_scale_y) + p->s2d_bias_y) \
+             : (((y)*p->s2d_scale_y) + p->s2d_bias_y))
+
+static inline const char*  //
+iconvg_private_canvas__begin_path(iconvg_canvas* c,
+                                  const iconvg_paint* p,
+                                  iconvg_private_wide_coord x0,
+                                  iconvg_private_wide_coord y0) {
+  return (*c->vtable->begin_path)(c,                                //
+                                  ICONVG_PRIVATE_S2D_X(p, x0, y0),  //
+                                  ICONVG_PRIVATE_S2D_Y(p, x0, y0));
+}
+
+static inline const char*  //
+iconvg_private_canvas__path_line_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1) {
+  return (*c->vtable->path_line_to)(c,                                //
+                                    ICONVG_PRIVATE_S2D_X(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x1, y1));
+}
+
+static inline const char*  //
+iconvg_private_canvas__path_quad_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2) {
+  return (*c->vtable->path_quad_to)(c,                                //
+                                    ICONVG_PRIVATE_S2D_X(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_X(p, x2, y2),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x2, y2));
+}
+
+static inline const char*  //
+iconvg_private_canvas__path_cube_to(iconvg_canvas* c,
+                                    const iconvg_paint* p,
+                                    iconvg_private_wide_coord x1,
+                                    iconvg_private_wide_coord y1,
+                                    iconvg_private_wide_coord x2,
+                                    iconvg_private_wide_coord y2,
+                                    iconvg_private_wide_coord x3,
+                                    iconvg_private_wide_coord y3) {
+  return (*c->vtable->path_cube_to)(c,                                //
+                                    ICONVG_PRIVATE_S2D_X(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x1, y1),  //
+                                    ICONVG_PRIVATE_S2D_X(p, x2, y2),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x2, y2),  //
+                                    ICONVG_PRIVATE_S2D_X(p, x3, y3),  //
+                                    ICONVG_PRIVATE_S2D_Y(p, x3, y3));
+}
+
+static const char*  //
+iconvg_private_canvas__path_run(iconvg_canvas* c,
+                                const iconvg_paint* p,
+                                const iconvg_private_coord* src,
+                                size_t num_points,
+                                size_t num_reps) {
+  float dst[ICONVG_PRIVATE_PATH_RUN__MAX_COORDS];
+  size_t n = 2 * num_points * num_reps;
+  const double sx = p->s2d_scale_x;
+  const double bx = p->s2d_bias_x;
+  const double sy = p->s2d_scale_y;
+  const double by = p->s2d_bias_y;
+  // This is ICONVG_PRIVATE_S2D_X and ICONVG_PRIVATE_S2D_Y, with the
+  // p->skewed check hoisted out of the loop. The arithmetic must stay the
+  // same so that the results match, bit for bit.
+  if (p->skewed) {
+    const double kx = p->s2d_skew_x;
+    const double ky = p->s2d_skew_y;
+    for (size_t i = 0; i < n; i += 2) {
+      double x = src[i + 0];
+      double y = src[i + 1];
+      dst[i + 0] = (float)((x * sx) + (y * kx) + bx);
+      dst[i + 1] = (float)((x * ky) + (y * sy) + by);
+    }
+  } else {
+    for (size_t i = 0; i < n; i += 2) {
+      dst[i + 0] = (float)((((double)src[i + 0]) * sx) + bx);
+      dst[i + 1] = (float)((((double)src[i + 1]) * sy) + by);
+    }
+  }
+
+  const float* d = dst;
+  switch (num_points) {
+    case 1:
+      for (; num_reps > 0; num_reps--, d += 2) {
+        ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(c, d[0], d[1]));
+      }
+      break;
+    case 2:
+      for (; num_reps > 0; num_reps--, d += 4) {
+        ICONVG_PRIVATE_TRY(
+            (*c->vtable->path_quad_to)(c, d[0], d[1], d[2], d[3]));
+      }
+      break;
+    default:
+      for (; num_reps > 0; num_reps--, d += 6) {
+        ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(c, d[0], d[1], d[2],
+                                                      d[3], d[4], d[5]));
+      }
+      break;
+  }
+  return NULL;
+}
+
+#endif  // defined(ICONVG_CONFIG__FIXED_POINT)
+
+// ----
+
+// Each opcode's iconvg_private_opcode_infos entry says which of the bytecode
+// interpreter's handlers executes it and how long its arguments are, so that
+// jump ops can skip over it without executing it. An op's arguments are, in
+// order:
+//   - if the REPS flag is set, a natural number repeat count (only if the
+//     opcode's low 4 bits are zero) and then num_naturals coordinates per
+//     repetition. Coordinates have the same lengths as natural numbers.
+//   - if the VARIABLE_LENGTH flag is set, a natural number N and then N
+//     bytes.
+//   - num_bytes bytes.
+//   - if the REPS flag is not set, num_naturals natural numbers or
+//     coordinates.
+//   - if the SEGREF flag is set, an 8-byte SegRef and, if it is an Inline
+//     SegRef, the Segment Length bytes of segment contents that follow it.
+
+#define ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO 0x00
+#define ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO 0x01
+#define ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO 0x02
+#define ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE 0x03
+#define ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO 0x04
+#define ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD 0x05
+#define ICONVG_PRIVATE_OPCODE_HANDLER__NOP 0x06
+#define ICONVG_PRIVATE_OPCODE_HANDLER__JUMP 0x07
+#define ICONVG_PRIVATE_OPCODE_HANDLER__RET 0x08
+#define ICONVG_PRIVATE_OPCODE_HANDLER__CALL 0x09
+#define ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER 0x0A
+#define ICONVG_PRIVATE_OPCODE_HANDLER__FILL 0x0B
+#define ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED 0x0C
+#define ICONVG_PRIVATE_OPCODE_HANDLER__COUNT 0x0D
+
+#define ICONVG_PRIVATE_OPCODE_FLAG__REPS 0x01
+#define ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH 0x02
+#define ICONVG_PRIVATE_OPCODE_FLAG__SEGREF 0x04
+
+typedef struct iconvg_private_opcode_info_struct {
+  uint8_t handler;
+  uint8_t flags;
+  uint8_t num_bytes;
+  uint8_t num_naturals;
+} iconvg_private_opcode_info;
+
+#define ICONVG_PRIVATE_X16(...)                                     \
+  __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, \
+      __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, \
+      __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, __VA_ARGS__, \
+      __VA_ARGS__
+
+static const iconvg_private_opcode_info  //
+    iconvg_private_opcode_infos[256] = {
+        // 0x00 ..= 0x0F: LineTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO,
+                            ICONVG_PRIVATE_OPCODE_FLAG__REPS, 0, 2}),
+        // 0x10 ..= 0x1F: QuadTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO,
+                            ICONVG_PRIVATE_OPCODE_FLAG__REPS, 0, 4}),
+        // 0x20 ..= 0x2F: CubeTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO,
+                            ICONVG_PRIVATE_OPCODE_FLAG__REPS, 0, 6}),
+
+        // 0x30 ..= 0x33: Ellipse (1, 2, 3 or 4 quarters).
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        // 0x34: Parallelogram.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE, 0, 0, 4},
+        // 0x35: MoveTo.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO, 0, 0, 2},
+        // 0x36: SEL += arg.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD, 0, 1, 0},
+        // 0x37: NOP.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__NOP, 0, 0, 0},
+        // 0x38: Jump Unconditional.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__JUMP, 0, 0, 1},
+        // 0x39: Jump Feature-Bits.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__JUMP, 0, 0, 2},
+        // 0x3A: Jump Level-of-Detail.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__JUMP, 0, 0, 3},
+        // 0x3B: RET.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__RET, 0, 0, 0},
+        // 0x3C: Call Untransformed (SegRef).
+        {ICONVG_PRIVATE_OPCODE_HANDLER__CALL,
+         ICONVG_PRIVATE_OPCODE_FLAG__SEGREF, 0, 0},
+        // 0x3D: Call Transformed (alpha byte, 6 coordinates, SegRef).
+        {ICONVG_PRIVATE_OPCODE_HANDLER__CALL,
+         ICONVG_PRIVATE_OPCODE_FLAG__SEGREF, 1, 6},
+        // 0x3E ..= 0x3F: Reserved ops.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+         ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+         ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0, 0},
+
+        // 0x40 ..= 0x4F: SetReg[SEL+adj].lo32 = u32.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 4, 0}),
+        // 0x50 ..= 0x5F: SetReg[SEL+adj].hi32 = u32.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 4, 0}),
+        // 0x60 ..= 0x6F: SetReg[SEL+adj] = u64.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 8, 0}),
+        // 0x70 ..= 0x7F: SetRegs[SEL-N+1 ..= SEL] = N u64s, for N = 2 ..= 17.
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 16, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 24, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 32, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 40, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 48, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 56, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 64, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 72, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 80, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 88, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 96, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 104, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 112, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 120, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 128, 0},
+        {ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER, 0, 136, 0},
+
+        // 0x80 ..= 0x8F: Fill flat color.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL, 0, 0, 0}),
+        // 0x90 ..= 0x9F: Fill linear gradient (NSTOPS byte, 3 f32s).
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL, 0, 13, 0}),
+        // 0xA0 ..= 0xAF: Fill radial gradient (NSTOPS byte, 6 f32s).
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL, 0, 25, 0}),
+        // 0xB0 ..= 0xBF: Reserved fill ops.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__FILL,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            0}),
+
+        // 0xC0 ..= 0xDF: Reserved ops that end with a LineTo.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            2}),
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            2}),
+        // 0xE0 ..= 0xFF: Other reserved ops.
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            0}),
+        ICONVG_PRIVATE_X16({ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED,
+                            ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH, 0,
+                            0}),
+};
+
+#undef ICONVG_PRIVATE_X16
+
+// iconvg_private_decoder__decode_num_reps sets *dst to the repeat count of
+// an op with the REPS flag, decoding a natural number if opcode's low 4 bits
+// are zero.
+static inline bool  //
+iconvg_private_decoder__decode_num_reps(iconvg_private_decoder* self,
+                                        uint8_t opcode,
+                                        uint32_t* dst) {
+  uint32_t num_reps = opcode & 15;
+  if (num_reps == 0) {
+    if (!iconvg_private_decoder__decode_natural_number(self, &num_reps)) {
+      return false;
+    }
+    num_reps += 16;
+  }
+  *dst = num_reps;
+  return true;
+}
+
+// iconvg_private_decoder__skip_segref skips an 8-byte SegRef and, if it is an
+// Inline SegRef (one whose high 32 bits are zero), the segment contents that
+// immediately follow it.
+static inline bool  //
+iconvg_private_decoder__skip_segref(iconvg_private_decoder* self) {
+  if (!iconvg_private_decoder__ensure(self, 8)) {
+    return false;
+  }
+  uint64_t segref = iconvg_private_peek_u64le(self->ptr);
+  size_t n = 8;
+  if ((segref >> 32) == 0) {
+    n += (size_t)((segref >> 8) & 0xFFFFFF);
+  }
+  return iconvg_private_decoder__skip(self, n);
+}
+
+// ----
+
 static const char*  //
 iconvg_private_expand_call(iconvg_canvas* c,
                            iconvg_private_decoder* d,
@@ -209,35 +939,23 @@ iconvg_private_expand_call(iconvg_canvas* c,
                            uint8_t opcode) {
   // TODO: implement call ops. For now, just jump over them.
 
-  // Handle the ATM (Alpha and Transform Matrix).
+  // Handle the ATM (Alpha and Transform Matrix): an alpha byte and then six
+  // coordinates.
   if (opcode & 1) {
-    if (d->len < 25) {
-      return iconvg_error_bad_opcode_length;
-    }
-    d->ptr += 25;
-    d->len -= 25;
-  }
-
-  if (opcode & 2) {
-    // Absolute FileSegment.
-    if (d->len < 8) {
-      return iconvg_error_bad_opcode_length;
-    }
-    d->ptr += 8;
-    d->len -= 8;
-  } else {
-    // Inline FileSegment.
-    if (d->len < 4) {
+    if (!iconvg_private_decoder__skip(d, 1)) {
       return iconvg_error_bad_opcode_length;
     }
-    uint32_t n = 4 + (iconvg_private_peek_u32le(d->ptr) >> 8);
-    if (d->len < n) {
-      return iconvg_error_bad_opcode_length;
+    for (int i = 0; i < 6; i++) {
+      uint32_t dummy;
+      if (!iconvg_private_decoder__decode_natural_number(d, &dummy)) {
+        return iconvg_error_bad_coordinate;
+      }
     }
-    d->ptr += n;
-    d->len -= n;
   }
 
+  if (!iconvg_private_decoder__skip_segref(d)) {
+    return iconvg_error_bad_opcode_length;
+  }
   return NULL;
 }
 
@@ -247,21 +965,29 @@ iconvg_private_expand_ellipse_parallelogram(iconvg_canvas* c,
                                             iconvg_paint* p,
                                             uint8_t opcode) {
   // Decode the two explicit coordinate pairs.
-  if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1], 4)) {
+  if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[1], 4)) {
     return iconvg_error_bad_coordinate;
   }
 
   // The third coordinate pair is implicit.
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  for (int j = 0; j < 2; j++) {
+    int64_t v = ((int64_t)p->coords[0][j]) - ((int64_t)p->coords[1][j]) +
+                ((int64_t)p->coords[2][j]);
+    p->coords[3][j] = (v > INT32_MAX)   ? INT32_MAX
+                      : (v < INT32_MIN) ? INT32_MIN
+                                        : (int32_t)v;
+  }
+#else
   p->coords[3][0] = p->coords[0][0] - p->coords[1][0] + p->coords[2][0];
   p->coords[3][1] = p->coords[0][1] - p->coords[1][1] + p->coords[2][1];
+#endif
 
   // Handle a Parallelogram opcode.
   if (opcode >= 0x34) {
     for (int i = 1; i <= 4; i++) {  // Loop 1 ..= 4, not 0 ..= 3.
-      ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
-          c,                                                       //
-          (p->coords[i & 3][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-          (p->coords[i & 3][1] * p->s2d_scale_y) + p->s2d_bias_y));
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_line_to(
+          c, p, p->coords[i & 3][0], p->coords[i & 3][1]));
     }
     return NULL;
   }
@@ -269,6 +995,20 @@ iconvg_private_expand_ellipse_parallelogram(iconvg_canvas* c,
   // The ellipse approximation's cubic Bézier points are described at
   // https://nigeltao.github.io/blog/2021/three-points-define-ellipse.html
 
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  // k is 0.551784777779014 as a 16.16 fixed point number. Working with
+  // (2 * (B - center)) = (2*B - A - C) avoids rounding the center.
+  const int64_t k = 36162;
+  int64_t kr[2];
+  int64_t ks[2];
+  for (int j = 0; j < 2; j++) {
+    int64_t ca = p->coords[0][j];
+    int64_t cb = p->coords[1][j];
+    int64_t cc = p->coords[2][j];
+    kr[j] = ((k * ((2 * cb) - ca - cc)) + 0x10000) >> 17;
+    ks[j] = ((k * (cc - ca)) + 0x10000) >> 17;
+  }
+#else
   double center[2];
   center[0] = (p->coords[0][0] + p->coords[2][0]) / 2;
   center[1] = (p->coords[0][1] + p->coords[2][1]) / 2;
@@ -279,8 +1019,9 @@ iconvg_private_expand_ellipse_parallelogram(iconvg_canvas* c,
   double ks[2];
   ks[0] = k * (p->coords[2][0] - center[0]);
   ks[1] = k * (p->coords[2][1] - center[1]);
+#endif
 
-  double imps[12][2];  // A+ B- B,   B+ C- C,   C+ D- D,   D+ A- A.
+  iconvg_private_wide_coord imps[12][2];  // A+ B- B,   B+ C- C,   C+ D- D,   D+ A- A.
   imps[0][0] = p->coords[0][0] + kr[0];
   imps[0][1] = p->coords[0][1] + kr[1];
   imps[1][0] = p->coords[1][0] - ks[0];
@@ -307,16 +1048,15 @@ iconvg_private_expand_ellipse_parallelogram(iconvg_canvas* c,
   imps[11][1] = p->coords[0][1];
 
   for (size_t i = 0; i <= (opcode & 3); i++) {
-    ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
-        c,                                                        //
-        (imps[(3 * i) + 0][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-        (imps[(3 * i) + 0][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-        (imps[(3 * i) + 1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-        (imps[(3 * i) + 1][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-        (imps[(3 * i) + 2][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-        (imps[(3 * i) + 2][1] * p->s2d_scale_y) + p->s2d_bias_y));
-    p->coords[0][0] = imps[(3 * i) + 2][0];
-    p->coords[0][1] = imps[(3 * i) + 2][1];
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_cube_to(
+        c, p,                                            //
+        imps[(3 * i) + 0][0], imps[(3 * i) + 0][1],      //
+        imps[(3 * i) + 1][0], imps[(3 * i) + 1][1],      //
+        imps[(3 * i) + 2][0], imps[(3 * i) + 2][1]));
+    // The end points (B, C, D or A) are coords[1], coords[2], coords[3] or
+    // coords[0], so this cast does not overflow.
+    p->coords[0][0] = (iconvg_private_coord)imps[(3 * i) + 2][0];
+    p->coords[0][1] = (iconvg_private_coord)imps[(3 * i) + 2][1];
   }
   return NULL;
 }
@@ -342,91 +1082,54 @@ iconvg_private_expand_jump(iconvg_private_decoder* d,
     }
 
   } else if (opcode == 0x3A) {  // Jump Level-of-Detail.
-    float lod[2] = {0};
-    if (!iconvg_private_decoder__decode_coordinates(d, lod, 2)) {
+    iconvg_private_coord lod[2] = {0};
+    if (!iconvg_private_decoder__decode_path_coordinates(d, lod, 2)) {
       return iconvg_error_bad_number;
     }
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+    // lod is 24.8 fixed point, so scale h by 256 too. The bounds saturate at
+    // ±(1<<23), so clamping h to ±(1<<24) doesn't change the comparisons.
+    int64_t h = p->height_in_pixels;
+    h = (h < -(1 << 24)) ? -(1 << 24) : (h > (1 << 24)) ? (1 << 24) : h;
+    h *= 256;
+#else
     double h = p->height_in_pixels;
+#endif
     if ((lod[0] <= h) && (h < lod[1])) {
       return NULL;
     }
   }
 
   for (; jump_distance > 0; jump_distance--) {
-    if (d->len == 0) {
+    if (!iconvg_private_decoder__ensure(d, 1)) {
       return iconvg_error_bad_jump;
     }
     uint8_t opcode = d->ptr[0];
     d->ptr += 1;
     d->len -= 1;
+    const iconvg_private_opcode_info* info =
+        &iconvg_private_opcode_infos[opcode];
 
-    uint32_t num_bytes = 0;
-    uint64_t num_naturals = 0;
-    bool inline_file_segment = false;
-
-    if (opcode < 0x30) {
-      uint32_t num_reps = opcode & 15;
-      if (num_reps == 0) {
-        if (!iconvg_private_decoder__decode_natural_number(d, &num_reps)) {
-          return iconvg_error_bad_jump;
-        }
-        num_reps += 16;
-      }
-      uint64_t coordinate_pairs_per_rep = 1 + (opcode >> 4);
-      num_naturals = ((uint64_t)num_reps) * 2 * coordinate_pairs_per_rep;
-
-    } else if (opcode < 0x3C) {
-      static const uint8_t nums[16] = {
-          0x04, 0x04, 0x04, 0x04,  // Ellipse ops.
-          0x04, 0x02, 0x10, 0x00,  // Parallelogram, MoveTo, SEL += arg, NOP.
-          0x01, 0x02, 0x03, 0x00,  // Jump ops.
-          0x00, 0x00, 0x00, 0x00,  // Call ops are handled separately, below.
-      };
-      num_bytes = nums[opcode & 15] >> 4;
-      num_naturals = nums[opcode & 15] & 15;
-
-    } else if (opcode < 0x40) {
-      if (opcode & 1) {
-        num_bytes += 25;
-      }
-      if (opcode & 2) {
-        num_bytes += 8;
-      } else {
-        inline_file_segment = true;
+    uint64_t num_naturals = info->num_naturals;
+    if (info->flags & ICONVG_PRIVATE_OPCODE_FLAG__REPS) {
+      uint32_t num_reps = 0;
+      if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+        return iconvg_error_bad_jump;
       }
+      num_naturals *= num_reps;
+    }
 
-    } else if (opcode < 0x60) {
-      num_bytes = 4;
-
-    } else if (opcode < 0x70) {
-      num_bytes = 8;
-
-    } else if (opcode < 0x80) {
-      num_bytes = 8 * (2 + (opcode & 15));
-
-    } else if (opcode < 0x90) {
-      continue;
-
-    } else if (opcode < 0xA0) {
-      num_bytes = 13;
-
-    } else if (opcode < 0xB0) {
-      num_bytes = 25;
-
-    } else {
-      if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
+    if (info->flags & ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH) {
+      uint32_t num_bytes = 0;
+      if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes) ||
+          !iconvg_private_decoder__skip(d, num_bytes)) {
         return iconvg_error_bad_jump;
       }
-      if ((0xC0 <= opcode) && (opcode < 0xE0)) {
-        num_naturals = 2;
-      }
     }
 
-    if (d->len < num_bytes) {
+    if (!iconvg_private_decoder__skip(d, info->num_bytes)) {
       return iconvg_error_bad_jump;
     }
-    d->ptr += num_bytes;
-    d->len -= num_bytes;
 
     for (; num_naturals > 0; num_naturals--) {
       uint32_t dummy;
@@ -435,16 +1138,9 @@ iconvg_private_expand_jump(iconvg_private_decoder* d,
       }
     }
 
-    if (inline_file_segment) {
-      if (d->len < 4) {
-        return iconvg_error_bad_jump;
-      }
-      uint32_t n = 4 + (iconvg_private_peek_u32le(d->ptr) >> 8);
-      if (d->len < n) {
-        return iconvg_error_bad_jump;
-      }
-      d->ptr += n;
-      d->len -= n;
+    if ((info->flags & ICONVG_PRIVATE_OPCODE_FLAG__SEGREF) &&
+        !iconvg_private_decoder__skip_segref(d)) {
+      return iconvg_error_bad_jump;
     }
   }
 
@@ -453,277 +1149,392 @@ iconvg_private_expand_jump(iconvg_private_decoder* d,
 
 // ----
 
-static const char*  //
-iconvg_private_execute_bytecode(iconvg_canvas* c,
-                                iconvg_private_decoder* d,
-                                iconvg_paint* p) {
-  while (d->len > 0) {
-    uint8_t opcode = d->ptr[0];
+static inline const char*  //
+iconvg_private_execute_register_op(iconvg_private_decoder* d,
+                                   iconvg_paint* p,
+                                   uint8_t opcode) {
+  uint32_t adj = opcode & 15;
+  switch ((opcode >> 4) & 3) {
+    case 0:
+      if (!iconvg_private_decoder__ensure(d, 4)) {
+        return iconvg_error_bad_number;
+      }
+      p->regs[(p->sel + adj) & 63] =
+          ((uint64_t)iconvg_private_peek_u32le(d->ptr));
+      d->ptr += 4;
+      d->len -= 4;
+      break;
+    case 1:
+      if (!iconvg_private_decoder__ensure(d, 4)) {
+        return iconvg_error_bad_number;
+      }
+      p->regs[(p->sel + adj) & 63] =
+          ((uint64_t)iconvg_private_peek_u32le(d->ptr)) << 32;
+      d->ptr += 4;
+      d->len -= 4;
+      break;
+    case 2:
+      if (!iconvg_private_decoder__ensure(d, 8)) {
+        return iconvg_error_bad_number;
+      }
+      p->regs[(p->sel + adj) & 63] = iconvg_private_peek_u64le(d->ptr);
+      d->ptr += 8;
+      d->len -= 8;
+      break;
+    default:
+      adj += 2;
+      p->sel -= adj;
+      for (uint32_t i = 1; i <= adj; i++) {
+        if (!iconvg_private_decoder__ensure(d, 8)) {
+          return iconvg_error_bad_number;
+        }
+        p->regs[(p->sel + i) & 63] = iconvg_private_peek_u64le(d->ptr);
+        d->ptr += 8;
+        d->len -= 8;
+      }
+      return NULL;
+  }
+  p->sel -= (adj == 0) ? 1 : 0;
+  return NULL;
+}
+
+static inline const char*  //
+iconvg_private_execute_fill_op(iconvg_canvas* c,
+                               iconvg_private_decoder* d,
+                               iconvg_paint* p,
+                               uint8_t opcode) {
+  uint32_t adj = opcode & 15;
+  p->sel += (adj == 0) ? 1 : 0;
+  uint32_t num_transforms = 0;
+
+  switch ((opcode >> 4) & 3) {
+    case 0:
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
+      break;
+    case 1:
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__LINEAR_GRADIENT;
+      p->transform[3] = 0.0f;
+      p->transform[4] = 0.0f;
+      p->transform[5] = 0.0f;
+      num_transforms = 3;
+      break;
+    case 2:
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__RADIAL_GRADIENT;
+      num_transforms = 6;
+      break;
+    case 3: {
+      p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
+      uint32_t num_bytes = 0;
+      if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
+        return iconvg_error_bad_number;
+      }
+      if (!iconvg_private_decoder__skip(d, num_bytes)) {
+        return iconvg_error_bad_opcode_length;
+      }
+      break;
+    }
+  }
+  p->which_regs = (uint8_t)(p->sel + adj);
+
+  if (num_transforms > 0) {
+    if (!iconvg_private_decoder__ensure(d, 1)) {
+      return iconvg_error_bad_opcode_length;
+    }
+    p->num_stops = (d->ptr[0] & 63) + 2;
+    p->spread = d->ptr[0] >> 6;
     d->ptr += 1;
     d->len -= 1;
+    if (p->num_stops > 64) {
+      return iconvg_error_bad_opcode_length;
+    }
+    for (uint32_t i = 0; i < num_transforms; i++) {
+      if (!iconvg_private_decoder__decode_float32(d, &p->transform[i])) {
+        return iconvg_error_bad_number;
+      }
+    }
+  }
 
-    switch (opcode >> 6) {
-      case 0: {  // Path and miscellaneous ops.
-        if (opcode >= 0x36) {
-          if (opcode == 0x36) {  // SEL += arg.
-            if (d->len == 0) {
-              return iconvg_error_bad_number;
-            }
-            p->sel += d->ptr[0];
-            d->ptr += 1;
-            d->len -= 1;
-            continue;
-          } else if (opcode == 0x37) {  // NOP.
-            continue;
-          } else if (opcode < 0x3B) {  // Jump ops.
-            ICONVG_PRIVATE_TRY(iconvg_private_expand_jump(d, p, opcode));
-            continue;
-          } else if (opcode > 0x3B) {  // Call ops.
-            ICONVG_PRIVATE_TRY(iconvg_private_expand_call(c, d, p, opcode));
-            continue;
-          }
-          // RET.
-          return NULL;
-        }
+  if (p->begun_path) {
+    p->begun_path = false;
+    ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+  }
+  if (p->begun_drawing) {
+    p->begun_drawing = false;
+    ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, p));
+  }
+  return NULL;
+}
 
-        if (!p->begun_drawing) {
-          p->begun_drawing = true;
-          ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
-        }
+static inline const char*  //
+iconvg_private_execute_reserved_op(iconvg_canvas* c,
+                                   iconvg_private_decoder* d,
+                                   iconvg_paint* p,
+                                   uint8_t opcode) {
+  uint32_t num_bytes = 0;
+  if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
+    return iconvg_error_bad_number;
+  }
+  if (!iconvg_private_decoder__skip(d, num_bytes)) {
+    return iconvg_error_bad_opcode_length;
+  }
+  if ((0xC0 <= opcode) && (opcode < 0xE0)) {
+    if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[1], 2)) {
+      return iconvg_error_bad_coordinate;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_line_to(
+        c, p, p->coords[1][0], p->coords[1][1]));
+    p->coords[0][0] = p->coords[1][0];
+    p->coords[0][1] = p->coords[1][1];
+  }
+  return NULL;
+}
 
-        if (opcode == 0x35) {
-          if (!iconvg_private_decoder__decode_coordinates(d, p->coords[0], 2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          if (p->begun_path) {
-            ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-          } else {
-            p->begun_path = true;
-          }
-          ICONVG_PRIVATE_TRY((*c->vtable->begin_path)(
-              c,                                                   //
-              (p->coords[0][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[0][1] * p->s2d_scale_y) + p->s2d_bias_y));
-          continue;
-        }
+// ----
 
-        if (!p->begun_path) {
-          p->begun_path = true;
-          ICONVG_PRIVATE_TRY((*c->vtable->begin_path)(
-              c,                                                   //
-              (p->coords[0][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[0][1] * p->s2d_scale_y) + p->s2d_bias_y));
-        }
+// With GCC and Clang, iconvg_private_execute_bytecode uses computed gotos (a
+// GNU C extension) to jump straight from one op's handler to the next's,
+// each handler having its own indirect branch. Otherwise, or if the
+// ICONVG_CONFIG__DISABLE_COMPUTED_GOTO macro is defined, it uses a switch.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    !defined(ICONVG_CONFIG__DISABLE_COMPUTED_GOTO)
+#define ICONVG_PRIVATE_HAVE_COMPUTED_GOTO 1
+#endif
+
+// iconvg_private_canvas__ensure_begun_path calls begin_drawing and then
+// begin_path (at the current point), unless they have already been called.
+static inline const char*  //
+iconvg_private_canvas__ensure_begun_path(iconvg_canvas* c, iconvg_paint* p) {
+  if (!p->begun_drawing) {
+    p->begun_drawing = true;
+    ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
+  }
+  if (!p->begun_path) {
+    p->begun_path = true;
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__begin_path(
+        c, p, p->coords[0][0], p->coords[0][1]));
+  }
+  return NULL;
+}
 
-        if (opcode >= 0x30) {
-          ICONVG_PRIVATE_TRY(
-              iconvg_private_expand_ellipse_parallelogram(c, d, p, opcode));
-          continue;
-        }
+static inline const char*  //
+iconvg_private_execute_move_to(iconvg_canvas* c,
+                               iconvg_private_decoder* d,
+                               iconvg_paint* p) {
+  if (!p->begun_drawing) {
+    p->begun_drawing = true;
+    ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
+  }
+  if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[0], 2)) {
+    return iconvg_error_bad_coordinate;
+  }
+  if (p->begun_path) {
+    ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+  } else {
+    p->begun_path = true;
+  }
+  return iconvg_private_canvas__begin_path(c, p, p->coords[0][0],
+                                           p->coords[0][1]);
+}
 
-        uint32_t num_reps = opcode & 15;
-        if (num_reps == 0) {
-          if (!iconvg_private_decoder__decode_natural_number(d, &num_reps)) {
-            return iconvg_error_bad_number;
-          }
-          num_reps += 16;
-        }
+static inline const char*  //
+iconvg_private_execute_sel_add(iconvg_private_decoder* d, iconvg_paint* p) {
+  if (!iconvg_private_decoder__ensure(d, 1)) {
+    return iconvg_error_bad_number;
+  }
+  p->sel += d->ptr[0];
+  d->ptr += 1;
+  d->len -= 1;
+  return NULL;
+}
 
-        switch (opcode >> 4) {
-          case 0:
-            for (; num_reps > 0; num_reps--) {
-              if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1],
-                                                              2)) {
-                return iconvg_error_bad_coordinate;
-              }
-              ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
-                  c,                                                   //
-                  (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-                  (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y));
-            }
-            p->coords[0][0] = p->coords[1][0];
-            p->coords[0][1] = p->coords[1][1];
-            continue;
-
-          case 1:
-            for (; num_reps > 0; num_reps--) {
-              if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1],
-                                                              4)) {
-                return iconvg_error_bad_coordinate;
-              }
-              ICONVG_PRIVATE_TRY((*c->vtable->path_quad_to)(
-                  c,                                                   //
-                  (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-                  (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-                  (p->coords[2][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-                  (p->coords[2][1] * p->s2d_scale_y) + p->s2d_bias_y));
-            }
-            p->coords[0][0] = p->coords[2][0];
-            p->coords[0][1] = p->coords[2][1];
-            continue;
-        }
+// iconvg_private_execute_path_run executes num_reps repetitions of a LineTo,
+// QuadTo or CubeTo op (with num_points being 1, 2 or 3), decoding and then
+// transforming up to ICONVG_PRIVATE_PATH_RUN__MAX_REPS of them at a time.
+static inline const char*  //
+iconvg_private_execute_path_run(iconvg_canvas* c,
+                                iconvg_private_decoder* d,
+                                iconvg_paint* p,
+                                uint32_t num_reps,
+                                size_t num_points) {
+  iconvg_private_coord src[ICONVG_PRIVATE_PATH_RUN__MAX_COORDS];
+  const size_t rep_len = 2 * num_points;
+  while (num_reps > 0) {
+    uint32_t n = (num_reps < ICONVG_PRIVATE_PATH_RUN__MAX_REPS)
+                     ? num_reps
+                     : ICONVG_PRIVATE_PATH_RUN__MAX_REPS;
+    size_t num_complete_reps =
+        iconvg_private_decoder__decode_path_coordinate_run(d, src,
+                                                           n * rep_len) /
+        rep_len;
+    // As if executing the repetitions one at a time, the canvas sees every
+    // repetition before the first bad coordinate.
+    if (num_complete_reps > 0) {
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_run(c, p, src, num_points,
+                                                         num_complete_reps));
+      p->coords[0][0] = src[(num_complete_reps * rep_len) - 2];
+      p->coords[0][1] = src[(num_complete_reps * rep_len) - 1];
+    }
+    if (num_complete_reps < n) {
+      return iconvg_error_bad_coordinate;
+    }
+    num_reps -= n;
+  }
+  return NULL;
+}
 
-        for (; num_reps > 0; num_reps--) {
-          if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1], 6)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY((*c->vtable->path_cube_to)(
-              c,                                                   //
-              (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-              (p->coords[2][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[2][1] * p->s2d_scale_y) + p->s2d_bias_y,  //
-              (p->coords[3][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[3][1] * p->s2d_scale_y) + p->s2d_bias_y));
-        }
-        p->coords[0][0] = p->coords[3][0];
-        p->coords[0][1] = p->coords[3][1];
-        continue;
-      }
+#if defined(ICONVG_PRIVATE_HAVE_COMPUTED_GOTO)
+#define ICONVG_PRIVATE_HANDLER(h) handler_##h
+#define ICONVG_PRIVATE_NEXT_OPCODE()                                       \
+  do {                                                                     \
+    if ((d->len == 0) && !iconvg_private_decoder__refill(d, 1)) {          \
+      return NULL;                                                         \
+    }                                                                      \
+    ICONVG_PRIVATE_OBSERVE_OP(d->ptr);                                     \
+    opcode = d->ptr[0];                                                    \
+    d->ptr += 1;                                                           \
+    d->len -= 1;                                                           \
+    goto* handlers[iconvg_private_opcode_infos[opcode].handler];           \
+  } while (0)
+#else
+#define ICONVG_PRIVATE_HANDLER(h) case ICONVG_PRIVATE_OPCODE_HANDLER__##h
+#define ICONVG_PRIVATE_NEXT_OPCODE() goto next_opcode
+#endif
 
-      case 1: {  // Register ops.
-        uint32_t adj = opcode & 15;
-        switch ((opcode >> 4) & 3) {
-          case 0:
-            if (d->len < 4) {
-              return iconvg_error_bad_number;
-            }
-            p->regs[(p->sel + adj) & 63] =
-                ((uint64_t)iconvg_private_peek_u32le(d->ptr));
-            d->ptr += 4;
-            d->len -= 4;
-            break;
-          case 1:
-            if (d->len < 4) {
-              return iconvg_error_bad_number;
-            }
-            p->regs[(p->sel + adj) & 63] =
-                ((uint64_t)iconvg_private_peek_u32le(d->ptr)) << 32;
-            d->ptr += 4;
-            d->len -= 4;
-            break;
-          case 2:
-            if (d->len < 8) {
-              return iconvg_error_bad_number;
-            }
-            p->regs[(p->sel + adj) & 63] = iconvg_private_peek_u64le(d->ptr);
-            d->ptr += 8;
-            d->len -= 8;
-            break;
-          default:
-            adj += 2;
-            p->sel -= adj;
-            for (uint32_t i = 1; i <= adj; i++) {
-              if (d->len < 8) {
-                return iconvg_error_bad_number;
-              }
-              p->regs[(p->sel + i) & 63] = iconvg_private_peek_u64le(d->ptr);
-              d->ptr += 8;
-              d->len -= 8;
-            }
-            continue;
-        }
-        p->sel -= (adj == 0) ? 1 : 0;
-        continue;
-      }
+static const char*  //
+iconvg_private_execute_bytecode(iconvg_canvas* c,
+                                iconvg_private_decoder* d,
+                                iconvg_paint* p) {
+  uint8_t opcode = 0;
+
+#if defined(ICONVG_PRIVATE_HAVE_COMPUTED_GOTO)
+  // This array's order matches the ICONVG_PRIVATE_OPCODE_HANDLER__ETC values.
+  static const void* const handlers[ICONVG_PRIVATE_OPCODE_HANDLER__COUNT] = {
+      &&handler_LINE_TO,  &&handler_QUAD_TO,  &&handler_CUBE_TO,
+      &&handler_ELLIPSE,  &&handler_MOVE_TO,  &&handler_SEL_ADD,
+      &&handler_NOP,      &&handler_JUMP,     &&handler_RET,
+      &&handler_CALL,     &&handler_REGISTER, &&handler_FILL,
+      &&handler_RESERVED,
+  };
+  ICONVG_PRIVATE_NEXT_OPCODE();
+#else
+next_opcode:
+  if ((d->len == 0) && !iconvg_private_decoder__refill(d, 1)) {
+    return NULL;
+  }
+  ICONVG_PRIVATE_OBSERVE_OP(d->ptr);
+  opcode = d->ptr[0];
+  d->ptr += 1;
+  d->len -= 1;
+  switch (iconvg_private_opcode_infos[opcode].handler) {
+#endif
+
+  ICONVG_PRIVATE_HANDLER(LINE_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    uint32_t num_reps = 0;
+    if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+      return iconvg_error_bad_number;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_path_run(c, d, p, num_reps, 1));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
 
-      case 2: {  // Fill ops.
-        uint32_t adj = opcode & 15;
-        p->sel += (adj == 0) ? 1 : 0;
-        uint32_t num_transforms = 0;
-
-        switch ((opcode >> 4) & 3) {
-          case 0:
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
-            break;
-          case 1:
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__LINEAR_GRADIENT;
-            p->transform[3] = 0.0f;
-            p->transform[4] = 0.0f;
-            p->transform[5] = 0.0f;
-            num_transforms = 3;
-            break;
-          case 2:
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__RADIAL_GRADIENT;
-            num_transforms = 6;
-            break;
-          case 3: {
-            p->paint_type = (uint8_t)ICONVG_PAINT_TYPE__FLAT_COLOR;
-            uint32_t num_bytes = 0;
-            if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
-              return iconvg_error_bad_number;
-            }
-            if (d->len < num_bytes) {
-              return iconvg_error_bad_opcode_length;
-            }
-            d->ptr += num_bytes;
-            d->len -= num_bytes;
-            break;
-          }
-        }
-        p->which_regs = (uint8_t)(p->sel + adj);
+  ICONVG_PRIVATE_HANDLER(QUAD_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    uint32_t num_reps = 0;
+    if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+      return iconvg_error_bad_number;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_path_run(c, d, p, num_reps, 2));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
 
-        if (num_transforms > 0) {
-          if (d->len == 0) {
-            return iconvg_error_bad_opcode_length;
-          }
-          p->num_stops = (d->ptr[0] & 63) + 2;
-          p->spread = d->ptr[0] >> 6;
-          d->ptr += 1;
-          d->len -= 1;
-          if (p->num_stops > 64) {
-            return iconvg_error_bad_opcode_length;
-          }
-          for (uint32_t i = 0; i < num_transforms; i++) {
-            if (!iconvg_private_decoder__decode_float32(d, &p->transform[i])) {
-              return iconvg_error_bad_number;
-            }
-          }
-        }
+  ICONVG_PRIVATE_HANDLER(CUBE_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    uint32_t num_reps = 0;
+    if (!iconvg_private_decoder__decode_num_reps(d, opcode, &num_reps)) {
+      return iconvg_error_bad_number;
+    }
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_path_run(c, d, p, num_reps, 3));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
 
-        if (p->begun_path) {
-          p->begun_path = false;
-          ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
-        }
-        if (p->begun_drawing) {
-          p->begun_drawing = false;
-          ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, p));
-        }
-        continue;
-      }
+  ICONVG_PRIVATE_HANDLER(ELLIPSE) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+    ICONVG_PRIVATE_TRY(
+        iconvg_private_expand_ellipse_parallelogram(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
 
-      case 3: {  // Reserved ops.
-        uint32_t num_bytes = 0;
-        if (!iconvg_private_decoder__decode_natural_number(d, &num_bytes)) {
-          return iconvg_error_bad_number;
-        }
-        if (d->len < num_bytes) {
-          return iconvg_error_bad_opcode_length;
-        }
-        d->ptr += num_bytes;
-        d->len -= num_bytes;
-        if (opcode < 0xE0) {
-          if (!iconvg_private_decoder__decode_coordinates(d, p->coords[1], 2)) {
-            return iconvg_error_bad_coordinate;
-          }
-          ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(
-              c,                                                   //
-              (p->coords[1][0] * p->s2d_scale_x) + p->s2d_bias_x,  //
-              (p->coords[1][1] * p->s2d_scale_y) + p->s2d_bias_y));
-          p->coords[0][0] = p->coords[1][0];
-          p->coords[0][1] = p->coords[1][1];
-        }
-      }
-    }
+  ICONVG_PRIVATE_HANDLER(MOVE_TO) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_move_to(c, d, p));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(SEL_ADD) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_sel_add(d, p));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(NOP) : {
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(JUMP) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_expand_jump(d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(RET) : {
+    return NULL;
+  }
+
+  ICONVG_PRIVATE_HANDLER(CALL) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_expand_call(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(REGISTER) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_register_op(d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(FILL) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_fill_op(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+  ICONVG_PRIVATE_HANDLER(RESERVED) : {
+    ICONVG_PRIVATE_TRY(iconvg_private_execute_reserved_op(c, d, p, opcode));
+    ICONVG_PRIVATE_NEXT_OPCODE();
+  }
+
+#if !defined(ICONVG_PRIVATE_HAVE_COMPUTED_GOTO)
   }
   return NULL;
+#endif
 }
 
+#undef ICONVG_PRIVATE_HANDLER
+#undef ICONVG_PRIVATE_NEXT_OPCODE
+
 // ----
 
-static void  //
-iconvg_private_initialize_remaining_paint_fields(iconvg_paint* p,
-                                                 iconvg_rectangle_f32 r) {
+const iconvg_matrix_2x3_f64*  //
+iconvg_private_dst_transform(const iconvg_decode_options* options) {
+  if (!options ||
+      (options->sizeof__iconvg_decode_options <
+       (offsetof(iconvg_decode_options, dst_transform) +
+        sizeof(options->dst_transform)))) {
+    return NULL;
+  }
+  return options->dst_transform;
+}
+
+void  //
+iconvg_private_initialize_remaining_paint_fields(
+    iconvg_paint* p,
+    iconvg_rectangle_f32 r,
+    const iconvg_matrix_2x3_f64* m) {
   double rw = iconvg_rectangle_f32__width_f64(&r);
   double rh = iconvg_rectangle_f32__height_f64(&r);
   double vw = iconvg_rectangle_f32__width_f64(&p->viewbox);
@@ -740,10 +1551,79 @@ iconvg_private_initialize_remaining_paint_fields(iconvg_paint* p,
     p->s2d_bias_y = 0.0;
   }
 
+  p->s2d_skew_x = 0.0;
+  p->s2d_skew_y = 0.0;
+
+  // An identity m is the same as no m. Any other axis-aligned m (a scale and
+  // a translation) keeps s2d axis-aligned, so compose it directly and derive
+  // d2s the same way as for no m, rather than by a general matrix inverse.
+  // Either way, the results are exact, not off by an ulp or so.
+  if (m && (m->elems[0][1] == 0) && (m->elems[1][0] == 0)) {
+    if ((m->elems[0][0] == 1) && (m->elems[0][2] == 0) &&
+        (m->elems[1][1] == 1) && (m->elems[1][2] == 0)) {
+      m = NULL;
+    } else if ((m->elems[0][0] != 0) && (m->elems[1][1] != 0)) {
+      p->s2d_bias_x = (m->elems[0][0] * p->s2d_bias_x) + m->elems[0][2];
+      p->s2d_bias_y = (m->elems[1][1] * p->s2d_bias_y) + m->elems[1][2];
+      p->s2d_scale_x *= m->elems[0][0];
+      p->s2d_scale_y *= m->elems[1][1];
+      m = NULL;
+    }
+  }
+
   p->d2s_scale_x = 1.0 / p->s2d_scale_x;
   p->d2s_bias_x = -p->s2d_bias_x * p->d2s_scale_x;
   p->d2s_scale_y = 1.0 / p->s2d_scale_y;
   p->d2s_bias_y = -p->s2d_bias_y * p->d2s_scale_y;
+  p->d2s_skew_x = 0.0;
+  p->d2s_skew_y = 0.0;
+
+  p->skewed = false;
+
+  if (m) {
+    // Compose the (not axis-aligned) m after the axis-aligned s2d transform.
+    iconvg_matrix_2x3_f64 s2d = iconvg_matrix_2x3_f64__make(
+        m->elems[0][0] * p->s2d_scale_x,  //
+        m->elems[0][1] * p->s2d_scale_y,  //
+        (m->elems[0][0] * p->s2d_bias_x) + (m->elems[0][1] * p->s2d_bias_y) +
+            m->elems[0][2],               //
+        m->elems[1][0] * p->s2d_scale_x,  //
+        m->elems[1][1] * p->s2d_scale_y,  //
+        (m->elems[1][0] * p->s2d_bias_x) + (m->elems[1][1] * p->s2d_bias_y) +
+            m->elems[1][2]);
+    iconvg_matrix_2x3_f64 d2s = iconvg_matrix_2x3_f64__inverse(&s2d);
+
+    p->s2d_scale_x = s2d.elems[0][0];
+    p->s2d_skew_x = s2d.elems[0][1];
+    p->s2d_bias_x = s2d.elems[0][2];
+    p->s2d_skew_y = s2d.elems[1][0];
+    p->s2d_scale_y = s2d.elems[1][1];
+    p->s2d_bias_y = s2d.elems[1][2];
+
+    p->d2s_scale_x = d2s.elems[0][0];
+    p->d2s_skew_x = d2s.elems[0][1];
+    p->d2s_bias_x = d2s.elems[0][2];
+    p->d2s_skew_y = d2s.elems[1][0];
+    p->d2s_scale_y = d2s.elems[1][1];
+    p->d2s_bias_y = d2s.elems[1][2];
+
+    p->skewed = (p->s2d_skew_x != 0) || (p->s2d_skew_y != 0);
+  }
+
+#if defined(ICONVG_CONFIG__FIXED_POINT)
+  p->s2d_fixed_scale_x = iconvg_private_fixed_from_f64(p->s2d_scale_x, 65536.0,
+                                                       ((int64_t)1) << 28);
+  p->s2d_fixed_bias_x = iconvg_private_fixed_from_f64(p->s2d_bias_x, 256.0,
+                                                      ((int64_t)1) << 40);
+  p->s2d_fixed_scale_y = iconvg_private_fixed_from_f64(p->s2d_scale_y, 65536.0,
+                                                       ((int64_t)1) << 28);
+  p->s2d_fixed_bias_y = iconvg_private_fixed_from_f64(p->s2d_bias_y, 256.0,
+                                                      ((int64_t)1) << 40);
+  p->s2d_fixed_skew_x = iconvg_private_fixed_from_f64(p->s2d_skew_x, 65536.0,
+                                                      ((int64_t)1) << 28);
+  p->s2d_fixed_skew_y = iconvg_private_fixed_from_f64(p->s2d_skew_y, 65536.0,
+                                                      ((int64_t)1) << 28);
+#endif
 
   p->sel = 56;
   p->begun_drawing = false;
@@ -754,14 +1634,14 @@ iconvg_private_initialize_remaining_paint_fields(iconvg_paint* p,
   p->spread = 0;
   p->which_regs = 0;
 
-  p->coords[0][0] = 0.0f;
-  p->coords[0][1] = 0.0f;
-  p->coords[1][0] = 0.0f;
-  p->coords[1][1] = 0.0f;
-  p->coords[2][0] = 0.0f;
-  p->coords[2][1] = 0.0f;
-  p->coords[3][0] = 0.0f;
-  p->coords[3][1] = 0.0f;
+  p->coords[0][0] = 0;
+  p->coords[0][1] = 0;
+  p->coords[1][0] = 0;
+  p->coords[1][1] = 0;
+  p->coords[2][0] = 0;
+  p->coords[2][1] = 0;
+  p->coords[3][0] = 0;
+  p->coords[3][1] = 0;
 
   for (int i = 0; i < 64; i++) {
     uint32_t u =
@@ -779,6 +1659,7 @@ iconvg_decode_viewbox(iconvg_rectangle_f32* dst_viewbox,
   iconvg_private_decoder d;
   d.ptr = src_ptr;
   d.len = src_len;
+  d.iov = NULL;
 
   if (!iconvg_private_decoder__decode_magic_identifier(&d)) {
     return iconvg_error_bad_magic_identifier;
@@ -832,28 +1713,35 @@ iconvg_decode_viewbox(iconvg_rectangle_f32* dst_viewbox,
   return NULL;
 }
 
-static const char*  //
-iconvg_private_decode(iconvg_canvas* c,
-                      iconvg_rectangle_f32 r,
-                      iconvg_private_decoder* d,
-                      const iconvg_decode_options* options) {
-  iconvg_paint p;
-  p.viewbox = iconvg_private_default_viewbox();
+int64_t  //
+iconvg_private_height_in_pixels(iconvg_rectangle_f32 r,
+                                const iconvg_decode_options* options) {
   if (options && options->height_in_pixels.has_value) {
-    p.height_in_pixels = options->height_in_pixels.value;
-  } else {
-    double h = iconvg_rectangle_f32__height_f64(&r);
-    // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
-    // than MAX_INT32 and also ensures that conversion between integer and
-    // float or double is lossless.
-    if (h <= 0x100000) {
-      p.height_in_pixels = (int64_t)h;
-    } else {
-      p.height_in_pixels = 0x100000;
-    }
+    return options->height_in_pixels.value;
   }
-  memcpy(&p.custom_palette, &iconvg_private_default_palette,
-         sizeof(p.custom_palette));
+  double h = iconvg_rectangle_f32__height_f64(&r);
+  // The 0x10_0000 = (1 << 20) = 1048576 limit is arbitrary but it's less
+  // than MAX_INT32 and also ensures that conversion between integer and
+  // float or double is lossless.
+  if (h <= 0x100000) {
+    return (int64_t)h;
+  }
+  return 0x100000;
+}
+
+// iconvg_private_decode_header decodes the magic identifier and metadata,
+// passing the latter to c, and sets up p to execute the bytecode that
+// follows.
+static const char*  //
+iconvg_private_decode_header(iconvg_canvas* c,
+                             iconvg_rectangle_f32 r,
+                             iconvg_private_decoder* d,
+                             iconvg_paint* p,
+                             const iconvg_decode_options* options) {
+  p->viewbox = iconvg_private_default_viewbox();
+  p->height_in_pixels = iconvg_private_height_in_pixels(r, options);
+  memcpy(&p->custom_palette, &iconvg_private_default_palette,
+         sizeof(p->custom_palette));
 
   if (!iconvg_private_decoder__decode_magic_identifier(d)) {
     return iconvg_error_bad_magic_identifier;
@@ -867,7 +1755,7 @@ iconvg_private_decode(iconvg_canvas* c,
   for (; num_metadata_chunks > 0; num_metadata_chunks--) {
     uint32_t chunk_length;
     if (!iconvg_private_decoder__decode_natural_number(d, &chunk_length) ||
-        (chunk_length > d->len)) {
+        !iconvg_private_decoder__ensure(d, chunk_length)) {
       return iconvg_error_bad_metadata;
     }
     iconvg_private_decoder chunk =
@@ -882,7 +1770,7 @@ iconvg_private_decode(iconvg_canvas* c,
     switch (metadata_id) {
       case 8:  // MID 8 (ViewBox).
         if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk,
-                                                             &p.viewbox) ||
+                                                             &p->viewbox) ||
             (chunk.len != 0)) {
           return iconvg_error_bad_metadata_viewbox;
         }
@@ -890,7 +1778,7 @@ iconvg_private_decode(iconvg_canvas* c,
 
       case 16:  // MID 16 (Suggested Palette).
         if (!iconvg_private_decoder__decode_metadata_suggested_palette(
-                &chunk, &p.custom_palette) ||
+                &chunk, &p->custom_palette) ||
             (chunk.len != 0)) {
           return iconvg_error_bad_metadata_suggested_palette;
         }
@@ -905,15 +1793,26 @@ iconvg_private_decode(iconvg_canvas* c,
     previous_metadata_id = ((int32_t)metadata_id);
   }
 
-  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, p.viewbox));
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, p->viewbox));
   ICONVG_PRIVATE_TRY(
-      (*c->vtable->on_metadata_suggested_palette)(c, &p.custom_palette));
+      (*c->vtable->on_metadata_suggested_palette)(c, &p->custom_palette));
 
   if (options && options->palette) {
-    memcpy(&p.custom_palette, options->palette, sizeof(p.custom_palette));
+    memcpy(&p->custom_palette, options->palette, sizeof(p->custom_palette));
   }
 
-  iconvg_private_initialize_remaining_paint_fields(&p, r);
+  iconvg_private_initialize_remaining_paint_fields(
+      p, r, iconvg_private_dst_transform(options));
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_decode(iconvg_canvas* c,
+                      iconvg_rectangle_f32 r,
+                      iconvg_private_decoder* d,
+                      const iconvg_decode_options* options) {
+  iconvg_paint p;
+  ICONVG_PRIVATE_TRY(iconvg_private_decode_header(c, r, d, &p, options));
   return iconvg_private_execute_bytecode(c, d, &p);
 }
 
@@ -939,6 +1838,7 @@ iconvg_decode(iconvg_canvas* dst_canvas,
   iconvg_private_decoder d;
   d.ptr = src_ptr;
   d.len = src_len;
+  d.iov = NULL;
 
   const char* err_msg =
       (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
@@ -948,3 +1848,758 @@ iconvg_decode(iconvg_canvas* dst_canvas,
   return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg, src_len - d.len,
                                            d.len);
 }
+
+const char*  //
+iconvg_decode_iov(iconvg_canvas* dst_canvas,
+                  iconvg_rectangle_f32 dst_rect,
+                  const struct iovec* iov,
+                  int iovcnt,
+                  const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+
+  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
+      sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+
+  iconvg_private_decoder_iov v;
+  v.iov = iov;
+  v.offset = 0;
+  v.remaining = 0;
+  for (int i = 0; iov && (i < iovcnt); i++) {
+    v.remaining += iov[i].iov_len;
+  }
+  size_t src_len = v.remaining;
+
+  iconvg_private_decoder d;
+  d.ptr = NULL;
+  d.len = 0;
+  d.iov = &v;
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_decode(dst_canvas, dst_rect, &d, options);
+  }
+  size_t num_bytes_remaining = d.len + v.remaining;
+  return (*dst_canvas->vtable->end_decode)(
+      dst_canvas, err_msg, src_len - num_bytes_remaining, num_bytes_remaining);
+}
+
+// ----
+
+// The iconvg_op_iterator's private_impl.paint holds an iconvg_paint, whose
+// size is only known here.
+typedef char iconvg_private_op_iterator_paint_storage_is_large_enough
+    [(sizeof(iconvg_paint) <=
+      (sizeof(uint64_t) * ICONVG_OP_ITERATOR__PAINT_STORAGE_SIZE))
+         ? 1
+         : -1];
+
+// iconvg_private_op_iterator_canvas is a canvas that appends each method call
+// to the iconvg_op_iterator (its context.nonconst_ptr1)'s queue of ops.
+
+static iconvg_op*  //
+iconvg_private_op_iterator_canvas__push(iconvg_canvas* c, iconvg_op_type t) {
+  iconvg_op_iterator* self = (iconvg_op_iterator*)(c->context.nonconst_ptr1);
+  if (self->private_impl.ops_wi >= ICONVG_OP_ITERATOR__MAX_PENDING_OPS) {
+    return NULL;
+  }
+  iconvg_op* op = &self->private_impl.ops[self->private_impl.ops_wi++];
+  memset(op, 0, sizeof(*op));
+  op->type = t;
+  return op;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__begin_decode(iconvg_canvas* c,
+                                                iconvg_rectangle_f32 dst_rect) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__end_decode(iconvg_canvas* c,
+                                              const char* err_msg,
+                                              size_t num_bytes_consumed,
+                                              size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__BEGIN_DRAWING);
+  return op ? NULL : iconvg_error_system_failure_out_of_memory;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__end_drawing(iconvg_canvas* c,
+                                               const iconvg_paint* p) {
+  // The op's paint field is set by iconvg_op_iterator__next, as the iterator
+  // (and its paint) might have moved since.
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__END_DRAWING);
+  return op ? NULL : iconvg_error_system_failure_out_of_memory;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__begin_path(iconvg_canvas* c,
+                                              float x0,
+                                              float y0) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__BEGIN_PATH);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x0 = x0;
+  op->y0 = y0;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__end_path(iconvg_canvas* c) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__END_PATH);
+  return op ? NULL : iconvg_error_system_failure_out_of_memory;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__path_line_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__PATH_LINE_TO);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x1 = x1;
+  op->y1 = y1;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__path_quad_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__PATH_QUAD_TO);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x1 = x1;
+  op->y1 = y1;
+  op->x2 = x2;
+  op->y2 = y2;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__path_cube_to(iconvg_canvas* c,
+                                                float x1,
+                                                float y1,
+                                                float x2,
+                                                float y2,
+                                                float x3,
+                                                float y3) {
+  iconvg_op* op =
+      iconvg_private_op_iterator_canvas__push(c, ICONVG_OP_TYPE__PATH_CUBE_TO);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->x1 = x1;
+  op->y1 = y1;
+  op->x2 = x2;
+  op->y2 = y2;
+  op->x3 = x3;
+  op->y3 = y3;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_op* op = iconvg_private_op_iterator_canvas__push(
+      c, ICONVG_OP_TYPE__ON_METADATA_VIEWBOX);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  op->viewbox = viewbox;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_op_iterator_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_op_iterator* self = (iconvg_op_iterator*)(c->context.nonconst_ptr1);
+  iconvg_op* op = iconvg_private_op_iterator_canvas__push(
+      c, ICONVG_OP_TYPE__ON_METADATA_SUGGESTED_PALETTE);
+  if (!op) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  memcpy(&self->private_impl.suggested_palette, suggested_palette,
+         sizeof(*suggested_palette));
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_op_iterator_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_op_iterator_canvas__begin_decode,
+        &iconvg_private_op_iterator_canvas__end_decode,
+        &iconvg_private_op_iterator_canvas__begin_drawing,
+        &iconvg_private_op_iterator_canvas__end_drawing,
+        &iconvg_private_op_iterator_canvas__begin_path,
+        &iconvg_private_op_iterator_canvas__end_path,
+        &iconvg_private_op_iterator_canvas__path_line_to,
+        &iconvg_private_op_iterator_canvas__path_quad_to,
+        &iconvg_private_op_iterator_canvas__path_cube_to,
+        &iconvg_private_op_iterator_canvas__on_metadata_viewbox,
+        &iconvg_private_op_iterator_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+static iconvg_canvas  //
+iconvg_private_op_iterator__make_canvas(iconvg_op_iterator* self) {
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_op_iterator_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = self;
+  return c;
+}
+
+// iconvg_private_op_iterator__step is like iconvg_private_execute_bytecode
+// but it stops as soon as c (an iconvg_private_op_iterator_canvas) has queued
+// any ops. Ops with repeated coordinates stop after each repetition, leaving
+// the rest in private_impl.num_reps.
+static const char*  //
+iconvg_private_op_iterator__step(iconvg_op_iterator* self,
+                                 iconvg_canvas* c,
+                                 iconvg_private_decoder* d,
+                                 iconvg_paint* p) {
+  while (self->private_impl.ops_wi == 0) {
+    if (self->private_impl.num_reps > 0) {
+      self->private_impl.num_reps--;
+      bool last = self->private_impl.num_reps == 0;
+
+      switch (self->private_impl.rep_opcode >> 4) {
+        case 0:
+          if (!iconvg_private_decoder__decode_path_coordinates(
+                  d, p->coords[1], 2)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_line_to(
+              c, p, p->coords[1][0], p->coords[1][1]));
+          if (last) {
+            p->coords[0][0] = p->coords[1][0];
+            p->coords[0][1] = p->coords[1][1];
+          }
+          continue;
+
+        case 1:
+          if (!iconvg_private_decoder__decode_path_coordinates(
+                  d, p->coords[1], 4)) {
+            return iconvg_error_bad_coordinate;
+          }
+          ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_quad_to(
+              c, p,                              //
+              p->coords[1][0], p->coords[1][1],  //
+              p->coords[2][0], p->coords[2][1]));
+          if (last) {
+            p->coords[0][0] = p->coords[2][0];
+            p->coords[0][1] = p->coords[2][1];
+          }
+          continue;
+      }
+
+      if (!iconvg_private_decoder__decode_path_coordinates(d, p->coords[1],
+                                                           6)) {
+        return iconvg_error_bad_coordinate;
+      }
+      ICONVG_PRIVATE_TRY(iconvg_private_canvas__path_cube_to(
+          c, p,                              //
+          p->coords[1][0], p->coords[1][1],  //
+          p->coords[2][0], p->coords[2][1],  //
+          p->coords[3][0], p->coords[3][1]));
+      if (last) {
+        p->coords[0][0] = p->coords[3][0];
+        p->coords[0][1] = p->coords[3][1];
+      }
+      continue;
+    }
+
+    if (d->len == 0) {
+      self->private_impl.done = true;
+      return NULL;
+    }
+    ICONVG_PRIVATE_OBSERVE_OP(d->ptr);
+    uint8_t opcode = d->ptr[0];
+    d->ptr += 1;
+    d->len -= 1;
+
+    switch (iconvg_private_opcode_infos[opcode].handler) {
+      case ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO:
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+        if (!iconvg_private_decoder__decode_num_reps(
+                d, opcode, &self->private_impl.num_reps)) {
+          return iconvg_error_bad_number;
+        }
+        self->private_impl.rep_opcode = opcode;
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE:
+        ICONVG_PRIVATE_TRY(iconvg_private_canvas__ensure_begun_path(c, p));
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_expand_ellipse_parallelogram(c, d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_move_to(c, d, p));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_sel_add(d, p));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__NOP:
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__JUMP:
+        ICONVG_PRIVATE_TRY(iconvg_private_expand_jump(d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RET:
+        self->private_impl.done = true;
+        return NULL;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CALL:
+        ICONVG_PRIVATE_TRY(iconvg_private_expand_call(c, d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_register_op(d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__FILL:
+        ICONVG_PRIVATE_TRY(iconvg_private_execute_fill_op(c, d, p, opcode));
+        continue;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED:
+        ICONVG_PRIVATE_TRY(
+            iconvg_private_execute_reserved_op(c, d, p, opcode));
+        continue;
+    }
+  }
+  return NULL;
+}
+
+iconvg_op_iterator  //
+iconvg_op_iterator__make(iconvg_rectangle_f32 dst_rect,
+                         const uint8_t* src_ptr,
+                         size_t src_len,
+                         const iconvg_decode_options* options) {
+  iconvg_op_iterator self;
+  memset(&self, 0, sizeof(self));
+
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  d.iov = NULL;
+
+  iconvg_canvas c = iconvg_private_op_iterator__make_canvas(&self);
+  self.private_impl.err_msg = iconvg_private_decode_header(
+      &c, dst_rect, &d, (iconvg_paint*)(void*)(self.private_impl.paint),
+      options);
+  self.private_impl.src_ptr = d.ptr;
+  self.private_impl.src_len = d.len;
+  return self;
+}
+
+const char*  //
+iconvg_op_iterator__next(iconvg_op_iterator* self, iconvg_op* dst_op) {
+  if (self->private_impl.ops_ri >= self->private_impl.ops_wi) {
+    self->private_impl.ops_ri = 0;
+    self->private_impl.ops_wi = 0;
+    if (!self->private_impl.err_msg && !self->private_impl.done) {
+      iconvg_private_decoder d;
+      d.ptr = self->private_impl.src_ptr;
+      d.len = self->private_impl.src_len;
+      d.iov = NULL;
+
+      iconvg_canvas c = iconvg_private_op_iterator__make_canvas(self);
+      self->private_impl.err_msg = iconvg_private_op_iterator__step(
+          self, &c, &d, (iconvg_paint*)(void*)(self->private_impl.paint));
+      self->private_impl.src_ptr = d.ptr;
+      self->private_impl.src_len = d.len;
+    }
+
+    if (self->private_impl.ops_wi == 0) {
+      memset(dst_op, 0, sizeof(*dst_op));
+      return self->private_impl.err_msg;
+    }
+  }
+
+  *dst_op = self->private_impl.ops[self->private_impl.ops_ri++];
+  if (dst_op->type == ICONVG_OP_TYPE__END_DRAWING) {
+    dst_op->paint =
+        (const iconvg_paint*)(const void*)(self->private_impl.paint);
+  } else if (dst_op->type == ICONVG_OP_TYPE__ON_METADATA_SUGGESTED_PALETTE) {
+    dst_op->suggested_palette = &self->private_impl.suggested_palette;
+  }
+  return NULL;
+}
+
+// ----
+
+static bool  //
+iconvg_private_decoder__skip_coordinates(iconvg_private_decoder* self,
+                                         uint64_t n) {
+  for (; n > 0; n--) {
+    if (self->len == 0) {
+      return false;
+    }
+    uint8_t v = self->ptr[0];
+    size_t num_bytes = ((v & 0x01) != 0) ? 1 : ((v & 0x02) != 0) ? 2 : 4;
+    if (self->len < num_bytes) {
+      return false;
+    } else if ((num_bytes == 4) &&
+               ((iconvg_private_peek_u32le(self->ptr) & 0x7FFFFFFF) >
+                0x7F800000)) {  // Reject NaN.
+      return false;
+    }
+    self->ptr += num_bytes;
+    self->len -= num_bytes;
+  }
+  return true;
+}
+
+static bool  //
+iconvg_private_validate_absolute_segref(const uint8_t* src_ptr,
+                                        size_t src_len,
+                                        uint64_t segref) {
+  // Only Segment Type 0x00 (IconVG bytecode) can be called.
+  if ((segref & 0xFF) != 0) {
+    return false;
+  }
+
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  if ((segref >> 63) == 0) {  // Direct.
+    offset = segref >> 32;
+    length = (segref >> 8) & 0xFFFFFF;
+    if (offset == 0) {
+      return false;
+    }
+  } else {  // Indirect.
+    uint64_t o = (segref >> 8) & 0x7FFFFFFFFFFFFF;
+    if ((o > src_len) || (16 > (src_len - o))) {
+      return false;
+    }
+    length = iconvg_private_peek_u64le(src_ptr + o);
+    offset = iconvg_private_peek_u64le(src_ptr + o + 8);
+  }
+  return (offset <= src_len) && (length <= (src_len - offset));
+}
+
+static void  //
+iconvg_private_lod_thresholds__add(iconvg_private_lod_thresholds* self,
+                                   float f) {
+  if ((iconvg_private_reinterpret_from_f32_to_u32(f) & 0x7FFFFFFF) >=
+      0x7F800000) {  // Ignore infinities and NaN.
+    return;
+  }
+  for (uint32_t i = 0; i < self->num_values; i++) {
+    if (self->values[i] == f) {
+      return;
+    }
+  }
+  if (self->num_values < ICONVG_PRIVATE_LOD_THRESHOLDS__MAX) {
+    self->values[self->num_values++] = f;
+  } else {
+    self->overflowed = true;
+  }
+}
+
+size_t  //
+iconvg_private_lod_thresholds__breakpoints(
+    const iconvg_private_lod_thresholds* self,
+    int64_t* dst) {
+  size_t n = 0;
+  dst[n++] = INT64_MIN;
+  for (uint32_t i = 0; i < self->num_values; i++) {
+    double t = self->values[i];
+    int64_t b = 0;
+    if (t <= -9007199254740992.0) {
+      b = -9007199254740992;
+    } else if (t >= +9007199254740992.0) {
+      b = +9007199254740992;
+    } else {
+      b = (int64_t)t;
+      if (((double)b) < t) {
+        b++;
+      }
+    }
+    // Insertion sort, skipping duplicates.
+    size_t j = n;
+    while ((j > 0) && (dst[j - 1] > b)) {
+      j--;
+    }
+    if ((j > 0) && (dst[j - 1] == b)) {
+      continue;
+    }
+    memmove(dst + j + 1, dst + j, (n - j) * sizeof(int64_t));
+    dst[j] = b;
+    n++;
+  }
+  return n;
+}
+
+const char*  //
+iconvg_private_validate(iconvg_validate_report* r,
+                        const uint8_t* src_ptr,
+                        size_t src_len,
+                        iconvg_private_lod_thresholds* lods) {
+  iconvg_private_decoder d;
+  d.ptr = src_ptr;
+  d.len = src_len;
+  d.iov = NULL;
+
+  if (!iconvg_private_decoder__decode_magic_identifier(&d)) {
+    return iconvg_error_bad_magic_identifier;
+  }
+  r->error_offset = (size_t)(d.ptr - src_ptr);
+  uint32_t num_metadata_chunks;
+  if (!iconvg_private_decoder__decode_natural_number(&d,
+                                                     &num_metadata_chunks)) {
+    return iconvg_error_bad_metadata;
+  }
+
+  int32_t previous_metadata_id = -1;
+  for (; num_metadata_chunks > 0; num_metadata_chunks--) {
+    r->error_offset = (size_t)(d.ptr - src_ptr);
+    uint32_t chunk_length;
+    if (!iconvg_private_decoder__decode_natural_number(&d, &chunk_length) ||
+        (chunk_length > d.len)) {
+      return iconvg_error_bad_metadata;
+    }
+    iconvg_private_decoder chunk =
+        iconvg_private_decoder__limit_u32(&d, chunk_length);
+    uint32_t metadata_id;
+    if (!iconvg_private_decoder__decode_natural_number(&chunk, &metadata_id)) {
+      return iconvg_error_bad_metadata;
+    } else if (previous_metadata_id >= ((int32_t)metadata_id)) {
+      return iconvg_error_bad_metadata_id_order;
+    }
+
+    if (metadata_id == 8) {  // MID 8 (ViewBox).
+      iconvg_rectangle_f32 viewbox;
+      if (!iconvg_private_decoder__decode_metadata_viewbox(&chunk, &viewbox) ||
+          (chunk.len != 0)) {
+        return iconvg_error_bad_metadata_viewbox;
+      }
+    } else if (metadata_id == 16) {  // MID 16 (Suggested Palette).
+      iconvg_palette palette;
+      if (!iconvg_private_decoder__decode_metadata_suggested_palette(
+              &chunk, &palette) ||
+          (chunk.len != 0)) {
+        return iconvg_error_bad_metadata_suggested_palette;
+      }
+    } else {
+      return iconvg_error_bad_metadata;
+    }
+
+    iconvg_private_decoder__advance_to_ptr(&d, chunk.ptr);
+    previous_metadata_id = ((int32_t)metadata_id);
+    r->num_metadata_chunks++;
+  }
+
+  // jump_end is one past the index of the last op that any jump op skips.
+  uint64_t jump_end = 0;
+
+  while (d.len > 0) {
+    r->error_offset = (size_t)(d.ptr - src_ptr);
+    uint8_t opcode = d.ptr[0];
+    d.ptr += 1;
+    d.len -= 1;
+
+    const iconvg_private_opcode_info* info =
+        &iconvg_private_opcode_infos[opcode];
+    uint32_t num_bytes = 0;
+    switch (info->handler) {
+      case ICONVG_PRIVATE_OPCODE_HANDLER__LINE_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__QUAD_TO:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CUBE_TO: {
+        uint32_t num_reps = 0;
+        if (!iconvg_private_decoder__decode_num_reps(&d, opcode, &num_reps)) {
+          return iconvg_error_bad_number;
+        } else if (!iconvg_private_decoder__skip_coordinates(
+                       &d, ((uint64_t)num_reps) * info->num_naturals)) {
+          return iconvg_error_bad_coordinate;
+        }
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__ELLIPSE:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__MOVE_TO:
+        if (!iconvg_private_decoder__skip_coordinates(&d,
+                                                      info->num_naturals)) {
+          return iconvg_error_bad_coordinate;
+        }
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__SEL_ADD:
+        num_bytes = info->num_bytes;
+        if (d.len < num_bytes) {
+          return iconvg_error_bad_number;
+        }
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__NOP:
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RET:
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__JUMP: {
+        uint32_t jump_distance = 0;
+        uint32_t feature_bits = 0;
+        if (!iconvg_private_decoder__decode_natural_number(&d,
+                                                           &jump_distance) ||
+            ((opcode == 0x39) &&
+             !iconvg_private_decoder__decode_natural_number(&d,
+                                                            &feature_bits))) {
+          return iconvg_error_bad_number;
+        } else if (opcode == 0x3A) {
+          iconvg_private_decoder lod_d = d;
+          if (!iconvg_private_decoder__skip_coordinates(&d, 2)) {
+            return iconvg_error_bad_number;
+          } else if (lods) {
+            float lod[2] = {0};
+            iconvg_private_decoder__decode_coordinates(&lod_d, lod, 2);
+            iconvg_private_lod_thresholds__add(lods, lod[0]);
+            iconvg_private_lod_thresholds__add(lods, lod[1]);
+          }
+        }
+        uint64_t end = r->num_ops + 1 + ((uint64_t)jump_distance);
+        jump_end = (jump_end > end) ? jump_end : end;
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__CALL: {
+        if (opcode & 1) {  // The ATM: an alpha byte and six coordinates.
+          if (d.len < 1) {
+            return iconvg_error_bad_opcode_length;
+          }
+          d.ptr += 1;
+          d.len -= 1;
+          if (!iconvg_private_decoder__skip_coordinates(&d, 6)) {
+            return iconvg_error_bad_coordinate;
+          }
+        }
+        if (d.len < 8) {
+          return iconvg_error_bad_opcode_length;
+        }
+        uint64_t segref = iconvg_private_peek_u64le(d.ptr);
+        if ((segref >> 32) == 0) {  // Inline.
+          if ((segref & 0xFF) != 0) {
+            return iconvg_error_bad_segref;
+          }
+          num_bytes = 8 + ((uint32_t)(segref >> 8));
+        } else if (!iconvg_private_validate_absolute_segref(src_ptr, src_len,
+                                                            segref)) {
+          return iconvg_error_bad_segref;
+        } else {
+          num_bytes = 8;
+        }
+        if (d.len < num_bytes) {
+          return iconvg_error_bad_opcode_length;
+        }
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__REGISTER:
+        num_bytes = info->num_bytes;
+        if (d.len < num_bytes) {
+          return iconvg_error_bad_number;
+        }
+        break;
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__FILL: {
+        uint32_t num_transforms = 3 * ((opcode >> 4) & 3);
+        if (info->flags & ICONVG_PRIVATE_OPCODE_FLAG__VARIABLE_LENGTH) {
+          if (!iconvg_private_decoder__decode_natural_number(&d, &num_bytes)) {
+            return iconvg_error_bad_number;
+          } else if (d.len < num_bytes) {
+            return iconvg_error_bad_opcode_length;
+          }
+        } else if (num_transforms > 0) {
+          // The (num_stops > 64) check means that the stops' register window
+          // fits in the 64 registers without wrapping around onto itself.
+          if ((d.len == 0) || (((d.ptr[0] & 63) + 2) > 64)) {
+            return iconvg_error_bad_opcode_length;
+          }
+          d.ptr += 1;
+          d.len -= 1;
+          for (uint32_t i = 0; i < num_transforms; i++) {
+            if ((d.len < 4) ||
+                ((iconvg_private_peek_u32le(d.ptr) & 0x7FFFFFFF) >
+                 0x7F800000)) {  // Reject NaN.
+              return iconvg_error_bad_number;
+            }
+            d.ptr += 4;
+            d.len -= 4;
+          }
+        }
+        break;
+      }
+
+      case ICONVG_PRIVATE_OPCODE_HANDLER__RESERVED: {
+        if (!iconvg_private_decoder__decode_natural_number(&d, &num_bytes)) {
+          return iconvg_error_bad_number;
+        } else if (d.len < num_bytes) {
+          return iconvg_error_bad_opcode_length;
+        }
+        d.ptr += num_bytes;
+        d.len -= num_bytes;
+        num_bytes = 0;
+        if (!iconvg_private_decoder__skip_coordinates(&d,
+                                                      info->num_naturals)) {
+          return iconvg_error_bad_coordinate;
+        }
+        break;
+      }
+    }
+
+    d.ptr += num_bytes;
+    d.len -= num_bytes;
+    r->num_ops++;
+  }
+
+  if (jump_end > r->num_ops) {
+    r->error_offset = src_len;
+    return iconvg_error_bad_jump;
+  }
+  r->error_offset = src_len;
+  return NULL;
+}
+
+const char*  //
+iconvg_validate(const uint8_t* src_ptr,
+                size_t src_len,
+                iconvg_validate_report* report) {
+  iconvg_validate_report r = {0};
+  const char* err_msg = iconvg_private_validate(&r, src_ptr, src_len, NULL);
+  if (report) {
+    *report = r;
+  }
+  return err_msg;
+}
@@ -0,0 +1,1021 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#include <stdlib.h>
+
+// The display list cache format is documented alongside
+// iconvg_display_list_cache in the public header.
+//
+// In a verb stream, each verb byte is followed by its arguments:
+//   - BEGIN_DRAWING and END_PATH have no arguments.
+//   - BEGIN_PATH and LINE_TO have 2 f32 values, QUAD_TO has 4 and CUBE_TO
+//     has 6.
+//   - END_DRAWING has the paint type byte. A flat color is then followed by
+//     its 4-byte premultiplied color. A gradient is followed by its spread
+//     and number of stops bytes, the src space gradient transform (6 f32
+//     values) and then the stops' registers (each a u64).
+
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_DRAWING 0x01
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_DRAWING 0x02
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH 0x03
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_PATH 0x04
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO 0x05
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO 0x06
+#define ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO 0x07
+
+#define ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE 32
+#define ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE 40
+#define ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE 16
+#define ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE 16
+#define ICONVG_PRIVATE_DISPLAY_LIST__BODY_ALIGNMENT 8
+
+// ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE is the size of a body's
+// ViewBox, number of variants and flags.
+#define ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE (16 + 4 + 4)
+
+// ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE means that the body's prefix
+// is followed by a (non-default) suggested palette.
+#define ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE 0x01
+
+static const uint32_t iconvg_private_display_list__blake2s_iv[8] = {
+    0x6A09E667u, 0xBB67AE85u, 0x3C6EF372u, 0xA54FF53Au,
+    0x510E527Fu, 0x9B05688Cu, 0x1F83D9ABu, 0x5BE0CD19u,
+};
+
+static const uint8_t iconvg_private_display_list__blake2s_sigma[10][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0},
+};
+
+static inline uint32_t  //
+iconvg_private_display_list__rotr32(uint32_t x, uint32_t n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+// iconvg_private_display_list__blake2s_compress is BLAKE2s' compression
+// function (RFC 7693 section 3.2), with t being the number of bytes so far.
+static void  //
+iconvg_private_display_list__blake2s_compress(uint32_t h[8],
+                                              const uint8_t block[64],
+                                              uint64_t t,
+                                              bool last) {
+  uint32_t m[16];
+  uint32_t v[16];
+  for (int i = 0; i < 16; i++) {
+    m[i] = iconvg_private_peek_u32le(block + (4 * i));
+  }
+  for (int i = 0; i < 8; i++) {
+    v[i] = h[i];
+    v[i + 8] = iconvg_private_display_list__blake2s_iv[i];
+  }
+  v[12] ^= (uint32_t)(t);
+  v[13] ^= (uint32_t)(t >> 32);
+  if (last) {
+    v[14] = ~v[14];
+  }
+
+  // The rounds are unrolled so that the compiler can resolve each sigma
+  // lookup at compile time.
+#define ICONVG_PRIVATE_DISPLAY_LIST__G(r, i, a, b, c, d)       \
+  v[a] = v[a] + v[b] + m[sigma[r][2 * i]];                     \
+  v[d] = iconvg_private_display_list__rotr32(v[d] ^ v[a], 16); \
+  v[c] = v[c] + v[d];                                          \
+  v[b] = iconvg_private_display_list__rotr32(v[b] ^ v[c], 12); \
+  v[a] = v[a] + v[b] + m[sigma[r][(2 * i) + 1]];               \
+  v[d] = iconvg_private_display_list__rotr32(v[d] ^ v[a], 8);  \
+  v[c] = v[c] + v[d];                                          \
+  v[b] = iconvg_private_display_list__rotr32(v[b] ^ v[c], 7)
+
+#define ICONVG_PRIVATE_DISPLAY_LIST__ROUND(r)         \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 0, 0, 4, 8, 12);  \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 1, 1, 5, 9, 13);  \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 2, 2, 6, 10, 14); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 3, 3, 7, 11, 15); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 4, 0, 5, 10, 15); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 5, 1, 6, 11, 12); \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 6, 2, 7, 8, 13);  \
+  ICONVG_PRIVATE_DISPLAY_LIST__G(r, 7, 3, 4, 9, 14)
+
+  const uint8_t(*sigma)[16] = iconvg_private_display_list__blake2s_sigma;
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(0);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(1);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(2);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(3);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(4);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(5);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(6);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(7);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(8);
+  ICONVG_PRIVATE_DISPLAY_LIST__ROUND(9);
+
+#undef ICONVG_PRIVATE_DISPLAY_LIST__ROUND
+#undef ICONVG_PRIVATE_DISPLAY_LIST__G
+
+  for (int i = 0; i < 8; i++) {
+    h[i] ^= v[i] ^ v[i + 8];
+  }
+}
+
+// iconvg_private_display_list__digest sets dst to the unkeyed 128-bit
+// BLAKE2s digest of p[.. n]. The cache is keyed by this digest, not by a
+// fast non-cryptographic hash, so that a crafted IconVG file can't collide
+// with (and so replay as) another one.
+static void  //
+iconvg_private_display_list__digest(
+    uint8_t dst[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE],
+    const uint8_t* p,
+    size_t n) {
+  uint32_t h[8];
+  memcpy(h, iconvg_private_display_list__blake2s_iv, sizeof(h));
+  h[0] ^= 0x01010000u ^ ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE;
+  uint64_t t = 0;
+  for (; n > 64; n -= 64, p += 64) {
+    t += 64;
+    iconvg_private_display_list__blake2s_compress(h, p, t, false);
+  }
+  uint8_t tail[64] = {0};
+  if (n > 0) {
+    memcpy(tail, p, n);
+  }
+  iconvg_private_display_list__blake2s_compress(h, tail, t + n, true);
+  for (int i = 0; i < (ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE / 4); i++) {
+    iconvg_private_poke_u32le(dst + (4 * i), h[i]);
+  }
+}
+
+static uint64_t  //
+iconvg_private_display_list__palette_key(
+    const iconvg_decode_options* options) {
+  if (!options || !options->palette) {
+    return 0;
+  }
+  uint8_t digest[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE];
+  iconvg_private_display_list__digest(
+      digest, &options->palette->colors[0].rgba[0], sizeof(iconvg_palette));
+  return 1 | iconvg_private_peek_u64le(digest);
+}
+
+static inline float  //
+iconvg_private_display_list__peek_f32(const uint8_t* p, int i) {
+  return iconvg_private_reinterpret_from_u32_to_f32(
+      iconvg_private_peek_u32le(p + (4 * i)));
+}
+
+// ----
+
+// iconvg_private_display_list_buffer is a growable byte buffer, backed by
+// allocator (which may be NULL). Once an allocation fails, oom is set and
+// further appends are no-ops.
+typedef struct iconvg_private_display_list_buffer_struct {
+  uint8_t* ptr;
+  size_t len;
+  size_t cap;
+  bool oom;
+  iconvg_allocator* allocator;
+} iconvg_private_display_list_buffer;
+
+static bool  //
+iconvg_private_display_list_buffer__append(
+    iconvg_private_display_list_buffer* b,
+    const uint8_t* p,
+    size_t n) {
+  if (b->oom) {
+    return false;
+  } else if (n > (b->cap - b->len)) {
+    size_t new_cap = b->cap ? b->cap : 4096;
+    while (n > (new_cap - b->len)) {
+      if (new_cap > (SIZE_MAX / 2)) {
+        b->oom = true;
+        return false;
+      }
+      new_cap *= 2;
+    }
+    uint8_t* new_ptr = iconvg_private_allocator__realloc(b->allocator, b->ptr,
+                                                         b->cap, new_cap);
+    if (!new_ptr) {
+      b->oom = true;
+      return false;
+    }
+    b->ptr = new_ptr;
+    b->cap = new_cap;
+  }
+  if (n > 0) {
+    memcpy(b->ptr + b->len, p, n);
+    b->len += n;
+  }
+  return true;
+}
+
+static bool  //
+iconvg_private_display_list_buffer__append_u8(
+    iconvg_private_display_list_buffer* b,
+    uint8_t x) {
+  return iconvg_private_display_list_buffer__append(b, &x, 1);
+}
+
+static bool  //
+iconvg_private_display_list_buffer__append_f32s(
+    iconvg_private_display_list_buffer* b,
+    const float* f,
+    int n) {
+  uint8_t x[4 * 6];
+  for (int i = 0; i < n; i++) {
+    iconvg_private_poke_u32le(x + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f[i]));
+  }
+  return iconvg_private_display_list_buffer__append(b, x, 4 * (size_t)n);
+}
+
+// ----
+
+// The recording canvas appends a verb stream to its buffer, given decoding
+// with the dst_rect set to the ViewBox, so that dst coordinates are src
+// coordinates.
+
+typedef struct iconvg_private_display_list_recorder_struct {
+  iconvg_private_display_list_buffer* stream;
+  iconvg_rectangle_f32 viewbox;
+  iconvg_palette suggested_palette;
+} iconvg_private_display_list_recorder;
+
+static inline const char*  //
+iconvg_private_display_list_recorder__verb(iconvg_canvas* c,
+                                           uint8_t verb,
+                                           const float* f,
+                                           int n) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  if (!iconvg_private_display_list_buffer__append_u8(r->stream, verb) ||
+      !iconvg_private_display_list_buffer__append_f32s(r->stream, f, n)) {
+    return iconvg_error_system_failure_out_of_memory;
+  }
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__begin_decode(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 dst_rect) {
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__end_decode(iconvg_canvas* c,
+                                                 const char* err_msg,
+                                                 size_t num_bytes_consumed,
+                                                 size_t num_bytes_remaining) {
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__begin_drawing(iconvg_canvas* c) {
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_DRAWING, NULL, 0);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__end_drawing(iconvg_canvas* c,
+                                                  const iconvg_paint* p) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  iconvg_private_display_list_buffer* b = r->stream;
+  iconvg_paint_type paint_type = iconvg_paint__type(p);
+  iconvg_private_display_list_buffer__append_u8(
+      b, ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_DRAWING);
+  iconvg_private_display_list_buffer__append_u8(b, (uint8_t)paint_type);
+  switch (paint_type) {
+    case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+      iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+      iconvg_private_display_list_buffer__append(b, &k.rgba[0], 4);
+      break;
+    }
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
+      iconvg_private_display_list_buffer__append_u8(b, p->spread);
+      iconvg_private_display_list_buffer__append_u8(b, p->num_stops);
+      iconvg_private_display_list_buffer__append_f32s(b, p->transform, 6);
+      for (uint32_t i = 0; i < p->num_stops; i++) {
+        uint8_t x[8];
+        iconvg_private_poke_u64le(x, p->regs[(p->which_regs + i) & 63]);
+        iconvg_private_display_list_buffer__append(b, x, 8);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return b->oom ? iconvg_error_system_failure_out_of_memory : NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__begin_path(iconvg_canvas* c,
+                                                 float x0,
+                                                 float y0) {
+  float f[2] = {x0, y0};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH, f, 2);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__end_path(iconvg_canvas* c) {
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_PATH, NULL, 0);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__path_line_to(iconvg_canvas* c,
+                                                   float x1,
+                                                   float y1) {
+  float f[2] = {x1, y1};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO, f, 2);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__path_quad_to(iconvg_canvas* c,
+                                                   float x1,
+                                                   float y1,
+                                                   float x2,
+                                                   float y2) {
+  float f[4] = {x1, y1, x2, y2};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO, f, 4);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__path_cube_to(iconvg_canvas* c,
+                                                   float x1,
+                                                   float y1,
+                                                   float x2,
+                                                   float y2,
+                                                   float x3,
+                                                   float y3) {
+  float f[6] = {x1, y1, x2, y2, x3, y3};
+  return iconvg_private_display_list_recorder__verb(
+      c, ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO, f, 6);
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  r->viewbox = viewbox;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_display_list_recorder__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_private_display_list_recorder* r =
+      (iconvg_private_display_list_recorder*)(c->context.nonconst_ptr1);
+  memcpy(&r->suggested_palette, suggested_palette, sizeof(iconvg_palette));
+  return NULL;
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_display_list_recorder_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_display_list_recorder__begin_decode,
+        &iconvg_private_display_list_recorder__end_decode,
+        &iconvg_private_display_list_recorder__begin_drawing,
+        &iconvg_private_display_list_recorder__end_drawing,
+        &iconvg_private_display_list_recorder__begin_path,
+        &iconvg_private_display_list_recorder__end_path,
+        &iconvg_private_display_list_recorder__path_line_to,
+        &iconvg_private_display_list_recorder__path_quad_to,
+        &iconvg_private_display_list_recorder__path_cube_to,
+        &iconvg_private_display_list_recorder__on_metadata_viewbox,
+        &iconvg_private_display_list_recorder__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+// ----
+
+typedef struct iconvg_private_display_list_entry_struct {
+  uint8_t src_digest[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE];
+  uint64_t src_len;
+  uint64_t body_offset;
+  uint64_t body_len;
+  size_t src_index;
+} iconvg_private_display_list_entry;
+
+static int  //
+iconvg_private_display_list_entry__compare(const void* a, const void* b) {
+  const iconvg_private_display_list_entry* x =
+      (const iconvg_private_display_list_entry*)a;
+  const iconvg_private_display_list_entry* y =
+      (const iconvg_private_display_list_entry*)b;
+  int c = memcmp(x->src_digest, y->src_digest,
+                 ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+  if (c != 0) {
+    return c;
+  } else if (x->src_len != y->src_len) {
+    return (x->src_len < y->src_len) ? -1 : +1;
+  } else if (x->src_index != y->src_index) {
+    return (x->src_index < y->src_index) ? -1 : +1;
+  }
+  return 0;
+}
+
+// iconvg_private_display_list__record appends src_ptr[.. src_len]'s body to
+// bodies. It returns false if the source was left out (or on out of memory,
+// which also sets bodies->oom).
+static bool  //
+iconvg_private_display_list__record(iconvg_private_display_list_buffer* bodies,
+                                    iconvg_private_display_list_buffer* streams,
+                                    const uint8_t* src_ptr,
+                                    size_t src_len,
+                                    const iconvg_decode_options* options) {
+  iconvg_validate_report report = {0};
+  iconvg_private_lod_thresholds lods;
+  lods.num_values = 0;
+  lods.overflowed = false;
+  if (iconvg_private_validate(&report, src_ptr, src_len, &lods) ||
+      lods.overflowed) {
+    return false;
+  }
+  iconvg_rectangle_f32 viewbox;
+  if (iconvg_decode_viewbox(&viewbox, src_ptr, src_len)) {
+    return false;
+  }
+
+  int64_t breakpoints[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t num_breakpoints =
+      iconvg_private_lod_thresholds__breakpoints(&lods, breakpoints);
+
+  iconvg_private_display_list_recorder r;
+  memset(&r, 0, sizeof(r));
+  r.stream = streams;
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_display_list_recorder_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = &r;
+
+  iconvg_decode_options opts = {0};
+  opts.sizeof__iconvg_decode_options = sizeof(iconvg_decode_options);
+  opts.palette = options ? options->palette : NULL;
+
+  // Decode once per variant, dropping variants that are identical to their
+  // predecessor.
+  int64_t min_heights[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS];
+  size_t offsets[ICONVG_PRIVATE_LOD_THRESHOLDS__MAX_BREAKPOINTS + 1];
+  size_t num_variants = 0;
+  streams->len = 0;
+  offsets[0] = 0;
+  for (size_t i = 0; i < num_breakpoints; i++) {
+    opts.height_in_pixels = iconvg_optional_i64__make_some(breakpoints[i]);
+    if (iconvg_decode(&c, viewbox, src_ptr, src_len, &opts)) {
+      if (streams->oom) {
+        bodies->oom = true;
+      }
+      return false;
+    }
+    size_t prev = offsets[num_variants];
+    size_t n = streams->len - prev;
+    if ((num_variants > 0) &&
+        (n == (prev - offsets[num_variants - 1])) &&
+        !memcmp(streams->ptr + offsets[num_variants - 1], streams->ptr + prev,
+                n)) {
+      streams->len = prev;
+      continue;
+    }
+    min_heights[num_variants++] = breakpoints[i];
+    offsets[num_variants] = streams->len;
+  }
+
+  bool has_palette = memcmp(&r.suggested_palette,
+                            &iconvg_private_default_palette,
+                            sizeof(iconvg_palette)) != 0;
+  size_t table_size =
+      ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE +
+      (has_palette ? sizeof(iconvg_palette) : 0) +
+      (num_variants * ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE);
+  if (streams->len > (0xFFFFFFFFu - table_size)) {
+    return false;
+  }
+
+  uint8_t prefix[ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE];
+  float f[4] = {viewbox.min_x, viewbox.min_y, viewbox.max_x, viewbox.max_y};
+  for (int i = 0; i < 4; i++) {
+    iconvg_private_poke_u32le(prefix + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f[i]));
+  }
+  iconvg_private_poke_u32le(prefix + 16, (uint32_t)num_variants);
+  iconvg_private_poke_u32le(
+      prefix + 20,
+      has_palette ? ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE : 0);
+  iconvg_private_display_list_buffer__append(bodies, prefix, sizeof(prefix));
+  if (has_palette) {
+    iconvg_private_display_list_buffer__append(
+        bodies, &r.suggested_palette.colors[0].rgba[0], sizeof(iconvg_palette));
+  }
+  for (size_t i = 0; i < num_variants; i++) {
+    uint8_t v[ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE];
+    iconvg_private_poke_u64le(v + 0, (uint64_t)(min_heights[i]));
+    iconvg_private_poke_u32le(v + 8, (uint32_t)(table_size + offsets[i]));
+    iconvg_private_poke_u32le(v + 12, (uint32_t)(offsets[i + 1] - offsets[i]));
+    iconvg_private_display_list_buffer__append(bodies, v, sizeof(v));
+  }
+  iconvg_private_display_list_buffer__append(bodies, streams->ptr,
+                                             streams->len);
+  return !bodies->oom;
+}
+
+const char*  //
+iconvg_write_display_list_cache(FILE* f,
+                                const uint8_t* const* src_ptrs,
+                                const size_t* src_lens,
+                                size_t num_srcs,
+                                const iconvg_decode_options* options) {
+  if (!f || ((!src_ptrs || !src_lens) && (num_srcs > 0))) {
+    return iconvg_error_invalid_constructor_argument;
+  } else if (num_srcs > 0xFFFFFFFFu) {
+    num_srcs = 0xFFFFFFFFu;
+  }
+
+  iconvg_allocator* allocator =
+      iconvg_private_allocator__from_options(options);
+  const size_t entries_size =
+      num_srcs * sizeof(iconvg_private_display_list_entry);
+  iconvg_private_display_list_entry* entries = NULL;
+  if (num_srcs > 0) {
+    entries = iconvg_private_allocator__alloc(allocator, entries_size);
+    if (!entries) {
+      return iconvg_error_system_failure_out_of_memory;
+    }
+  }
+  for (size_t i = 0; i < num_srcs; i++) {
+    iconvg_private_display_list__digest(entries[i].src_digest, src_ptrs[i],
+                                        src_lens[i]);
+    entries[i].src_len = src_lens[i];
+    entries[i].body_offset = 0;
+    entries[i].body_len = 0;
+    entries[i].src_index = i;
+  }
+  if (num_srcs > 1) {
+    qsort(entries, num_srcs, sizeof(iconvg_private_display_list_entry),
+          &iconvg_private_display_list_entry__compare);
+  }
+
+  // Record the bodies in index order, compacting the entries to drop
+  // duplicates and sources that couldn't be recorded. Sources with equal keys
+  // are compared byte for byte: identical ones share one entry but, should
+  // different ones ever collide, they are all left out (and so fall back to
+  // iconvg_decode) rather than replaying one as the other.
+  iconvg_private_display_list_buffer bodies = {0};
+  iconvg_private_display_list_buffer streams = {0};
+  bodies.allocator = allocator;
+  streams.allocator = allocator;
+  size_t num_entries = 0;
+  for (size_t i = 0, j = 0; i < num_srcs; i = j) {
+    iconvg_private_display_list_entry e = entries[i];
+    const uint8_t* e_ptr = src_ptrs[e.src_index];
+    bool collides = false;
+    for (j = i + 1; j < num_srcs; j++) {
+      const iconvg_private_display_list_entry* f = &entries[j];
+      if ((f->src_len != e.src_len) ||
+          memcmp(f->src_digest, e.src_digest,
+                 ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE)) {
+        break;
+      } else if ((e.src_len > 0) &&
+                 memcmp(src_ptrs[f->src_index], e_ptr, e.src_len)) {
+        collides = true;
+      }
+    }
+    if (collides) {
+      continue;
+    }
+    while (bodies.len % ICONVG_PRIVATE_DISPLAY_LIST__BODY_ALIGNMENT) {
+      iconvg_private_display_list_buffer__append_u8(&bodies, 0);
+    }
+    size_t body_start = bodies.len;
+    if (!iconvg_private_display_list__record(&bodies, &streams,
+                                             src_ptrs[e.src_index],
+                                             src_lens[e.src_index], options)) {
+      if (bodies.oom) {
+        break;
+      }
+      bodies.len = body_start;
+      continue;
+    }
+    e.body_offset = body_start;
+    e.body_len = bodies.len - body_start;
+    entries[num_entries++] = e;
+  }
+  iconvg_private_allocator__free(allocator, streams.ptr, streams.cap);
+  if (bodies.oom) {
+    iconvg_private_allocator__free(allocator, bodies.ptr, bodies.cap);
+    iconvg_private_allocator__free(allocator, entries, entries_size);
+    return iconvg_error_system_failure_out_of_memory;
+  }
+
+  uint64_t bodies_start =
+      ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE +
+      (((uint64_t)num_entries) * ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE);
+  uint8_t header[ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE];
+  memcpy(header, "\x8AIVGdlst", 8);
+  iconvg_private_poke_u32le(header + 8, 2);
+  iconvg_private_poke_u32le(header + 12, (uint32_t)num_entries);
+  iconvg_private_poke_u64le(header + 16,
+                            iconvg_private_display_list__palette_key(options));
+  iconvg_private_poke_u64le(header + 24, bodies_start + bodies.len);
+  fwrite(header, 1, sizeof(header), f);
+  for (size_t i = 0; i < num_entries; i++) {
+    uint8_t x[ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE];
+    memcpy(x + 0, entries[i].src_digest,
+           ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+    iconvg_private_poke_u64le(x + 16, entries[i].src_len);
+    iconvg_private_poke_u64le(x + 24, bodies_start + entries[i].body_offset);
+    iconvg_private_poke_u64le(x + 32, entries[i].body_len);
+    fwrite(x, 1, sizeof(x), f);
+  }
+  if (bodies.len > 0) {
+    fwrite(bodies.ptr, 1, bodies.len, f);
+  }
+
+  iconvg_private_allocator__free(allocator, bodies.ptr, bodies.cap);
+  iconvg_private_allocator__free(allocator, entries, entries_size);
+  return NULL;
+}
+
+// ----
+
+const char*  //
+iconvg_display_list_cache__open_bytes(iconvg_display_list_cache* self,
+                                      const uint8_t* ptr,
+                                      size_t len) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!ptr || (len < ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE) ||
+      memcmp(ptr, "\x8AIVGdlst", 8) ||
+      (iconvg_private_peek_u32le(ptr + 8) != 2) ||
+      (iconvg_private_peek_u64le(ptr + 24) != len)) {
+    return iconvg_error_bad_display_list_cache;
+  }
+
+  // Check the index up front, so that the other methods don't have to. The
+  // bodies are checked as they are replayed.
+  uint32_t num_entries = iconvg_private_peek_u32le(ptr + 12);
+  uint64_t bodies_start =
+      ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE +
+      (((uint64_t)num_entries) * ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE);
+  if (bodies_start > len) {
+    return iconvg_error_bad_display_list_cache;
+  }
+  const uint8_t* e = ptr + ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE;
+  for (uint32_t i = 0; i < num_entries;
+       i++, e += ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE) {
+    uint64_t body_offset = iconvg_private_peek_u64le(e + 24);
+    uint64_t body_length = iconvg_private_peek_u64le(e + 32);
+    if ((body_offset % ICONVG_PRIVATE_DISPLAY_LIST__BODY_ALIGNMENT) ||
+        (body_offset < bodies_start) || (body_offset > len) ||
+        (body_length > (len - body_offset))) {
+      return iconvg_error_bad_display_list_cache;
+    } else if (i > 0) {
+      const uint8_t* p = e - ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE;
+      int c = memcmp(p, e, ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+      if ((c > 0) || ((c == 0) && (iconvg_private_peek_u64le(p + 16) >=
+                                   iconvg_private_peek_u64le(e + 16)))) {
+        return iconvg_error_bad_display_list_cache;
+      }
+    }
+  }
+
+  self->ptr = ptr;
+  self->len = len;
+  self->num_entries = num_entries;
+  return NULL;
+}
+
+const char*  //
+iconvg_display_list_cache__open_mmap(iconvg_display_list_cache* self,
+                                     const char* path,
+                                     iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!path) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  iconvg_file file;
+  const char* err_msg = iconvg_file__open(&file, path, allocator);
+  if (err_msg) {
+    return err_msg;
+  }
+  err_msg = iconvg_display_list_cache__open_bytes(self, file.ptr, file.len);
+  if (err_msg) {
+    iconvg_file__close(&file);
+    return err_msg;
+  }
+  self->file = file;
+  return NULL;
+}
+
+void  //
+iconvg_display_list_cache__close(iconvg_display_list_cache* self) {
+  if (!self) {
+    return;
+  }
+  iconvg_file__close(&self->file);
+  memset(self, 0, sizeof(*self));
+}
+
+// iconvg_private_display_list_cache__find sets *body_ptr and *body_len to the
+// body for src_ptr[.. src_len], using a binary search of the index. It returns
+// false if there is no such body.
+static bool  //
+iconvg_private_display_list_cache__find(const iconvg_display_list_cache* self,
+                                        const uint8_t* src_ptr,
+                                        size_t src_len,
+                                        const iconvg_decode_options* options,
+                                        const uint8_t** body_ptr,
+                                        size_t* body_len) {
+  if (!self || !self->ptr || !src_ptr ||
+      (iconvg_private_peek_u64le(self->ptr + 16) !=
+       iconvg_private_display_list__palette_key(options))) {
+    return false;
+  }
+  uint8_t digest[ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE];
+  iconvg_private_display_list__digest(digest, src_ptr, src_len);
+  uint32_t lo = 0;
+  uint32_t hi = self->num_entries;
+  const uint8_t* index = self->ptr + ICONVG_PRIVATE_DISPLAY_LIST__HEADER_SIZE;
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) / 2);
+    const uint8_t* e =
+        index + (((size_t)mid) * ICONVG_PRIVATE_DISPLAY_LIST__ENTRY_SIZE);
+    int c = memcmp(digest, e, ICONVG_PRIVATE_DISPLAY_LIST__DIGEST_SIZE);
+    uint64_t el = iconvg_private_peek_u64le(e + 16);
+    if ((c == 0) && (src_len == el)) {
+      *body_ptr = self->ptr + iconvg_private_peek_u64le(e + 24);
+      *body_len = (size_t)(iconvg_private_peek_u64le(e + 32));
+      return true;
+    } else if ((c < 0) || ((c == 0) && (src_len < el))) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return false;
+}
+
+bool  //
+iconvg_display_list_cache__contains(const iconvg_display_list_cache* self,
+                                    const uint8_t* src_ptr,
+                                    size_t src_len,
+                                    const iconvg_decode_options* options) {
+  const uint8_t* body_ptr = NULL;
+  size_t body_len = 0;
+  return iconvg_private_display_list_cache__find(
+      self, src_ptr, src_len, options, &body_ptr, &body_len);
+}
+
+// iconvg_private_display_list__replay_paint reads an end_drawing verb's
+// arguments (after the verb byte) from s[.. n] into *p, keeping p's scale and
+// bias fields. It returns the number of bytes read, or zero if malformed.
+static size_t  //
+iconvg_private_display_list__replay_paint(iconvg_paint* p,
+                                          const uint8_t* s,
+                                          size_t n) {
+  if (n < 1) {
+    return 0;
+  }
+  p->paint_type = s[0];
+  p->spread = 0;
+  p->num_stops = 0;
+  p->which_regs = 0;
+  switch (p->paint_type) {
+    case ICONVG_PAINT_TYPE__INVALID:
+      return 1;
+    case ICONVG_PAINT_TYPE__FLAT_COLOR:
+      if (n < 5) {
+        return 0;
+      }
+      // A valid premultiplied color resolves to itself.
+      p->regs[0] = ((uint64_t)(iconvg_private_peek_u32le(s + 1))) << 32;
+      return 5;
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      break;
+    default:
+      return 0;
+  }
+
+  if (n < 27) {
+    return 0;
+  }
+  p->spread = s[1];
+  p->num_stops = s[2];
+  size_t m = 27 + (8 * (size_t)(p->num_stops));
+  if ((p->num_stops > 64) || (n < m)) {
+    return 0;
+  }
+  for (int i = 0; i < 6; i++) {
+    p->transform[i] = iconvg_private_display_list__peek_f32(s + 3, i);
+  }
+  for (uint32_t i = 0; i < p->num_stops; i++) {
+    p->regs[i] = iconvg_private_peek_u64le(s + 27 + (8 * i));
+  }
+  return m;
+}
+
+static const char*  //
+iconvg_private_display_list__replay(iconvg_canvas* c,
+                                    iconvg_rectangle_f32 dst_rect,
+                                    const uint8_t* body,
+                                    size_t body_len,
+                                    const iconvg_decode_options* options) {
+  if (body_len < ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE) {
+    return iconvg_error_bad_display_list_cache;
+  }
+  uint32_t num_variants = iconvg_private_peek_u32le(body + 16);
+  uint32_t flags = iconvg_private_peek_u32le(body + 20);
+  const uint8_t* v = body + ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE;
+  size_t n = body_len - ICONVG_PRIVATE_DISPLAY_LIST__BODY_PREFIX_SIZE;
+
+  // The iconvg_palette type is a byte array, so that it can alias the body.
+  const iconvg_palette* suggested_palette = &iconvg_private_default_palette;
+  if (flags & ICONVG_PRIVATE_DISPLAY_LIST__FLAG_HAS_PALETTE) {
+    if (n < sizeof(iconvg_palette)) {
+      return iconvg_error_bad_display_list_cache;
+    }
+    suggested_palette = (const iconvg_palette*)v;
+    v += sizeof(iconvg_palette);
+    n -= sizeof(iconvg_palette);
+  }
+  if ((num_variants == 0) ||
+      (num_variants > (n / ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE))) {
+    return iconvg_error_bad_display_list_cache;
+  }
+
+  iconvg_paint p;
+  memset(&p, 0, sizeof(p));
+  p.viewbox = iconvg_rectangle_f32__make(
+      iconvg_private_display_list__peek_f32(body, 0),
+      iconvg_private_display_list__peek_f32(body, 1),
+      iconvg_private_display_list__peek_f32(body, 2),
+      iconvg_private_display_list__peek_f32(body, 3));
+  p.height_in_pixels = iconvg_private_height_in_pixels(dst_rect, options);
+
+  ICONVG_PRIVATE_TRY((*c->vtable->on_metadata_viewbox)(c, p.viewbox));
+  ICONVG_PRIVATE_TRY(
+      (*c->vtable->on_metadata_suggested_palette)(c, suggested_palette));
+  iconvg_private_initialize_remaining_paint_fields(
+      &p, dst_rect, iconvg_private_dst_transform(options));
+
+  // Pick the last variant whose minimum height is at most the height.
+  for (uint32_t i = 1; i < num_variants; i++) {
+    const uint8_t* w = v + ICONVG_PRIVATE_DISPLAY_LIST__VARIANT_SIZE;
+    if (((int64_t)(iconvg_private_peek_u64le(w))) > p.height_in_pixels) {
+      break;
+    }
+    v = w;
+  }
+  size_t offset = iconvg_private_peek_u32le(v + 8);
+  n = iconvg_private_peek_u32le(v + 12);
+  if ((offset > body_len) || (n > (body_len - offset))) {
+    return iconvg_error_bad_display_list_cache;
+  }
+  const uint8_t* s = body + offset;
+
+  while (n > 0) {
+    uint8_t verb = s[0];
+    s += 1;
+    n -= 1;
+    float f[6];
+    int num_f32s = 0;
+    switch (verb) {
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_DRAWING:
+        ICONVG_PRIVATE_TRY((*c->vtable->begin_drawing)(c));
+        continue;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_DRAWING: {
+        size_t m = iconvg_private_display_list__replay_paint(&p, s, n);
+        if (m == 0) {
+          return iconvg_error_bad_display_list_cache;
+        }
+        s += m;
+        n -= m;
+        ICONVG_PRIVATE_TRY((*c->vtable->end_drawing)(c, &p));
+        continue;
+      }
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__END_PATH:
+        ICONVG_PRIVATE_TRY((*c->vtable->end_path)(c));
+        continue;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH:
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO:
+        num_f32s = 2;
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO:
+        num_f32s = 4;
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO:
+        num_f32s = 6;
+        break;
+      default:
+        return iconvg_error_bad_display_list_cache;
+    }
+
+    // Convert from src to dst coordinate space, the same way that the
+    // bytecode interpreter does.
+    if (n < (4 * (size_t)num_f32s)) {
+      return iconvg_error_bad_display_list_cache;
+    }
+    for (int i = 0; i < num_f32s; i += 2) {
+      float x = iconvg_private_display_list__peek_f32(s, i + 0);
+      float y = iconvg_private_display_list__peek_f32(s, i + 1);
+      if (p.skewed) {
+        f[i + 0] = (float)((x * p.s2d_scale_x) + (y * p.s2d_skew_x) +
+                           p.s2d_bias_x);
+        f[i + 1] = (float)((x * p.s2d_skew_y) + (y * p.s2d_scale_y) +
+                           p.s2d_bias_y);
+      } else {
+        f[i + 0] = (float)((x * p.s2d_scale_x) + p.s2d_bias_x);
+        f[i + 1] = (float)((y * p.s2d_scale_y) + p.s2d_bias_y);
+      }
+    }
+    s += 4 * (size_t)num_f32s;
+    n -= 4 * (size_t)num_f32s;
+    switch (verb) {
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__BEGIN_PATH:
+        ICONVG_PRIVATE_TRY((*c->vtable->begin_path)(c, f[0], f[1]));
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_LINE_TO:
+        ICONVG_PRIVATE_TRY((*c->vtable->path_line_to)(c, f[0], f[1]));
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_QUAD_TO:
+        ICONVG_PRIVATE_TRY(
+            (*c->vtable->path_quad_to)(c, f[0], f[1], f[2], f[3]));
+        break;
+      case ICONVG_PRIVATE_DISPLAY_LIST_VERB__PATH_CUBE_TO:
+        ICONVG_PRIVATE_TRY(
+            (*c->vtable->path_cube_to)(c, f[0], f[1], f[2], f[3], f[4], f[5]));
+        break;
+    }
+  }
+  return NULL;
+}
+
+const char*  //
+iconvg_display_list_cache__replay(const iconvg_display_list_cache* self,
+                                  iconvg_canvas* dst_canvas,
+                                  iconvg_rectangle_f32 dst_rect,
+                                  const uint8_t* src_ptr,
+                                  size_t src_len,
+                                  const iconvg_decode_options* options) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!dst_canvas || !dst_canvas->vtable) {
+    dst_canvas = &fallback_canvas;
+  }
+  if (dst_canvas->vtable->sizeof__iconvg_canvas_vtable !=
+      sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+
+  const uint8_t* body_ptr = NULL;
+  size_t body_len = 0;
+  if (!iconvg_private_display_list_cache__find(self, src_ptr, src_len, options,
+                                               &body_ptr, &body_len)) {
+    return iconvg_decode(dst_canvas, dst_rect, src_ptr, src_len, options);
+  }
+
+  const char* err_msg =
+      (*dst_canvas->vtable->begin_decode)(dst_canvas, dst_rect);
+  if (!err_msg) {
+    err_msg = iconvg_private_display_list__replay(dst_canvas, dst_rect,
+                                                  body_ptr, body_len, options);
+  }
+  return (*dst_canvas->vtable->end_decode)(dst_canvas, err_msg,
+                                           err_msg ? 0 : src_len,
+                                           err_msg ? src_len : 0);
+}
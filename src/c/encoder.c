@@ -0,0 +1,554 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// ICONVG_PRIVATE_ENCODER__MAX_RUN_REPS is the largest RepCount of a merged
+// LineTo, QuadTo or CubeTo op. Longer runs start a new op, so that the
+// RepCount's natural number always fits in 1 byte and extending a run never
+// moves the coordinates already written more than once.
+#define ICONVG_PRIVATE_ENCODER__MAX_RUN_REPS (16 + 127)
+
+#define ICONVG_PRIVATE_ENCODER__NO_RUN SIZE_MAX
+
+// iconvg_private_encode_natural writes u's shortest encoding to dst,
+// returning its length. u must be less than (1 << 30).
+static inline size_t  //
+iconvg_private_encode_natural(uint8_t* dst, uint32_t u) {
+  if (u < (1u << 7)) {
+    dst[0] = (uint8_t)((u << 1) | 0x01);
+    return 1;
+  } else if (u < (1u << 14)) {
+    u = (u << 2) | 0x02;
+    dst[0] = (uint8_t)(u >> 0);
+    dst[1] = (uint8_t)(u >> 8);
+    return 2;
+  }
+  iconvg_private_poke_u32le(dst, u << 2);
+  return 4;
+}
+
+// iconvg_private_encode_coordinate writes f's shortest encoding to dst,
+// returning its length, or zero if f is NaN. It produces the same bytes as
+// the Go implementation's encodeCoordinate.
+static inline size_t  //
+iconvg_private_encode_coordinate(uint8_t* dst, float f) {
+  if ((-64.0f <= f) && (f < +64.0f)) {
+    int32_t i = (int32_t)f;
+    if ((float)i == f) {
+      dst[0] = (uint8_t)((((uint32_t)(i + 64)) << 1) | 0x01);
+      return 1;
+    }
+  }
+
+  float g = f * 64.0f;
+  if ((-8192.0f <= g) && (g < +8192.0f)) {
+    int32_t i = (int32_t)g;
+    if ((float)i == g) {
+      uint32_t u = (((uint32_t)(i + 8192)) << 2) | 0x02;
+      dst[0] = (uint8_t)(u >> 0);
+      dst[1] = (uint8_t)(u >> 8);
+      return 2;
+    }
+  }
+
+  if (f != f) {  // Reject NaN.
+    return 0;
+  }
+  // Round the fractional bits (the low 23 bits) to the nearest multiple of 4,
+  // being careful not to overflow into the upper bits. The low 2 bits must
+  // end up zero, as they mark this as a 4-byte encoding.
+  uint32_t u = iconvg_private_reinterpret_from_f32_to_u32(f);
+  uint32_t v = u & 0x007FFFFF;
+  if (v < 0x007FFFFE) {
+    v += 2;
+  }
+  iconvg_private_poke_u32le(dst, (u & 0xFF800000) | (v & ~3u));
+  return 4;
+}
+
+static size_t  //
+iconvg_private_encode_coordinates(uint8_t* dst, const float* src, size_t n) {
+  size_t m = 0;
+  for (; n > 0; n--) {
+    size_t k = iconvg_private_encode_coordinate(dst + m, *src++);
+    if (k == 0) {
+      return 0;
+    }
+    m += k;
+  }
+  return m;
+}
+
+// ----
+
+static const char*  //
+iconvg_private_encoder__fail(iconvg_encoder* self, const char* err_msg) {
+  self->private_impl.err_msg = err_msg;
+  return err_msg;
+}
+
+// iconvg_private_encoder__reserve makes room for n more bytes, calling
+// grow_func if necessary.
+static const char*  //
+iconvg_private_encoder__reserve(iconvg_encoder* self, size_t n) {
+  if (n <= (self->cap - self->len)) {
+    return NULL;
+  } else if (!self->grow_func || (n > (SIZE_MAX - self->len))) {
+    return iconvg_private_encoder__fail(
+        self, iconvg_error_system_failure_out_of_memory);
+  }
+  uint8_t* ptr = self->ptr;
+  size_t cap = self->cap;
+  size_t min_cap = self->len + n;
+  const char* err_msg =
+      (*self->grow_func)(self->grow_context, &ptr, &cap, min_cap);
+  if (err_msg) {
+    return iconvg_private_encoder__fail(self, err_msg);
+  } else if (!ptr || (cap < min_cap)) {
+    return iconvg_private_encoder__fail(
+        self, iconvg_error_system_failure_out_of_memory);
+  }
+  self->ptr = ptr;
+  self->cap = cap;
+  return NULL;
+}
+
+// iconvg_private_encoder__write_bytes appends src[.. n], writing the default
+// metadata first if needed.
+static const char*  //
+iconvg_private_encoder__write_bytes(iconvg_encoder* self,
+                                    const uint8_t* src,
+                                    size_t n) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  }
+  size_t header = self->private_impl.wrote_metadata ? 0 : 5;
+  ICONVG_PRIVATE_TRY(iconvg_private_encoder__reserve(self, header + n));
+  uint8_t* p = self->ptr + self->len;
+  if (header) {
+    // The magic identifier and zero metadata chunks.
+    memcpy(p, "\x8A\x49\x56\x47\x01", 5);
+    p += 5;
+    self->private_impl.wrote_metadata = true;
+  }
+  if (n) {
+    memcpy(p, src, n);
+  }
+  self->len += header + n;
+  return NULL;
+}
+
+// iconvg_private_encoder__write_op appends an op other than a LineTo, QuadTo
+// or CubeTo op, ending any run of those.
+static const char*  //
+iconvg_private_encoder__write_op(iconvg_encoder* self,
+                                 const uint8_t* src,
+                                 size_t n) {
+  ICONVG_PRIVATE_TRY(iconvg_private_encoder__write_bytes(self, src, n));
+  self->private_impl.run_offset = ICONVG_PRIVATE_ENCODER__NO_RUN;
+  return NULL;
+}
+
+// iconvg_private_encoder__write_segment appends a LineTo (opcode 0x00),
+// QuadTo (0x10) or CubeTo (0x20) segment, merging it into the previous op if
+// that was of the same kind.
+static const char*  //
+iconvg_private_encoder__write_segment(iconvg_encoder* self,
+                                      uint8_t opcode,
+                                      const float* coords,
+                                      size_t num_coords) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  }
+  uint8_t buf[1 + (6 * 4)];
+  size_t n = iconvg_private_encode_coordinates(buf + 1, coords, num_coords);
+  if (n == 0) {
+    return iconvg_private_encoder__fail(self, iconvg_error_bad_coordinate);
+  }
+
+  size_t run_offset = self->private_impl.run_offset;
+  uint32_t reps = self->private_impl.run_reps + 1;
+  if ((run_offset == ICONVG_PRIVATE_ENCODER__NO_RUN) ||
+      (self->private_impl.run_opcode != opcode) ||
+      (reps > ICONVG_PRIVATE_ENCODER__MAX_RUN_REPS)) {
+    buf[0] = opcode | 1;
+    ICONVG_PRIVATE_TRY(iconvg_private_encoder__write_bytes(self, buf, 1 + n));
+    self->private_impl.run_offset = self->len - (1 + n);
+    self->private_impl.run_reps = 1;
+    self->private_impl.run_opcode = opcode;
+    return NULL;
+  }
+
+  // Extend the run. Going from 15 to 16 reps switches the op to the form
+  // where the RepCount is a natural number after the opcode byte.
+  ICONVG_PRIVATE_TRY(iconvg_private_encoder__reserve(self, 1 + n));
+  uint8_t* op = self->ptr + run_offset;
+  if (reps < 16) {
+    op[0] = opcode | (uint8_t)reps;
+  } else if (reps == 16) {
+    memmove(op + 2, op + 1, self->len - (run_offset + 1));
+    op[0] = opcode;
+    op[1] = 0x01;
+    self->len++;
+  } else {
+    op[1] = (uint8_t)(((reps - 16) << 1) | 0x01);
+  }
+  memcpy(self->ptr + self->len, buf + 1, n);
+  self->len += n;
+  self->private_impl.run_reps = reps;
+  return NULL;
+}
+
+static const char*  //
+iconvg_private_encoder__write_gradient(
+    iconvg_encoder* self,
+    uint8_t opcode,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if ((adj > 15) || (num_stops < 2) || (num_stops > 64) ||
+             (((uint32_t)spread) > 3) || !nominal_matrix) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  }
+  size_t num_floats = (opcode == 0x90) ? 3 : 6;
+  uint8_t buf[2 + (6 * 4)];
+  buf[0] = opcode | (uint8_t)adj;
+  buf[1] = (uint8_t)((num_stops - 2) | (((uint32_t)spread) << 6));
+  for (size_t i = 0; i < num_floats; i++) {
+    float f = (float)(nominal_matrix->elems[i / 3][i % 3]);
+    if (f != f) {  // Reject NaN.
+      return iconvg_private_encoder__fail(self, iconvg_error_bad_number);
+    }
+    iconvg_private_poke_u32le(buf + 2 + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f));
+  }
+  return iconvg_private_encoder__write_op(self, buf, 2 + (4 * num_floats));
+}
+
+// iconvg_private_encoder__register_op writes REGS[SEL + adj]'s op to dst,
+// returning its length.
+static size_t  //
+iconvg_private_encoder__register_op(uint8_t* dst,
+                                    uint32_t adj,
+                                    uint64_t value) {
+  uint32_t lo = (uint32_t)(value >> 0);
+  uint32_t hi = (uint32_t)(value >> 32);
+  if (hi == 0) {
+    dst[0] = 0x40 | (uint8_t)adj;
+    iconvg_private_poke_u32le(dst + 1, lo);
+    return 5;
+  } else if (lo == 0) {
+    dst[0] = 0x50 | (uint8_t)adj;
+    iconvg_private_poke_u32le(dst + 1, hi);
+    return 5;
+  }
+  dst[0] = 0x60 | (uint8_t)adj;
+  iconvg_private_poke_u64le(dst + 1, value);
+  return 9;
+}
+
+// ----
+
+const char*  //
+iconvg_encoder__initialize(iconvg_encoder* self,
+                           uint8_t* ptr,
+                           size_t cap,
+                           const char* (*grow_func)(void* grow_context,
+                                                    uint8_t** ptr,
+                                                    size_t* cap,
+                                                    size_t min_cap),
+                           void* grow_context) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  self->private_impl.run_offset = ICONVG_PRIVATE_ENCODER__NO_RUN;
+  if (!ptr && cap) {
+    return iconvg_private_encoder__fail(
+        self, iconvg_error_invalid_constructor_argument);
+  }
+  self->ptr = ptr;
+  self->cap = cap;
+  self->grow_func = grow_func;
+  self->grow_context = grow_context;
+  return NULL;
+}
+
+const char*  //
+iconvg_encoder__write_metadata(iconvg_encoder* self,
+                               const iconvg_rectangle_f32* viewbox,
+                               const iconvg_palette* suggested_palette) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if (self->private_impl.wrote_metadata) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  }
+
+  // The magic identifier (4 bytes), the number of chunks (1 byte), the
+  // ViewBox chunk (18 bytes) and the Suggested Palette chunk (260 bytes).
+  uint8_t buf[4 + 1 + (2 + (4 * 4)) + (2 + 2 + (64 * 4))];
+  memcpy(buf, "\x8A\x49\x56\x47", 4);
+  size_t n = 5;
+  uint8_t num_chunks = 0;
+
+  if (viewbox &&
+      ((viewbox->min_x != -32) || (viewbox->min_y != -32) ||
+       (viewbox->max_x != +32) || (viewbox->max_y != +32))) {
+    if (!((-INFINITY < viewbox->min_x) &&         //
+          (viewbox->min_x <= viewbox->max_x) &&  //
+          (viewbox->max_x < +INFINITY) &&        //
+          (-INFINITY < viewbox->min_y) &&        //
+          (viewbox->min_y <= viewbox->max_y) &&  //
+          (viewbox->max_y < +INFINITY))) {
+      return iconvg_private_encoder__fail(self,
+                                          iconvg_error_bad_metadata_viewbox);
+    }
+    float coords[4] = {viewbox->min_x, viewbox->min_y, viewbox->max_x,
+                       viewbox->max_y};
+    size_t m = iconvg_private_encode_coordinates(buf + n + 2, coords, 4);
+    buf[n + 0] = (uint8_t)(((1 + m) << 1) | 0x01);
+    buf[n + 1] = 0x11;  // MID 8.
+    n += 2 + m;
+    num_chunks++;
+  }
+
+  int last = suggested_palette
+                 ? iconvg_private_last_color_that_isnt_opaque_black(
+                       suggested_palette)
+                 : -1;
+  if (last >= 0) {
+    size_t m = 4 * (1 + (size_t)last);
+    n += iconvg_private_encode_natural(buf + n, (uint32_t)(2 + m));
+    buf[n + 0] = 0x21;  // MID 16.
+    buf[n + 1] = (uint8_t)last;
+    n += 2;
+    for (int i = 0; i <= last; i++) {
+      const uint8_t* rgba = &suggested_palette->colors[i].rgba[0];
+      if ((rgba[0] > rgba[3]) || (rgba[1] > rgba[3]) || (rgba[2] > rgba[3])) {
+        return iconvg_private_encoder__fail(
+            self, iconvg_error_bad_metadata_suggested_palette);
+      }
+      memcpy(buf + n, rgba, 4);
+      n += 4;
+    }
+    num_chunks++;
+  }
+
+  buf[4] = (uint8_t)((num_chunks << 1) | 0x01);
+  self->private_impl.wrote_metadata = true;
+  const char* err_msg = iconvg_private_encoder__write_op(self, buf, n);
+  if (err_msg) {
+    self->private_impl.wrote_metadata = false;
+  }
+  return err_msg;
+}
+
+const char*  //
+iconvg_encoder__move_to(iconvg_encoder* self, float x, float y) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  }
+  float coords[2] = {x, y};
+  uint8_t buf[1 + (2 * 4)];
+  buf[0] = 0x35;
+  size_t n = iconvg_private_encode_coordinates(buf + 1, coords, 2);
+  if (n == 0) {
+    return iconvg_private_encoder__fail(self, iconvg_error_bad_coordinate);
+  }
+  return iconvg_private_encoder__write_op(self, buf, 1 + n);
+}
+
+const char*  //
+iconvg_encoder__line_to(iconvg_encoder* self, float x, float y) {
+  float coords[2] = {x, y};
+  return iconvg_private_encoder__write_segment(self, 0x00, coords, 2);
+}
+
+const char*  //
+iconvg_encoder__quad_to(iconvg_encoder* self,
+                        float x1,
+                        float y1,
+                        float x2,
+                        float y2) {
+  float coords[4] = {x1, y1, x2, y2};
+  return iconvg_private_encoder__write_segment(self, 0x10, coords, 4);
+}
+
+const char*  //
+iconvg_encoder__cube_to(iconvg_encoder* self,
+                        float x1,
+                        float y1,
+                        float x2,
+                        float y2,
+                        float x3,
+                        float y3) {
+  float coords[6] = {x1, y1, x2, y2, x3, y3};
+  return iconvg_private_encoder__write_segment(self, 0x20, coords, 6);
+}
+
+static const char*  //
+iconvg_private_encoder__write_parallelogram_op(iconvg_encoder* self,
+                                               uint8_t opcode,
+                                               float x1,
+                                               float y1,
+                                               float x2,
+                                               float y2) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  }
+  float coords[4] = {x1, y1, x2, y2};
+  uint8_t buf[1 + (4 * 4)];
+  buf[0] = opcode;
+  size_t n = iconvg_private_encode_coordinates(buf + 1, coords, 4);
+  if (n == 0) {
+    return iconvg_private_encoder__fail(self, iconvg_error_bad_coordinate);
+  }
+  return iconvg_private_encoder__write_op(self, buf, 1 + n);
+}
+
+const char*  //
+iconvg_encoder__ellipse(iconvg_encoder* self,
+                        uint32_t num_quarters,
+                        float x1,
+                        float y1,
+                        float x2,
+                        float y2) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if ((num_quarters < 1) || (num_quarters > 4)) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  }
+  return iconvg_private_encoder__write_parallelogram_op(
+      self, (uint8_t)(0x30 + (num_quarters - 1)), x1, y1, x2, y2);
+}
+
+const char*  //
+iconvg_encoder__parallelogram(iconvg_encoder* self,
+                              float x1,
+                              float y1,
+                              float x2,
+                              float y2) {
+  return iconvg_private_encoder__write_parallelogram_op(self, 0x34, x1, y1,
+                                                        x2, y2);
+}
+
+const char*  //
+iconvg_encoder__set_register(iconvg_encoder* self,
+                             uint32_t adj,
+                             uint64_t value) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if (adj > 15) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  }
+  uint8_t buf[9];
+  size_t n = iconvg_private_encoder__register_op(buf, adj, value);
+  return iconvg_private_encoder__write_op(self, buf, n);
+}
+
+const char*  //
+iconvg_encoder__set_registers(iconvg_encoder* self,
+                              const uint64_t* values,
+                              size_t num_values) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if ((num_values > 64) || (!values && num_values)) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  } else if (num_values == 0) {
+    return NULL;
+  }
+
+  // Each op decrements SEL first, so write the highest registers first. A
+  // run of 1 uses a "set REGS[SEL + 0]; SEL--" op, as there is no 1-register
+  // multi-register op.
+  uint8_t buf[(4 * 1) + (64 * 8)];
+  size_t n = 0;
+  for (size_t end = num_values; end > 0;) {
+    size_t chunk = (end < 17) ? end : 17;
+    size_t start = end - chunk;
+    if (chunk == 1) {
+      n += iconvg_private_encoder__register_op(buf + n, 0, values[start]);
+    } else {
+      buf[n++] = 0x70 | (uint8_t)(chunk - 2);
+      for (size_t i = start; i < end; i++) {
+        iconvg_private_poke_u64le(buf + n, values[i]);
+        n += 8;
+      }
+    }
+    end = start;
+  }
+  return iconvg_private_encoder__write_op(self, buf, n);
+}
+
+const char*  //
+iconvg_encoder__add_to_sel(iconvg_encoder* self, uint8_t delta) {
+  uint8_t buf[2] = {0x36, delta};
+  return iconvg_private_encoder__write_op(self, buf, 2);
+}
+
+const char*  //
+iconvg_encoder__fill_flat(iconvg_encoder* self, uint32_t adj) {
+  if (self->private_impl.err_msg) {
+    return self->private_impl.err_msg;
+  } else if (adj > 15) {
+    return iconvg_private_encoder__fail(self,
+                                        iconvg_error_invalid_encoder_call);
+  }
+  uint8_t buf[1] = {0x80 | (uint8_t)adj};
+  return iconvg_private_encoder__write_op(self, buf, 1);
+}
+
+const char*  //
+iconvg_encoder__fill_flat_color(iconvg_encoder* self,
+                                iconvg_premul_color color) {
+  uint8_t buf[6] = {0x51, color.rgba[0], color.rgba[1],
+                    color.rgba[2], color.rgba[3], 0x81};
+  return iconvg_private_encoder__write_op(self, buf, 6);
+}
+
+const char*  //
+iconvg_encoder__fill_linear_gradient(
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix) {
+  return iconvg_private_encoder__write_gradient(self, 0x90, adj, num_stops,
+                                                spread, nominal_matrix);
+}
+
+const char*  //
+iconvg_encoder__fill_radial_gradient(
+    iconvg_encoder* self,
+    uint32_t adj,
+    uint32_t num_stops,
+    iconvg_gradient_spread spread,
+    const iconvg_matrix_2x3_f64* nominal_matrix) {
+  return iconvg_private_encoder__write_gradient(self, 0xA0, adj, num_stops,
+                                                spread, nominal_matrix);
+}
+
+const char*  //
+iconvg_encoder__finish(iconvg_encoder* self) {
+  return iconvg_private_encoder__write_bytes(self, NULL, 0);
+}
@@ -16,6 +16,8 @@
 
 const char iconvg_error_bad_coordinate[] =  //
     "iconvg: bad coordinate";
+const char iconvg_error_bad_display_list_cache[] =  //
+    "iconvg: bad display list cache";
 const char iconvg_error_bad_jump[] =  //
     "iconvg: bad jump";
 const char iconvg_error_bad_magic_identifier[] =  //
@@ -32,7 +34,13 @@ const char iconvg_error_bad_number[] =  //
     "iconvg: bad number";
 const char iconvg_error_bad_opcode_length[] =  //
     "iconvg: bad opcode length";
+const char iconvg_error_bad_pack[] =  //
+    "iconvg: bad pack";
+const char iconvg_error_bad_segref[] =  //
+    "iconvg: bad SegRef";
 
+const char iconvg_error_system_failure_could_not_read_file[] =  //
+    "iconvg: system failure: could not read file";
 const char iconvg_error_system_failure_out_of_memory[] =  //
     "iconvg: system failure: out of memory";
 
@@ -40,8 +48,12 @@ const char iconvg_error_invalid_backend_not_enabled[] =  //
     "iconvg: invalid backend (not enabled)";
 const char iconvg_error_invalid_constructor_argument[] =  //
     "iconvg: invalid constructor argument";
+const char iconvg_error_invalid_encoder_call[] =  //
+    "iconvg: invalid encoder call";
 const char iconvg_error_invalid_paint_type[] =  //
     "iconvg: invalid paint type";
+const char iconvg_error_invalid_trace[] =  //
+    "iconvg: invalid trace";
 const char iconvg_error_invalid_vtable[] =  //
     "iconvg: invalid vtable";
 
@@ -50,6 +62,7 @@ const char iconvg_error_invalid_vtable[] =  //
 bool  //
 iconvg_error_is_file_format_error(const char* err_msg) {
   return (err_msg == iconvg_error_bad_coordinate) ||
+         (err_msg == iconvg_error_bad_display_list_cache) ||
          (err_msg == iconvg_error_bad_jump) ||
          (err_msg == iconvg_error_bad_magic_identifier) ||
          (err_msg == iconvg_error_bad_metadata) ||
@@ -57,5 +70,7 @@ iconvg_error_is_file_format_error(const char* err_msg) {
          (err_msg == iconvg_error_bad_metadata_suggested_palette) ||
          (err_msg == iconvg_error_bad_metadata_viewbox) ||
          (err_msg == iconvg_error_bad_number) ||
-         (err_msg == iconvg_error_bad_opcode_length);
+         (err_msg == iconvg_error_bad_opcode_length) ||
+         (err_msg == iconvg_error_bad_pack) ||
+         (err_msg == iconvg_error_bad_segref);
 }
@@ -0,0 +1,221 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ICONVG_PRIVATE_FILE__HAVE_MMAP 1
+#endif
+
+// iconvg_private_file__reserve grows (*ptr)[.. *cap] so that at least one
+// byte is free after its first n bytes. On failure, it frees *ptr.
+static bool  //
+iconvg_private_file__reserve(uint8_t** ptr,
+                             size_t* cap,
+                             size_t n,
+                             iconvg_allocator* allocator) {
+  if (n < *cap) {
+    return true;
+  }
+  size_t new_cap = *cap ? (2 * *cap) : 65536;
+  uint8_t* new_ptr = (new_cap > *cap) ? iconvg_private_allocator__realloc(
+                                            allocator, *ptr, *cap, new_cap)
+                                      : NULL;
+  if (!new_ptr) {
+    iconvg_private_allocator__free(allocator, *ptr, *cap);
+    *ptr = NULL;
+    *cap = 0;
+    return false;
+  }
+  *ptr = new_ptr;
+  *cap = new_cap;
+  return true;
+}
+
+// iconvg_private_file__read_stream reads f until EOF into (*ptr)[.. *len],
+// allocated (with capacity *cap) by allocator. On failure, nothing needs
+// freeing.
+static const char*  //
+iconvg_private_file__read_stream(FILE* f,
+                                 uint8_t** ptr,
+                                 size_t* len,
+                                 size_t* cap,
+                                 iconvg_allocator* allocator) {
+  uint8_t* p = NULL;
+  size_t n = 0;
+  size_t c = 0;
+  while (true) {
+    if (!iconvg_private_file__reserve(&p, &c, n, allocator)) {
+      return iconvg_error_system_failure_out_of_memory;
+    }
+    size_t m = fread(p + n, 1, c - n, f);
+    n += m;
+    if (m == 0) {
+      break;
+    }
+  }
+  if (ferror(f)) {
+    iconvg_private_allocator__free(allocator, p, c);
+    return iconvg_error_system_failure_could_not_read_file;
+  }
+  *ptr = p;
+  *len = n;
+  *cap = c;
+  return NULL;
+}
+
+#if defined(ICONVG_PRIVATE_FILE__HAVE_MMAP)
+// iconvg_private_file__read_fd is like iconvg_private_file__read_stream but
+// reads from a file descriptor.
+static const char*  //
+iconvg_private_file__read_fd(int fd,
+                             uint8_t** ptr,
+                             size_t* len,
+                             size_t* cap,
+                             iconvg_allocator* allocator) {
+  uint8_t* p = NULL;
+  size_t n = 0;
+  size_t c = 0;
+  while (true) {
+    if (!iconvg_private_file__reserve(&p, &c, n, allocator)) {
+      return iconvg_error_system_failure_out_of_memory;
+    }
+    ssize_t m = read(fd, p + n, c - n);
+    if (m > 0) {
+      n += (size_t)m;
+    } else if (m == 0) {
+      break;
+    } else if (errno != EINTR) {
+      iconvg_private_allocator__free(allocator, p, c);
+      return iconvg_error_system_failure_could_not_read_file;
+    }
+  }
+  *ptr = p;
+  *len = n;
+  *cap = c;
+  return NULL;
+}
+#endif
+
+// ----
+
+const char*  //
+iconvg_file__open(iconvg_file* self,
+                  const char* path,
+                  iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!path) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  uint8_t* ptr = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+
+#if defined(ICONVG_PRIVATE_FILE__HAVE_MMAP)
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return iconvg_error_system_failure_could_not_read_file;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return iconvg_error_system_failure_could_not_read_file;
+  } else if (S_ISREG(st.st_mode) && (st.st_size > 0) &&
+             (((uint64_t)(st.st_size)) <= SIZE_MAX)) {
+    size_t n = (size_t)(st.st_size);
+    void* p = mmap(NULL, n, PROT_READ, MAP_SHARED, fd, 0);
+    if (p != MAP_FAILED) {
+      close(fd);
+      self->ptr = (const uint8_t*)p;
+      self->len = n;
+      self->is_mapped = true;
+      return NULL;
+    }
+  }
+  // Pipes, character devices, empty files and the like can't be mapped, so
+  // read them instead.
+  const char* err_msg =
+      iconvg_private_file__read_fd(fd, &ptr, &len, &cap, allocator);
+  close(fd);
+
+#else
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    return iconvg_error_system_failure_could_not_read_file;
+  }
+  const char* err_msg =
+      iconvg_private_file__read_stream(f, &ptr, &len, &cap, allocator);
+  fclose(f);
+#endif
+
+  if (err_msg) {
+    return err_msg;
+  }
+  self->ptr = ptr;
+  self->len = len;
+  self->cap = cap;
+  self->allocator = allocator;
+  return NULL;
+}
+
+const char*  //
+iconvg_file__open_stream(iconvg_file* self,
+                         FILE* f,
+                         iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!f) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  uint8_t* ptr = NULL;
+  size_t len = 0;
+  size_t cap = 0;
+  const char* err_msg =
+      iconvg_private_file__read_stream(f, &ptr, &len, &cap, allocator);
+  if (err_msg) {
+    return err_msg;
+  }
+  self->ptr = ptr;
+  self->len = len;
+  self->cap = cap;
+  self->allocator = allocator;
+  return NULL;
+}
+
+void  //
+iconvg_file__close(iconvg_file* self) {
+  if (!self) {
+    return;
+  } else if (self->is_mapped) {
+#if defined(ICONVG_PRIVATE_FILE__HAVE_MMAP)
+    munmap((void*)(self->ptr), self->len);
+#endif
+  } else {
+    iconvg_private_allocator__free(self->allocator, (void*)(self->ptr),
+                                   self->cap);
+  }
+  memset(self, 0, sizeof(*self));
+}
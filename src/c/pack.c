@@ -0,0 +1,195 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#define ICONVG_PRIVATE_PACK__HEADER_SIZE 32
+#define ICONVG_PRIVATE_PACK__ENTRY_SIZE 32
+#define ICONVG_PRIVATE_PACK__BLOB_ALIGNMENT 4096
+
+static inline uint64_t  //
+iconvg_private_pack__hash(const char* name, size_t name_len) {
+  return iconvg_private_hash_fnv1a_64((const uint8_t*)name, name_len);
+}
+
+// iconvg_private_pack__compare orders entries (given as hash, name and
+// name_len) by hash and then by name.
+static int  //
+iconvg_private_pack__compare(uint64_t h0,
+                             const char* name0,
+                             size_t name_len0,
+                             uint64_t h1,
+                             const char* name1,
+                             size_t name_len1) {
+  if (h0 != h1) {
+    return (h0 < h1) ? -1 : +1;
+  }
+  size_t n = (name_len0 < name_len1) ? name_len0 : name_len1;
+  int c = memcmp(name0, name1, n);
+  if (c != 0) {
+    return c;
+  } else if (name_len0 != name_len1) {
+    return (name_len0 < name_len1) ? -1 : +1;
+  }
+  return 0;
+}
+
+static iconvg_pack_entry  //
+iconvg_private_pack__entry(const iconvg_pack* self, uint32_t i) {
+  const uint8_t* e = self->ptr + ICONVG_PRIVATE_PACK__HEADER_SIZE +
+                     (((size_t)i) * ICONVG_PRIVATE_PACK__ENTRY_SIZE);
+  iconvg_pack_entry entry;
+  entry.name =
+      (const char*)(self->ptr + iconvg_private_peek_u32le(e + 24));
+  entry.name_len = iconvg_private_peek_u32le(e + 28);
+  entry.ptr = self->ptr + iconvg_private_peek_u64le(e + 8);
+  entry.len = (size_t)(iconvg_private_peek_u64le(e + 16));
+  return entry;
+}
+
+// ----
+
+const char*  //
+iconvg_pack__open_bytes(iconvg_pack* self, const uint8_t* ptr, size_t len) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!ptr || (len < ICONVG_PRIVATE_PACK__HEADER_SIZE) ||
+      memcmp(ptr, "\x8AIVGpack", 8) ||
+      (iconvg_private_peek_u32le(ptr + 8) != 1) ||
+      (iconvg_private_peek_u64le(ptr + 16) !=
+       ICONVG_PRIVATE_PACK__HEADER_SIZE) ||
+      (iconvg_private_peek_u64le(ptr + 24) != len)) {
+    return iconvg_error_bad_pack;
+  }
+
+  // Check the index up front, so that the other methods don't have to.
+  uint32_t num_entries = iconvg_private_peek_u32le(ptr + 12);
+  uint64_t names_start = ICONVG_PRIVATE_PACK__HEADER_SIZE +
+                         (((uint64_t)num_entries) *
+                          ICONVG_PRIVATE_PACK__ENTRY_SIZE);
+  if (names_start > len) {
+    return iconvg_error_bad_pack;
+  }
+  const uint8_t* e = ptr + ICONVG_PRIVATE_PACK__HEADER_SIZE;
+  for (uint32_t i = 0; i < num_entries;
+       i++, e += ICONVG_PRIVATE_PACK__ENTRY_SIZE) {
+    uint64_t h = iconvg_private_peek_u64le(e + 0);
+    uint64_t blob_offset = iconvg_private_peek_u64le(e + 8);
+    uint64_t blob_length = iconvg_private_peek_u64le(e + 16);
+    uint64_t name_offset = iconvg_private_peek_u32le(e + 24);
+    uint64_t name_length = iconvg_private_peek_u32le(e + 28);
+    if ((blob_offset % ICONVG_PRIVATE_PACK__BLOB_ALIGNMENT) ||
+        (blob_offset > len) || (blob_length > (len - blob_offset)) ||
+        (name_offset < names_start) || (name_offset > len) ||
+        (name_length >= (len - name_offset)) ||
+        (ptr[name_offset + name_length] != 0)) {
+      return iconvg_error_bad_pack;
+    }
+    const char* name = (const char*)(ptr + name_offset);
+    if (h != iconvg_private_pack__hash(name, name_length)) {
+      return iconvg_error_bad_pack;
+    } else if (i > 0) {
+      const uint8_t* p = e - ICONVG_PRIVATE_PACK__ENTRY_SIZE;
+      if (iconvg_private_pack__compare(
+              iconvg_private_peek_u64le(p + 0),
+              (const char*)(ptr + iconvg_private_peek_u32le(p + 24)),
+              iconvg_private_peek_u32le(p + 28), h, name, name_length) >= 0) {
+        return iconvg_error_bad_pack;
+      }
+    }
+  }
+
+  self->ptr = ptr;
+  self->len = len;
+  self->num_entries = num_entries;
+  return NULL;
+}
+
+// ----
+
+const char*  //
+iconvg_pack__open_mmap(iconvg_pack* self,
+                       const char* path,
+                       iconvg_allocator* allocator) {
+  if (!self) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+  memset(self, 0, sizeof(*self));
+  if (!path) {
+    return iconvg_error_invalid_constructor_argument;
+  }
+
+  iconvg_file file;
+  const char* err_msg = iconvg_file__open(&file, path, allocator);
+  if (err_msg) {
+    return err_msg;
+  }
+  err_msg = iconvg_pack__open_bytes(self, file.ptr, file.len);
+  if (err_msg) {
+    iconvg_file__close(&file);
+    return err_msg;
+  }
+  self->file = file;
+  return NULL;
+}
+
+void  //
+iconvg_pack__close(iconvg_pack* self) {
+  if (!self) {
+    return;
+  }
+  iconvg_file__close(&self->file);
+  memset(self, 0, sizeof(*self));
+}
+
+iconvg_pack_entry  //
+iconvg_pack__find(const iconvg_pack* self, const char* name, size_t name_len) {
+  iconvg_pack_entry entry = {0};
+  if (!self || !self->ptr || (!name && name_len)) {
+    return entry;
+  } else if (!name) {
+    name = "";
+  }
+  uint64_t h = iconvg_private_pack__hash(name, name_len);
+  uint32_t lo = 0;
+  uint32_t hi = self->num_entries;
+  while (lo < hi) {
+    uint32_t mid = lo + ((hi - lo) / 2);
+    const uint8_t* e = self->ptr + ICONVG_PRIVATE_PACK__HEADER_SIZE +
+                       (((size_t)mid) * ICONVG_PRIVATE_PACK__ENTRY_SIZE);
+    int c = iconvg_private_pack__compare(
+        h, name, name_len, iconvg_private_peek_u64le(e + 0),
+        (const char*)(self->ptr + iconvg_private_peek_u32le(e + 24)),
+        iconvg_private_peek_u32le(e + 28));
+    if (c == 0) {
+      return iconvg_private_pack__entry(self, mid);
+    } else if (c < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return entry;
+}
+
+iconvg_pack_entry  //
+iconvg_pack__entry(const iconvg_pack* self, uint32_t i) {
+  if (!self || !self->ptr || (i >= self->num_entries)) {
+    iconvg_pack_entry entry = {0};
+    return entry;
+  }
+  return iconvg_private_pack__entry(self, i);
+}
@@ -215,5 +215,17 @@ iconvg_paint__gradient_transformation_matrix(const iconvg_paint* self) {
   double d11 = s11 * self->d2s_scale_y;
   double d12 = (s10 * self->d2s_bias_x) + (s11 * self->d2s_bias_y) + s12;
 
+  // With a rotating or skewing dst_transform, src_x also depends on dst_y
+  // (and src_y on dst_x):
+  //
+  //   src_x = (dst_x * d2s_scale_x) + (dst_y * d2s_skew_x) + d2s_bias_x
+  //   src_y = (dst_x * d2s_skew_y) + (dst_y * d2s_scale_y) + d2s_bias_y
+  if (self->skewed) {
+    d00 += s01 * self->d2s_skew_y;
+    d01 += s00 * self->d2s_skew_x;
+    d10 += s11 * self->d2s_skew_y;
+    d11 += s10 * self->d2s_skew_x;
+  }
+
   return iconvg_matrix_2x3_f64__make(d00, d01, d02, d10, d11, d12);
 }
@@ -0,0 +1,511 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+#include <time.h>
+
+static uint64_t  //
+iconvg_private_monotonic_nanos() {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0) {
+    return (((uint64_t)(ts.tv_sec)) * 1000000000u) +
+           ((uint64_t)(ts.tv_nsec));
+  }
+  return 0;
+#elif defined(TIME_UTC)
+  struct timespec ts;
+  if (timespec_get(&ts, TIME_UTC) == TIME_UTC) {
+    return (((uint64_t)(ts.tv_sec)) * 1000000000u) +
+           ((uint64_t)(ts.tv_nsec));
+  }
+  return 0;
+#else
+  return (uint64_t)(((double)(clock())) * (1e9 / CLOCKS_PER_SEC));
+#endif
+}
+
+// ----
+
+void  //
+iconvg_histogram__add(iconvg_histogram* self, uint64_t value) {
+  if (!self) {
+    return;
+  }
+  uint32_t i = 0;
+  for (uint64_t v = value; v; v >>= 1) {
+    i++;
+  }
+  if (i >= ICONVG_HISTOGRAM__NUM_BUCKETS) {
+    i = ICONVG_HISTOGRAM__NUM_BUCKETS - 1;
+  }
+  self->count++;
+  self->sum += value;
+  if (self->max < value) {
+    self->max = value;
+  }
+  self->buckets[i]++;
+}
+
+void  //
+iconvg_histogram__merge(iconvg_histogram* self,
+                        const iconvg_histogram* other) {
+  if (!self || !other) {
+    return;
+  }
+  self->count += other->count;
+  self->sum += other->sum;
+  if (self->max < other->max) {
+    self->max = other->max;
+  }
+  for (int i = 0; i < ICONVG_HISTOGRAM__NUM_BUCKETS; i++) {
+    self->buckets[i] += other->buckets[i];
+  }
+}
+
+uint64_t  //
+iconvg_histogram__percentile(const iconvg_histogram* self, double p) {
+  if (!self || (self->count == 0)) {
+    return 0;
+  } else if (!(p > 0)) {
+    p = 0;
+  } else if (p > 100) {
+    p = 100;
+  }
+  uint64_t rank = (uint64_t)((p / 100) * ((double)(self->count)));
+  if (rank >= self->count) {
+    rank = self->count - 1;
+  }
+  uint64_t n = 0;
+  for (int i = 0; i < ICONVG_HISTOGRAM__NUM_BUCKETS; i++) {
+    n += self->buckets[i];
+    if (n > rank) {
+      if (i >= (ICONVG_HISTOGRAM__NUM_BUCKETS - 1)) {
+        break;
+      }
+      uint64_t upper = ((uint64_t)1) << i;
+      return (upper < self->max) ? upper : self->max;
+    }
+  }
+  return self->max;
+}
+
+// ----
+
+void  //
+iconvg_profile__merge(iconvg_profile* self, const iconvg_profile* other) {
+  if (!self || !other) {
+    return;
+  }
+  self->num_calls.begin_decode += other->num_calls.begin_decode;
+  self->num_calls.end_decode += other->num_calls.end_decode;
+  self->num_calls.begin_drawing += other->num_calls.begin_drawing;
+  self->num_calls.end_drawing += other->num_calls.end_drawing;
+  self->num_calls.begin_path += other->num_calls.begin_path;
+  self->num_calls.end_path += other->num_calls.end_path;
+  self->num_calls.path_line_to += other->num_calls.path_line_to;
+  self->num_calls.path_quad_to += other->num_calls.path_quad_to;
+  self->num_calls.path_cube_to += other->num_calls.path_cube_to;
+  self->num_calls.on_metadata_viewbox +=
+      other->num_calls.on_metadata_viewbox;
+  self->num_calls.on_metadata_suggested_palette +=
+      other->num_calls.on_metadata_suggested_palette;
+  self->num_failed_decodes += other->num_failed_decodes;
+  for (int i = 0; i < 4; i++) {
+    self->num_drawings_by_paint_type[i] +=
+        other->num_drawings_by_paint_type[i];
+  }
+  iconvg_histogram__merge(&self->segments_per_path, &other->segments_per_path);
+  iconvg_histogram__merge(&self->stops_per_gradient,
+                          &other->stops_per_gradient);
+  iconvg_histogram__merge(&self->end_drawing_nanos, &other->end_drawing_nanos);
+  iconvg_histogram__merge(&self->path_nanos, &other->path_nanos);
+}
+
+static void  //
+iconvg_private_histogram__write_json(const iconvg_histogram* self,
+                                     FILE* f,
+                                     const char* name,
+                                     const char* suffix) {
+  fprintf(f,
+          "  \"%s\": {\"count\": %llu, \"sum\": %llu, \"max\": %llu"
+          ", \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"buckets\": {",
+          name, ((unsigned long long)(self->count)),
+          ((unsigned long long)(self->sum)), ((unsigned long long)(self->max)),
+          ((unsigned long long)(iconvg_histogram__percentile(self, 50))),
+          ((unsigned long long)(iconvg_histogram__percentile(self, 90))),
+          ((unsigned long long)(iconvg_histogram__percentile(self, 99))));
+  const char* sep = "";
+  for (int i = 0; i < ICONVG_HISTOGRAM__NUM_BUCKETS; i++) {
+    if (self->buckets[i] == 0) {
+      continue;
+    } else if (i < (ICONVG_HISTOGRAM__NUM_BUCKETS - 1)) {
+      fprintf(f, "%s\"<%llu\": %llu", sep,
+              ((unsigned long long)(((uint64_t)1) << i)),
+              ((unsigned long long)(self->buckets[i])));
+    } else {
+      fprintf(f, "%s\"inf\": %llu", sep,
+              ((unsigned long long)(self->buckets[i])));
+    }
+    sep = ", ";
+  }
+  fprintf(f, "}}%s\n", suffix);
+}
+
+void  //
+iconvg_profile__write_json(const iconvg_profile* self, FILE* f) {
+  if (!self || !f) {
+    return;
+  }
+  fprintf(f, "{\n  \"num_calls\": {");
+  fprintf(f, "\"begin_decode\": %llu",
+          ((unsigned long long)(self->num_calls.begin_decode)));
+  fprintf(f, ", \"end_decode\": %llu",
+          ((unsigned long long)(self->num_calls.end_decode)));
+  fprintf(f, ", \"begin_drawing\": %llu",
+          ((unsigned long long)(self->num_calls.begin_drawing)));
+  fprintf(f, ", \"end_drawing\": %llu",
+          ((unsigned long long)(self->num_calls.end_drawing)));
+  fprintf(f, ", \"begin_path\": %llu",
+          ((unsigned long long)(self->num_calls.begin_path)));
+  fprintf(f, ", \"end_path\": %llu",
+          ((unsigned long long)(self->num_calls.end_path)));
+  fprintf(f, ", \"path_line_to\": %llu",
+          ((unsigned long long)(self->num_calls.path_line_to)));
+  fprintf(f, ", \"path_quad_to\": %llu",
+          ((unsigned long long)(self->num_calls.path_quad_to)));
+  fprintf(f, ", \"path_cube_to\": %llu",
+          ((unsigned long long)(self->num_calls.path_cube_to)));
+  fprintf(f, ", \"on_metadata_viewbox\": %llu",
+          ((unsigned long long)(self->num_calls.on_metadata_viewbox)));
+  fprintf(
+      f, ", \"on_metadata_suggested_palette\": %llu},\n",
+      ((unsigned long long)(self->num_calls.on_metadata_suggested_palette)));
+  fprintf(f, "  \"num_failed_decodes\": %llu,\n",
+          ((unsigned long long)(self->num_failed_decodes)));
+  fprintf(f,
+          "  \"num_drawings_by_paint_type\": {\"invalid\": %llu"
+          ", \"flat_color\": %llu, \"linear_gradient\": %llu"
+          ", \"radial_gradient\": %llu},\n",
+          ((unsigned long long)(self->num_drawings_by_paint_type[0])),
+          ((unsigned long long)(self->num_drawings_by_paint_type[1])),
+          ((unsigned long long)(self->num_drawings_by_paint_type[2])),
+          ((unsigned long long)(self->num_drawings_by_paint_type[3])));
+  iconvg_private_histogram__write_json(&self->segments_per_path, f,
+                                       "segments_per_path", ",");
+  iconvg_private_histogram__write_json(&self->stops_per_gradient, f,
+                                       "stops_per_gradient", ",");
+  iconvg_private_histogram__write_json(&self->end_drawing_nanos, f,
+                                       "end_drawing_nanos", ",");
+  iconvg_private_histogram__write_json(&self->path_nanos, f, "path_nanos",
+                                       "");
+  fprintf(f, "}\n");
+}
+
+// ----
+
+// The profiler canvas' context fields are:
+//  - nonconst_ptr1: the wrapped iconvg_canvas*, possibly NULL.
+//  - nonconst_ptr2: the iconvg_profile*, possibly NULL.
+//  - extra5: the number of segments in the current path.
+
+static const char*  //
+iconvg_private_profiler_canvas__begin_decode(iconvg_canvas* c,
+                                             iconvg_rectangle_f32 dst_rect) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.begin_decode++;
+  }
+  c->context.extra5 = 0;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__end_decode(iconvg_canvas* c,
+                                           const char* err_msg,
+                                           size_t num_bytes_consumed,
+                                           size_t num_bytes_remaining) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.end_decode++;
+    if (err_msg) {
+      profile->num_failed_decodes++;
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return err_msg;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.begin_drawing++;
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__end_drawing(iconvg_canvas* c,
+                                            const iconvg_paint* p) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.end_drawing++;
+    iconvg_paint_type t = iconvg_paint__type(p);
+    profile->num_drawings_by_paint_type[t & 3]++;
+    if ((t == ICONVG_PAINT_TYPE__LINEAR_GRADIENT) ||
+        (t == ICONVG_PAINT_TYPE__RADIAL_GRADIENT)) {
+      iconvg_histogram__add(&profile->stops_per_gradient,
+                            iconvg_paint__gradient_number_of_stops(p));
+    }
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->end_drawing)(wrapped, p);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->end_drawing)(wrapped, p);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->end_drawing_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__begin_path(iconvg_canvas* c,
+                                           float x0,
+                                           float y0) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.begin_path++;
+  }
+  c->context.extra5 = 0;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__end_path(iconvg_canvas* c) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.end_path++;
+    iconvg_histogram__add(&profile->segments_per_path, c->context.extra5);
+  }
+  c->context.extra5 = 0;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->end_path)(wrapped);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->end_path)(wrapped);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__path_line_to(iconvg_canvas* c,
+                                             float x1,
+                                             float y1) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.path_line_to++;
+  }
+  c->context.extra5++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg = (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__path_quad_to(iconvg_canvas* c,
+                                             float x1,
+                                             float y1,
+                                             float x2,
+                                             float y2) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.path_quad_to++;
+  }
+  c->context.extra5++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg =
+      (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__path_cube_to(iconvg_canvas* c,
+                                             float x1,
+                                             float y1,
+                                             float x2,
+                                             float y2,
+                                             float x3,
+                                             float y3) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.path_cube_to++;
+  }
+  c->context.extra5++;
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!profile) {
+    return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+  }
+  uint64_t t0 = iconvg_private_monotonic_nanos();
+  const char* err_msg =
+      (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+  uint64_t t1 = iconvg_private_monotonic_nanos();
+  iconvg_histogram__add(&profile->path_nanos, t1 - t0);
+  return err_msg;
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__on_metadata_viewbox(
+    iconvg_canvas* c,
+    iconvg_rectangle_f32 viewbox) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.on_metadata_viewbox++;
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+}
+
+static const char*  //
+iconvg_private_profiler_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_profile* profile = (iconvg_profile*)(c->context.nonconst_ptr2);
+  if (profile) {
+    profile->num_calls.on_metadata_suggested_palette++;
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_profiler_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_profiler_canvas__begin_decode,
+        &iconvg_private_profiler_canvas__end_decode,
+        &iconvg_private_profiler_canvas__begin_drawing,
+        &iconvg_private_profiler_canvas__end_drawing,
+        &iconvg_private_profiler_canvas__begin_path,
+        &iconvg_private_profiler_canvas__end_path,
+        &iconvg_private_profiler_canvas__path_line_to,
+        &iconvg_private_profiler_canvas__path_quad_to,
+        &iconvg_private_profiler_canvas__path_cube_to,
+        &iconvg_private_profiler_canvas__on_metadata_viewbox,
+        &iconvg_private_profiler_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_profiler(iconvg_canvas* wrapped, iconvg_profile* profile) {
+  if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_profiler_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = profile;
+  return c;
+}
@@ -158,28 +158,29 @@ iconvg_private_skia_canvas__end_decode(iconvg_canvas* c,
                                        const char* err_msg,
                                        size_t num_bytes_consumed,
                                        size_t num_bytes_remaining) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
   if (spb) {
     sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
+    c->context.nonconst_ptr2 = NULL;
   }
   sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
   sk_canvas_restore(sc);
   return err_msg;
 }
 
+// The first begin_drawing creates the path builder. Later drawings (in the
+// same decode) reuse it, as end_drawing's sk_pathbuilder_detach_path leaves it
+// empty, and end_decode deletes it.
 static const char*  //
 iconvg_private_skia_canvas__begin_drawing(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
+  if (c->context.nonconst_ptr2) {
+    return NULL;
   }
-  spb = sk_pathbuilder_new();
+  sk_pathbuilder_t* spb = sk_pathbuilder_new();
   if (!spb) {
     return iconvg_error_system_failure_out_of_memory;
   }
-  c->context_nonconst_ptr2 = spb;
+  c->context.nonconst_ptr2 = spb;
   return NULL;
 }
 
@@ -187,7 +188,7 @@ static const char*  //
 iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
                                         const iconvg_paint* p) {
   sk_canvas_t* sc = (sk_canvas_t*)(c->context.nonconst_ptr1);
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
 
   iconvg_paint_type paint_type = iconvg_paint__type(p);
   switch (paint_type) {
@@ -287,43 +288,38 @@ iconvg_private_skia_canvas__end_drawing(iconvg_canvas* c,
         &sm);
   }
 
-  // Use the Skia shader.
+  // Use the Skia shader. Detach the path even if there's no shader, so that
+  // the path builder is empty for the next drawing.
+  sk_path_t* path = sk_pathbuilder_detach_path(spb);
   if (shader) {
-    sk_path_t* path = sk_pathbuilder_detach_path(spb);
     sk_paint_t* paint = sk_paint_new();
     sk_paint_set_antialias(paint, true);
     sk_paint_set_shader(paint, shader);
     sk_shader_unref(shader);
     sk_canvas_draw_path(sc, path, paint);
     sk_paint_delete(paint);
-    sk_path_delete(path);
-  }
-
-  // Clean up.
-  if (spb) {
-    sk_pathbuilder_delete(spb);
-    c->context_nonconst_ptr2 = NULL;
   }
+  sk_path_delete(path);
   return NULL;
 }
 
 static const char*  //
 iconvg_private_skia_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
   sk_pathbuilder_move_to(spb, x0, y0);
   return NULL;
 }
 
 static const char*  //
 iconvg_private_skia_canvas__end_path(iconvg_canvas* c) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
   sk_pathbuilder_close(spb);
   return NULL;
 }
 
 static const char*  //
 iconvg_private_skia_canvas__path_line_to(iconvg_canvas* c, float x1, float y1) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
   sk_pathbuilder_line_to(spb, x1, y1);
   return NULL;
 }
@@ -334,7 +330,7 @@ iconvg_private_skia_canvas__path_quad_to(iconvg_canvas* c,
                                          float y1,
                                          float x2,
                                          float y2) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
   sk_pathbuilder_quad_to(spb, x1, y1, x2, y2);
   return NULL;
 }
@@ -347,7 +343,7 @@ iconvg_private_skia_canvas__path_cube_to(iconvg_canvas* c,
                                          float y2,
                                          float x3,
                                          float y3) {
-  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context_nonconst_ptr2);
+  sk_pathbuilder_t* spb = (sk_pathbuilder_t*)(c->context.nonconst_ptr2);
   sk_pathbuilder_cubic_to(spb, x1, y1, x2, y2, x3, y3);
   return NULL;
 }
@@ -379,6 +375,10 @@ static const iconvg_canvas_vtable  //
         &iconvg_private_skia_canvas__path_cube_to,
         &iconvg_private_skia_canvas__on_metadata_viewbox,
         &iconvg_private_skia_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
 };
 
 iconvg_canvas  //
@@ -0,0 +1,699 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "./aaa_private.h"
+
+// Each trace record is ICONVG_TRACE__RECORD_SIZE (32) bytes:
+//  - byte 0 is the op, one of the ICONVG_PRIVATE_TRACE_OP__ETC values.
+//  - bytes 1, 2 and 3 are small op-specific fields.
+//  - bytes 4 .. 8 are the number of continuation records that immediately
+//    follow this one, as a little-endian uint32_t.
+//  - bytes 8 .. 32 are the payload: up to six little-endian float32 values
+//    (a rectangle or path coordinates) or three little-endian uint64_t values.
+//
+// Continuation records hold larger arguments (a paint or a palette), 24 bytes
+// per record, in their bytes 8 .. 32. Their other bytes are zero except for
+// byte 0, which is ICONVG_PRIVATE_TRACE_OP__CONTINUATION.
+//
+// For end_decode, byte 1 indexes iconvg_private_trace_errors, or is 0xFF for
+// other (non-NULL) error messages, and the payload holds num_bytes_consumed
+// and num_bytes_remaining.
+//
+// For end_drawing, bytes 1, 2 and 3 are the paint's type, gradient spread and
+// gradient number of stops. For flat colors, the payload's first four bytes
+// hold the (resolved) premultiplied color. For gradients, the payload holds
+// the src space gradient transform (six float32 values) and the continuation
+// records hold the four float64 d2s scale and bias values followed by the
+// stops' registers (each a uint64_t). If the paint is skewed (see
+// iconvg_decode_options.dst_transform), two float64 d2s skew values follow
+// the registers. Older traces don't have them, which replays as unskewed.
+
+#define ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE 0x01
+#define ICONVG_PRIVATE_TRACE_OP__END_DECODE 0x02
+#define ICONVG_PRIVATE_TRACE_OP__BEGIN_DRAWING 0x03
+#define ICONVG_PRIVATE_TRACE_OP__END_DRAWING 0x04
+#define ICONVG_PRIVATE_TRACE_OP__BEGIN_PATH 0x05
+#define ICONVG_PRIVATE_TRACE_OP__END_PATH 0x06
+#define ICONVG_PRIVATE_TRACE_OP__PATH_LINE_TO 0x07
+#define ICONVG_PRIVATE_TRACE_OP__PATH_QUAD_TO 0x08
+#define ICONVG_PRIVATE_TRACE_OP__PATH_CUBE_TO 0x09
+#define ICONVG_PRIVATE_TRACE_OP__ON_METADATA_VIEWBOX 0x0A
+#define ICONVG_PRIVATE_TRACE_OP__ON_METADATA_SUGGESTED_PALETTE 0x0B
+#define ICONVG_PRIVATE_TRACE_OP__CONTINUATION 0xFF
+
+#define ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE 24
+
+// ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE is the largest continuation payload: a
+// gradient's four float64 values, 64 registers and two more float64 values.
+#define ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE (32 + (64 * 8) + 16)
+
+#define ICONVG_PRIVATE_TRACE__MAX_NUM_CONTINUATIONS \
+  ((ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE +           \
+    (ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE - 1)) /     \
+   ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE)
+
+static const char* const iconvg_private_trace_errors[] = {
+    NULL,
+    iconvg_error_bad_coordinate,
+    iconvg_error_bad_jump,
+    iconvg_error_bad_magic_identifier,
+    iconvg_error_bad_metadata,
+    iconvg_error_bad_metadata_id_order,
+    iconvg_error_bad_metadata_suggested_palette,
+    iconvg_error_bad_metadata_viewbox,
+    iconvg_error_bad_number,
+    iconvg_error_bad_opcode_length,
+    iconvg_error_system_failure_out_of_memory,
+    iconvg_error_invalid_backend_not_enabled,
+    iconvg_error_invalid_constructor_argument,
+    iconvg_error_invalid_paint_type,
+    iconvg_error_invalid_vtable,
+    iconvg_error_invalid_trace,
+    // New errors are appended, so that existing traces' indexes stay valid.
+    iconvg_error_bad_segref,
+    iconvg_error_bad_pack,
+    iconvg_error_system_failure_could_not_read_file,
+    iconvg_error_bad_display_list_cache,
+    iconvg_error_invalid_encoder_call,
+};
+
+#define ICONVG_PRIVATE_TRACE__NUM_ERRORS \
+  (sizeof(iconvg_private_trace_errors) / sizeof(iconvg_private_trace_errors[0]))
+
+// ----
+
+static void  //
+iconvg_private_trace__write_record(iconvg_trace* t, const uint8_t* rec) {
+  if (t->ptr) {
+    size_t n = t->len / ICONVG_TRACE__RECORD_SIZE;
+    if (n > 0) {
+      memcpy(t->ptr + (ICONVG_TRACE__RECORD_SIZE * (t->num_records % n)), rec,
+             ICONVG_TRACE__RECORD_SIZE);
+    }
+  }
+  if (t->file) {
+    fwrite(rec, 1, ICONVG_TRACE__RECORD_SIZE, t->file);
+  }
+  t->num_records++;
+}
+
+// iconvg_private_trace__write writes a record whose first 8 bytes are set from
+// the op and a8, b8, c8 arguments, followed by the continuation records for
+// blob_ptr[.. blob_len]. The record's payload is rec[8 .. 32], set by the
+// caller.
+static void  //
+iconvg_private_trace__write(iconvg_trace* t,
+                            uint8_t* rec,
+                            uint8_t op,
+                            uint8_t a8,
+                            uint8_t b8,
+                            uint8_t c8,
+                            const uint8_t* blob_ptr,
+                            size_t blob_len) {
+  size_t num_continuations =
+      (blob_len + (ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE - 1)) /
+      ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE;
+  rec[0] = op;
+  rec[1] = a8;
+  rec[2] = b8;
+  rec[3] = c8;
+  iconvg_private_poke_u32le(rec + 4, (uint32_t)num_continuations);
+  iconvg_private_trace__write_record(t, rec);
+
+  while (blob_len > 0) {
+    size_t n = (blob_len < ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE)
+                   ? blob_len
+                   : ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE;
+    uint8_t cont[ICONVG_TRACE__RECORD_SIZE] = {0};
+    cont[0] = ICONVG_PRIVATE_TRACE_OP__CONTINUATION;
+    memcpy(cont + 8, blob_ptr, n);
+    iconvg_private_trace__write_record(t, cont);
+    blob_ptr += n;
+    blob_len -= n;
+  }
+}
+
+static inline void  //
+iconvg_private_trace__poke_f32s(uint8_t* rec, const float* f, int n) {
+  for (int i = 0; i < n; i++) {
+    iconvg_private_poke_u32le(rec + 8 + (4 * i),
+                              iconvg_private_reinterpret_from_f32_to_u32(f[i]));
+  }
+}
+
+// ----
+
+static const char*  //
+iconvg_private_trace_canvas__begin_decode(iconvg_canvas* c,
+                                          iconvg_rectangle_f32 dst_rect) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[4] = {dst_rect.min_x, dst_rect.min_y, dst_rect.max_x,
+                  dst_rect.max_y};
+    iconvg_private_trace__poke_f32s(rec, f, 4);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_decode)(wrapped, dst_rect);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__end_decode(iconvg_canvas* c,
+                                        const char* err_msg,
+                                        size_t num_bytes_consumed,
+                                        size_t num_bytes_remaining) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t e = 0xFF;
+    for (size_t i = 0; i < ICONVG_PRIVATE_TRACE__NUM_ERRORS; i++) {
+      if (err_msg == iconvg_private_trace_errors[i]) {
+        e = (uint8_t)i;
+        break;
+      }
+    }
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_poke_u64le(rec + 8, num_bytes_consumed);
+    iconvg_private_poke_u64le(rec + 16, num_bytes_remaining);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__END_DECODE, e,
+                                0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return err_msg;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_decode)(wrapped, err_msg, num_bytes_consumed,
+                                        num_bytes_remaining);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__begin_drawing(iconvg_canvas* c) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__BEGIN_DRAWING,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_drawing)(wrapped);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__end_drawing(iconvg_canvas* c,
+                                         const iconvg_paint* p) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    uint8_t blob[ICONVG_PRIVATE_TRACE__MAX_BLOB_SIZE];
+    size_t blob_len = 0;
+    iconvg_paint_type paint_type = iconvg_paint__type(p);
+    uint8_t spread = 0;
+    uint8_t num_stops = 0;
+    switch (paint_type) {
+      case ICONVG_PAINT_TYPE__FLAT_COLOR: {
+        iconvg_premul_color k = iconvg_paint__flat_color_as_premul_color(p);
+        memcpy(rec + 8, &k.rgba[0], 4);
+        break;
+      }
+      case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+      case ICONVG_PAINT_TYPE__RADIAL_GRADIENT: {
+        spread = p->spread;
+        num_stops = p->num_stops;
+        iconvg_private_trace__poke_f32s(rec, p->transform, 6);
+        double d2s[4] = {p->d2s_scale_x, p->d2s_bias_x, p->d2s_scale_y,
+                         p->d2s_bias_y};
+        for (int i = 0; i < 4; i++) {
+          iconvg_private_poke_u64le(
+              blob + blob_len,
+              iconvg_private_reinterpret_from_f64_to_u64(d2s[i]));
+          blob_len += 8;
+        }
+        for (uint32_t i = 0; i < num_stops; i++) {
+          iconvg_private_poke_u64le(blob + blob_len,
+                                    p->regs[(p->which_regs + i) & 63]);
+          blob_len += 8;
+        }
+        if (p->skewed) {
+          double skews[2] = {p->d2s_skew_x, p->d2s_skew_y};
+          for (int i = 0; i < 2; i++) {
+            iconvg_private_poke_u64le(
+                blob + blob_len,
+                iconvg_private_reinterpret_from_f64_to_u64(skews[i]));
+            blob_len += 8;
+          }
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__END_DRAWING,
+                                (uint8_t)paint_type, spread, num_stops, blob,
+                                blob_len);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_drawing)(wrapped, p);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__begin_path(iconvg_canvas* c, float x0, float y0) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[2] = {x0, y0};
+    iconvg_private_trace__poke_f32s(rec, f, 2);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__BEGIN_PATH, 0,
+                                0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->begin_path)(wrapped, x0, y0);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__end_path(iconvg_canvas* c) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__END_PATH, 0, 0,
+                                0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->end_path)(wrapped);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__path_line_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[2] = {x1, y1};
+    iconvg_private_trace__poke_f32s(rec, f, 2);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__PATH_LINE_TO,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_line_to)(wrapped, x1, y1);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__path_quad_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[4] = {x1, y1, x2, y2};
+    iconvg_private_trace__poke_f32s(rec, f, 4);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__PATH_QUAD_TO,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_quad_to)(wrapped, x1, y1, x2, y2);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__path_cube_to(iconvg_canvas* c,
+                                          float x1,
+                                          float y1,
+                                          float x2,
+                                          float y2,
+                                          float x3,
+                                          float y3) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[6] = {x1, y1, x2, y2, x3, y3};
+    iconvg_private_trace__poke_f32s(rec, f, 6);
+    iconvg_private_trace__write(t, rec, ICONVG_PRIVATE_TRACE_OP__PATH_CUBE_TO,
+                                0, 0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->path_cube_to)(wrapped, x1, y1, x2, y2, x3, y3);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__on_metadata_viewbox(iconvg_canvas* c,
+                                                 iconvg_rectangle_f32 viewbox) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    float f[4] = {viewbox.min_x, viewbox.min_y, viewbox.max_x, viewbox.max_y};
+    iconvg_private_trace__poke_f32s(rec, f, 4);
+    iconvg_private_trace__write(t, rec,
+                                ICONVG_PRIVATE_TRACE_OP__ON_METADATA_VIEWBOX, 0,
+                                0, 0, NULL, 0);
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_viewbox)(wrapped, viewbox);
+}
+
+static const char*  //
+iconvg_private_trace_canvas__on_metadata_suggested_palette(
+    iconvg_canvas* c,
+    const iconvg_palette* suggested_palette) {
+  iconvg_trace* t = (iconvg_trace*)(c->context.nonconst_ptr2);
+  if (t) {
+    uint8_t rec[ICONVG_TRACE__RECORD_SIZE] = {0};
+    iconvg_private_trace__write(
+        t, rec, ICONVG_PRIVATE_TRACE_OP__ON_METADATA_SUGGESTED_PALETTE, 0, 0, 0,
+        &suggested_palette->colors[0].rgba[0], sizeof(iconvg_palette));
+  }
+  iconvg_canvas* wrapped = (iconvg_canvas*)(c->context.nonconst_ptr1);
+  if (!wrapped) {
+    return NULL;
+  } else if (iconvg_private_canvas_sizeof_vtable(wrapped) <
+             sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  }
+  return (*wrapped->vtable->on_metadata_suggested_palette)(wrapped,
+                                                           suggested_palette);
+}
+
+static const iconvg_canvas_vtable  //
+    iconvg_private_trace_canvas_vtable = {
+        sizeof(iconvg_canvas_vtable),
+        &iconvg_private_trace_canvas__begin_decode,
+        &iconvg_private_trace_canvas__end_decode,
+        &iconvg_private_trace_canvas__begin_drawing,
+        &iconvg_private_trace_canvas__end_drawing,
+        &iconvg_private_trace_canvas__begin_path,
+        &iconvg_private_trace_canvas__end_path,
+        &iconvg_private_trace_canvas__path_line_to,
+        &iconvg_private_trace_canvas__path_quad_to,
+        &iconvg_private_trace_canvas__path_cube_to,
+        &iconvg_private_trace_canvas__on_metadata_viewbox,
+        &iconvg_private_trace_canvas__on_metadata_suggested_palette,
+        NULL,  // begin_path__fixed
+        NULL,  // path_line_to__fixed
+        NULL,  // path_quad_to__fixed
+        NULL,  // path_cube_to__fixed
+};
+
+iconvg_canvas  //
+iconvg_canvas__make_trace(iconvg_canvas* wrapped, iconvg_trace* trace) {
+  if (wrapped && !wrapped->vtable) {
+    wrapped = NULL;
+  }
+  iconvg_canvas c;
+  c.vtable = &iconvg_private_trace_canvas_vtable;
+  memset(&c.context, 0, sizeof(c.context));
+  c.context.nonconst_ptr1 = wrapped;
+  c.context.nonconst_ptr2 = trace;
+  return c;
+}
+
+// ----
+
+static inline float  //
+iconvg_private_trace__peek_f32(const uint8_t* rec, int i) {
+  return iconvg_private_reinterpret_from_u32_to_f32(
+      iconvg_private_peek_u32le(rec + 8 + (4 * i)));
+}
+
+static inline iconvg_rectangle_f32  //
+iconvg_private_trace__peek_rectangle(const uint8_t* rec) {
+  return iconvg_rectangle_f32__make(iconvg_private_trace__peek_f32(rec, 0),
+                                    iconvg_private_trace__peek_f32(rec, 1),
+                                    iconvg_private_trace__peek_f32(rec, 2),
+                                    iconvg_private_trace__peek_f32(rec, 3));
+}
+
+// iconvg_private_trace__replay_paint reconstructs, in *p, a paint whose
+// iconvg_paint__etc accessors return what the recorded paint's did.
+static const char*  //
+iconvg_private_trace__replay_paint(iconvg_paint* p,
+                                   const uint8_t* rec,
+                                   const uint8_t* blob,
+                                   size_t blob_len) {
+  memset(p, 0, sizeof(*p));
+  p->paint_type = rec[1];
+  switch (p->paint_type) {
+    case ICONVG_PAINT_TYPE__INVALID:
+      return NULL;
+    case ICONVG_PAINT_TYPE__FLAT_COLOR:
+      // A valid premultiplied color resolves to itself.
+      p->regs[0] = ((uint64_t)(iconvg_private_peek_u32le(rec + 8))) << 32;
+      return NULL;
+    case ICONVG_PAINT_TYPE__LINEAR_GRADIENT:
+    case ICONVG_PAINT_TYPE__RADIAL_GRADIENT:
+      break;
+    default:
+      return iconvg_error_invalid_trace;
+  }
+
+  p->spread = rec[2];
+  p->num_stops = rec[3];
+  if ((p->num_stops > 64) || (blob_len < (32 + (8 * (size_t)p->num_stops)))) {
+    return iconvg_error_invalid_trace;
+  }
+  for (int i = 0; i < 6; i++) {
+    p->transform[i] = iconvg_private_trace__peek_f32(rec, i);
+  }
+  p->d2s_scale_x =
+      iconvg_private_reinterpret_from_u64_to_f64(iconvg_private_peek_u64le(blob));
+  p->d2s_bias_x = iconvg_private_reinterpret_from_u64_to_f64(
+      iconvg_private_peek_u64le(blob + 8));
+  p->d2s_scale_y = iconvg_private_reinterpret_from_u64_to_f64(
+      iconvg_private_peek_u64le(blob + 16));
+  p->d2s_bias_y = iconvg_private_reinterpret_from_u64_to_f64(
+      iconvg_private_peek_u64le(blob + 24));
+  for (uint32_t i = 0; i < p->num_stops; i++) {
+    p->regs[i] = iconvg_private_peek_u64le(blob + 32 + (8 * i));
+  }
+  size_t skews_offset = 32 + (8 * (size_t)p->num_stops);
+  if (blob_len >= (skews_offset + 16)) {
+    p->d2s_skew_x = iconvg_private_reinterpret_from_u64_to_f64(
+        iconvg_private_peek_u64le(blob + skews_offset));
+    p->d2s_skew_y = iconvg_private_reinterpret_from_u64_to_f64(
+        iconvg_private_peek_u64le(blob + skews_offset + 8));
+    p->skewed = (p->d2s_skew_x != 0) || (p->d2s_skew_y != 0);
+  }
+  return NULL;
+}
+
+const char*  //
+iconvg_trace__replay(const iconvg_trace* self, iconvg_canvas* c) {
+  iconvg_canvas fallback_canvas = iconvg_canvas__make_broken(NULL);
+  if (!c || !c->vtable) {
+    c = &fallback_canvas;
+  }
+  if (c->vtable->sizeof__iconvg_canvas_vtable != sizeof(iconvg_canvas_vtable)) {
+    return iconvg_error_invalid_vtable;
+  } else if (!self || !self->ptr) {
+    return NULL;
+  }
+  uint64_t n = self->len / ICONVG_TRACE__RECORD_SIZE;
+  if (n == 0) {
+    return NULL;
+  }
+  uint64_t i = 0;
+  uint64_t end = self->num_records;
+  bool skipping = false;
+  if (end > n) {
+    i = end - n;
+    skipping = true;
+  }
+
+  const char* ret = NULL;
+  const char* err_msg = NULL;
+  iconvg_palette palette;
+  iconvg_paint paint;
+  uint8_t blob[ICONVG_PRIVATE_TRACE__MAX_NUM_CONTINUATIONS *
+               ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE];
+  while (i < end) {
+    const uint8_t* rec =
+        self->ptr + (ICONVG_TRACE__RECORD_SIZE * (size_t)(i % n));
+    i++;
+    uint8_t op = rec[0];
+    if (skipping) {
+      if (op != ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE) {
+        continue;
+      }
+      skipping = false;
+    }
+
+    uint64_t num_continuations = iconvg_private_peek_u32le(rec + 4);
+    if ((op == ICONVG_PRIVATE_TRACE_OP__CONTINUATION) ||
+        (num_continuations > (end - i)) ||
+        (num_continuations > ICONVG_PRIVATE_TRACE__MAX_NUM_CONTINUATIONS)) {
+      return iconvg_error_invalid_trace;
+    }
+    size_t blob_len = 0;
+    for (; num_continuations > 0; num_continuations--) {
+      const uint8_t* cont =
+          self->ptr + (ICONVG_TRACE__RECORD_SIZE * (size_t)(i % n));
+      i++;
+      if (cont[0] != ICONVG_PRIVATE_TRACE_OP__CONTINUATION) {
+        return iconvg_error_invalid_trace;
+      }
+      memcpy(blob + blob_len, cont + 8, ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE);
+      blob_len += ICONVG_PRIVATE_TRACE__PAYLOAD_SIZE;
+    }
+
+    // Like iconvg_decode, once a canvas method fails, skip ahead to
+    // end_decode.
+    if (err_msg && (op != ICONVG_PRIVATE_TRACE_OP__END_DECODE)) {
+      continue;
+    }
+
+    switch (op) {
+      case ICONVG_PRIVATE_TRACE_OP__BEGIN_DECODE:
+        err_msg = (*c->vtable->begin_decode)(
+            c, iconvg_private_trace__peek_rectangle(rec));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__END_DECODE: {
+        if (!err_msg) {
+          err_msg = (rec[1] < ICONVG_PRIVATE_TRACE__NUM_ERRORS)
+                        ? iconvg_private_trace_errors[rec[1]]
+                        : iconvg_error_invalid_trace;
+        }
+        const char* z = (*c->vtable->end_decode)(
+            c, err_msg, (size_t)iconvg_private_peek_u64le(rec + 8),
+            (size_t)iconvg_private_peek_u64le(rec + 16));
+        if (!ret) {
+          ret = z;
+        }
+        err_msg = NULL;
+        break;
+      }
+
+      case ICONVG_PRIVATE_TRACE_OP__BEGIN_DRAWING:
+        err_msg = (*c->vtable->begin_drawing)(c);
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__END_DRAWING:
+        err_msg =
+            iconvg_private_trace__replay_paint(&paint, rec, blob, blob_len);
+        if (err_msg) {
+          return err_msg;
+        }
+        err_msg = (*c->vtable->end_drawing)(c, &paint);
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__BEGIN_PATH:
+        err_msg = (*c->vtable->begin_path)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__END_PATH:
+        err_msg = (*c->vtable->end_path)(c);
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__PATH_LINE_TO:
+        err_msg = (*c->vtable->path_line_to)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__PATH_QUAD_TO:
+        err_msg = (*c->vtable->path_quad_to)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1),
+            iconvg_private_trace__peek_f32(rec, 2),
+            iconvg_private_trace__peek_f32(rec, 3));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__PATH_CUBE_TO:
+        err_msg = (*c->vtable->path_cube_to)(
+            c, iconvg_private_trace__peek_f32(rec, 0),
+            iconvg_private_trace__peek_f32(rec, 1),
+            iconvg_private_trace__peek_f32(rec, 2),
+            iconvg_private_trace__peek_f32(rec, 3),
+            iconvg_private_trace__peek_f32(rec, 4),
+            iconvg_private_trace__peek_f32(rec, 5));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__ON_METADATA_VIEWBOX:
+        err_msg = (*c->vtable->on_metadata_viewbox)(
+            c, iconvg_private_trace__peek_rectangle(rec));
+        break;
+
+      case ICONVG_PRIVATE_TRACE_OP__ON_METADATA_SUGGESTED_PALETTE:
+        if (blob_len < sizeof(palette)) {
+          return iconvg_error_invalid_trace;
+        }
+        memcpy(&palette, blob, sizeof(palette));
+        err_msg = (*c->vtable->on_metadata_suggested_palette)(c, &palette);
+        break;
+
+      default:
+        return iconvg_error_invalid_trace;
+    }
+  }
+  return ret;
+}
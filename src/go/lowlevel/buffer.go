@@ -103,12 +103,13 @@ func (b *buffer) encodeCoordinate(f float32) {
 		u := math.Float32bits(f)
 
 		// Round the fractional bits (the low 23 bits) to the nearest multiple
-		// of 4, being careful not to overflow into the upper bits.
+		// of 4, being careful not to overflow into the upper bits. The low 2
+		// bits must end up zero, as they mark this as a 4-byte encoding.
 		v := u & 0x007fffff
 		if v < 0x007ffffe {
 			v += 2
 		}
-		u = (u & 0xff800000) | v
+		u = (u & 0xff800000) | (v &^ 3)
 
 		*b = append(*b, uint8(u), uint8(u>>8), uint8(u>>16), uint8(u>>24))
 	}
@@ -48,9 +48,35 @@ type Destination interface {
 }
 
 // printer prints debug information (the disassembly) during the decode. b
-// holds the byte code of a single IconVG operation. format and args contain
-// human-readable commentary in fmt.Printf style.
-type printer func(b []byte, format string, args ...interface{})
+// holds the byte code of a single IconVG operation. k says what b holds, for
+// printers (such as Stats.observe) that classify rather than print. format
+// and args contain human-readable commentary in fmt.Printf style.
+type printer func(b []byte, k printKind, format string, args ...interface{})
+
+// printKind is what a printer's b argument holds.
+type printKind uint8
+
+const (
+	// printKindOther is anything not listed below, such as the magic
+	// identifier, colors or register values.
+	printKindOther printKind = iota
+	// printKindOpcode is an opcode byte, possibly followed by a second byte
+	// that is part of the same instruction (e.g. a gradient's spread and
+	// number of stops).
+	printKindOpcode
+	// printKindNatural is a natural number (see buffer.decodeNatural), other
+	// than the one given by printKindReps.
+	printKindNatural
+	// printKindReps is the natural number that, plus 16, is a LineTo, QuadTo
+	// or CubeTo op's repetition count.
+	printKindReps
+	// printKindCoordinate is a coordinate number (see
+	// buffer.decodeCoordinate).
+	printKindCoordinate
+	// printKindFloat32 is a float32 number (see buffer.decodeFloat32) that
+	// is not a coordinate, such as a gradient fill's transform.
+	printKindFloat32
+)
 
 // DecodeOptions are the optional parameters to the Decode function.
 type DecodeOptions struct {
@@ -81,7 +107,7 @@ func decode(dst Destination, p printer, m *Metadata, metadataOnly bool, src buff
 		return errInvalidMagicIdentifier
 	}
 	if p != nil {
-		p(src[:len(magic)], "IconVG Magic Identifier\n")
+		p(src[:len(magic)], printKindOther, "IconVG Magic Identifier\n")
 	}
 	src = src[len(magic):]
 
@@ -90,12 +116,14 @@ func decode(dst Destination, p printer, m *Metadata, metadataOnly bool, src buff
 		return errInvalidNumberOfMetadataChunks
 	}
 	if p != nil {
-		p(src[:n], "Number of metadata chunks: %d\n", nMetadataChunks)
+		p(src[:n], printKindNatural, "Number of metadata chunks: %d\n", nMetadataChunks)
 	}
 	src = src[n:]
 
 	if m == nil {
-		m = &Metadata{}
+		// Like DecodeMetadata, start with the default values, for any
+		// metadata chunks that src leaves out.
+		m = &Metadata{ViewBox: DefaultViewBox, Palette: DefaultPalette}
 	}
 	for ; nMetadataChunks > 0; nMetadataChunks-- {
 		if src, retErr = decodeMetadataChunk(p, m, src, opts); retErr != nil {
@@ -117,7 +145,7 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 		return nil, errInvalidMetadataChunkLength
 	}
 	if p != nil {
-		p(src[:n], "Metadata chunk length: %d\n", length)
+		p(src[:n], printKindNatural, "Metadata chunk length: %d\n", length)
 	}
 	src = src[n:]
 	lenSrcWant := int64(len(src)) - int64(length)
@@ -130,7 +158,7 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 		return nil, errUnsupportedMetadataIdentifier
 	}
 	if p != nil {
-		p(src[:n], "Metadata Identifier: %d (%s)\n", mid, midDescriptions[mid])
+		p(src[:n], printKindNatural, "Metadata Identifier: %d (%s)\n", mid, midDescriptions[mid])
 	}
 	src = src[n:]
 
@@ -156,7 +184,7 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 		}
 		length := 1 + int(src[0]&0x3f)
 		if p != nil {
-			p(src[:1], "      %d palette colors\n", length)
+			p(src[:1], printKindOther, "      %d palette colors\n", length)
 		}
 		src = src[1:]
 
@@ -174,7 +202,7 @@ func decodeMetadataChunk(p printer, m *Metadata, src buffer, opts *DecodeOptions
 				c = color.RGBA{0x00, 0x00, 0x00, 0xff}
 			}
 			if p != nil {
-				p(src[:4], "      rgba(%02X:%02X:%02X:%02X)\n", c.R, c.G, c.B, c.A)
+				p(src[:4], printKindOther, "      rgba(%02X:%02X:%02X:%02X)\n", c.R, c.G, c.B, c.A)
 			}
 			src = src[4:]
 			if opts == nil || opts.Palette == nil {
@@ -218,7 +246,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 			} else if opcode < 0x34 {
 				nQuarters := 1 + uint32(opcode&3)
 				if p != nil {
-					p(src[:1], "#%04d Ellipse (%d quarters)\n", pc, nQuarters)
+					p(src[:1], printKindOpcode, "#%04d Ellipse (%d quarters)\n", pc, nQuarters)
 					pc++
 				}
 				src = src[1:]
@@ -233,7 +261,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 				switch opcode & 0x0F {
 				case 0x04:
 					if p != nil {
-						p(src[:1], "#%04d Parallelogram\n", pc)
+						p(src[:1], printKindOpcode, "#%04d Parallelogram\n", pc)
 						pc++
 					}
 					src = src[1:]
@@ -246,7 +274,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 
 				case 0x05:
 					if p != nil {
-						p(src[:1], "#%04d ClosePath; MoveTo\n", pc)
+						p(src[:1], printKindOpcode, "#%04d ClosePath; MoveTo\n", pc)
 						pc++
 					}
 					src = src[1:]
@@ -263,7 +291,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 					}
 					delta := src[1] & 63
 					if p != nil {
-						p(src[:2], "#%04d SEL += %d\n", pc, delta)
+						p(src[:2], printKindOpcode, "#%04d SEL += %d\n", pc, delta)
 						pc++
 					}
 					src = src[2:]
@@ -273,14 +301,14 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 
 				case 0x07:
 					if p != nil {
-						p(src[:1], "#%04d NOP\n", pc)
+						p(src[:1], printKindOpcode, "#%04d NOP\n", pc)
 						pc++
 					}
 					src = src[1:]
 
 				case 0x08:
 					if p != nil {
-						p(src[:1], "#%04d Jump Unconditional\n", pc)
+						p(src[:1], printKindOpcode, "#%04d Jump Unconditional\n", pc)
 						pc++
 					}
 					src = src[1:]
@@ -289,7 +317,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 						return errInvalidNumber
 					}
 					if p != nil {
-						p(src[:n], "      Target: #%04d (PC+%d)\n", pc+jumpDist, jumpDist)
+						p(src[:n], printKindNatural, "      Target: #%04d (PC+%d)\n", pc+jumpDist, jumpDist)
 					}
 					src = src[n:]
 					if dst != nil {
@@ -299,7 +327,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 
 				case 0x09:
 					if p != nil {
-						p(src[:1], "#%04d Jump Feature-Bits\n", pc)
+						p(src[:1], printKindOpcode, "#%04d Jump Feature-Bits\n", pc)
 						pc++
 					}
 					src = src[1:]
@@ -308,7 +336,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 						return errInvalidNumber
 					}
 					if p != nil {
-						p(src[:n], "      Target: #%04d (PC+%d)\n", pc+jumpDist, jumpDist)
+						p(src[:n], printKindNatural, "      Target: #%04d (PC+%d)\n", pc+jumpDist, jumpDist)
 					}
 					src = src[n:]
 					fBits, n := src.decodeNatural()
@@ -316,7 +344,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 						return errInvalidNumber
 					}
 					if p != nil {
-						p(src[:n], "      FeatureBits: 0x%08X\n", fBits)
+						p(src[:n], printKindNatural, "      FeatureBits: 0x%08X\n", fBits)
 					}
 					src = src[n:]
 					// This decoder doesn't support any feature bits.
@@ -327,7 +355,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 
 				case 0x0A:
 					if p != nil {
-						p(src[:1], "#%04d Jump Level-of-Detail\n", pc)
+						p(src[:1], printKindOpcode, "#%04d Jump Level-of-Detail\n", pc)
 						pc++
 					}
 					src = src[1:]
@@ -336,7 +364,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 						return errInvalidNumber
 					}
 					if p != nil {
-						p(src[:n], "      Target: #%04d (PC+%d)\n", pc+jumpDist, jumpDist)
+						p(src[:n], printKindNatural, "      Target: #%04d (PC+%d)\n", pc+jumpDist, jumpDist)
 					}
 					src = src[n:]
 					lod := [2]float32{}
@@ -350,7 +378,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 
 				case 0x0B:
 					if p != nil {
-						p(src[:1], "#%04d RET\n", pc)
+						p(src[:1], printKindOpcode, "#%04d RET\n", pc)
 						pc++
 					}
 					src = src[1:]
@@ -358,8 +386,25 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 						return nil
 					}
 
+				case 0x0C, 0x0D:
+					if p != nil {
+						if opcode == 0x3C {
+							p(src[:1], printKindOpcode, "#%04d Call Untransformed\n", pc)
+						} else {
+							p(src[:1], printKindOpcode, "#%04d Call Transformed\n", pc)
+						}
+						pc++
+					}
+					src = src[1:]
+					if src, retErr = decodeCall(p, opcode, src); retErr != nil {
+						return retErr
+					}
+
 				default:
-					return fmt.Errorf("iconvg: TODO: call opcodes")
+					if src, retErr = decodeReservedOpcodes(dst, p, src); retErr != nil {
+						return retErr
+					}
+					pc++
 				}
 			}
 
@@ -371,7 +416,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 			switch (opcode >> 4) & 3 {
 			case 0:
 				if p != nil {
-					p(src[:1], "#%04d Set REGS[SEL+%d].lo32%s\n", pc, adj, decr)
+					p(src[:1], printKindOpcode, "#%04d Set REGS[SEL+%d].lo32%s\n", pc, adj, decr)
 					pc++
 				}
 				src = src[1:]
@@ -380,7 +425,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 				}
 			case 1:
 				if p != nil {
-					p(src[:1], "#%04d Set REGS[SEL+%d].hi32%s\n", pc, adj, decr)
+					p(src[:1], printKindOpcode, "#%04d Set REGS[SEL+%d].hi32%s\n", pc, adj, decr)
 					pc++
 				}
 				src = src[1:]
@@ -389,7 +434,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 				}
 			case 2:
 				if p != nil {
-					p(src[:1], "#%04d Set REGS[SEL+%d]%s\n", pc, adj, decr)
+					p(src[:1], printKindOpcode, "#%04d Set REGS[SEL+%d]%s\n", pc, adj, decr)
 					pc++
 				}
 				src = src[1:]
@@ -401,7 +446,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 				}
 			case 3:
 				if p != nil {
-					p(src[:1], "#%04d SEL -= %d; Set REGS[SEL+1 .. SEL+%d]\n", pc, adj+2, adj+3)
+					p(src[:1], printKindOpcode, "#%04d SEL -= %d; Set REGS[SEL+1 .. SEL+%d]\n", pc, adj+2, adj+3)
 					pc++
 				}
 				src = src[1:]
@@ -424,7 +469,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 			switch o := (opcode >> 4) & 3; o {
 			case 0:
 				if p != nil {
-					p(src[:1], "#%04d ClosePath; %sFill (flat color) with REGS[SEL+%d]\n", pc, incr, adj)
+					p(src[:1], printKindOpcode, "#%04d ClosePath; %sFill (flat color) with REGS[SEL+%d]\n", pc, incr, adj)
 					pc++
 				}
 				src = src[1:]
@@ -441,7 +486,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 					grad = "radial"
 				}
 				if p != nil {
-					p(src[:2], "#%04d ClosePath; %sFill (%s gradient; %s) with REGS[SEL+%d .. SEL+%d]\n",
+					p(src[:2], printKindOpcode, "#%04d ClosePath; %sFill (%s gradient; %s) with REGS[SEL+%d .. SEL+%d]\n",
 						pc, incr, grad, gradientSpreadNames[src[1]>>6], adj, adj+2+(src[1]&63))
 					pc++
 				}
@@ -452,7 +497,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 						return errInvalidNumber
 					}
 					if p != nil {
-						p(src[:n], "      %+g\n", f)
+						p(src[:n], printKindFloat32, "      %+g\n", f)
 					}
 					args[i] = f
 					src = src[n:]
@@ -463,7 +508,7 @@ func decodeBytecode(dst Destination, p printer, src buffer) (retErr error) {
 
 			case 3:
 				if p != nil {
-					p(src[:1], "#%04d ClosePath; %sFill (reserved) with REGS[SEL+%d]\n", pc, incr, adj)
+					p(src[:1], printKindOpcode, "#%04d ClosePath; %sFill (reserved) with REGS[SEL+%d]\n", pc, incr, adj)
 					pc++
 				}
 				src = src[1:]
@@ -516,12 +561,12 @@ func decodeLineQuadCubeTo(dst Destination, p printer, src buffer, pc uint32, opc
 	nReps := uint32(opcode & 0x0f)
 	if nReps > 0 {
 		if p != nil {
-			p(src[:1], "#%04d %s (%d reps)\n", pc, op, nReps)
+			p(src[:1], printKindOpcode, "#%04d %s (%d reps)\n", pc, op, nReps)
 		}
 		src = src[1:]
 	} else {
 		if p != nil {
-			p(src[:1], "#%04d %s...\n", pc, op)
+			p(src[:1], printKindOpcode, "#%04d %s...\n", pc, op)
 		}
 		src = src[1:]
 		n := 0
@@ -531,14 +576,14 @@ func decodeLineQuadCubeTo(dst Destination, p printer, src buffer, pc uint32, opc
 		}
 		nReps += 16
 		if p != nil {
-			p(src[:n], "      ...(%d reps)\n", nReps)
+			p(src[:n], printKindReps, "      ...(%d reps)\n", nReps)
 		}
 		src = src[n:]
 	}
 
 	for i := uint32(0); i < nReps; i++ {
 		if p != nil && i != 0 {
-			p(nil, "      (rep)\n")
+			p(nil, printKindOther, "      (rep)\n")
 		}
 		err := error(nil)
 		src, err = decodeCoordinates(coords[6-nCoords:6], p, src)
@@ -567,7 +612,7 @@ func decodeCoordinates(coords []float32, p printer, src buffer) (src1 buffer, re
 			return nil, errInvalidNumber
 		}
 		if p != nil {
-			p(src[:n], "      %+g\n", x)
+			p(src[:n], printKindCoordinate, "      %+g\n", x)
 		}
 		src = src[n:]
 		coords[i] = x
@@ -580,7 +625,7 @@ func decodeSetRegLo32(dst Destination, p printer, src buffer) (buffer, error) {
 		return nil, errInvalidNumber
 	}
 	if p != nil {
-		p(src[:4], "      lo32 = 0x%02X%02X_%02X%02X\n",
+		p(src[:4], printKindOther, "      lo32 = 0x%02X%02X_%02X%02X\n",
 			src[3], src[2], src[1], src[0])
 	}
 	if dst != nil {
@@ -599,14 +644,14 @@ func decodeSetRegHi32(dst Destination, p printer, src buffer) (buffer, error) {
 	ca := src[3]
 	if p != nil {
 		if (cr <= ca) && (cg <= ca) && (cb <= ca) {
-			p(src[:4], "      hi32 = rgba(%02X:%02X:%02X:%02X)\n", cr, cg, cb, ca)
+			p(src[:4], printKindOther, "      hi32 = rgba(%02X:%02X:%02X:%02X)\n", cr, cg, cb, ca)
 		} else {
 			if (src[0] == 0x00) || (src[1] == src[2]) {
-				p(src[:4], "      hi32 = %s\n", oneByteColorString(src[1]))
+				p(src[:4], printKindOther, "      hi32 = %s\n", oneByteColorString(src[1]))
 			} else if src[0] == 0xFF {
-				p(src[:4], "      hi32 = %s\n", oneByteColorString(src[2]))
+				p(src[:4], printKindOther, "      hi32 = %s\n", oneByteColorString(src[2]))
 			} else {
-				p(src[:4], "      hi32 = blend(0x%02X * %s, 0x%02X * %s)\n",
+				p(src[:4], printKindOther, "      hi32 = blend(0x%02X * %s, 0x%02X * %s)\n",
 					0xFF-src[0], oneByteColorString(src[1]),
 					0x00+src[0], oneByteColorString(src[2]))
 			}
@@ -618,13 +663,72 @@ func decodeSetRegHi32(dst Destination, p printer, src buffer) (buffer, error) {
 	return src[4:], nil
 }
 
+// decodeCall decodes a Call op's arguments (after the opcode): for Call
+// Transformed, an alpha byte and six coordinates, and then an 8-byte SegRef.
+// An Inline SegRef's segment contents immediately follow it and are part of
+// the op, so that jumps skip over them too.
+//
+// TODO: execute the callee bytecode. For now, Call ops are skipped.
+func decodeCall(p printer, opcode byte, src buffer) (src1 buffer, retErr error) {
+	if opcode == 0x3D {
+		if len(src) < 1 {
+			return nil, errInvalidOpcodeLength
+		}
+		if p != nil {
+			p(src[:1], printKindOther, "      Alpha: 0x%02X\n", src[0])
+		}
+		src = src[1:]
+		matrix := [6]float32{}
+		if src, retErr = decodeCoordinates(matrix[:], p, src); retErr != nil {
+			return nil, retErr
+		}
+	}
+
+	if len(src) < 8 {
+		return nil, errInvalidOpcodeLength
+	}
+	segRef := uint64(0)
+	for i := 7; i >= 0; i-- {
+		segRef = (segRef << 8) | uint64(src[i])
+	}
+	if (segRef >> 32) != 0 {
+		if p != nil {
+			p(src[:4], printKindOther, "      Absolute SegRef\n")
+			p(src[4:8], printKindOther, "      ...\n")
+		}
+		return src[8:], nil
+	}
+
+	segType, segLen := uint8(segRef), uint32(segRef>>8)
+	if p != nil {
+		p(src[:4], printKindOther, "      Inline SegRef: type 0x%02X, length %d\n", segType, segLen)
+		p(src[4:8], printKindOther, "      ...\n")
+	}
+	src = src[8:]
+	if segType != 0 {
+		return nil, errInvalidSegRef
+	} else if uint64(len(src)) < uint64(segLen) {
+		return nil, errInvalidOpcodeLength
+	}
+	contents, src := src[:segLen], src[segLen:]
+	if p != nil {
+		for ; len(contents) > 4; contents = contents[4:] {
+			p(contents[:4], printKindOther, "      (segment contents)\n")
+		}
+		if len(contents) > 0 {
+			p(contents, printKindOther, "      (segment contents)\n")
+		}
+	}
+	return src, nil
+}
+
 func decodeReservedOpcodes(dst Destination, p printer, src buffer) (src1 buffer, retErr error) {
-	lineTo, fallback := src[0] < 0xE0, "NOP"
+	lineTo, fallback := (0xC0 <= src[0]) && (src[0] < 0xE0), "NOP"
 	if lineTo {
 		fallback = "LineTo"
 	}
 	if p != nil {
-		p(src[:1], "Reserved (%s)\n", fallback)
+		p(src[:1], printKindOpcode, "Reserved (%s)\n", fallback)
 	}
 	src = src[1:]
 
@@ -651,7 +755,7 @@ func decodeExtraData(dst Destination, p printer, src buffer) (src1 buffer, retEr
 		return nil, errInvalidNumber
 	}
 	if p != nil {
-		p(src[:n], "      Extra data length: %d\n", length)
+		p(src[:n], printKindNatural, "      Extra data length: %d\n", length)
 	}
 	src = src[n:]
 
@@ -661,10 +765,10 @@ func decodeExtraData(dst Destination, p printer, src buffer) (src1 buffer, retEr
 	extra, src := src[:length], src[length:]
 	if p != nil {
 		for ; len(extra) > 4; extra = extra[4:] {
-			p(extra[:4], "      ???\n")
+			p(extra[:4], printKindOther, "      ???\n")
 		}
 		if len(extra) > 0 {
-			p(extra, "      ???\n")
+			p(extra, printKindOther, "      ???\n")
 		}
 	}
 	return src, nil
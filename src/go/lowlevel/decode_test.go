@@ -0,0 +1,94 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"fmt"
+	"testing"
+)
+
+// TestDecodeCallSkipsInlineSegment checks that a Call op's Inline SegRef (8
+// bytes) and its segment contents are skipped as part of the op, both when
+// executing it and when a Jump Level-of-Detail op jumps over it. The segments
+// are all NOPs, so the calls should draw nothing.
+func TestDecodeCallSkipsInlineSegment(t *testing.T) {
+	for _, segLen := range []int{0, 1, 3, 4, 5, 8, 13} {
+		opts := &SynthesizeOptions{
+			NumDrawings:        8,
+			NumSegmentsPerPath: 10,
+			CoordinateWidths:   []int{1, 2, 4},
+			LODDepth:           3,
+			Seed:               3,
+		}
+		want, err := Synthesize(opts)
+		if err != nil {
+			t.Fatalf("Synthesize (without calls): %v", err)
+		}
+		opts.NumCallsPerDrawing = 2
+		opts.CallSegmentLength = segLen
+		got, err := Synthesize(opts)
+		if err != nil {
+			t.Fatalf("Synthesize (with calls): %v", err)
+		}
+		for _, h := range testHeights {
+			checkSameCalls(t, fmt.Sprintf("segment length %d", segLen), want, got, h)
+		}
+	}
+}
+
+// TestDecodeCallTransformed checks the Call Transformed op's alpha byte and
+// coordinates, and that opcodes 0x3E and 0x3F are reserved ops (followed by
+// Extra Data) rather than Call ops.
+func TestDecodeCallTransformed(t *testing.T) {
+	want := buffer(nil)
+	want = append(want, magicBytes...)
+	want.encodeNatural(0) // Number of metadata chunks.
+	got := append(buffer(nil), want...)
+
+	// Call Transformed, with an Inline SegRef to three NOPs.
+	got = append(got, 0x3D, 0xFF)
+	for _, f := range []float32{1, 0, 0.5, 0, 1, -0.25} {
+		got.encodeCoordinate(f)
+	}
+	got = append(got, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00)
+	got = append(got, 0x37, 0x37, 0x37)
+
+	// Reserved ops, with 2 and 0 bytes of Extra Data.
+	got = append(got, 0x3E)
+	got.encodeNatural(2)
+	got = append(got, 0x35, 0x00)
+	got = append(got, 0x3F)
+	got.encodeNatural(0)
+
+	for _, b := range []*buffer{&want, &got} {
+		*b = append(*b, 0x35) // ClosePath; MoveTo.
+		b.encodeCoordinate(-4)
+		b.encodeCoordinate(-4)
+		*b = append(*b, 0x02) // LineTo, 2 reps.
+		for _, f := range []float32{4, -4, 0, 4} {
+			b.encodeCoordinate(f)
+		}
+		*b = append(*b, 0x80) // Fill with a flat color.
+	}
+
+	for _, h := range testHeights {
+		checkSameCalls(t, "Call Transformed", want, got, h)
+	}
+	if calls, err := record(got, 0); err != nil {
+		t.Fatalf("decoding: %v", err)
+	} else if len(calls) < 4 {
+		t.Fatalf("got %d calls, want at least 4", len(calls))
+	}
+}
@@ -43,7 +43,7 @@ func Disassemble(w io.Writer, src []byte) error {
 
 func disassemble(w io.Writer, src []byte) error {
 	var buf [14]byte
-	p := func(b []byte, format string, args ...interface{}) {
+	p := func(b []byte, k printKind, format string, args ...interface{}) {
 		const hex = "0123456789abcdef"
 		for i := range buf {
 			buf[i] = ' '
@@ -0,0 +1,441 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"errors"
+	"math"
+	"reflect"
+)
+
+var (
+	errInvalidLODOptions = errors.New("iconvg: invalid LOD options")
+	errUnsupportedJumpOp = errors.New("iconvg: cannot generate LODs for graphics with Jump or RET ops")
+)
+
+// LODOptions are the parameters to the GenerateLODs function.
+//
+// Zero values mean to use the default value, where one is given.
+type LODOptions struct {
+	// Heights are the height_in_pixels boundaries, in increasing order,
+	// between the Level of Detail variants. N boundaries make N+1 variants:
+	// one below Heights[0], one for each [Heights[i], Heights[i+1]) range and
+	// one at or above Heights[N-1]. That last one has the original geometry.
+	// The others are simplified for the largest height in their range. The
+	// default is {20, 32}.
+	Heights []float32
+
+	// Tolerance is how far (in pixels) simplified geometry may stray from the
+	// original. The default is 0.5.
+	Tolerance float32
+
+	// MinArea is the bounding box area (in square pixels) below which a
+	// drawing is removed. The default is 0.5. Negative means to never remove
+	// drawings.
+	MinArea float32
+}
+
+// GenerateLODs converts the src IconVG graphic into one that holds multiple
+// Level of Detail variants of it, each guarded by a Jump Level-of-Detail op,
+// so that rendering at a small height_in_pixels decodes simpler geometry.
+//
+// For each variant, it demotes QuadTo and CubeTo segments that are close to
+// straight to LineTo segments, simplifies runs of LineTo segments with the
+// Douglas-Peucker algorithm and removes drawings whose bounding boxes are
+// too small to see. Pixels are measured as if the ViewBox's height maps to
+// the height_in_pixels. Adjacent variants that end up identical are merged.
+// The result is then optimized, as per the Optimize function.
+//
+// src must not already have any Jump or RET ops. opts may be nil, which means
+// to use the default options.
+func GenerateLODs(src []byte, opts *LODOptions) ([]byte, error) {
+	l := lodGenerator{}
+	if opts != nil {
+		l.opts = *opts
+	}
+	if err := l.setDefaults(); err != nil {
+		return nil, err
+	}
+
+	o := optimizer{}
+	if err := o.parse(src); err != nil {
+		return nil, err
+	}
+	for i := range o.ops {
+		if k := o.ops[i].kind; (k == irJump) || (k == irReturn) {
+			return nil, errUnsupportedJumpOp
+		}
+	}
+	viewBoxHeight := float64(64)
+	if o.hasViewBox {
+		viewBoxHeight = float64(o.viewBox[3]) - float64(o.viewBox[1])
+	}
+
+	// variants are listed from the largest heights to the smallest.
+	type variant struct {
+		lo  float32
+		ops []irOp
+	}
+	heights := l.opts.Heights
+	variants := []variant{{lo: heights[len(heights)-1], ops: o.ops}}
+	for i := len(heights) - 1; i >= 0; i-- {
+		lo := float32(math.Inf(-1))
+		if i > 0 {
+			lo = heights[i-1]
+		}
+		ops := o.ops
+		if viewBoxHeight > 0 {
+			ops = l.simplify(o.ops, float64(heights[i])/viewBoxHeight)
+		}
+		if last := &variants[len(variants)-1]; reflect.DeepEqual(ops, last.ops) {
+			last.lo = lo
+		} else {
+			variants = append(variants, variant{lo: lo, ops: ops})
+		}
+	}
+
+	if len(variants) > 1 {
+		all := []irOp(nil)
+		for i := len(variants) - 1; i >= 0; i-- {
+			hi := float32(math.Inf(+1))
+			if i > 0 {
+				hi = variants[i-1].lo
+			}
+			all = append(all, irOp{
+				kind:   irJump,
+				opcode: 0x3A,
+				target: len(all) + 1 + len(variants[i].ops),
+				lod:    [2]float32{variants[i].lo, hi},
+			})
+			all = append(all, variants[i].ops...)
+		}
+		o.ops = all
+	}
+	return o.optimize(), nil
+}
+
+type lodGenerator struct {
+	opts LODOptions
+
+	// tolerance and minArea are in ViewBox units, not pixels.
+	tolerance float64
+	minArea   float64
+
+	dst []irOp
+	// pendingLine holds the consecutive LineTo points not yet written to
+	// dst, starting from the point before the first of them.
+	pendingLine [][2]float32
+	// pendingOther holds the register and other non-drawing ops that came
+	// after the first pendingLine point. It is written to dst after the
+	// simplified pendingLine, as they do not affect the geometry.
+	pendingOther []irOp
+}
+
+func (l *lodGenerator) setDefaults() error {
+	o := &l.opts
+	if len(o.Heights) == 0 {
+		o.Heights = []float32{20, 32}
+	}
+	if o.Tolerance == 0 {
+		o.Tolerance = 0.5
+	}
+	if o.MinArea == 0 {
+		o.MinArea = 0.5
+	}
+
+	if !(o.Tolerance > 0) || math.IsInf(float64(o.Tolerance), +1) || math.IsNaN(float64(o.MinArea)) {
+		return errInvalidLODOptions
+	}
+	for i, h := range o.Heights {
+		if !(h > 0) || math.IsInf(float64(h), +1) || ((i > 0) && !(o.Heights[i-1] < h)) {
+			return errInvalidLODOptions
+		}
+	}
+	return nil
+}
+
+// simplify returns the simplified src, for rendering at scale pixels per
+// ViewBox unit.
+func (l *lodGenerator) simplify(src []irOp, scale float64) []irOp {
+	l.tolerance = float64(l.opts.Tolerance) / scale
+	l.minArea = float64(l.opts.MinArea) / (scale * scale)
+	l.dst = nil
+
+	// origCurr and currWant are the current point in the original and
+	// simplified graphics. They can differ after removing a drawing.
+	origCurr := [2]float32{}
+	currWant := [2]float32{}
+	for len(src) > 0 {
+		// A drawing is everything up to and including the next Fill op.
+		n := 0
+		for (n < len(src)) && (src[n].kind != irFill) {
+			n++
+		}
+		if n < len(src) {
+			n++
+		}
+		drawing := src[:n]
+		src = src[n:]
+
+		start := origCurr
+		for i := range drawing {
+			origCurr = advanceCurrentPoint(&drawing[i], origCurr)
+		}
+		if l.isNegligible(drawing, start) {
+			l.removeDrawing(drawing)
+			continue
+		}
+		l.simplifyDrawing(drawing, start, start != currWant)
+		currWant = origCurr
+	}
+	return l.dst
+}
+
+// advanceCurrentPoint returns the current point after op, given the current
+// point before it. Like the C decoder, an Ellipse op moves it to where the
+// ellipse's last quarter ends, a Parallelogram op leaves it alone and a
+// reserved op moves it only if it falls back to being a LineTo.
+func advanceCurrentPoint(op *irOp, curr [2]float32) [2]float32 {
+	if (op.kind == irSegment) || ((op.kind == irShape) && (op.opcode == 0x35)) ||
+		((op.kind == irOpaque) && (op.nCoords == 2)) {
+		return [2]float32{op.coords[op.nCoords-2], op.coords[op.nCoords-1]}
+	} else if (op.kind == irShape) && (op.opcode < 0x34) {
+		switch op.opcode & 3 {
+		case 0:
+			return [2]float32{op.coords[0], op.coords[1]}
+		case 1:
+			return [2]float32{op.coords[2], op.coords[3]}
+		case 2:
+			return [2]float32{
+				curr[0] - op.coords[0] + op.coords[2],
+				curr[1] - op.coords[1] + op.coords[3],
+			}
+		}
+	}
+	return curr
+}
+
+func isPathOp(op *irOp) bool {
+	return (op.kind == irSegment) || (op.kind == irShape) || (op.kind == irOpaque)
+}
+
+// isNegligible returns whether the drawing is filled (instead of being a
+// trailing path without a Fill op) and its bounding box is smaller than
+// l.minArea. Drawings with reserved ops are never negligible.
+func (l *lodGenerator) isNegligible(drawing []irOp, start [2]float32) bool {
+	if drawing[len(drawing)-1].kind != irFill {
+		return false
+	}
+	b := bounds{}
+	curr := start
+	for i := range drawing {
+		op := &drawing[i]
+		switch op.kind {
+		case irSegment:
+			if b.empty() {
+				b.add(curr)
+			}
+			for j := 0; j < op.nCoords; j += 2 {
+				b.add([2]float32{op.coords[j], op.coords[j+1]})
+			}
+		case irShape:
+			if op.opcode == 0x35 {
+				break
+			}
+			if b.empty() {
+				b.add(curr)
+			}
+			b.addShape(op, curr)
+		case irOpaque:
+			return false
+		}
+		curr = advanceCurrentPoint(op, curr)
+	}
+	return b.empty() || ((b.max[0]-b.min[0])*(b.max[1]-b.min[1]) < l.minArea)
+}
+
+// removeDrawing writes the drawing's non-path ops to l.dst. The Fill op
+// becomes a SEL adjustment, if it had one.
+func (l *lodGenerator) removeDrawing(drawing []irOp) {
+	for i := range drawing {
+		op := &drawing[i]
+		if isPathOp(op) {
+			continue
+		} else if op.kind == irFill {
+			if op.adj == 0 {
+				l.dst = append(l.dst, irOp{kind: irSelAdd, adj: 1})
+			}
+			continue
+		}
+		l.dst = append(l.dst, *op)
+	}
+}
+
+// simplifyDrawing writes the simplified drawing to l.dst. If needMoveTo, the
+// decoder's current point no longer matches start, the current point before
+// the drawing, so a path that starts without a ClosePathMoveTo op gets one.
+func (l *lodGenerator) simplifyDrawing(drawing []irOp, start [2]float32, needMoveTo bool) {
+	curr := start
+	for i := range drawing {
+		op := &drawing[i]
+		if needMoveTo && isPathOp(op) {
+			needMoveTo = false
+			if (op.kind != irShape) || (op.opcode != 0x35) {
+				l.dst = append(l.dst, irOp{
+					kind:    irShape,
+					opcode:  0x35,
+					nCoords: 2,
+					coords:  [6]float32{curr[0], curr[1]},
+				})
+			}
+		}
+
+		switch op.kind {
+		case irSegment:
+			end := [2]float32{op.coords[op.nCoords-2], op.coords[op.nCoords-1]}
+			if (op.opcode == 0x00) || l.isFlat(op, curr) {
+				if len(l.pendingLine) == 0 {
+					l.pendingLine = append(l.pendingLine, curr)
+				}
+				l.pendingLine = append(l.pendingLine, end)
+			} else {
+				l.flush()
+				l.dst = append(l.dst, *op)
+			}
+		case irSetRegister, irSelAdd, irNOP:
+			if len(l.pendingLine) > 0 {
+				l.pendingOther = append(l.pendingOther, *op)
+			} else {
+				l.dst = append(l.dst, *op)
+			}
+		default:
+			l.flush()
+			l.dst = append(l.dst, *op)
+		}
+		curr = advanceCurrentPoint(op, curr)
+	}
+	l.flush()
+}
+
+// isFlat returns whether the QuadTo or CubeTo segment op, starting at curr,
+// is within half of l.tolerance of the straight line between its end points.
+// The other half is left for flush's Douglas-Peucker simplification.
+func (l *lodGenerator) isFlat(op *irOp, curr [2]float32) bool {
+	end := [2]float32{op.coords[op.nCoords-2], op.coords[op.nCoords-1]}
+	// A quadratic Bézier curve strays at most 1/2 of its control point's
+	// distance from the chord. For cubics, it's 3/4 of the larger distance.
+	if op.opcode == 0x10 {
+		d := distanceToSegment([2]float32{op.coords[0], op.coords[1]}, curr, end)
+		return (d / 2) <= (l.tolerance / 2)
+	}
+	d0 := distanceToSegment([2]float32{op.coords[0], op.coords[1]}, curr, end)
+	d1 := distanceToSegment([2]float32{op.coords[2], op.coords[3]}, curr, end)
+	return (0.75 * math.Max(d0, d1)) <= (l.tolerance / 2)
+}
+
+// flush writes the Douglas-Peucker simplification of l.pendingLine, and then
+// l.pendingOther, to l.dst.
+func (l *lodGenerator) flush() {
+	if p := l.pendingLine; len(p) > 0 {
+		keep := make([]bool, len(p))
+		keep[0], keep[len(p)-1] = true, true
+		stack := [][2]int{{0, len(p) - 1}}
+		for len(stack) > 0 {
+			lo, hi := stack[len(stack)-1][0], stack[len(stack)-1][1]
+			stack = stack[:len(stack)-1]
+			worst, worstD := -1, l.tolerance/2
+			for i := lo + 1; i < hi; i++ {
+				if d := distanceToSegment(p[i], p[lo], p[hi]); d > worstD {
+					worst, worstD = i, d
+				}
+			}
+			if worst >= 0 {
+				keep[worst] = true
+				stack = append(stack, [2]int{lo, worst}, [2]int{worst, hi})
+			}
+		}
+		for i := 1; i < len(p); i++ {
+			if keep[i] {
+				l.dst = append(l.dst, irOp{
+					kind:    irSegment,
+					opcode:  0x00,
+					nCoords: 2,
+					coords:  [6]float32{p[i][0], p[i][1]},
+				})
+			}
+		}
+		l.pendingLine = l.pendingLine[:0]
+	}
+	l.dst = append(l.dst, l.pendingOther...)
+	l.pendingOther = l.pendingOther[:0]
+}
+
+func distanceToSegment(p [2]float32, a [2]float32, b [2]float32) float64 {
+	px, py := float64(p[0])-float64(a[0]), float64(p[1])-float64(a[1])
+	bx, by := float64(b[0])-float64(a[0]), float64(b[1])-float64(a[1])
+	if lengthSquared := (bx * bx) + (by * by); lengthSquared > 0 {
+		t := ((px * bx) + (py * by)) / lengthSquared
+		t = math.Max(0, math.Min(1, t))
+		px, py = px-(t*bx), py-(t*by)
+	}
+	return math.Sqrt((px * px) + (py * py))
+}
+
+// bounds is an axis-aligned bounding box, in float64 ViewBox units.
+type bounds struct {
+	min, max [2]float64
+	nonEmpty bool
+}
+
+func (b *bounds) empty() bool { return !b.nonEmpty }
+
+func (b *bounds) add(p [2]float32) {
+	for i := range p {
+		v := float64(p[i])
+		if !b.nonEmpty || (b.min[i] > v) {
+			b.min[i] = v
+		}
+		if !b.nonEmpty || (b.max[i] < v) {
+			b.max[i] = v
+		}
+	}
+	b.nonEmpty = true
+}
+
+// addShape adds the Ellipse or Parallelogram op, starting at curr. For an
+// Ellipse, the points added enclose the control points of the cubic Bézier
+// curves that the decoder generates, which enclose the curves.
+func (b *bounds) addShape(op *irOp, curr [2]float32) {
+	const k = 0.551784777779014
+	a := curr
+	p := [2]float32{op.coords[0], op.coords[1]}
+	c := [2]float32{op.coords[2], op.coords[3]}
+	d := [2]float32{a[0] - p[0] + c[0], a[1] - p[1] + c[1]}
+	if op.opcode == 0x34 {
+		b.add(p)
+		b.add(c)
+		b.add(d)
+		return
+	}
+	center := [2]float32{(a[0] + c[0]) / 2, (a[1] + c[1]) / 2}
+	kr := [2]float32{k * (p[0] - center[0]), k * (p[1] - center[1])}
+	ks := [2]float32{k * (c[0] - center[0]), k * (c[1] - center[1])}
+	for _, q := range [4][2]float32{a, p, c, d} {
+		for _, r := range [2][2]float32{kr, ks} {
+			b.add([2]float32{q[0] + r[0], q[1] + r[1]})
+			b.add([2]float32{q[0] - r[0], q[1] - r[1]})
+		}
+	}
+}
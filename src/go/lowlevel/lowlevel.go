@@ -35,6 +35,7 @@ var (
 	errInvalidMetadataIdentifier       = errors.New("iconvg: invalid metadata identifier")
 	errInvalidNumber                   = errors.New("iconvg: invalid number")
 	errInvalidNumberOfMetadataChunks   = errors.New("iconvg: invalid number of metadata chunks")
+	errInvalidSegRef                   = errors.New("iconvg: invalid SegRef")
 	errInvalidSuggestedPalette         = errors.New("iconvg: invalid suggested palette")
 	errInvalidViewBox                  = errors.New("iconvg: invalid view box")
 	errUnsupportedMetadataIdentifier   = errors.New("iconvg: unsupported metadata identifier")
@@ -0,0 +1,995 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"errors"
+	"math"
+)
+
+var (
+	errInvalidJump              = errors.New("iconvg: invalid jump")
+	errInvalidOpcodeLength      = errors.New("iconvg: invalid opcode length")
+	errUnsupportedCallOp        = errors.New("iconvg: cannot optimize files with Call ops")
+	errUnsupportedMetadataOrder = errors.New("iconvg: unsupported metadata identifier order")
+)
+
+// OptimizeReport describes what Optimize did to a graphic.
+type OptimizeReport struct {
+	// NumOpsBefore and NumOpsAfter count the ops (not including the metadata)
+	// before and after optimization.
+	NumOpsBefore int
+	NumOpsAfter  int
+
+	// NumUnreachableOps counts the ops (counting each LineTo, QuadTo or CubeTo
+	// rep and each register of a multi-register op separately) that no
+	// height_in_pixels can reach, such as those inside a Level of Detail
+	// branch that can never be taken.
+	NumUnreachableOps int
+
+	// NumRedundantRegisterSets counts the registers (not ops) whose setting
+	// was removed, because it set a register to the value that it already
+	// held or because it was overwritten before being read.
+	NumRedundantRegisterSets int
+}
+
+// Optimize re-encodes the src IconVG graphic, without changing what it draws,
+// to be smaller and to have fewer ops to decode. Specifically, it:
+//   - encodes each coordinate number in the shortest form that represents it
+//     exactly, e.g. 1 byte instead of 4 for small integers.
+//   - merges consecutive LineTo, QuadTo or CubeTo ops of the same kind into
+//     single ops with larger RepCounts.
+//   - picks the cheapest of the equivalent register op forms (setting the low
+//     32 bits, the high 32 bits, all 64 bits or multiple registers at once),
+//     weighing each op's bytes and, so as not to add ops, its dispatch cost.
+//   - removes register sets that are redundant (setting a register to the
+//     value that it already holds) or dead (overwritten before being read),
+//     along with NOPs and zero SEL adjustments.
+//   - removes Level of Detail branches that no height_in_pixels can take or
+//     skip, given the enclosing branches, and jumps that jump over nothing.
+//   - leaves out metadata chunks that only repeat the default values.
+//
+// Graphics with Call ops are not supported, as their SegRefs can refer to
+// absolute file offsets.
+func Optimize(src []byte) (dst []byte, report OptimizeReport, retErr error) {
+	o := optimizer{}
+	if retErr = o.parse(src); retErr != nil {
+		return nil, OptimizeReport{}, retErr
+	}
+	o.report.NumOpsBefore = o.numOrigOps
+	dst = o.optimize()
+	return dst, o.report, nil
+}
+
+// Specialize is like Optimize but the result only has to draw the same as src
+// when decoded with the given height_in_pixels. Every Jump Level-of-Detail op
+// is evaluated for that height: the branches not taken are removed, and so
+// are the jumps themselves. Decoding the result at that height produces the
+// same canvas calls as decoding src.
+func Specialize(src []byte, heightInPixels int64) (dst []byte, report OptimizeReport, retErr error) {
+	o := optimizer{}
+	if retErr = o.parse(src); retErr != nil {
+		return nil, OptimizeReport{}, retErr
+	}
+	// Like the C decoder, compare the height as a float64.
+	h := float64(heightInPixels)
+	o.heights = heightSet{{h, math.Nextafter(h, math.Inf(+1))}}
+	o.report.NumOpsBefore = o.numOrigOps
+	dst = o.optimize()
+	return dst, o.report, nil
+}
+
+// irKind is the kind of an irOp.
+type irKind uint8
+
+const (
+	irSegment     irKind = iota // A single LineTo, QuadTo or CubeTo rep.
+	irShape                     // An Ellipse, Parallelogram or ClosePathMoveTo op.
+	irSelAdd                    // A SEL += delta op.
+	irNOP                       // A NOP op.
+	irJump                      // A Jump op.
+	irReturn                    // A RET op.
+	irSetRegister               // A single register's set.
+	irFill                      // A Fill op, including reserved ones.
+	irOpaque                    // A reserved op other than a Fill.
+)
+
+// irOp is an op in the optimizer's intermediate representation. LineTo,
+// QuadTo and CubeTo ops with multiple reps, and multi-register ops, are split
+// into one irOp per rep or per register, so that the optimization passes can
+// remove or re-group them freely. The emit pass groups them back into ops.
+type irOp struct {
+	kind irKind
+	dead bool
+
+	// opcode is the opcode (with LOW4 zeroed for irSegment ops) for irSegment,
+	// irShape, irJump and irOpaque ops.
+	opcode byte
+	// adj is the LOW4 for irSetRegister and irFill ops, and the SEL += delta
+	// for irSelAdd ops.
+	adj byte
+	// sel is (relative to the start of its block) SEL just before this op.
+	sel byte
+
+	nCoords int
+	coords  [6]float32
+	// target is the index of the first irOp after those jumped over.
+	target      int
+	lod         [2]float32
+	featureBits uint32
+	value       uint64
+	// removedSet is whether an irSelAdd op replaced a "set REGS[SEL+0];
+	// SEL--" op that was redundant or dead. Its value is that set's value,
+	// which emitRegisterRun may write anyway, if that needs fewer ops than
+	// adjusting SEL.
+	removedSet bool
+	// raw holds the op's original bytes, for irFill and irOpaque ops.
+	raw []byte
+}
+
+type optimizer struct {
+	report OptimizeReport
+
+	viewBox    [4]float32
+	hasViewBox bool
+	palette    []byte
+
+	// heights are the height_in_pixels values that the result has to draw
+	// the same for. nil means all of them.
+	heights heightSet
+
+	ops        []irOp
+	numOrigOps int
+	isTarget   []bool
+	groups     []irGroup
+}
+
+// irGroup is a run of consecutive irOps that the emit pass writes as numOps
+// ops (which is zero for e.g. an irNOP).
+type irGroup struct {
+	start, end int
+	numOps     int
+	// registerRun, if non-nil, is planRegisterRun's result for this group.
+	registerRun []int
+}
+
+// optimize runs the optimization passes over o.ops and returns the encoded
+// graphic.
+func (o *optimizer) optimize() []byte {
+	o.removeUnreachableOps()
+	o.computeTargets()
+	o.removeRedundantRegisterSets()
+	o.removeDeadRegisterSets()
+	for {
+		o.computeTargets()
+		o.plan()
+		if !o.removeEmptyJumps() {
+			break
+		}
+	}
+	return o.emit()
+}
+
+// ----
+
+func (o *optimizer) parse(src buffer) error {
+	if len(src) < len(magic) || string(src[:len(magic)]) != magic {
+		return errInvalidMagicIdentifier
+	}
+	src = src[len(magic):]
+
+	nChunks, n := src.decodeNatural()
+	if n == 0 {
+		return errInvalidNumberOfMetadataChunks
+	}
+	src = src[n:]
+	prevMID := int64(-1)
+	for ; nChunks > 0; nChunks-- {
+		length, n := src.decodeNatural()
+		if (n == 0) || (uint64(length) > uint64(len(src)-n)) {
+			return errInvalidMetadataChunkLength
+		}
+		chunk := src[n : n+int(length)]
+		src = src[n+int(length):]
+		mid, n := chunk.decodeNatural()
+		if n == 0 {
+			return errInvalidMetadataIdentifier
+		} else if int64(mid) <= prevMID {
+			return errUnsupportedMetadataOrder
+		}
+		prevMID = int64(mid)
+		chunk = chunk[n:]
+
+		switch mid {
+		case midViewBox:
+			for i := range o.viewBox {
+				f, n := chunk.decodeCoordinate()
+				if n == 0 {
+					return errInvalidViewBox
+				}
+				o.viewBox[i] = f
+				chunk = chunk[n:]
+			}
+			if len(chunk) != 0 {
+				return errInconsistentMetadataChunkLength
+			} else if (o.viewBox[0] > o.viewBox[2]) || (o.viewBox[1] > o.viewBox[3]) ||
+				isNaNOrInfinity(o.viewBox[0]) || isNaNOrInfinity(o.viewBox[1]) ||
+				isNaNOrInfinity(o.viewBox[2]) || isNaNOrInfinity(o.viewBox[3]) {
+				return errInvalidViewBox
+			}
+			o.hasViewBox = true
+		case midSuggestedPalette:
+			if (len(chunk) == 0) || (chunk[0] >= 64) || (len(chunk) != 1+4*(1+int(chunk[0]))) {
+				return errInvalidSuggestedPalette
+			}
+			o.palette = chunk[1:]
+		default:
+			return errUnsupportedMetadataIdentifier
+		}
+	}
+
+	// origStarts[i] is the index of the first irOp of the i'th original op.
+	origStarts := []int(nil)
+	origTargets := []int(nil)
+	for len(src) > 0 {
+		origStarts = append(origStarts, len(o.ops))
+		opcode := src[0]
+		rest := src[1:]
+		err := error(nil)
+		switch {
+		case opcode < 0x30:
+			rest, err = o.parseSegments(opcode, rest)
+
+		case opcode < 0x36:
+			op := irOp{kind: irShape, opcode: opcode, nCoords: 4}
+			if opcode == 0x35 {
+				op.nCoords = 2
+			}
+			rest, err = decodeCoordinates(op.coords[:op.nCoords], nil, rest)
+			o.ops = append(o.ops, op)
+
+		case opcode == 0x36:
+			if len(rest) < 1 {
+				return errInvalidOpcodeLength
+			}
+			o.ops = append(o.ops, irOp{kind: irSelAdd, adj: rest[0] & 63})
+			rest = rest[1:]
+
+		case opcode == 0x37:
+			o.ops = append(o.ops, irOp{kind: irNOP})
+
+		case opcode < 0x3B:
+			op := irOp{kind: irJump, opcode: opcode}
+			jumpCount, n := rest.decodeNatural()
+			if n == 0 {
+				return errInvalidNumber
+			}
+			rest = rest[n:]
+			if opcode == 0x39 {
+				op.featureBits, n = rest.decodeNatural()
+				if n == 0 {
+					return errInvalidNumber
+				}
+				rest = rest[n:]
+			} else if opcode == 0x3A {
+				rest, err = decodeCoordinates(op.lod[:], nil, rest)
+			}
+			// For now, target holds the original op index. It is converted
+			// to an irOp index below.
+			op.target = len(origStarts) + int(jumpCount)
+			origTargets = append(origTargets, len(o.ops))
+			o.ops = append(o.ops, op)
+
+		case opcode == 0x3B:
+			o.ops = append(o.ops, irOp{kind: irReturn})
+
+		case opcode < 0x40:
+			return errUnsupportedCallOp
+
+		case opcode < 0x70:
+			nBytes := 4 << ((opcode >> 5) & 1)
+			if len(rest) < nBytes {
+				return errInvalidOpcodeLength
+			}
+			value := uint64(0)
+			for i := nBytes - 1; i >= 0; i-- {
+				value = (value << 8) | uint64(rest[i])
+			}
+			if (opcode >> 4) == 5 {
+				value <<= 32
+			}
+			o.ops = append(o.ops, irOp{kind: irSetRegister, adj: opcode & 15, value: value})
+			rest = rest[nBytes:]
+
+		case opcode < 0x80:
+			// A multi-register op is equivalent to a sequence of "set
+			// REGS[SEL+0]; SEL--" ops, highest register first.
+			nRegs := 2 + int(opcode&15)
+			if len(rest) < 8*nRegs {
+				return errInvalidOpcodeLength
+			}
+			for i := nRegs - 1; i >= 0; i-- {
+				value := uint64(0)
+				for j := 7; j >= 0; j-- {
+					value = (value << 8) | uint64(rest[8*i+j])
+				}
+				o.ops = append(o.ops, irOp{kind: irSetRegister, adj: 0, value: value})
+			}
+			rest = rest[8*nRegs:]
+
+		case opcode < 0xC0:
+			// A gradient's extra bytes are its NStops byte and its 3 or 6
+			// float32 transform elements.
+			nBytes := 0
+			switch opcode >> 4 {
+			case 0x9:
+				nBytes = 1 + 3*4
+			case 0xA:
+				nBytes = 1 + 6*4
+			case 0xB:
+				rest, err = skipExtraData(rest)
+			}
+			if len(rest) < nBytes {
+				return errInvalidOpcodeLength
+			}
+			rest = rest[nBytes:]
+			o.ops = append(o.ops, irOp{kind: irFill, adj: opcode & 15})
+
+		default:
+			op := irOp{kind: irOpaque, opcode: opcode}
+			rest, err = skipExtraData(rest)
+			if (err == nil) && (opcode < 0xE0) {
+				op.nCoords = 2
+				rest, err = decodeCoordinates(op.coords[:2], nil, rest)
+			}
+			o.ops = append(o.ops, op)
+		}
+		if err != nil {
+			return err
+		}
+		if k := o.ops[len(o.ops)-1].kind; (k == irFill) || (k == irOpaque) {
+			o.ops[len(o.ops)-1].raw = src[:len(src)-len(rest)]
+		}
+		src = rest
+	}
+
+	o.numOrigOps = len(origStarts)
+	origStarts = append(origStarts, len(o.ops))
+	for _, i := range origTargets {
+		t := o.ops[i].target
+		if t >= len(origStarts) {
+			return errInvalidJump
+		}
+		o.ops[i].target = origStarts[t]
+	}
+	return nil
+}
+
+func (o *optimizer) parseSegments(opcode byte, src buffer) (buffer, error) {
+	nReps := uint32(opcode & 15)
+	if nReps == 0 {
+		n := 0
+		nReps, n = src.decodeNatural()
+		if n == 0 {
+			return nil, errInvalidNumber
+		}
+		nReps += 16
+		src = src[n:]
+	}
+	op := irOp{kind: irSegment, opcode: opcode &^ 15, nCoords: 2 * (1 + int(opcode>>4))}
+	for ; nReps > 0; nReps-- {
+		err := error(nil)
+		if src, err = decodeCoordinates(op.coords[:op.nCoords], nil, src); err != nil {
+			return nil, err
+		}
+		o.ops = append(o.ops, op)
+	}
+	return src, nil
+}
+
+func skipExtraData(src buffer) (buffer, error) {
+	length, n := src.decodeNatural()
+	if n == 0 {
+		return nil, errInvalidNumber
+	} else if uint64(length) > uint64(len(src)-n) {
+		return nil, errInvalidExtraDataLength
+	}
+	return src[n+int(length):], nil
+}
+
+// ----
+
+// heightSet is a set of height_in_pixels values, as a sorted list of disjoint
+// half-open intervals [lo, hi).
+type heightSet [][2]float64
+
+func (s heightSet) union(t heightSet) heightSet {
+	if len(s) == 0 {
+		return t
+	} else if len(t) == 0 {
+		return s
+	}
+	all := make(heightSet, 0, len(s)+len(t))
+	for i, j := 0, 0; (i < len(s)) || (j < len(t)); {
+		if (j == len(t)) || ((i < len(s)) && (s[i][0] <= t[j][0])) {
+			all = append(all, s[i])
+			i++
+		} else {
+			all = append(all, t[j])
+			j++
+		}
+	}
+	u := all[:1]
+	for _, r := range all[1:] {
+		if last := &u[len(u)-1]; r[0] <= last[1] {
+			last[1] = math.Max(last[1], r[1])
+		} else {
+			u = append(u, r)
+		}
+	}
+	return u
+}
+
+func (s heightSet) intersect(lo float64, hi float64) heightSet {
+	u := heightSet(nil)
+	for _, r := range s {
+		if a, b := math.Max(r[0], lo), math.Min(r[1], hi); a < b {
+			u = append(u, [2]float64{a, b})
+		}
+	}
+	return u
+}
+
+func (s heightSet) subtract(lo float64, hi float64) heightSet {
+	if !(lo < hi) {
+		return s
+	}
+	return s.intersect(math.Inf(-1), lo).union(s.intersect(hi, math.Inf(+1)))
+}
+
+// removeUnreachableOps marks the ops that no height_in_pixels (in o.heights)
+// can reach as dead, and simplifies the Jump ops whose outcome is known.
+func (o *optimizer) removeUnreachableOps() {
+	// Jumps only go forward, so one pass (in op order) suffices to find, for
+	// each op, the heights that reach it.
+	reach := make([]heightSet, len(o.ops)+1)
+	reach[0] = o.heights
+	if reach[0] == nil {
+		reach[0] = heightSet{{math.Inf(-1), math.Inf(+1)}}
+	}
+	for i := range o.ops {
+		op := &o.ops[i]
+		r := reach[i]
+		if len(r) == 0 {
+			op.dead = true
+			o.report.NumUnreachableOps++
+			continue
+		}
+		switch op.kind {
+		case irReturn:
+			continue
+		case irJump:
+			switch op.opcode {
+			case 0x38:
+				reach[op.target] = reach[op.target].union(r)
+				continue
+			case 0x39:
+				// Whether the jump is taken depends on the decoder, not on
+				// height_in_pixels.
+				reach[op.target] = reach[op.target].union(r)
+			case 0x3A:
+				lo, hi := float64(op.lod[0]), float64(op.lod[1])
+				taken := r.subtract(lo, hi)
+				r = r.intersect(lo, hi)
+				if len(taken) == 0 {
+					op.dead = true
+				} else if len(r) == 0 {
+					op.opcode = 0x38
+				}
+				reach[op.target] = reach[op.target].union(taken)
+			}
+		}
+		reach[i+1] = reach[i+1].union(r)
+	}
+}
+
+// computeTargets sets isTarget[i] for each op index i (possibly equal to
+// len(o.ops)) that a live Jump op jumps to, after moving each target past
+// any dead ops.
+func (o *optimizer) computeTargets() {
+	o.isTarget = make([]bool, len(o.ops)+1)
+	for i := range o.ops {
+		op := &o.ops[i]
+		if op.dead || (op.kind != irJump) {
+			continue
+		}
+		for (op.target < len(o.ops)) && o.ops[op.target].dead {
+			op.target++
+		}
+		o.isTarget[op.target] = true
+	}
+}
+
+// isBarrier returns whether no register state is known just before and just
+// after the i'th op, because other control flow paths can lead to it or its
+// effect on registers is unknown.
+func (o *optimizer) isBarrier(i int) bool {
+	return o.isTarget[i] || (o.ops[i].kind == irOpaque)
+}
+
+// removeRedundantRegisterSets removes the register sets that set a register
+// to the value that it already holds. It also records each op's SEL, relative
+// to its block, for removeDeadRegisterSets.
+func (o *optimizer) removeRedundantRegisterSets() {
+	known := [64]bool{}
+	values := [64]uint64{}
+	sel := byte(0)
+	for i := range o.ops {
+		op := &o.ops[i]
+		if op.dead {
+			continue
+		} else if o.isBarrier(i) {
+			known = [64]bool{}
+			sel = 0
+		}
+		op.sel = sel
+
+		switch op.kind {
+		case irSelAdd:
+			sel += op.adj
+		case irSetRegister:
+			adj := op.adj
+			r := (sel + adj) & 63
+			if known[r] && (values[r] == op.value) {
+				o.removeRegisterSet(op)
+			}
+			known[r], values[r] = true, op.value
+			if adj == 0 {
+				sel--
+			}
+		case irFill:
+			if op.adj == 0 {
+				sel++
+			}
+		case irOpaque:
+			known = [64]bool{}
+			sel = 0
+		}
+	}
+}
+
+// removeDeadRegisterSets removes the register sets that are overwritten before
+// being read. Conservatively, every Fill op reads every register (as colors
+// can refer to other registers) and so does every Jump op (as it has two
+// successors).
+func (o *optimizer) removeDeadRegisterSets() {
+	// At the end of the bytecode (or at a RET op), every register is dead.
+	dead := [64]bool{}
+	for r := range dead {
+		dead[r] = true
+	}
+	for i := len(o.ops) - 1; i >= 0; i-- {
+		op := &o.ops[i]
+		if op.dead {
+			continue
+		}
+		switch op.kind {
+		case irSetRegister:
+			r := (op.sel + op.adj) & 63
+			if dead[r] {
+				o.removeRegisterSet(op)
+			}
+			dead[r] = true
+		case irFill, irJump, irOpaque:
+			dead = [64]bool{}
+		case irReturn:
+			for r := range dead {
+				dead[r] = true
+			}
+		}
+		if o.isBarrier(i) {
+			dead = [64]bool{}
+		}
+	}
+}
+
+// removeRegisterSet removes op, keeping its effect on SEL.
+func (o *optimizer) removeRegisterSet(op *irOp) {
+	o.report.NumRedundantRegisterSets++
+	if op.adj != 0 {
+		op.dead = true
+		return
+	}
+	op.kind = irSelAdd
+	op.adj = 63
+	op.removedSet = true
+}
+
+// ----
+
+// maxSegmentReps is the largest RepCount of a LineTo, QuadTo or CubeTo op:
+// the largest natural number plus 16.
+const maxSegmentReps = 16 + (1 << 30) - 1
+
+// plan groups the live ops into the ops that emit writes.
+func (o *optimizer) plan() {
+	o.groups = o.groups[:0]
+	for i := 0; i < len(o.ops); {
+		op := &o.ops[i]
+		if op.dead {
+			i++
+			continue
+		}
+		g := irGroup{start: i, end: i + 1, numOps: 1}
+		if o.startsRegisterRun(i) {
+			g.end = o.registerRunEnd(i)
+			g.registerRun = o.planRegisterRun(g.start, g.end)
+			g.numOps = len(g.registerRun)
+			o.groups = append(o.groups, g)
+			i = g.end
+			continue
+		}
+		switch op.kind {
+		case irSegment:
+			for reps := 1; reps < maxSegmentReps; reps++ {
+				j := o.nextLiveOp(g.end)
+				if (j == len(o.ops)) || o.isTarget[j] ||
+					(o.ops[j].kind != irSegment) || (o.ops[j].opcode != op.opcode) {
+					break
+				}
+				g.end = j + 1
+			}
+		case irSelAdd:
+			delta := op.adj
+			for {
+				j := o.nextLiveOp(g.end)
+				if (j == len(o.ops)) || o.isTarget[j] || (o.ops[j].kind != irSelAdd) {
+					break
+				}
+				delta += o.ops[j].adj
+				g.end = j + 1
+			}
+			if delta&63 == 0 {
+				g.numOps = 0
+			}
+		case irNOP:
+			g.numOps = 0
+		}
+		o.groups = append(o.groups, g)
+		i = g.end
+	}
+}
+
+func (o *optimizer) nextLiveOp(i int) int {
+	for (i < len(o.ops)) && o.ops[i].dead {
+		i++
+	}
+	return i
+}
+
+// isRunOp returns whether o.ops[i] is a "set REGS[SEL+0]; SEL--" op or a
+// removedSet op, the two kinds of op that a register run is made of.
+func (o *optimizer) isRunOp(i int) bool {
+	op := &o.ops[i]
+	return ((op.kind == irSetRegister) && (op.adj == 0)) ||
+		((op.kind == irSelAdd) && op.removedSet)
+}
+
+// startsRegisterRun returns whether the live op o.ops[i] starts a register
+// run: a "set REGS[SEL+0]; SEL--" op, or removedSet ops followed by one.
+// removedSet ops that follow another SEL += delta op are not a run's start,
+// as plan merges them into that op's group for free.
+func (o *optimizer) startsRegisterRun(i int) bool {
+	if !o.isRunOp(i) {
+		return false
+	}
+	for j := i; ; {
+		if o.ops[j].kind == irSetRegister {
+			return true
+		}
+		j = o.nextLiveOp(j + 1)
+		if (j == len(o.ops)) || o.isTarget[j] || !o.isRunOp(j) {
+			return false
+		}
+	}
+}
+
+// registerRunEnd returns the end of the register run that starts at
+// o.ops[start]. Trailing removedSet ops are left out of the run if a
+// SEL += delta op follows them, as they merge into that op's group for free.
+func (o *optimizer) registerRunEnd(start int) int {
+	end, lastSet := start+1, start
+	for {
+		j := o.nextLiveOp(end)
+		if (j == len(o.ops)) || o.isTarget[j] || !o.isRunOp(j) {
+			if (j < len(o.ops)) && !o.isTarget[j] && (o.ops[j].kind == irSelAdd) {
+				return lastSet + 1
+			}
+			return end
+		}
+		if o.ops[j].kind == irSetRegister {
+			lastSet = j
+		}
+		end = j + 1
+	}
+}
+
+// opDispatchCost is what planRegisterRun charges for each op, in addition to
+// its length in bytes. The decoder does a table lookup and an indirect branch
+// per op, so a plan that saves a few bytes by splitting one op into two is
+// slower to decode. An extra op has to save more than one register's 8 bytes.
+const opDispatchCost = 8
+
+// planRegisterRun splits the register run o.ops[start:end] (some of whose ops
+// may be dead) into the cheapest ops, counting each op's bytes plus
+// opDispatchCost. Each element of the result is one op. A positive element m
+// is a register op writing m registers: a single-register op if m is one and
+// a multi-register op otherwise. A negative element -k is a SEL += delta op
+// that skips over k removedSet registers.
+//
+// A multi-register op can also write removedSet registers, with the values
+// that their original sets wrote. Those sets were redundant or dead, so
+// writing them again does not change what is drawn.
+func (o *optimizer) planRegisterRun(start int, end int) []int {
+	values, removed := []uint64(nil), []bool(nil)
+	for i := start; i < end; i++ {
+		if !o.ops[i].dead {
+			values = append(values, o.ops[i].value)
+			removed = append(removed, o.ops[i].kind == irSelAdd)
+		}
+	}
+
+	// cost[j] and nOps[j] are the cost and ops needed for values[:j], and
+	// last[j] is the result element for the last op.
+	cost := make([]int, len(values)+1)
+	nOps := make([]int, len(values)+1)
+	last := make([]int, len(values)+1)
+	for j := 1; j <= len(values); j++ {
+		cost[j], nOps[j] = -1, 0
+		try := func(c int, n int, l int) {
+			if (cost[j] < 0) || (c < cost[j]) || ((c == cost[j]) && (n < nOps[j])) {
+				cost[j], nOps[j], last[j] = c, n, l
+			}
+		}
+		if removed[j-1] {
+			for k := 1; (k <= 63) && (k <= j) && removed[j-k]; k++ {
+				try(cost[j-k]+2+opDispatchCost, nOps[j-k]+1, -k)
+			}
+		} else {
+			try(cost[j-1]+singleRegisterOpLength(values[j-1])+opDispatchCost, nOps[j-1]+1, 1)
+		}
+		for m := 2; (m <= 17) && (m <= j); m++ {
+			try(cost[j-m]+1+8*m+opDispatchCost, nOps[j-m]+1, m)
+		}
+	}
+
+	sizes := make([]int, nOps[len(values)])
+	for j, k := len(values), len(sizes)-1; j > 0; k-- {
+		sizes[k] = last[j]
+		if last[j] < 0 {
+			j += last[j]
+		} else {
+			j -= last[j]
+		}
+	}
+	return sizes
+}
+
+func singleRegisterOpLength(value uint64) int {
+	if (value>>32 == 0) || (value<<32 == 0) {
+		return 5
+	}
+	return 9
+}
+
+// removeEmptyJumps marks the Jump ops that jump over zero ops as dead,
+// returning whether there were any.
+func (o *optimizer) removeEmptyJumps() bool {
+	counts := o.jumpCounts()
+	any := false
+	for i, n := range counts {
+		if n == 0 {
+			o.ops[i].dead = true
+			any = true
+		}
+	}
+	return any
+}
+
+// jumpCounts returns each live Jump op's JumpCount, keyed by its op index.
+func (o *optimizer) jumpCounts() map[int]uint32 {
+	// numOpsBefore[i] is the number of ops emitted before the i'th irOp, if
+	// that starts a group.
+	numOpsBefore := make(map[int]uint32, len(o.groups)+1)
+	n := uint32(0)
+	for _, g := range o.groups {
+		numOpsBefore[g.start] = n
+		n += uint32(g.numOps)
+	}
+	numOpsBefore[len(o.ops)] = n
+
+	counts := map[int]uint32{}
+	for _, g := range o.groups {
+		if op := &o.ops[g.start]; op.kind == irJump {
+			counts[g.start] = numOpsBefore[op.target] - numOpsBefore[g.start] - 1
+		}
+	}
+	return counts
+}
+
+// ----
+
+func (o *optimizer) emit() []byte {
+	b := buffer(nil)
+	b = append(b, magicBytes...)
+
+	viewBox := buffer(nil)
+	if o.hasViewBox && (o.viewBox != [4]float32{-32, -32, +32, +32}) {
+		viewBox.encodeNatural(midViewBox)
+		for _, f := range o.viewBox {
+			viewBox.encodeExactCoordinate(f)
+		}
+	}
+	palette := buffer(nil)
+	// Trailing opaque black entries are implied.
+	p := o.palette
+	for (len(p) >= 4) && (string(p[len(p)-4:]) == "\x00\x00\x00\xFF") {
+		p = p[:len(p)-4]
+	}
+	if len(p) > 0 {
+		palette.encodeNatural(midSuggestedPalette)
+		palette = append(palette, uint8(len(p)/4-1))
+		palette = append(palette, p...)
+	}
+	numChunks := uint32(0)
+	for _, c := range [2]buffer{viewBox, palette} {
+		if len(c) > 0 {
+			numChunks++
+		}
+	}
+	b.encodeNatural(numChunks)
+	for _, c := range [2]buffer{viewBox, palette} {
+		if len(c) > 0 {
+			b.encodeNatural(uint32(len(c)))
+			b = append(b, c...)
+		}
+	}
+
+	counts := o.jumpCounts()
+	for _, g := range o.groups {
+		o.report.NumOpsAfter += g.numOps
+		if g.registerRun != nil {
+			b = o.emitRegisterRun(b, g)
+			continue
+		}
+		op := &o.ops[g.start]
+		switch op.kind {
+		case irSegment:
+			reps := 0
+			for i := g.start; i < g.end; i++ {
+				if !o.ops[i].dead {
+					reps++
+				}
+			}
+			if reps < 16 {
+				b = append(b, op.opcode|uint8(reps))
+			} else {
+				b = append(b, op.opcode)
+				b.encodeNatural(uint32(reps - 16))
+			}
+			for i := g.start; i < g.end; i++ {
+				if !o.ops[i].dead {
+					for _, f := range o.ops[i].coords[:op.nCoords] {
+						b.encodeExactCoordinate(f)
+					}
+				}
+			}
+
+		case irShape:
+			b = append(b, op.opcode)
+			for _, f := range op.coords[:op.nCoords] {
+				b.encodeExactCoordinate(f)
+			}
+
+		case irSelAdd:
+			if g.numOps > 0 {
+				delta := byte(0)
+				for i := g.start; i < g.end; i++ {
+					if !o.ops[i].dead {
+						delta += o.ops[i].adj
+					}
+				}
+				b = append(b, 0x36, delta&63)
+			}
+
+		case irJump:
+			b = append(b, op.opcode)
+			b.encodeNatural(counts[g.start])
+			if op.opcode == 0x39 {
+				b.encodeNatural(op.featureBits)
+			} else if op.opcode == 0x3A {
+				b.encodeExactCoordinate(op.lod[0])
+				b.encodeExactCoordinate(op.lod[1])
+			}
+
+		case irReturn:
+			b = append(b, 0x3B)
+
+		case irSetRegister:
+			b.encodeSingleRegisterOp(op.adj, op.value)
+
+		case irFill, irOpaque:
+			b = append(b, op.raw...)
+		}
+	}
+	return b
+}
+
+func (o *optimizer) emitRegisterRun(b buffer, g irGroup) buffer {
+	values, removed := []uint64(nil), []bool(nil)
+	for i := g.start; i < g.end; i++ {
+		if !o.ops[i].dead {
+			values = append(values, o.ops[i].value)
+			removed = append(removed, o.ops[i].kind == irSelAdd)
+		}
+	}
+	for _, m := range g.registerRun {
+		if m < 0 {
+			b = append(b, 0x36, uint8(m)&63)
+			values, removed = values[-m:], removed[-m:]
+			continue
+		} else if m == 1 {
+			b.encodeSingleRegisterOp(0, values[0])
+		} else {
+			// The multi-register op writes its registers lowest first, which
+			// is the reverse of the "SEL--" ops' order.
+			b = append(b, 0x70|uint8(m-2))
+			for i := m - 1; i >= 0; i-- {
+				v := values[i]
+				b = append(b,
+					uint8(v>>0), uint8(v>>8), uint8(v>>16), uint8(v>>24),
+					uint8(v>>32), uint8(v>>40), uint8(v>>48), uint8(v>>56))
+				if removed[i] {
+					o.report.NumRedundantRegisterSets--
+				}
+			}
+		}
+		values, removed = values[m:], removed[m:]
+	}
+	return b
+}
+
+func (b *buffer) encodeSingleRegisterOp(adj byte, v uint64) {
+	if v>>32 == 0 {
+		*b = append(*b, 0x40|adj, uint8(v>>0), uint8(v>>8), uint8(v>>16), uint8(v>>24))
+	} else if v<<32 == 0 {
+		*b = append(*b, 0x50|adj, uint8(v>>32), uint8(v>>40), uint8(v>>48), uint8(v>>56))
+	} else {
+		*b = append(*b, 0x60|adj,
+			uint8(v>>0), uint8(v>>8), uint8(v>>16), uint8(v>>24),
+			uint8(v>>32), uint8(v>>40), uint8(v>>48), uint8(v>>56))
+	}
+}
+
+// encodeExactCoordinate is like encodeCoordinate but it preserves negative
+// zero, which the 1 and 2 byte encodings cannot represent. Coordinates that
+// were decoded from an IconVG file are otherwise encoded exactly.
+func (b *buffer) encodeExactCoordinate(f float32) {
+	if (f == 0) && math.Signbit(float64(f)) {
+		b.encodeFloat32(f)
+		return
+	}
+	b.encodeCoordinate(f)
+}
@@ -0,0 +1,218 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"fmt"
+	"os"
+	"path/filepath"
+	"testing"
+)
+
+// testHeights are the height_in_pixels values that the tests decode at. They
+// straddle the Level of Detail boundaries used by test/data/lod-polygon.iconvg,
+// by GenerateLODs' defaults and by Synthesize's LODDepth.
+var testHeights = []int64{0, 1, 15, 16, 20, 31, 32, 47, 48, 63, 64, 80, 127, 128, 1000, 65535, 65536, 1 << 20}
+
+// recorder is a Destination that records the calls made to it. Its
+// QueryLevelOfDetail answers for a fixed height and is not itself recorded,
+// as optimizing can remove Jump Level-of-Detail ops.
+type recorder struct {
+	height float32
+	calls  []string
+}
+
+func (r *recorder) Reset(m Metadata) {
+	r.calls = append(r.calls, fmt.Sprintf("Reset(%v)", m))
+}
+
+func (r *recorder) QueryLevelOfDetail(lod0, lod1 float32) bool {
+	return (lod0 <= r.height) && (r.height < lod1)
+}
+
+func (r *recorder) ClosePathMoveTo(x, y float32) {
+	r.calls = append(r.calls, fmt.Sprintf("ClosePathMoveTo(%v, %v)", x, y))
+}
+
+func (r *recorder) LineTo(x, y float32) {
+	r.calls = append(r.calls, fmt.Sprintf("LineTo(%v, %v)", x, y))
+}
+
+func (r *recorder) QuadTo(x1, y1, x, y float32) {
+	r.calls = append(r.calls, fmt.Sprintf("QuadTo(%v, %v, %v, %v)", x1, y1, x, y))
+}
+
+func (r *recorder) CubeTo(x1, y1, x2, y2, x, y float32) {
+	r.calls = append(r.calls, fmt.Sprintf("CubeTo(%v, %v, %v, %v, %v, %v)", x1, y1, x2, y2, x, y))
+}
+
+func (r *recorder) Ellipse(nQuarters uint32, x1, y1, x2, y2, x, y float32) {
+	r.calls = append(r.calls, fmt.Sprintf("Ellipse(%d, %v, %v, %v, %v, %v, %v)", nQuarters, x1, y1, x2, y2, x, y))
+}
+
+func (r *recorder) Parallelogram(x1, y1, x2, y2, x, y float32) {
+	r.calls = append(r.calls, fmt.Sprintf("Parallelogram(%v, %v, %v, %v, %v, %v)", x1, y1, x2, y2, x, y))
+}
+
+func (r *recorder) ClosePathFill() {
+	r.calls = append(r.calls, "ClosePathFill()")
+}
+
+func record(src []byte, height int64) ([]string, error) {
+	r := &recorder{height: float32(height)}
+	err := Decode(r, src, nil)
+	return r.calls, err
+}
+
+// checkSameCalls checks that decoding got at height produces the same calls
+// as decoding want.
+func checkSameCalls(t *testing.T, name string, want []byte, got []byte, height int64) {
+	t.Helper()
+	wantCalls, err := record(want, height)
+	if err != nil {
+		t.Fatalf("%s: decoding the original: %v", name, err)
+	}
+	gotCalls, err := record(got, height)
+	if err != nil {
+		t.Fatalf("%s: height %d: decoding the result: %v", name, height, err)
+	}
+	if len(gotCalls) != len(wantCalls) {
+		t.Fatalf("%s: height %d: got %d calls, want %d", name, height, len(gotCalls), len(wantCalls))
+	}
+	for i := range gotCalls {
+		if gotCalls[i] != wantCalls[i] {
+			t.Fatalf("%s: height %d: call #%d: got %s, want %s", name, height, i, gotCalls[i], wantCalls[i])
+		}
+	}
+}
+
+// testInputs returns test/data/*.iconvg plus some synthesized graphics, one
+// of them with many (nested) Level of Detail jumps.
+func testInputs(t *testing.T) map[string][]byte {
+	t.Helper()
+	filenames, err := filepath.Glob("../../../test/data/*.iconvg")
+	if err != nil {
+		t.Fatalf("Glob: %v", err)
+	} else if len(filenames) == 0 {
+		t.Fatalf("Glob: no test/data/*.iconvg files")
+	}
+	inputs := map[string][]byte{}
+	for _, filename := range filenames {
+		src, err := os.ReadFile(filename)
+		if err != nil {
+			t.Fatalf("ReadFile: %v", err)
+		}
+		inputs[filepath.Base(filename)] = src
+	}
+
+	synthesized := map[string]*SynthesizeOptions{
+		"synthesized-plain": {
+			NumDrawings:        4,
+			NumSegmentsPerPath: 40,
+			CoordinateWidths:   []int{1, 2, 4},
+			Seed:               1,
+		},
+		"synthesized-jumps": {
+			NumDrawings:        16,
+			NumPathsPerDrawing: 2,
+			NumSegmentsPerPath: 12,
+			CoordinateWidths:   []int{4, 1, 2},
+			NumGradientStops:   3,
+			LODDepth:           4,
+			RegisterRunLength:  5,
+			Seed:               2,
+		},
+	}
+	for name, opts := range synthesized {
+		src, err := Synthesize(opts)
+		if err != nil {
+			t.Fatalf("%s: Synthesize: %v", name, err)
+		}
+		inputs[name] = src
+	}
+	return inputs
+}
+
+func TestOptimize(t *testing.T) {
+	for name, src := range testInputs(t) {
+		dst, _, err := Optimize(src)
+		if err != nil {
+			t.Fatalf("%s: Optimize: %v", name, err)
+		}
+		for _, h := range testHeights {
+			checkSameCalls(t, name, src, dst, h)
+		}
+
+		// Optimizing again should not change what is drawn either.
+		dst2, _, err := Optimize(dst)
+		if err != nil {
+			t.Fatalf("%s: Optimize (again): %v", name, err)
+		}
+		for _, h := range testHeights {
+			checkSameCalls(t, name+" (again)", src, dst2, h)
+		}
+	}
+}
+
+// TestOptimizeDoesNotAddOps checks that Optimize never trades fewer bytes for
+// more ops. In particular, it used to split gradient.iconvg's multi-register
+// ops, going from 20 to 28 ops, to save a few bytes.
+func TestOptimizeDoesNotAddOps(t *testing.T) {
+	inputs := testInputs(t)
+	if _, ok := inputs["gradient.iconvg"]; !ok {
+		t.Fatalf("no gradient.iconvg test input")
+	}
+	for name, src := range inputs {
+		_, report, err := Optimize(src)
+		if err != nil {
+			t.Fatalf("%s: Optimize: %v", name, err)
+		}
+		if report.NumOpsAfter > report.NumOpsBefore {
+			t.Errorf("%s: ops went from %d to %d", name, report.NumOpsBefore, report.NumOpsAfter)
+		}
+	}
+}
+
+func TestSpecialize(t *testing.T) {
+	for name, src := range testInputs(t) {
+		for _, h := range testHeights {
+			dst, _, err := Specialize(src, h)
+			if err != nil {
+				t.Fatalf("%s: Specialize(%d): %v", name, h, err)
+			}
+			checkSameCalls(t, name, src, dst, h)
+		}
+	}
+}
+
+// TestGenerateLODs checks the variant at or above the largest boundary
+// height, which keeps the original geometry. The other variants are
+// simplified, so they are not expected to draw the same.
+func TestGenerateLODs(t *testing.T) {
+	opts := &LODOptions{Heights: []float32{20, 32}}
+	for name, src := range testInputs(t) {
+		dst, err := GenerateLODs(src, opts)
+		if err == errUnsupportedJumpOp {
+			continue
+		} else if err != nil {
+			t.Fatalf("%s: GenerateLODs: %v", name, err)
+		}
+		for _, h := range testHeights {
+			if float32(h) >= opts.Heights[len(opts.Heights)-1] {
+				checkSameCalls(t, name, src, dst, h)
+			}
+		}
+	}
+}
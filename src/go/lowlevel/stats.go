@@ -0,0 +1,366 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"bufio"
+	"encoding/json"
+	"fmt"
+	"io"
+	"math/bits"
+	"sort"
+	"strconv"
+)
+
+// Stats accumulates aggregate statistics (opcode, number encoding and paint
+// mix histograms) over a corpus of IconVG graphics.
+//
+// The zero value is an empty Stats, ready to use. A Stats is not safe for
+// concurrent use, but multiple Stats (e.g. one per goroutine) can be
+// combined with Merge.
+type Stats struct {
+	numFiles        uint64
+	numInvalidFiles uint64
+	numBytes        uint64
+	drawingsPerFile histogram
+	errors          map[string]uint64
+	lodRanges       map[[2]float32]uint64
+	total           statsCounts
+
+	// file holds the counts for the graphic currently being added. They are
+	// only merged into total if that graphic is valid.
+	file statsCounts
+	// opcode is the opcode of the op currently being decoded.
+	opcode byte
+	// lodArgs holds the Jump Level-of-Detail op's coordinates seen so far.
+	lodArgs []float32
+}
+
+type statsCounts struct {
+	opcodes          [256]uint64
+	coordinateWidths [5]uint64
+	naturalWidths    [5]uint64
+	repsPerOp        histogram
+	gradientStops    [66]uint64
+	lodRanges        [][2]float32
+}
+
+// histogram counts uint32 values in power-of-2 buckets: bucket i holds the
+// values v for which bits.Len32(v) == i.
+type histogram [33]uint64
+
+func (h *histogram) add(v uint32) { h[bits.Len32(v)]++ }
+
+func histogramBucketName(i int) string {
+	if i <= 1 {
+		return strconv.Itoa(i)
+	}
+	lo := uint64(1) << (i - 1)
+	return strconv.FormatUint(lo, 10) + "-" + strconv.FormatUint((2*lo)-1, 10)
+}
+
+// Add decodes the src IconVG graphic and adds its statistics. If src is not
+// a valid IconVG graphic then only the file count, byte count and error
+// message are recorded and the decoding error is returned.
+func (s *Stats) Add(src []byte) error {
+	s.file.opcodes = [256]uint64{}
+	s.file.coordinateWidths = [5]uint64{}
+	s.file.naturalWidths = [5]uint64{}
+	s.file.repsPerOp = histogram{}
+	s.file.gradientStops = [66]uint64{}
+	s.file.lodRanges = s.file.lodRanges[:0]
+	s.opcode = 0
+	s.lodArgs = s.lodArgs[:0]
+
+	s.numFiles++
+	s.numBytes += uint64(len(src))
+	if err := decode(nil, s.observe, nil, false, src, nil); err != nil {
+		s.numInvalidFiles++
+		if s.errors == nil {
+			s.errors = map[string]uint64{}
+		}
+		s.errors[err.Error()]++
+		return err
+	}
+
+	numDrawings := uint64(0)
+	for op := 0x80; op < 0xC0; op++ {
+		numDrawings += s.file.opcodes[op]
+	}
+	s.drawingsPerFile.add(uint32(min(numDrawings, 0xFFFFFFFF)))
+	s.total.merge(&s.file)
+	if len(s.file.lodRanges) > 0 {
+		if s.lodRanges == nil {
+			s.lodRanges = map[[2]float32]uint64{}
+		}
+		for _, r := range s.file.lodRanges {
+			s.lodRanges[r]++
+		}
+	}
+	return nil
+}
+
+func (c *statsCounts) merge(d *statsCounts) {
+	for i, n := range d.opcodes {
+		c.opcodes[i] += n
+	}
+	for i, n := range d.coordinateWidths {
+		c.coordinateWidths[i] += n
+	}
+	for i, n := range d.naturalWidths {
+		c.naturalWidths[i] += n
+	}
+	for i, n := range d.repsPerOp {
+		c.repsPerOp[i] += n
+	}
+	for i, n := range d.gradientStops {
+		c.gradientStops[i] += n
+	}
+}
+
+// Merge adds t's statistics to s.
+func (s *Stats) Merge(t *Stats) {
+	s.numFiles += t.numFiles
+	s.numInvalidFiles += t.numInvalidFiles
+	s.numBytes += t.numBytes
+	for i, n := range t.drawingsPerFile {
+		s.drawingsPerFile[i] += n
+	}
+	for k, n := range t.errors {
+		if s.errors == nil {
+			s.errors = map[string]uint64{}
+		}
+		s.errors[k] += n
+	}
+	for k, n := range t.lodRanges {
+		if s.lodRanges == nil {
+			s.lodRanges = map[[2]float32]uint64{}
+		}
+		s.lodRanges[k] += n
+	}
+	s.total.merge(&t.total)
+}
+
+// observe is a printer that, instead of printing, classifies the decoder's
+// output by its printKind. Numbers are decoded again from b, so that observe
+// does not depend on the disassembly's format strings or arguments.
+func (s *Stats) observe(b []byte, k printKind, format string, args ...interface{}) {
+	switch k {
+	case printKindOpcode:
+		s.opcode = b[0]
+		s.file.opcodes[s.opcode]++
+		switch {
+		case (s.opcode < 0x30) && ((s.opcode & 0x0F) != 0):
+			s.file.repsPerOp.add(uint32(s.opcode & 0x0F))
+		case (0x90 <= s.opcode) && (s.opcode < 0xB0):
+			s.file.gradientStops[2+(b[1]&63)]++
+		}
+
+	case printKindNatural:
+		s.file.naturalWidths[len(b)]++
+
+	case printKindReps:
+		s.file.naturalWidths[len(b)]++
+		u, _ := buffer(b).decodeNatural()
+		s.file.repsPerOp.add(u + 16)
+
+	case printKindCoordinate:
+		s.file.coordinateWidths[len(b)]++
+		if s.opcode == 0x3A {
+			f, _ := buffer(b).decodeCoordinate()
+			s.lodArgs = append(s.lodArgs, f)
+			if len(s.lodArgs) == 2 {
+				s.file.lodRanges = append(s.file.lodRanges, [2]float32{s.lodArgs[0], s.lodArgs[1]})
+				s.lodArgs = s.lodArgs[:0]
+			}
+		}
+	}
+}
+
+var opcodeClassNames = [...]string{
+	"LineTo", "QuadTo", "CubeTo", "Ellipse", "Parallelogram",
+	"ClosePath; MoveTo", "SEL += n", "NOP",
+	"Jump Unconditional", "Jump Feature-Bits", "Jump Level-of-Detail", "RET",
+	"Call",
+	"Set REGS[SEL+n].lo32", "Set REGS[SEL+n].hi32", "Set REGS[SEL+n]", "Set REGS[SEL+1 .. SEL+n]",
+	"Fill (flat color)", "Fill (linear gradient)", "Fill (radial gradient)", "Fill (reserved)",
+	"Reserved (LineTo)", "Reserved (NOP)",
+}
+
+// opcodeClass returns an index into opcodeClassNames.
+func opcodeClass(opcode byte) int {
+	switch opcode >> 6 {
+	case 0:
+		if opcode < 0x30 {
+			return int(opcode >> 4)
+		} else if opcode < 0x34 {
+			return 3
+		} else if opcode < 0x3C {
+			return 4 + int(opcode-0x34)
+		} else if opcode < 0x3E {
+			return 12
+		}
+		// 0x3E and 0x3F are reserved ops whose fallback is a NOP.
+	case 1:
+		return 13 + int((opcode>>4)&3)
+	case 2:
+		return 17 + int((opcode>>4)&3)
+	case 3:
+		if opcode < 0xE0 {
+			return 21
+		}
+	}
+	return 22
+}
+
+// statsSection is a named, ordered list of (key, count) pairs.
+type statsSection struct {
+	name   string
+	keys   []string
+	counts []uint64
+}
+
+func (t *statsSection) add(key string, count uint64) {
+	t.keys = append(t.keys, key)
+	t.counts = append(t.counts, count)
+}
+
+func (t *statsSection) addHistogram(h *histogram) {
+	for i, n := range h {
+		if n != 0 {
+			t.add(histogramBucketName(i), n)
+		}
+	}
+}
+
+func (s *Stats) sections() []statsSection {
+	files := statsSection{name: "files"}
+	files.add("total", s.numFiles)
+	files.add("invalid", s.numInvalidFiles)
+	files.add("bytes", s.numBytes)
+
+	opcodeClasses := statsSection{name: "opcodeClasses"}
+	classCounts := [len(opcodeClassNames)]uint64{}
+	for op, n := range s.total.opcodes {
+		classCounts[opcodeClass(byte(op))] += n
+	}
+	for i, n := range classCounts {
+		opcodeClasses.add(opcodeClassNames[i], n)
+	}
+
+	coordinateWidths := statsSection{name: "coordinateWidths"}
+	naturalWidths := statsSection{name: "naturalWidths"}
+	for _, w := range [3]int{1, 2, 4} {
+		coordinateWidths.add(strconv.Itoa(w), s.total.coordinateWidths[w])
+		naturalWidths.add(strconv.Itoa(w), s.total.naturalWidths[w])
+	}
+
+	repsPerOp := statsSection{name: "repsPerOp"}
+	repsPerOp.addHistogram(&s.total.repsPerOp)
+
+	gradientStops := statsSection{name: "gradientStops"}
+	for i, n := range s.total.gradientStops {
+		if n != 0 {
+			gradientStops.add(strconv.Itoa(i), n)
+		}
+	}
+
+	lodRanges := statsSection{name: "lodRanges"}
+	lodKeys := make([][2]float32, 0, len(s.lodRanges))
+	for k := range s.lodRanges {
+		lodKeys = append(lodKeys, k)
+	}
+	sort.Slice(lodKeys, func(i, j int) bool {
+		if lodKeys[i][0] != lodKeys[j][0] {
+			return lodKeys[i][0] < lodKeys[j][0]
+		}
+		return lodKeys[i][1] < lodKeys[j][1]
+	})
+	for _, k := range lodKeys {
+		lodRanges.add(fmt.Sprintf("%g..%g", k[0], k[1]), s.lodRanges[k])
+	}
+
+	drawingsPerFile := statsSection{name: "drawingsPerFile"}
+	drawingsPerFile.addHistogram(&s.drawingsPerFile)
+
+	errs := statsSection{name: "errors"}
+	errKeys := make([]string, 0, len(s.errors))
+	for k := range s.errors {
+		errKeys = append(errKeys, k)
+	}
+	sort.Strings(errKeys)
+	for _, k := range errKeys {
+		errs.add(k, s.errors[k])
+	}
+
+	return []statsSection{
+		files, opcodeClasses, coordinateWidths, naturalWidths, repsPerOp,
+		gradientStops, lodRanges, drawingsPerFile, errs,
+	}
+}
+
+// WriteJSON writes s as a JSON object of objects, each mapping a bucket name
+// (such as an opcode class or a number encoding width) to a count.
+func (s *Stats) WriteJSON(w io.Writer) error {
+	bw := bufio.NewWriter(w)
+	bw.WriteString("{")
+	for i, t := range s.sections() {
+		if i > 0 {
+			bw.WriteString(",")
+		}
+		fmt.Fprintf(bw, "\n  %q: {", t.name)
+		for j, k := range t.keys {
+			if j > 0 {
+				bw.WriteString(",")
+			}
+			key, _ := json.Marshal(k)
+			fmt.Fprintf(bw, "\n    %s: %d", key, t.counts[j])
+		}
+		if len(t.keys) > 0 {
+			bw.WriteString("\n  ")
+		}
+		bw.WriteString("}")
+	}
+	bw.WriteString("\n}\n")
+	return bw.Flush()
+}
+
+// WriteCSV writes s as CSV records with "section,key,count" fields.
+func (s *Stats) WriteCSV(w io.Writer) error {
+	bw := bufio.NewWriter(w)
+	bw.WriteString("section,key,count\n")
+	for _, t := range s.sections() {
+		for j, k := range t.keys {
+			fmt.Fprintf(bw, "%s,%s,%d\n", t.name, csvQuote(k), t.counts[j])
+		}
+	}
+	return bw.Flush()
+}
+
+func csvQuote(s string) string {
+	for i := 0; i < len(s); i++ {
+		if c := s[i]; (c == ',') || (c == '"') || (c == '\n') || (c == '\r') {
+			b := []byte{'"'}
+			for j := 0; j < len(s); j++ {
+				if s[j] == '"' {
+					b = append(b, '"')
+				}
+				b = append(b, s[j])
+			}
+			return string(append(b, '"'))
+		}
+	}
+	return s
+}
@@ -0,0 +1,312 @@
+// Copyright 2021 The IconVG Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//    https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package lowlevel
+
+import (
+	"errors"
+	"math/rand"
+)
+
+var (
+	errInvalidSynthesizeOptions = errors.New("iconvg: invalid synthesize options")
+)
+
+// SynthesizeOptions are the parameters to the Synthesize function.
+//
+// Zero values mean to use the default value, where one is given.
+type SynthesizeOptions struct {
+	// NumDrawings is the number of drawings (Fill ops). The default is 1.
+	NumDrawings int
+
+	// NumPathsPerDrawing is the number of paths in each drawing. The default
+	// is 1.
+	NumPathsPerDrawing int
+
+	// NumSegmentsPerPath is the number of LineTo, QuadTo or CubeTo segments in
+	// each path. Consecutive segments of the same kind are grouped into ops of
+	// 1 to 15 reps or, occasionally, longer runs that encode the RepCount as a
+	// natural number. The default is 8.
+	NumSegmentsPerPath int
+
+	// CoordinateWidths lists the encoded sizes (1, 2 or 4 bytes) of the
+	// path coordinate numbers. The generator cycles through the list. The
+	// default is {1}.
+	CoordinateWidths []int
+
+	// NumGradientStops is the number of stops for each gradient fill, in the
+	// range [2 ..= 64]. Zero means to use flat color fills instead.
+	// Gradients alternate between linear and radial.
+	NumGradientStops int
+
+	// LODDepth is the number of nested Level Of Detail Jump ops that each
+	// drawing is wrapped in. The i'th drawing's j'th level is taken either
+	// below or at-or-above a height of (16 << j) pixels, depending on the j'th
+	// bit of i, so that different heights render different subsets.
+	LODDepth int
+
+	// RegisterRunLength is the number of registers written (in runs of
+	// multi-register ops, each setting up to 17 registers) before each
+	// drawing's fill, in addition to those needed for the fill's colors.
+	RegisterRunLength int
+
+	// NumCallsPerDrawing is the number of Call ops (with Inline SegRefs)
+	// emitted at the start of each drawing, inside its LODJump-guarded
+	// region. Each segment is CallSegmentLength bytes of NOP ops, so that
+	// calling it doesn't change what is drawn.
+	NumCallsPerDrawing int
+	CallSegmentLength  int
+
+	// Seed seeds the pseudo-random number generator that picks coordinates,
+	// colors and segment kinds. The same options produce the same output.
+	Seed int64
+}
+
+// Synthesize generates an IconVG graphic whose size and structure are
+// parameterized by opts. It is intended for generating stress tests and
+// benchmark inputs, not for producing pleasing artwork.
+//
+// opts may be nil, which means to use the default options.
+func Synthesize(opts *SynthesizeOptions) ([]byte, error) {
+	s := synthesizer{}
+	if opts != nil {
+		s.opts = *opts
+	}
+	if err := s.setDefaults(); err != nil {
+		return nil, err
+	}
+	s.rng = rand.New(rand.NewSource(s.opts.Seed))
+
+	b := buffer(nil)
+	b = append(b, magicBytes...)
+	b.encodeNatural(1) // Number of metadata chunks.
+	viewBox := buffer(nil)
+	viewBox.encodeNatural(midViewBox)
+	viewBox.encodeCoordinate(-32)
+	viewBox.encodeCoordinate(-32)
+	viewBox.encodeCoordinate(+32)
+	viewBox.encodeCoordinate(+32)
+	b.encodeNatural(uint32(len(viewBox)))
+	b = append(b, viewBox...)
+
+	for i := 0; i < s.opts.NumDrawings; i++ {
+		b = s.appendDrawing(b, i)
+	}
+	return b, nil
+}
+
+type synthesizer struct {
+	opts     SynthesizeOptions
+	rng      *rand.Rand
+	numCoord int
+}
+
+func (s *synthesizer) setDefaults() error {
+	o := &s.opts
+	if o.NumDrawings == 0 {
+		o.NumDrawings = 1
+	}
+	if o.NumPathsPerDrawing == 0 {
+		o.NumPathsPerDrawing = 1
+	}
+	if o.NumSegmentsPerPath == 0 {
+		o.NumSegmentsPerPath = 8
+	}
+	if len(o.CoordinateWidths) == 0 {
+		o.CoordinateWidths = []int{1}
+	}
+
+	if (o.NumDrawings < 0) || (o.NumPathsPerDrawing < 0) || (o.NumSegmentsPerPath < 0) ||
+		((o.NumGradientStops != 0) && ((o.NumGradientStops < 2) || (64 < o.NumGradientStops))) ||
+		(o.LODDepth < 0) || (o.LODDepth > 12) || (o.RegisterRunLength < 0) ||
+		(o.NumCallsPerDrawing < 0) || (o.CallSegmentLength < 0) || (o.CallSegmentLength > 0xFFFFFF) {
+		return errInvalidSynthesizeOptions
+	}
+	for _, w := range o.CoordinateWidths {
+		if (w != 1) && (w != 2) && (w != 4) {
+			return errInvalidSynthesizeOptions
+		}
+	}
+	return nil
+}
+
+// coordinate returns a pseudo-random coordinate in the ViewBox's [-32, +32)
+// range that encodes in the next CoordinateWidths number of bytes.
+func (s *synthesizer) coordinate() float32 {
+	w := s.opts.CoordinateWidths[s.numCoord%len(s.opts.CoordinateWidths)]
+	s.numCoord++
+	switch w {
+	case 1:
+		return float32(s.rng.Intn(64) - 32)
+	case 2:
+		// A non-integral multiple of 1/64.
+		return float32((64*s.rng.Intn(64))-(64*32)+1+s.rng.Intn(63)) / 64
+	}
+	// Not a multiple of 1/64. The low two bits of the float32 mantissa are
+	// zero so that encodeCoordinate's rounding is a no-op.
+	return float32((1024*s.rng.Intn(64))-(1024*32)+1+2*s.rng.Intn(511)) / 1024
+}
+
+func (s *synthesizer) appendCoordinates(b buffer, n int) buffer {
+	for ; n > 0; n-- {
+		b.encodeCoordinate(s.coordinate())
+	}
+	return b
+}
+
+func (s *synthesizer) appendCall(b buffer) buffer {
+	n := s.opts.CallSegmentLength
+	b = append(b, 0x3C) // Call Untransformed.
+	// An Inline SegRef: Segment Type 0x00, then a 24-bit Segment Length, then
+	// 32 zero bits.
+	b = append(b, 0x00, uint8(n), uint8(n>>8), uint8(n>>16), 0x00, 0x00, 0x00, 0x00)
+	for i := 0; i < n; i++ {
+		b = append(b, 0x37) // NOP.
+	}
+	return b
+}
+
+// appendDrawing appends the i'th drawing, wrapped in s.opts.LODDepth nested
+// LODJump ops.
+func (s *synthesizer) appendDrawing(b buffer, i int) buffer {
+	body, numOps := s.drawingBody(i)
+	for j := s.opts.LODDepth - 1; j >= 0; j-- {
+		threshold := float32(int(16) << uint(j))
+		lod0, lod1 := float32(0), threshold
+		if (i>>uint(j))&1 != 0 {
+			lod0, lod1 = threshold, 65536
+		}
+		jump := buffer{0x3A}
+		jump.encodeNatural(uint32(numOps))
+		jump.encodeCoordinate(lod0)
+		jump.encodeCoordinate(lod1)
+		body = append(jump, body...)
+		numOps++
+	}
+	return append(b, body...)
+}
+
+// drawingBody returns the encoded ops for the i'th drawing (its Call ops,
+// paths, register ops and fill) and the number of those ops.
+func (s *synthesizer) drawingBody(i int) (b buffer, numOps int) {
+	for j := 0; j < s.opts.NumCallsPerDrawing; j++ {
+		b = s.appendCall(b)
+		numOps++
+	}
+
+	for p := 0; p < s.opts.NumPathsPerDrawing; p++ {
+		b = append(b, 0x35) // ClosePath; MoveTo.
+		b = s.appendCoordinates(b, 2)
+		numOps++
+
+		for remaining := s.opts.NumSegmentsPerPath; remaining > 0; {
+			reps := 1 + s.rng.Intn(15)
+			if s.rng.Intn(8) == 0 {
+				reps = 16 + s.rng.Intn(48)
+			}
+			if reps > remaining {
+				reps = remaining
+			}
+			remaining -= reps
+
+			kind := s.rng.Intn(3) // 0, 1, 2 means LineTo, QuadTo, CubeTo.
+			if reps < 16 {
+				b = append(b, uint8(kind<<4)|uint8(reps))
+			} else {
+				b = append(b, uint8(kind<<4))
+				b.encodeNatural(uint32(reps - 16))
+			}
+			b = s.appendCoordinates(b, reps*2*(kind+1))
+			numOps++
+		}
+	}
+
+	// Write RegisterRunLength registers below SEL, in runs of up to 17, then
+	// restore SEL. These registers are overwritten before they are used.
+	if n := s.opts.RegisterRunLength; n > 0 {
+		b, numOps = s.appendRegisterRun(b, numOps, n, func(int) uint64 {
+			return s.rng.Uint64()
+		})
+		b = append(b, 0x36, uint8(n&63)) // SEL += n.
+		numOps++
+	}
+
+	if k := s.opts.NumGradientStops; k > 0 {
+		// Set REGS[SEL+1 .. SEL+1+k] to the stops, then fill with them.
+		b, numOps = s.appendRegisterRun(b, numOps, k, func(j int) uint64 {
+			lo := uint64(j * 0x10000 / (k - 1))
+			return lo | (uint64(s.opaqueColor()) << 32)
+		})
+		config := uint8(k-2) | uint8(i&3)<<6
+		if i&1 == 0 {
+			b = append(b, 0x91, config) // Linear gradient, REGS[SEL+1 ..].
+			b.encodeFloat32(1.0 / 64)
+			b.encodeFloat32(0)
+			b.encodeFloat32(0.5)
+		} else {
+			b = append(b, 0xA1, config) // Radial gradient, REGS[SEL+1 ..].
+			b.encodeFloat32(1.0 / 32)
+			b.encodeFloat32(0)
+			b.encodeFloat32(0)
+			b.encodeFloat32(0)
+			b.encodeFloat32(1.0 / 32)
+			b.encodeFloat32(0)
+		}
+		b = append(b, 0x36, uint8(k&63)) // SEL += k.
+		numOps += 2
+
+	} else {
+		c := s.opaqueColor()
+		// Set REGS[SEL+1].hi32 and fill with it.
+		b = append(b, 0x51, uint8(c), uint8(c>>8), uint8(c>>16), uint8(c>>24))
+		b = append(b, 0x81)
+		numOps += 2
+	}
+	return b, numOps
+}
+
+// appendRegisterRun sets REGS[SEL-n+1 .. SEL+1] to value(0), value(1), ...,
+// value(n-1) and then decrements SEL by n, so that those registers become
+// REGS[SEL+1 .. SEL+1+n].
+func (s *synthesizer) appendRegisterRun(b buffer, numOps int, n int, value func(int) uint64) (buffer, int) {
+	// Each multi-register op decrements SEL first, so emit the highest
+	// registers first.
+	for end := n; end > 0; {
+		chunk := end
+		if chunk > 17 {
+			chunk = 17
+		}
+		start := end - chunk
+		if chunk == 1 {
+			b = append(b, 0x60) // Set REGS[SEL+0]; SEL--.
+		} else {
+			b = append(b, 0x70|uint8(chunk-2)) // SEL -= chunk; Set etc.
+		}
+		for j := start; j < end; j++ {
+			v := value(j)
+			b = append(b,
+				uint8(v>>0), uint8(v>>8), uint8(v>>16), uint8(v>>24),
+				uint8(v>>32), uint8(v>>40), uint8(v>>48), uint8(v>>56))
+		}
+		numOps++
+		end = start
+	}
+	return b, numOps
+}
+
+// opaqueColor returns a pseudo-random opaque color, packed as a little-endian
+// RGBA uint32. Opaque colors are always sensible alpha-premultiplied colors.
+func (s *synthesizer) opaqueColor() uint32 {
+	return uint32(s.rng.Intn(1<<24)) | 0xFF000000
+}